@@ -1,10 +1,199 @@
+const {Zcl} = require('zigbee-herdsman');
 const m = require('zigbee-herdsman-converters/lib/modernExtend');
 
+// Offline backfill batches (EP1 cluster 0xFC01, command 0x00), see main/meas_log.h.
+// Field order and scale of the firmware's meas_field_t.
+const BACKFILL_FIELDS = [
+    ['temperature', 0.1],
+    ['humidity', 0.1],
+    ['pressure', 0.1],
+    ['external_temperature', 0.1],
+    ['wind_speed', 0.1],
+    ['wind_direction', 1],
+    ['illuminance', 32],        // ZCL MeasuredValue units, converted to lux below
+    ['battery_voltage', 1],     // mV
+    ['rain_tips', 1],           // total tips modulo 32768
+];
+const BACKFILL_ABSENT_KEY = -32768;
+const BACKFILL_ABSENT_DELTA = -128;
+const BACKFILL_KIND_KEY = 0;
+const BACKFILL_KIND_DELTA = 1;
+const BACKFILL_KIND_KEY_OLD_BOOT = 2;   // device clock of an earlier boot: time unknown
+
+function decodeBackfillBatch(buf, receivedMs) {
+    if (buf.length < 8 || (buf[0] !== 1 && buf[0] !== 2)) return [];
+    const count = buf[1];
+    const deviceNow = buf.readUInt32LE(2);
+    const tipMm = buf.readUInt16LE(6) / 1000;
+    const n = BACKFILL_FIELDS.length;
+    const samples = [];
+    let pos = 8;
+    let prev = null;
+    for (let i = 0; i < count; i++) {
+        const kind = buf[pos++];
+        const cur = {time: 0, oldBoot: false, v: new Array(n)};
+        if ((kind === BACKFILL_KIND_KEY || kind === BACKFILL_KIND_KEY_OLD_BOOT) && pos + 4 + 2 * n <= buf.length) {
+            cur.time = buf.readUInt32LE(pos);
+            cur.oldBoot = kind === BACKFILL_KIND_KEY_OLD_BOOT;
+            for (let f = 0; f < n; f++) {
+                const raw = buf.readInt16LE(pos + 4 + 2 * f);
+                cur.v[f] = raw === BACKFILL_ABSENT_KEY ? null : raw;
+            }
+            pos += 4 + 2 * n;
+        } else if (kind === BACKFILL_KIND_DELTA && prev && pos + 2 + n <= buf.length) {
+            cur.time = prev.time + buf.readUInt16LE(pos);
+            cur.oldBoot = prev.oldBoot;
+            for (let f = 0; f < n; f++) {
+                const d = buf.readInt8(pos + 2 + f);
+                if (d === BACKFILL_ABSENT_DELTA || prev.v[f] === null) {
+                    cur.v[f] = null;
+                } else if (BACKFILL_FIELDS[f][0] === 'wind_direction') {
+                    cur.v[f] = (prev.v[f] + d + 360) % 360;
+                } else if (BACKFILL_FIELDS[f][0] === 'rain_tips') {
+                    cur.v[f] = (prev.v[f] + d) & 0x7fff;
+                } else {
+                    cur.v[f] = prev.v[f] + d;
+                }
+            }
+            pos += 2 + n;
+        } else {
+            break;
+        }
+        prev = cur;
+
+        // Version 1 batches carry no boot: their keys are all taken as this boot's
+        const sample = cur.oldBoot ? {time_unknown: true}
+            : {time: new Date(receivedMs - (deviceNow - cur.time) * 1000).toISOString()};
+        BACKFILL_FIELDS.forEach(([name, scale], f) => {
+            if (cur.v[f] === null) return;
+            if (name === 'illuminance') {
+                sample.illuminance = Math.round(Math.pow(10, (cur.v[f] * scale - 1) / 10000));
+            } else if (name === 'rain_tips') {
+                sample.rain_amount = Math.round(cur.v[f] * tipMm * 100) / 100;
+            } else {
+                sample[name] = Math.round(cur.v[f] * scale * 10) / 10;
+            }
+        });
+        samples.push(sample);
+    }
+    return samples;
+}
+
+const fzBackfill = {
+    cluster: 'caelumBackfill',
+    type: ['commandBatch'],
+    convert: (model, msg, publish, options, meta) => {
+        const samples = decodeBackfillBatch(Buffer.from(msg.data.data), Date.now());
+        return samples.length ? {backfill: samples} : {};
+    },
+};
+
+// Awake time per cause (EP1 cluster 0xFC02, attribute 0x0020), see
+// main/power_profiler.h: u8 version, u8 count, then u32 ms per cause.
+const POWER_CAUSES = [
+    'acquisition', 'env', 'ds18b20', 'wind_speed', 'wind_dir', 'light',
+    'battery', 'backfill', 'rejoin', 'join_config', 'ota', 'led',
+];
+
+const fzPowerCauses = {
+    cluster: 'caelumDiagnostics',
+    type: ['attributeReport', 'readResponse'],
+    convert: (model, msg, publish, options, meta) => {
+        const raw = msg.data.powerCauses;
+        if (raw === undefined) return {};
+        const buf = Buffer.from(raw);
+        if (buf.length < 2 || buf[0] !== 1) return {};
+        const result = {};
+        for (let i = 0; i < buf[1] && 2 + 4 * i + 4 <= buf.length; i++) {
+            result[POWER_CAUSES[i] || `cause_${i}`] = buf.readUInt32LE(2 + 4 * i);
+        }
+        return {awake_by_cause: result};
+    },
+};
+
+// Telemetry snapshot (EP1 cluster 0xFC03, attribute 0x0000), see
+// main/telemetry.h: u8 version, u8 field count, u16 sequence number, then the
+// fields of the firmware's telemetry_table in order, little endian. Published
+// under the keys the standard clusters use, so either source fills the same
+// entities.
+const TELEMETRY_FIELDS = [
+    ['temperature_1', 's16', 0.1],
+    ['humidity_1', 'u16', 0.1],
+    ['pressure_1', 's16', 0.1],
+    ['voltage', 'u8', 100],             // 0.1 V -> mV
+    ['battery', 'u8', 0.5],             // 0.5 % -> %
+    ['rain_amount_2', 'u32', 0.01],
+    ['temperature_3', 's16', 0.1],
+    ['temperature_7', 's16', 0.1],
+    ['temperature_8', 's16', 0.1],
+    ['wind_speed_4', 'u16', 0.1],
+    ['wind_gust_4', 'u16', 0.1],
+    ['wind_speed_avg_2min_4', 'u16', 0.1],
+    ['wind_speed_avg_10min_4', 'u16', 0.1],
+    ['wind_direction_5', 'u16', 1],
+    ['wind_direction_avg_2min_5', 'u16', 1],
+    ['wind_direction_avg_10min_5', 'u16', 1],
+    ['illuminance_6', 'u16', 1],        // ZCL MeasuredValue, converted to lux below
+    ['pressure_tendency_1', 's16', 0.1],
+];
+const TELEMETRY_ENCODINGS = {
+    s16: {size: 2, read: (b, p) => b.readInt16LE(p), absent: -32768},
+    u8: {size: 1, read: (b, p) => b.readUInt8(p), absent: 0xff},
+    u16: {size: 2, read: (b, p) => b.readUInt16LE(p), absent: 0xffff},
+    u32: {size: 4, read: (b, p) => b.readUInt32LE(p), absent: 0xffffffff},
+};
+
+function decodeTelemetrySnapshot(buf) {
+    if (buf.length < 4 || buf[0] !== 1) return {};
+    const result = {telemetry_sequence: buf.readUInt16LE(2)};
+    let pos = 4;
+    // Fields are appended only: skip any this converter does not know yet
+    for (let f = 0; f < Math.min(buf[1], TELEMETRY_FIELDS.length); f++) {
+        const [name, encoding, scale] = TELEMETRY_FIELDS[f];
+        const enc = TELEMETRY_ENCODINGS[encoding];
+        if (pos + enc.size > buf.length) break;
+        const raw = enc.read(buf, pos);
+        pos += enc.size;
+        if (raw === enc.absent) continue;
+        if (name === 'illuminance_6') {
+            result[name] = raw === 0 ? 0 : Math.round(Math.pow(10, (raw - 1) / 10000));
+        } else {
+            result[name] = Math.round(raw * scale * 100) / 100;
+        }
+    }
+    return result;
+}
+
+const fzTelemetry = {
+    cluster: 'caelumTelemetry',
+    type: ['attributeReport', 'readResponse'],
+    convert: (model, msg, publish, options, meta) => {
+        const raw = msg.data.snapshot;
+        if (raw === undefined) return {};
+        return decodeTelemetrySnapshot(Buffer.from(raw));
+    },
+};
+
+// Z2M configures reporting of the standard clusters during the interview,
+// possibly after the firmware switched it off for snapshot mode. Writing the
+// mode back (last extend) makes the firmware apply it again.
+const telemetryReapplyMode = {
+    isModernExtend: true,
+    configure: [
+        async (device, coordinatorEndpoint, definition) => {
+            const endpoint = device.getEndpoint(1);
+            const {mode} = await endpoint.read('caelumTelemetry', ['mode']);
+            await endpoint.write('caelumTelemetry', {mode});
+        },
+    ],
+};
+
 module.exports = {
     zigbeeModel: ['caelum_pro'],
     model: 'caelum_pro',
     vendor: 'ESPRESSIF',
     description: 'Caelum Pro - Battery-powered Zigbee weather station (SHT4x + LPS22HB + DS18B20 + rain + wind + light)',
+    fromZigbee: [fzBackfill, fzPowerCauses, fzTelemetry],
     extend: [
         // Firmware endpoint map:
         //   EP1 = environmental (SHT4x temp/humidity, LPS22HB pressure, battery)
@@ -13,7 +202,9 @@ module.exports = {
         //   EP4 = wind speed       (genAnalogInput presentValue = m/s)
         //   EP5 = wind direction   (genAnalogInput presentValue = degrees)
         //   EP6 = illuminance      (standard Illuminance Measurement cluster 0x0400)
-        m.deviceEndpoints({endpoints: {"1": 1, "2": 2, "3": 3, "4": 4, "5": 5, "6": 6}}),
+        //   EP7 = DS18B20 probe 2  (only if a second probe is on the 1-Wire bus)
+        //   EP8 = DS18B20 probe 3  (only if a third probe is on the 1-Wire bus)
+        m.deviceEndpoints({endpoints: {"1": 1, "2": 2, "3": 3, "4": 4, "5": 5, "6": 6, "7": 7, "8": 8}}),
 
         // EP1 - on-board environmental sensors
         m.temperature({
@@ -31,6 +222,22 @@ module.exports = {
             access: "STATE_GET",
             reporting: {min: 10, max: 3600, change: 10},
         }),
+        // EP1 genPressureMeasurement 0x4000 - 3-hour pressure tendency in
+        // 0.1 hPa, reported once 3 h of readings are held (RTC memory, lost on
+        // power-on).
+        m.numeric({
+            endpointNames: ["1"],
+            name: "pressure_tendency",
+            cluster: "genPressureMeasurement",
+            attribute: {ID: 0x4000, type: Zcl.DataType.INT16},
+            reporting: {min: 10, max: 3600, change: 1},
+            description: "Pressure change over the last 3 hours",
+            unit: "hPa",
+            scale: 10,
+            precision: 1,
+            access: "STATE_GET",
+            icon: "mdi:trending-down",
+        }),
         m.battery(),
 
         // NOTE: the firmware also exposes battery ADC diagnostics on genPowerCfg
@@ -39,6 +246,321 @@ module.exports = {
         // device page clean - read them on demand via the Z2M dev console by
         // numeric attribute ID if the battery ADC ever needs debugging again.
 
+        // EP1 genPowerCfg 0x4005 - time awake per report (acquisition trigger
+        // to attribute flush), to confirm the effect of sensor timing changes.
+        m.numeric({
+            endpointNames: ["1"],
+            name: "awake_time",
+            cluster: "genPowerCfg",
+            attribute: {ID: 0x4005, type: Zcl.DataType.UINT16},
+            reporting: {min: 60, max: 3600, change: 2},
+            description: "Time awake for the last sensor report",
+            unit: "ms",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+            icon: "mdi:timer-outline",
+        }),
+
+        // EP1 cluster 0xFC00 - adaptive reporting scheduler. The firmware reads
+        // every 5 min in active weather and backs off to 30 min when stable;
+        // all limits are kept in NVS on the device.
+        m.deviceAddCustomCluster("caelumScheduler", {
+            ID: 0xFC00,
+            attributes: {
+                minInterval: {ID: 0x0000, type: Zcl.DataType.UINT16},
+                maxInterval: {ID: 0x0001, type: Zcl.DataType.UINT16},
+                pressureFall: {ID: 0x0002, type: Zcl.DataType.SINGLE_PREC},
+                windGust: {ID: 0x0003, type: Zcl.DataType.SINGLE_PREC},
+                windShift: {ID: 0x0004, type: Zcl.DataType.SINGLE_PREC},
+                lowBattery: {ID: 0x0005, type: Zcl.DataType.UINT8},
+                interval: {ID: 0x0010, type: Zcl.DataType.UINT16},
+            },
+            commands: {},
+            commandsResponse: {},
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "report_interval",
+            cluster: "caelumScheduler",
+            attribute: "interval",
+            reporting: {min: 60, max: 3600, change: 1},
+            description: "Interval currently used by the adaptive scheduler",
+            unit: "s",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+            icon: "mdi:timer-sync-outline",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "report_interval_min",
+            cluster: "caelumScheduler",
+            attribute: "minInterval",
+            description: "Reading interval while the weather is active",
+            unit: "s",
+            valueMin: 60,
+            valueMax: 3600,
+            access: "ALL",
+            entityCategory: "config",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "report_interval_max",
+            cluster: "caelumScheduler",
+            attribute: "maxInterval",
+            description: "Longest reading interval in stable weather",
+            unit: "s",
+            valueMin: 60,
+            valueMax: 7200,
+            access: "ALL",
+            entityCategory: "config",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "pressure_fall_threshold",
+            cluster: "caelumScheduler",
+            attribute: "pressureFall",
+            description: "Pressure fall rate that counts as active weather",
+            unit: "hPa/h",
+            valueMin: 0.1,
+            valueMax: 10,
+            valueStep: 0.1,
+            access: "ALL",
+            entityCategory: "config",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "wind_gust_threshold",
+            cluster: "caelumScheduler",
+            attribute: "windGust",
+            description: "Gust above the 10-minute mean that counts as variable wind",
+            unit: "m/s",
+            valueMin: 0.5,
+            valueMax: 20,
+            valueStep: 0.5,
+            access: "ALL",
+            entityCategory: "config",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "wind_shift_threshold",
+            cluster: "caelumScheduler",
+            attribute: "windShift",
+            description: "Direction change (2 vs 10 min mean) that counts as variable wind",
+            unit: "°",
+            valueMin: 5,
+            valueMax: 180,
+            access: "ALL",
+            entityCategory: "config",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "low_battery_threshold",
+            cluster: "caelumScheduler",
+            attribute: "lowBattery",
+            description: "Battery level below which the reading interval is stretched",
+            unit: "%",
+            valueMin: 0,
+            valueMax: 100,
+            access: "ALL",
+            entityCategory: "config",
+        }),
+
+        // EP1 cluster 0xFC01 - samples buffered while the coordinator was
+        // unreachable. The firmware sends them in batches after a rejoin;
+        // fzBackfill publishes each batch as "backfill" (list of samples with
+        // the time they were taken, reconstructed from the device clock;
+        // samples from before a reboot have time_unknown instead).
+        m.deviceAddCustomCluster("caelumBackfill", {
+            ID: 0xFC01,
+            attributes: {
+                pending: {ID: 0x0000, type: Zcl.DataType.UINT16},
+            },
+            commands: {},
+            commandsResponse: {
+                batch: {ID: 0x00, parameters: [{name: "data", type: Zcl.DataType.OCTET_STR}]},
+            },
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "backfill_pending",
+            cluster: "caelumBackfill",
+            attribute: "pending",
+            reporting: {min: 60, max: 3600, change: 1},
+            description: "Samples buffered offline and not yet sent",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+            icon: "mdi:database-clock-outline",
+        }),
+
+        // EP1 cluster 0xFC02 - diagnostics. The rejoin attributes describe the
+        // last outage: how many attempts it took, how long the radio spent
+        // scanning, and whether the quick last-channel scan or a full scan
+        // found the network again.
+        m.deviceAddCustomCluster("caelumDiagnostics", {
+            ID: 0xFC02,
+            attributes: {
+                rejoinAttempts: {ID: 0x0000, type: Zcl.DataType.UINT16},
+                rejoinScanTime: {ID: 0x0001, type: Zcl.DataType.UINT32},
+                rejoinOutage: {ID: 0x0002, type: Zcl.DataType.UINT32},
+                rejoinPhase: {ID: 0x0003, type: Zcl.DataType.UINT8},
+                rejoinCount: {ID: 0x0004, type: Zcl.DataType.UINT16},
+                powerAwake: {ID: 0x0010, type: Zcl.DataType.SINGLE_PREC},
+                powerSleep: {ID: 0x0011, type: Zcl.DataType.SINGLE_PREC},
+                powerSleeps: {ID: 0x0012, type: Zcl.DataType.UINT32},
+                powerTxFrames: {ID: 0x0013, type: Zcl.DataType.UINT32},
+                powerRadio: {ID: 0x0014, type: Zcl.DataType.SINGLE_PREC},
+                powerCharge: {ID: 0x0015, type: Zcl.DataType.SINGLE_PREC},
+                powerCurrent: {ID: 0x0016, type: Zcl.DataType.SINGLE_PREC},
+                powerCauses: {ID: 0x0020, type: Zcl.DataType.OCTET_STR},
+            },
+            commands: {},
+            commandsResponse: {},
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "rejoin_attempts",
+            cluster: "caelumDiagnostics",
+            attribute: "rejoinAttempts",
+            reporting: {min: 60, max: 43200, change: 1},
+            description: "Rejoin attempts during the last outage",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "rejoin_scan_time",
+            cluster: "caelumDiagnostics",
+            attribute: "rejoinScanTime",
+            reporting: {min: 60, max: 43200, change: 1},
+            description: "Time spent scanning for the network during the last outage",
+            unit: "ms",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "rejoin_outage",
+            cluster: "caelumDiagnostics",
+            attribute: "rejoinOutage",
+            reporting: {min: 60, max: 43200, change: 1},
+            description: "Duration of the last outage",
+            unit: "s",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+        }),
+        m.enumLookup({
+            endpointName: "1",
+            name: "rejoin_phase",
+            cluster: "caelumDiagnostics",
+            attribute: "rejoinPhase",
+            lookup: {none: 0, last_channel: 1, all_channels: 2},
+            reporting: {min: 60, max: 43200, change: 1},
+            description: "Scan that ended the last outage",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "rejoin_count",
+            cluster: "caelumDiagnostics",
+            attribute: "rejoinCount",
+            reporting: {min: 60, max: 43200, change: 1},
+            description: "Outages recovered since the last reboot",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+            icon: "mdi:lan-connect",
+        }),
+
+        // Power profile since the last power-on, refreshed hourly with the
+        // battery read. Charge and current come from the firmware's current
+        // model (POWER_MODEL_* in main/power_profiler.h), not a measurement.
+        // The per-cause split is read on demand: reading powerCauses publishes
+        // awake_by_cause (ms per cause).
+        m.numeric({
+            endpointNames: ["1"],
+            name: "power_awake_time",
+            cluster: "caelumDiagnostics",
+            attribute: "powerAwake",
+            reporting: {min: 600, max: 43200, change: 10},
+            description: "Time awake since power-on",
+            unit: "s",
+            precision: 0,
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "power_sleep_time",
+            cluster: "caelumDiagnostics",
+            attribute: "powerSleep",
+            reporting: {min: 600, max: 43200, change: 60},
+            description: "Time in light sleep since power-on",
+            unit: "s",
+            precision: 0,
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "power_tx_frames",
+            cluster: "caelumDiagnostics",
+            attribute: "powerTxFrames",
+            reporting: {min: 600, max: 43200, change: 10},
+            description: "APS frames sent since power-on",
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "power_radio_time",
+            cluster: "caelumDiagnostics",
+            attribute: "powerRadio",
+            reporting: {min: 600, max: 43200, change: 1},
+            description: "Modelled radio-on time since power-on",
+            unit: "s",
+            precision: 1,
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+        }),
+        m.numeric({
+            endpointNames: ["1"],
+            name: "power_average_current",
+            cluster: "caelumDiagnostics",
+            attribute: "powerCurrent",
+            reporting: {min: 600, max: 43200, change: 1},
+            description: "Modelled average current since power-on",
+            unit: "µA",
+            precision: 1,
+            access: "STATE_GET",
+            entityCategory: "diagnostic",
+            icon: "mdi:current-dc",
+        }),
+
+        // EP1 cluster 0xFC03 - telemetry snapshot. Every channel in one report
+        // frame per reading (fzTelemetry), then nothing until a value changes
+        // or the hourly heartbeat. In "snapshot" mode the firmware keeps the
+        // standard clusters readable but does not report them; "both" and
+        // "standard" bring their reports back. Kept in NVS on the device.
+        m.deviceAddCustomCluster("caelumTelemetry", {
+            ID: 0xFC03,
+            attributes: {
+                snapshot: {ID: 0x0000, type: Zcl.DataType.OCTET_STR},
+                mode: {ID: 0x0001, type: Zcl.DataType.UINT8},
+            },
+            commands: {},
+            commandsResponse: {},
+        }),
+        m.enumLookup({
+            endpointName: "1",
+            name: "telemetry_mode",
+            cluster: "caelumTelemetry",
+            attribute: "mode",
+            lookup: {snapshot: 0, both: 1, standard: 2},
+            description: "Report all channels in one snapshot frame, the standard clusters, or both",
+            access: "ALL",
+            entityCategory: "config",
+        }),
+
         // EP2 - rain gauge total (mm)
         m.numeric({
             endpointNames: ["2"],
@@ -53,9 +575,11 @@ module.exports = {
             icon: "mdi:weather-rainy",
         }),
 
-        // EP3 - DS18B20 external temperature probe
+        // EP3/EP7/EP8 - DS18B20 external temperature probes (shared 1-Wire bus).
+        // EP7/EP8 only exist when extra probes were enumerated; re-interview the
+        // device after adding a probe.
         m.temperature({
-            endpointNames: ["3"],
+            endpointNames: ["3", "7", "8"],
             access: "STATE_GET",
             reporting: {min: 10, max: 3600, change: 10},
         }),
@@ -73,6 +597,43 @@ module.exports = {
             access: "STATE_GET",
             icon: "mdi:weather-windy",
         }),
+        // EP4 - wind statistics from the 1 Hz sampler (custom genAnalogInput attributes)
+        m.numeric({
+            endpointNames: ["4"],
+            name: "wind_gust",
+            cluster: "genAnalogInput",
+            attribute: {ID: 0x4000, type: Zcl.DataType.SINGLE_PREC},
+            reporting: {min: 0, max: 3600, change: 0.5},
+            description: "Peak 3 s gust since the previous report",
+            unit: "m/s",
+            precision: 1,
+            access: "STATE_GET",
+            icon: "mdi:weather-windy-variant",
+        }),
+        m.numeric({
+            endpointNames: ["4"],
+            name: "wind_speed_avg_2min",
+            cluster: "genAnalogInput",
+            attribute: {ID: 0x4001, type: Zcl.DataType.SINGLE_PREC},
+            reporting: {min: 0, max: 3600, change: 0.5},
+            description: "2-minute average wind speed",
+            unit: "m/s",
+            precision: 1,
+            access: "STATE_GET",
+            icon: "mdi:weather-windy",
+        }),
+        m.numeric({
+            endpointNames: ["4"],
+            name: "wind_speed_avg_10min",
+            cluster: "genAnalogInput",
+            attribute: {ID: 0x4002, type: Zcl.DataType.SINGLE_PREC},
+            reporting: {min: 0, max: 3600, change: 0.5},
+            description: "10-minute average wind speed",
+            unit: "m/s",
+            precision: 1,
+            access: "STATE_GET",
+            icon: "mdi:weather-windy",
+        }),
 
         // EP5 - wind direction (degrees, 0 = North)
         m.numeric({
@@ -87,6 +648,30 @@ module.exports = {
             access: "STATE_GET",
             icon: "mdi:compass",
         }),
+        m.numeric({
+            endpointNames: ["5"],
+            name: "wind_direction_avg_2min",
+            cluster: "genAnalogInput",
+            attribute: {ID: 0x4000, type: Zcl.DataType.SINGLE_PREC},
+            reporting: {min: 0, max: 3600, change: 5},
+            description: "2-minute vector-averaged wind direction",
+            unit: "°",
+            precision: 0,
+            access: "STATE_GET",
+            icon: "mdi:compass",
+        }),
+        m.numeric({
+            endpointNames: ["5"],
+            name: "wind_direction_avg_10min",
+            cluster: "genAnalogInput",
+            attribute: {ID: 0x4001, type: Zcl.DataType.SINGLE_PREC},
+            reporting: {min: 0, max: 3600, change: 5},
+            description: "10-minute vector-averaged wind direction",
+            unit: "°",
+            precision: 0,
+            access: "STATE_GET",
+            icon: "mdi:compass",
+        }),
 
         // EP6 - illuminance (standard cluster)
         m.illuminance({
@@ -94,6 +679,8 @@ module.exports = {
             access: "STATE_GET",
             reporting: {min: 10, max: 3600, change: 100},
         }),
+
+        telemetryReapplyMode,
     ],
     meta: {multiEndpoint: true},
     ota: true,
@@ -0,0 +1,43 @@
+/*
+ * Host mock: bme280.h (esp-iot-solution bme280 component)
+ * No BME280 is modelled, so creating one fails like an absent chip.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "i2c_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BME280_I2C_ADDRESS_DEFAULT  0x76
+#define BME280_REGISTER_CHIPID      0xD0
+
+typedef enum { BME280_MODE_SLEEP = 0, BME280_MODE_FORCED = 1, BME280_MODE_NORMAL = 3 } bme280_sensor_mode;
+typedef enum { BME280_SAMPLING_NONE = 0, BME280_SAMPLING_X1 = 1 } bme280_sensor_sampling;
+typedef enum { BME280_FILTER_OFF = 0 } bme280_sensor_filter;
+typedef enum { BME280_STANDBY_MS_0_5 = 0 } bme280_standby_duration;
+
+typedef struct {
+    i2c_bus_device_handle_t i2c_dev;
+    uint8_t dev_addr;
+} bme280_dev_t;
+
+typedef bme280_dev_t *bme280_handle_t;
+
+bme280_handle_t bme280_create(i2c_bus_handle_t bus, uint8_t dev_addr);
+esp_err_t bme280_delete(bme280_handle_t *sensor);
+esp_err_t bme280_set_sampling(bme280_handle_t sensor, bme280_sensor_mode mode, bme280_sensor_sampling temp,
+                              bme280_sensor_sampling press, bme280_sensor_sampling hum,
+                              bme280_sensor_filter filter, bme280_standby_duration duration);
+esp_err_t bme280_read_coefficients(bme280_handle_t sensor);
+esp_err_t bme280_take_forced_measurement(bme280_handle_t sensor);
+esp_err_t bme280_read_temperature(bme280_handle_t sensor, float *temperature);
+esp_err_t bme280_read_humidity(bme280_handle_t sensor, float *humidity);
+esp_err_t bme280_read_pressure(bme280_handle_t sensor, float *pressure);
+
+#ifdef __cplusplus
+}
+#endif
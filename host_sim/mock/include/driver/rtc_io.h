@@ -0,0 +1,18 @@
+/*
+ * Host mock: driver/rtc_io.h
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t gpio_num);
+
+#ifdef __cplusplus
+}
+#endif
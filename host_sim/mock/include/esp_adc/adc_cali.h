@@ -0,0 +1,19 @@
+/*
+ * Host mock: esp_adc/adc_cali.h (ideal linear calibration, 0-3300 mV)
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct adc_cali_scheme_t *adc_cali_handle_t;
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Host mock: esp_adc/adc_cali_scheme.h (the ESP32-H2 has curve fitting)
+ */
+
+#pragma once
+
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_oneshot.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED 1
+#define ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED  0
+
+typedef struct {
+    adc_unit_t unit_id;
+    adc_channel_t chan;
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+} adc_cali_curve_fitting_config_t;
+
+typedef adc_cali_curve_fitting_config_t adc_cali_line_fitting_config_t;
+
+esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t *config,
+                                               adc_cali_handle_t *ret_handle);
+esp_err_t adc_cali_delete_scheme_curve_fitting(adc_cali_handle_t handle);
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config,
+                                              adc_cali_handle_t *ret_handle);
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,7 @@
+/*
+ * Host mock: esp_app_format.h
+ */
+
+#pragma once
+
+#define ESP_IMAGE_HEADER_MAGIC      0xE9
@@ -0,0 +1,9 @@
+/*
+ * Host mock: esp_attr.h
+ */
+
+#pragma once
+
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
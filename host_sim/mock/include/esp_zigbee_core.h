@@ -0,0 +1,116 @@
+/*
+ * Host mock: esp_zigbee_core.h
+ * Only what the compiled modules use. Attribute writes mark their cluster for
+ * a report unless local reporting of the attribute was turned off; the
+ * scheduler alarms run on the simulated Zigbee task (sim_zigbee.c), and
+ * frames for us wait at the parent until a poll fetches them.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG              0x0001
+#define ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT              0x000C
+#define ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE               0x0019
+#define ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT   0x0400
+#define ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT          0x0402
+#define ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT      0x0403
+#define ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT  0x0405
+
+#define ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID                   0x0000
+#define ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID           0x0000
+#define ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID               0x0000
+#define ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID   0x0000
+#define ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID               0x0055
+
+#define ESP_ZB_ZCL_CLUSTER_SERVER_ROLE                  0x01
+#define ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI                 0x01
+#define ESP_ZB_ZCL_REPORT_DIRECTION_SEND                0x00
+#define ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT            0x02
+
+#define ESP_ZB_ZCL_ATTR_TYPE_U8                         0x20
+#define ESP_ZB_ZCL_ATTR_TYPE_U16                        0x21
+#define ESP_ZB_ZCL_ATTR_TYPE_U32                        0x23
+#define ESP_ZB_ZCL_ATTR_TYPE_S16                        0x29
+#define ESP_ZB_ZCL_ATTR_TYPE_SINGLE                     0x39
+
+typedef enum {
+    ESP_ZB_ZCL_STATUS_SUCCESS = 0x00,
+    ESP_ZB_ZCL_STATUS_FAIL = 0x01,
+} esp_zb_zcl_status_t;
+
+typedef enum {
+    ESP_ZB_COMMON_SIGNAL_CAN_SLEEP = 0x16,
+} esp_zb_app_signal_type_t;
+
+typedef void (*esp_zb_callback_t)(uint8_t param);
+
+typedef struct {
+    uint8_t status;                 // 0 = delivered (APS ACK received)
+} esp_zb_apsde_data_confirm_t;
+
+typedef struct {
+    uint8_t status;
+    uint8_t dst_endpoint;           // 0 = ZDO
+    uint16_t cluster_id;
+} esp_zb_apsde_data_ind_t;
+
+typedef struct {
+    union {
+        uint16_t addr_short;
+    } dst_addr_u;
+    uint8_t dst_endpoint;
+    uint8_t src_endpoint;
+} esp_zb_zcl_basic_cmd_t;
+
+typedef struct {
+    uint8_t direction;
+    uint16_t attributeID;
+    uint8_t attrType;
+    uint16_t min_interval;
+    uint16_t max_interval;          // 0xFFFF = do not report
+    void *reportable_change;
+} esp_zb_zcl_config_report_record_t;
+
+typedef struct {
+    esp_zb_zcl_basic_cmd_t zcl_basic_cmd;
+    uint8_t address_mode;
+    uint16_t clusterID;
+    uint8_t record_number;
+    esp_zb_zcl_config_report_record_t *record_field;
+} esp_zb_zcl_config_report_cmd_t;
+
+typedef struct {
+    esp_zb_zcl_basic_cmd_t zcl_basic_cmd;
+    uint8_t address_mode;
+    uint16_t clusterID;
+    uint16_t attributeID;
+    uint8_t direction;
+} esp_zb_zcl_report_attr_cmd_t;
+
+typedef void (*esp_zb_apsde_data_confirm_callback_t)(esp_zb_apsde_data_confirm_t confirm);
+typedef bool (*esp_zb_apsde_data_indication_callback_t)(esp_zb_apsde_data_ind_t ind);
+
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                 uint16_t attr_id, void *value_p, bool check);
+void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time);
+bool esp_zb_lock_acquire(TickType_t block_ticks);
+void esp_zb_lock_release(void);
+void esp_zb_aps_data_confirm_handler_register(esp_zb_apsde_data_confirm_callback_t cb);
+void esp_zb_aps_data_indication_handler_register(esp_zb_apsde_data_indication_callback_t cb);
+void esp_zb_zdo_pim_set_long_poll_interval(uint32_t ms);
+uint16_t esp_zb_get_short_address(void);
+esp_err_t esp_zb_zcl_config_report_cmd_req(esp_zb_zcl_config_report_cmd_t *cmd_req);
+esp_err_t esp_zb_zcl_report_attr_cmd_req(esp_zb_zcl_report_attr_cmd_t *cmd_req);
+
+#ifdef __cplusplus
+}
+#endif
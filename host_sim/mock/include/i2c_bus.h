@@ -0,0 +1,54 @@
+/*
+ * Host mock: i2c_bus.h (esp-iot-solution i2c_bus component)
+ * Transfers go to the register models in sim_i2c.c and cost their bus time
+ * at the configured clock.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int i2c_port_t;
+
+#define I2C_NUM_0               0
+#define I2C_NUM_1               1
+#define I2C_MODE_MASTER         1
+#define NULL_I2C_MEM_ADDR       0xFF
+#define I2C_BUS_DEVICE_CREATE_DEFAULT 0
+
+typedef struct {
+    int mode;
+    int sda_io_num;
+    int scl_io_num;
+    bool sda_pullup_en;
+    bool scl_pullup_en;
+    struct {
+        uint32_t clk_speed;
+    } master;
+    uint32_t clk_flags;
+} i2c_config_t;
+
+typedef struct sim_i2c_bus *i2c_bus_handle_t;
+typedef struct sim_i2c_dev *i2c_bus_device_handle_t;
+
+i2c_bus_handle_t i2c_bus_create(i2c_port_t port, const i2c_config_t *conf);
+esp_err_t i2c_bus_delete(i2c_bus_handle_t *p_bus);
+uint8_t i2c_bus_scan(i2c_bus_handle_t bus, uint8_t *buf, uint8_t num);
+i2c_bus_device_handle_t i2c_bus_device_create(i2c_bus_handle_t bus, uint8_t dev_addr, uint32_t clk_speed);
+esp_err_t i2c_bus_device_delete(i2c_bus_device_handle_t *p_dev);
+esp_err_t i2c_bus_read_bytes(i2c_bus_device_handle_t dev, uint8_t mem_address, size_t data_len, uint8_t *data);
+esp_err_t i2c_bus_read_byte(i2c_bus_device_handle_t dev, uint8_t mem_address, uint8_t *data);
+esp_err_t i2c_bus_write_bytes(i2c_bus_device_handle_t dev, uint8_t mem_address, size_t data_len, const uint8_t *data);
+esp_err_t i2c_bus_write_byte(i2c_bus_device_handle_t dev, uint8_t mem_address, uint8_t data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Host mock: sdkconfig.h (values from sdkconfig.defaults that the modules read)
+ */
+
+#pragma once
+
+#define CONFIG_FREERTOS_HZ                          1000
+#define CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP      3
+#define CONFIG_PM_ENABLE                            1
+#define CONFIG_FREERTOS_USE_TICKLESS_IDLE           1
+
+/* Hardware profile (main/Kconfig.projbuild): the sim models the full board */
+#define CONFIG_CAELUM_PROFILE_FULL                  1
+#define CONFIG_CAELUM_PROFILE_NAME                  "full"
+#define CONFIG_CAELUM_HAS_ENV                       1
+#define CONFIG_CAELUM_HAS_DS18B20                   1
+#define CONFIG_CAELUM_HAS_WIND                      1
+#define CONFIG_CAELUM_HAS_LIGHT                     1
+#define CONFIG_CAELUM_ANEMOMETER_RADIUS_MM          70
+#define CONFIG_CAELUM_RAIN_UM_PER_PULSE             360
@@ -0,0 +1,5 @@
+/*
+ * Host mock: zcl_utility.h
+ */
+
+#pragma once
@@ -0,0 +1,205 @@
+/*
+ * weather_sim: replay a weather trace through the reporting pipeline
+ *
+ *   weather_sim <trace.csv> [--hours N] [--isr-in-sleep kept|lost] [--verbose]
+ *               [--label NAME] [--baseline FILE [--tolerance PCT]] [--emit-baseline]
+ *
+ * Prints an hourly table and "<metric> <value>" totals. With --baseline,
+ * every gated metric is compared against "<label>:<metric> <value>" in FILE
+ * and the exit code is 1 if any of them got worse by more than the tolerance.
+ * --emit-baseline prints the totals in that format instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "power_profiler.h"
+#include "rain_gauge.h"
+#include "sim.h"
+
+#define DEFAULT_HOURS           24.0
+#define DEFAULT_TOLERANCE_PCT   5.0
+#define US_PER_HOUR             3600000000LL
+
+typedef struct {
+    const char *name;
+    double value;
+    bool gated;                     // part of the regression check (higher is worse)
+} metric_t;
+
+static const char *const s_cause_names[POWER_CAUSE_COUNT] = {
+    "acquisition", "env", "ds18b20", "wind_speed", "wind_dir", "light", "battery",
+    "backfill", "rejoin", "join_config", "ota", "led",
+};
+
+static struct {
+    power_profile_t profile;
+    sim_stats_t stats;
+} s_last_hour;
+static int s_hour = 0;
+
+static void hourly_sample(void)
+{
+    power_profile_t p;
+    power_profiler_get(&p);
+    const sim_stats_t *s = &g_sim_stats;
+    const sim_stats_t *l = &s_last_hour.stats;
+    printf("%4d %10.1f %6lu %6lu %7lu %4lu %5lu %5lu %7lu\n", ++s_hour,
+           (p.awake_us - s_last_hour.profile.awake_us) / 1000.0,
+           (unsigned long)(s->wakes - l->wakes), (unsigned long)(s->attr_updates - l->attr_updates),
+           (unsigned long)(s->reports - l->reports), (unsigned long)(s->nvs_writes - l->nvs_writes),
+           (unsigned long)(s->flash_writes - l->flash_writes), (unsigned long)(s->tips_expected - l->tips_expected),
+           (unsigned long)(s->isr_edges_in_sleep - l->isr_edges_in_sleep));
+    s_last_hour.profile = p;
+    s_last_hour.stats = *s;
+}
+
+static bool baseline_lookup(const char *path, const char *label, const char *metric, double *value)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return false;
+    char key[128], line[256];
+    snprintf(key, sizeof(key), "%s:%s", label, metric);
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), f)) {
+        char name[128];
+        double v;
+        if (line[0] != '#' && sscanf(line, "%127s %lf", name, &v) == 2 && strcmp(name, key) == 0) {
+            *value = v;
+            found = true;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s <trace.csv> [--hours N] [--isr-in-sleep kept|lost] [--verbose]\n"
+                    "       [--label NAME] [--baseline FILE [--tolerance PCT]] [--emit-baseline]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace = NULL, *baseline = NULL, *label = NULL;
+    double hours = DEFAULT_HOURS, tolerance = DEFAULT_TOLERANCE_PCT;
+    sim_isr_policy_t policy = SIM_ISR_IN_SLEEP_KEPT;
+    bool emit_baseline = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--hours") == 0 && i + 1 < argc) {
+            hours = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--isr-in-sleep") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "lost") == 0) policy = SIM_ISR_IN_SLEEP_LOST;
+            else if (strcmp(argv[i], "kept") != 0) usage(argv[0]);
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            g_sim_log_level = ESP_LOG_INFO;
+        } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            label = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            tolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--emit-baseline") == 0) {
+            emit_baseline = true;
+        } else if (argv[i][0] != '-' && !trace) {
+            trace = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (!trace || hours <= 0.0) usage(argv[0]);
+
+    /* Label: trace file name without directory and extension */
+    char label_buf[64];
+    if (!label) {
+        const char *base = strrchr(trace, '/') ? strrchr(trace, '/') + 1 : trace;
+        snprintf(label_buf, sizeof(label_buf), "%s", base);
+        char *dot = strrchr(label_buf, '.');
+        if (dot) *dot = '\0';
+        label = label_buf;
+    }
+
+    int64_t end_us = (int64_t)(hours * US_PER_HOUR);
+    if (!trace_load(trace, end_us)) return 2;
+
+    if (!emit_baseline) {
+        printf("trace %s: %.1f h, ISR edges in light sleep %s\n", label, hours,
+               policy == SIM_ISR_IN_SLEEP_KEPT ? "kept" : "lost");
+        printf("hour   awake_ms  wakes  attrs reports  nvs flash  tips sleep_isr\n");
+        sim_set_sampler(US_PER_HOUR, hourly_sample);
+    }
+    sim_run(pipeline_app_main, end_us, policy);
+
+    power_profile_t p;
+    power_profiler_get(&p);
+    rain_gauge_stats_t rain;
+    rain_gauge_get_stats(&rain);
+    const sim_stats_t *s = &g_sim_stats;
+    uint32_t tips_counted = rain_gauge_pulse_count();
+    uint32_t tips_dropped = s->tips_expected > tips_counted ? s->tips_expected - tips_counted : 0;
+
+    const metric_t metrics[] = {
+        { "awake_ms_per_h", p.awake_us / 1000.0 / hours, true },
+        { "average_ua", p.average_ua, true },
+        { "charge_uah", p.charge_uah, false },
+        { "wakes_per_h", s->wakes / hours, true },
+        { "attr_updates_per_h", s->attr_updates / hours, true },
+        { "reports_per_h", s->reports / hours, true },
+        { "nvs_writes", s->nvs_writes, true },
+        { "nvs_commits", s->nvs_commits, false },
+        { "flash_writes", s->flash_writes, true },
+        { "flash_erases", s->flash_erases, true },
+        { "i2c_transfers_per_h", s->i2c_transfers / hours, true },
+        { "i2c_bus_creates", s->i2c_bus_creates, false },
+        { "polls", s->polls, false },
+        { "frames_lost", s->frames_lost, true },
+        { "rain_tips_expected", s->tips_expected, false },
+        { "rain_tips_counted", tips_counted, false },
+        { "rain_tips_dropped", tips_dropped, true },
+        { "rain_debounced", rain.debounced, false },
+        { "rain_ring_overruns", rain.ring_overruns, true },
+        { "anemometer_pulses", s->anemometer_pulses, false },
+        { "isr_edges_in_sleep", s->isr_edges_in_sleep, false },
+        { "isr_edges_lost", s->isr_edges_lost, true },
+    };
+    const size_t metric_count = sizeof(metrics) / sizeof(metrics[0]);
+
+    if (emit_baseline) {
+        for (size_t i = 0; i < metric_count; i++) {
+            if (metrics[i].gated) printf("%s:%s %.3f\n", label, metrics[i].name, metrics[i].value);
+        }
+        return 0;
+    }
+
+    printf("\n");
+    for (size_t i = 0; i < metric_count; i++) printf("%-22s %.3f\n", metrics[i].name, metrics[i].value);
+    for (int c = 0; c < POWER_CAUSE_COUNT; c++) {
+        if (p.cause_runs[c] == 0 && p.cause_us[c] == 0) continue;
+        printf("cause_%-16s %.3f ms in %lu runs\n", s_cause_names[c], p.cause_us[c] / 1000.0,
+               (unsigned long)p.cause_runs[c]);
+    }
+
+    if (!baseline) return 0;
+    int regressions = 0;
+    for (size_t i = 0; i < metric_count; i++) {
+        if (!metrics[i].gated) continue;
+        double ref;
+        if (!baseline_lookup(baseline, label, metrics[i].name, &ref)) {
+            printf("baseline: no %s:%s\n", label, metrics[i].name);
+            continue;
+        }
+        /* Relative tolerance, with one unit of slack so small counts do not flap */
+        double limit = ref * (1.0 + tolerance / 100.0);
+        if (limit < ref + 1.0) limit = ref + 1.0;
+        if (metrics[i].value > limit) {
+            printf("REGRESSION %s: %.3f -> %.3f (limit %.3f)\n", metrics[i].name, ref, metrics[i].value, limit);
+            regressions++;
+        }
+    }
+    printf("%s: %d regression(s) against %s (tolerance %.1f %%)\n", label, regressions, baseline, tolerance);
+    return regressions ? 1 : 0;
+}
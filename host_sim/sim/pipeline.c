@@ -0,0 +1,822 @@
+/*
+ * Firmware glue of the simulated device
+ * The reporting pipeline of esp_zb_weather.c - cadence table, acquisition
+ * trigger/collect, the per-channel read_and_report functions and the sleep
+ * hook - on top of the real driver and scheduling modules. esp_zb_weather.c
+ * itself is not compiled: it is mostly cluster creation and network handling
+ * the host has no use for. Keep the functions below in step with their
+ * firmware namesakes when the pipeline changes; the device is joined at t=0
+ * and stays online, so the offline log, backfill, rejoin and DS18B20 paths
+ * are left out.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "esp_zb_weather.h"
+#include "sleep_manager.h"
+#include "sensor_if.h"
+#include "i2c_config.h"
+#include "battery_monitor.h"
+#include "anemometer.h"
+#include "wind_stats.h"
+#include "attr_cache.h"
+#include "channel_sched.h"
+#include "rain_log.h"
+#include "rain_gauge.h"
+#include "power_profiler.h"
+#include "as5600.h"
+#include "veml7700.h"
+#include "hw_inventory.h"
+#include "poll_control.h"
+#include "telemetry.h"
+#include "pressure_tendency.h"
+#include "sim.h"
+
+static const char *TAG = "SIM_PIPELINE";
+
+#define INITIAL_CONFIG_DELAY_SEC        60      // longest the join window keeps the device awake
+#define PRESSURE_TREND_SPAN_S           (30 * 60)
+#define BATTERY_NVS_CHECKPOINT_READS    24
+
+#define ACQ_CH_ENV              (1U << 0)
+#define ACQ_CH_DS18B20          (1U << 1)
+#define ACQ_CH_RAIN             (1U << 2)
+#define ACQ_CH_WIND_SPEED       (1U << 3)
+#define ACQ_CH_WIND_DIR         (1U << 4)
+#define ACQ_CH_LIGHT            (1U << 5)
+#define ACQ_CH_BATTERY          (1U << 6)
+#define ACQ_CH_ALL              0x7FU
+#define ACQ_CH_FAST             (ACQ_CH_RAIN | ACQ_CH_WIND_SPEED | ACQ_CH_WIND_DIR | ACQ_CH_LIGHT)
+#define ACQ_AWAKE_ATTR_ID       0x4005
+
+static bool zigbee_network_connected = false;
+static esp_timer_handle_t periodic_report_timer = NULL;
+static adaptive_schedule_t sched_cfg = {
+    .min_interval_s = SCHED_DEFAULT_MIN_INTERVAL_S,
+    .max_interval_s = SCHED_DEFAULT_MAX_INTERVAL_S,
+    .pressure_fall_hpa_h = SCHED_DEFAULT_PRESSURE_FALL,
+    .wind_gust_ms = SCHED_DEFAULT_WIND_GUST,
+    .wind_shift_deg = SCHED_DEFAULT_WIND_SHIFT,
+    .low_battery_percent = SCHED_DEFAULT_LOW_BATTERY,
+};
+static uint32_t sched_interval_s = SCHED_DEFAULT_MIN_INTERVAL_S;
+static float sched_last_rain_mm = -1.0f;
+static float sched_wind_gust_excess_ms = 0.0f;
+static float pressure_trend_hpa_h = NAN;
+static uint16_t battery_last_good_mv = 0;
+static uint8_t battery_drop_confirm = 0;
+static uint16_t battery_reads_since_checkpoint = 0;
+static battery_estimate_t battery_estimate;
+static int64_t battery_last_read_us = -1;
+
+static bool acq_in_flight = false;
+static uint8_t acq_active_mask = 0;
+static uint8_t acq_deferred_mask = 0;
+static uint8_t acq_i2c_mask = 0;
+static int64_t acq_started_us = 0;
+
+static bool as5600_available = false;
+static bool as5600_magnet_ok = true;
+static float wind_dir_held = -1.0f;
+static bool veml7700_available = false;
+static bool drivers_ready = false;
+static hw_inventory_t hw_inventory;
+
+static const channel_sched_def_t cadence_table[] = {
+    { "rain+wind", ACQ_CH_FAST,    SCHED_DEFAULT_MIN_INTERVAL_S, SCHED_DEFAULT_MIN_INTERVAL_S, 0 },
+    { "env",       ACQ_CH_ENV,     CADENCE_ENV_S,     CADENCE_ENV_S,     CADENCE_ENV_S / 4 },
+    { "ds18b20",   ACQ_CH_DS18B20, CADENCE_DS18B20_S, CADENCE_DS18B20_S, CADENCE_DS18B20_S / 4 },
+    { "battery",   ACQ_CH_BATTERY, CADENCE_BATTERY_S, CADENCE_BATTERY_S, CADENCE_BATTERY_S / 4 },
+};
+
+/* Same attributes and deadbands as esp_zb_weather.c */
+static const attr_cache_def_t attr_cache_table[] = {
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ATTR_CACHE_S16, 10.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID, ATTR_CACHE_U16, 100.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID, ATTR_CACHE_S16, 1.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, PRESSURE_ATTR_TENDENCY_3H_ID, ATTR_CACHE_S16, 1.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0020, ATTR_CACHE_U8, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0021, ATTR_CACHE_U8, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4000, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4001, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4002, ATTR_CACHE_U8, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4003, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4004, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, ACQ_AWAKE_ATTR_ID, ATTR_CACHE_U16, 2.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, SCHED_ATTR_INTERVAL_ID, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_AWAKE_ID, ATTR_CACHE_FLOAT, 1.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_SLEEP_ID, ATTR_CACHE_FLOAT, 1.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_SLEEPS_ID, ATTR_CACHE_U32, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_TX_ID, ATTR_CACHE_U32, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_RADIO_ID, ATTR_CACHE_FLOAT, 0.1f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_CHARGE_ID, ATTR_CACHE_FLOAT, 1.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_CURRENT_ID, ATTR_CACHE_FLOAT, 0.1f },
+    { HA_ESP_RAIN_GAUGE_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, ATTR_CACHE_FLOAT, 0.3f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, ATTR_CACHE_FLOAT, 0.5f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_GUST_ID, ATTR_CACHE_FLOAT, 0.5f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_2MIN_ID, ATTR_CACHE_FLOAT, 0.5f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_10MIN_ID, ATTR_CACHE_FLOAT, 0.5f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, ATTR_CACHE_DEGREES, 5.0f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_2MIN_ID, ATTR_CACHE_DEGREES, 5.0f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_10MIN_ID, ATTR_CACHE_DEGREES, 5.0f },
+    { HA_ESP_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT, ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID, ATTR_CACHE_U16, 100.0f },
+};
+
+/* Same snapshot fields as esp_zb_weather.c */
+static const telemetry_field_def_t telemetry_table[] = {
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 0.1f },           // 0.1 °C
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID, TELEMETRY_U16, 0.1f }, // 0.1 %RH
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 1.0f },    // 0.1 hPa
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0020, TELEMETRY_U8, 1.0f },                                                     // 0.1 V
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0021, TELEMETRY_U8, 1.0f },                                                     // 0.5 %
+    { HA_ESP_RAIN_GAUGE_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, TELEMETRY_U32, 100.0f },         // 0.01 mm
+    { HA_ESP_DS18B20_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 0.1f },              // 0.1 °C
+    { HA_ESP_DS18B20_PROBE2_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 0.1f },
+    { HA_ESP_DS18B20_PROBE3_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 0.1f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, TELEMETRY_U16, 10.0f },          // 0.1 m/s
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_GUST_ID, TELEMETRY_U16, 10.0f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_2MIN_ID, TELEMETRY_U16, 10.0f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_10MIN_ID, TELEMETRY_U16, 10.0f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, TELEMETRY_U16, 1.0f },             // 1°
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_2MIN_ID, TELEMETRY_U16, 1.0f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_10MIN_ID, TELEMETRY_U16, 1.0f },
+    { HA_ESP_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT, ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID, TELEMETRY_U16, 1.0f }, // MeasuredValue
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, PRESSURE_ATTR_TENDENCY_3H_ID, TELEMETRY_S16, 1.0f },                   // 0.1 hPa / 3 h
+};
+
+static void acquisition_start(uint8_t mask);
+static void acquisition_collect(uint8_t param);
+static void schedule_next_reading(void);
+static void cadence_tick(uint8_t param);
+static void cadence_arm_timer(void);
+
+static bool zigbee_is_connected(void)
+{
+    return zigbee_network_connected;
+}
+
+static void env_read_and_report(uint8_t param)
+{
+    (void)param;
+    float temperature = 0.0f, humidity = 0.0f, pressure = 0.0f;
+    if (sensor_collect_measurement() != ESP_OK) {
+        ESP_LOGW(TAG, "sensor_collect_measurement() failed - reporting cached values");
+    }
+    if (sensor_read_temperature(&temperature) == ESP_OK) {
+        int16_t temp_centidegrees = (int16_t)(temperature * 100);
+        attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
+                       ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &temp_centidegrees);
+    }
+    if (sensor_read_humidity(&humidity) == ESP_OK) {
+        uint16_t hum_centipercent = (uint16_t)(humidity * 100);
+        attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
+                       ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID, &hum_centipercent);
+    }
+    if (sensor_read_pressure(&pressure) == ESP_OK) {
+        int16_t pressure_zigbee = (int16_t)(pressure * 10);
+        attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT,
+                       ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID, &pressure_zigbee);
+        pressure_tendency_add(pressure);
+        pressure_trend_hpa_h = pressure_tendency_rate_hpa_h(PRESSURE_TREND_SPAN_S);
+        float tendency = pressure_tendency_3h();
+        if (!isnan(tendency)) {
+            int16_t tendency_zigbee = (int16_t)lroundf(tendency * 10.0f);
+            attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT,
+                           PRESSURE_ATTR_TENDENCY_3H_ID, &tendency_zigbee);
+        }
+    }
+}
+
+static void wind_speed_read_and_report(uint8_t param)
+{
+    (void)param;
+    float speed_ms = 0.0f;
+    wind_stats_t stats;
+    bool have_stats = false;
+
+    if (wind_stats_running()) {
+        if (wind_stats_take_report(&stats) != ESP_OK) return;
+        speed_ms = stats.mean_since_report_ms;
+        sched_wind_gust_excess_ms = stats.gust_ms - stats.avg_10min_ms;
+        have_stats = true;
+    } else if (anemometer_get_wind_speed(&speed_ms) != ESP_OK) {
+        return;
+    }
+    attr_cache_set(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                   ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, &speed_ms);
+    if (have_stats) {
+        attr_cache_set(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_GUST_ID, &stats.gust_ms);
+        attr_cache_set(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_2MIN_ID, &stats.avg_2min_ms);
+        attr_cache_set(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_10MIN_ID, &stats.avg_10min_ms);
+        ESP_LOGI(TAG, "💨 Wind speed: %.2f m/s, gust %.2f, 2min %.2f, 10min %.2f m/s",
+                 speed_ms, stats.gust_ms, stats.avg_2min_ms, stats.avg_10min_ms);
+    }
+}
+
+static void wind_dir_read_and_report(uint8_t param)
+{
+    (void)param;
+    if (!as5600_available) return;
+
+    bool magnet_ok = false;
+    if (as5600_check_magnet(&magnet_ok) != ESP_OK || !magnet_ok) {
+        as5600_magnet_ok = false;
+        return;
+    }
+    as5600_magnet_ok = true;
+
+    float direction = 0.0f, spread = 0.0f;
+    if (as5600_read_direction_burst(WIND_DIR_BURST_SAMPLES, WIND_DIR_BURST_INTERVAL_MS, &direction, &spread) != ESP_OK) {
+        return;
+    }
+    float delta = fabsf(direction - wind_dir_held);
+    if (delta > 180.0f) delta = 360.0f - delta;
+    if (wind_dir_held < 0 || delta >= WIND_DIR_HYSTERESIS_DEG) {
+        wind_dir_held = direction;
+    }
+    attr_cache_set(HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                   ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, &wind_dir_held);
+
+    wind_stats_t stats;
+    if (wind_stats_get(&stats) == ESP_OK && stats.dir_valid) {
+        attr_cache_set(HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_2MIN_ID, &stats.dir_2min_deg);
+        attr_cache_set(HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_10MIN_ID, &stats.dir_10min_deg);
+    }
+}
+
+static void light_read_and_report(uint8_t param)
+{
+    if (!veml7700_available) return;
+    if (param > 0) i2c_buses_acquire(I2C_BUS2_MASK);
+    float lux = 0.0f;
+    esp_err_t ret = veml7700_read_lux(&lux);
+    if (ret == ESP_ERR_NOT_FINISHED && param == 0) {
+        uint32_t light_ms = 0;
+        if (veml7700_start_measurement(&light_ms) == ESP_OK) {
+            esp_zb_scheduler_alarm((esp_zb_callback_t)light_read_and_report, 1, light_ms);
+            return;
+        }
+    } else if (ret != ESP_OK && ret != ESP_ERR_NOT_FINISHED) {
+        if (param > 0) i2c_buses_release(I2C_BUS2_MASK);
+        return;
+    }
+#if VEML7700_SHUTDOWN_BETWEEN_READS
+    veml7700_power_down();
+#endif
+    if (param > 0) i2c_buses_release(I2C_BUS2_MASK);
+    uint16_t measured = 0;
+    if (lux > 0.0f) {
+        float val = 10000.0f * log10f(lux) + 1.0f;
+        if (val < 1.0f) val = 1.0f;
+        if (val > 65534.0f) val = 65534.0f;
+        measured = (uint16_t)val;
+    }
+    attr_cache_set(HA_ESP_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT,
+                   ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID, &measured);
+    if (param > 0) {
+        attr_cache_flush(false);
+    }
+}
+
+/* The glitch guard without its ADC-recovery reboot (resets are not modelled) */
+static void battery_read_and_report(uint8_t param)
+{
+    (void)param;
+    battery_estimate_t estimate = battery_estimate;
+    power_profile_t profile;
+    power_profiler_get(&profile);
+    int64_t since_read_us = battery_last_read_us < 0 ? 0 : esp_timer_get_time() - battery_last_read_us;
+    battery_estimate_predict(&estimate, profile.charge_uah, (uint32_t)(since_read_us / 1000000LL));
+
+    bool quick = battery_estimate_quick_ok(&estimate);
+    uint16_t battery_mv = 0;
+    esp_err_t err = quick ? battery_read_voltage_quick(&battery_mv) : battery_read_voltage(&battery_mv);
+    if (err == ESP_OK && quick &&
+        battery_estimate_innovation(&estimate, battery_load_compensate(battery_mv, POWER_MODEL_ACTIVE_UA),
+                                    BATTERY_EST_QUICK_NOISE_MV) > BATTERY_EST_GATE_SIGMA) {
+        quick = false;
+        err = battery_read_voltage(&battery_mv);
+    }
+    float battery_voltage = err == ESP_OK ? battery_mv / 1000.0f : 3.7f;
+
+    uint16_t diag_raw = battery_get_last_raw_adc();
+    uint16_t diag_div_mv = battery_get_last_divider_mv();
+    uint8_t diag_cal = battery_get_last_calibrated() ? 1 : 0;
+    uint16_t diag_uptime_min = (uint16_t)((esp_timer_get_time() / 1000000ULL) / 60ULL);
+    uint16_t diag_reboots = 0;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4000, &diag_raw);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4001, &diag_div_mv);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4002, &diag_cal);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4003, &diag_uptime_min);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4004, &diag_reboots);
+
+    uint16_t measured_mv = (uint16_t)(battery_voltage * 1000.0f);
+    if (battery_last_good_mv != 0 && measured_mv + 500 < battery_last_good_mv && ++battery_drop_confirm < 2) {
+        return;
+    }
+    battery_drop_confirm = 0;
+    battery_last_good_mv = measured_mv;
+
+    if (err == ESP_OK) {
+        uint16_t ocv_mv = battery_estimate_update(&estimate, battery_load_compensate(battery_mv, POWER_MODEL_ACTIVE_UA),
+                                                  quick ? BATTERY_EST_QUICK_NOISE_MV : BATTERY_EST_FULL_NOISE_MV);
+        battery_estimate = estimate;
+        battery_voltage = ocv_mv / 1000.0f;
+    }
+    battery_last_read_us = esp_timer_get_time();
+
+    uint8_t pct = battery_voltage_to_percentage((uint16_t)(battery_voltage * 1000.0f));
+    uint8_t zigbee_voltage = (uint8_t)(battery_voltage * 10.0f);
+    uint8_t zigbee_percentage = (uint8_t)(pct * 2);
+    if (++battery_reads_since_checkpoint >= BATTERY_NVS_CHECKPOINT_READS) {
+        nvs_handle_t nvs_handle;
+        if (nvs_open("storage", NVS_READWRITE, &nvs_handle) == ESP_OK) {
+            float percentage = (float)pct;
+            nvs_set_u8(nvs_handle, "batt_zb_v", zigbee_voltage);
+            nvs_set_u8(nvs_handle, "batt_zb_p", zigbee_percentage);
+            nvs_set_blob(nvs_handle, "batt_v", &battery_voltage, sizeof(float));
+            nvs_set_blob(nvs_handle, "batt_pct", &percentage, sizeof(float));
+            nvs_set_u32(nvs_handle, "batt_reboots", 0);
+            nvs_commit(nvs_handle);
+            nvs_close(nvs_handle);
+        }
+        battery_reads_since_checkpoint = 0;
+    }
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0020, &zigbee_voltage);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0021, &zigbee_percentage);
+}
+
+static void power_profile_publish(void)
+{
+    power_profile_t profile;
+    power_profiler_get(&profile);
+    float awake_s = profile.awake_us / 1e6f;
+    float sleep_s = profile.sleep_us / 1e6f;
+    float radio_s = profile.radio_us / 1e6f;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_AWAKE_ID, &awake_s);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_SLEEP_ID, &sleep_s);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_SLEEPS_ID, &profile.sleeps);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_TX_ID, &profile.tx_frames);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_RADIO_ID, &radio_s);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_CHARGE_ID, &profile.charge_uah);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_CURRENT_ID, &profile.average_ua);
+
+    uint8_t causes[3 + 4 * POWER_CAUSE_COUNT];
+    if (power_profiler_encode_causes(causes, sizeof(causes)) > 0) {
+        esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                     DIAG_ATTR_POWER_CAUSES_ID, causes, false);
+    }
+}
+
+static void acquisition_start(uint8_t mask)
+{
+    if (acq_in_flight || !drivers_ready) {
+        acq_deferred_mask |= mask;
+        return;
+    }
+
+    uint32_t ready_ms = 0;
+    acq_started_us = esp_timer_get_time();
+    power_profiler_begin(POWER_CAUSE_ACQUISITION);
+
+    acq_i2c_mask = ((mask & ACQ_CH_ENV) ? I2C_BUS1_MASK : 0) |
+                   ((mask & (ACQ_CH_WIND_DIR | ACQ_CH_LIGHT)) ? I2C_BUS2_MASK : 0);
+    if (acq_i2c_mask) i2c_buses_acquire(acq_i2c_mask);
+
+    if (mask & ACQ_CH_ENV) {
+        uint32_t env_ms = 0;
+        if (sensor_start_measurement(&env_ms) == ESP_OK && env_ms > ready_ms) ready_ms = env_ms;
+    }
+    mask &= ~ACQ_CH_DS18B20;        // no 1-Wire model
+    if (mask & ACQ_CH_BATTERY) {
+        if (battery_prepare_measurement() == ESP_OK && BATTERY_SETTLE_TIME_MS > ready_ms) {
+            ready_ms = BATTERY_SETTLE_TIME_MS;
+        }
+        int64_t last_tx_us = power_profiler_last_tx_us();
+        if (last_tx_us >= 0) {
+            int64_t quiet_ms = ((last_tx_us - acq_started_us) / 1000) + BATTERY_RADIO_QUIET_MS;
+            if (quiet_ms > (int64_t)ready_ms) ready_ms = (uint32_t)quiet_ms;
+        }
+    }
+    if (mask & ACQ_CH_RAIN) {
+        rain_gauge_request_flush(false, true);
+    }
+    if ((mask & ACQ_CH_LIGHT) && veml7700_available) {
+        uint32_t light_ms = 0;
+        veml7700_start_measurement(&light_ms);
+        if (light_ms > ready_ms) ready_ms = light_ms;
+    }
+
+    acq_in_flight = true;
+    acq_active_mask = mask;
+    esp_zb_scheduler_alarm((esp_zb_callback_t)acquisition_collect, 0, ready_ms);
+    power_profiler_end(POWER_CAUSE_ACQUISITION);
+}
+
+static void acquisition_run(power_cause_t cause, void (*read_and_report)(uint8_t))
+{
+    power_profiler_begin(cause);
+    read_and_report(0);
+    power_profiler_end(cause);
+}
+
+static uint64_t wind_dir_job_us = 0;
+
+static void acquisition_wind_dir_job(void *arg)
+{
+    (void)arg;
+    int64_t start_us = esp_timer_get_time();
+    wind_dir_read_and_report(0);
+    wind_dir_job_us += (uint64_t)(esp_timer_get_time() - start_us);
+}
+
+static void acquisition_collect(uint8_t param)
+{
+    (void)param;
+    uint8_t mask = acq_active_mask;
+
+    bool dir_job = false;
+    if (mask & ACQ_CH_WIND_DIR) {
+        esp_err_t ret = i2c_bus_job_start(i2c_bus2, acquisition_wind_dir_job, NULL);
+        if (ret == ESP_OK) dir_job = true;
+        else if (ret != ESP_ERR_INVALID_STATE) acquisition_run(POWER_CAUSE_WIND_DIR, wind_dir_read_and_report);
+    }
+    if (mask & ACQ_CH_ENV)        acquisition_run(POWER_CAUSE_ENV, env_read_and_report);
+    if (mask & ACQ_CH_WIND_SPEED) acquisition_run(POWER_CAUSE_WIND_SPEED, wind_speed_read_and_report);
+    if (mask & ACQ_CH_LIGHT)      acquisition_run(POWER_CAUSE_LIGHT, light_read_and_report);
+    if (mask & ACQ_CH_BATTERY)    acquisition_run(POWER_CAUSE_BATTERY, battery_read_and_report);
+    if (dir_job && i2c_bus_job_wait(i2c_bus2, WIND_DIR_JOB_TIMEOUT_MS) == ESP_OK) {
+        power_profiler_add(POWER_CAUSE_WIND_DIR, wind_dir_job_us, false);
+        wind_dir_job_us = 0;
+    }
+    power_profiler_begin(POWER_CAUSE_ACQUISITION);
+    i2c_buses_release(acq_i2c_mask);
+    acq_i2c_mask = 0;
+
+    uint32_t awake_ms = (uint32_t)((esp_timer_get_time() - acq_started_us) / 1000LL);
+    uint16_t awake_attr = awake_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)awake_ms;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, ACQ_AWAKE_ATTR_ID, &awake_attr);
+
+    if (mask & ACQ_CH_WIND_SPEED) {
+        schedule_next_reading();
+    }
+    if (mask & ACQ_CH_BATTERY) {
+        power_profile_publish();
+    }
+    attr_cache_flush(false);
+    power_profiler_end(POWER_CAUSE_ACQUISITION);
+
+    acq_in_flight = false;
+    acq_active_mask = 0;
+    if (acq_deferred_mask) {
+        uint8_t deferred = acq_deferred_mask;
+        acq_deferred_mask = 0;
+        esp_zb_scheduler_alarm((esp_zb_callback_t)acquisition_start, deferred, 0);
+    }
+}
+
+static void schedule_next_reading(void)
+{
+    weather_activity_t activity = {
+        .rain_mm = sched_last_rain_mm < 0.0f ? 0.0f : rain_gauge_total_mm() - sched_last_rain_mm,
+        .wind_gust_excess_ms = sched_wind_gust_excess_ms,
+        .wind_dir_shift_deg = 0.0f,
+        .pressure_trend_hpa_h = pressure_trend_hpa_h,
+        .battery_percent = battery_get_zigbee_voltage() ? battery_get_zigbee_percentage() / 2 : 0xFF,
+    };
+    sched_last_rain_mm = rain_gauge_total_mm();
+
+    wind_stats_t stats;
+    if (wind_stats_get(&stats) == ESP_OK && stats.dir_valid && stats.avg_2min_ms > 0.0f) {
+        float shift = fabsf(stats.dir_2min_deg - stats.dir_10min_deg);
+        activity.wind_dir_shift_deg = shift > 180.0f ? 360.0f - shift : shift;
+    }
+
+    sched_interval_s = get_adaptive_sleep_duration(&activity, &sched_cfg);
+    uint16_t interval_attr = sched_interval_s > UINT16_MAX ? UINT16_MAX : (uint16_t)sched_interval_s;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, SCHED_ATTR_INTERVAL_ID, &interval_attr);
+
+    channel_sched_set_period(ACQ_CH_FAST, sched_interval_s);
+    cadence_arm_timer();
+}
+
+static void cadence_tick(uint8_t param)
+{
+    (void)param;
+    uint8_t mask = channel_sched_take_due(esp_timer_get_time(), CADENCE_COALESCE_S);
+    if (mask) {
+        acquisition_start(mask);
+    }
+    cadence_arm_timer();
+}
+
+static void cadence_arm_timer(void)
+{
+    if (periodic_report_timer == NULL) return;
+    int64_t wake_us = channel_sched_next_wake_us();
+    if (wake_us == INT64_MAX) return;
+    int64_t delay_us = wake_us - esp_timer_get_time();
+    if (delay_us < 1000) delay_us = 1000;
+    esp_timer_stop(periodic_report_timer);
+    esp_timer_start_once(periodic_report_timer, (uint64_t)delay_us);
+}
+
+static void periodic_sensor_report_callback(void *arg)
+{
+    (void)arg;
+    esp_zb_lock_acquire(portMAX_DELAY);
+    esp_zb_scheduler_alarm((esp_zb_callback_t)cadence_tick, 0, 0);
+    esp_zb_lock_release();
+}
+
+static void start_periodic_reading(void)
+{
+    const esp_timer_create_args_t periodic_timer_args = {
+        .callback = &periodic_sensor_report_callback,
+        .name = "periodic_read"
+    };
+    if (esp_timer_create(&periodic_timer_args, &periodic_report_timer) != ESP_OK) return;
+    channel_sched_start(esp_timer_get_time());
+    cadence_arm_timer();
+}
+
+static void rain_gauge_init_task(void *arg)
+{
+    (void)arg;
+    rain_gauge_init(zigbee_is_connected);
+    vTaskDelete(NULL);
+}
+
+static bool i2c_addr_present(const uint8_t *list, int count, uint8_t addr)
+{
+    for (int i = 0; i < count; ++i) {
+        if (list[i] == addr) return true;
+    }
+    return false;
+}
+
+static void bus2_init_job(void *arg)
+{
+    const hw_inventory_t *inv = arg;
+    i2c_bus_handle_t i2c_bus2 = i2c_get_bus2();
+    if (i2c_addr_present(inv->bus_addrs[1], inv->bus_count[1], AS5600_I2C_ADDR) && as5600_init(i2c_bus2) == ESP_OK) {
+        as5600_available = true;
+        as5600_configure((as5600_power_mode_t)AS5600_IDLE_POWER_MODE, (as5600_slow_filter_t)AS5600_SLOW_FILTER);
+    }
+    if (i2c_addr_present(inv->bus_addrs[1], inv->bus_count[1], VEML7700_I2C_ADDR) && veml7700_init(i2c_bus2) == ESP_OK) {
+        veml7700_available = true;
+        veml7700_set_auto_range(VEML7700_AUTO_RANGE);
+#if !VEML7700_SHUTDOWN_BETWEEN_READS
+        veml7700_set_power_saving(true);
+#endif
+    }
+}
+
+/* driver_init_task() without the DS18B20 and the background re-probe: the
+ * sim runs one boot from an empty NVS, so the inventory is always scanned */
+static void driver_init_task(void *arg)
+{
+    (void)arg;
+    bool cached = HW_INVENTORY_CACHE_ENABLED && hw_inventory_load(&hw_inventory) == ESP_OK;
+    if (!cached) {
+        uint8_t found[32];
+        memset(&hw_inventory, 0, sizeof(hw_inventory));
+        int count = i2c_bus_scan(i2c_get_bus1(), found, sizeof(found));
+        hw_inventory_set_bus(&hw_inventory, 0, found, count);
+        count = i2c_bus_scan(i2c_get_bus2(), found, sizeof(found));
+        hw_inventory_set_bus(&hw_inventory, 1, found, count);
+        hw_inventory.env_drivers = SENSOR_DRIVERS_ALL;
+    }
+
+    bool bus2_job = i2c_bus_job_start(i2c_get_bus2(), bus2_init_job, &hw_inventory) == ESP_OK;
+    if (!bus2_job) bus2_init_job(&hw_inventory);
+
+    if (sensor_init_from_scan(i2c_get_bus1(), hw_inventory.bus_addrs[0], hw_inventory.bus_count[0],
+                              hw_inventory.env_drivers) != ESP_OK) {
+        ESP_LOGW(TAG, "No environmental sensor found on Bus 1");
+    }
+#if CONFIG_CAELUM_PRESSURE_FIFO
+    else if (sensor_get_source_name(SENSOR_QTY_PRESSURE)) {
+        sensor_start_background(SENSOR_QTY_PRESSURE);
+    }
+#endif
+    hw_inventory.env_drivers = sensor_get_present_mask();
+
+    bool anemometer_ok = anemometer_init() == ESP_OK;
+    battery_monitor_init();
+    if (bus2_job) i2c_bus_job_wait(i2c_get_bus2(), DRIVER_INIT_BUS2_TIMEOUT_MS);
+    if (anemometer_ok && wind_stats_start(as5600_available) != ESP_OK) {
+        ESP_LOGW(TAG, "Wind statistics sampler not started");
+    }
+    i2c_buses_release(I2C_BUS_ALL_MASK);
+    hw_inventory_store(&hw_inventory);
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    drivers_ready = true;
+    if (acq_deferred_mask) {
+        uint8_t deferred = acq_deferred_mask;
+        acq_deferred_mask = 0;
+        esp_zb_scheduler_alarm((esp_zb_callback_t)acquisition_start, deferred, 0);
+    }
+    esp_zb_lock_release();
+    vTaskDelete(NULL);
+}
+
+static void deferred_driver_init(void)
+{
+    if (i2c_buses_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize I2C buses");
+        return;
+    }
+    xTaskCreate(rain_gauge_init_task, "rain_init", 4096, NULL, 4, NULL);
+    xTaskCreate(driver_init_task, "drv_init", 4096, NULL, 4, NULL);
+}
+
+/* Local reporting of one cached attribute: on change of its deadband and
+ * hourly, or off (max interval 0xFFFF) while the telemetry snapshot carries it
+ * instead. Same context rules as configure_present_value_reporting(). */
+static void configure_local_reporting(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id)
+{
+    attr_cache_def_t def;
+    if (!attr_cache_get_def(endpoint, cluster_id, attr_id, &def)) return;     // channel not on this board
+
+    /* Reportable change in the attribute's own type */
+    union {
+        uint8_t u8;
+        uint16_t u16;
+        uint32_t u32;
+        int16_t s16;
+        float f;
+    } change;
+    uint8_t attr_type;
+    switch (def.type) {
+        case ATTR_CACHE_U8:  change.u8 = (uint8_t)def.deadband;   attr_type = ESP_ZB_ZCL_ATTR_TYPE_U8;  break;
+        case ATTR_CACHE_U16: change.u16 = (uint16_t)def.deadband; attr_type = ESP_ZB_ZCL_ATTR_TYPE_U16; break;
+        case ATTR_CACHE_U32: change.u32 = (uint32_t)def.deadband; attr_type = ESP_ZB_ZCL_ATTR_TYPE_U32; break;
+        case ATTR_CACHE_S16: change.s16 = (int16_t)def.deadband;  attr_type = ESP_ZB_ZCL_ATTR_TYPE_S16; break;
+        default:             change.f = def.deadband;             attr_type = ESP_ZB_ZCL_ATTR_TYPE_SINGLE; break;
+    }
+    bool off = telemetry_get_mode() == TELEMETRY_MODE_SNAPSHOT && telemetry_covers(endpoint, cluster_id, attr_id);
+
+    esp_zb_zcl_config_report_cmd_t cmd = {0};
+    cmd.zcl_basic_cmd.dst_addr_u.addr_short = esp_zb_get_short_address();  // Send to self
+    cmd.zcl_basic_cmd.dst_endpoint = endpoint;
+    cmd.zcl_basic_cmd.src_endpoint = endpoint;
+    cmd.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
+    cmd.clusterID = cluster_id;
+
+    esp_zb_zcl_config_report_record_t record = {
+        .direction = ESP_ZB_ZCL_REPORT_DIRECTION_SEND,
+        .attributeID = attr_id,
+        .attrType = attr_type,
+        .min_interval = 0,                      // No minimum interval - report immediately on change
+        .max_interval = off ? 0xFFFF : 3600,    // Report at least every hour even if no change; 0xFFFF = never
+        .reportable_change = &change,
+    };
+    cmd.record_number = 1;
+    cmd.record_field = &record;
+
+    esp_zb_zcl_config_report_cmd_req(&cmd);
+    if (off) {
+        ESP_LOGD(TAG, "📋 EP%u 0x%04x/0x%04x reporting off (in the telemetry snapshot)", endpoint, cluster_id, attr_id);
+    } else {
+        ESP_LOGI(TAG, "📋 EP%u 0x%04x/0x%04x reporting configured: change=%.2f, max_interval=3600s",
+                 endpoint, cluster_id, attr_id, def.deadband);
+    }
+}
+
+/* Reporting of every attribute the snapshot carries, for the current mode */
+static void telemetry_apply_reporting(void)
+{
+    for (size_t i = 0; i < sizeof(telemetry_table) / sizeof(telemetry_table[0]); i++) {
+        configure_local_reporting(telemetry_table[i].endpoint, telemetry_table[i].cluster_id, telemetry_table[i].attr_id);
+    }
+    ESP_LOGI(TAG, "📦 Telemetry mode %d: standard reports %s", telemetry_get_mode(),
+             telemetry_get_mode() == TELEMETRY_MODE_SNAPSHOT ? "off, one snapshot frame per cycle" : "on");
+}
+
+/* Send the telemetry snapshot to the coordinator if one is due; true if sent */
+static bool telemetry_publish(void)
+{
+    uint8_t snapshot[1 + TELEMETRY_MAX_BYTES];      // ZCL octet string: length byte + data
+    size_t len = telemetry_build(snapshot, sizeof(snapshot));
+    if (len == 0) return false;
+
+    esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, TELEMETRY_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 TELEMETRY_ATTR_SNAPSHOT_ID, snapshot, false);
+    esp_zb_zcl_report_attr_cmd_t cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,        // coordinator
+            .dst_endpoint = 1,
+            .src_endpoint = HA_ESP_ENV_SENSOR_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = TELEMETRY_CLUSTER_ID,
+        .attributeID = TELEMETRY_ATTR_SNAPSHOT_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
+    };
+    esp_zb_zcl_report_attr_cmd_req(&cmd);
+    ESP_LOGD(TAG, "📦 Telemetry snapshot sent (%u bytes)", (unsigned)(len - 1));
+    return true;
+}
+
+/* After every attribute flush: the snapshot if one is due, and the APS ACK
+ * poll window when any report goes out (the writes the snapshot replaces do
+ * not report) */
+static void attr_cache_flushed(const attr_cache_def_t *written, int count)
+{
+    bool reports = false;
+    bool snapshot_only = telemetry_get_mode() == TELEMETRY_MODE_SNAPSHOT;
+    for (int i = 0; i < count && !reports; i++) {
+        reports = !snapshot_only || !telemetry_covers(written[i].endpoint, written[i].cluster_id, written[i].attr_id);
+    }
+    if (zigbee_network_connected && telemetry_publish()) reports = true;
+    /* The reports go out now; their APS ACKs come back through the parent */
+    if (reports) poll_control_open(POLL_WINDOW_APS_ACK);
+}
+
+/* configure_analog_input_reporting() without the binds */
+static void configure_analog_input_reporting(uint8_t param)
+{
+    (void)param;
+    telemetry_apply_reporting();
+}
+
+/* BDB steering succeeded: what esp_zb_app_signal_handler() does on a join */
+static void network_joined(uint8_t param)
+{
+    (void)param;
+    deferred_driver_init();
+    zigbee_network_connected = true;
+    poll_control_open(POLL_WINDOW_JOIN);
+    rain_gauge_enable();
+    esp_zb_scheduler_alarm((esp_zb_callback_t)acquisition_start, ACQ_CH_ALL, 2000);
+    start_periodic_reading();
+    esp_zb_scheduler_alarm(configure_analog_input_reporting, 0, 1000);
+    power_profiler_sleep_blocked(POWER_CAUSE_JOIN_CONFIG);
+}
+
+/* The TX accounting of aps_data_confirm_cb() is done by the mock */
+static void aps_data_confirm_cb(esp_zb_apsde_data_confirm_t confirm)
+{
+    (void)confirm;
+    poll_control_traffic(POLL_WINDOW_APS_ACK);
+}
+
+static bool aps_data_indication_cb(esp_zb_apsde_data_ind_t ind)
+{
+    poll_control_frame_received(ind.dst_endpoint == 0 ? 0 : ind.cluster_id);
+    return false;
+}
+
+void pipeline_app_main(void)
+{
+    power_profiler_init();
+    nvs_flash_init();
+    rain_log_init();
+    attr_cache_init(attr_cache_table, sizeof(attr_cache_table) / sizeof(attr_cache_table[0]));
+    telemetry_init(telemetry_table, sizeof(telemetry_table) / sizeof(telemetry_table[0]),
+                   TELEMETRY_HEARTBEAT_S, (telemetry_mode_t)TELEMETRY_DEFAULT_MODE);
+    attr_cache_set_flush_cb(attr_cache_flushed);
+    pressure_tendency_init();
+    channel_sched_init(cadence_table, sizeof(cadence_table) / sizeof(cadence_table[0]));
+    channel_sched_set_period(ACQ_CH_FAST, sched_interval_s);
+    rain_gauge_load();
+    const poll_control_config_t poll_cfg = {
+        .long_interval_ms = POLL_LONG_INTERVAL_MS,
+        .fast_interval_ms = POLL_FAST_INTERVAL_MS,
+        .windows = {
+            [POLL_WINDOW_JOIN] = { POLL_JOIN_FIRST_MS, POLL_JOIN_QUIET_MS, INITIAL_CONFIG_DELAY_SEC * 1000 },
+            [POLL_WINDOW_CONFIG] = { POLL_CONFIG_QUIET_MS, POLL_CONFIG_QUIET_MS, POLL_CONFIG_MAX_MS },
+            [POLL_WINDOW_OTA] = { POLL_OTA_QUIET_MS, POLL_OTA_QUIET_MS, 0 },
+            [POLL_WINDOW_APS_ACK] = { POLL_APS_ACK_FIRST_MS, POLL_APS_ACK_QUIET_MS, POLL_APS_ACK_MAX_MS },
+        },
+    };
+    poll_control_init(&poll_cfg);
+    esp_zb_aps_data_confirm_handler_register(aps_data_confirm_cb);
+    esp_zb_aps_data_indication_handler_register(aps_data_indication_cb);
+    sim_zigbee_start();
+    esp_zb_scheduler_alarm(network_joined, 0, 0);
+}
+
+bool pipeline_can_sleep(void)
+{
+    if (poll_control_is_open(POLL_WINDOW_JOIN)) {
+        power_profiler_sleep_blocked(POWER_CAUSE_JOIN_CONFIG);
+        return false;
+    }
+    power_profiler_sleep_enter();
+    return true;
+}
+
+void pipeline_woke(void)
+{
+    power_profiler_sleep_exit();
+}
@@ -0,0 +1,143 @@
+/*
+ * Host simulation of the reporting pipeline
+ * Internal interface between the virtual-time kernel, the ESP-IDF/Zigbee mocks,
+ * the device models, the trace and the firmware glue. Time is virtual and in
+ * microseconds; nothing here depends on the host clock, so a run is
+ * reproducible bit for bit.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Cost model: awake time charged for work the mocks stand in for */
+#define SIM_TICK_US                 1000                /* FreeRTOS tick (CONFIG_FREERTOS_HZ 1000) */
+#define SIM_IDLE_BEFORE_SLEEP_US    3000                /* CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP */
+#define SIM_WAKE_OVERHEAD_US        400                 /* light-sleep exit + entry, clocks and regulators */
+#define SIM_KEEP_ALIVE_US           7500000LL           /* parent poll period until esp_zb_zdo_pim_set_long_poll_interval() */
+#define SIM_PARENT_HOLD_US          7680000LL           /* macTransactionPersistenceTime: parent drops a frame not polled for */
+#define SIM_ACK_RTT_US              20000               /* report sent to its APS ACK waiting at the parent */
+#define SIM_INTERVIEW_DELAY_US      2000000LL           /* join to the coordinator's first interview frame */
+#define SIM_INTERVIEW_FRAMES        12                  /* binds and Configure Reporting of the interview */
+#define SIM_COORD_TURNAROUND_US     50000               /* our response to the coordinator's next frame at the parent */
+#define SIM_ISR_US                  5                   /* one GPIO ISR */
+#define SIM_ADC_READ_US             20                  /* one oneshot conversion */
+#define SIM_I2C_OVERHEAD_US         30                  /* driver call, start/stop, address byte */
+#define SIM_I2C_BUS_CREATE_US       150                 /* i2c_bus_create: controller, pins, ISR, mutex */
+#define SIM_I2C_DEVICE_CREATE_US    10                  /* i2c_bus_device_create */
+#define SIM_NVS_WRITE_US            1000                /* one NVS entry written to flash */
+#define SIM_FLASH_WRITE_US(len)     (40 + (len) / 4)    /* program a few words */
+#define SIM_FLASH_ERASE_US          45000               /* erase one 4 KB sector */
+#define SIM_HEARTBEAT_US            3600000000LL        /* ZCL max reporting interval of every cluster */
+
+typedef enum {
+    SIM_ISR_IN_SLEEP_KEPT,          /* GPIO edges in light sleep still reach the ISR */
+    SIM_ISR_IN_SLEEP_LOST,          /* edges that do not wake the chip are dropped */
+} sim_isr_policy_t;
+
+/* Ground-truth counters of one run (next to the firmware's own profiler) */
+typedef struct {
+    uint32_t wakes;                 /* light-sleep exits */
+    uint32_t polls;                 /* data requests to the parent, keep-alive and fast */
+    uint32_t frames_lost;           /* frames for us the parent dropped before a poll */
+    uint32_t attr_updates;          /* esp_zb_zcl_set_attribute_val() calls */
+    uint32_t reports;               /* report frames sent */
+    uint32_t nvs_writes;            /* NVS sets that changed stored data */
+    uint32_t nvs_commits;
+    uint32_t flash_writes;          /* raw partition program calls */
+    uint32_t flash_erases;          /* raw partition sectors erased */
+    uint32_t i2c_transfers;
+    uint32_t i2c_bus_creates;       /* i2c_bus_create() calls, boot and rebuilds */
+    uint32_t isr_edges_in_sleep;    /* edges delivered to an ISR while asleep (at risk on hardware) */
+    uint32_t isr_edges_lost;        /* edges dropped by SIM_ISR_IN_SLEEP_LOST */
+    uint32_t tips_expected;         /* tips in the trace up to the end of the run */
+    uint32_t anemometer_pulses;     /* anemometer pulses generated by the trace */
+} sim_stats_t;
+
+extern sim_stats_t g_sim_stats;
+extern int g_sim_log_level;         /* esp_log_level_t printed to stderr (sim_idf.c) */
+
+/* ---- kernel (sim_kernel.c) ---- */
+
+int64_t sim_now_us(void);
+
+/**
+ * @brief Charge CPU time to the running context
+ *
+ * Edges that fall inside the interval are delivered at their own time, as
+ * interrupts preempting the work.
+ */
+void sim_busy_us(int64_t us);
+
+bool sim_asleep(void);
+void sim_pm_lock(bool acquire);
+
+/* Parent poll interval from now on; a pending poll further out is brought in */
+void sim_set_poll_interval_us(int64_t interval_us);
+
+/**
+ * @brief Run the simulation until end_us
+ *
+ * @param app_main Entry of the first task, like the IDF app_main
+ * @param end_us Virtual time to stop at
+ * @param policy What light sleep does to GPIO edges that do not wake the chip
+ */
+void sim_run(void (*app_main)(void), int64_t end_us, sim_isr_policy_t policy);
+
+/* Call cb (no wake, no cost) every period_us of virtual time, from the scheduler */
+void sim_set_sampler(int64_t period_us, void (*cb)(void));
+
+/* Block the running task until sim_wake_waiters(obj) or the deadline (INT64_MAX = none) */
+void sim_wait(const void *obj, int64_t deadline_us);
+void sim_wake_waiters(const void *obj);
+
+/* ---- hardware inputs (trace.c) ---- */
+
+typedef struct {
+    float temp_c;
+    float rh;
+    float pressure_hpa;
+    float lux;
+    float wind_ms;
+    float wind_dir_deg;
+    float battery_mv;
+} sim_env_t;
+
+bool trace_load(const char *path, int64_t end_us);
+void trace_env(int64_t t_us, sim_env_t *env);
+
+/* Time of the next pin transition, INT64_MAX if none */
+int64_t trace_next_edge_us(void);
+void trace_pop_edge(int *pin, int *level);
+int trace_initial_level(int pin);
+
+/* ---- GPIO (sim_idf.c) ---- */
+
+/* Apply a trace transition: PCNT counts, ISRs, the sleep policy */
+void sim_gpio_input(int pin, int level, bool asleep, sim_isr_policy_t policy);
+/* The pin is at a level armed with gpio_wakeup_enable() */
+bool sim_gpio_wake_pending(void);
+bool sim_gpio_is_wake_level(int pin, int level);
+
+/* ---- Zigbee (sim_zigbee.c) ---- */
+
+void sim_zigbee_start(void);
+/* A data request reached the parent: hand over what it holds for us (scheduler context) */
+void sim_zigbee_poll(void);
+
+/* ---- firmware glue (pipeline.c) ---- */
+
+void pipeline_app_main(void);
+/* ESP_ZB_COMMON_SIGNAL_CAN_SLEEP: true to sleep (profiler entered) */
+bool pipeline_can_sleep(void);
+/* esp_zb_sleep_now() returned */
+void pipeline_woke(void);
+
+#ifdef __cplusplus
+}
+#endif
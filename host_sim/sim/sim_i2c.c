@@ -0,0 +1,461 @@
+/*
+ * i2c_bus mock and register models of the default board:
+ * bus 1 SHT41 (0x44) + LPS22HB (0x5D), bus 2 AS5600 (0x36) + VEML7700 (0x10).
+ * Conversions latch the trace at their start and only become readable once
+ * their datasheet time has passed (the LPS22HB FIFO fills from the trace at
+ * its ODR), so a driver that reads too early sees what
+ * the chip would show (NACK, stale data, status not ready). Every transfer
+ * costs its bus time at the configured clock, every bus (re)build its setup.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "i2c_bus.h"
+#include "bme280.h"
+#include "sim.h"
+
+#define I2C_BITS_PER_BYTE       9
+#define I2C_SCAN_PROBE_US       120     // address byte, ACK and stop per probed address
+
+typedef struct sim_i2c_model sim_i2c_model_t;
+
+struct sim_i2c_model {
+    int port;
+    uint8_t addr;
+    esp_err_t (*read)(sim_i2c_model_t *m, uint8_t mem, size_t len, uint8_t *data);
+    esp_err_t (*write)(sim_i2c_model_t *m, uint8_t mem, size_t len, const uint8_t *data);
+    uint8_t regs[256];
+    int64_t ready_us;               // conversion result readable from here
+    bool pending;                   // conversion started and not read yet
+    uint8_t out[8];                 // latched result
+    int64_t start_us;               // VEML7700: integration start, LPS22HB: next FIFO sample
+    uint8_t fifo[32][5];            // LPS22HB: PRESS_OUT_XL..TEMP_OUT_H per level, oldest first
+    int fifo_level;
+    bool fifo_ovr;
+    int fifo_pos;                   // byte of the oldest sample the next output read returns
+};
+
+struct sim_i2c_bus {
+    int port;
+    uint32_t clk_hz;
+};
+
+struct sim_i2c_dev {
+    struct sim_i2c_bus *bus;
+    uint8_t addr;
+    sim_i2c_model_t *model;
+};
+
+/* ---- SHT41 ---- */
+
+static uint8_t sht_crc8(const uint8_t *data, int len)
+{
+    uint8_t crc = 0xFF;
+    for (int i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+static uint16_t clamp_u16(float v)
+{
+    if (v < 0.0f) return 0;
+    if (v > 65535.0f) return 65535;
+    return (uint16_t)lroundf(v);
+}
+
+static esp_err_t sht41_write(sim_i2c_model_t *m, uint8_t mem, size_t len, const uint8_t *data)
+{
+    if (mem != NULL_I2C_MEM_ADDR || len != 1) return ESP_FAIL;
+    int64_t measure_us;
+    switch (data[0]) {
+    case 0x94: m->pending = false; m->ready_us = sim_now_us() + 1000; return ESP_OK;   // soft reset
+    case 0xFD: measure_us = 8300; break;
+    case 0xF6: measure_us = 4500; break;
+    case 0xE0: measure_us = 1600; break;
+    default: return ESP_FAIL;
+    }
+    sim_env_t env;
+    trace_env(sim_now_us(), &env);
+    uint16_t t = clamp_u16((env.temp_c + 45.0f) * 65535.0f / 175.0f);
+    uint16_t rh = clamp_u16((env.rh + 6.0f) * 65535.0f / 125.0f);
+    m->out[0] = t >> 8;
+    m->out[1] = t & 0xFF;
+    m->out[2] = sht_crc8(&m->out[0], 2);
+    m->out[3] = rh >> 8;
+    m->out[4] = rh & 0xFF;
+    m->out[5] = sht_crc8(&m->out[3], 2);
+    m->pending = true;
+    m->ready_us = sim_now_us() + measure_us;
+    return ESP_OK;
+}
+
+static esp_err_t sht41_read(sim_i2c_model_t *m, uint8_t mem, size_t len, uint8_t *data)
+{
+    /* The read header is NACKed while converting and when there is no result */
+    if (mem != NULL_I2C_MEM_ADDR || len > 6 || !m->pending || sim_now_us() < m->ready_us) return ESP_FAIL;
+    memcpy(data, m->out, len);
+    m->pending = false;
+    return ESP_OK;
+}
+
+/* ---- LPS22HB ---- */
+
+#define LPS_ONE_SHOT_US         13000   // typical; the driver waits 15 ms
+
+#define LPS_FIFO_DEPTH          32
+
+static bool lps_fifo_running(const sim_i2c_model_t *m)
+{
+    return (m->regs[0x10] & 0x70) == 0x10 && (m->regs[0x11] & 0x40) && (m->regs[0x14] & 0xE0) == 0x40;
+}
+
+/* 1 Hz stream mode: one sample per elapsed second, the oldest dropped when full */
+static void lps_fifo_update(sim_i2c_model_t *m)
+{
+    if (!lps_fifo_running(m)) return;
+    for (; m->start_us <= sim_now_us(); m->start_us += 1000000) {
+        sim_env_t env;
+        trace_env(m->start_us, &env);
+        int32_t p = (int32_t)lroundf(env.pressure_hpa * 4096.0f);
+        int16_t t = (int16_t)lroundf(env.temp_c * 100.0f);
+        if (m->fifo_level == LPS_FIFO_DEPTH) {
+            memmove(m->fifo[0], m->fifo[1], sizeof(m->fifo[0]) * (LPS_FIFO_DEPTH - 1));
+            m->fifo_level--;
+            m->fifo_ovr = true;
+        }
+        uint8_t *s = m->fifo[m->fifo_level++];
+        s[0] = p & 0xFF;
+        s[1] = (p >> 8) & 0xFF;
+        s[2] = (p >> 16) & 0xFF;
+        s[3] = t & 0xFF;
+        s[4] = (t >> 8) & 0xFF;
+    }
+    m->regs[0x26] = (uint8_t)((m->fifo_ovr ? 0x40 : 0) | m->fifo_level);
+}
+
+static void lps_latch(sim_i2c_model_t *m)
+{
+    sim_env_t env;
+    trace_env(sim_now_us(), &env);
+    int32_t p = (int32_t)lroundf(env.pressure_hpa * 4096.0f);
+    int16_t t = (int16_t)lroundf(env.temp_c * 100.0f);
+    m->regs[0x28] = p & 0xFF;
+    m->regs[0x29] = (p >> 8) & 0xFF;
+    m->regs[0x2A] = (p >> 16) & 0xFF;
+    m->regs[0x2B] = t & 0xFF;
+    m->regs[0x2C] = (t >> 8) & 0xFF;
+}
+
+static void lps_update(sim_i2c_model_t *m)
+{
+    if (m->pending && sim_now_us() >= m->ready_us) {
+        lps_latch(m);
+        m->pending = false;
+        m->regs[0x11] &= (uint8_t)~0x01;    // ONE_SHOT self-clears
+        m->regs[0x27] = 0x03;               // P_DA | T_DA
+    }
+}
+
+static esp_err_t lps22hb_write(sim_i2c_model_t *m, uint8_t mem, size_t len, const uint8_t *data)
+{
+    if (mem == NULL_I2C_MEM_ADDR) return ESP_FAIL;
+    lps_update(m);
+    lps_fifo_update(m);
+    bool was_running = lps_fifo_running(m);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t reg = (uint8_t)(mem + i);
+        m->regs[reg] = data[i];
+        if (!was_running && lps_fifo_running(m)) {
+            m->start_us = sim_now_us() + 1000000;
+            m->fifo_level = 0;
+            m->fifo_ovr = false;
+            m->fifo_pos = 0;
+        }
+        if (reg == 0x11 && (data[i] & 0x01)) {
+            m->pending = true;
+            m->ready_us = sim_now_us() + LPS_ONE_SHOT_US;
+            m->regs[0x27] = 0;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t lps22hb_read(sim_i2c_model_t *m, uint8_t mem, size_t len, uint8_t *data)
+{
+    if (mem == NULL_I2C_MEM_ADDR) return ESP_FAIL;
+    lps_update(m);
+    lps_fifo_update(m);
+    if (lps_fifo_running(m) && mem == 0x28) {
+        /* The address wraps from TEMP_OUT_H to PRESS_OUT_XL, popping a sample */
+        for (size_t i = 0; i < len; i++) {
+            data[i] = m->fifo_level > 0 ? m->fifo[0][m->fifo_pos] : 0;
+            if (++m->fifo_pos == 5) {
+                m->fifo_pos = 0;
+                if (m->fifo_level > 0) {
+                    memmove(m->fifo[0], m->fifo[1], sizeof(m->fifo[0]) * (LPS_FIFO_DEPTH - 1));
+                    m->fifo_level--;
+                    m->fifo_ovr = false;
+                }
+            }
+        }
+        m->regs[0x26] = (uint8_t)m->fifo_level;
+        return ESP_OK;
+    }
+    for (size_t i = 0; i < len; i++) data[i] = m->regs[(uint8_t)(mem + i)];
+    /* Reading the output registers clears the data-available flags */
+    if (mem <= 0x2C && mem + len > 0x28) m->regs[0x27] = 0;
+    return ESP_OK;
+}
+
+/* ---- VEML7700 (16-bit little-endian registers) ---- */
+
+#define VEML_WAKEUP_US          2500    // SD=0 -> integration starts
+
+static uint16_t veml_reg(sim_i2c_model_t *m, uint8_t reg)
+{
+    return (uint16_t)(m->regs[2 * reg] | (m->regs[2 * reg + 1] << 8));
+}
+
+static int veml_it_ms(uint16_t conf)
+{
+    switch (conf & 0x03C0) {
+    case 0x0300: return 25;
+    case 0x0200: return 50;
+    case 0x0040: return 200;
+    case 0x0080: return 400;
+    case 0x00C0: return 800;
+    default: return 100;
+    }
+}
+
+static float veml_gain(uint16_t conf)
+{
+    /* Gain encoding as veml7700.c defines it */
+    switch (conf & 0x0C00) {
+    case 0x0400: return 2.0f;
+    case 0x0800: return 0.125f;
+    case 0x0C00: return 0.25f;
+    default: return 1.0f;
+    }
+}
+
+static esp_err_t veml7700_write(sim_i2c_model_t *m, uint8_t mem, size_t len, const uint8_t *data)
+{
+    if (mem > 0x06 || len != 2) return ESP_FAIL;
+    uint16_t old = veml_reg(m, mem);
+    m->regs[2 * mem] = data[0];
+    m->regs[2 * mem + 1] = data[1];
+    if (mem == 0x00 && veml_reg(m, 0) != old) {
+        m->start_us = sim_now_us() + VEML_WAKEUP_US;    // new range or power-up restarts the integration
+    }
+    return ESP_OK;
+}
+
+static esp_err_t veml7700_read(sim_i2c_model_t *m, uint8_t mem, size_t len, uint8_t *data)
+{
+    if (mem > 0x06 || len != 2) return ESP_FAIL;
+    uint16_t conf = veml_reg(m, 0);
+    if (mem == 0x04 && !(conf & 0x0001)) {
+        int it_ms = veml_it_ms(conf);
+        if (sim_now_us() - m->start_us >= (int64_t)it_ms * 1000) {
+            sim_env_t env;
+            trace_env(sim_now_us(), &env);
+            float resolution = 0.0036f * (2.0f / veml_gain(conf)) * (800.0f / (float)it_ms);
+            uint16_t counts = clamp_u16(env.lux / resolution);
+            m->regs[8] = counts & 0xFF;
+            m->regs[9] = counts >> 8;
+        }
+    }
+    data[0] = m->regs[2 * mem];
+    data[1] = m->regs[2 * mem + 1];
+    return ESP_OK;
+}
+
+/* ---- AS5600 ---- */
+
+static esp_err_t as5600_read(sim_i2c_model_t *m, uint8_t mem, size_t len, uint8_t *data)
+{
+    if (mem == NULL_I2C_MEM_ADDR) return ESP_FAIL;
+    sim_env_t env;
+    trace_env(sim_now_us(), &env);
+    float deg = fmodf(env.wind_dir_deg, 360.0f);
+    if (deg < 0.0f) deg += 360.0f;
+    uint16_t angle = (uint16_t)lroundf(deg * 4096.0f / 360.0f) & 0x0FFF;
+    m->regs[0x0B] = 0x20;                   // MD: magnet detected, in range
+    m->regs[0x0C] = m->regs[0x0E] = angle >> 8;
+    m->regs[0x0D] = m->regs[0x0F] = angle & 0xFF;
+    m->regs[0x1A] = 0x80;
+    m->regs[0x1B] = 0x08;
+    m->regs[0x1C] = 0x00;
+    for (size_t i = 0; i < len; i++) data[i] = m->regs[(uint8_t)(mem + i)];
+    return ESP_OK;
+}
+
+static esp_err_t as5600_write(sim_i2c_model_t *m, uint8_t mem, size_t len, const uint8_t *data)
+{
+    if (mem == NULL_I2C_MEM_ADDR) return ESP_FAIL;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t reg = (uint8_t)(mem + i);
+        if (reg == 0x07 || reg == 0x08) m->regs[reg] = data[i];
+    }
+    return ESP_OK;
+}
+
+static sim_i2c_model_t s_models[] = {
+    { .port = I2C_NUM_0, .addr = 0x44, .read = sht41_read, .write = sht41_write },
+    { .port = I2C_NUM_0, .addr = 0x5D, .read = lps22hb_read, .write = lps22hb_write, .regs = { [0x0F] = 0xB1, [0x11] = 0x10 } },
+    { .port = I2C_NUM_1, .addr = 0x36, .read = as5600_read, .write = as5600_write },
+    { .port = I2C_NUM_1, .addr = 0x10, .read = veml7700_read, .write = veml7700_write, .regs = { [0] = 0x01 } },
+};
+
+static sim_i2c_model_t *model_at(int port, uint8_t addr)
+{
+    for (size_t i = 0; i < sizeof(s_models) / sizeof(s_models[0]); i++) {
+        if (s_models[i].port == port && s_models[i].addr == addr) return &s_models[i];
+    }
+    return NULL;
+}
+
+/* ---- i2c_bus API ---- */
+
+static void bus_time(const struct sim_i2c_dev *dev, uint8_t mem, size_t len, bool read)
+{
+    size_t bytes = 1 + len;                                 // address + data
+    if (mem != NULL_I2C_MEM_ADDR) bytes += read ? 2 : 1;    // register, repeated-start address
+    g_sim_stats.i2c_transfers++;
+    sim_busy_us(SIM_I2C_OVERHEAD_US + (int64_t)bytes * I2C_BITS_PER_BYTE * 1000000LL / dev->bus->clk_hz);
+}
+
+i2c_bus_handle_t i2c_bus_create(i2c_port_t port, const i2c_config_t *conf)
+{
+    struct sim_i2c_bus *bus = calloc(1, sizeof(*bus));
+    if (!bus) return NULL;
+    bus->port = port;
+    bus->clk_hz = conf && conf->master.clk_speed ? conf->master.clk_speed : 100000;
+    g_sim_stats.i2c_bus_creates++;
+    sim_busy_us(SIM_I2C_BUS_CREATE_US);
+    return bus;
+}
+
+esp_err_t i2c_bus_delete(i2c_bus_handle_t *p_bus)
+{
+    if (!p_bus || !*p_bus) return ESP_ERR_INVALID_ARG;
+    free(*p_bus);
+    *p_bus = NULL;
+    return ESP_OK;
+}
+
+uint8_t i2c_bus_scan(i2c_bus_handle_t bus, uint8_t *buf, uint8_t num)
+{
+    uint8_t found = 0;
+    for (int addr = 0x08; addr < 0x78; addr++) {
+        if (model_at(bus->port, (uint8_t)addr) == NULL) continue;
+        if (buf && found < num) buf[found] = (uint8_t)addr;
+        found++;
+    }
+    sim_busy_us((0x78 - 0x08) * I2C_SCAN_PROBE_US);
+    return found;
+}
+
+i2c_bus_device_handle_t i2c_bus_device_create(i2c_bus_handle_t bus, uint8_t dev_addr, uint32_t clk_speed)
+{
+    (void)clk_speed;
+    struct sim_i2c_dev *dev = calloc(1, sizeof(*dev));
+    if (!dev) return NULL;
+    dev->bus = bus;
+    dev->addr = dev_addr;
+    dev->model = model_at(bus->port, dev_addr);     // NULL: every transfer NACKs
+    sim_busy_us(SIM_I2C_DEVICE_CREATE_US);
+    return dev;
+}
+
+esp_err_t i2c_bus_device_delete(i2c_bus_device_handle_t *p_dev)
+{
+    if (!p_dev || !*p_dev) return ESP_ERR_INVALID_ARG;
+    free(*p_dev);
+    *p_dev = NULL;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_read_bytes(i2c_bus_device_handle_t dev, uint8_t mem_address, size_t data_len, uint8_t *data)
+{
+    if (!dev || !data) return ESP_ERR_INVALID_ARG;
+    bus_time(dev, mem_address, data_len, true);
+    return dev->model ? dev->model->read(dev->model, mem_address, data_len, data) : ESP_FAIL;
+}
+
+esp_err_t i2c_bus_read_byte(i2c_bus_device_handle_t dev, uint8_t mem_address, uint8_t *data)
+{
+    return i2c_bus_read_bytes(dev, mem_address, 1, data);
+}
+
+esp_err_t i2c_bus_write_bytes(i2c_bus_device_handle_t dev, uint8_t mem_address, size_t data_len, const uint8_t *data)
+{
+    if (!dev || !data) return ESP_ERR_INVALID_ARG;
+    bus_time(dev, mem_address, data_len, false);
+    return dev->model ? dev->model->write(dev->model, mem_address, data_len, data) : ESP_FAIL;
+}
+
+esp_err_t i2c_bus_write_byte(i2c_bus_device_handle_t dev, uint8_t mem_address, uint8_t data)
+{
+    return i2c_bus_write_bytes(dev, mem_address, 1, &data);
+}
+
+/* ---- bme280 component: no BME280 on the default board ---- */
+
+bme280_handle_t bme280_create(i2c_bus_handle_t bus, uint8_t dev_addr)
+{
+    (void)bus;
+    (void)dev_addr;
+    return NULL;
+}
+
+esp_err_t bme280_delete(bme280_handle_t *sensor)
+{
+    if (sensor) *sensor = NULL;
+    return ESP_OK;
+}
+
+esp_err_t bme280_set_sampling(bme280_handle_t sensor, bme280_sensor_mode mode, bme280_sensor_sampling temp,
+                              bme280_sensor_sampling press, bme280_sensor_sampling hum,
+                              bme280_sensor_filter filter, bme280_standby_duration duration)
+{
+    (void)sensor; (void)mode; (void)temp; (void)press; (void)hum; (void)filter; (void)duration;
+    return ESP_FAIL;
+}
+
+esp_err_t bme280_read_coefficients(bme280_handle_t sensor)
+{
+    (void)sensor;
+    return ESP_FAIL;
+}
+
+esp_err_t bme280_take_forced_measurement(bme280_handle_t sensor)
+{
+    (void)sensor;
+    return ESP_FAIL;
+}
+
+esp_err_t bme280_read_temperature(bme280_handle_t sensor, float *temperature)
+{
+    (void)sensor;
+    (void)temperature;
+    return ESP_FAIL;
+}
+
+esp_err_t bme280_read_humidity(bme280_handle_t sensor, float *humidity)
+{
+    (void)sensor;
+    (void)humidity;
+    return ESP_FAIL;
+}
+
+esp_err_t bme280_read_pressure(bme280_handle_t sensor, float *pressure)
+{
+    (void)sensor;
+    (void)pressure;
+    return ESP_FAIL;
+}
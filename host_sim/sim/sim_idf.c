@@ -0,0 +1,695 @@
+/*
+ * ESP-IDF mocks: logging, reset/sleep queries, CRC, raw partitions, NVS,
+ * GPIO with ISRs and wake levels, PCNT and the battery ADC. Flash writes and
+ * ADC conversions charge their time to the caller through sim_busy_us().
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_rtc_time.h"
+#include "esp_rom_crc.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "driver/pulse_cnt.h"
+#include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "esp_zb_weather.h"
+#include "sim.h"
+
+int g_sim_log_level = ESP_LOG_NONE;
+
+/* ---- logging and system ---- */
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    if (level > g_sim_log_level) return;
+    fprintf(stderr, "%c (%11.6f) %s: ", letters[level], sim_now_us() / 1e6, tag);
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_NOT_FINISHED: return "ESP_ERR_NOT_FINISHED";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    default: return "ESP_ERR_UNKNOWN";
+    }
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "sim: esp_restart() at t=%.3f s - resets are not modelled\n", sim_now_us() / 1e6);
+    exit(2);
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void)
+{
+    return ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t io_mask, esp_sleep_ext1_wakeup_mode_t level_mode)
+{
+    (void)io_mask;
+    (void)level_mode;
+    return ESP_OK;
+}
+
+uint64_t esp_rtc_get_time_us(void)
+{
+    return (uint64_t)sim_now_us();
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+    return ~crc;
+}
+
+/* ---- raw partitions (partitions.csv) ---- */
+
+#define FLASH_SECTOR_SIZE       4096
+
+typedef struct {
+    esp_partition_t part;
+    uint8_t *data;
+} sim_partition_t;
+
+static sim_partition_t s_partitions[] = {
+    { { ESP_PARTITION_TYPE_DATA, 0x40, 0x355000, 0x4000, FLASH_SECTOR_SIZE, "rain_log" }, NULL },
+    { { ESP_PARTITION_TYPE_DATA, 0x41, 0x359000, 0x10000, FLASH_SECTOR_SIZE, "meas_log" }, NULL },
+};
+
+static sim_partition_t *partition_of(const esp_partition_t *partition)
+{
+    for (size_t i = 0; i < sizeof(s_partitions) / sizeof(s_partitions[0]); i++) {
+        sim_partition_t *p = &s_partitions[i];
+        if (&p->part != partition) continue;
+        if (!p->data) {
+            p->data = malloc(p->part.size);
+            memset(p->data, 0xFF, p->part.size);
+        }
+        return p;
+    }
+    return NULL;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (size_t i = 0; i < sizeof(s_partitions) / sizeof(s_partitions[0]); i++) {
+        const esp_partition_t *p = &s_partitions[i].part;
+        if (p->type == type && p->subtype == subtype && (!label || strcmp(label, p->label) == 0)) return p;
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    sim_partition_t *p = partition_of(partition);
+    if (!p || src_offset + size > p->part.size) return ESP_ERR_INVALID_ARG;
+    memcpy(dst, p->data + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    sim_partition_t *p = partition_of(partition);
+    if (!p || dst_offset + size > p->part.size) return ESP_ERR_INVALID_ARG;
+    /* NOR flash: programming only clears bits */
+    const uint8_t *s = src;
+    for (size_t i = 0; i < size; i++) p->data[dst_offset + i] &= s[i];
+    g_sim_stats.flash_writes++;
+    sim_busy_us(SIM_FLASH_WRITE_US((int64_t)size));
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    sim_partition_t *p = partition_of(partition);
+    if (!p || offset % FLASH_SECTOR_SIZE || size % FLASH_SECTOR_SIZE || offset + size > p->part.size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(p->data + offset, 0xFF, size);
+    g_sim_stats.flash_erases += size / FLASH_SECTOR_SIZE;
+    sim_busy_us((int64_t)(size / FLASH_SECTOR_SIZE) * SIM_FLASH_ERASE_US);
+    return ESP_OK;
+}
+
+/* ---- NVS ---- */
+
+#define NVS_MAX_ENTRIES         64
+#define NVS_MAX_HANDLES         16
+
+typedef struct {
+    char ns[16];
+    char key[16];
+    uint8_t *value;
+    size_t len;
+} nvs_entry_t;
+
+static nvs_entry_t s_nvs[NVS_MAX_ENTRIES];
+static char s_nvs_handles[NVS_MAX_HANDLES + 1][16];     // namespace per handle, index 0 unused
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        free(s_nvs[i].value);
+        memset(&s_nvs[i], 0, sizeof(s_nvs[i]));
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    (void)open_mode;
+    for (nvs_handle_t h = 1; h <= NVS_MAX_HANDLES; h++) {
+        if (s_nvs_handles[h][0] == '\0') {
+            snprintf(s_nvs_handles[h], sizeof(s_nvs_handles[h]), "%s", namespace_name);
+            *out_handle = h;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    if (handle >= 1 && handle <= NVS_MAX_HANDLES) s_nvs_handles[handle][0] = '\0';
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    g_sim_stats.nvs_commits++;
+    return ESP_OK;
+}
+
+static nvs_entry_t *nvs_find(nvs_handle_t handle, const char *key, bool create)
+{
+    if (handle < 1 || handle > NVS_MAX_HANDLES || s_nvs_handles[handle][0] == '\0') return NULL;
+    const char *ns = s_nvs_handles[handle];
+    nvs_entry_t *free_slot = NULL;
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        nvs_entry_t *e = &s_nvs[i];
+        if (e->key[0] == '\0') {
+            if (!free_slot) free_slot = e;
+            continue;
+        }
+        if (strcmp(e->ns, ns) == 0 && strcmp(e->key, key) == 0) return e;
+    }
+    if (!create || !free_slot) return NULL;
+    snprintf(free_slot->ns, sizeof(free_slot->ns), "%s", ns);
+    snprintf(free_slot->key, sizeof(free_slot->key), "%s", key);
+    return free_slot;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char *key, const void *value, size_t len)
+{
+    nvs_entry_t *e = nvs_find(handle, key, true);
+    if (!e) return ESP_ERR_NO_MEM;
+    /* Like the real NVS, an unchanged value is not written again */
+    if (e->value && e->len == len && memcmp(e->value, value, len) == 0) return ESP_OK;
+    free(e->value);
+    e->value = malloc(len ? len : 1);
+    memcpy(e->value, value, len);
+    e->len = len;
+    g_sim_stats.nvs_writes++;
+    sim_busy_us(SIM_NVS_WRITE_US);
+    return ESP_OK;
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, void *out, size_t len)
+{
+    nvs_entry_t *e = nvs_find(handle, key, false);
+    if (!e || !e->value) return ESP_ERR_NVS_NOT_FOUND;
+    if (e->len != len) return ESP_ERR_INVALID_SIZE;
+    memcpy(out, e->value, len);
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    nvs_entry_t *e = nvs_find(handle, key, false);
+    if (!e) return ESP_ERR_NVS_NOT_FOUND;
+    free(e->value);
+    memset(e, 0, sizeof(*e));
+    g_sim_stats.nvs_writes++;
+    sim_busy_us(SIM_NVS_WRITE_US);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return nvs_set(handle, key, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    nvs_entry_t *e = nvs_find(handle, key, false);
+    if (!e || !e->value) return ESP_ERR_NVS_NOT_FOUND;
+    if (out_value == NULL) {
+        *length = e->len;
+        return ESP_OK;
+    }
+    if (*length < e->len) return ESP_ERR_INVALID_SIZE;
+    memcpy(out_value, e->value, e->len);
+    *length = e->len;
+    return ESP_OK;
+}
+
+#define NVS_SCALAR(suffix, type)                                                        \
+    esp_err_t nvs_set_##suffix(nvs_handle_t handle, const char *key, type value)        \
+    {                                                                                   \
+        return nvs_set(handle, key, &value, sizeof(value));                             \
+    }                                                                                   \
+    esp_err_t nvs_get_##suffix(nvs_handle_t handle, const char *key, type *out_value)   \
+    {                                                                                   \
+        return nvs_get(handle, key, out_value, sizeof(*out_value));                     \
+    }
+
+NVS_SCALAR(u8, uint8_t)
+NVS_SCALAR(u16, uint16_t)
+NVS_SCALAR(u32, uint32_t)
+NVS_SCALAR(i64, int64_t)
+
+/* ---- GPIO ---- */
+
+typedef struct {
+    int level;
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    gpio_isr_t isr;
+    void *isr_arg;
+    gpio_int_type_t wake_type;      // GPIO_INTR_DISABLE = not a wake source
+} sim_pin_t;
+
+static sim_pin_t s_pins[GPIO_NUM_MAX];
+static bool s_pins_ready = false;
+static bool s_isr_service = false;
+
+static sim_pin_t *pin_of(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) return NULL;
+    if (!s_pins_ready) {
+        for (int i = 0; i < GPIO_NUM_MAX; i++) s_pins[i].level = trace_initial_level(i);
+        s_pins_ready = true;
+    }
+    return &s_pins[gpio_num];
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        if (!(config->pin_bit_mask & (1ULL << i))) continue;
+        sim_pin_t *p = pin_of(i);
+        p->intr_type = config->intr_type;
+        p->intr_enabled = config->intr_type != GPIO_INTR_DISABLE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    if (!p) return ESP_ERR_INVALID_ARG;
+    p->intr_type = GPIO_INTR_DISABLE;
+    p->intr_enabled = false;
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    return p ? p->level : 0;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    if (!p) return ESP_ERR_INVALID_ARG;
+    p->level = level ? 1 : 0;
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    (void)intr_alloc_flags;
+    if (s_isr_service) return ESP_ERR_INVALID_STATE;
+    s_isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    if (!p) return ESP_ERR_INVALID_ARG;
+    if (!s_isr_service) return ESP_ERR_INVALID_STATE;
+    p->isr = isr_handler;
+    p->isr_arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    if (!p) return ESP_ERR_INVALID_ARG;
+    p->isr = NULL;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    if (!p) return ESP_ERR_INVALID_ARG;
+    p->intr_enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    if (!p) return ESP_ERR_INVALID_ARG;
+    p->intr_enabled = false;
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    if (!p || (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL)) return ESP_ERR_INVALID_ARG;
+    p->wake_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio_num)
+{
+    sim_pin_t *p = pin_of(gpio_num);
+    if (!p) return ESP_ERR_INVALID_ARG;
+    p->wake_type = GPIO_INTR_DISABLE;
+    return ESP_OK;
+}
+
+bool rtc_gpio_is_valid_gpio(gpio_num_t gpio_num)
+{
+    /* ESP32-H2: GPIO7-14 are LP/RTC capable */
+    return gpio_num >= 7 && gpio_num <= 14;
+}
+
+bool sim_gpio_is_wake_level(int pin, int level)
+{
+    sim_pin_t *p = pin_of(pin);
+    return p && ((p->wake_type == GPIO_INTR_LOW_LEVEL && level == 0) ||
+                 (p->wake_type == GPIO_INTR_HIGH_LEVEL && level == 1));
+}
+
+bool sim_gpio_wake_pending(void)
+{
+    for (int i = 0; i < GPIO_NUM_MAX; i++) {
+        if (sim_gpio_is_wake_level(i, pin_of(i)->level)) return true;
+    }
+    return false;
+}
+
+/* ---- PCNT ---- */
+
+#define PCNT_MAX_UNITS          4
+
+struct pcnt_chan_t {
+    struct pcnt_unit_t *unit;
+    int gpio;
+    pcnt_channel_edge_action_t pos_act;
+    pcnt_channel_edge_action_t neg_act;
+};
+
+struct pcnt_unit_t {
+    bool used;
+    bool enabled;
+    bool started;
+    int count;
+    struct pcnt_chan_t chan;
+    bool has_chan;
+};
+
+static struct pcnt_unit_t s_pcnt[PCNT_MAX_UNITS];
+
+esp_err_t pcnt_new_unit(const pcnt_unit_config_t *config, pcnt_unit_handle_t *ret_unit)
+{
+    (void)config;
+    for (int i = 0; i < PCNT_MAX_UNITS; i++) {
+        if (!s_pcnt[i].used) {
+            memset(&s_pcnt[i], 0, sizeof(s_pcnt[i]));
+            s_pcnt[i].used = true;
+            *ret_unit = &s_pcnt[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t pcnt_del_unit(pcnt_unit_handle_t unit)
+{
+    if (!unit || unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->used = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_set_glitch_filter(pcnt_unit_handle_t unit, const pcnt_glitch_filter_config_t *config)
+{
+    (void)unit;
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_enable(pcnt_unit_handle_t unit)
+{
+    if (!unit || unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->enabled = true;
+    sim_pm_lock(true);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_disable(pcnt_unit_handle_t unit)
+{
+    if (!unit || !unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->enabled = false;
+    unit->started = false;
+    sim_pm_lock(false);
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_start(pcnt_unit_handle_t unit)
+{
+    if (!unit || !unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->started = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_stop(pcnt_unit_handle_t unit)
+{
+    if (!unit || !unit->enabled) return ESP_ERR_INVALID_STATE;
+    unit->started = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unit)
+{
+    if (!unit) return ESP_ERR_INVALID_ARG;
+    unit->count = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unit, int *value)
+{
+    if (!unit || !value) return ESP_ERR_INVALID_ARG;
+    *value = unit->count;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_unit_add_watch_point(pcnt_unit_handle_t unit, int watch_point)
+{
+    (void)unit;
+    (void)watch_point;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_new_channel(pcnt_unit_handle_t unit, const pcnt_chan_config_t *config, pcnt_channel_handle_t *ret_chan)
+{
+    if (!unit || unit->has_chan) return ESP_ERR_INVALID_STATE;
+    unit->has_chan = true;
+    unit->chan.unit = unit;
+    unit->chan.gpio = config->edge_gpio_num;
+    *ret_chan = &unit->chan;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_del_channel(pcnt_channel_handle_t chan)
+{
+    if (!chan) return ESP_ERR_INVALID_ARG;
+    chan->unit->has_chan = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_edge_action(pcnt_channel_handle_t chan, pcnt_channel_edge_action_t pos_act,
+                                       pcnt_channel_edge_action_t neg_act)
+{
+    if (!chan) return ESP_ERR_INVALID_ARG;
+    chan->pos_act = pos_act;
+    chan->neg_act = neg_act;
+    return ESP_OK;
+}
+
+static void pcnt_edge(int pin, bool rising)
+{
+    for (int i = 0; i < PCNT_MAX_UNITS; i++) {
+        struct pcnt_unit_t *u = &s_pcnt[i];
+        if (!u->used || !u->started || !u->has_chan || u->chan.gpio != pin) continue;
+        pcnt_channel_edge_action_t act = rising ? u->chan.pos_act : u->chan.neg_act;
+        if (act == PCNT_CHANNEL_EDGE_ACTION_INCREASE) u->count++;
+        else if (act == PCNT_CHANNEL_EDGE_ACTION_DECREASE) u->count--;
+    }
+}
+
+void sim_gpio_input(int pin, int level, bool asleep, sim_isr_policy_t policy)
+{
+    sim_pin_t *p = pin_of(pin);
+    if (!p || p->level == level) return;
+    bool rising = level > p->level;
+    p->level = level;
+    pcnt_edge(pin, rising);
+
+    if (!p->isr || !p->intr_enabled) return;
+    bool match = p->intr_type == GPIO_INTR_ANYEDGE ||
+                 (p->intr_type == GPIO_INTR_POSEDGE && rising) ||
+                 (p->intr_type == GPIO_INTR_NEGEDGE && !rising) ||
+                 (p->intr_type == GPIO_INTR_LOW_LEVEL && level == 0) ||
+                 (p->intr_type == GPIO_INTR_HIGH_LEVEL && level == 1);
+    if (!match) return;
+    if (asleep) {
+        if (policy == SIM_ISR_IN_SLEEP_LOST) {
+            g_sim_stats.isr_edges_lost++;
+            return;
+        }
+        g_sim_stats.isr_edges_in_sleep++;
+    }
+    p->isr(p->isr_arg);
+}
+
+/* ---- battery ADC (ADC1 channel 3 behind the divider) ---- */
+
+#define ADC_FULL_SCALE_MV       3300
+#define ADC_MAX_RAW             4095
+
+static int s_adc_unit;
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *init_config, adc_oneshot_unit_handle_t *ret_unit)
+{
+    (void)init_config;
+    *ret_unit = (adc_oneshot_unit_handle_t)&s_adc_unit;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel,
+                                     const adc_oneshot_chan_cfg_t *config)
+{
+    (void)handle;
+    (void)channel;
+    (void)config;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t chan, int *out_raw)
+{
+    (void)handle;
+    sim_busy_us(SIM_ADC_READ_US);
+    if (chan != ADC_CHANNEL_3 || gpio_get_level(GPIO_NUM_3) == 0) {
+        *out_raw = 0;           // divider disconnected by the MOSFET
+        return ESP_OK;
+    }
+    sim_env_t env;
+    trace_env(sim_now_us(), &env);
+    int divider_mv = (int)(env.battery_mv * BATTERY_VOLTAGE_DIVIDER_R2 /
+                           (BATTERY_VOLTAGE_DIVIDER_R1 + BATTERY_VOLTAGE_DIVIDER_R2));
+    int raw = divider_mv * ADC_MAX_RAW / ADC_FULL_SCALE_MV;
+    *out_raw = raw > ADC_MAX_RAW ? ADC_MAX_RAW : raw;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+static int s_adc_cali;
+
+esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t *config,
+                                               adc_cali_handle_t *ret_handle)
+{
+    (void)config;
+    *ret_handle = (adc_cali_handle_t)&s_adc_cali;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_delete_scheme_curve_fitting(adc_cali_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_create_scheme_line_fitting(const adc_cali_line_fitting_config_t *config,
+                                              adc_cali_handle_t *ret_handle)
+{
+    return adc_cali_create_scheme_curve_fitting(config, ret_handle);
+}
+
+esp_err_t adc_cali_delete_scheme_line_fitting(adc_cali_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t handle, int raw, int *voltage)
+{
+    (void)handle;
+    *voltage = raw * ADC_FULL_SCALE_MV / ADC_MAX_RAW;
+    return ESP_OK;
+}
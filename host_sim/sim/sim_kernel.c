@@ -0,0 +1,612 @@
+/*
+ * Virtual-time kernel
+ * FreeRTOS tasks, notifications, queues, semaphores and esp_timer on top of one baton: every
+ * task is a host thread, but only the holder of g_current runs, and the
+ * scheduler (g_current == NULL) only advances time when no task is ready. Time
+ * jumps straight to the next event, so a day of firmware runs in well under a
+ * second. Gaps without a runnable task, PM lock or pending wake level that are
+ * longer than the idle threshold are light sleep.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "power_profiler.h"
+#include "sim.h"
+
+typedef enum {
+    TASK_READY,
+    TASK_BLOCKED,
+    TASK_DEAD,
+} task_state_t;
+
+struct sim_task {
+    pthread_t thread;
+    pthread_cond_t cv;
+    char name[16];
+    TaskFunction_t fn;
+    void *arg;
+    task_state_t state;
+    int64_t deadline_us;            // INT64_MAX = no timeout
+    const void *wait_obj;
+    uint32_t notify_value;
+    bool notify_pending;
+    struct sim_task *next;
+};
+
+struct sim_queue {
+    uint8_t *buf;
+    size_t item_size;
+    size_t length;
+    size_t head;
+    size_t count;
+};
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    bool active;
+    int64_t expiry_us;
+    int64_t period_us;              // 0 = one-shot
+    struct esp_timer *next;
+};
+
+sim_stats_t g_sim_stats;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_sched_cv = PTHREAD_COND_INITIALIZER;
+static struct sim_task *s_tasks = NULL;
+static struct sim_task *s_tasks_tail = NULL;
+static struct sim_task *s_current = NULL;
+static struct esp_timer *s_timers = NULL;
+static int64_t s_now_us = 0;
+static int64_t s_poll_interval_us = SIM_KEEP_ALIVE_US;
+static int64_t s_next_poll_us = SIM_KEEP_ALIVE_US;
+static bool s_asleep = false;
+static int s_pm_locks = 0;
+static int s_isr_depth = 0;
+static sim_isr_policy_t s_policy = SIM_ISR_IN_SLEEP_KEPT;
+static int64_t s_sample_period_us = 0;
+static int64_t s_next_sample_us = INT64_MAX;
+static void (*s_sampler)(void) = NULL;
+
+static void die(const char *what)
+{
+    fprintf(stderr, "sim: %s (t=%.6f s, task %s)\n", what, s_now_us / 1e6, s_current ? s_current->name : "-");
+    abort();
+}
+
+int64_t sim_now_us(void)
+{
+    return s_now_us;
+}
+
+bool sim_asleep(void)
+{
+    return s_asleep;
+}
+
+void sim_pm_lock(bool acquire)
+{
+    s_pm_locks += acquire ? 1 : -1;
+    if (s_pm_locks < 0) die("PM lock released more often than taken");
+}
+
+void sim_set_poll_interval_us(int64_t interval_us)
+{
+    if (interval_us <= 0) die("poll interval must be positive");
+    s_poll_interval_us = interval_us;
+    if (s_next_poll_us > s_now_us + interval_us) s_next_poll_us = s_now_us + interval_us;
+}
+
+/* ---- edges and busy time ---- */
+
+/* Deliver the next trace edge; returns the ISR time it cost */
+static int64_t deliver_edge(void)
+{
+    int pin = 0, level = 0;
+    trace_pop_edge(&pin, &level);
+    bool asleep = s_asleep;
+    if (asleep && sim_gpio_is_wake_level(pin, level)) {
+        /* The wake source fires first; the ISR then runs awake */
+        asleep = false;
+        s_asleep = false;
+        g_sim_stats.wakes++;
+        pipeline_woke();
+        s_now_us += SIM_WAKE_OVERHEAD_US;
+    }
+    s_isr_depth++;
+    sim_gpio_input(pin, level, asleep, s_policy);
+    s_isr_depth--;
+    return asleep ? 0 : SIM_ISR_US;
+}
+
+void sim_busy_us(int64_t us)
+{
+    if (us <= 0) return;
+    int64_t target = s_now_us + us;
+    for (;;) {
+        int64_t edge = trace_next_edge_us();
+        if (edge > target) break;
+        if (edge > s_now_us) s_now_us = edge;
+        int64_t cost = deliver_edge();
+        s_now_us += cost;
+        target += cost;
+    }
+    s_now_us = target;
+}
+
+/* ---- tasks ---- */
+
+static void task_exit(struct sim_task *t)
+{
+    t->state = TASK_DEAD;
+    s_current = NULL;
+    pthread_cond_signal(&s_sched_cv);
+    pthread_mutex_unlock(&s_lock);
+    pthread_exit(NULL);
+}
+
+static void *task_entry(void *p)
+{
+    struct sim_task *t = p;
+    pthread_mutex_lock(&s_lock);
+    while (s_current != t) pthread_cond_wait(&t->cv, &s_lock);
+    t->fn(t->arg);
+    task_exit(t);
+    return NULL;
+}
+
+static void task_yield(struct sim_task *t)
+{
+    s_current = NULL;
+    pthread_cond_signal(&s_sched_cv);
+    while (s_current != t) pthread_cond_wait(&t->cv, &s_lock);
+}
+
+static void dispatch(struct sim_task *t)
+{
+    s_current = t;
+    pthread_cond_signal(&t->cv);
+    while (s_current != NULL) pthread_cond_wait(&s_sched_cv, &s_lock);
+}
+
+void sim_wait(const void *obj, int64_t deadline_us)
+{
+    struct sim_task *t = s_current;
+    if (t == NULL || s_isr_depth > 0) die("blocking call outside a task");
+    t->state = TASK_BLOCKED;
+    t->wait_obj = obj;
+    t->deadline_us = deadline_us;
+    task_yield(t);
+}
+
+void sim_wake_waiters(const void *obj)
+{
+    if (obj == NULL) return;
+    for (struct sim_task *t = s_tasks; t; t = t->next) {
+        if (t->state == TASK_BLOCKED && t->wait_obj == obj) {
+            t->state = TASK_READY;
+            t->wait_obj = NULL;
+        }
+    }
+}
+
+static int64_t ticks_to_deadline(TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) return INT64_MAX;
+    /* FreeRTOS wakes on tick boundaries */
+    return (s_now_us / SIM_TICK_US + (int64_t)ticks) * SIM_TICK_US;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *out_handle)
+{
+    (void)stack_depth;
+    (void)priority;
+    struct sim_task *t = calloc(1, sizeof(*t));
+    if (!t) return pdFAIL;
+    snprintf(t->name, sizeof(t->name), "%s", name ? name : "task");
+    t->fn = fn;
+    t->arg = arg;
+    t->state = TASK_READY;
+    t->deadline_us = INT64_MAX;
+    pthread_cond_init(&t->cv, NULL);
+    if (s_tasks_tail) s_tasks_tail->next = t; else s_tasks = t;
+    s_tasks_tail = t;
+    if (pthread_create(&t->thread, NULL, task_entry, t) != 0) die("pthread_create failed");
+    if (out_handle) *out_handle = t;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task != NULL && task != s_current) die("vTaskDelete of another task is not modelled");
+    if (s_current == NULL) die("vTaskDelete outside a task");
+    task_exit(s_current);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    sim_wait(NULL, ticks_to_deadline(ticks));
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+    *previous_wake += increment;
+    int64_t deadline = (int64_t)*previous_wake * SIM_TICK_US;
+    if (deadline > s_now_us) {
+        sim_wait(NULL, deadline);
+    } else {
+        *previous_wake = (TickType_t)(s_now_us / SIM_TICK_US);
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(s_now_us / SIM_TICK_US);
+}
+
+TickType_t xTaskGetTickCountFromISR(void)
+{
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+/* ---- task notifications (the task itself is the wait object) ---- */
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    if (task == NULL) die("notify of a NULL task");
+    BaseType_t ret = pdPASS;
+    switch (action) {
+    case eSetBits: task->notify_value |= value; break;
+    case eIncrement: task->notify_value++; break;
+    case eSetValueWithOverwrite: task->notify_value = value; break;
+    case eSetValueWithoutOverwrite:
+        if (task->notify_pending) ret = pdFAIL; else task->notify_value = value;
+        break;
+    case eNoAction: break;
+    }
+    task->notify_pending = true;
+    sim_wake_waiters(task);
+    return ret;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higher_prio_woken)
+{
+    if (higher_prio_woken) *higher_prio_woken = pdFALSE;
+    return xTaskNotify(task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks)
+{
+    struct sim_task *t = s_current;
+    if (t == NULL) die("notify wait outside a task");
+    if (!t->notify_pending) t->notify_value &= ~clear_on_entry;
+    int64_t deadline = ticks_to_deadline(ticks);
+    while (!t->notify_pending) {
+        if (s_now_us >= deadline) return pdFAIL;
+        sim_wait(t, deadline);
+    }
+    if (value) *value = t->notify_value;
+    t->notify_value &= ~clear_on_exit;
+    t->notify_pending = false;
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct sim_task *t = s_current;
+    if (t == NULL) die("notify take outside a task");
+    int64_t deadline = ticks_to_deadline(ticks);
+    while (t->notify_value == 0 && s_now_us < deadline) sim_wait(t, deadline);
+    uint32_t value = t->notify_value;
+    if (value) t->notify_value = clear_on_exit ? 0 : value - 1;
+    t->notify_pending = false;
+    return value;
+}
+
+/* ---- queues and semaphores ---- */
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct sim_queue *q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->item_size = item_size;
+    q->length = length;
+    q->buf = item_size ? calloc(length, item_size) : NULL;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (!queue) return;
+    free(queue->buf);
+    free(queue);
+}
+
+static void queue_push(struct sim_queue *q, const void *item)
+{
+    if (q->item_size && item) {
+        memcpy(q->buf + ((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+    }
+    q->count++;
+    sim_wake_waiters(q);
+}
+
+static void queue_pop(struct sim_queue *q, void *item)
+{
+    if (q->item_size && item) {
+        memcpy(item, q->buf + q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+    }
+    q->count--;
+    sim_wake_waiters(q);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    int64_t deadline = ticks_to_deadline(ticks);
+    while (queue->count >= queue->length) {
+        if (ticks == 0 || s_now_us >= deadline) return pdFAIL;
+        sim_wait(queue, deadline);
+    }
+    queue_push(queue, item);
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higher_prio_woken)
+{
+    if (higher_prio_woken) *higher_prio_woken = pdFALSE;
+    if (queue->count >= queue->length) return pdFAIL;
+    queue_push(queue, item);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    int64_t deadline = ticks_to_deadline(ticks);
+    while (queue->count == 0) {
+        if (ticks == 0 || s_now_us >= deadline) return pdFAIL;
+        sim_wait(queue, deadline);
+    }
+    queue_pop(queue, item);
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    return (UBaseType_t)queue->count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t sem = xQueueCreate(1, 0);
+    if (sem) sem->count = 1;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSend(sem, NULL, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *higher_prio_woken)
+{
+    return xQueueSendFromISR(sem, NULL, higher_prio_woken);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    vQueueDelete(sem);
+}
+
+/* ---- esp_timer ---- */
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !create_args->callback || !out_handle) return ESP_ERR_INVALID_ARG;
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (!t) return ESP_ERR_NO_MEM;
+    t->callback = create_args->callback;
+    t->arg = create_args->arg;
+    t->name = create_args->name;
+    t->next = s_timers;
+    s_timers = t;
+    *out_handle = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = true;
+    timer->period_us = 0;
+    timer->expiry_us = s_now_us + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (!timer || period == 0) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = true;
+    timer->period_us = (int64_t)period;
+    timer->expiry_us = s_now_us + (int64_t)period;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (!timer->active) return ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    if (timer->active) return ESP_ERR_INVALID_STATE;
+    for (struct esp_timer **pp = &s_timers; *pp; pp = &(*pp)->next) {
+        if (*pp == timer) {
+            *pp = timer->next;
+            free(timer);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_ARG;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer && timer->active;
+}
+
+/* ---- scheduler ---- */
+
+void sim_set_sampler(int64_t period_us, void (*cb)(void))
+{
+    s_sample_period_us = period_us;
+    s_next_sample_us = s_now_us + period_us;
+    s_sampler = cb;
+}
+
+static void app_main_task(void *arg)
+{
+    void (*app)(void) = (void (*)(void))arg;
+    app();
+}
+
+static struct sim_task *first_ready(void)
+{
+    for (struct sim_task *t = s_tasks; t; t = t->next) {
+        if (t->state == TASK_READY) return t;
+    }
+    return NULL;
+}
+
+/* Earliest event that wakes the chip (trace edges are handled apart) */
+static int64_t next_wake_source(void)
+{
+    int64_t next = s_next_poll_us;
+    for (struct sim_task *t = s_tasks; t; t = t->next) {
+        if (t->state == TASK_BLOCKED && t->deadline_us < next) next = t->deadline_us;
+    }
+    for (struct esp_timer *t = s_timers; t; t = t->next) {
+        if (t->active && t->expiry_us < next) next = t->expiry_us;
+    }
+    return next;
+}
+
+static void wake_up(void)
+{
+    s_asleep = false;
+    g_sim_stats.wakes++;
+    pipeline_woke();
+    sim_busy_us(SIM_WAKE_OVERHEAD_US);
+}
+
+static void fire_due(void)
+{
+    if (s_now_us >= s_next_poll_us) {
+        /* Data request to the parent; the CPU waits for the radio */
+        s_next_poll_us += s_poll_interval_us;
+        g_sim_stats.polls++;
+        sim_busy_us(POWER_MODEL_POLL_US);
+        sim_zigbee_poll();
+    }
+    for (struct esp_timer *t = s_timers; t; t = t->next) {
+        if (t->active && t->expiry_us <= s_now_us) {
+            if (t->period_us > 0) {
+                t->expiry_us += t->period_us;
+            } else {
+                t->active = false;
+            }
+            t->callback(t->arg);
+        }
+    }
+    for (struct sim_task *t = s_tasks; t; t = t->next) {
+        if (t->state == TASK_BLOCKED && t->deadline_us <= s_now_us) {
+            t->state = TASK_READY;
+            t->wait_obj = NULL;
+        }
+    }
+}
+
+void sim_run(void (*app_main)(void), int64_t end_us, sim_isr_policy_t policy)
+{
+    pthread_mutex_lock(&s_lock);
+    s_policy = policy;
+    xTaskCreate(app_main_task, "main", 0, (void *)app_main, 1, NULL);
+
+    for (;;) {
+        struct sim_task *t = first_ready();
+        if (t) {
+            dispatch(t);
+            continue;
+        }
+        if (s_now_us >= end_us) break;
+
+        int64_t wake_at = next_wake_source();
+        if (!s_asleep && wake_at - s_now_us >= SIM_IDLE_BEFORE_SLEEP_US && s_pm_locks == 0 &&
+            !sim_gpio_wake_pending() && pipeline_can_sleep()) {
+            s_asleep = true;
+        }
+
+        int64_t edge = trace_next_edge_us();
+        int64_t next = wake_at < edge ? wake_at : edge;
+        if (next > end_us) next = end_us;
+        if (s_sampler && s_next_sample_us <= next) {
+            if (s_next_sample_us > s_now_us) s_now_us = s_next_sample_us;
+            s_next_sample_us += s_sample_period_us;
+            s_sampler();
+            continue;
+        }
+        if (next > s_now_us) s_now_us = next;
+        if (s_now_us >= end_us) break;          // events at the end belong to the next run
+
+        if (edge <= s_now_us) {
+            s_now_us += deliver_edge();
+            continue;
+        }
+        if (s_asleep) wake_up();
+        fire_due();
+    }
+
+    if (s_asleep) {
+        /* Close the open sleep so the profile covers the whole run */
+        s_asleep = false;
+        pipeline_woke();
+    }
+    pthread_mutex_unlock(&s_lock);
+}
@@ -0,0 +1,318 @@
+/*
+ * Zigbee stack mock: scheduler alarms run on a "zigbee" task and attribute
+ * writes turn into report frames. The device is joined throughout; every
+ * cluster that changed during a pass of the task sends one report, and a
+ * reported cluster repeats itself every SIM_HEARTBEAT_US (the ZCL max interval).
+ * Writes to an attribute whose local reporting was configured off (max
+ * interval 0xFFFF) do not report; esp_zb_zcl_report_attr_cmd_req() sends one
+ * report of its cluster without a heartbeat.
+ * Each frame is charged POWER_MODEL_TX_FRAME_US awake and counted by the
+ * firmware profiler, as aps_data_confirm_cb() does on the device.
+ *
+ * Frames for us go through the parent: the APS ACK of every report, and the
+ * coordinator's interview (SIM_INTERVIEW_FRAMES commands, the next one sent
+ * once we answered the last). The parent holds a frame until our next data
+ * request and drops it after SIM_PARENT_HOLD_US; a fetched frame reaches the
+ * registered confirm/indication handler on the zigbee task.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_zigbee_core.h"
+#include "freertos/task.h"
+#include "esp_zb_weather.h"
+#include "power_profiler.h"
+#include "sim.h"
+
+#define SIM_ZB_MAX_ALARMS       32
+#define SIM_ZB_MAX_CLUSTERS     32
+#define SIM_ZB_MAX_FRAMES       32
+#define SIM_ZB_MAX_SILENT       32
+
+typedef struct {
+    esp_zb_callback_t cb;
+    uint8_t param;
+    int64_t due_us;
+    uint32_t seq;                   // FIFO order among alarms due together
+} sim_alarm_t;
+
+typedef struct {
+    uint8_t endpoint;
+    uint16_t cluster_id;
+    bool dirty;
+    bool periodic;                  // has attributes with reporting on, so it repeats
+    int64_t last_report_us;         // < 0 = never reported
+} sim_cluster_t;
+
+typedef struct {
+    uint8_t endpoint;
+    uint16_t cluster_id;
+    uint16_t attr_id;
+} sim_attr_ref_t;
+
+typedef struct {
+    bool ack;                       // APS ACK of a report, else a coordinator command
+    uint8_t dst_endpoint;
+    uint16_t cluster_id;
+    int64_t at_parent_us;           // from then on a poll fetches it
+} sim_frame_t;
+
+static sim_alarm_t s_alarms[SIM_ZB_MAX_ALARMS];
+static size_t s_alarm_count = 0;
+static uint32_t s_alarm_seq = 0;
+static sim_cluster_t s_clusters[SIM_ZB_MAX_CLUSTERS];
+static size_t s_cluster_count = 0;
+static const char s_zb_event = 0;   // wait object of the zigbee task
+static sim_frame_t s_parent[SIM_ZB_MAX_FRAMES];     // held for us at the parent
+static size_t s_parent_count = 0;
+static sim_frame_t s_inbox[SIM_ZB_MAX_FRAMES];      // fetched, not yet handled
+static size_t s_inbox_count = 0;
+static int s_interview_sent = 0;
+static sim_attr_ref_t s_silent[SIM_ZB_MAX_SILENT];  // reporting configured off
+static size_t s_silent_count = 0;
+static esp_zb_apsde_data_confirm_callback_t s_confirm_cb = NULL;
+static esp_zb_apsde_data_indication_callback_t s_indication_cb = NULL;
+
+static void parent_queue(sim_frame_t frame)
+{
+    if (s_parent_count >= SIM_ZB_MAX_FRAMES) {
+        g_sim_stats.frames_lost++;  // indirect queue full
+        return;
+    }
+    s_parent[s_parent_count++] = frame;
+}
+
+/* Next interview command: ZDO binds first, then Configure Reporting */
+static void interview_send(int64_t at_parent_us)
+{
+    if (s_interview_sent >= SIM_INTERVIEW_FRAMES) return;
+    bool bind = s_interview_sent < SIM_INTERVIEW_FRAMES / 2;
+    s_interview_sent++;
+    parent_queue((sim_frame_t) {
+        .ack = false,
+        .dst_endpoint = bind ? 0 : HA_ESP_ENV_SENSOR_ENDPOINT,
+        .cluster_id = bind ? 0 : ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
+        .at_parent_us = at_parent_us,
+    });
+}
+
+void sim_zigbee_poll(void)
+{
+    int64_t now = sim_now_us();
+    size_t kept = 0;
+    for (size_t i = 0; i < s_parent_count; i++) {
+        sim_frame_t f = s_parent[i];
+        if (f.at_parent_us > now) {
+            s_parent[kept++] = f;
+        } else if (now - f.at_parent_us > SIM_PARENT_HOLD_US || s_inbox_count >= SIM_ZB_MAX_FRAMES) {
+            g_sim_stats.frames_lost++;
+        } else {
+            s_inbox[s_inbox_count++] = f;
+        }
+    }
+    s_parent_count = kept;
+    if (s_inbox_count > 0) sim_wake_waiters(&s_zb_event);
+}
+
+static sim_cluster_t *cluster_of(uint8_t endpoint, uint16_t cluster_id)
+{
+    for (size_t i = 0; i < s_cluster_count; i++) {
+        if (s_clusters[i].endpoint == endpoint && s_clusters[i].cluster_id == cluster_id) return &s_clusters[i];
+    }
+    if (s_cluster_count >= SIM_ZB_MAX_CLUSTERS) return NULL;
+    sim_cluster_t *c = &s_clusters[s_cluster_count++];
+    c->endpoint = endpoint;
+    c->cluster_id = cluster_id;
+    c->dirty = false;
+    c->periodic = false;
+    c->last_report_us = -1;
+    return c;
+}
+
+static int silent_index(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id)
+{
+    for (size_t i = 0; i < s_silent_count; i++) {
+        if (s_silent[i].endpoint == endpoint && s_silent[i].cluster_id == cluster_id && s_silent[i].attr_id == attr_id) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+esp_zb_zcl_status_t esp_zb_zcl_set_attribute_val(uint8_t endpoint, uint16_t cluster_id, uint8_t cluster_role,
+                                                 uint16_t attr_id, void *value_p, bool check)
+{
+    (void)cluster_role;
+    (void)value_p;
+    (void)check;
+    g_sim_stats.attr_updates++;
+    /* The cause breakdown is read on demand, never reported */
+    if (cluster_id == DIAG_CLUSTER_ID && attr_id == DIAG_ATTR_POWER_CAUSES_ID) return ESP_ZB_ZCL_STATUS_SUCCESS;
+    /* Not reportable: sent by esp_zb_zcl_report_attr_cmd_req() */
+    if (cluster_id == TELEMETRY_CLUSTER_ID && attr_id == TELEMETRY_ATTR_SNAPSHOT_ID) return ESP_ZB_ZCL_STATUS_SUCCESS;
+    if (silent_index(endpoint, cluster_id, attr_id) >= 0) return ESP_ZB_ZCL_STATUS_SUCCESS;
+    sim_cluster_t *c = cluster_of(endpoint, cluster_id);
+    if (c) c->dirty = c->periodic = true;
+    sim_wake_waiters(&s_zb_event);
+    return ESP_ZB_ZCL_STATUS_SUCCESS;
+}
+
+void esp_zb_scheduler_alarm(esp_zb_callback_t cb, uint8_t param, uint32_t time)
+{
+    if (s_alarm_count >= SIM_ZB_MAX_ALARMS) {
+        fprintf(stderr, "sim: scheduler alarm table full\n");
+        abort();
+    }
+    s_alarms[s_alarm_count++] = (sim_alarm_t) {
+        .cb = cb, .param = param, .due_us = sim_now_us() + (int64_t)time * 1000, .seq = s_alarm_seq++,
+    };
+    sim_wake_waiters(&s_zb_event);
+}
+
+void esp_zb_aps_data_confirm_handler_register(esp_zb_apsde_data_confirm_callback_t cb)
+{
+    s_confirm_cb = cb;
+}
+
+void esp_zb_aps_data_indication_handler_register(esp_zb_apsde_data_indication_callback_t cb)
+{
+    s_indication_cb = cb;
+}
+
+void esp_zb_zdo_pim_set_long_poll_interval(uint32_t ms)
+{
+    sim_set_poll_interval_us((int64_t)ms * 1000);
+}
+
+uint16_t esp_zb_get_short_address(void)
+{
+    return 0x1234;
+}
+
+esp_err_t esp_zb_zcl_config_report_cmd_req(esp_zb_zcl_config_report_cmd_t *cmd_req)
+{
+    for (uint8_t i = 0; i < cmd_req->record_number; i++) {
+        const esp_zb_zcl_config_report_record_t *r = &cmd_req->record_field[i];
+        uint8_t endpoint = cmd_req->zcl_basic_cmd.dst_endpoint;
+        int k = silent_index(endpoint, cmd_req->clusterID, r->attributeID);
+        if (r->max_interval == 0xFFFF && k < 0) {
+            if (s_silent_count >= SIM_ZB_MAX_SILENT) {
+                fprintf(stderr, "sim: too many attributes with reporting off\n");
+                abort();
+            }
+            s_silent[s_silent_count++] = (sim_attr_ref_t) { endpoint, cmd_req->clusterID, r->attributeID };
+            /* Until another attribute of the cluster reports */
+            sim_cluster_t *c = cluster_of(endpoint, cmd_req->clusterID);
+            if (c) c->periodic = false;
+        } else if (r->max_interval != 0xFFFF && k >= 0) {
+            s_silent[k] = s_silent[--s_silent_count];
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_zb_zcl_report_attr_cmd_req(esp_zb_zcl_report_attr_cmd_t *cmd_req)
+{
+    sim_cluster_t *c = cluster_of(cmd_req->zcl_basic_cmd.src_endpoint, cmd_req->clusterID);
+    if (c) c->dirty = true;
+    sim_wake_waiters(&s_zb_event);
+    return ESP_OK;
+}
+
+bool esp_zb_lock_acquire(TickType_t block_ticks)
+{
+    (void)block_ticks;
+    return true;                    // everything runs under the kernel baton
+}
+
+void esp_zb_lock_release(void)
+{
+}
+
+/* Index of the alarm to run next, -1 if none */
+static int next_alarm(void)
+{
+    int best = -1;
+    for (size_t i = 0; i < s_alarm_count; i++) {
+        if (best < 0 || s_alarms[i].due_us < s_alarms[best].due_us ||
+            (s_alarms[i].due_us == s_alarms[best].due_us && s_alarms[i].seq < s_alarms[best].seq)) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+static void send_report(sim_cluster_t *c)
+{
+    c->dirty = false;
+    c->last_report_us = sim_now_us();
+    g_sim_stats.reports++;
+    power_profiler_tx();
+    sim_busy_us(POWER_MODEL_TX_FRAME_US);
+    parent_queue((sim_frame_t) { .ack = true, .at_parent_us = sim_now_us() + SIM_ACK_RTT_US });
+}
+
+/* A frame a poll fetched: ACKs confirm, commands are answered */
+static void handle_frame(sim_frame_t f)
+{
+    if (f.ack) {
+        if (s_confirm_cb) s_confirm_cb((esp_zb_apsde_data_confirm_t) { .status = 0 });
+        return;
+    }
+    if (s_indication_cb) {
+        s_indication_cb((esp_zb_apsde_data_ind_t) {
+            .status = 0, .dst_endpoint = f.dst_endpoint, .cluster_id = f.cluster_id,
+        });
+    }
+    /* The stack's response; not a report */
+    power_profiler_tx();
+    sim_busy_us(POWER_MODEL_TX_FRAME_US);
+    interview_send(sim_now_us() + SIM_COORD_TURNAROUND_US);
+}
+
+/* Send what changed and what is due for its heartbeat; returns the next heartbeat */
+static int64_t flush_reports(void)
+{
+    int64_t next_heartbeat = INT64_MAX;
+    for (size_t i = 0; i < s_cluster_count; i++) {
+        sim_cluster_t *c = &s_clusters[i];
+        bool repeats = c->periodic && c->last_report_us >= 0;
+        if (c->dirty || (repeats && sim_now_us() - c->last_report_us >= SIM_HEARTBEAT_US)) {
+            send_report(c);
+        }
+        if (repeats && c->last_report_us + SIM_HEARTBEAT_US < next_heartbeat) {
+            next_heartbeat = c->last_report_us + SIM_HEARTBEAT_US;
+        }
+    }
+    return next_heartbeat;
+}
+
+static void zigbee_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        if (s_inbox_count > 0) {
+            sim_frame_t f = s_inbox[0];
+            s_inbox_count--;
+            for (size_t k = 0; k < s_inbox_count; k++) s_inbox[k] = s_inbox[k + 1];
+            handle_frame(f);
+            continue;
+        }
+        int i = next_alarm();
+        if (i >= 0 && s_alarms[i].due_us <= sim_now_us()) {
+            sim_alarm_t a = s_alarms[i];
+            s_alarms[i] = s_alarms[--s_alarm_count];
+            a.cb(a.param);
+            continue;
+        }
+        int64_t deadline = flush_reports();
+        if (i >= 0 && s_alarms[i].due_us < deadline) deadline = s_alarms[i].due_us;
+        sim_wait(&s_zb_event, deadline);
+    }
+}
+
+void sim_zigbee_start(void)
+{
+    xTaskCreate(zigbee_task, "zigbee", 4096, NULL, 5, NULL);
+    interview_send(sim_now_us() + SIM_INTERVIEW_DELAY_US);
+}
@@ -0,0 +1,213 @@
+/*
+ * Weather trace replay
+ * A trace is a CSV of rows, in time order:
+ *
+ *   t_s,temp_c,rh,pressure_hpa,lux,wind_ms,wind_dir_deg,battery_mv,rain_mm_h
+ *
+ * Sensor values are interpolated linearly between rows (the direction along
+ * the shorter arc). Rain rate and wind speed hold from their row to the next
+ * and become pin edges: a bucket tip every RAIN_MM_PER_PULSE of rain (reed
+ * closed for TRACE_TIP_LOW_US) and one anemometer pulse per revolution, at the
+ * rate anemometer_pulses_to_speed() inverts to. The last row holds to the end.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "driver/gpio.h"
+#include "anemometer.h"
+#include "rain_gauge.h"
+#include "esp_zb_weather.h"
+#include "sim.h"
+
+#define TRACE_COLUMNS           9
+#define TRACE_TIP_LOW_US        80000   // reed switch closed while the bucket swings over
+#define TRACE_PULSE_DUTY        0.2     // hall output low for this share of a revolution
+#define TRACE_PULSE_LOW_MAX_US  20000
+#define TRACE_MIN_HIGH_US       1000
+
+typedef struct {
+    double t_s;
+    double v[TRACE_COLUMNS - 1];
+} trace_row_t;
+
+enum { COL_TEMP, COL_RH, COL_PRESSURE, COL_LUX, COL_WIND, COL_DIR, COL_BATTERY, COL_RAIN };
+
+typedef struct {
+    int pin;
+    int col;                        // rate column
+    double units_per_value_s;       // edges per second per unit of that column
+    bool low;                       // pin currently pulled low
+    int64_t next_us;                // next transition, INT64_MAX = none
+    int64_t fall_us;                // last falling edge
+    uint32_t *counter;              // ground-truth count in g_sim_stats
+} trace_channel_t;
+
+static trace_row_t *s_rows = NULL;
+static size_t s_row_count = 0;
+static int64_t s_end_us = 0;
+static trace_channel_t s_channels[2];
+
+/* Row in effect at t (the last one starting at or before it) */
+static size_t row_at(double t_s)
+{
+    size_t lo = 0, hi = s_row_count;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (s_rows[mid].t_s <= t_s) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+void trace_env(int64_t t_us, sim_env_t *env)
+{
+    double t = t_us / 1e6;
+    size_t i = row_at(t);
+    const trace_row_t *a = &s_rows[i];
+    const trace_row_t *b = i + 1 < s_row_count ? &s_rows[i + 1] : a;
+    double f = b->t_s > a->t_s ? (t - a->t_s) / (b->t_s - a->t_s) : 0.0;
+    if (f < 0.0) f = 0.0;
+    if (f > 1.0) f = 1.0;
+#define LERP(col) (float)(a->v[col] + (b->v[col] - a->v[col]) * f)
+    env->temp_c = LERP(COL_TEMP);
+    env->rh = LERP(COL_RH);
+    env->pressure_hpa = LERP(COL_PRESSURE);
+    env->lux = LERP(COL_LUX);
+    env->wind_ms = LERP(COL_WIND);
+    env->battery_mv = LERP(COL_BATTERY);
+#undef LERP
+    double d = fmod(b->v[COL_DIR] - a->v[COL_DIR] + 540.0, 360.0) - 180.0;
+    env->wind_dir_deg = (float)fmod(a->v[COL_DIR] + d * f + 360.0, 360.0);
+}
+
+/* Time one more unit of the channel's rate has accumulated after from_s */
+static int64_t next_unit_us(const trace_channel_t *ch, double from_s, double need)
+{
+    double t = from_s;
+    for (size_t i = row_at(t);; i++) {
+        double rate = s_rows[i].v[ch->col] * ch->units_per_value_s;
+        double seg_end = i + 1 < s_row_count ? s_rows[i + 1].t_s : INFINITY;
+        if (rate > 0.0 && t + need / rate <= seg_end) {
+            double at_s = t + need / rate;
+            return at_s * 1e6 < (double)s_end_us ? (int64_t)llround(at_s * 1e6) : INT64_MAX;
+        }
+        if (isinf(seg_end) || seg_end * 1e6 >= (double)s_end_us) return INT64_MAX;
+        if (rate > 0.0) need -= rate * (seg_end - t);
+        t = seg_end;
+    }
+}
+
+static int64_t low_time_us(const trace_channel_t *ch, int64_t at_us)
+{
+    if (ch->pin == RAIN_GAUGE_GPIO) return TRACE_TIP_LOW_US;
+    double rate = s_rows[row_at(at_us / 1e6)].v[ch->col] * ch->units_per_value_s;
+    double low = TRACE_PULSE_DUTY * 1e6 / rate;
+    return low > TRACE_PULSE_LOW_MAX_US ? TRACE_PULSE_LOW_MAX_US : (int64_t)low;
+}
+
+static bool parse_row(char *line, trace_row_t *row)
+{
+    double cols[TRACE_COLUMNS];
+    char *p = line;
+    for (int c = 0; c < TRACE_COLUMNS; c++) {
+        char *end;
+        cols[c] = strtod(p, &end);
+        if (end == p) return false;
+        p = end;
+        while (*p == ' ' || *p == '\t') p++;
+        if (c + 1 < TRACE_COLUMNS) {
+            if (*p != ',') return false;
+            p++;
+        }
+    }
+    row->t_s = cols[0];
+    memcpy(row->v, &cols[1], sizeof(row->v));
+    return true;
+}
+
+bool trace_load(const char *path, int64_t end_us)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "trace: cannot open %s\n", path);
+        return false;
+    }
+    char line[512];
+    size_t cap = 0;
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0' || isalpha((unsigned char)*p)) continue;    // comment, blank, header
+        if (s_row_count == cap) {
+            cap = cap ? cap * 2 : 64;
+            s_rows = realloc(s_rows, cap * sizeof(*s_rows));
+        }
+        trace_row_t *row = &s_rows[s_row_count];
+        if (!parse_row(p, row) || (s_row_count > 0 && row->t_s <= s_rows[s_row_count - 1].t_s)) {
+            fprintf(stderr, "trace: %s:%d: expected %d comma-separated values in increasing time\n",
+                    path, line_no, TRACE_COLUMNS);
+            fclose(f);
+            return false;
+        }
+        s_row_count++;
+    }
+    fclose(f);
+    if (s_row_count == 0 || s_rows[0].t_s > 0.0) {
+        fprintf(stderr, "trace: %s: the first row must start at t=0\n", path);
+        return false;
+    }
+
+    s_end_us = end_us;
+    s_channels[0] = (trace_channel_t) {
+        .pin = RAIN_GAUGE_GPIO, .col = COL_RAIN,
+        .units_per_value_s = 1.0 / (3600.0 * RAIN_MM_PER_PULSE), .counter = &g_sim_stats.tips_expected,
+    };
+    s_channels[1] = (trace_channel_t) {
+        .pin = ANEMOMETER_GPIO, .col = COL_WIND,
+        .units_per_value_s = 1.0 / anemometer_pulses_to_speed(1, 1.0f), .counter = &g_sim_stats.anemometer_pulses,
+    };
+    /* Start half way to the first edge: a part-filled bucket, a cup mid-turn */
+    for (int i = 0; i < 2; i++) s_channels[i].next_us = next_unit_us(&s_channels[i], 0.0, 0.5);
+    return true;
+}
+
+static trace_channel_t *next_channel(void)
+{
+    return s_channels[1].next_us < s_channels[0].next_us ? &s_channels[1] : &s_channels[0];
+}
+
+int64_t trace_next_edge_us(void)
+{
+    return next_channel()->next_us;
+}
+
+void trace_pop_edge(int *pin, int *level)
+{
+    trace_channel_t *ch = next_channel();
+    int64_t at = ch->next_us;
+    *pin = ch->pin;
+    if (!ch->low) {
+        ch->low = true;
+        ch->fall_us = at;
+        *level = 0;
+        (*ch->counter)++;
+        ch->next_us = at + low_time_us(ch, at);
+        return;
+    }
+    ch->low = false;
+    *level = 1;
+    /* The next edge is timed from the previous falling one, so the rate is exact */
+    int64_t next = next_unit_us(ch, ch->fall_us / 1e6, 1.0);
+    if (next != INT64_MAX && next < at + TRACE_MIN_HIGH_US) next = at + TRACE_MIN_HIGH_US;
+    ch->next_us = next;
+}
+
+int trace_initial_level(int pin)
+{
+    /* Both pulse inputs idle high on their pull-ups */
+    return pin == RAIN_GAUGE_GPIO || pin == ANEMOMETER_GPIO;
+}
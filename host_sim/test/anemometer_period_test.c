@@ -0,0 +1,141 @@
+/*
+ * anemometer_period_test: median-period wind speed across a calm
+ *
+ *   anemometer_period_test [--verbose]
+ *
+ * Drives the anemometer ISR with hand-placed pulses on a mocked esp_timer
+ * and checks anemometer_get_period_speed():
+ *   - steady spin: the median period of the last revolutions
+ *   - spin, calm, gust: after the calm only the gust's periods count, not
+ *     the ones left in the history from before it
+ * The exit code is 1 if any case fails.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "anemometer.h"
+
+static bool s_verbose = false;
+static int s_failures = 0;
+
+/* ---- mocks: log, timer, GPIO ISR ---- */
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (!s_verbose) return;
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s: ", tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+static int64_t s_now_us = 1000000;
+static gpio_isr_t s_isr = NULL;
+static void *s_isr_arg = NULL;
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config) { return ESP_OK; }
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) { return ESP_OK; }
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num) { return ESP_OK; }
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num) { return ESP_OK; }
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    s_isr = isr_handler;
+    s_isr_arg = args;
+    return ESP_OK;
+}
+
+/* ---- cases ---- */
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            printf("  FAIL: " __VA_ARGS__);                     \
+            printf("\n");                                       \
+            return false;                                       \
+        }                                                       \
+    } while (0)
+
+/* count pulses, period_us apart, the first one period_us from now */
+static void spin(int count, uint32_t period_us)
+{
+    for (int i = 0; i < count; i++) {
+        s_now_us += period_us;
+        s_isr(s_isr_arg);
+    }
+}
+
+static bool check_speed(uint32_t period_us, uint8_t expect_revs)
+{
+    float speed = -1.0f;
+    uint8_t revs = 0;
+    CHECK(anemometer_get_period_speed(&speed, &revs) == ESP_OK, "anemometer_get_period_speed failed");
+    float expect = anemometer_pulses_to_speed(1, period_us / 1000000.0f);
+    CHECK(revs == expect_revs, "%u revolutions in the median, expected %u", revs, expect_revs);
+    CHECK(fabsf(speed - expect) <= 0.01f * expect, "%.3f m/s, expected %.3f m/s (%lu us period)",
+          speed, expect, (unsigned long)period_us);
+    return true;
+}
+
+static bool test_steady(void)
+{
+    spin(ANEMOMETER_PERIOD_REVS + 3, 400000);
+    return check_speed(400000, ANEMOMETER_PERIOD_REVS);
+}
+
+static bool test_calm_then_gust(void)
+{
+    /* Leaves the history write position in the middle of the ring */
+    spin(ANEMOMETER_PERIOD_REVS + 2, 2000000);
+    if (!check_speed(2000000, ANEMOMETER_PERIOD_REVS)) return false;
+
+    s_now_us += ANEMOMETER_PERIOD_TIMEOUT_US + 1000000;
+    float speed = -1.0f;
+    uint8_t revs = 0xFF;
+    CHECK(anemometer_get_period_speed(&speed, &revs) == ESP_OK, "anemometer_get_period_speed failed");
+    CHECK(speed == 0.0f && revs == 0, "calm reads %.3f m/s over %u revolutions", speed, revs);
+
+    /* First pulse ends the calm interval, which is skipped; then two revolutions */
+    spin(1, 1000000);
+    spin(2, 250000);
+    return check_speed(250000, 2);
+}
+
+static void run(const char *name, bool (*test)(void))
+{
+    printf("%s\n", name);
+    anemometer_reset();
+    bool ok = test();
+    if (!ok) s_failures++;
+    printf("  %s\n", ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0) s_verbose = true;
+    }
+
+    if (anemometer_init() != ESP_OK || s_isr == NULL) {
+        printf("anemometer_init failed\n");
+        return 1;
+    }
+    run("steady spin", test_steady);
+    run("spin, calm, gust", test_calm_then_gust);
+
+    printf("%d failure(s)\n", s_failures);
+    return s_failures ? 1 : 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * ota_resume_test: interrupted and resumed OTA downloads through ota_writer
+ *
+ *   ota_resume_test [--verbose]
+ *
+ * Feeds a synthetic upgrade-image sub-element (6-byte header, app image,
+ * trailing signature sub-element) to ota_writer in odd-sized blocks, the way
+ * the OTA client hands them over, and compares what reached the partition
+ * with the source byte for byte:
+ *   - uninterrupted download
+ *   - download stopped past a checkpoint, resumed from
+ *     ota_writer_get_checkpoint() at the offset the server is asked for
+ *   - the same, but the server starts over at offset 0
+ * The exit code is 1 if any case fails.
+ */
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "ota_writer.h"
+
+#define BLOCK_SIZE          61                          // not a divisor of the sector size
+#define APP_SIZE            (40 * OTA_WRITER_SECTOR_SIZE + 1234)
+#define SUBELEMENT_HDR      6
+#define TRAILER_SIZE        70                          // signature sub-element after the image
+#define STREAM_SIZE         (SUBELEMENT_HDR + APP_SIZE + TRAILER_SIZE)
+#define STOP_AT             (100 * 1024)                // past the first checkpoint (64 KB)
+#define PARTITION_SIZE      (256 * 1024)
+
+static bool s_verbose = false;
+static int s_failures = 0;
+
+/* ---- mocks: log, timer, CRC ---- */
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    if (!s_verbose) return;
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s: ", tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+int64_t esp_timer_get_time(void)
+{
+    static int64_t now = 0;
+    return now += 1000;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+    }
+    return ~crc;
+}
+
+/* ---- mocks: one RAM partition and esp_ota_* on top of it ---- */
+
+static uint8_t s_flash[PARTITION_SIZE];
+static const esp_partition_t s_partition = {
+    .type = ESP_PARTITION_TYPE_APP, .subtype = 0x10, .address = 0x110000,
+    .size = PARTITION_SIZE, .erase_size = OTA_WRITER_SECTOR_SIZE, .label = "ota_0",
+};
+static bool s_ota_open = false;
+static size_t s_ota_pos = 0;
+static size_t s_ota_end_len = 0;            // image length at the last esp_ota_end()
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    if (partition != &s_partition || src_offset + size > PARTITION_SIZE) return ESP_ERR_INVALID_ARG;
+    memcpy(dst, s_flash + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    if (partition != &s_partition) return ESP_ERR_INVALID_ARG;
+    memset(s_flash, 0xFF, sizeof(s_flash));
+    s_ota_open = true;
+    s_ota_pos = 0;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_resume(const esp_partition_t *partition, size_t erase_size, size_t image_offset,
+                         esp_ota_handle_t *out_handle)
+{
+    if (partition != &s_partition || image_offset > PARTITION_SIZE) return ESP_ERR_INVALID_ARG;
+    memset(s_flash + image_offset, 0xFF, PARTITION_SIZE - image_offset);
+    s_ota_open = true;
+    s_ota_pos = image_offset;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if (!s_ota_open || s_ota_pos + size > PARTITION_SIZE) return ESP_ERR_INVALID_STATE;
+    memcpy(s_flash + s_ota_pos, data, size);
+    s_ota_pos += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    if (!s_ota_open) return ESP_ERR_INVALID_STATE;
+    s_ota_open = false;
+    s_ota_end_len = s_ota_pos;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    s_ota_open = false;
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return NULL;                            // no delta base: raw images only
+}
+
+/* ---- mocks: NVS blobs (kept across the simulated reboot) ---- */
+
+#define NVS_MAX_BLOBS       4
+
+static struct {
+    char key[16];
+    uint8_t data[64];
+    size_t len;
+} s_blobs[NVS_MAX_BLOBS];
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    int slot = -1;
+    for (int i = 0; i < NVS_MAX_BLOBS; i++) {
+        if (strcmp(s_blobs[i].key, key) == 0) { slot = i; break; }
+        if (slot < 0 && s_blobs[i].key[0] == '\0') slot = i;
+    }
+    if (slot < 0 || length > sizeof(s_blobs[slot].data)) return ESP_ERR_NVS_NO_FREE_PAGES;
+    snprintf(s_blobs[slot].key, sizeof(s_blobs[slot].key), "%s", key);
+    memcpy(s_blobs[slot].data, value, length);
+    s_blobs[slot].len = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    for (int i = 0; i < NVS_MAX_BLOBS; i++) {
+        if (strcmp(s_blobs[i].key, key) != 0) continue;
+        if (*length < s_blobs[i].len) return ESP_ERR_INVALID_SIZE;
+        memcpy(out_value, s_blobs[i].data, s_blobs[i].len);
+        *length = s_blobs[i].len;
+        return ESP_OK;
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    for (int i = 0; i < NVS_MAX_BLOBS; i++) {
+        if (strcmp(s_blobs[i].key, key) == 0) {
+            s_blobs[i].key[0] = '\0';
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+/* ---- test image and cases ---- */
+
+static uint8_t s_stream[STREAM_SIZE];       // block stream after the 56-byte OTA file header
+static const ota_writer_image_id_t s_image_id = {
+    .manufacturer = 0x131B, .image_type = 0x0001, .file_version = 0x00020001, .image_size = 56 + STREAM_SIZE,
+};
+
+static void build_stream(void)
+{
+    uint32_t len = APP_SIZE;
+    s_stream[0] = 0x00;                     // tag: upgrade image
+    s_stream[1] = 0x00;
+    for (int i = 0; i < 4; i++) s_stream[2 + i] = (uint8_t)(len >> (8 * i));
+
+    uint32_t x = 0x12345678;
+    for (size_t i = SUBELEMENT_HDR; i < sizeof(s_stream); i++) {
+        x = x * 1103515245u + 12345u;
+        s_stream[i] = (uint8_t)(x >> 16);
+    }
+    s_stream[SUBELEMENT_HDR] = 0xE9;        // ESP image magic
+    s_stream[SUBELEMENT_HDR + APP_SIZE] = 0x01;   // trailing sub-element tag (signature)
+    s_stream[SUBELEMENT_HDR + APP_SIZE + 1] = 0x00;
+}
+
+#define CHECK(cond, ...) do {                                   \
+        if (!(cond)) {                                          \
+            printf("  FAIL: " __VA_ARGS__);                     \
+            printf("\n");                                       \
+            return false;                                       \
+        }                                                       \
+    } while (0)
+
+/* Blocks of BLOCK_SIZE from offset up to (not including) end */
+static bool feed(uint32_t offset, uint32_t end)
+{
+    while (offset < end) {
+        size_t len = end - offset < BLOCK_SIZE ? end - offset : BLOCK_SIZE;
+        esp_err_t ret = ota_writer_write(s_stream + offset, len);
+        CHECK(ret == ESP_OK, "ota_writer_write at stream offset %lu returned 0x%x", (unsigned long)offset, ret);
+        offset += len;
+    }
+    return true;
+}
+
+static bool finish_and_compare(void)
+{
+    CHECK(ota_writer_finish() == ESP_OK, "ota_writer_finish failed");
+    CHECK(s_ota_end_len == APP_SIZE, "image is %lu bytes, expected %d", (unsigned long)s_ota_end_len, APP_SIZE);
+    for (size_t i = 0; i < APP_SIZE; i++) {
+        CHECK(s_flash[i] == s_stream[SUBELEMENT_HDR + i], "image differs from the source at byte %lu",
+              (unsigned long)i);
+    }
+    CHECK(!ota_writer_get_checkpoint(NULL, NULL), "checkpoint left behind after a complete image");
+    return true;
+}
+
+/* Download up to STOP_AT, abort, then begin again as after a reboot */
+static bool interrupt(uint32_t *stream_offset)
+{
+    CHECK(ota_writer_begin(&s_partition, &s_image_id) == ESP_OK, "ota_writer_begin failed");
+    if (!feed(0, STOP_AT)) return false;
+    ota_writer_abort();
+
+    ota_writer_image_id_t ckpt_image;
+    CHECK(ota_writer_get_checkpoint(&ckpt_image, stream_offset), "no checkpoint after %d bytes", STOP_AT);
+    CHECK(memcmp(&ckpt_image, &s_image_id, sizeof(ckpt_image)) == 0, "checkpoint for another image");
+    CHECK((*stream_offset - SUBELEMENT_HDR) % OTA_WRITER_SECTOR_SIZE == 0,
+          "checkpoint at stream offset %lu is not a sector boundary", (unsigned long)*stream_offset);
+    if (s_verbose) {
+        printf("  checkpoint at stream offset %lu (%lu bytes into a block)\n", (unsigned long)*stream_offset,
+               (unsigned long)(*stream_offset % BLOCK_SIZE));
+    }
+
+    CHECK(ota_writer_begin(&s_partition, &s_image_id) == ESP_OK, "ota_writer_begin after the reboot failed");
+    return true;
+}
+
+static bool test_uninterrupted(void)
+{
+    CHECK(ota_writer_begin(&s_partition, &s_image_id) == ESP_OK, "ota_writer_begin failed");
+    return feed(0, STREAM_SIZE) && finish_and_compare();
+}
+
+static bool test_resume_at_checkpoint(void)
+{
+    uint32_t stream_offset = 0;
+    if (!interrupt(&stream_offset)) return false;
+
+    /* The server serves the FileOffset esp_zb_ota_restore_resume_point() sets */
+    if (!feed(stream_offset, STREAM_SIZE)) return false;
+    ota_writer_stats_t stats;
+    ota_writer_get_stats(&stats);
+    CHECK(stats.resumed_from == stream_offset, "stats say resumed from %lu, checkpoint was %lu",
+          (unsigned long)stats.resumed_from, (unsigned long)stream_offset);
+    return finish_and_compare();
+}
+
+static bool test_resume_restarted_at_zero(void)
+{
+    uint32_t stream_offset = 0;
+    if (!interrupt(&stream_offset)) return false;
+
+    /* The client ignored FileOffset: the writer has to start the image over */
+    if (!feed(0, STREAM_SIZE)) return false;
+    ota_writer_stats_t stats;
+    ota_writer_get_stats(&stats);
+    CHECK(stats.resumed_from == 0, "restart from 0 still counted as a resume from %lu",
+          (unsigned long)stats.resumed_from);
+    return finish_and_compare();
+}
+
+static void run(const char *name, bool (*test)(void))
+{
+    printf("%s\n", name);
+    bool ok = test();
+    if (ota_writer_is_active()) ota_writer_abort();
+    ota_writer_clear_checkpoint();
+    if (!ok) s_failures++;
+    printf("  %s\n", ok ? "ok" : "FAILED");
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0) s_verbose = true;
+    }
+
+    build_stream();
+    run("uninterrupted download", test_uninterrupted);
+    run("resume at the checkpoint", test_resume_at_checkpoint);
+    run("resume, server restarts at offset 0", test_resume_restarted_at_zero);
+
+    printf("%d failure(s)\n", s_failures);
+    return s_failures ? 1 : 0;
+}
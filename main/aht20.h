@@ -6,11 +6,20 @@
 // Initialize AHT20 on the provided I2C bus
 esp_err_t aht20_init(i2c_bus_handle_t i2c_bus);
 
-// Trigger a measurement (if required). Many AHT20 chips start measurement on read; this is provided for completeness.
+// Conversion time (datasheet typ. 75 ms)
+#define AHT20_MEASURE_TIME_MS 80
+
+// Start a measurement without waiting for it
+esp_err_t aht20_start_measurement(void);
+
+// Fetch the result of aht20_start_measurement(); ESP_ERR_NOT_FINISHED while busy
+esp_err_t aht20_fetch_measurement(void);
+
+// Trigger a measurement and wait for the result (start + delay + fetch)
 esp_err_t aht20_trigger_measurement(void);
 
-// Read temperature in degrees Celsius
+// Read last measured temperature in degrees Celsius
 esp_err_t aht20_read_temperature(float *out_c);
 
-// Read relative humidity in percent (0-100)
+// Read last measured relative humidity in percent (0-100)
 esp_err_t aht20_read_humidity(float *out_percent);
@@ -10,18 +10,153 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_timer.h"
+#if ANEMOMETER_USE_PCNT
+#include "pulse_counter.h"
+#endif
 
 static const char *TAG = "ANEMOMETER";
 
 /* Pulse counting state */
-static volatile uint32_t pulse_count = 0;
 static int64_t last_measurement_time_us = 0;
 static bool interrupts_enabled = false;
 
+#if ANEMOMETER_USE_PCNT
+/* Pulses are counted by the PCNT peripheral and only read out on demand */
+static pulse_counter_handle_t pulse_counter = NULL;
+#else
+_Static_assert((ANEMOMETER_RING_LEN & (ANEMOMETER_RING_LEN - 1)) == 0, "anemometer ring length must be a power of two");
+
+/* The count is exact; the ring carries the time between consecutive pulses
+ * from the ISR (single producer) to anemometer_take_intervals() (single
+ * consumer). The ISR computes each interval itself, so an interval dropped
+ * while the ring is full never merges two periods into one. */
+static uint32_t pulse_count = 0;
+static uint32_t last_pulse_us = 0;
+static bool last_pulse_valid = false;
+static uint32_t interval_ring[ANEMOMETER_RING_LEN];
+static uint32_t interval_head = 0;
+static uint32_t interval_tail = 0;
+
+#if ANEMOMETER_USE_PERIOD
+/* Last ANEMOMETER_PERIOD_REVS periods, owned by the anemometer_get_period_speed() caller */
+static uint32_t period_hist[ANEMOMETER_PERIOD_REVS];
+static uint8_t period_head = 0;
+static uint8_t period_count = 0;
+#endif
+
 /* ISR handler for anemometer pulses */
 static void IRAM_ATTR anemometer_isr_handler(void *arg)
 {
-    pulse_count++;
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+
+    __atomic_store_n(&pulse_count, pulse_count + 1, __ATOMIC_RELAXED);
+    if (last_pulse_valid) {
+        uint32_t head = interval_head;
+        if (head - __atomic_load_n(&interval_tail, __ATOMIC_ACQUIRE) < ANEMOMETER_RING_LEN) {
+            interval_ring[head & (ANEMOMETER_RING_LEN - 1)] = now_us - last_pulse_us;
+            __atomic_store_n(&interval_head, head + 1, __ATOMIC_RELEASE);
+        }
+    }
+    last_pulse_us = now_us;
+    last_pulse_valid = true;
+}
+#endif
+
+uint32_t anemometer_take_pulses(void)
+{
+#if ANEMOMETER_USE_PCNT
+    uint32_t pulses = 0;
+    if (pulse_counter_take(pulse_counter, &pulses) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to read pulse counter");
+    }
+    return pulses;
+#else
+    return __atomic_exchange_n(&pulse_count, 0, __ATOMIC_RELAXED);
+#endif
+}
+
+size_t anemometer_take_intervals(uint32_t *intervals_us, size_t max)
+{
+#if ANEMOMETER_USE_PCNT
+    (void)intervals_us;
+    (void)max;
+    return 0;
+#else
+    uint32_t tail = interval_tail;
+    uint32_t head = __atomic_load_n(&interval_head, __ATOMIC_ACQUIRE);
+    size_t n = 0;
+    for (; tail != head; tail++) {
+        if (n < max) {
+            intervals_us[n++] = interval_ring[tail & (ANEMOMETER_RING_LEN - 1)];
+        }
+    }
+    __atomic_store_n(&interval_tail, tail, __ATOMIC_RELEASE);
+    return n;
+#endif
+}
+
+esp_err_t anemometer_get_period_speed(float *speed_ms, uint8_t *revs)
+{
+    if (!speed_ms) return ESP_ERR_INVALID_ARG;
+#if ANEMOMETER_USE_PCNT || !ANEMOMETER_USE_PERIOD
+    (void)revs;
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    uint32_t intervals[ANEMOMETER_RING_LEN];
+    size_t n = anemometer_take_intervals(intervals, ANEMOMETER_RING_LEN);
+    for (size_t i = 0; i < n; i++) {
+        /* The first interval after a calm measures the calm, not a revolution */
+        if (intervals[i] >= ANEMOMETER_PERIOD_TIMEOUT_US) continue;
+        period_hist[period_head] = intervals[i];
+        period_head = (period_head + 1) % ANEMOMETER_PERIOD_REVS;
+        if (period_count < ANEMOMETER_PERIOD_REVS) period_count++;
+    }
+
+    uint32_t age_us = 0;
+    if (!anemometer_last_pulse_age_us(&age_us) || age_us >= ANEMOMETER_PERIOD_TIMEOUT_US) {
+        /* The median reads period_hist[0..count-1]: refill from the start */
+        period_head = 0;
+        period_count = 0;
+    }
+    if (revs) *revs = period_count;
+    if (period_count == 0) {
+        *speed_ms = 0.0f;
+        return ESP_OK;
+    }
+
+    /* Median by insertion sort (a handful of entries) */
+    uint32_t sorted[ANEMOMETER_PERIOD_REVS];
+    for (uint8_t i = 0; i < period_count; i++) {
+        uint32_t v = period_hist[i];
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = v;
+    }
+    uint32_t period_us = (period_count & 1) ? sorted[period_count / 2]
+                         : (sorted[period_count / 2 - 1] + sorted[period_count / 2]) / 2;
+
+    /* The revolution in progress is already longer: the cups are slowing down */
+    if (age_us > period_us) period_us = age_us;
+
+    *speed_ms = anemometer_pulses_to_speed(1, period_us / 1000000.0f);
+    return ESP_OK;
+#endif
+}
+
+bool anemometer_last_pulse_age_us(uint32_t *age_us)
+{
+#if ANEMOMETER_USE_PCNT
+    (void)age_us;
+    return false;
+#else
+    if (!last_pulse_valid) {
+        return false;
+    }
+    *age_us = (uint32_t)esp_timer_get_time() - last_pulse_us;
+    return true;
+#endif
 }
 
 esp_err_t anemometer_init(void)
@@ -32,7 +167,11 @@ esp_err_t anemometer_init(void)
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
+#if ANEMOMETER_USE_PCNT
+        .intr_type = GPIO_INTR_DISABLE,  // edges are counted by PCNT
+#else
         .intr_type = GPIO_INTR_NEGEDGE,  // SS445P pulls low on magnet detection
+#endif
     };
     
     esp_err_t ret = gpio_config(&io_conf);
@@ -41,6 +180,20 @@ esp_err_t anemometer_init(void)
         return ret;
     }
 
+#if ANEMOMETER_USE_PCNT
+    /* SS445P pulls low on magnet detection: count falling edges */
+    ret = pulse_counter_create(ANEMOMETER_GPIO, false, ANEMOMETER_PCNT_GLITCH_NS, &pulse_counter);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create pulse counter");
+        return ret;
+    }
+
+    ret = pulse_counter_enable(pulse_counter);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable pulse counter");
+        return ret;
+    }
+#else
     /* Install ISR service */
     ret = gpio_install_isr_service(0);
     if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
@@ -54,12 +207,13 @@ esp_err_t anemometer_init(void)
         ESP_LOGE(TAG, "Failed to add ISR handler");
         return ret;
     }
+#endif
 
     interrupts_enabled = true;
-    last_measurement_time_us = esp_timer_get_time();
-    pulse_count = 0;
+    anemometer_reset();
 
-    ESP_LOGI(TAG, "Anemometer initialized on GPIO%d", ANEMOMETER_GPIO);
+    ESP_LOGI(TAG, "Anemometer initialized on GPIO%d (%s)", ANEMOMETER_GPIO,
+             ANEMOMETER_USE_PCNT ? "PCNT" : "GPIO ISR");
     return ESP_OK;
 }
 
@@ -77,16 +231,11 @@ esp_err_t anemometer_get_wind_speed(float *speed_ms)
     }
 
     /* Get pulse count and reset */
-    uint32_t pulses = pulse_count;
-    pulse_count = 0;
+    uint32_t pulses = anemometer_take_pulses();
     last_measurement_time_us = current_time_us;
 
-    /* Calculate wind speed */
-    /* v = (pulses / elapsed_time) * (2π * radius) * calibration */
     float elapsed_s = elapsed_us / 1000000.0f;
-    float rotations_per_sec = pulses / (ANEMOMETER_PULSES_PER_REV * elapsed_s);
-    float circumference = 2.0f * 3.14159f * ANEMOMETER_RADIUS_M;
-    *speed_ms = rotations_per_sec * circumference * ANEMOMETER_CALIBRATION;
+    *speed_ms = anemometer_pulses_to_speed(pulses, elapsed_s);
 
     ESP_LOGI(TAG, "Wind speed: %.2f m/s (%d pulses in %.1fs)", 
              *speed_ms, pulses, elapsed_s);
@@ -94,16 +243,36 @@ esp_err_t anemometer_get_wind_speed(float *speed_ms)
     return ESP_OK;
 }
 
+float anemometer_pulses_to_speed(uint32_t pulses, float elapsed_s)
+{
+    if (elapsed_s <= 0.0f) return 0.0f;
+
+    /* v = (pulses / elapsed_time) * (2π * radius) * calibration */
+    float rotations_per_sec = pulses / (ANEMOMETER_PULSES_PER_REV * elapsed_s);
+    float circumference = 2.0f * 3.14159f * ANEMOMETER_RADIUS_M;
+    return rotations_per_sec * circumference * ANEMOMETER_CALIBRATION;
+}
+
 void anemometer_reset(void)
 {
-    pulse_count = 0;
+    anemometer_take_pulses();
+    anemometer_take_intervals(NULL, 0);
+#if !ANEMOMETER_USE_PCNT && ANEMOMETER_USE_PERIOD
+    period_head = 0;
+    period_count = 0;
+#endif
     last_measurement_time_us = esp_timer_get_time();
 }
 
 void anemometer_enable(void)
 {
     if (!interrupts_enabled) {
+#if ANEMOMETER_USE_PCNT
+        pulse_counter_enable(pulse_counter);
+#else
+        last_pulse_valid = false;   // the first interval would span the disabled time
         gpio_intr_enable(ANEMOMETER_GPIO);
+#endif
         interrupts_enabled = true;
         anemometer_reset();
     }
@@ -112,7 +281,11 @@ void anemometer_enable(void)
 void anemometer_disable(void)
 {
     if (interrupts_enabled) {
+#if ANEMOMETER_USE_PCNT
+        pulse_counter_disable(pulse_counter);
+#else
         gpio_intr_disable(ANEMOMETER_GPIO);
+#endif
         interrupts_enabled = false;
     }
 }
@@ -5,7 +5,10 @@
 
 #pragma once
 
+#include "sdkconfig.h"
 #include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -13,9 +16,12 @@ extern "C" {
 #endif
 
 /* Wind speed calculation constants */
-#define ANEMOMETER_RADIUS_M        0.07f    // 70mm radius (adjust to your anemometer)
+#define ANEMOMETER_RADIUS_M        (CONFIG_CAELUM_ANEMOMETER_RADIUS_MM / 1000.0f)    // cup radius from Kconfig (70 mm default)
 #define ANEMOMETER_PULSES_PER_REV  1        // SS445P generates 1 pulse per revolution
 #define ANEMOMETER_CALIBRATION     1.18f    // Calibration factor (adjust based on testing)
+#define ANEMOMETER_RING_LEN        64       // pulse intervals buffered between takes (power of two)
+#define ANEMOMETER_PERIOD_REVS     5        // median over the last N revolutions
+#define ANEMOMETER_PERIOD_TIMEOUT_US (5ULL * 1000ULL * 1000ULL)  // no pulse for this long = calm (~0.1 m/s)
 
 /**
  * @brief Initialize anemometer
@@ -36,20 +42,79 @@ esp_err_t anemometer_init(void);
  */
 esp_err_t anemometer_get_wind_speed(float *speed_ms);
 
+/**
+ * @brief Take the pulses counted since the previous call
+ *
+ * For callers doing their own timing (wind_stats sampler). Consumes the same
+ * counter as anemometer_get_wind_speed(), so use one or the other.
+ *
+ * @return Number of pulses
+ */
+uint32_t anemometer_take_pulses(void);
+
+/**
+ * @brief Take the pulse intervals recorded by the ISR since the previous call
+ *
+ * Oldest first. The pulse count stays exact when the ring overflows; only
+ * interval samples are missing then. Always 0 with ANEMOMETER_USE_PCNT.
+ *
+ * @param intervals_us Buffer for the intervals in microseconds (may be NULL when max is 0)
+ * @param max Buffer length; intervals beyond it are discarded
+ * @return Number of intervals written
+ */
+size_t anemometer_take_intervals(uint32_t *intervals_us, size_t max);
+
+/**
+ * @brief Instantaneous wind speed from the median of the last revolution periods
+ *
+ * Takes the intervals recorded since the previous call (the same ring as
+ * anemometer_take_intervals(), so use one or the other) and converts the
+ * median of the last ANEMOMETER_PERIOD_REVS periods to a speed. A few pulses
+ * are enough, which a pulse count over a short window cannot resolve at one
+ * pulse per revolution. While the current revolution is already longer than
+ * the median the speed follows it down; after ANEMOMETER_PERIOD_TIMEOUT_US
+ * without a pulse it is 0.
+ *
+ * @param speed_ms Pointer to store wind speed in m/s
+ * @param revs Number of periods the median was taken over (0 = calm), may be NULL
+ * @return ESP_OK on success, ESP_ERR_NOT_SUPPORTED with ANEMOMETER_USE_PCNT or
+ *         without ANEMOMETER_USE_PERIOD
+ */
+esp_err_t anemometer_get_period_speed(float *speed_ms, uint8_t *revs);
+
+/**
+ * @brief Time since the last pulse
+ *
+ * @param age_us Microseconds since the last pulse edge
+ * @return false if no pulse has been seen (or with ANEMOMETER_USE_PCNT)
+ */
+bool anemometer_last_pulse_age_us(uint32_t *age_us);
+
+/**
+ * @brief Convert a pulse count over a time window to wind speed
+ *
+ * @param pulses Pulses counted in the window
+ * @param elapsed_s Window length in seconds
+ * @return Wind speed in m/s (0 for an empty window)
+ */
+float anemometer_pulses_to_speed(uint32_t pulses, float elapsed_s);
+
 /**
  * @brief Reset pulse counter
  * 
- * Resets accumulated pulse count and timestamp
+ * Resets accumulated pulse count, pending intervals and timestamp
  */
 void anemometer_reset(void);
 
 /**
- * @brief Enable anemometer interrupts
+ * @brief Enable anemometer interrupts (or the PCNT unit with ANEMOMETER_USE_PCNT)
  */
 void anemometer_enable(void);
 
 /**
  * @brief Disable anemometer interrupts (power saving)
+ *
+ * With ANEMOMETER_USE_PCNT this stops the PCNT unit and releases its PM lock.
  */
 void anemometer_disable(void);
 
@@ -3,12 +3,19 @@
  * 12-bit magnetic rotary position sensor for wind direction
  */
 
+#include <math.h>
 #include "as5600.h"
+#include "i2c_txn.h"
+#include "i2c_config.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 static const char *TAG = "AS5600";
 
 /* AS5600 Registers */
+#define AS5600_REG_CONF_H       0x07    // Configuration high byte (WD, FTH, SF)
+#define AS5600_REG_CONF_L       0x08    // Configuration low byte (PWMF, OUTS, HYST, PM)
 #define AS5600_REG_STATUS       0x0B    // Status register
 #define AS5600_REG_RAW_ANGLE_H  0x0C    // Raw angle high byte
 #define AS5600_REG_RAW_ANGLE_L  0x0D    // Raw angle low byte
@@ -18,12 +25,23 @@ static const char *TAG = "AS5600";
 #define AS5600_REG_MAGNITUDE_H  0x1B    // Magnitude high byte
 #define AS5600_REG_MAGNITUDE_L  0x1C    // Magnitude low byte
 
+/* CONF fields */
+#define AS5600_CONF_L_PM_MASK   0x03    // CONF[1:0] power mode
+#define AS5600_CONF_H_SF_MASK   0x03    // CONF[9:8] slow filter
+
 /* Status register bits */
 #define AS5600_STATUS_MH        (1 << 3)  // Magnet too strong
 #define AS5600_STATUS_ML        (1 << 4)  // Magnet too weak
 #define AS5600_STATUS_MD        (1 << 5)  // Magnet detected
 
+#define AS5600_BURST_MAX_SAMPLES 32
+
 static i2c_bus_device_handle_t as5600_dev = NULL;
+static as5600_power_mode_t idle_mode = AS5600_PM_NOM;
+
+/* CONF bytes (volatile, never burnt to OTP): read once, then only written */
+static i2c_shadow_reg_t conf_h_shadow = I2C_SHADOW_REG8(AS5600_REG_CONF_H);
+static i2c_shadow_reg_t conf_l_shadow = I2C_SHADOW_REG8(AS5600_REG_CONF_L);
 
 /* Calibration offset for wind vane orientation (adjust during installation) */
 #define WIND_DIRECTION_OFFSET_DEG  0.0f
@@ -34,6 +52,21 @@ static esp_err_t as5600_read_reg(uint8_t reg, uint8_t *data, size_t len)
     return i2c_bus_read_bytes(as5600_dev, reg, len, data);
 }
 
+/* Output refresh period of a power mode (datasheet: 0 / 5 / 20 / 100 ms) */
+static uint32_t as5600_polling_ms(as5600_power_mode_t mode)
+{
+    static const uint8_t POLLING_MS[] = { 1, 5, 20, 100 };
+    return POLLING_MS[mode & AS5600_CONF_L_PM_MASK];
+}
+
+static float as5600_apply_offset(float angle_deg)
+{
+    float direction = angle_deg + WIND_DIRECTION_OFFSET_DEG;
+    while (direction < 0) direction += 360.0f;
+    while (direction >= 360.0f) direction -= 360.0f;
+    return direction;
+}
+
 esp_err_t as5600_init(i2c_bus_handle_t i2c_bus)
 {
     if (!i2c_bus) return ESP_ERR_INVALID_ARG;
@@ -45,6 +78,9 @@ esp_err_t as5600_init(i2c_bus_handle_t i2c_bus)
         return ESP_FAIL;
     }
 
+    i2c_shadow_invalidate(&conf_h_shadow);
+    i2c_shadow_invalidate(&conf_l_shadow);
+
     /* Check status register for magnet detection */
     uint8_t status;
     esp_err_t ret = as5600_read_reg(AS5600_REG_STATUS, &status, 1);
@@ -64,6 +100,7 @@ esp_err_t as5600_init(i2c_bus_handle_t i2c_bus)
         ESP_LOGI(TAG, "Magnet detected, field strength OK");
     }
 
+    i2c_buses_track_device(i2c_bus, AS5600_I2C_ADDR, &as5600_dev);
     ESP_LOGI(TAG, "AS5600 initialized");
     return ESP_OK;
 }
@@ -106,13 +143,73 @@ esp_err_t as5600_get_wind_direction(float *direction)
     esp_err_t ret = as5600_read_angle_degrees(&angle_deg);
     if (ret != ESP_OK) return ret;
 
-    /* Apply calibration offset for physical orientation */
-    *direction = angle_deg + WIND_DIRECTION_OFFSET_DEG;
-    
-    /* Normalize to 0-360° */
-    while (*direction < 0) *direction += 360.0f;
-    while (*direction >= 360.0f) *direction -= 360.0f;
+    /* Apply calibration offset for physical orientation, normalized to 0-360° */
+    *direction = as5600_apply_offset(angle_deg);
+
+    return ESP_OK;
+}
+
+esp_err_t as5600_configure(as5600_power_mode_t mode, as5600_slow_filter_t filter)
+{
+    if (!as5600_dev) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t ret = i2c_shadow_update(as5600_dev, &conf_h_shadow, AS5600_CONF_H_SF_MASK, (uint8_t)filter);
+    if (ret == ESP_OK) {
+        ret = i2c_shadow_update(as5600_dev, &conf_l_shadow, AS5600_CONF_L_PM_MASK, (uint8_t)mode);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write CONF: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    idle_mode = mode;
+    ESP_LOGI(TAG, "Power mode %s (%lu ms polling), slow filter %ux",
+             mode == AS5600_PM_NOM ? "NOM" : mode == AS5600_PM_LPM1 ? "LPM1" : mode == AS5600_PM_LPM2 ? "LPM2" : "LPM3",
+             (unsigned long)as5600_polling_ms(mode), 16U >> filter);
+    return ESP_OK;
+}
+
+esp_err_t as5600_read_direction_burst(uint8_t samples, uint32_t interval_ms, float *direction, float *spread)
+{
+    if (!direction || samples == 0 || samples > AS5600_BURST_MAX_SAMPLES) return ESP_ERR_INVALID_ARG;
+    if (!as5600_dev) return ESP_ERR_INVALID_STATE;
+
+    /* Run the burst in LPM1 when idling slower, so consecutive samples are
+     * fresh conversions rather than the same held output. */
+    bool boosted = false;
+    if (idle_mode > AS5600_PM_LPM1 && interval_ms < as5600_polling_ms(idle_mode)) {
+        boosted = i2c_shadow_update(as5600_dev, &conf_l_shadow, AS5600_CONF_L_PM_MASK, AS5600_PM_LPM1) == ESP_OK;
+        if (boosted) vTaskDelay(pdMS_TO_TICKS(as5600_polling_ms(AS5600_PM_LPM1)));
+    }
+
+    /* Circular mean: average the unit vectors, a plain mean breaks at 0/360° */
+    float sum_sin = 0.0f, sum_cos = 0.0f;
+    uint8_t taken = 0;
+    esp_err_t ret = ESP_OK;
+    for (uint8_t i = 0; i < samples; i++) {
+        if (i > 0 && interval_ms > 0) vTaskDelay(pdMS_TO_TICKS(interval_ms));
+        uint16_t raw;
+        ret = as5600_read_angle_raw(&raw);
+        if (ret != ESP_OK) continue;
+        float rad = raw * (2.0f * (float)M_PI / 4096.0f);
+        sum_sin += sinf(rad);
+        sum_cos += cosf(rad);
+        taken++;
+    }
+
+    if (boosted) {
+        i2c_shadow_update(as5600_dev, &conf_l_shadow, AS5600_CONF_L_PM_MASK, (uint8_t)idle_mode);
+    }
+    if (taken == 0) return ret;
+
+    float mean_deg = atan2f(sum_sin, sum_cos) * (180.0f / (float)M_PI);
+    if (mean_deg < 0) mean_deg += 360.0f;
+    *direction = as5600_apply_offset(mean_deg);
 
+    if (spread) {
+        /* Circular standard deviation sqrt(-2 ln R), R = mean resultant length */
+        float r = sqrtf(sum_sin * sum_sin + sum_cos * sum_cos) / taken;
+        *spread = r >= 1.0f ? 0.0f : r <= 1e-6f ? 180.0f : fminf(sqrtf(-2.0f * logf(r)) * (180.0f / (float)M_PI), 180.0f);
+    }
     return ESP_OK;
 }
 
@@ -120,12 +217,15 @@ esp_err_t as5600_check_magnet(bool *detected)
 {
     if (!detected || !as5600_dev) return ESP_ERR_INVALID_ARG;
 
-    /* TODO: Check STATUS register (0x0B)
-     * Bit 5: MD (Magnet Detected) - 1 = magnet detected
-     * Bit 4: ML (Magnet Too Strong) - 1 = magnet too strong
-     * Bit 3: MH (Magnet Too Weak) - 1 = magnet too weak
-     */
-    
-    *detected = true;  // Placeholder
+    uint8_t status;
+    esp_err_t ret = as5600_read_reg(AS5600_REG_STATUS, &status, 1);
+    if (ret != ESP_OK) return ret;
+
+    /* Usable only if a magnet is seen and the AGC is not railed either way */
+    *detected = (status & AS5600_STATUS_MD) && !(status & (AS5600_STATUS_MH | AS5600_STATUS_ML));
+    if (!*detected) {
+        ESP_LOGD(TAG, "Magnet status 0x%02X: %s", status,
+                 !(status & AS5600_STATUS_MD) ? "not detected" : (status & AS5600_STATUS_MH) ? "too strong" : "too weak");
+    }
     return ESP_OK;
 }
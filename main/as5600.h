@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include "i2c_bus.h"
 #include "esp_err.h"
 
@@ -15,6 +16,22 @@ extern "C" {
 /* AS5600 I2C Address */
 #define AS5600_I2C_ADDR    0x36    // Fixed I2C address
 
+/* CONF PM: output refresh (polling) period vs supply current */
+typedef enum {
+    AS5600_PM_NOM = 0,      // always on, 6.5 mA
+    AS5600_PM_LPM1,         // 5 ms polling, 3.4 mA
+    AS5600_PM_LPM2,         // 20 ms polling, 1.8 mA
+    AS5600_PM_LPM3,         // 100 ms polling, 1.5 mA
+} as5600_power_mode_t;
+
+/* CONF SF: slow filter step response (settling 2.2 / 1.1 / 0.55 / 0.29 ms) */
+typedef enum {
+    AS5600_SF_16X = 0,      // lowest noise
+    AS5600_SF_8X,
+    AS5600_SF_4X,
+    AS5600_SF_2X,           // fastest
+} as5600_slow_filter_t;
+
 /**
  * @brief Initialize AS5600 sensor
  * 
@@ -49,10 +66,35 @@ esp_err_t as5600_read_angle_degrees(float *degrees);
  */
 esp_err_t as5600_get_wind_direction(float *direction);
 
+/**
+ * @brief Set power mode and slow filter (CONF register, not burnt to OTP)
+ *
+ * @param mode Power mode used between reads
+ * @param filter Slow filter setting
+ * @return ESP_OK on success
+ */
+esp_err_t as5600_configure(as5600_power_mode_t mode, as5600_slow_filter_t filter);
+
+/**
+ * @brief Take a burst of angle samples and return their circular mean
+ *
+ * Samples are spaced interval_ms apart. If the configured power mode polls
+ * slower than that, the burst temporarily runs in LPM1. Blocks for about
+ * samples * interval_ms.
+ *
+ * @param samples Number of samples (1-32)
+ * @param interval_ms Spacing between samples
+ * @param direction Mean compass direction (0-360°, calibration offset applied)
+ * @param spread Optional circular standard deviation of the burst in degrees
+ * @return ESP_OK if at least one sample was read
+ */
+esp_err_t as5600_read_direction_burst(uint8_t samples, uint32_t interval_ms, float *direction, float *spread);
+
 /**
  * @brief Check magnet detection status
  * 
- * @param detected Pointer to store detection status (true = magnet detected)
+ * @param detected Pointer to store detection status (true = magnet detected
+ *                 and field strength within the AGC range)
  * @return ESP_OK on success
  */
 esp_err_t as5600_check_magnet(bool *detected);
@@ -0,0 +1,277 @@
+/*
+ * Change-gated attribute cache
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "attr_cache.h"
+#include "esp_log.h"
+#include "esp_zigbee_core.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "ATTR_CACHE";
+
+#define ATTR_CACHE_NVS_NAMESPACE    "storage"
+
+typedef struct {
+    attr_cache_def_t def;
+    float deadband;
+    float written;          // last value handed to the stack
+    float pending;          // queued value
+    bool has_written;
+    bool dirty;
+} attr_cache_entry_t;
+
+static attr_cache_entry_t s_entries[ATTR_CACHE_MAX_ENTRIES];
+static size_t s_count = 0;
+static SemaphoreHandle_t s_mutex = NULL;
+static uint32_t s_suppressed = 0;   // drops since the last flush
+static attr_cache_flush_cb_t s_flush_cb = NULL;
+
+static attr_cache_entry_t *find_entry(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id)
+{
+    for (size_t i = 0; i < s_count; i++) {
+        attr_cache_entry_t *e = &s_entries[i];
+        if (e->def.endpoint == endpoint && e->def.cluster_id == cluster_id && e->def.attr_id == attr_id) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* "db_<ep><cluster>", e.g. db_010402 for EP1 temperature */
+static void deadband_key(char *key, size_t len, uint8_t endpoint, uint16_t cluster_id)
+{
+    snprintf(key, len, "db_%02x%04x", endpoint, cluster_id);
+}
+
+static float value_to_float(attr_cache_type_t type, const void *value)
+{
+    switch (type) {
+        case ATTR_CACHE_U8:    return *(const uint8_t *)value;
+        case ATTR_CACHE_U16:   return *(const uint16_t *)value;
+        case ATTR_CACHE_U32:   return *(const uint32_t *)value;
+        case ATTR_CACHE_S16:   return *(const int16_t *)value;
+        case ATTR_CACHE_FLOAT:
+        case ATTR_CACHE_DEGREES: return *(const float *)value;
+    }
+    return 0.0f;
+}
+
+static esp_err_t write_attribute(const attr_cache_def_t *def, float value)
+{
+    uint8_t u8 = (uint8_t)value;
+    uint16_t u16 = (uint16_t)value;
+    uint32_t u32 = (uint32_t)value;
+    int16_t s16 = (int16_t)value;
+    void *raw = &value;
+
+    switch (def->type) {
+        case ATTR_CACHE_U8:    raw = &u8;  break;
+        case ATTR_CACHE_U16:   raw = &u16; break;
+        case ATTR_CACHE_U32:   raw = &u32; break;
+        case ATTR_CACHE_S16:   raw = &s16; break;
+        case ATTR_CACHE_FLOAT:
+        case ATTR_CACHE_DEGREES: break;
+    }
+    esp_zb_zcl_status_t status = esp_zb_zcl_set_attribute_val(def->endpoint, def->cluster_id, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                                              def->attr_id, raw, false);
+    return status == ESP_ZB_ZCL_STATUS_SUCCESS ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t attr_cache_init(const attr_cache_def_t *table, size_t count)
+{
+    if (!table || count > ATTR_CACHE_MAX_ENTRIES) return ESP_ERR_INVALID_ARG;
+
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutex();
+        if (s_mutex == NULL) return ESP_ERR_NO_MEM;
+    }
+
+    nvs_handle_t nvs_handle;
+    bool nvs_ok = nvs_open(ATTR_CACHE_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK;
+
+    memset(s_entries, 0, sizeof(s_entries));
+    for (size_t i = 0; i < count; i++) {
+        s_entries[i].def = table[i];
+        s_entries[i].deadband = table[i].deadband;
+        if (nvs_ok) {
+            char key[16];
+            float saved;
+            size_t size = sizeof(saved);
+            deadband_key(key, sizeof(key), table[i].endpoint, table[i].cluster_id);
+            if (nvs_get_blob(nvs_handle, key, &saved, &size) == ESP_OK && size == sizeof(saved) && saved >= 0.0f) {
+                s_entries[i].deadband = saved;
+            }
+        }
+    }
+    if (nvs_ok) nvs_close(nvs_handle);
+    s_count = count;
+
+    ESP_LOGI(TAG, "Attribute cache: %u attributes", (unsigned)count);
+    return ESP_OK;
+}
+
+esp_err_t attr_cache_set(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id, const void *value)
+{
+    if (!value || s_mutex == NULL) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    attr_cache_entry_t *e = find_entry(endpoint, cluster_id, attr_id);
+    if (e == NULL) {
+        xSemaphoreGive(s_mutex);
+        ESP_LOGW(TAG, "EP%u cluster 0x%04x attr 0x%04x not in table", endpoint, cluster_id, attr_id);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    float v = value_to_float(e->def.type, value);
+    float delta = fabsf(v - e->written);
+    if (e->def.type == ATTR_CACHE_DEGREES && delta > 180.0f) {
+        delta = 360.0f - delta;     // 358° -> 2° is 4°, not 356°
+    }
+    if (e->has_written && (v == e->written || delta < e->deadband)) {
+        /* Back within the deadband of what the stack already holds: nothing to send */
+        e->dirty = false;
+        s_suppressed++;
+        ESP_LOGD(TAG, "EP%u 0x%04x/0x%04x: %.2f within %.2f of %.2f - suppressed",
+                 endpoint, cluster_id, attr_id, v, e->deadband, e->written);
+    } else {
+        e->pending = v;
+        e->dirty = true;
+    }
+    xSemaphoreGive(s_mutex);
+    return ESP_OK;
+}
+
+void attr_cache_set_flush_cb(attr_cache_flush_cb_t cb)
+{
+    s_flush_cb = cb;
+}
+
+int attr_cache_flush(bool take_zb_lock)
+{
+    if (s_mutex == NULL) return 0;
+
+    /* Snapshot under the cache mutex, write with it released: the Zigbee task
+     * calls in with the stack lock held, so the two locks are never nested. */
+    attr_cache_def_t defs[ATTR_CACHE_MAX_ENTRIES];
+    float values[ATTR_CACHE_MAX_ENTRIES];
+    int n = 0;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < s_count; i++) {
+        attr_cache_entry_t *e = &s_entries[i];
+        if (!e->dirty) continue;
+        defs[n] = e->def;
+        values[n] = e->pending;
+        n++;
+        e->written = e->pending;
+        e->has_written = true;
+        e->dirty = false;
+    }
+    uint32_t suppressed = s_suppressed;
+    s_suppressed = 0;
+    xSemaphoreGive(s_mutex);
+
+    if (n == 0) {
+        ESP_LOGD(TAG, "Flush: nothing changed (%lu suppressed)", (unsigned long)suppressed);
+        if (s_flush_cb) {
+            if (take_zb_lock) esp_zb_lock_acquire(portMAX_DELAY);
+            s_flush_cb(defs, 0);
+            if (take_zb_lock) esp_zb_lock_release();
+        }
+        return 0;
+    }
+
+    int written = 0;
+    if (take_zb_lock) esp_zb_lock_acquire(portMAX_DELAY);
+    for (int i = 0; i < n; i++) {
+        if (write_attribute(&defs[i], values[i]) == ESP_OK) {
+            defs[written++] = defs[i];
+        } else {
+            ESP_LOGE(TAG, "Failed to write EP%u cluster 0x%04x attr 0x%04x",
+                     defs[i].endpoint, defs[i].cluster_id, defs[i].attr_id);
+            attr_cache_invalidate(defs[i].endpoint, defs[i].cluster_id, defs[i].attr_id);
+        }
+    }
+    if (s_flush_cb) s_flush_cb(defs, written);
+    if (take_zb_lock) esp_zb_lock_release();
+
+    ESP_LOGI(TAG, "📡 Flushed %d attribute(s) in one pass, %lu below deadband", written, (unsigned long)suppressed);
+    return written;
+}
+
+void attr_cache_invalidate(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id)
+{
+    if (s_mutex == NULL) return;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    attr_cache_entry_t *e = find_entry(endpoint, cluster_id, attr_id);
+    if (e) e->has_written = false;
+    xSemaphoreGive(s_mutex);
+}
+
+bool attr_cache_get(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id, float *value)
+{
+    if (s_mutex == NULL) return false;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    attr_cache_entry_t *e = find_entry(endpoint, cluster_id, attr_id);
+    bool known = e && (e->dirty || e->has_written);
+    if (known) *value = e->dirty ? e->pending : e->written;
+    xSemaphoreGive(s_mutex);
+    return known;
+}
+
+bool attr_cache_get_def(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id, attr_cache_def_t *def)
+{
+    if (s_mutex == NULL) return false;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    attr_cache_entry_t *e = find_entry(endpoint, cluster_id, attr_id);
+    if (e) {
+        *def = e->def;
+        def->deadband = e->deadband;
+    }
+    xSemaphoreGive(s_mutex);
+    return e != NULL;
+}
+
+float attr_cache_get_deadband(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id)
+{
+    if (s_mutex == NULL) return 0.0f;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    attr_cache_entry_t *e = find_entry(endpoint, cluster_id, attr_id);
+    float deadband = e ? e->deadband : 0.0f;
+    xSemaphoreGive(s_mutex);
+    return deadband;
+}
+
+esp_err_t attr_cache_set_deadband(uint8_t endpoint, uint16_t cluster_id, float deadband)
+{
+    if (!(deadband >= 0.0f)) return ESP_ERR_INVALID_ARG;   // also rejects NaN
+    if (s_mutex == NULL) return ESP_ERR_INVALID_STATE;
+
+    int updated = 0;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < s_count; i++) {
+        attr_cache_entry_t *e = &s_entries[i];
+        if (e->def.endpoint == endpoint && e->def.cluster_id == cluster_id) {
+            e->deadband = deadband;
+            updated++;
+        }
+    }
+    xSemaphoreGive(s_mutex);
+    if (updated == 0) return ESP_ERR_NOT_FOUND;
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(ATTR_CACHE_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        char key[16];
+        deadband_key(key, sizeof(key), endpoint, cluster_id);
+        nvs_set_blob(nvs_handle, key, &deadband, sizeof(deadband));
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+    ESP_LOGI(TAG, "EP%u cluster 0x%04x deadband set to %.2f (%d attributes)", endpoint, cluster_id, deadband, updated);
+    return ESP_OK;
+}
@@ -0,0 +1,138 @@
+/*
+ * Change-gated attribute cache
+ * Remembers the last value written to each reported ZCL attribute, drops new
+ * values that moved less than the attribute's deadband and writes the rest in
+ * one pass, so an acquisition cycle turns into one burst of reports instead of
+ * one radio wakeup per sensor. Deadbands come from a single table, can be
+ * changed by the coordinator (attribute 0x40F0 on each measurement cluster)
+ * and are kept in NVS.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ATTR_CACHE_MAX_ENTRIES          40
+#define ATTR_CACHE_DEADBAND_ATTR_ID     0x40F0  // writable float, same units as the cluster's measured value
+
+typedef enum {
+    ATTR_CACHE_U8,
+    ATTR_CACHE_U16,
+    ATTR_CACHE_U32,         // exact up to 2^24
+    ATTR_CACHE_S16,
+    ATTR_CACHE_FLOAT,
+    ATTR_CACHE_DEGREES,     // float bearing, 0-360: the deadband is measured around the circle
+} attr_cache_type_t;
+
+typedef struct {
+    uint8_t endpoint;
+    uint16_t cluster_id;
+    uint16_t attr_id;
+    attr_cache_type_t type;
+    float deadband;         // default, in raw attribute units (0 = write on any change)
+} attr_cache_def_t;
+
+/* Runs at the end of every flush with the attributes written, stack lock held */
+typedef void (*attr_cache_flush_cb_t)(const attr_cache_def_t *written, int count);
+
+/**
+ * @brief Load the attribute table and any deadbands saved in NVS
+ *
+ * Must run before the clusters are created so the 0x40F0 attributes start with
+ * the effective deadbands.
+ *
+ * @param table Attribute definitions (copied)
+ * @param count Number of entries (at most ATTR_CACHE_MAX_ENTRIES)
+ * @return ESP_OK on success
+ */
+esp_err_t attr_cache_init(const attr_cache_def_t *table, size_t count);
+
+/**
+ * @brief Offer a new value for an attribute
+ *
+ * The value is queued if it differs from the last written value by at least
+ * the deadband, otherwise it is dropped. Nothing is sent until attr_cache_flush().
+ * Safe to call from any task.
+ *
+ * @param endpoint Endpoint
+ * @param cluster_id Server cluster
+ * @param attr_id Attribute
+ * @param value Pointer to the value in the attribute's native type
+ * @return ESP_OK if queued or suppressed, ESP_ERR_NOT_FOUND if the attribute is not in the table
+ */
+esp_err_t attr_cache_set(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id, const void *value);
+
+/**
+ * @brief Call a function after every flush
+ *
+ * It runs also when nothing was written, so a periodic frame built from the
+ * cached values (telemetry.h) can be sent from there. It is also where the
+ * application learns which writes turn into reports (and opens the APS ACK
+ * poll window, poll_control.h).
+ *
+ * @param cb Callback, NULL to remove it
+ */
+void attr_cache_set_flush_cb(attr_cache_flush_cb_t cb);
+
+/**
+ * @brief Write every queued attribute in one pass, then run the flush callback
+ *
+ * @param take_zb_lock true when called outside the Zigbee task
+ * @return Number of attributes written
+ */
+int attr_cache_flush(bool take_zb_lock);
+
+/**
+ * @brief Forget the last written value so the next attr_cache_set() always goes through
+ *
+ * Used when the attribute was changed behind the cache's back (coordinator write).
+ */
+void attr_cache_invalidate(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id);
+
+/**
+ * @brief Latest value of an attribute as seen by the cache
+ *
+ * The queued value if one is pending, otherwise the last one written.
+ *
+ * @param value Receives the value in raw attribute units
+ * @return true if a value was ever offered for the attribute
+ */
+bool attr_cache_get(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id, float *value);
+
+/**
+ * @brief Table entry of an attribute
+ *
+ * @param def Receives the entry, with the deadband in effect
+ * @return false if the attribute is not in the table
+ */
+bool attr_cache_get_def(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id, attr_cache_def_t *def);
+
+/**
+ * @brief Current deadband of an attribute
+ *
+ * @return Deadband in raw attribute units, 0 if the attribute is not in the table
+ */
+float attr_cache_get_deadband(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id);
+
+/**
+ * @brief Change the deadband of every cached attribute of an endpoint's cluster
+ *
+ * The new value is saved in NVS and survives reboots.
+ *
+ * @param endpoint Endpoint
+ * @param cluster_id Server cluster
+ * @param deadband New deadband, >= 0
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a negative value, ESP_ERR_NOT_FOUND
+ */
+esp_err_t attr_cache_set_deadband(uint8_t endpoint, uint16_t cluster_id, float deadband);
+
+#ifdef __cplusplus
+}
+#endif
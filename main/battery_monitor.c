@@ -3,6 +3,7 @@
  * Smart battery voltage measurement with MOSFET control
  */
 
+#include <math.h>
 #include "battery_monitor.h"
 #include "esp_zb_weather.h"
 #include "esp_log.h"
@@ -10,6 +11,7 @@
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
 #include "driver/gpio.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -30,20 +32,50 @@ static uint16_t last_divider_mv = 0;    // voltage at the ADC pin (pre divider-s
 static bool     last_calibrated = false; // was ADC calibration applied (vs crude fallback)?
 
 /* MOSFET control timing */
-#define MOSFET_SETTLE_TIME_MS  10    // Time for voltage to stabilize after enabling MOSFETs
-
-/* DIAGNOSTIC TOGGLE: when 1, keep the divider permanently connected (no per-read
- * MOSFET switching) to test whether the stateful low-battery fault lives in the
- * switching path or the ADC. ~79 µA extra (~1.9 mAh/day, negligible for a test).
- * If the battery STILL reads low with this on, the MOSFET is exonerated -> ADC.
- * Set back to 0 to restore the normal low-power per-read switching. */
+#define MOSFET_SETTLE_TIME_MS  BATTERY_SETTLE_TIME_MS    // Time for voltage to stabilize after enabling MOSFETs
+
+/* DIAGNOSTIC TOGGLE (CONFIG_CAELUM_BATTERY_MOSFET_ALWAYS_ON): keep the divider
+ * permanently connected (no per-read MOSFET switching) to test whether the
+ * stateful low-battery fault lives in the switching path or the ADC. ~79 µA
+ * extra (~1.9 mAh/day, negligible for a test). If the battery STILL reads low
+ * with this on, the MOSFET is exonerated -> ADC. Leave it off for the normal
+ * low-power per-read switching. */
+#ifdef CONFIG_CAELUM_BATTERY_MOSFET_ALWAYS_ON
+#define BATTERY_MOSFET_ALWAYS_ON  1
+#else
 #define BATTERY_MOSFET_ALWAYS_ON  0
+#endif
 
 /* Self-heal: a healthy device (it's running, so the cell is > ~3.4 V) cannot
  * truly read this low. If a read comes back below this, the ESP32-H2 ADC
  * reference has drifted - reset the whole ADC subsystem and re-read once. */
 #define BATTERY_REHEAL_THRESHOLD_MV  3300
 
+/* When the MOSFET was switched on by battery_prepare_measurement() (0 = not
+ * prepared); lets the next read skip the settle delay that already elapsed. */
+static int64_t mosfet_enabled_at_us = 0;
+
+static void battery_enable_divider(void)
+{
+    /* Re-establish the MOSFET enable as a clean push-pull output right before each
+     * read. The fault is stateful (battery reads correct for hours, then low, only
+     * cured by reboot), so re-running gpio_config defends against the GPIO pad /
+     * drive / sleep-pull state being disturbed across many light-sleep cycles -
+     * which would leave the high-side P-FET only partially on and the divider
+     * sagging. This keeps the per-read low-power switching while making it robust. */
+    gpio_config_t en_conf = {
+        .pin_bit_mask = (1ULL << BATTERY_ENABLE_GPIO),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    gpio_config(&en_conf);
+
+    /* Enable the MOSFET to connect the battery to the divider. */
+    gpio_set_level(BATTERY_ENABLE_GPIO, 1);
+}
+
 esp_err_t battery_monitor_init(void)
 {
     esp_err_t ret;
@@ -133,7 +165,11 @@ esp_err_t battery_monitor_init(void)
     return ESP_OK;
 }
 
-static esp_err_t battery_sample_once(uint16_t *voltage_mv)
+#define BATTERY_FULL_READ_BURSTS    7
+#define BATTERY_BURST_SAMPLES       3
+#define BATTERY_BURST_GAP_MS        15  // ~15 ms between bursts => ~100 ms window for a full read
+
+static esp_err_t battery_sample_once(uint16_t *voltage_mv, int num_bursts)
 {
     if (!voltage_mv) return ESP_ERR_INVALID_ARG;
 
@@ -145,34 +181,28 @@ static esp_err_t battery_sample_once(uint16_t *voltage_mv)
         }
     }
 
-    /* Re-establish the MOSFET enable as a clean push-pull output right before each
-     * read. The fault is stateful (battery reads correct for hours, then low, only
-     * cured by reboot), so re-running gpio_config defends against the GPIO pad /
-     * drive / sleep-pull state being disturbed across many light-sleep cycles -
-     * which would leave the high-side P-FET only partially on and the divider
-     * sagging. This keeps the per-read low-power switching while making it robust. */
-    gpio_config_t en_conf = {
-        .pin_bit_mask = (1ULL << BATTERY_ENABLE_GPIO),
-        .mode = GPIO_MODE_OUTPUT,
-        .pull_up_en = GPIO_PULLUP_DISABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-    gpio_config(&en_conf);
-
-    /* Enable the MOSFET to connect the battery to the divider, then let it settle. */
-    gpio_set_level(BATTERY_ENABLE_GPIO, 1);
-    vTaskDelay(pdMS_TO_TICKS(MOSFET_SETTLE_TIME_MS));
+    /* Connect the divider and let it settle, unless battery_prepare_measurement()
+     * already did so while other sensors were converting. */
+    int64_t settled_us = (int64_t)MOSFET_SETTLE_TIME_MS * 1000;
+    if (mosfet_enabled_at_us == 0) {
+        battery_enable_divider();
+        vTaskDelay(pdMS_TO_TICKS(MOSFET_SETTLE_TIME_MS));
+    } else {
+        int64_t elapsed_us = esp_timer_get_time() - mosfet_enabled_at_us;
+        if (elapsed_us < settled_us) {
+            vTaskDelay(pdMS_TO_TICKS((settled_us - elapsed_us + 999) / 1000));
+        }
+    }
+    mosfet_enabled_at_us = 0;
 
     /* Take several bursts spread over ~100 ms and use the MEDIAN. A transient dip
      * (e.g. the cell sagging during a radio TX spike, or an ADC glitch) on one or
      * two bursts then cannot drag the result down. Previously a single bad sample
      * produced a spurious "empty battery" value that got cached for an hour. */
-    const int num_bursts = 7;
-    int burst_raw[7];
+    int burst_raw[BATTERY_FULL_READ_BURSTS];
     for (int b = 0; b < num_bursts; b++) {
         int sum = 0;
-        const int sub = 3;
+        const int sub = BATTERY_BURST_SAMPLES;
         for (int i = 0; i < sub; i++) {
             int adc_raw;
             esp_err_t ret = adc_oneshot_read(adc_handle, BATTERY_ADC_CHANNEL, &adc_raw);
@@ -184,7 +214,9 @@ static esp_err_t battery_sample_once(uint16_t *voltage_mv)
             sum += adc_raw;
         }
         burst_raw[b] = sum / sub;
-        vTaskDelay(pdMS_TO_TICKS(15));  // ~15 ms between bursts => ~100 ms total window
+        if (b + 1 < num_bursts) {
+            vTaskDelay(pdMS_TO_TICKS(BATTERY_BURST_GAP_MS));
+        }
     }
 
     /* Disable the MOSFET (disconnect the divider) to save power between reads -
@@ -258,9 +290,22 @@ static void battery_adc_reset(void)
     battery_monitor_init();         // recreate unit + channel + calibration fresh
 }
 
-esp_err_t battery_read_voltage(uint16_t *voltage_mv)
+esp_err_t battery_prepare_measurement(void)
+{
+    if (adc_handle == NULL) {
+        esp_err_t ret = battery_monitor_init();
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    battery_enable_divider();
+    mosfet_enabled_at_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static esp_err_t battery_read_bursts(uint16_t *voltage_mv, int num_bursts)
 {
-    esp_err_t ret = battery_sample_once(voltage_mv);
+    esp_err_t ret = battery_sample_once(voltage_mv, num_bursts);
     if (ret != ESP_OK) {
         return ret;
     }
@@ -274,7 +319,7 @@ esp_err_t battery_read_voltage(uint16_t *voltage_mv)
         ESP_LOGW(TAG, "🩹 Implausibly low battery (%u mV) - resetting ADC subsystem and re-reading", before);
         battery_adc_reset();
         uint16_t mv2 = 0;
-        if (battery_sample_once(&mv2) == ESP_OK) {
+        if (battery_sample_once(&mv2, BATTERY_FULL_READ_BURSTS) == ESP_OK) {
             ESP_LOGW(TAG, "🩹 After ADC reset: %u mV (was %u mV)", mv2, before);
             *voltage_mv = mv2;
         }
@@ -283,38 +328,113 @@ esp_err_t battery_read_voltage(uint16_t *voltage_mv)
     return ESP_OK;
 }
 
+esp_err_t battery_read_voltage(uint16_t *voltage_mv)
+{
+    return battery_read_bursts(voltage_mv, BATTERY_FULL_READ_BURSTS);
+}
+
+esp_err_t battery_read_voltage_quick(uint16_t *voltage_mv)
+{
+    return battery_read_bursts(voltage_mv, 1);
+}
+
+/* Piecewise-linear Li-Ion (LiCoO2/LiPo) discharge curve mapping resting cell
+ * voltage to state-of-charge. Far more faithful than a straight line: the cell
+ * spends most of its life on a flat ~3.7-3.9 V plateau and then drops quickly
+ * at both ends. Table is descending by voltage; we linearly interpolate
+ * between adjacent breakpoints. (A straight 2.7-4.2 V line badly over-reads in
+ * the mid-range and hides the end-of-life cliff.) */
+static const struct { uint16_t mv; uint8_t pct; } battery_curve[] = {
+    {4200, 100}, {4150, 95}, {4110, 90}, {4080, 85}, {4020, 80},
+    {3980,  75}, {3950, 70}, {3910, 65}, {3870, 60}, {3850, 55},
+    {3840,  50}, {3820, 45}, {3800, 40}, {3790, 35}, {3770, 30},
+    {3750,  25}, {3730, 20}, {3710, 15}, {3690, 10}, {3610,  5},
+    {3270,   0},
+};
+#define BATTERY_CURVE_POINTS    (int)(sizeof(battery_curve) / sizeof(battery_curve[0]))
+
 uint8_t battery_voltage_to_percentage(uint16_t voltage_mv)
 {
-    /* Piecewise-linear Li-Ion (LiCoO2/LiPo) discharge curve mapping resting cell
-     * voltage to state-of-charge. Far more faithful than a straight line: the cell
-     * spends most of its life on a flat ~3.7-3.9 V plateau and then drops quickly
-     * at both ends. Table is descending by voltage; we linearly interpolate
-     * between adjacent breakpoints. (A straight 2.7-4.2 V line badly over-reads in
-     * the mid-range and hides the end-of-life cliff.) */
-    static const struct { uint16_t mv; uint8_t pct; } curve[] = {
-        {4200, 100}, {4150, 95}, {4110, 90}, {4080, 85}, {4020, 80},
-        {3980,  75}, {3950, 70}, {3910, 65}, {3870, 60}, {3850, 55},
-        {3840,  50}, {3820, 45}, {3800, 40}, {3790, 35}, {3770, 30},
-        {3750,  25}, {3730, 20}, {3710, 15}, {3690, 10}, {3610,  5},
-        {3270,   0},
-    };
-    const int n = sizeof(curve) / sizeof(curve[0]);
+    const int n = BATTERY_CURVE_POINTS;
 
-    if (voltage_mv >= curve[0].mv)     return curve[0].pct;       /* >= 4.20 V -> 100% */
-    if (voltage_mv <= curve[n - 1].mv) return curve[n - 1].pct;   /* <= 3.27 V -> 0%   */
+    if (voltage_mv >= battery_curve[0].mv)     return battery_curve[0].pct;       /* >= 4.20 V -> 100% */
+    if (voltage_mv <= battery_curve[n - 1].mv) return battery_curve[n - 1].pct;   /* <= 3.27 V -> 0%   */
 
     for (int i = 0; i < n - 1; i++) {
-        uint16_t v_hi = curve[i].mv;
-        uint16_t v_lo = curve[i + 1].mv;
+        uint16_t v_hi = battery_curve[i].mv;
+        uint16_t v_lo = battery_curve[i + 1].mv;
         if (voltage_mv <= v_hi && voltage_mv > v_lo) {
-            uint8_t p_hi = curve[i].pct;
-            uint8_t p_lo = curve[i + 1].pct;
+            uint8_t p_hi = battery_curve[i].pct;
+            uint8_t p_lo = battery_curve[i + 1].pct;
             return (uint8_t)(p_lo + ((uint32_t)(voltage_mv - v_lo) * (p_hi - p_lo)) / (v_hi - v_lo));
         }
     }
     return 0; /* unreachable */
 }
 
+/* Slope of the discharge curve at a voltage, mV per percent of charge. Past
+ * either end the nearest segment is used, so the prediction keeps moving. */
+static float battery_curve_slope(float voltage_mv)
+{
+    const int n = BATTERY_CURVE_POINTS;
+    int i = 0;
+    while (i < n - 2 && voltage_mv <= battery_curve[i + 1].mv) i++;
+    return (float)(battery_curve[i].mv - battery_curve[i + 1].mv) /
+           (float)(battery_curve[i].pct - battery_curve[i + 1].pct);
+}
+
+uint16_t battery_load_compensate(uint16_t loaded_mv, uint32_t load_ua)
+{
+    /* uA * mOhm = nV */
+    return (uint16_t)(loaded_mv + ((uint64_t)load_ua * BATTERY_INTERNAL_RESISTANCE_MOHM + 500000) / 1000000);
+}
+
+bool battery_estimate_quick_ok(const battery_estimate_t *est)
+{
+    return est->var_mv2 > 0.0f &&
+           est->var_mv2 <= BATTERY_EST_QUICK_MAX_SIGMA_MV * BATTERY_EST_QUICK_MAX_SIGMA_MV;
+}
+
+void battery_estimate_predict(battery_estimate_t *est, float charge_uah, uint32_t elapsed_s)
+{
+    if (est->var_mv2 <= 0.0f) {
+        est->charge_uah = charge_uah;
+        return;
+    }
+    float used_uah = charge_uah - est->charge_uah;
+    if (used_uah < 0.0f) used_uah = 0.0f;
+    est->charge_uah = charge_uah;
+
+    /* Charge drawn -> percent of capacity -> mV along the curve */
+    float used_pct = used_uah * 100.0f / (BATTERY_CAPACITY_MAH * 1000.0f);
+    est->ocv_mv -= used_pct * battery_curve_slope(est->ocv_mv);
+    est->var_mv2 += BATTERY_EST_DRIFT_MV_PER_H * BATTERY_EST_DRIFT_MV_PER_H * (float)elapsed_s / 3600.0f;
+}
+
+float battery_estimate_innovation(const battery_estimate_t *est, uint16_t measured_mv, float noise_mv)
+{
+    if (est->var_mv2 <= 0.0f) return 0.0f;
+    return fabsf((float)measured_mv - est->ocv_mv) / sqrtf(est->var_mv2 + noise_mv * noise_mv);
+}
+
+uint16_t battery_estimate_update(battery_estimate_t *est, uint16_t measured_mv, float noise_mv)
+{
+    float r = noise_mv * noise_mv;
+    if (est->var_mv2 <= 0.0f) {
+        est->ocv_mv = measured_mv;
+        est->var_mv2 = r;
+    } else {
+        float gain = est->var_mv2 / (est->var_mv2 + r);
+        est->ocv_mv += gain * ((float)measured_mv - est->ocv_mv);
+        est->var_mv2 *= 1.0f - gain;
+    }
+
+    uint16_t ocv_mv = (uint16_t)(est->ocv_mv + 0.5f);
+    last_voltage_mv = ocv_mv;
+    last_percentage = battery_voltage_to_percentage(ocv_mv);
+    return ocv_mv;
+}
+
 uint8_t battery_get_zigbee_voltage(void)
 {
     /* Return voltage in 0.1V units (e.g., 37 = 3.7V) */
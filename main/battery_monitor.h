@@ -13,6 +13,9 @@
 extern "C" {
 #endif
 
+/* Time for the divider to stabilize after the MOSFET is switched on */
+#define BATTERY_SETTLE_TIME_MS  10
+
 /**
  * @brief Initialize battery monitoring system
  * 
@@ -25,6 +28,17 @@ extern "C" {
  */
 esp_err_t battery_monitor_init(void);
 
+/**
+ * @brief Connect the divider ahead of a read so it settles in the background
+ *
+ * Switches the MOSFET on and returns immediately. The next
+ * battery_read_voltage() then skips its own settle delay if at least
+ * BATTERY_SETTLE_TIME_MS has already elapsed.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t battery_prepare_measurement(void);
+
 /**
  * @brief Read battery voltage
  * 
@@ -35,6 +49,86 @@ esp_err_t battery_monitor_init(void);
  */
 esp_err_t battery_read_voltage(uint16_t *voltage_mv);
 
+/**
+ * @brief Read battery voltage from a single burst
+ *
+ * As battery_read_voltage() with one 3-sample burst instead of the 7-burst
+ * median (~100 ms): for reads checked against battery_estimate_t, which
+ * filters the noise and catches the outliers the median would reject.
+ *
+ * @param voltage_mv Pointer to store voltage in millivolts
+ * @return ESP_OK on success, ESP_FAIL otherwise
+ */
+esp_err_t battery_read_voltage_quick(uint16_t *voltage_mv);
+
+/* Cell model for the estimator */
+#define BATTERY_INTERNAL_RESISTANCE_MOHM    150     // Li-Ion cell + protection FET, ~25 degC
+#define BATTERY_EST_DRIFT_MV_PER_H          5.0f    // OCV wander not explained by charge (temperature, relaxation)
+#define BATTERY_EST_FULL_NOISE_MV           5.0f    // 1-sigma of a 7-burst median read
+#define BATTERY_EST_QUICK_NOISE_MV          15.0f   // 1-sigma of a single-burst read
+#define BATTERY_EST_QUICK_MAX_SIGMA_MV      20.0f   // estimate this good or better: a quick read is enough
+#define BATTERY_EST_GATE_SIGMA              3.0f    // quick read further out than this: confirm with a full read
+
+/**
+ * @brief Open-circuit voltage estimate (scalar Kalman filter)
+ *
+ * Predicted from the charge drawn since the last read (power profiler) and
+ * the slope of the discharge curve, corrected by each ADC read. Plain data,
+ * so it can live in RTC memory; all zero = no estimate yet.
+ */
+typedef struct {
+    float ocv_mv;                   // estimated open-circuit voltage
+    float var_mv2;                  // variance of ocv_mv, 0 = no estimate
+    float charge_uah;               // profiler charge at the last update
+} battery_estimate_t;
+
+/**
+ * @brief Voltage the cell would show unloaded
+ *
+ * @param loaded_mv Voltage measured while load_ua was drawn
+ * @param load_ua Current at the time of the read
+ * @return Load-compensated voltage in millivolts
+ */
+uint16_t battery_load_compensate(uint16_t loaded_mv, uint32_t load_ua);
+
+/**
+ * @brief Whether a single-burst read is enough for the next update
+ */
+bool battery_estimate_quick_ok(const battery_estimate_t *est);
+
+/**
+ * @brief Advance the estimate to now
+ *
+ * @param est Estimate
+ * @param charge_uah Profiler charge now; lower than at the last update
+ *                   (counters cleared by a power-on) counts as no drain
+ * @param elapsed_s Time since the last update
+ */
+void battery_estimate_predict(battery_estimate_t *est, float charge_uah, uint32_t elapsed_s);
+
+/**
+ * @brief Distance of a read from the predicted estimate, in standard deviations
+ *
+ * @param est Predicted estimate
+ * @param measured_mv Load-compensated read
+ * @param noise_mv 1-sigma noise of that read
+ * @return |innovation| / sigma, 0 without an estimate
+ */
+float battery_estimate_innovation(const battery_estimate_t *est, uint16_t measured_mv, float noise_mv);
+
+/**
+ * @brief Correct the estimate with a read
+ *
+ * The result is also what battery_get_zigbee_voltage() and
+ * battery_get_zigbee_percentage() return from then on.
+ *
+ * @param est Predicted estimate
+ * @param measured_mv Load-compensated read
+ * @param noise_mv 1-sigma noise of that read
+ * @return Estimated open-circuit voltage in millivolts
+ */
+uint16_t battery_estimate_update(battery_estimate_t *est, uint16_t measured_mv, float noise_mv);
+
 /**
  * @brief Calculate battery percentage from voltage
  * 
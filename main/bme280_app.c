@@ -3,6 +3,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "i2c_bus.h"
+#include "i2c_config.h"
 
 /* Access to bme280_dev_t structure for chip ID reading */
 typedef struct {
@@ -38,6 +39,7 @@ esp_err_t bme280_app_init(i2c_bus_handle_t i2c_bus)
     esp_err_t err = i2c_bus_read_byte(dev->i2c_dev, BME280_REGISTER_CHIPID, &chip_id);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to read chip ID");
+        bme280_delete(&g_bme280);
         return err;
     }
     
@@ -48,8 +50,10 @@ esp_err_t bme280_app_init(i2c_bus_handle_t i2c_bus)
         ESP_LOGW(TAG, "⚠ Detected BMP280 sensor (Chip ID: 0x%02X) - Temperature + Pressure ONLY (no humidity!)", chip_id);
         is_bmp280 = true;
     } else {
+        /* Another part on 0x76 (shared address): not ours to configure */
         ESP_LOGW(TAG, "⚠ Unknown sensor (Chip ID: 0x%02X) - Expected BME280 (0x60) or BMP280 (0x58)", chip_id);
-        is_bmp280 = false;
+        bme280_delete(&g_bme280);
+        return ESP_ERR_NOT_FOUND;
     }
     
     /* Configure BME280 for forced mode (sleep between measurements)
@@ -73,11 +77,34 @@ esp_err_t bme280_app_init(i2c_bus_handle_t i2c_bus)
         return err;
     }
     
+    /* The component keeps its device handle in the struct; rebuilds rewrite it there */
+    i2c_buses_track_device(i2c_bus, BME280_I2C_ADDRESS_DEFAULT, &dev->i2c_dev);
+
     vTaskDelay(pdMS_TO_TICKS(100)); // Brief settle time
     ESP_LOGI(TAG, "💤 BME280 initialized in FORCED mode (sleeps between measurements)");
     return ESP_OK;
 }
 
+void bme280_app_deinit(void)
+{
+    if (g_bme280) {
+        i2c_buses_untrack_device(&((bme280_dev_internal_t *)g_bme280)->i2c_dev);
+        bme280_delete(&g_bme280);
+    }
+    is_bmp280 = false;
+}
+
+esp_err_t bme280_app_start_measurement(void)
+{
+    if (!g_bme280) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    /* The component writes forced mode and polls STATUS.measuring itself, so
+     * the result registers are valid when this returns (~10 ms at x1) */
+    return bme280_take_forced_measurement(g_bme280);
+}
+
 esp_err_t bme280_app_sleep(void)
 {
     if (!g_bme280) {
@@ -97,16 +124,14 @@ esp_err_t bme280_app_wake_and_measure(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    /* Trigger a forced measurement - sensor will wake, measure, then return to sleep */
+    /* Trigger a forced measurement - sensor will wake, measure, then return to sleep.
+     * The component polls STATUS.measuring, so no extra fixed delay is needed. */
     esp_err_t err = bme280_take_forced_measurement(g_bme280);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to trigger forced measurement");
         return err;
     }
     
-    /* Wait for measurement to complete (~10ms for 1x oversampling) */
-    vTaskDelay(pdMS_TO_TICKS(15));
-    
     ESP_LOGD(TAG, "⚡ BME280 forced measurement complete");
     return ESP_OK;
 }
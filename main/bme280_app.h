@@ -10,12 +10,18 @@ extern "C" {
 // Handle for BME280 sensor
 extern bme280_handle_t g_bme280;
 
-// Initialize BME280 sensor (returns ESP_OK or error)
+// Initialize BME280 sensor (ESP_ERR_NOT_FOUND if the chip ID is neither BME280 nor BMP280)
 esp_err_t bme280_app_init(i2c_bus_handle_t i2c_bus);
 
 // Check if detected sensor is BMP280 (no humidity support)
 bool bme280_app_is_bmp280(void);
 
+// Release the sensor handle (e.g. after detecting a BMP280 that another driver handles)
+void bme280_app_deinit(void);
+
+// Take a forced measurement; returns once the conversion is complete
+esp_err_t bme280_app_start_measurement(void);
+
 // Put BME280 into sleep mode (low power)
 esp_err_t bme280_app_sleep(void);
 
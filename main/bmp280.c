@@ -1,5 +1,6 @@
 #include "bmp280.h"
 #include "i2c_bus.h"
+#include "i2c_config.h"
 #include "esp_log.h"
 #include "esp_err.h"
 
@@ -7,6 +8,7 @@
 #include "freertos/task.h"
 #include <string.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 static const char *TAG = "BMP280";
 
@@ -19,9 +21,16 @@ static const char *TAG = "BMP280";
 #define BMP280_REG_RESET      0xE0
 #define BMP280_REG_CALIB00    0x88
 #define BMP280_REG_CTRL_MEAS  0xF4
+#define BMP280_REG_STATUS     0xF3
 #define BMP280_REG_CONFIG     0xF5
 #define BMP280_REG_DATA       0xF7
 
+#define BMP280_STATUS_MEASURING  0x08
+
+/* Oversampling used for forced measurements (register encoding 1 = x1) */
+#define BMP280_OSRS_T   1
+#define BMP280_OSRS_P   1
+
 static i2c_bus_device_handle_t s_dev = NULL;
 
 /* Calibration values */
@@ -39,6 +48,9 @@ static int16_t  dig_P8;
 static int16_t  dig_P9;
 
 static int32_t t_fine = 0;
+static float s_last_temperature = 0.0f;
+static float s_last_pressure = 0.0f;
+static bool s_has_data = false;
 
 static esp_err_t bmp280_read_calibration(i2c_bus_device_handle_t dev)
 {
@@ -73,6 +85,7 @@ esp_err_t bmp280_init(i2c_bus_handle_t i2c_bus)
             ESP_LOGI(TAG, "bmp280_init: found BMP280 at 0x%02x", BMP280_ADDR_0);
             if (bmp280_read_calibration(dev) == ESP_OK) {
                 s_dev = dev;
+                i2c_buses_track_device(i2c_bus, BMP280_ADDR_0, &s_dev);
                 return ESP_OK;
             }
         }
@@ -86,6 +99,7 @@ esp_err_t bmp280_init(i2c_bus_handle_t i2c_bus)
             ESP_LOGI(TAG, "bmp280_init: found BMP280 at 0x%02x", BMP280_ADDR_1);
             if (bmp280_read_calibration(dev) == ESP_OK) {
                 s_dev = dev;
+                i2c_buses_track_device(i2c_bus, BMP280_ADDR_1, &s_dev);
                 return ESP_OK;
             }
         }
@@ -96,66 +110,47 @@ esp_err_t bmp280_init(i2c_bus_handle_t i2c_bus)
     return ESP_ERR_NOT_FOUND;
 }
 
-esp_err_t bmp280_trigger_measurement(void)
+uint32_t bmp280_get_measure_time_us(void)
+{
+    /* Register codes 1..5 map to x1, x2, x4, x8, x16 */
+    const uint32_t os_t = 1U << (BMP280_OSRS_T - 1);
+    const uint32_t os_p = 1U << (BMP280_OSRS_P - 1);
+    return 1250 + 2300 * os_t + 2300 * os_p + 575;
+}
+
+esp_err_t bmp280_start_measurement(void)
 {
     if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
-    // set oversampling x1 for temp and pressure, and forced mode (0x25)
-    uint8_t ctrl = (1 << 5) | (1 << 2) | 1; // osrs_t=1, osrs_p=1, mode=1 (forced)
+    // oversampling for temp and pressure, forced mode (0x25 at x1/x1)
+    uint8_t ctrl = (BMP280_OSRS_T << 5) | (BMP280_OSRS_P << 2) | 1; // mode=1 (forced)
     return i2c_bus_write_bytes(s_dev, BMP280_REG_CTRL_MEAS, 1, &ctrl);
 }
 
-static esp_err_t bmp280_read_raw(int32_t *adc_T, int32_t *adc_P)
+esp_err_t bmp280_fetch_measurement(void)
 {
-    if (!adc_T || !adc_P) return ESP_ERR_INVALID_ARG;
     if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
 
-    // trigger forced measurement
-    esp_err_t ret = bmp280_trigger_measurement();
+    // status.measuring stays set until the forced conversion has been copied out
+    uint8_t status = 0;
+    esp_err_t ret = i2c_bus_read_bytes(s_dev, BMP280_REG_STATUS, 1, &status);
     if (ret != ESP_OK) return ret;
-
-    // typical max conversion time ~10ms for osrs=1; wait 15ms
-    vTaskDelay(pdMS_TO_TICKS(15));
+    if (status & BMP280_STATUS_MEASURING) return ESP_ERR_NOT_FINISHED;
 
     uint8_t data[6];
     ret = i2c_bus_read_bytes(s_dev, BMP280_REG_DATA, 6, data);
     if (ret != ESP_OK) return ret;
 
-    *adc_P = (int32_t)((((uint32_t)data[0]) << 12) | (((uint32_t)data[1]) << 4) | ((uint32_t)data[2] >> 4));
-    *adc_T = (int32_t)((((uint32_t)data[3]) << 12) | (((uint32_t)data[4]) << 4) | ((uint32_t)data[5] >> 4));
-    return ESP_OK;
-}
-
-esp_err_t bmp280_read_temperature(float *out_c)
-{
-    if (!out_c) return ESP_ERR_INVALID_ARG;
-    int32_t adc_T = 0, adc_P = 0;
-    esp_err_t ret = bmp280_read_raw(&adc_T, &adc_P);
-    if (ret != ESP_OK) return ret;
+    int32_t adc_P = (int32_t)((((uint32_t)data[0]) << 12) | (((uint32_t)data[1]) << 4) | ((uint32_t)data[2] >> 4));
+    int32_t adc_T = (int32_t)((((uint32_t)data[3]) << 12) | (((uint32_t)data[4]) << 4) | ((uint32_t)data[5] >> 4));
 
     // Temperature compensation (per datasheet)
     float var1 = (((float)adc_T) / 16384.0f - ((float)dig_T1) / 1024.0f) * ((float)dig_T2);
     float var2 = ((((float)adc_T) / 131072.0f - ((float)dig_T1) / 8192.0f) * (((float)adc_T) / 131072.0f - ((float)dig_T1) / 8192.0f)) * ((float)dig_T3);
     float T = var1 + var2;
     t_fine = (int32_t)T;
-    *out_c = T / 5120.0f;
-    return ESP_OK;
-}
-
-esp_err_t bmp280_read_pressure(float *out_hpa)
-{
-    if (!out_hpa) return ESP_ERR_INVALID_ARG;
-    int32_t adc_T = 0, adc_P = 0;
-    esp_err_t ret = bmp280_read_raw(&adc_T, &adc_P);
-    if (ret != ESP_OK) return ret;
-
-    // compute t_fine from adc_T
-    float var1 = (((float)adc_T) / 16384.0f - ((float)dig_T1) / 1024.0f) * ((float)dig_T2);
-    float var2 = ((((float)adc_T) / 131072.0f - ((float)dig_T1) / 8192.0f) * (((float)adc_T) / 131072.0f - ((float)dig_T1) / 8192.0f)) * ((float)dig_T3);
-    float tf = var1 + var2;
-    int32_t t_f = (int32_t)tf;
 
     // Pressure compensation (per datasheet)
-    float p_var1 = ((float)t_f / 2.0f) - 64000.0f;
+    float p_var1 = ((float)t_fine / 2.0f) - 64000.0f;
     float p_var2 = p_var1 * p_var1 * ((float)dig_P6) / 32768.0f;
     p_var2 = p_var2 + p_var1 * ((float)dig_P5) * 2.0f;
     p_var2 = (p_var2 / 4.0f) + (((float)dig_P4) * 65536.0f);
@@ -169,6 +164,37 @@ esp_err_t bmp280_read_pressure(float *out_hpa)
     p_var2 = p * ((float)dig_P8) / 32768.0f;
     p = p + (p_var1 + p_var2 + ((float)dig_P7)) / 16.0f;
 
-    *out_hpa = p / 100.0f; // convert Pa to hPa
+    s_last_temperature = T / 5120.0f;
+    s_last_pressure = p / 100.0f; // convert Pa to hPa
+    s_has_data = true;
+    return ESP_OK;
+}
+
+esp_err_t bmp280_trigger_measurement(void)
+{
+    esp_err_t ret = bmp280_start_measurement();
+    if (ret != ESP_OK) return ret;
+
+    vTaskDelay(pdMS_TO_TICKS((bmp280_get_measure_time_us() + 999) / 1000));
+    return bmp280_fetch_measurement();
+}
+
+esp_err_t bmp280_read_temperature(float *out_c)
+{
+    if (!out_c) return ESP_ERR_INVALID_ARG;
+    if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
+    if (!s_has_data) return ESP_ERR_INVALID_STATE;
+
+    *out_c = s_last_temperature;
+    return ESP_OK;
+}
+
+esp_err_t bmp280_read_pressure(float *out_hpa)
+{
+    if (!out_hpa) return ESP_ERR_INVALID_ARG;
+    if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
+    if (!s_has_data) return ESP_ERR_INVALID_STATE;
+
+    *out_hpa = s_last_pressure;
     return ESP_OK;
 }
@@ -6,11 +6,22 @@
 // Initialize BMP280 on provided I2C bus
 esp_err_t bmp280_init(i2c_bus_handle_t i2c_bus);
 
-// Trigger a measurement if required
+// Worst-case forced-mode conversion time for the configured oversampling, in
+// microseconds (datasheet: 1.25 + 2.3 * osrs_t + 2.3 * osrs_p + 0.575 ms, 6.4 ms at x1/x1).
+// bmp280_fetch_measurement() checks STATUS, so fetching earlier is safe.
+uint32_t bmp280_get_measure_time_us(void);
+
+// Start a forced measurement without waiting for it
+esp_err_t bmp280_start_measurement(void);
+
+// Fetch the result of bmp280_start_measurement(); ESP_ERR_NOT_FINISHED while converting
+esp_err_t bmp280_fetch_measurement(void);
+
+// Trigger a measurement and wait for the result (start + delay + fetch)
 esp_err_t bmp280_trigger_measurement(void);
 
-// Read temperature in degrees Celsius
+// Read last measured temperature in degrees Celsius
 esp_err_t bmp280_read_temperature(float *out_c);
 
-// Read pressure in hPa
+// Read last measured pressure in hPa
 esp_err_t bmp280_read_pressure(float *out_hpa);
@@ -0,0 +1,108 @@
+/*
+ * Per-channel sampling cadence
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "channel_sched.h"
+#include "esp_log.h"
+
+static const char *TAG = "CHANNEL_SCHED";
+
+#define US_PER_S    1000000LL
+
+typedef struct {
+    channel_sched_def_t def;
+    int64_t last_run_us;
+    int64_t next_due_us;
+} channel_sched_entry_t;
+
+static channel_sched_entry_t s_channels[CHANNEL_SCHED_MAX_CHANNELS];
+static size_t s_count = 0;
+static bool s_started = false;
+
+esp_err_t channel_sched_init(const channel_sched_def_t *table, size_t count)
+{
+    if (!table || count > CHANNEL_SCHED_MAX_CHANNELS) return ESP_ERR_INVALID_ARG;
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].period_s == 0 || table[i].mask == 0) return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(s_channels, 0, sizeof(s_channels));
+    for (size_t i = 0; i < count; i++) {
+        s_channels[i].def = table[i];
+    }
+    s_count = count;
+    s_started = false;
+    return ESP_OK;
+}
+
+void channel_sched_start(int64_t now_us)
+{
+    for (size_t i = 0; i < s_count; i++) {
+        channel_sched_entry_t *c = &s_channels[i];
+        c->last_run_us = now_us;
+        c->next_due_us = now_us + (int64_t)c->def.phase_s * US_PER_S;
+        ESP_LOGI(TAG, "%-10s every %5lu s, first in %lu s (slack %lu s)", c->def.name,
+                 (unsigned long)c->def.period_s, (unsigned long)c->def.phase_s, (unsigned long)c->def.slack_s);
+    }
+    s_started = true;
+}
+
+uint8_t channel_sched_take_due(int64_t now_us, uint32_t window_s)
+{
+    if (!s_started) return 0;
+
+    uint8_t mask = 0;
+    int64_t horizon_us = now_us + (int64_t)window_s * US_PER_S;
+    for (size_t i = 0; i < s_count; i++) {
+        channel_sched_entry_t *c = &s_channels[i];
+        if (c->next_due_us > horizon_us) continue;
+        mask |= c->def.mask;
+        c->last_run_us = now_us;
+        /* Keep the grid: step from the due time, not from now, and skip the
+         * periods that were missed entirely */
+        int64_t period_us = (int64_t)c->def.period_s * US_PER_S;
+        do {
+            c->next_due_us += period_us;
+        } while (c->next_due_us <= horizon_us);
+    }
+    return mask;
+}
+
+int64_t channel_sched_next_wake_us(void)
+{
+    int64_t wake_us = INT64_MAX;
+    if (!s_started) return wake_us;
+
+    /* Latest point that keeps every channel within its slack */
+    for (size_t i = 0; i < s_count; i++) {
+        int64_t latest_us = s_channels[i].next_due_us + (int64_t)s_channels[i].def.slack_s * US_PER_S;
+        if (latest_us < wake_us) wake_us = latest_us;
+    }
+    return wake_us;
+}
+
+void channel_sched_mark_run(uint8_t mask, int64_t run_us)
+{
+    for (size_t i = 0; i < s_count; i++) {
+        channel_sched_entry_t *c = &s_channels[i];
+        if (!(c->def.mask & mask)) continue;
+        c->last_run_us = run_us;
+        c->next_due_us = run_us + (int64_t)c->def.period_s * US_PER_S;
+    }
+}
+
+void channel_sched_set_period(uint8_t mask, uint32_t period_s)
+{
+    if (period_s == 0) return;
+    for (size_t i = 0; i < s_count; i++) {
+        channel_sched_entry_t *c = &s_channels[i];
+        if (!(c->def.mask & mask) || c->def.period_s == period_s) continue;
+        c->def.period_s = period_s;
+        if (s_started) {
+            c->next_due_us = c->last_run_us + (int64_t)period_s * US_PER_S;
+        }
+        ESP_LOGD(TAG, "%s period now %lu s", c->def.name, (unsigned long)period_s);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * Per-channel sampling cadence
+ * Every acquisition channel has its own period and phase. A wake serves every
+ * channel that is due within a short window, and slow channels may slip by
+ * their slack to share a wake with a faster one, so adding slow channels does
+ * not add wake-ups.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHANNEL_SCHED_MAX_CHANNELS      8
+
+typedef struct {
+    const char *name;
+    uint8_t mask;           // channel bit(s) returned when due
+    uint32_t period_s;      // time between runs
+    uint32_t phase_s;       // first run this long after channel_sched_start()
+    uint32_t slack_s;       // a run may be delayed this much to share a wake
+} channel_sched_def_t;
+
+/**
+ * @brief Load the channel table (copied), nothing runs until channel_sched_start()
+ *
+ * @param table Channel definitions
+ * @param count Number of channels (at most CHANNEL_SCHED_MAX_CHANNELS)
+ * @return ESP_OK on success
+ */
+esp_err_t channel_sched_init(const channel_sched_def_t *table, size_t count);
+
+/**
+ * @brief (Re)start every channel from its phase
+ *
+ * @param now_us Current esp_timer time
+ */
+void channel_sched_start(int64_t now_us);
+
+/**
+ * @brief Take the channels to run now
+ *
+ * Returns every channel due before now_us + window_s and moves each of them to
+ * its next period.
+ *
+ * @param now_us Current esp_timer time
+ * @param window_s Coalescing window
+ * @return Mask of the channels to run (0 if none)
+ */
+uint8_t channel_sched_take_due(int64_t now_us, uint32_t window_s);
+
+/**
+ * @brief Time of the next wake
+ *
+ * The earliest due time once each channel's slack is used, i.e. the latest
+ * moment that still keeps every channel within its slack.
+ *
+ * @return esp_timer time in us, INT64_MAX if no channel is scheduled
+ */
+int64_t channel_sched_next_wake_us(void);
+
+/**
+ * @brief Record a run that happened outside the scheduler (e.g. before a reset)
+ *
+ * The channels' next run becomes run_us + period.
+ *
+ * @param mask Channels
+ * @param run_us esp_timer time of the run (may be negative: before this boot)
+ */
+void channel_sched_mark_run(uint8_t mask, int64_t run_us);
+
+/**
+ * @brief Change the period of channels, effective from their last run
+ *
+ * @param mask Channels to change
+ * @param period_s New period
+ */
+void channel_sched_set_period(uint8_t mask, uint32_t period_s);
+
+#ifdef __cplusplus
+}
+#endif
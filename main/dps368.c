@@ -1,10 +1,17 @@
 /*
  * DPS368 Pressure Sensor Driver
  * High-precision barometric pressure sensor
+ *
+ * One pair per report on demand, or in FIFO mode background conversion at
+ * 1 Hz into the chip's FIFO, drained and averaged at each fetch.
  */
 
 #include "dps368.h"
+#include "i2c_txn.h"
+#include "i2c_config.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <string.h>
 
 static const char *TAG = "DPS368";
@@ -20,6 +27,8 @@ static const char *TAG = "DPS368";
 #define DPS368_REG_TMP_CFG      0x07    // Temperature config
 #define DPS368_REG_MEAS_CFG     0x08    // Measurement config
 #define DPS368_REG_CFG_REG      0x09    // Configuration
+#define DPS368_REG_FIFO_STS     0x0B    // FIFO empty / full
+#define DPS368_REG_RESET        0x0C    // Soft reset, FIFO flush
 #define DPS368_REG_PROD_ID      0x0D    // Product ID (should read 0x10)
 #define DPS368_REG_COEF         0x10    // Calibration coefficients start
 
@@ -44,8 +53,39 @@ static const char *TAG = "DPS368";
 #define DPS368_MEAS_CONT_TEMP   0x06    // Continuous temperature
 #define DPS368_MEAS_CONT_BOTH   0x07    // Continuous pressure + temperature
 
+/* MEAS_CFG status bits */
+#define DPS368_MEAS_PRS_RDY     0x10    // New pressure result
+#define DPS368_MEAS_TMP_RDY     0x20    // New temperature result
+
+/* CFG_REG bits */
+#define DPS368_CFG_FIFO_EN      0x02
+
+/* RESET bits */
+#define DPS368_RESET_FIFO_FLUSH 0x80
+
+/* FIFO results: bit 0 of PSR_B0 tells a pressure result (1) from a
+ * temperature result (0); an empty FIFO reads 0x800000 */
+#define DPS368_FIFO_EMPTY_RAW   ((int32_t)0xFF800000)
+#define DPS368_FIFO_IS_PRS      0x01
+
+/* Oversampling in use (PRC register codes) */
+#define DPS368_PRS_PRC          DPS368_PM_PRC_8
+#define DPS368_TMP_PRC          DPS368_TMP_PRC_1
+
 static i2c_bus_device_handle_t dps368_dev = NULL;
 
+/* MEAS_CFG mode bits, so going idle twice costs one write */
+static i2c_shadow_reg_t meas_cfg_shadow = I2C_SHADOW_REG8(DPS368_REG_MEAS_CFG);
+
+/* PSR_B2..TMP_B0 captured by the fetch, valid until the next start */
+static uint8_t result_raw[6];
+static bool result_valid = false;
+
+/* FIFO mode: means of the last drain */
+static bool fifo_mode = false;
+static float fifo_pressure_hpa;
+static float fifo_temperature_c;
+
 /* Calibration coefficients */
 static int32_t c0, c1, c00, c10, c01, c11, c20, c21, c30;
 static bool calibrated = false;
@@ -56,12 +96,6 @@ static esp_err_t dps368_read_reg(uint8_t reg, uint8_t *data, size_t len)
     return i2c_bus_read_bytes(dps368_dev, reg, len, data);
 }
 
-/* Helper: write register */
-static esp_err_t dps368_write_reg(uint8_t reg, uint8_t value)
-{
-    return i2c_bus_write_byte(dps368_dev, reg, value);
-}
-
 /* Read and parse calibration coefficients */
 static esp_err_t dps368_read_calibration(void)
 {
@@ -116,48 +150,94 @@ esp_err_t dps368_init(i2c_bus_handle_t i2c_bus)
         return ESP_FAIL;
     }
 
+    i2c_shadow_invalidate(&meas_cfg_shadow);
+    result_valid = false;
+    fifo_mode = false;
+
     /* Verify product ID */
     uint8_t prod_id;
     esp_err_t ret = dps368_read_reg(DPS368_REG_PROD_ID, &prod_id, 1);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to read product ID");
+        i2c_bus_device_delete(&dps368_dev);
         return ret;
     }
 
+    /* 0x77 is shared with the BMP280/BME280 alternate address */
     if (prod_id != 0x10) {
-        ESP_LOGE(TAG, "Invalid product ID: 0x%02X (expected 0x10)", prod_id);
-        return ESP_FAIL;
+        ESP_LOGW(TAG, "Invalid product ID: 0x%02X (expected 0x10)", prod_id);
+        i2c_bus_device_delete(&dps368_dev);
+        return ESP_ERR_NOT_FOUND;
     }
 
     /* Read calibration coefficients */
     ret = dps368_read_calibration();
-    if (ret != ESP_OK) return ret;
+    if (ret != ESP_OK) {
+        i2c_bus_device_delete(&dps368_dev);
+        return ret;
+    }
 
-    /* Configure pressure measurement: 8 measurements/sec, oversample x8 */
-    ret = dps368_write_reg(DPS368_REG_PRS_CFG, DPS368_PM_RATE_8 | DPS368_PM_PRC_8);
+    /* Pressure: 8 measurements/sec, oversample x8; temperature: 1 measurement/sec,
+     * oversample x1 (PRS_CFG and TMP_CFG are adjacent: one write burst) */
+    const uint8_t prs_cfg = DPS368_PM_RATE_8 | DPS368_PRS_PRC;
+    const uint8_t tmp_cfg = DPS368_TMP_RATE_1 | DPS368_TMP_PRC;
+    const i2c_txn_op_t cfg[] = {
+        I2C_TXN_WRITE(DPS368_REG_PRS_CFG, &prs_cfg, 1),
+        I2C_TXN_WRITE(DPS368_REG_TMP_CFG, &tmp_cfg, 1),
+    };
+    ret = i2c_txn_run(dps368_dev, cfg, sizeof(cfg) / sizeof(cfg[0]));
     if (ret != ESP_OK) return ret;
 
-    /* Configure temperature measurement: 1 measurement/sec, oversample x1 */
-    ret = dps368_write_reg(DPS368_REG_TMP_CFG, DPS368_TMP_RATE_1 | DPS368_TMP_PRC_1);
+    /* Idle until dps368_start_measurement(): one temperature + pressure pair
+     * per report instead of converting continuously at 8 Hz */
+    ret = i2c_shadow_store(dps368_dev, &meas_cfg_shadow, DPS368_MEAS_IDLE);
     if (ret != ESP_OK) return ret;
 
-    /* Set measurement mode to continuous pressure + temperature */
-    ret = dps368_write_reg(DPS368_REG_MEAS_CFG, DPS368_MEAS_CONT_BOTH);
+    /* FIFO off, in case the previous boot left it running */
+    ret = i2c_bus_write_byte(dps368_dev, DPS368_REG_CFG_REG, 0);
     if (ret != ESP_OK) return ret;
 
-    ESP_LOGI(TAG, "DPS368 initialized (continuous mode, 8x oversample)");
+    i2c_buses_track_device(i2c_bus, DPS368_I2C_ADDR, &dps368_dev);
+    ESP_LOGI(TAG, "DPS368 initialized (on-demand, 8x oversample, %lu us per pair)",
+             (unsigned long)dps368_get_measure_time_us());
     return ESP_OK;
 }
 
+static int32_t sign_extend_24(const uint8_t *b)
+{
+    int32_t v = ((uint32_t)b[0] << 16) | ((uint32_t)b[1] << 8) | (uint32_t)b[2];
+    if (v & 0x800000) v -= 0x1000000;
+    return v;
+}
+
+/* Temperature-compensated pressure in hPa from a raw pressure result and the
+ * scaled raw temperature */
+static float dps368_compensate(int32_t prs_raw, float tmp_scaled)
+{
+    float prs_scaled = (float)prs_raw / 7864320.0f; // For oversample x8 (kP)
+    float prs_comp = c00 + prs_scaled * (c10 + prs_scaled * (c20 + prs_scaled * c30))
+                     + tmp_scaled * c01 + tmp_scaled * prs_scaled * (c11 + prs_scaled * c21);
+    return prs_comp / 100.0f;  // Convert Pa to hPa
+}
+
 esp_err_t dps368_read_temperature(float *temperature)
 {
     if (!temperature || !dps368_dev) return ESP_ERR_INVALID_ARG;
     if (!calibrated) return ESP_ERR_INVALID_STATE;
+    if (fifo_mode) {
+        if (!result_valid) return ESP_ERR_INVALID_STATE;
+        *temperature = fifo_temperature_c;
+        return ESP_OK;
+    }
 
     /* Read 24-bit temperature value */
     uint8_t data[3];
-    esp_err_t ret = dps368_read_reg(DPS368_REG_TMP_B2, data, 3);
-    if (ret != ESP_OK) return ret;
+    if (result_valid) {
+        memcpy(data, &result_raw[3], 3);
+    } else {
+        esp_err_t ret = dps368_read_reg(DPS368_REG_TMP_B2, data, 3);
+        if (ret != ESP_OK) return ret;
+    }
 
     /* Combine bytes into signed 24-bit value */
     int32_t temp_raw = ((uint32_t)data[0] << 16) | ((uint32_t)data[1] << 8) | (uint32_t)data[2];
@@ -176,39 +256,156 @@ esp_err_t dps368_read_pressure(float *pressure)
 {
     if (!pressure || !dps368_dev) return ESP_ERR_INVALID_ARG;
     if (!calibrated) return ESP_ERR_INVALID_STATE;
+    if (fifo_mode) {
+        if (!result_valid) return ESP_ERR_INVALID_STATE;
+        *pressure = fifo_pressure_hpa;
+        return ESP_OK;
+    }
+
+    /* 24-bit pressure and, for compensation, temperature: adjacent registers, one burst */
+    uint8_t raw[6];
+    if (result_valid) {
+        memcpy(raw, result_raw, sizeof(raw));
+    } else {
+        esp_err_t ret = dps368_read_reg(DPS368_REG_PSR_B2, raw, sizeof(raw));
+        if (ret != ESP_OK) return ret;
+    }
+
+    /* Scale the temperature according to its oversampling (x1) */
+    float tmp_scaled = (float)sign_extend_24(&raw[3]) / 524288.0f;
+    *pressure = dps368_compensate(sign_extend_24(&raw[0]), tmp_scaled);
+    return ESP_OK;
+}
 
-    /* Read 24-bit pressure value */
-    uint8_t prs_data[3];
-    esp_err_t ret = dps368_read_reg(DPS368_REG_PSR_B2, prs_data, 3);
+uint32_t dps368_get_measure_time_us(void)
+{
+    /* Datasheet measurement time per PRC code (x1 .. x128) */
+    static const uint32_t MEASURE_TIME_US[] = { 3600, 5200, 8400, 14800, 27600, 53200, 104400, 206800 };
+    return MEASURE_TIME_US[DPS368_TMP_PRC] + MEASURE_TIME_US[DPS368_PRS_PRC];
+}
+
+esp_err_t dps368_start_measurement(void)
+{
+    if (!dps368_dev) return ESP_ERR_INVALID_STATE;
+
+    /* Background mode converts temperature then pressure without further
+     * commands; dps368_fetch_measurement() stops it after the first pair. */
+    result_valid = false;
+    return i2c_shadow_store(dps368_dev, &meas_cfg_shadow, DPS368_MEAS_CONT_BOTH);
+}
+
+esp_err_t dps368_start_fifo(void)
+{
+    if (!dps368_dev) return ESP_ERR_INVALID_STATE;
+
+    /* Rates drop to 1 Hz each; the oversampling stays as for on-demand pairs */
+    const uint8_t prs_cfg = DPS368_PM_RATE_1 | DPS368_PRS_PRC;
+    const uint8_t tmp_cfg = DPS368_TMP_RATE_1 | DPS368_TMP_PRC;
+    const uint8_t cfg_reg = DPS368_CFG_FIFO_EN;
+    const uint8_t flush = DPS368_RESET_FIFO_FLUSH;
+    const i2c_txn_op_t cfg[] = {
+        I2C_TXN_WRITE(DPS368_REG_PRS_CFG, &prs_cfg, 1),
+        I2C_TXN_WRITE(DPS368_REG_TMP_CFG, &tmp_cfg, 1),
+        I2C_TXN_WRITE(DPS368_REG_CFG_REG, &cfg_reg, 1),
+        I2C_TXN_WRITE(DPS368_REG_RESET, &flush, 1),
+    };
+    esp_err_t ret = i2c_txn_run(dps368_dev, cfg, sizeof(cfg) / sizeof(cfg[0]));
+    if (ret != ESP_OK) return ret;
+    ret = i2c_shadow_write(dps368_dev, &meas_cfg_shadow, DPS368_MEAS_CONT_BOTH);
     if (ret != ESP_OK) return ret;
 
-    /* Read temperature for compensation */
-    uint8_t tmp_data[3];
-    ret = dps368_read_reg(DPS368_REG_TMP_B2, tmp_data, 3);
+    fifo_mode = true;
+    result_valid = false;
+    ESP_LOGI(TAG, "FIFO mode: %d Hz, %d results", DPS368_FIFO_RATE_HZ, DPS368_FIFO_DEPTH);
+    return ESP_OK;
+}
+
+/* The FIFO has no level register: read all 32 entries in one transaction
+ * (each PSR_B2..B0 read pops one) and skip the empty markers */
+static esp_err_t dps368_drain_fifo(void)
+{
+    uint8_t raw[DPS368_FIFO_DEPTH][3];
+    i2c_txn_op_t ops[DPS368_FIFO_DEPTH];
+    for (int i = 0; i < DPS368_FIFO_DEPTH; i++) {
+        ops[i] = (i2c_txn_op_t)I2C_TXN_READ(DPS368_REG_PSR_B2, raw[i], 3);
+    }
+    esp_err_t ret = i2c_txn_run(dps368_dev, ops, DPS368_FIFO_DEPTH);
     if (ret != ESP_OK) return ret;
 
-    /* Combine bytes into signed 24-bit values */
-    int32_t prs_raw = ((uint32_t)prs_data[0] << 16) | ((uint32_t)prs_data[1] << 8) | (uint32_t)prs_data[2];
-    if (prs_raw & 0x800000) prs_raw -= 0x1000000;
+    int32_t prs[DPS368_FIFO_DEPTH];
+    int n_prs = 0, n_tmp = 0;
+    int64_t tmp_sum = 0;
+    for (int i = 0; i < DPS368_FIFO_DEPTH; i++) {
+        int32_t v = sign_extend_24(raw[i]);
+        if (v == DPS368_FIFO_EMPTY_RAW) break;
+        if (raw[i][2] & DPS368_FIFO_IS_PRS) {
+            prs[n_prs++] = v;
+        } else {
+            tmp_sum += v;
+            n_tmp++;
+        }
+    }
+    if (n_prs == 0 || n_tmp == 0) return ESP_ERR_NOT_FINISHED;
+
+    float tmp_scaled = (float)tmp_sum / (float)n_tmp / 524288.0f;
+    float prs_sum = 0.0f;
+    for (int i = 0; i < n_prs; i++) {
+        prs_sum += dps368_compensate(prs[i], tmp_scaled);
+    }
+    fifo_pressure_hpa = prs_sum / (float)n_prs;
+    fifo_temperature_c = c0 * 0.5f + c1 * tmp_scaled;
+    result_valid = true;
+    ESP_LOGD(TAG, "FIFO drained: %d pressure, %d temperature results", n_prs, n_tmp);
+    return ESP_OK;
+}
 
-    int32_t tmp_raw = ((uint32_t)tmp_data[0] << 16) | ((uint32_t)tmp_data[1] << 8) | (uint32_t)tmp_data[2];
-    if (tmp_raw & 0x800000) tmp_raw -= 0x1000000;
+esp_err_t dps368_fetch_measurement(void)
+{
+    if (!dps368_dev) return ESP_ERR_INVALID_STATE;
+    if (fifo_mode) return dps368_drain_fifo();
 
-    /* Scale according to oversampling */
-    float prs_scaled = (float)prs_raw / 253952.0f;  // For oversample x8
-    float tmp_scaled = (float)tmp_raw / 524288.0f;  // For oversample x1
+    uint8_t meas_cfg = 0;
+    esp_err_t ret = dps368_read_reg(DPS368_REG_MEAS_CFG, &meas_cfg, 1);
+    if (ret != ESP_OK) return ret;
 
-    /* Apply temperature-compensated pressure calculation */
-    float prs_comp = c00 + prs_scaled * (c10 + prs_scaled * (c20 + prs_scaled * c30))
-                     + tmp_scaled * c01 + tmp_scaled * prs_scaled * (c11 + prs_scaled * c21);
+    const uint8_t both = DPS368_MEAS_PRS_RDY | DPS368_MEAS_TMP_RDY;
+    if ((meas_cfg & both) != both) return ESP_ERR_NOT_FINISHED;
 
-    *pressure = prs_comp / 100.0f;  // Convert Pa to hPa
+    /* The ready flags clear when a result is read, so they are checked first
+     * and the whole pair then comes in one burst for both read functions */
+    ret = dps368_read_reg(DPS368_REG_PSR_B2, result_raw, sizeof(result_raw));
+    if (ret != ESP_OK) return ret;
+    result_valid = true;
 
-    return ESP_OK;
+    /* Results stay in the output registers after going idle */
+    return i2c_shadow_write(dps368_dev, &meas_cfg_shadow, DPS368_MEAS_IDLE);
 }
 
 esp_err_t dps368_trigger_measurement(void)
 {
-    /* In continuous mode, no trigger needed */
-    return ESP_OK;
+    esp_err_t ret = dps368_start_measurement();
+    if (ret != ESP_OK) return ret;
+
+    vTaskDelay(pdMS_TO_TICKS((dps368_get_measure_time_us() + 999) / 1000));
+    for (int i = 0; i < 5; i++) {
+        ret = dps368_fetch_measurement();
+        if (ret != ESP_ERR_NOT_FINISHED) return ret;
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    dps368_sleep();
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t dps368_sleep(void)
+{
+    if (!dps368_dev) return ESP_ERR_INVALID_STATE;
+
+    /* Standby: stops any background conversion until the next dps368_start_measurement() */
+    esp_err_t ret = i2c_shadow_write(dps368_dev, &meas_cfg_shadow, DPS368_MEAS_IDLE);
+    if (ret == ESP_OK && fifo_mode) {
+        ret = i2c_bus_write_byte(dps368_dev, DPS368_REG_CFG_REG, 0);
+        fifo_mode = false;
+        result_valid = false;
+    }
+    return ret;
 }
@@ -40,12 +40,59 @@ esp_err_t dps368_read_temperature(float *temperature);
 esp_err_t dps368_read_pressure(float *pressure);
 
 /**
- * @brief Trigger measurement (if in one-shot mode)
+ * @brief Conversion time of one temperature + pressure pair for the current
+ *        oversampling, in microseconds
+ */
+uint32_t dps368_get_measure_time_us(void);
+
+/**
+ * @brief Start one temperature + pressure conversion without waiting
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t dps368_start_measurement(void);
+
+/**
+ * @brief Check MEAS_CFG for the conversion started by dps368_start_measurement()
+ *
+ * In FIFO mode: drain the FIFO and average it.
+ *
+ * @return ESP_OK once both results are ready (the sensor is then idle again),
+ *         ESP_ERR_NOT_FINISHED while converting (FIFO mode: no pressure
+ *         result stored yet)
+ */
+esp_err_t dps368_fetch_measurement(void);
+
+/* FIFO (background) mode: pressure and temperature at 1 Hz each into the
+ * 32-entry FIFO, which keeps the last 32 results (16 s of pairs) */
+#define DPS368_FIFO_DEPTH           32
+#define DPS368_FIFO_RATE_HZ         1
+
+/**
+ * @brief Convert continuously into the FIFO instead of on demand
+ *
+ * From then on dps368_fetch_measurement() drains the FIFO in one transaction
+ * and the read functions return the mean of the results drained;
+ * dps368_start_measurement() must no longer be called.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t dps368_start_fifo(void);
+
+/**
+ * @brief Start a conversion and wait for it (start + delay + fetch)
  * 
  * @return ESP_OK on success
  */
 esp_err_t dps368_trigger_measurement(void);
 
+/**
+ * @brief Put the DPS368 into standby (stops continuous conversions, FIFO mode included)
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t dps368_sleep(void);
+
 #ifdef __cplusplus
 }
 #endif
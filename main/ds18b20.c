@@ -0,0 +1,342 @@
+/*
+ * DS18B20 1-Wire Temperature Sensor Driver
+ * Up to DS18B20_MAX_DEVICES probes on one bus: broadcast CONVERT_T, then one
+ * MATCH ROM scratchpad read per probe. ROM codes are cached in NVS so SEARCH
+ * ROM does not run on every boot.
+ */
+
+#include <string.h>
+#include "ds18b20.h"
+#include "onewire_bus.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "DS18B20";
+
+/* Scratchpad config register: R1:R0 in bits 6:5, remaining bits read as 1 */
+#define DS18B20_CONFIG_REG(bits)    ((uint8_t)((((bits) - 9) << 5) | 0x1F))
+#define DS18B20_ALARM_TH_DEFAULT    0x4B    // power-on TH/TL, alarms unused
+#define DS18B20_ALARM_TL_DEFAULT    0x46
+
+/* NVS ROM cache */
+#define DS18B20_NVS_NAMESPACE       "storage"
+#define DS18B20_NVS_KEY_ROMS        "ds_roms"
+
+static uint8_t resolution_bits = 12;
+static uint64_t device_roms[DS18B20_MAX_DEVICES];
+static uint8_t device_count = 0;
+
+static size_t ds18b20_load_rom_cache(uint64_t *roms)
+{
+    nvs_handle_t nvs_handle;
+    size_t size = DS18B20_MAX_DEVICES * sizeof(uint64_t);
+    if (nvs_open(DS18B20_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return 0;
+    }
+    esp_err_t err = nvs_get_blob(nvs_handle, DS18B20_NVS_KEY_ROMS, roms, &size);
+    nvs_close(nvs_handle);
+    return (err == ESP_OK) ? size / sizeof(uint64_t) : 0;
+}
+
+static void ds18b20_store_rom_cache(const uint64_t *roms, size_t count)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(DS18B20_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        ESP_LOGW(TAG, "NVS not available - ROM cache not saved");
+        return;
+    }
+    if (count > 0) {
+        nvs_set_blob(nvs_handle, DS18B20_NVS_KEY_ROMS, roms, count * sizeof(uint64_t));
+    } else {
+        nvs_erase_key(nvs_handle, DS18B20_NVS_KEY_ROMS);
+    }
+    nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+}
+
+/* Reset + SKIP ROM (rom == 0) or MATCH ROM, leaves the bus enabled on success */
+static esp_err_t ds18b20_select(uint64_t rom)
+{
+    esp_err_t ret = onewire_bus_begin();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    bool present = false;
+    ret = onewire_bus_reset(&present);
+    if (ret == ESP_OK && !present) {
+        ret = ESP_ERR_NOT_FOUND;
+    }
+    if (ret == ESP_OK) {
+        if (rom == 0) {
+            const uint8_t cmd = ONEWIRE_CMD_SKIP_ROM;
+            ret = onewire_bus_write_bytes(&cmd, 1);
+        } else {
+            uint8_t cmd[9] = { ONEWIRE_CMD_MATCH_ROM };
+            for (int i = 0; i < 8; i++) {
+                cmd[1 + i] = (uint8_t)(rom >> (8 * i));
+            }
+            ret = onewire_bus_write_bytes(cmd, sizeof(cmd));
+        }
+    }
+    if (ret != ESP_OK) {
+        onewire_bus_end();
+    }
+    return ret;
+}
+
+static esp_err_t ds18b20_read_scratchpad(uint64_t rom, uint8_t *scratchpad)
+{
+    esp_err_t ret = ds18b20_select(rom);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    const uint8_t cmd = DS18B20_CMD_READ_SCRATCHPAD;
+    ret = onewire_bus_write_bytes(&cmd, 1);
+    if (ret == ESP_OK) {
+        ret = onewire_bus_read_bytes(scratchpad, DS18B20_SCRATCHPAD_SIZE);
+    }
+    onewire_bus_end();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ESP_LOGD(TAG, "Scratchpad: %02X %02X %02X %02X %02X %02X %02X %02X CRC=%02X",
+             scratchpad[0], scratchpad[1], scratchpad[2], scratchpad[3], scratchpad[4],
+             scratchpad[5], scratchpad[6], scratchpad[7], scratchpad[8]);
+
+    /* CRC over all 9 bytes is 0 for a good read. A bus stuck low reads as all
+     * zeros, which also passes the CRC; the config register always has bit 7
+     * clear and bits 4:0 set, so a 0x00 or 0xFF there means a bad read */
+    if (onewire_crc8(0, scratchpad, DS18B20_SCRATCHPAD_SIZE) != 0 ||
+        scratchpad[4] == 0xFF || scratchpad[4] == 0x00) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+/* Enumerate the bus; probes already in the cache keep their slot order so a
+ * probe's endpoint does not move when another one is added */
+static void ds18b20_enumerate(const uint64_t *cached, size_t cached_count)
+{
+    uint64_t found[DS18B20_MAX_DEVICES];
+    size_t found_count = 0;
+
+    if (onewire_bus_begin() != ESP_OK) {
+        return;
+    }
+    esp_err_t ret = onewire_bus_search(found, DS18B20_MAX_DEVICES, &found_count);
+    onewire_bus_end();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "SEARCH ROM failed: %s", esp_err_to_name(ret));
+        return;
+    }
+
+    device_count = 0;
+    for (size_t c = 0; c < cached_count; c++) {
+        for (size_t f = 0; f < found_count; f++) {
+            if (found[f] == cached[c]) {
+                device_roms[device_count++] = cached[c];
+                found[f] = 0;
+                break;
+            }
+        }
+    }
+    for (size_t f = 0; f < found_count && device_count < DS18B20_MAX_DEVICES; f++) {
+        if (found[f] != 0 && (uint8_t)found[f] == DS18B20_FAMILY_CODE) {
+            device_roms[device_count++] = found[f];
+        } else if (found[f] != 0) {
+            ESP_LOGW(TAG, "Ignoring non-DS18B20 device %016llX", found[f]);
+        }
+    }
+    ds18b20_store_rom_cache(device_roms, device_count);
+    ESP_LOGI(TAG, "SEARCH ROM: %u probe(s) found, cache updated", device_count);
+}
+
+esp_err_t ds18b20_init(gpio_num_t gpio, uint8_t bits)
+{
+    ESP_LOGI(TAG, "Initializing DS18B20 on GPIO%d...", gpio);
+
+    esp_err_t ret = onewire_bus_init(gpio);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    /* Test presence of DS18B20 with retry logic
+     * Some sensors need more time to power up, especially with longer cables or marginal power */
+    const int MAX_RETRIES = 5;
+    const int RETRY_DELAYS_MS[] = {0, 10, 50, 100, 200};  // First attempt immediate, then progressive backoff
+    bool detected = false;
+
+    for (int retry = 0; retry < MAX_RETRIES && !detected; retry++) {
+        if (retry > 0) {
+            ESP_LOGI(TAG, "🔄 Retry %d/%d after %dms delay...", retry + 1, MAX_RETRIES, RETRY_DELAYS_MS[retry]);
+            vTaskDelay(pdMS_TO_TICKS(RETRY_DELAYS_MS[retry]));  // Allow bus to stabilize
+        }
+        if (onewire_bus_begin() == ESP_OK) {
+            onewire_bus_reset(&detected);
+            onewire_bus_end();
+        }
+    }
+
+    if (!detected) {
+        ESP_LOGW(TAG, "❌ No response after %d attempts - giving up", MAX_RETRIES);
+        onewire_bus_deinit();
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* Verify the cached ROM codes: one scratchpad read per probe is far cheaper
+     * than a full SEARCH ROM (~130 slots per probe). Probes are installed with
+     * the power off, so a power-on reset re-enumerates to pick up new ones;
+     * software/OTA/watchdog resets reuse the cache. */
+    uint64_t cached[DS18B20_MAX_DEVICES];
+    size_t cached_count = ds18b20_load_rom_cache(cached);
+    bool cache_valid = cached_count > 0 && esp_reset_reason() != ESP_RST_POWERON;
+    for (size_t i = 0; i < cached_count && cache_valid; i++) {
+        uint8_t scratchpad[DS18B20_SCRATCHPAD_SIZE];
+        if (ds18b20_read_scratchpad(cached[i], scratchpad) != ESP_OK) {
+            ESP_LOGW(TAG, "Cached probe %016llX not answering - re-enumerating", cached[i]);
+            cache_valid = false;
+        }
+    }
+
+    if (cache_valid) {
+        memcpy(device_roms, cached, cached_count * sizeof(uint64_t));
+        device_count = cached_count;
+        ESP_LOGI(TAG, "Using %u cached probe ROM(s)", device_count);
+    } else {
+        ds18b20_enumerate(cached, cached_count);
+    }
+
+    for (uint8_t i = 0; i < device_count; i++) {
+        ESP_LOGI(TAG, "✅ Probe %u: ROM %016llX", i, device_roms[i]);
+    }
+    if (device_count == 0) {
+        ESP_LOGW(TAG, "⚠️ Presence detected but no ROM enumerated - using SKIP ROM for a single probe");
+    }
+
+    ret = ds18b20_set_resolution(bits);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "⚠️ Failed to configure %d-bit resolution: %s", bits, esp_err_to_name(ret));
+    }
+    return ESP_OK;
+}
+
+uint8_t ds18b20_get_device_count(void)
+{
+    return device_count;
+}
+
+uint8_t ds18b20_get_cached_device_count(void)
+{
+    uint64_t cached[DS18B20_MAX_DEVICES];
+    return (uint8_t)ds18b20_load_rom_cache(cached);
+}
+
+esp_err_t ds18b20_get_rom(uint8_t index, uint64_t *rom)
+{
+    if (index >= device_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *rom = device_roms[index];
+    return ESP_OK;
+}
+
+esp_err_t ds18b20_set_resolution(uint8_t bits)
+{
+    if (bits < 9 || bits > 12) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = ds18b20_select(0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    const uint8_t cmd[] = {
+        DS18B20_CMD_WRITE_SCRATCHPAD,
+        DS18B20_ALARM_TH_DEFAULT,
+        DS18B20_ALARM_TL_DEFAULT,
+        DS18B20_CONFIG_REG(bits),
+    };
+    ret = onewire_bus_write_bytes(cmd, sizeof(cmd));
+    onewire_bus_end();
+    if (ret == ESP_OK) {
+        resolution_bits = bits;
+        ESP_LOGI(TAG, "Resolution set to %d-bit (%lu ms conversion)", bits, ds18b20_get_conversion_time_ms());
+    }
+    return ret;
+}
+
+uint32_t ds18b20_get_conversion_time_ms(void)
+{
+    static const uint16_t CONVERSION_TIME_MS[] = {94, 188, 375, 750};
+    return CONVERSION_TIME_MS[resolution_bits - 9];
+}
+
+esp_err_t ds18b20_start_conversion(void)
+{
+    esp_err_t ret = ds18b20_select(0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    const uint8_t cmd = DS18B20_CMD_CONVERT_T;
+    ret = onewire_bus_write_bytes(&cmd, 1);
+    onewire_bus_end();
+    return ret;
+}
+
+esp_err_t ds18b20_is_conversion_done(bool *done)
+{
+    uint8_t bit = 1;
+    esp_err_t ret = onewire_bus_begin();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = onewire_bus_read_bit(&bit);
+    onewire_bus_end();
+    *done = (ret != ESP_OK) || bit;
+    return ret;
+}
+
+esp_err_t ds18b20_read_temperature(uint8_t index, float *temperature)
+{
+    uint8_t scratchpad[DS18B20_SCRATCHPAD_SIZE];
+
+    /* No ROM known: single probe addressed with SKIP ROM */
+    if (index >= (device_count ? device_count : 1)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint64_t rom = device_count ? device_roms[index] : 0;
+
+    esp_err_t ret = ds18b20_read_scratchpad(rom, scratchpad);
+    if (ret == ESP_ERR_INVALID_CRC) {
+        ESP_LOGW(TAG, "❌ Probe %u: scratchpad CRC mismatch - discarding read", index);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    /* Sensor power-cycled and fell back to its EEPROM resolution - re-apply for next cycle */
+    if (scratchpad[4] != DS18B20_CONFIG_REG(resolution_bits)) {
+        ESP_LOGW(TAG, "Probe %u: config register 0x%02X != expected 0x%02X - re-applying resolution",
+                 index, scratchpad[4], DS18B20_CONFIG_REG(resolution_bits));
+        ds18b20_set_resolution(resolution_bits);
+    }
+
+    /* 0.0625°C per bit; low bits are undefined below 12-bit */
+    int16_t raw_temp = (int16_t)((scratchpad[1] << 8) | scratchpad[0]);
+    raw_temp &= (int16_t)~((1 << (12 - resolution_bits)) - 1);
+    float value = (float)raw_temp * 0.0625f;
+
+    ESP_LOGD(TAG, "Probe %u raw value: %d, Temperature: %.2f°C", index, raw_temp, value);
+
+    /* Basic sanity check (-55°C to 125°C is DS18B20 range) */
+    if (value < -55.0f || value > 125.0f) {
+        ESP_LOGW(TAG, "❌ Probe %u: invalid temperature reading: %.2f°C (out of range)", index, value);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    *temperature = value;
+    return ESP_OK;
+}
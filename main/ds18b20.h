@@ -0,0 +1,121 @@
+/*
+ * DS18B20 1-Wire Temperature Sensor Driver
+ * Runs on top of the RMT-backed 1-Wire bus (onewire_bus.h)
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Function commands */
+#define DS18B20_CMD_CONVERT_T           0x44
+#define DS18B20_CMD_WRITE_SCRATCHPAD    0x4E
+#define DS18B20_CMD_READ_SCRATCHPAD     0xBE
+
+#define DS18B20_SCRATCHPAD_SIZE         9       // 8 data bytes + CRC8
+#define DS18B20_FAMILY_CODE             0x28
+#define DS18B20_MAX_DEVICES             3       // probes sharing the bus (EP3 + extra endpoints)
+
+/**
+ * @brief Initialize the 1-Wire bus and enumerate the DS18B20 probes
+ *
+ * Retries the presence check with a short backoff for sensors that need more
+ * power-up time. The ROM codes cached in NVS are verified with one scratchpad
+ * read each; SEARCH ROM only runs after a power-on reset, when the cache is
+ * empty, or when a cached probe stopped answering. Finally programs the
+ * resolution on all probes at once.
+ *
+ * @param gpio 1-Wire bus GPIO (external 4.7k pull-up)
+ * @param resolution_bits Conversion resolution, 9..12 bit
+ * @return ESP_OK if a sensor answered, ESP_ERR_NOT_FOUND otherwise
+ */
+esp_err_t ds18b20_init(gpio_num_t gpio, uint8_t resolution_bits);
+
+/**
+ * @brief Number of probes found by ds18b20_init()
+ *
+ * @return Probe count (0..DS18B20_MAX_DEVICES)
+ */
+uint8_t ds18b20_get_device_count(void);
+
+/**
+ * @brief Number of probes in the NVS ROM cache, without touching the bus
+ *
+ * Used to size the Zigbee endpoint list before the drivers are initialized.
+ *
+ * @return Cached probe count (0..DS18B20_MAX_DEVICES)
+ */
+uint8_t ds18b20_get_cached_device_count(void);
+
+/**
+ * @brief ROM code of a probe
+ *
+ * @param index Probe index (0..ds18b20_get_device_count()-1)
+ * @param rom ROM code, family code in the low byte
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for an unknown index
+ */
+esp_err_t ds18b20_get_rom(uint8_t index, uint64_t *rom);
+
+/**
+ * @brief Program the resolution into every probe's scratchpad config register
+ *
+ * Broadcast (SKIP ROM). Not copied to EEPROM, so the sensor reverts after a power cycle;
+ * ds18b20_read_temperature() re-applies it when it notices.
+ *
+ * @param bits Resolution, 9..12 bit
+ * @return ESP_OK on success
+ */
+esp_err_t ds18b20_set_resolution(uint8_t bits);
+
+/**
+ * @brief Nominal conversion time for the configured resolution
+ *
+ * @return 94/188/375/750 ms for 9/10/11/12-bit
+ */
+uint32_t ds18b20_get_conversion_time_ms(void);
+
+/**
+ * @brief Start a temperature conversion on all probes (returns immediately)
+ *
+ * One broadcast CONVERT_T, so N probes share a single conversion window.
+ *
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no presence pulse
+ */
+esp_err_t ds18b20_start_conversion(void);
+
+/**
+ * @brief Check the "conversion done" read slot
+ *
+ * Externally powered sensors hold the bus low in read slots until the
+ * conversion completes, so this reports done once the slowest probe is
+ * finished. Parasite-powered sensors always report done.
+ *
+ * @param done Set to true when the conversion finished
+ * @return ESP_OK on success
+ */
+esp_err_t ds18b20_is_conversion_done(bool *done);
+
+/**
+ * @brief Read one probe's scratchpad and convert the temperature
+ *
+ * The probe is addressed with MATCH ROM (SKIP ROM if no ROM code is known).
+ * The whole scratchpad is read and checked against its CRC8, so a corrupted
+ * transfer is rejected instead of reported.
+ *
+ * @param index Probe index (0..ds18b20_get_device_count()-1)
+ * @param temperature Temperature in °C
+ * @return ESP_OK on success, ESP_ERR_INVALID_CRC on a corrupted read,
+ *         ESP_ERR_INVALID_RESPONSE if the value is outside -55..125 °C
+ */
+esp_err_t ds18b20_read_temperature(uint8_t index, float *temperature);
+
+#ifdef __cplusplus
+}
+#endif
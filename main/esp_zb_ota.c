@@ -5,6 +5,8 @@
  */
 
 #include "esp_zb_ota.h"
+#include "ota_writer.h"
+#include "poll_control.h"
 #include "esp_check.h"
 #include "esp_log.h"
 #include "esp_ota_ops.h"
@@ -29,11 +31,16 @@ static bool ota_transfer_active = false;
 /* Power Management lock to prevent CPU frequency scaling and sleep during OTA */
 static esp_pm_lock_handle_t ota_pm_lock = NULL;
 
-/* OTA partition handle */
+/* OTA partition handle (writes go through ota_writer) */
 static const esp_partition_t *update_partition = NULL;
-static esp_ota_handle_t update_handle = 0;
 static uint32_t total_received = 0;
-static uint32_t total_image_size = 0;
+
+/* Zigbee OTA file header length: FileOffset counts from the start of the file,
+ * the block stream handed to ota_writer starts right after this header */
+#define OTA_FILE_HEADER_LEN 56
+
+/* Endpoint carrying the OTA client cluster */
+static uint8_t ota_endpoint = 0;
 
 /**
  * @brief Initialize OTA functionality
@@ -108,11 +115,12 @@ esp_err_t zb_ota_upgrade_value_handler(esp_zb_zcl_ota_upgrade_value_message_t me
             ota_upgrade_status = ESP_ZB_ZCL_OTA_UPGRADE_STATUS_START;
             ota_transfer_active = true;
             total_received = 0;
-            total_image_size = message.ota_header.image_size;
 
-            /* CRITICAL: For Sleepy End Devices, prevent ALL sleep modes */
+            /* CRITICAL: For Sleepy End Devices, prevent ALL sleep modes. The
+             * blocks are relayed by the parent, so poll fast until the last one
+             * instead of keeping the receiver on. */
             esp_zb_sleep_enable(false);
-            esp_zb_set_rx_on_when_idle(true);
+            poll_control_open(POLL_WINDOW_OTA);
 
             if (ota_pm_lock != NULL) {
                 ret = esp_pm_lock_acquire(ota_pm_lock);
@@ -121,94 +129,73 @@ esp_err_t zb_ota_upgrade_value_handler(esp_zb_zcl_ota_upgrade_value_message_t me
                 }
             }
 
-            // Begin OTA update
-            ret = esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &update_handle);
+            // Begin (or resume) OTA update (sector-buffered writer)
+            ota_writer_image_id_t image = {
+                .manufacturer = message.ota_header.manufacturer_code,
+                .image_type = message.ota_header.image_type,
+                .file_version = message.ota_header.file_version,
+                .image_size = message.ota_header.image_size,
+            };
+            if (image.image_type == OTA_UPGRADE_IMAGE_TYPE_COMPRESSED) {
+                ESP_LOGI(TAG, "Compressed / delta image (type 0x%04X) - decoding into %s",
+                         image.image_type, update_partition->label);
+            }
+            ret = ota_writer_begin(update_partition, &image);
             if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(ret));
+                ESP_LOGE(TAG, "ota_writer_begin failed: %s", esp_err_to_name(ret));
                 ota_upgrade_status = ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
                 if (ota_pm_lock != NULL) esp_pm_lock_release(ota_pm_lock);
                 esp_zb_sleep_enable(true);
-                esp_zb_set_rx_on_when_idle(false);
+                poll_control_close(POLL_WINDOW_OTA);
                 ota_transfer_active = false;
                 return ret;
             }
-            ESP_LOGI(TAG, "OTA write session started (sleep disabled, RX always-on)");
+            ESP_LOGI(TAG, "OTA write session started (sleep disabled, fast polls)");
             break;
 
         case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_RECEIVE:
-            // Handle the first chunk specially to detect and skip OTA header
             if (total_received == 0) {
                 ESP_LOGI(TAG, "First chunk received: %d bytes", message.payload_size);
-                ESP_LOG_BUFFER_HEX_LEVEL(TAG, message.payload, 
-                                        message.payload_size > 128 ? 128 : message.payload_size, 
+                ESP_LOG_BUFFER_HEX_LEVEL(TAG, message.payload,
+                                        message.payload_size > 128 ? 128 : message.payload_size,
                                         ESP_LOG_DEBUG);
-                
-                // Search for the ESP32 magic byte (0xE9) in the first chunk
-                int magic_offset = -1;
-                for (int i = 0; i < message.payload_size && i < 256; i++) {
-                    if (message.payload[i] == 0xE9) {
-                        magic_offset = i;
-                        ESP_LOGI(TAG, "Found ESP32 magic byte (0xE9) at offset %d", magic_offset);
-                        break;
-                    }
-                }
-                
-                if (magic_offset >= 0) {
-                    // Found the ESP32 binary, skip everything before it
-                    ESP_LOGI(TAG, "Skipping %d bytes before ESP32 binary", magic_offset);
-                    ESP_LOGI(TAG, "Writing %d bytes from first chunk", 
-                             message.payload_size - magic_offset);
-                    
-                    ret = esp_ota_write(update_handle, message.payload + magic_offset, 
-                                      message.payload_size - magic_offset);
-                    total_received += message.payload_size - magic_offset;
-                } else {
-                    ESP_LOGE(TAG, "No ESP32 magic byte (0xE9) found in first %d bytes", 
-                             message.payload_size);
-                    ESP_LOGE(TAG, "Cannot proceed with OTA update");
-                    ota_upgrade_status = ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
-                    return ESP_ERR_INVALID_ARG;
-                }
-            } else {
-                // Subsequent chunks - write directly
-                ESP_LOGD(TAG, "OTA receiving chunk: %d bytes (total: %ld bytes)",
-                         message.payload_size, total_received);
-                
-                ret = esp_ota_write(update_handle, message.payload, message.payload_size);
-                total_received += message.payload_size;
             }
-            
+
+            /* Blocks are staged in RAM and written to flash one 4 KB sector at a
+             * time; the writer also skips the sub-element header before the
+             * ESP image (0xE9) in the first block, and streams compressed
+             * (CLMZ) images through ota_decoder. */
+            ret = ota_writer_write(message.payload, message.payload_size);
+            total_received += message.payload_size;
+
             if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "esp_ota_write failed: %s", esp_err_to_name(ret));
+                ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(ret));
                 ota_upgrade_status = ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
+                ota_writer_abort();
                 if (ota_pm_lock != NULL) esp_pm_lock_release(ota_pm_lock);
                 esp_zb_sleep_enable(true);
-                esp_zb_set_rx_on_when_idle(false);
+                poll_control_close(POLL_WINDOW_OTA);
                 ota_transfer_active = false;
                 return ret;
             }
 
-            // Log progress every ~100KB
-            static uint32_t last_milestone = 0;
-            uint32_t current_milestone = total_received / 100000;
-            if (current_milestone > last_milestone) {
-                ESP_LOGI(TAG, "OTA progress: %ld KB (%.1f%%)", total_received / 1000,
-                         total_image_size > 0 ? (float)total_received / (float)total_image_size * 100.0f : 0.0f);
-                last_milestone = current_milestone;
-            }
+            /* Next block is on its way: keep polling fast */
+            poll_control_traffic(POLL_WINDOW_OTA);
+
+            /* Progress and transfer rate are logged by ota_writer every 10% */
             break;
 
         case ESP_ZB_ZCL_OTA_UPGRADE_STATUS_APPLY:
             ESP_LOGI(TAG, "=== OTA UPGRADE APPLY ===");
 
-            // Finish OTA write
-            ret = esp_ota_end(update_handle);
+            // Flush the last partial sector and finish OTA write
+            ret = ota_writer_finish();
             if (ret != ESP_OK) {
-                ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(ret));
+                ESP_LOGE(TAG, "ota_writer_finish failed: %s", esp_err_to_name(ret));
                 ota_upgrade_status = ESP_ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
                 if (ota_pm_lock != NULL) esp_pm_lock_release(ota_pm_lock);
                 esp_zb_sleep_enable(true);
-                esp_zb_set_rx_on_when_idle(false);
+                poll_control_close(POLL_WINDOW_OTA);
                 ota_transfer_active = false;
                 return ret;
             }
@@ -241,7 +228,7 @@ esp_err_t zb_ota_upgrade_value_handler(esp_zb_zcl_ota_upgrade_value_message_t me
             /* Re-enable sleep before reboot */
             ota_transfer_active = false;
             esp_zb_sleep_enable(true);
-            esp_zb_set_rx_on_when_idle(false);
+            poll_control_close(POLL_WINDOW_OTA);
             if (ota_pm_lock != NULL) esp_pm_lock_release(ota_pm_lock);
 
             ESP_LOGI(TAG, "Rebooting in 3 seconds...");
@@ -276,14 +263,12 @@ esp_err_t zb_ota_upgrade_value_handler(esp_zb_zcl_ota_upgrade_value_message_t me
 
             /* Re-enable sleep after OTA failure */
             esp_zb_sleep_enable(true);
-            esp_zb_set_rx_on_when_idle(false);
+            poll_control_close(POLL_WINDOW_OTA);
             if (ota_pm_lock != NULL) esp_pm_lock_release(ota_pm_lock);
 
-            // Abort OTA if it was started
-            if (update_handle) {
-                esp_ota_abort(update_handle);
-                update_handle = 0;
-            }
+            // Abort OTA if it was started; the checkpoint is kept for the next attempt
+            ota_writer_abort();
+            esp_zb_ota_restore_resume_point(ota_endpoint);
             ret = ESP_FAIL;
             break;
 
@@ -295,6 +280,42 @@ esp_err_t zb_ota_upgrade_value_handler(esp_zb_zcl_ota_upgrade_value_message_t me
     return ret;
 }
 
+/**
+ * @brief Advertise the checkpointed download position to the OTA server
+ *
+ * The client cluster asks for its next block at FileOffset. Should the stack
+ * start over at 0 anyway, the first block is the start of the file and
+ * ota_writer_write() drops the resume point and rewrites the image from there.
+ */
+esp_err_t esp_zb_ota_restore_resume_point(uint8_t endpoint)
+{
+    ota_endpoint = endpoint;
+
+    ota_writer_image_id_t image;
+    uint32_t stream_offset = 0;
+    if (!ota_writer_get_checkpoint(&image, &stream_offset)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (image.manufacturer != OTA_UPGRADE_MANUFACTURER) {
+        ESP_LOGW(TAG, "Checkpoint for foreign manufacturer 0x%04X - dropping", image.manufacturer);
+        ota_writer_clear_checkpoint();
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t file_offset = OTA_FILE_HEADER_LEN + stream_offset;
+    uint8_t image_status = ESP_ZB_ZCL_OTA_UPGRADE_IMAGE_STATUS_DOWNLOADING;
+    esp_zb_zcl_set_attribute_val(endpoint, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                 ESP_ZB_ZCL_ATTR_OTA_UPGRADE_FILE_OFFSET_ID, &file_offset, false);
+    esp_zb_zcl_set_attribute_val(endpoint, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                 ESP_ZB_ZCL_ATTR_OTA_UPGRADE_DOWNLOADED_FILE_VERSION_ID, &image.file_version, false);
+    esp_zb_zcl_set_attribute_val(endpoint, ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE, ESP_ZB_ZCL_CLUSTER_CLIENT_ROLE,
+                                 ESP_ZB_ZCL_ATTR_OTA_UPGRADE_IMAGE_STATUS_ID, &image_status, false);
+
+    ESP_LOGI(TAG, "♻️ Interrupted OTA v0x%08lX found - resuming at file offset %lu of %lu",
+             (unsigned long)image.file_version, (unsigned long)file_offset, (unsigned long)image.image_size);
+    return ESP_OK;
+}
+
 /**
  * @brief OTA query image response handler
  */
@@ -305,9 +326,11 @@ esp_err_t zb_ota_query_image_resp_handler(esp_zb_zcl_ota_upgrade_query_image_res
     if (message.info.status == ESP_ZB_ZCL_STATUS_SUCCESS) {
         ESP_LOGI(TAG, "📦 OTA image available: version 0x%lx, size %ld bytes",
                  message.file_version, message.image_size);
+        poll_control_open(POLL_WINDOW_OTA);     // the first block request follows
         ret = ESP_OK;
     } else {
         ESP_LOGD(TAG, "No OTA image available or query failed");
+        poll_control_close(POLL_WINDOW_OTA);
         ret = ESP_FAIL;
     }
 
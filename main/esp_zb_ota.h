@@ -8,6 +8,8 @@
 
 #include "esp_err.h"
 #include "esp_zigbee_core.h"
+/* Generated header with OTA_MANUFACTURER / OTA_IMAGE_TYPE from CMakeLists.txt */
+#include "version.h"
 
 // OTA manufacturer and image type definitions - now using CMakeLists.txt definitions
 #ifndef OTA_MANUFACTURER
@@ -22,6 +24,12 @@
 #define OTA_UPGRADE_IMAGE_TYPE    OTA_IMAGE_TYPE    // From CMakeLists.txt
 #endif
 
+#ifndef OTA_IMAGE_TYPE_COMPRESSED
+#define OTA_UPGRADE_IMAGE_TYPE_COMPRESSED  0x1203   // Compressed / delta image (see ota_decoder.h)
+#else
+#define OTA_UPGRADE_IMAGE_TYPE_COMPRESSED  OTA_IMAGE_TYPE_COMPRESSED    // From CMakeLists.txt
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -54,6 +62,19 @@ uint32_t esp_zb_ota_get_fw_version(void);
  */
 bool esp_zb_ota_is_active(void);
 
+/**
+ * @brief Restore an interrupted download position into the OTA client cluster
+ *
+ * If ota_writer has an NVS checkpoint, sets the client's FileOffset,
+ * DownloadedFileVersion and ImageUpgradeStatus attributes so the next block
+ * request continues from the checkpoint instead of offset 0. Call after the
+ * endpoints are registered; must run in the Zigbee task or under the Zigbee lock.
+ *
+ * @param endpoint Endpoint with the OTA upgrade client cluster
+ * @return ESP_OK if a resume point was restored, ESP_ERR_NOT_FOUND if there is none
+ */
+esp_err_t esp_zb_ota_restore_resume_point(uint8_t endpoint);
+
 /**
  * @brief OTA upgrade value callback handler
  * 
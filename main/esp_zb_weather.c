@@ -5,7 +5,7 @@
  *
  * ESP32-H2 Zigbee Weather Station with Light Sleep
  *
- * Battery-powered weather station with 5-minute periodic sensor readings.
+ * Battery-powered weather station with adaptive (5-30 minute) periodic sensor readings.
  * Rain gauge triggers immediate attribute updates on each pulse.
  * Uses light sleep to maintain Zigbee network connection.
  * All reporting controlled by Zigbee coordinator configuration.
@@ -23,24 +23,51 @@
 #include "esp_zb_ota.h"
 #include "sleep_manager.h"
 #include "driver/gpio.h"
+#if CONFIG_CAELUM_HAS_ENV
 #include "sensor_if.h"
+#endif
+#if CAELUM_HAS_I2C
 #include "i2c_bus.h"
 #include "i2c_config.h"
+#endif
 #include "nvs.h"
 #include "weather_driver.h"
 #include "battery_monitor.h"
+#if CONFIG_CAELUM_HAS_WIND
 #include "anemometer.h"
+#include "wind_stats.h"
+#endif
+#include "attr_cache.h"
+#include "channel_sched.h"
+#include "rain_log.h"
+#include "rain_gauge.h"
+#include "meas_log.h"
+#include "rejoin.h"
+#include "poll_control.h"
+#include "telemetry.h"
+#include "pressure_tendency.h"
+#include "power_profiler.h"
+#if CONFIG_CAELUM_HAS_WIND
 #include "as5600.h"
+#endif
+#if CONFIG_CAELUM_HAS_LIGHT
 #include "veml7700.h"
+#endif
+#if CONFIG_CAELUM_HAS_DS18B20
+#include "ds18b20.h"
+#endif
+#include "hw_inventory.h"
 #include "esp_ota_ops.h"
 #include "esp_app_format.h"
 #include "esp_timer.h"
+#include "esp_system.h"
 #include "esp_pm.h"
 #include "esp_sleep.h"
 #include "esp_rom_uart.h"
 #include "driver/rmt_tx.h"
 #include "driver/rmt_rx.h"
 #include <math.h>
+#include <time.h>
 /* Generated header with FW_VERSION / FW_DATE_CODE - created at configure time */
 #include "version.h"
 
@@ -57,7 +84,7 @@
 #endif
 
 /* Zigbee Sleepy End Device (SED) configuration */
-#define ZIGBEE_KEEP_ALIVE_MS        7500    // Keep-alive poll interval (7.5 seconds)
+#define ZIGBEE_KEEP_ALIVE_MS        POLL_LONG_INTERVAL_MS   // Keep-alive poll interval (7.5 seconds, see poll_control.h)
 #define ZIGBEE_SLEEP_THRESHOLD_MS   6000    // Idle time before sleep signal (6 seconds)
 #define ZIGBEE_ED_TIMEOUT           ESP_ZB_ED_AGING_TIMEOUT_64MIN  // Parent timeout
 
@@ -71,16 +98,16 @@
  */
 
 static const char *TAG = "WEATHER_STATION";
-//static const char *RAIN_TAG = "RAIN_GAUGE";
+static const char *RAIN_TAG = "RAIN_GAUGE";
 
 /* Network connection status - declared early for LED functions */
 static bool zigbee_network_connected = false;
 
 /* Sleep prevention during initial configuration
- * Prevents device from sleeping for 60 seconds after joining network
- * This gives coordinator (Z2M) time to configure reporting without interruption */
-static int64_t network_join_time_us = 0;
-#define INITIAL_CONFIG_DELAY_SEC 60  // Wait 60 seconds before allowing sleep after join
+ * The device stays awake and polls fast while the coordinator (Z2M) interviews
+ * it after a join: until its frames stop coming (POLL_JOIN_QUIET_MS), and for
+ * 60 seconds at most */
+#define INITIAL_CONFIG_DELAY_SEC 60  // Longest the join window keeps the device awake
 
 /* LED is used only during boot/join process:
  * - Blink yellow/orange during network joining
@@ -124,6 +151,7 @@ static void debug_led_deinit(void)
         led_strip_clear(led_strip);  // Clear pixels first
         led_strip_del(led_strip);    // Delete LED strip handle (powers down RMT)
         led_strip = NULL;
+        power_profiler_end(POWER_CAUSE_LED);
         ESP_LOGI(TAG, "🔌 RGB LED RMT peripheral powered down (boot sequence complete)");
     }
 }
@@ -134,6 +162,7 @@ static void debug_led_set_blue(void)
     if (led_strip) {
         led_strip_set_pixel(led_strip, 0, 0, 0, 16);  // R=0, G=0, B=16 (dim blue)
         led_strip_refresh(led_strip);
+        power_profiler_begin(POWER_CAUSE_LED);
     }
 }
 
@@ -161,6 +190,7 @@ static void debug_led_start_blink(void)
     if (!led_blink_task_running) {
         led_blink_task_running = true;
         xTaskCreate(debug_led_blink_task, "led_blink", 2048, NULL, 1, &led_blink_task_handle);
+        power_profiler_begin(POWER_CAUSE_LED);
         ESP_LOGI(TAG, "RGB LED blink started (network joining)");
     }
 }
@@ -192,54 +222,223 @@ static void debug_led_blink_red(void)
     }
 }
 
-/* Rain gauge configuration (RAIN_GAUGE_GPIO defined in esp_zb_weather.h) */
-#define RAIN_MM_PER_PULSE       0.36f           // mm of rain per bucket tip (adjust for your sensor)
-
-typedef enum {
-    RAIN_EVENT_PULSE = 0,
-    RAIN_EVENT_FLUSH,
-} rain_event_type_t;
-
-/* Rain gauge queue event */
-typedef struct {
-    rain_event_type_t type;
-    TickType_t tick;
-    bool force_nvs;
-    bool force_attribute;
-} rain_evt_t;
-
-/* v2.0: Pulse counter removed - only rain gauge on GPIO13 */
-
-static QueueHandle_t rain_gauge_evt_queue = NULL;
-static float total_rainfall_mm = 0.0f;
-static uint32_t rain_pulse_count = 0;
-static const char *RAIN_TAG = "RAIN_GAUGE";
-static bool rain_gauge_enabled = false;  // Only enable when connected to network
-static bool rain_gauge_isr_installed = false;  // Track ISR installation state
-static esp_timer_handle_t rain_flush_timer = NULL;
-
-/* v2.0: Pulse counter variables removed */
-
+#if CONFIG_CAELUM_HAS_DS18B20
 /* DS18B20 temperature sensor (GPIO24) */
 static const char *DS18B20_TAG = "DS18B20";
 static float ds18b20_last_temp = 0.0f;
 static bool ds18b20_available = false;
+/* Probe index -> endpoint. Probe 0 stays on EP3; extra probes found by SEARCH
+ * ROM get their own endpoint. Endpoints are sized from the NVS ROM cache at
+ * startup, so a newly found probe shows up after the next reboot. */
+static const uint8_t ds18b20_endpoints[DS18B20_MAX_DEVICES] = {
+    HA_ESP_DS18B20_ENDPOINT, HA_ESP_DS18B20_PROBE2_ENDPOINT, HA_ESP_DS18B20_PROBE3_ENDPOINT,
+};
+static uint8_t ds18b20_endpoint_count = 1;
+#else
+#define ds18b20_available false         // not in this hardware profile
+#endif
 
-/* Periodic sensor reading interval (5 minutes as per requirements) */
-#define PERIODIC_READING_INTERVAL_MS (5 * 60 * 1000ULL)  // 5 minutes in milliseconds
-#define RAIN_PULSE_FLUSH_THRESHOLD   10U
-#define RAIN_FLUSH_INTERVAL_US       (10ULL * 1000ULL * 1000ULL) // 10 seconds
 static esp_timer_handle_t periodic_report_timer = NULL;
 
-/* Network connection status (zigbee_network_connected declared earlier for LED functions) */
-static uint32_t connection_retry_count = 0;
-#define MAX_CONNECTION_RETRIES          20      // Fast (1 s) retries before backing off to the slow rejoin watchdog
+/* Adaptive reporting scheduler: every cycle with the fast channels picks
+ * their next interval from the weather activity it saw
+ * (get_adaptive_sleep_duration()). The limits live in
+ * cluster SCHED_CLUSTER_ID on EP1 and in NVS. */
+#define SCHED_NVS_KEY                   "sched_cfg"
+#define PRESSURE_TREND_SPAN_S           (30 * 60)   // shortest baseline for the fall rate
+static adaptive_schedule_t sched_cfg = {
+    .min_interval_s = SCHED_DEFAULT_MIN_INTERVAL_S,
+    .max_interval_s = SCHED_DEFAULT_MAX_INTERVAL_S,
+    .pressure_fall_hpa_h = SCHED_DEFAULT_PRESSURE_FALL,
+    .wind_gust_ms = SCHED_DEFAULT_WIND_GUST,
+    .wind_shift_deg = SCHED_DEFAULT_WIND_SHIFT,
+    .low_battery_percent = SCHED_DEFAULT_LOW_BATTERY,
+};
+static uint32_t sched_interval_s = SCHED_DEFAULT_MIN_INTERVAL_S;
+static float sched_last_rain_mm = -1.0f;        // rain total at the previous cycle, < 0 = none yet
+static float sched_wind_gust_excess_ms = 0.0f;  // gust above the 10-min mean at the last wind report
+static float pressure_trend_hpa_h = NAN;        // from the pressure_tendency ring
+
+#define BATTERY_RTC_MAGIC               0xBA77E202U
+#define BATTERY_NVS_CHECKPOINT_READS    24       // NVS checkpoint once a day at the hourly cadence
+
+/* Battery bookkeeping in RTC_NOINIT memory, like the counters in power_profiler.c:
+ * survives light sleep and software resets without touching flash (RTC_DATA
+ * would be reloaded from the image on every reset). NVS only
+ * gets a checkpoint every BATTERY_NVS_CHECKPOINT_READS reads and on esp_restart()
+ * (shutdown handler), which is what a power-on boot falls back to. */
+typedef struct {
+    uint32_t magic;
+    int64_t clock_us;               // battery_clock_us() when last touched
+    int64_t last_read_us;           // battery_clock_us() of the last real read, < 0 = none
+    float voltage_v;                // last accepted reading
+    uint16_t last_good_mv;          // glitch guard reference
+    uint8_t drop_confirm;           // glitch guard: consecutive implausible drops
+    uint8_t zigbee_voltage;         // 0.1 V units, 0xFF = unknown
+    uint8_t zigbee_percentage;      // 0-200, 0xFF = unknown
+    uint16_t reads_since_checkpoint;
+    uint32_t reboots;               // ADC-recovery reboots (diag 0x4004)
+    battery_estimate_t estimate;    // filtered open-circuit voltage, restarts from a full read after power-on
+} battery_rtc_t;
+
+static RTC_NOINIT_ATTR battery_rtc_t rtc_battery;
+static int64_t battery_clock_base_us = 0;   // clock before this boot, so read ages span resets
+
+/* Channels compiled in for the hardware profile; the others are never requested */
+#if CONFIG_CAELUM_HAS_ENV
+#define ACQ_CH_PROFILE_ENV      ACQ_CH_ENV
+#else
+#define ACQ_CH_PROFILE_ENV      0U
+#endif
+#if CONFIG_CAELUM_HAS_DS18B20
+#define ACQ_CH_PROFILE_DS18B20  ACQ_CH_DS18B20
+#else
+#define ACQ_CH_PROFILE_DS18B20  0U
+#endif
+#if CONFIG_CAELUM_HAS_WIND
+#define ACQ_CH_PROFILE_WIND     (ACQ_CH_WIND_SPEED | ACQ_CH_WIND_DIR)
+#else
+#define ACQ_CH_PROFILE_WIND     0U
+#endif
+#if CONFIG_CAELUM_HAS_LIGHT
+#define ACQ_CH_PROFILE_LIGHT    ACQ_CH_LIGHT
+#else
+#define ACQ_CH_PROFILE_LIGHT    0U
+#endif
 
-/* Rejoin watchdog: an always-on periodic timer that (a) keeps re-attempting
- * network steering when we're disconnected instead of giving up forever, and
- * (b) detects runtime parent loss (stack reports not-joined while we think we
- * are connected) and triggers a rejoin. */
-#define REJOIN_WATCHDOG_INTERVAL_MS     (5 * 60 * 1000ULL)   // attempt rejoin / check link every 5 minutes
+/* Acquisition pipeline: one trigger pass starts every conversion at once, then a
+ * single scheduler alarm collects all results when the slowest one is done.
+ * The channel mask is passed as the uint8_t scheduler-alarm parameter. */
+#define ACQ_CH_ENV              (1U << 0)   // EP1 SHT4x + LPS22HB
+#define ACQ_CH_DS18B20          (1U << 1)   // EP3
+#define ACQ_CH_RAIN             (1U << 2)   // EP2 (flushed by the rain task)
+#define ACQ_CH_WIND_SPEED       (1U << 3)   // EP4
+#define ACQ_CH_WIND_DIR         (1U << 4)   // EP5
+#define ACQ_CH_LIGHT            (1U << 5)   // EP6
+#define ACQ_CH_BATTERY          (1U << 6)   // EP1 power config (hourly gate)
+#define ACQ_CH_ALL              (ACQ_CH_RAIN | ACQ_CH_BATTERY | ACQ_CH_PROFILE_ENV | ACQ_CH_PROFILE_DS18B20 | \
+                                 ACQ_CH_PROFILE_WIND | ACQ_CH_PROFILE_LIGHT)   // channels of this hardware profile
+#define ACQ_CH_FAST             (ACQ_CH_RAIN | ACQ_CH_PROFILE_WIND | ACQ_CH_PROFILE_LIGHT)  // follow the adaptive interval
+#define ACQ_AWAKE_ATTR_ID       0x4005      // genPowerCfg: time awake for the last report (ms)
+#define DS18B20_POLL_INTERVAL_MS 10        // read-slot "conversion done" poll period
+#define DS18B20_MAX_POLLS       20          // give up after 200 ms past the nominal time
+
+static bool acq_in_flight = false;          // trigger issued, collect alarm pending
+static uint8_t acq_active_mask = 0;         // channels triggered by the pending cycle
+static uint8_t acq_deferred_mask = 0;       // requests that arrived while in flight
+#if CAELUM_HAS_I2C
+static uint8_t acq_i2c_mask = 0;            // I2C buses held from trigger to collect
+#endif
+static int64_t acq_started_us = 0;
+static uint32_t acq_cycle_count = 0;
+static uint64_t acq_awake_total_ms = 0;     // for the running mean in the log
+
+/* Sampling cadence per channel. The fast channels run at the adaptive interval
+ * (sched_interval_s), the slow ones on their own period with a quarter period
+ * of slack, so they normally ride along on a fast wake. Every channel was just
+ * read by the join cycle, hence phase = period. */
+static const channel_sched_def_t cadence_table[] = {
+    { "rain+wind", ACQ_CH_FAST,    SCHED_DEFAULT_MIN_INTERVAL_S, SCHED_DEFAULT_MIN_INTERVAL_S, 0 },
+#if CONFIG_CAELUM_HAS_ENV
+    { "env",       ACQ_CH_ENV,     CADENCE_ENV_S,     CADENCE_ENV_S,     CADENCE_ENV_S / 4 },
+#endif
+#if CONFIG_CAELUM_HAS_DS18B20
+    { "ds18b20",   ACQ_CH_DS18B20, CADENCE_DS18B20_S, CADENCE_DS18B20_S, CADENCE_DS18B20_S / 4 },
+#endif
+    { "battery",   ACQ_CH_BATTERY, CADENCE_BATTERY_S, CADENCE_BATTERY_S, CADENCE_BATTERY_S / 4 },
+};
+
+/* Every reported attribute with its default deadband in raw ZCL units. A new
+ * value closer than this to the last written one is not sent at all; the
+ * coordinator can change a cluster's deadband through attribute 0x40F0
+ * (ATTR_CACHE_DEADBAND_ATTR_ID). Analog Input deadbands double as the local
+ * reportable-change thresholds. */
+static const attr_cache_def_t attr_cache_table[] = {
+#if CONFIG_CAELUM_HAS_ENV
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ATTR_CACHE_S16, 10.0f },              // 0.1 °C
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID, ATTR_CACHE_U16, 100.0f }, // 1 %RH
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID, ATTR_CACHE_S16, 1.0f },       // 0.1 hPa
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, PRESSURE_ATTR_TENDENCY_3H_ID, ATTR_CACHE_S16, 1.0f },                      // 0.1 hPa / 3 h
+#endif
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0020, ATTR_CACHE_U8, 0.0f },       // battery voltage, any change
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0021, ATTR_CACHE_U8, 0.0f },       // battery percentage
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4000, ATTR_CACHE_U16, 0.0f },      // battery ADC diagnostics
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4001, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4002, ATTR_CACHE_U8, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4003, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4004, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, ACQ_AWAKE_ATTR_ID, ATTR_CACHE_U16, 2.0f },  // ms
+    { HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, SCHED_ATTR_INTERVAL_ID, ATTR_CACHE_U16, 0.0f },        // s
+    { HA_ESP_ENV_SENSOR_ENDPOINT, BACKFILL_CLUSTER_ID, BACKFILL_ATTR_PENDING_ID, ATTR_CACHE_U16, 0.0f },   // samples
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_ATTEMPTS_ID, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_SCAN_MS_ID, ATTR_CACHE_U32, 0.0f },     // ms
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_OUTAGE_S_ID, ATTR_CACHE_U32, 0.0f },    // s
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_PHASE_ID, ATTR_CACHE_U8, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_COUNT_ID, ATTR_CACHE_U16, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_AWAKE_ID, ATTR_CACHE_FLOAT, 1.0f },     // s
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_SLEEP_ID, ATTR_CACHE_FLOAT, 1.0f },     // s
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_SLEEPS_ID, ATTR_CACHE_U32, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_TX_ID, ATTR_CACHE_U32, 0.0f },
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_RADIO_ID, ATTR_CACHE_FLOAT, 0.1f },     // s
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_CHARGE_ID, ATTR_CACHE_FLOAT, 1.0f },    // µAh
+    { HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_CURRENT_ID, ATTR_CACHE_FLOAT, 0.1f },   // µA
+    { HA_ESP_RAIN_GAUGE_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, ATTR_CACHE_FLOAT, 0.3f },          // mm
+#if CONFIG_CAELUM_HAS_DS18B20
+    { HA_ESP_DS18B20_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ATTR_CACHE_S16, 10.0f },
+    { HA_ESP_DS18B20_PROBE2_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ATTR_CACHE_S16, 10.0f },
+    { HA_ESP_DS18B20_PROBE3_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ATTR_CACHE_S16, 10.0f },
+#endif
+#if CONFIG_CAELUM_HAS_WIND
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, ATTR_CACHE_FLOAT, 0.5f },          // m/s
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_GUST_ID, ATTR_CACHE_FLOAT, 0.5f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_2MIN_ID, ATTR_CACHE_FLOAT, 0.5f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_10MIN_ID, ATTR_CACHE_FLOAT, 0.5f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, ATTR_CACHE_DEGREES, 5.0f },          // degrees
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_2MIN_ID, ATTR_CACHE_DEGREES, 5.0f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_10MIN_ID, ATTR_CACHE_DEGREES, 5.0f },
+#endif
+#if CONFIG_CAELUM_HAS_LIGHT
+    { HA_ESP_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT, ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID, ATTR_CACHE_U16, 100.0f }, // ~2.3 % lux
+#endif
+};
+
+/* Fields of the telemetry snapshot (TELEMETRY_CLUSTER_ID), in wire order and
+ * the same on every profile: a channel the board lacks is sent as absent.
+ * Append only - caelum-weather-station.js decodes by position. */
+static const telemetry_field_def_t telemetry_table[] = {
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 0.1f },           // 0.1 °C
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID, TELEMETRY_U16, 0.1f }, // 0.1 %RH
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 1.0f },    // 0.1 hPa
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0020, TELEMETRY_U8, 1.0f },                                                     // 0.1 V
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x0021, TELEMETRY_U8, 1.0f },                                                     // 0.5 %
+    { HA_ESP_RAIN_GAUGE_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, TELEMETRY_U32, 100.0f },         // 0.01 mm
+    { HA_ESP_DS18B20_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 0.1f },              // 0.1 °C
+    { HA_ESP_DS18B20_PROBE2_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 0.1f },
+    { HA_ESP_DS18B20_PROBE3_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, TELEMETRY_S16, 0.1f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, TELEMETRY_U16, 10.0f },          // 0.1 m/s
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_GUST_ID, TELEMETRY_U16, 10.0f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_2MIN_ID, TELEMETRY_U16, 10.0f },
+    { HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_10MIN_ID, TELEMETRY_U16, 10.0f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, TELEMETRY_U16, 1.0f },             // 1°
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_2MIN_ID, TELEMETRY_U16, 1.0f },
+    { HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_10MIN_ID, TELEMETRY_U16, 1.0f },
+    { HA_ESP_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT, ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID, TELEMETRY_U16, 1.0f }, // MeasuredValue
+    { HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, PRESSURE_ATTR_TENDENCY_3H_ID, TELEMETRY_S16, 1.0f },                   // 0.1 hPa / 3 h
+};
+
+/* Rejoin: every steering attempt goes through the rejoin policy (rejoin.h),
+ * which picks the channel mask and the back-off. One attempt is scheduled or
+ * running at a time (Zigbee-task only). */
+static bool rejoin_scheduled = false;           // an attempt alarm is queued
+static uint32_t rejoin_attempt_mask = 0;        // channel mask of the queued attempt
+#define REJOIN_CHANNEL_NVS_KEY          "zb_channel"
+#define REJOIN_ATTEMPT_TIMEOUT_US       (10 * 60 * 1000000LL)   // steering that never reported back
+
+/* Rejoin watchdog: an always-on periodic timer that (a) detects runtime parent
+ * loss (stack reports not-joined while we think we are connected) and starts a
+ * rejoin, and (b) restarts the rejoin sequence if it ever stalls, so the
+ * device never gives up. */
+#define REJOIN_WATCHDOG_INTERVAL_MS     (5 * 60 * 1000ULL)   // check link every 5 minutes
 static esp_timer_handle_t rejoin_watchdog_timer = NULL;
 
 /* Delivery heartbeat: the APS data-confirm callback reports the TX status of
@@ -252,39 +451,99 @@ static esp_timer_handle_t rejoin_watchdog_timer = NULL;
 #define HEARTBEAT_FAIL_THRESHOLD        3       // consecutive failed APS confirms => link considered dead
 static uint32_t aps_tx_fail_streak = 0;         // consecutive APS delivery failures (Zigbee-task only)
 static int64_t  last_aps_tx_ok_us = 0;          // timestamp of last confirmed delivery (diagnostics)
+static uint32_t aps_tx_fail_total = 0;          // every failed confirm, a backfill batch is resent if it moved
 
-/* Button action tracking (no state needed for action-based buttons) */
-#define BUS2_PROBE_ENABLED 1
+/* Offline backfill: samples buffered in meas_log while off the network are
+ * drained in rate-limited batches after a rejoin (Zigbee-task only) */
+static size_t backfill_inflight = 0;            // samples in the batch awaiting confirmation
+static uint32_t backfill_fail_mark = 0;         // aps_tx_fail_total when that batch was sent
+static bool backfill_running = false;
 
-/* Bus 2 sensor availability (set during deferred_driver_init) */
+/* Bus 2 sensor availability (set during deferred_driver_init); constant
+ * false for a sensor the hardware profile leaves out */
+#if CONFIG_CAELUM_HAS_WIND
 static bool as5600_available = false;
+static bool as5600_magnet_ok = true;            // last magnet status check
+static float wind_dir_held = -1.0f;             // last direction passed on (hysteresis), < 0 = none
+#else
+#define as5600_available false
+#endif
+#if CONFIG_CAELUM_HAS_LIGHT
 static bool veml7700_available = false;
+#else
+#define veml7700_available false
+#endif
+
+/* Sensor drivers come up on the drv_init task; acquisitions wait for them */
+static bool drivers_ready = false;              // set under the Zigbee lock
+#if CAELUM_HAS_I2C || CONFIG_CAELUM_HAS_DS18B20
+static hw_inventory_t hw_inventory;             // what this boot was probed from (drv_init task)
+#endif
 
 /********************* Define functions **************************/
 static void builtin_button_callback(button_action_t action);
 static void factory_reset_device(uint8_t param);
+#if CONFIG_CAELUM_HAS_ENV
 static void env_read_and_report(uint8_t param);
+#endif
+#if CONFIG_CAELUM_HAS_WIND
 static void wind_speed_read_and_report(uint8_t param);
 static void wind_dir_read_and_report(uint8_t param);
+#endif
+#if CONFIG_CAELUM_HAS_LIGHT
 static void light_read_and_report(uint8_t param);
+#endif
 static void periodic_sensor_report_callback(void *arg);
 static void start_periodic_reading(void);
 static void stop_periodic_reading(void);
 static void start_rejoin_watchdog(void);
 static void rejoin_watchdog_cb(void *arg);
+static void rejoin_start(void);
+static void rejoin_schedule_next(void);
+static void rejoin_attempt_cb(uint8_t phase);
+static void rejoin_resume(uint8_t param);
+static void rejoin_steering_done(bool joined);
+static uint8_t rejoin_load_channel(void);
+static void rejoin_save_channel(uint8_t channel);
 static void aps_data_confirm_cb(esp_zb_apsde_data_confirm_t confirm);
-static void rain_gauge_init(void);
+static bool aps_data_indication_cb(esp_zb_apsde_data_ind_t ind);
 static void rain_gauge_init_task(void *arg);
-static void rain_gauge_isr_handler(void *arg);
-static void rain_gauge_task(void *arg);
-static void rain_flush_timer_callback(void *arg);
-static void rain_gauge_request_flush(bool force_nvs, bool force_attribute);
-static void rain_gauge_flush_totals(bool save_to_nvs, bool update_attribute);
-static void rain_gauge_enable_isr(void);
-static void ds18b20_init(void);
+static void driver_init_task(void *arg);
+static bool zigbee_is_connected(void);
+#if CONFIG_CAELUM_HAS_DS18B20
 static void ds18b20_read_and_report(uint8_t param);
+#endif
 static void battery_read_and_report(uint8_t param);
-
+static void battery_rtc_restore(void);
+static void battery_rtc_touch(void);
+static bool battery_reading_fresh(int64_t *age_us);
+static void battery_nvs_checkpoint(void);
+static void battery_shutdown_handler(void);
+static void acquisition_start(uint8_t mask);
+static void acquisition_collect(uint8_t param);
+static void acquisition_run(power_cause_t cause, void (*read_and_report)(uint8_t));
+#if CONFIG_CAELUM_HAS_WIND
+static void acquisition_wind_dir_job(void *arg);
+#endif
+static void power_profile_publish(void);
+static void add_deadband_attr(esp_zb_attribute_list_t *cluster, uint16_t cluster_id, uint8_t endpoint, uint16_t attr_id);
+static void configure_present_value_reporting(uint8_t endpoint);
+static void configure_local_reporting(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id);
+static void telemetry_apply_reporting(void);
+static bool telemetry_publish(void);
+static void attr_cache_flushed(const attr_cache_def_t *written, int count);
+static void sched_load_config(void);
+static esp_err_t sched_handle_write(uint16_t attr_id, const void *value);
+static void sched_publish_config(void);
+static void schedule_next_reading(void);
+static void cadence_tick(uint8_t param);
+static void cadence_arm_timer(void);
+static void offline_log_sample(void);
+static void backfill_publish_pending(void);
+static void backfill_tick(uint8_t param);
+static void backfill_step(void);
+
+#if I2C_BUS2_PRESENT
 static bool i2c_addr_present(const uint8_t *list, int count, uint8_t addr)
 {
     for (int i = 0; i < count; ++i) {
@@ -293,111 +552,218 @@ static bool i2c_addr_present(const uint8_t *list, int count, uint8_t addr)
     return false;
 }
 
-static esp_err_t deferred_driver_init(void)
+/* Bus 2 sensors from a scan result (bus 2 worker, or inline without one) */
+static void bus2_sensors_init(const uint8_t *found, int count)
 {
-    /* Initialize builtin button with callback for factory reset */
-    if (!builtin_button_driver_init(builtin_button_callback)) {
-        ESP_LOGE(TAG, "Failed to initialize builtin button driver");
-        return ESP_FAIL;
-    }
-    
-    ESP_LOGI(TAG, "⚙️  Initializing hardware v2.0 sensors...");
-    
-    /* Initialize dual I2C buses for hardware v2.0 */
-    esp_err_t ret = i2c_buses_init();
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize I2C buses");
-        return ESP_FAIL;
-    }
-    
-    /* Get I2C bus handles */
-    i2c_bus_handle_t i2c_bus1 = i2c_get_bus1();
     i2c_bus_handle_t i2c_bus2 = i2c_get_bus2();
-    
-    /* Initialize I2C Bus 1 sensors: SHT4x + LPS22HB */
-    ESP_LOGI(TAG, "🌡️  Initializing Bus 1 sensors (SHT4x + LPS22HB)...");
-    
-    /* Try initializing environmental sensor (SHT4x + LPS22HB) */
-    ret = sensor_init(i2c_bus1);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "No environmental sensor found on Bus 1 - continuing");
+    esp_err_t ret;
+
+    if (count <= 0) {
+        ESP_LOGW(TAG, "No I2C devices detected on Bus 2 - skipping AS5600/VEML7700 init");
+        return;
+    }
+
+#if CONFIG_CAELUM_HAS_WIND
+    if (i2c_addr_present(found, count, AS5600_I2C_ADDR)) {
+        ret = as5600_init(i2c_bus2);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "AS5600 not found or initialization failed - wind direction unavailable");
+        } else {
+            as5600_available = true;
+            as5600_configure((as5600_power_mode_t)AS5600_IDLE_POWER_MODE, (as5600_slow_filter_t)AS5600_SLOW_FILTER);
+            ESP_LOGI(TAG, "✅ AS5600 wind direction sensor initialized");
+        }
     } else {
-        sensor_type_t st = sensor_get_type();
-        if (st == SENSOR_TYPE_SHT41_LPS22HB) {
-            ESP_LOGI(TAG, "✅ Detected SHT4x + LPS22HB combo on Bus 1");
-        } else if (st == SENSOR_TYPE_SHT41) {
-            ESP_LOGI(TAG, "✅ Detected SHT4x on Bus 1 (no pressure)");
-        } else if (st == SENSOR_TYPE_LPS22HB) {
-            ESP_LOGI(TAG, "✅ Detected LPS22HB on Bus 1 (pressure + temperature)");
+        ESP_LOGW(TAG, "AS5600 not detected on Bus 2 - skipping init");
+    }
+#endif
+
+#if CONFIG_CAELUM_HAS_LIGHT
+    if (i2c_addr_present(found, count, VEML7700_I2C_ADDR)) {
+        ret = veml7700_init(i2c_bus2);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "VEML7700 not found or initialization failed - light data unavailable");
         } else {
-            ESP_LOGI(TAG, "✅ Environmental sensor initialized (type=%d)", st);
+            veml7700_available = true;
+            veml7700_set_auto_range(VEML7700_AUTO_RANGE);
+#if !VEML7700_SHUTDOWN_BETWEEN_READS
+            veml7700_set_power_saving(true);
+#endif
+            ESP_LOGI(TAG, "✅ VEML7700 light sensor initialized");
         }
+    } else {
+        ESP_LOGW(TAG, "VEML7700 not detected on Bus 2 - skipping init");
     }
-    
-    /* Initialize I2C Bus 2 sensors: AS5600 + VEML7700 */
-    ESP_LOGI(TAG, "🧭  Initializing Bus 2 sensors (AS5600 + VEML7700)...");
+#endif
+}
 
-#if BUS2_PROBE_ENABLED
-    uint8_t bus2_found[32];
-    int bus2_count = i2c_bus_scan(i2c_bus2, bus2_found, sizeof(bus2_found));
-    if (bus2_count <= 0) {
-        ESP_LOGW(TAG, "No I2C devices detected on Bus 2 - skipping AS5600/VEML7700 init");
+static void bus2_init_job(void *arg)
+{
+    const hw_inventory_t *inv = arg;
+    bus2_sensors_init(inv->bus_addrs[1], inv->bus_count[1]);
+}
+#endif /* I2C_BUS2_PRESENT */
+
+#if CAELUM_HAS_I2C || CONFIG_CAELUM_HAS_DS18B20
+/* Full scan of the buses the profile has (the others stay empty) */
+static void hw_inventory_scan(hw_inventory_t *inv)
+{
+#if CAELUM_HAS_I2C
+    uint8_t found[32];
+    int count = i2c_bus_scan(i2c_get_bus1(), found, sizeof(found));
+    hw_inventory_set_bus(inv, 0, found, count);
+#else
+    hw_inventory_set_bus(inv, 0, NULL, 0);
+#endif
+#if I2C_BUS2_PRESENT
+    count = i2c_bus_scan(i2c_get_bus2(), found, sizeof(found));
+    hw_inventory_set_bus(inv, 1, found, count);
+#else
+    hw_inventory_set_bus(inv, 1, NULL, 0);
+#endif
+}
+
+/* Background check of the inventory this boot was brought up from. A changed
+ * bus takes effect on the next boot (its drivers were never configured); a
+ * DS18B20 fitted since the last probe is enabled straight away, its endpoint
+ * always exists. */
+static void hw_inventory_reprobe(void)
+{
+    hw_inventory_t found = hw_inventory;
+
+#if CAELUM_HAS_I2C
+    i2c_buses_acquire(I2C_BUS_ALL_MASK);
+#endif
+    hw_inventory_scan(&found);
+#if CAELUM_HAS_I2C
+    i2c_buses_release(I2C_BUS_ALL_MASK);
+#endif
+
+    bool changed = !hw_inventory_same_buses(&found, &hw_inventory);
+    if (changed) {
+        ESP_LOGW(TAG, "⚠️ I2C devices differ from the cached inventory (bus 1: %u -> %u, bus 2: %u -> %u) - full probe on next boot",
+                 hw_inventory.bus_count[0], found.bus_count[0], hw_inventory.bus_count[1], found.bus_count[1]);
+#if CONFIG_CAELUM_HAS_ENV
+        found.env_drivers = SENSOR_DRIVERS_ALL;
+#endif
+    }
+
+#if CONFIG_CAELUM_HAS_DS18B20
+    if (!hw_inventory.ds18b20_present && ds18b20_init(DS18B20_GPIO, DS18B20_RESOLUTION_BITS) == ESP_OK) {
+        ESP_LOGI(TAG, "🌡️  DS18B20 found by the background probe - enabled");
+        found.ds18b20_present = true;
+        changed = true;
+        esp_zb_lock_acquire(portMAX_DELAY);
+        ds18b20_available = true;
+        esp_zb_lock_release();
+    }
+#endif
+
+    if (changed) {
+        hw_inventory_store(&found);
     } else {
-        bool has_as5600 = i2c_addr_present(bus2_found, bus2_count, AS5600_I2C_ADDR);
-        bool has_veml = i2c_addr_present(bus2_found, bus2_count, VEML7700_I2C_ADDR);
+        ESP_LOGI(TAG, "✅ Cached hardware inventory confirmed");
+    }
+}
+#endif /* CAELUM_HAS_I2C || CONFIG_CAELUM_HAS_DS18B20 */
+
+/* Driver bring-up off the Zigbee_main task, so the rejoin starts at once.
+ * With a cached inventory both bus scans are skipped and only the drivers
+ * that answered last time are probed; bus 2 comes up on its worker while bus
+ * 1, the DS18B20 and the GPIO drivers are initialised here. Acquisitions are
+ * held back (acquisition_start) until drivers_ready is set. Drivers the
+ * hardware profile leaves out are not compiled in at all. */
+static void driver_init_task(void *arg)
+{
+    (void)arg;
+    esp_err_t ret;
 
-        if (has_as5600) {
-            ret = as5600_init(i2c_bus2);
-            if (ret != ESP_OK) {
-                ESP_LOGW(TAG, "AS5600 not found or initialization failed - wind direction unavailable");
-            } else {
-                as5600_available = true;
-                ESP_LOGI(TAG, "✅ AS5600 wind direction sensor initialized");
-            }
-        } else {
-            ESP_LOGW(TAG, "AS5600 not detected on Bus 2 - skipping init");
+#if CAELUM_HAS_I2C || CONFIG_CAELUM_HAS_DS18B20
+    bool cached = HW_INVENTORY_CACHE_ENABLED && hw_inventory_load(&hw_inventory) == ESP_OK;
+    if (cached) {
+        ESP_LOGI(TAG, "📋 Hardware inventory from NVS (bus 1: %u, bus 2: %u device(s), DS18B20 %s) - bus scans skipped",
+                 hw_inventory.bus_count[0], hw_inventory.bus_count[1], hw_inventory.ds18b20_present ? "present" : "absent");
+    } else {
+        memset(&hw_inventory, 0, sizeof(hw_inventory));
+        hw_inventory_scan(&hw_inventory);
+#if CONFIG_CAELUM_HAS_ENV
+        hw_inventory.env_drivers = SENSOR_DRIVERS_ALL;
+#endif
+        hw_inventory.ds18b20_present = true;
+    }
+#endif
+
+#if I2C_BUS2_PRESENT
+    /* Initialize I2C Bus 2 sensors: AS5600 + VEML7700, concurrently with bus 1 */
+    ESP_LOGI(TAG, "🧭  Initializing Bus 2 sensors (AS5600 + VEML7700)...");
+    bool bus2_job = i2c_bus_job_start(i2c_get_bus2(), bus2_init_job, &hw_inventory) == ESP_OK;
+    if (!bus2_job) {
+        bus2_init_job(&hw_inventory);
+    }
+#endif
+
+#if CONFIG_CAELUM_HAS_ENV
+    /* Initialize I2C Bus 1 environmental sensors: every supported chip found by
+     * the bus scan is probed and the best one is picked per quantity */
+    ESP_LOGI(TAG, "🌡️  Initializing Bus 1 environmental sensors...");
+    uint32_t env_drivers = hw_inventory.env_drivers;
+    ret = hw_inventory.bus_count[0] > 0
+              ? sensor_init_from_scan(i2c_get_bus1(), hw_inventory.bus_addrs[0], hw_inventory.bus_count[0], env_drivers)
+              : ESP_ERR_NOT_FOUND;
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "No environmental sensor found on Bus 1 - continuing");
+    } else {
+        const char *t_src = sensor_get_source_name(SENSOR_QTY_TEMPERATURE);
+        const char *h_src = sensor_get_source_name(SENSOR_QTY_HUMIDITY);
+        const char *p_src = sensor_get_source_name(SENSOR_QTY_PRESSURE);
+        ESP_LOGI(TAG, "✅ Bus 1: temperature=%s, humidity=%s, pressure=%s",
+                 t_src ? t_src : "none", h_src ? h_src : "none", p_src ? p_src : "none");
+#if CONFIG_CAELUM_PRESSURE_FIFO
+        /* The chip samples on its own from here; BME280/BMP280 stay in forced mode */
+        if (p_src && sensor_start_background(SENSOR_QTY_PRESSURE) == ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGI(TAG, "%s has no FIFO - pressure stays one conversion per reading", p_src);
         }
+#endif
+    }
+    /* A cached driver that no longer answers gets every driver probed next boot */
+    hw_inventory.env_drivers = (!cached || sensor_get_present_mask() == env_drivers) ? sensor_get_present_mask()
+                                                                                      : SENSOR_DRIVERS_ALL;
+#endif
 
-        if (has_veml) {
-            ret = veml7700_init(i2c_bus2);
-            if (ret != ESP_OK) {
-                ESP_LOGW(TAG, "VEML7700 not found or initialization failed - light data unavailable");
-            } else {
-                veml7700_available = true;
-                ESP_LOGI(TAG, "✅ VEML7700 light sensor initialized");
-            }
+#if CONFIG_CAELUM_HAS_DS18B20
+    /* Initialize DS18B20 temperature sensor (GPIO24, RMT 1-Wire) - keep for v2.0.
+     * An absent probe costs ~360 ms of presence retries, so a cached "absent"
+     * skips it; the background probe looks again. */
+    if (hw_inventory.ds18b20_present) {
+        ESP_LOGI(TAG, "🌡️  Initializing DS18B20...");
+        ret = ds18b20_init(DS18B20_GPIO, DS18B20_RESOLUTION_BITS);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "⚠️ No DS18B20 detected on GPIO%d - sensor disabled", DS18B20_GPIO);
         } else {
-            ESP_LOGW(TAG, "VEML7700 not detected on Bus 2 - skipping init");
+            ds18b20_available = true;
+            if (ds18b20_get_device_count() > ds18b20_endpoint_count) {
+                ESP_LOGW(TAG, "⚠️ %u DS18B20 probes found but %u endpoint(s) registered - extra probes appear after reboot",
+                         ds18b20_get_device_count(), ds18b20_endpoint_count);
+            }
+            ESP_LOGI(TAG, "✅ DS18B20 initialized");
         }
+        hw_inventory.ds18b20_present = ret == ESP_OK;
+    } else {
+        ESP_LOGI(TAG, "🌡️  DS18B20 absent at the last probe - init skipped");
     }
-#else
-    ESP_LOGW(TAG, "Bus 2 probe disabled - skipping AS5600/VEML7700 init");
 #endif
-    
-    /* Initialize rain gauge (GPIO13) in a dedicated task.
-     * rain_gauge_init() does blocking GPIO/light-sleep-wakeup configuration that
-     * must NOT run inline here: deferred_driver_init() executes on the Zigbee_main
-     * task from the BDB signal handler, and blocking it long enough starves the
-     * IDLE task and trips the task watchdog. Run it off the Zigbee_main path. */
-    ESP_LOGI(TAG, "🌧️  Scheduling rain gauge initialization...");
-    BaseType_t rain_init_ret = xTaskCreate(rain_gauge_init_task, "rain_init", 4096, NULL, 4, NULL);
-    if (rain_init_ret != pdPASS) {
-        ESP_LOGE(TAG, "Failed to create rain gauge init task");
-    }
-    
+
+#if CONFIG_CAELUM_HAS_WIND
     /* Initialize anemometer (GPIO14) */
     ESP_LOGI(TAG, "💨  Initializing anemometer...");
-    ret = anemometer_init();
-    if (ret != ESP_OK) {
+    bool anemometer_ok = anemometer_init() == ESP_OK;
+    if (!anemometer_ok) {
         ESP_LOGW(TAG, "Anemometer initialization failed");
     } else {
         ESP_LOGI(TAG, "✅ Anemometer initialized");
     }
-    
-    /* Initialize DS18B20 temperature sensor (GPIO24) - keep for v2.0 */
-    ESP_LOGI(TAG, "🌡️  Initializing DS18B20...");
-    ds18b20_init();
-    
+#endif
+
     /* Initialize MOSFET-controlled battery monitor (battery_monitor.c, owns ADC1) */
     ESP_LOGI(TAG, "🔋  Initializing battery monitor...");
     ret = battery_monitor_init();
@@ -406,10 +772,104 @@ static esp_err_t deferred_driver_init(void)
     } else {
         ESP_LOGI(TAG, "✅ Battery monitor initialized (MOSFET-controlled)");
     }
-    
-    ESP_LOGI(TAG, "✅ Hardware v2.0 initialization complete");
 
+#if I2C_BUS2_PRESENT
+    if (bus2_job && i2c_bus_job_wait(i2c_get_bus2(), DRIVER_INIT_BUS2_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "Bus 2 init still running after %d ms", DRIVER_INIT_BUS2_TIMEOUT_MS);
+    }
+#endif
+
+#if CONFIG_CAELUM_HAS_WIND
+    /* 1 Hz gust/average sampler; falls back to the per-report mean if it can't start */
+    if (anemometer_ok && wind_stats_start(as5600_available) != ESP_OK) {
+        ESP_LOGW(TAG, "Wind statistics sampler not started - reporting plain mean speed");
+    }
+#endif
+
+#if CAELUM_HAS_I2C
+    /* Probes done: unused buses park until the first acquisition */
+    i2c_buses_release(I2C_BUS_ALL_MASK);
+#endif
+
+#if CAELUM_HAS_I2C || CONFIG_CAELUM_HAS_DS18B20
+    /* No write unless something differs from the cached copy */
+    hw_inventory_store(&hw_inventory);
+#endif
+
+#if CONFIG_CAELUM_HAS_DS18B20
+    /* Initial DS18B20 reading runs asynchronously: start the conversion here
+     * and let a scheduler alarm collect it. A failed first read is retried on
+     * the next cycle. */
+    bool ds18b20_first_read = ds18b20_available && ds18b20_start_conversion() == ESP_OK;
+    if (ds18b20_available && !ds18b20_first_read) {
+        ESP_LOGW(TAG, "⚠️ Initial DS18B20 conversion not started - will retry on next read cycle");
+    }
+#endif
+
+    esp_zb_lock_acquire(portMAX_DELAY);
+    drivers_ready = true;
+#if CONFIG_CAELUM_HAS_DS18B20
+    if (ds18b20_first_read) {
+        esp_zb_scheduler_alarm((esp_zb_callback_t)ds18b20_read_and_report, 0, ds18b20_get_conversion_time_ms());
+    }
+#endif
+    if (acq_deferred_mask) {
+        uint8_t deferred = acq_deferred_mask;
+        acq_deferred_mask = 0;
+        esp_zb_scheduler_alarm((esp_zb_callback_t)acquisition_start, deferred, 0);
+    }
+    esp_zb_lock_release();
+
+    ESP_LOGI(TAG, "✅ Hardware v2.0 initialization complete (%lld ms after boot, profile %s)",
+             esp_timer_get_time() / 1000, CONFIG_CAELUM_PROFILE_NAME);
+
+#if CAELUM_HAS_I2C || CONFIG_CAELUM_HAS_DS18B20
+    if (cached) {
+        vTaskDelay(pdMS_TO_TICKS(HW_INVENTORY_REPROBE_DELAY_MS));
+        hw_inventory_reprobe();
+    }
+#endif
+    vTaskDelete(NULL);
+}
+
+static esp_err_t deferred_driver_init(void)
+{
+    /* Initialize builtin button with callback for factory reset */
+    if (!builtin_button_driver_init(builtin_button_callback)) {
+        ESP_LOGE(TAG, "Failed to initialize builtin button driver");
+        return ESP_FAIL;
+    }
+    
+    ESP_LOGI(TAG, "⚙️  Initializing hardware v2.0 sensors...");
+    
+#if CAELUM_HAS_I2C
+    /* Initialize dual I2C buses for hardware v2.0 */
+    esp_err_t ret = i2c_buses_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize I2C buses");
+        return ESP_FAIL;
+    }
+#endif
     
+    /* Initialize rain gauge (GPIO13) in a dedicated task.
+     * rain_gauge_init() does blocking GPIO/light-sleep-wakeup configuration that
+     * must NOT run inline here: deferred_driver_init() executes on the Zigbee_main
+     * task from the BDB signal handler, and blocking it long enough starves the
+     * IDLE task and trips the task watchdog. Run it off the Zigbee_main path. */
+    ESP_LOGI(TAG, "🌧️  Scheduling rain gauge initialization...");
+    BaseType_t rain_init_ret = xTaskCreate(rain_gauge_init_task, "rain_init", 4096, NULL, 4, NULL);
+    if (rain_init_ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create rain gauge init task");
+    }
+
+    /* The sensor drivers come up on their own task for the same reason */
+    if (xTaskCreate(driver_init_task, "drv_init", 4096, NULL, 4, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create driver init task");
+#if CAELUM_HAS_I2C
+        i2c_buses_release(I2C_BUS_ALL_MASK);
+#endif
+        return ESP_FAIL;
+    }
     return ESP_OK;
 }
 
@@ -443,11 +903,6 @@ static esp_err_t esp_zb_power_save_init(void)
     return rc;
 }
 
-static void bdb_start_top_level_commissioning_cb(uint8_t mode_mask)
-{
-    ESP_RETURN_ON_FALSE(esp_zb_bdb_start_top_level_commissioning(mode_mask) == ESP_OK, , TAG, "Failed to start Zigbee commissioning");
-}
-
 /**
  * @brief Configure local reporting for analog input endpoints (EP2 and EP3)
  * 
@@ -512,71 +967,131 @@ static void configure_analog_input_reporting(uint8_t param)
     esp_zb_zdo_device_bind_req(&rain_bind_req, bind_req_cb, (void*)"rain gauge");
     
     /* v2.0: Pulse counter endpoint and binding removed */
-    
-    /* Reportable change threshold for float values */
-    float rain_reportable_change = 0.3f;    // Report when rain changes by 0.3mm
-    
-    /* Configure reporting for EP2 (rain gauge) */
-    esp_zb_zcl_config_report_cmd_t rain_report_cmd = {0};
-    rain_report_cmd.zcl_basic_cmd.dst_addr_u.addr_short = esp_zb_get_short_address();  // Send to self
-    rain_report_cmd.zcl_basic_cmd.dst_endpoint = HA_ESP_RAIN_GAUGE_ENDPOINT;
-    rain_report_cmd.zcl_basic_cmd.src_endpoint = HA_ESP_RAIN_GAUGE_ENDPOINT;
-    rain_report_cmd.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
-    rain_report_cmd.clusterID = ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT;
-    
-    esp_zb_zcl_config_report_record_t rain_record = {
+
+    /* Local reporting for every channel of the telemetry snapshot, the Analog
+     * Input endpoints (EP2 rain, EP4 wind speed, EP5 wind direction) included;
+     * the reportable change is the attribute cache deadband. In snapshot-only
+     * mode it is switched off instead, overriding what Z2M configured. */
+    telemetry_apply_reporting();
+}
+
+/* Analog Input presentValue reporting (float) with the cached deadband as the
+ * reportable change, sent to ourselves so it applies without Z2M. Called from
+ * the Zigbee task, or from elsewhere with the stack lock held. */
+static void configure_present_value_reporting(uint8_t endpoint)
+{
+    configure_local_reporting(endpoint, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID);
+}
+
+/* Local reporting of one cached attribute: on change of its deadband and
+ * hourly, or off (max interval 0xFFFF) while the telemetry snapshot carries it
+ * instead. Same context rules as configure_present_value_reporting(). */
+static void configure_local_reporting(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id)
+{
+    attr_cache_def_t def;
+    if (!attr_cache_get_def(endpoint, cluster_id, attr_id, &def)) return;     // channel not on this board
+
+    /* Reportable change in the attribute's own type */
+    union {
+        uint8_t u8;
+        uint16_t u16;
+        uint32_t u32;
+        int16_t s16;
+        float f;
+    } change;
+    uint8_t attr_type;
+    switch (def.type) {
+        case ATTR_CACHE_U8:  change.u8 = (uint8_t)def.deadband;   attr_type = ESP_ZB_ZCL_ATTR_TYPE_U8;  break;
+        case ATTR_CACHE_U16: change.u16 = (uint16_t)def.deadband; attr_type = ESP_ZB_ZCL_ATTR_TYPE_U16; break;
+        case ATTR_CACHE_U32: change.u32 = (uint32_t)def.deadband; attr_type = ESP_ZB_ZCL_ATTR_TYPE_U32; break;
+        case ATTR_CACHE_S16: change.s16 = (int16_t)def.deadband;  attr_type = ESP_ZB_ZCL_ATTR_TYPE_S16; break;
+        default:             change.f = def.deadband;             attr_type = ESP_ZB_ZCL_ATTR_TYPE_SINGLE; break;
+    }
+    bool off = telemetry_get_mode() == TELEMETRY_MODE_SNAPSHOT && telemetry_covers(endpoint, cluster_id, attr_id);
+
+    esp_zb_zcl_config_report_cmd_t cmd = {0};
+    cmd.zcl_basic_cmd.dst_addr_u.addr_short = esp_zb_get_short_address();  // Send to self
+    cmd.zcl_basic_cmd.dst_endpoint = endpoint;
+    cmd.zcl_basic_cmd.src_endpoint = endpoint;
+    cmd.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
+    cmd.clusterID = cluster_id;
+
+    esp_zb_zcl_config_report_record_t record = {
         .direction = ESP_ZB_ZCL_REPORT_DIRECTION_SEND,
-        .attributeID = ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID,
-        .attrType = ESP_ZB_ZCL_ATTR_TYPE_SINGLE,  // Float type
-        .min_interval = 0,      // No minimum interval - report immediately on change
-        .max_interval = 3600,   // Report at least every hour even if no change
-        .reportable_change = &rain_reportable_change,
+        .attributeID = attr_id,
+        .attrType = attr_type,
+        .min_interval = 0,                      // No minimum interval - report immediately on change
+        .max_interval = off ? 0xFFFF : 3600,    // Report at least every hour even if no change; 0xFFFF = never
+        .reportable_change = &change,
     };
-    rain_report_cmd.record_number = 1;
-    rain_report_cmd.record_field = &rain_record;
-    
-    esp_zb_lock_acquire(portMAX_DELAY);
-    esp_zb_zcl_config_report_cmd_req(&rain_report_cmd);
-    esp_zb_lock_release();
+    cmd.record_number = 1;
+    cmd.record_field = &record;
 
-    ESP_LOGI(RAIN_TAG, "📋 Rain gauge reporting configured: change=%.1f mm, max_interval=3600s", rain_reportable_change);
-
-    /* Configure reporting for EP4 (wind speed) and EP5 (wind direction).
-     * Both are Analog Input presentValue (float), same mechanism as the rain gauge. */
-    static float wind_speed_change = 0.5f;   // report on >=0.5 m/s change
-    static float wind_dir_change = 5.0f;     // report on >=5 degree change
-
-    const uint8_t wind_eps[2] = { HA_ESP_WIND_SPEED_ENDPOINT, HA_ESP_WIND_DIR_ENDPOINT };
-    float *wind_changes[2] = { &wind_speed_change, &wind_dir_change };
-    const char *wind_names[2] = { "wind speed", "wind direction" };
-
-    for (int i = 0; i < 2; i++) {
-        esp_zb_zcl_config_report_cmd_t cmd = {0};
-        cmd.zcl_basic_cmd.dst_addr_u.addr_short = esp_zb_get_short_address();
-        cmd.zcl_basic_cmd.dst_endpoint = wind_eps[i];
-        cmd.zcl_basic_cmd.src_endpoint = wind_eps[i];
-        cmd.address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT;
-        cmd.clusterID = ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT;
-
-        esp_zb_zcl_config_report_record_t record = {
-            .direction = ESP_ZB_ZCL_REPORT_DIRECTION_SEND,
-            .attributeID = ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID,
-            .attrType = ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
-            .min_interval = 0,
-            .max_interval = 3600,
-            .reportable_change = wind_changes[i],
-        };
-        cmd.record_number = 1;
-        cmd.record_field = &record;
+    esp_zb_zcl_config_report_cmd_req(&cmd);
+    if (off) {
+        ESP_LOGD(TAG, "📋 EP%u 0x%04x/0x%04x reporting off (in the telemetry snapshot)", endpoint, cluster_id, attr_id);
+    } else {
+        ESP_LOGI(TAG, "📋 EP%u 0x%04x/0x%04x reporting configured: change=%.2f, max_interval=3600s",
+                 endpoint, cluster_id, attr_id, def.deadband);
+    }
+}
 
-        esp_zb_lock_acquire(portMAX_DELAY);
-        esp_zb_zcl_config_report_cmd_req(&cmd);
-        esp_zb_lock_release();
-        ESP_LOGI(TAG, "📋 %s reporting configured (EP%d)", wind_names[i], wind_eps[i]);
+/* Reporting of every attribute the snapshot carries, for the current mode */
+static void telemetry_apply_reporting(void)
+{
+    for (size_t i = 0; i < sizeof(telemetry_table) / sizeof(telemetry_table[0]); i++) {
+        configure_local_reporting(telemetry_table[i].endpoint, telemetry_table[i].cluster_id, telemetry_table[i].attr_id);
     }
+    ESP_LOGI(TAG, "📦 Telemetry mode %d: standard reports %s", telemetry_get_mode(),
+             telemetry_get_mode() == TELEMETRY_MODE_SNAPSHOT ? "off, one snapshot frame per cycle" : "on");
+}
+
+/* Send the telemetry snapshot to the coordinator if one is due; true if sent */
+static bool telemetry_publish(void)
+{
+    uint8_t snapshot[1 + TELEMETRY_MAX_BYTES];      // ZCL octet string: length byte + data
+    size_t len = telemetry_build(snapshot, sizeof(snapshot));
+    if (len == 0) return false;
+
+    esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, TELEMETRY_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 TELEMETRY_ATTR_SNAPSHOT_ID, snapshot, false);
+    esp_zb_zcl_report_attr_cmd_t cmd = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,        // coordinator
+            .dst_endpoint = 1,
+            .src_endpoint = HA_ESP_ENV_SENSOR_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .clusterID = TELEMETRY_CLUSTER_ID,
+        .attributeID = TELEMETRY_ATTR_SNAPSHOT_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
+    };
+    esp_zb_zcl_report_attr_cmd_req(&cmd);
+    ESP_LOGD(TAG, "📦 Telemetry snapshot sent (%u bytes)", (unsigned)(len - 1));
+    return true;
+}
+
+/* After every attribute flush: the snapshot if one is due, and the APS ACK
+ * poll window when any report goes out (the writes the snapshot replaces do
+ * not report) */
+static void attr_cache_flushed(const attr_cache_def_t *written, int count)
+{
+    bool reports = false;
+    bool snapshot_only = telemetry_get_mode() == TELEMETRY_MODE_SNAPSHOT;
+    for (int i = 0; i < count && !reports; i++) {
+        reports = !snapshot_only || !telemetry_covers(written[i].endpoint, written[i].cluster_id, written[i].attr_id);
+    }
+    if (zigbee_network_connected && telemetry_publish()) reports = true;
+    /* The reports go out now; their APS ACKs come back through the parent */
+    if (reports) poll_control_open(POLL_WINDOW_APS_ACK);
+}
 
-    /* EP6 (illuminance) uses the standard Illuminance Measurement cluster; its
-     * reporting is configured by the coordinator (Z2M) via configureReporting. */
+/* Writable deadband attribute on a measurement cluster, initialised from the cache */
+static void add_deadband_attr(esp_zb_attribute_list_t *cluster, uint16_t cluster_id, uint8_t endpoint, uint16_t attr_id)
+{
+    float deadband = attr_cache_get_deadband(endpoint, cluster_id, attr_id);
+    esp_zb_cluster_add_attr(cluster, cluster_id, ATTR_CACHE_DEADBAND_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                            ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &deadband);
 }
 
 void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
@@ -612,15 +1127,16 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
             if (esp_zb_bdb_is_factory_new()) {
                 ESP_LOGI(TAG, "Start network steering");
                 debug_led_start_blink();  // Start blinking when joining network
-                esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+                rejoin_start();
             } else {
                 ESP_LOGI(TAG, "Device rebooted - rejoining previous network");
                 debug_led_start_blink();  // Start blinking when rejoining
                 
                 /* CRITICAL: Device must rejoin network after reboot!
                  * Don't mark as connected or schedule reports yet - wait for ESP_ZB_BDB_SIGNAL_STEERING success.
-                 * The ESP_ZB_BDB_SIGNAL_STEERING handler will enable rain gauge and schedule initial reports. */
-                esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+                 * The ESP_ZB_BDB_SIGNAL_STEERING handler will enable rain gauge and schedule initial reports.
+                 * The first attempts only scan the channel we were on before the reboot. */
+                rejoin_start();
             }
         } else {
             /* commissioning failed - try to rejoin */
@@ -628,7 +1144,7 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
             if (!esp_zb_bdb_is_factory_new()) {
                 /* Device was previously connected, try to rejoin */
                 ESP_LOGI(TAG, "Attempting to rejoin previous network");
-                esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+                rejoin_start();
             }
         }
         break;
@@ -644,19 +1160,19 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
             debug_led_stop_blink();       // Stop blinking
             debug_led_set_blue();         // Set steady blue to indicate success
             
-            /* Mark network as connected and reset retry count */
+            /* Mark network as connected and close the outage (publishes its cost) */
             zigbee_network_connected = true;
-            connection_retry_count = 0;
+            rejoin_steering_done(true);
             /* Fresh link: clear any stale delivery-heartbeat failure state. */
             aps_tx_fail_streak = 0;
             last_aps_tx_ok_us = esp_timer_get_time();
 
-            /* Record join time to prevent sleep during initial configuration */
-            network_join_time_us = esp_timer_get_time();
-            ESP_LOGI(TAG, "🕐 Network join time recorded - sleep disabled for %d seconds to allow reporting configuration", INITIAL_CONFIG_DELAY_SEC);
+            /* Stay awake and poll fast while the coordinator configures reporting */
+            poll_control_open(POLL_WINDOW_JOIN);
+            ESP_LOGI(TAG, "🕐 Sleep disabled until the coordinator's interview is over (%d seconds at most)", INITIAL_CONFIG_DELAY_SEC);
             
             /* Enable rain gauge now that we're connected */
-            rain_gauge_enable_isr();
+            rain_gauge_enable();
             ESP_LOGI(RAIN_TAG, "Rain gauge enabled - device connected to Zigbee network");
             
             /* v2.0: No separate pulse counter - only rain gauge */
@@ -670,18 +1186,27 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
              * Update attributes (but don't force reports) so coordinator can read current values.
              * Actual reports will be sent based on local and coordinator's reporting configuration. */
             ESP_LOGI(TAG, "📊 Scheduling initial sensor data updates after network join");
-            esp_zb_scheduler_alarm((esp_zb_callback_t)env_read_and_report, 0, 2000); // Update in 2 seconds
-            // Queue rain gauge flush to publish current total after network join
-            rain_gauge_request_flush(false, true);
-            esp_zb_scheduler_alarm((esp_zb_callback_t)wind_speed_read_and_report, 0, 2500); // Wind speed
-            esp_zb_scheduler_alarm((esp_zb_callback_t)wind_dir_read_and_report, 0, 3000);   // Wind direction
-            esp_zb_scheduler_alarm((esp_zb_callback_t)light_read_and_report, 0, 3500);      // Illuminance
-            esp_zb_scheduler_alarm((esp_zb_callback_t)battery_read_and_report, 1, 4000); // Force a real read after join (populates diagnostics)
+            /* One acquisition cycle for every endpoint (rain flush included). The
+             * battery is only read if the RTC record has no read from the last
+             * hour; its attributes already hold the last values otherwise. */
+            esp_zb_scheduler_alarm((esp_zb_callback_t)acquisition_start,
+                                   battery_reading_fresh(NULL) ? (ACQ_CH_ALL & ~ACQ_CH_BATTERY) : ACQ_CH_ALL,
+                                   2000); // Update in 2 seconds
             
-            /* Start periodic sensor reading timer for 15-minute intervals.
+            /* Start the adaptive periodic sensor reading timer (5-30 minute intervals).
              * This ensures sensors are read regularly and attributes stay updated.
              * Actual reporting to coordinator is controlled by Zigbee reporting configuration. */
-            start_periodic_reading();
+            if (periodic_report_timer == NULL) {
+                start_periodic_reading();
+            }
+
+            /* Drain the samples buffered while offline once the join reports are out */
+            if (meas_log_pending() > 0 && !backfill_running) {
+                ESP_LOGI(TAG, "📦 %u offline samples to backfill", (unsigned)meas_log_pending());
+                backfill_running = true;
+                backfill_inflight = 0;
+                esp_zb_scheduler_alarm((esp_zb_callback_t)backfill_tick, 0, BACKFILL_START_DELAY_MS);
+            }
             
             /* Deinitialize LED after successful join - LED kept on briefly to confirm join */
             ESP_LOGI(TAG, "💡 LED will power down in 5 seconds to save battery");
@@ -692,33 +1217,23 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
         } else {
             ESP_LOGI(TAG, "Network steering was not successful (status: %s)", esp_err_to_name(err_status));
             
-            /* Mark network as disconnected and increment retry count */
+            /* Mark network as disconnected */
             zigbee_network_connected = false;
-            connection_retry_count++;
 
             /* Keep the rain ISR running: tips are still counted and persisted to
              * NVS while off-network, and reported once we rejoin. */
             ESP_LOGW(RAIN_TAG, "Not connected - rain still counted offline, reporting deferred until rejoin");
 
-            /* Stop periodic sensor reading timer when disconnected */
-            stop_periodic_reading();
-
-            /* Fast retries exhausted: stop the aggressive 1 s loop and let the
-             * always-on rejoin watchdog keep trying at a slow cadence. We do NOT
-             * give up - the device keeps attempting to rejoin indefinitely. */
-            if (connection_retry_count >= MAX_CONNECTION_RETRIES) {
-                if (connection_retry_count == MAX_CONNECTION_RETRIES) {
-                    ESP_LOGW(TAG, "⚠️ Fast retries (%d) exhausted - backing off to slow rejoin watchdog (every %llu min)",
-                             MAX_CONNECTION_RETRIES, REJOIN_WATCHDOG_INTERVAL_MS / 60000ULL);
-                    debug_led_stop_blink();
-                    debug_led_blink_red();  // Blink red once to indicate prolonged disconnect
-                    esp_zb_scheduler_alarm((esp_zb_callback_t)debug_led_deinit, 0, 5000);
-                }
-                break;
+            /* Keep sampling while disconnected: the cycles are buffered in the
+             * offline log and backfilled after the rejoin. A device that never
+             * joined has nobody to backfill to. */
+            if (!esp_zb_bdb_is_factory_new() && periodic_report_timer == NULL) {
+                start_periodic_reading();
             }
 
-            ESP_LOGW(TAG, "🔄 Connection attempt %d/%d failed - retrying", connection_retry_count, MAX_CONNECTION_RETRIES);
-            esp_zb_scheduler_alarm((esp_zb_callback_t)bdb_start_top_level_commissioning_cb, ESP_ZB_BDB_MODE_NETWORK_STEERING, 1000);
+            /* Plan the next attempt. We do NOT give up - the back-off is
+             * capped and the device keeps attempting to rejoin indefinitely. */
+            rejoin_steering_done(false);
         }
         break;
     case ESP_ZB_COMMON_SIGNAL_CAN_SLEEP:
@@ -726,29 +1241,23 @@ void esp_zb_app_signal_handler(esp_zb_app_signal_t *signal_struct)
         if (esp_zb_ota_is_active()) {
             ESP_LOGW(TAG, "⚠️ OTA upgrade in progress - preventing sleep");
             /* Don't call esp_zb_sleep_now() - let OTA complete */
+            power_profiler_sleep_blocked(POWER_CAUSE_OTA);
             break;
         }
         
-        /* Prevent sleep during initial configuration period after network join
-         * This allows coordinator (Z2M) to configure reporting without interruption */
-        if (network_join_time_us > 0) {
-            int64_t time_since_join_us = esp_timer_get_time() - network_join_time_us;
-            int64_t config_period_us = (int64_t)INITIAL_CONFIG_DELAY_SEC * 1000000LL;
-            
-            if (time_since_join_us < config_period_us) {
-                int remaining_sec = (int)((config_period_us - time_since_join_us) / 1000000LL);
-                ESP_LOGD(TAG, "⏳ Preventing sleep during initial config period (%d sec remaining)", remaining_sec);
-                /* Don't sleep - let coordinator configure device */
-                break;
-            } else {
-                /* Configuration period complete - allow sleep from now on */
-                ESP_LOGI(TAG, "✅ Initial configuration period complete - sleep now enabled");
-                network_join_time_us = 0;  // Clear flag so we don't check again
-            }
+        /* Prevent sleep while the coordinator (Z2M) configures reporting after
+         * a join; the join window closes once its frames stop coming */
+        if (poll_control_is_open(POLL_WINDOW_JOIN)) {
+            ESP_LOGD(TAG, "⏳ Preventing sleep during the join interview");
+            power_profiler_sleep_blocked(POWER_CAUSE_JOIN_CONFIG);
+            break;
         }
         
-        /* LED is already deinitialized after successful join - no action needed */
+        /* LED is already deinitialized after successful join - no action needed.
+         * esp_zb_sleep_now() returns once the chip is awake again. */
+        power_profiler_sleep_enter();
         esp_zb_sleep_now();
+        power_profiler_sleep_exit();
         break;
     default:
         ESP_LOGI(TAG, "ZDO signal: %s (0x%x), status: %s", esp_zb_zdo_signal_to_string(sig_type), sig_type,
@@ -767,22 +1276,52 @@ static esp_err_t zb_attribute_handler(const esp_zb_zcl_set_attr_value_message_t
     ESP_LOGI(TAG, "Received message: endpoint(%d), cluster(0x%x), attribute(0x%x), data size(%d)", message->info.dst_endpoint, message->info.cluster,
              message->attribute.id, message->attribute.data.size);
     
-    /* Handle writes to Analog Input clusters (EP2 rain gauge, EP3 pulse counter)
-     * This allows Z2M to reset the counter values */
-    if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT &&
-        message->attribute.id == ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID) {
-        
-        float new_value = message->attribute.data.value ? *(float*)message->attribute.data.value : 0.0f;
-        
+    /* Deadband written by the coordinator: applies to every cached attribute of
+     * this endpoint's cluster and is persisted by the cache */
+    if (message->attribute.id == ATTR_CACHE_DEADBAND_ATTR_ID && message->attribute.data.value) {
+        float deadband = *(float *)message->attribute.data.value;
+        ret = attr_cache_set_deadband(message->info.dst_endpoint, message->info.cluster, deadband);
+        if (ret == ESP_OK && message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT) {
+            configure_present_value_reporting(message->info.dst_endpoint);
+        } else if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Rejected deadband %.2f for EP%d cluster 0x%x: %s", deadband,
+                     message->info.dst_endpoint, message->info.cluster, esp_err_to_name(ret));
+        }
+        return ret;
+    }
+
+    /* Scheduler limits (EP1 custom cluster) */
+    if (message->info.cluster == SCHED_CLUSTER_ID && message->attribute.data.value) {
+        return sched_handle_write(message->attribute.id, message->attribute.data.value);
+    }
+
+    /* Telemetry mode: persisted, reporting of the standard attributes follows */
+    if (message->info.cluster == TELEMETRY_CLUSTER_ID && message->attribute.id == TELEMETRY_ATTR_MODE_ID &&
+        message->attribute.data.value) {
+        ret = telemetry_set_mode((telemetry_mode_t)*(const uint8_t *)message->attribute.data.value);
+        if (ret == ESP_OK) {
+            telemetry_apply_reporting();
+        } else {
+            uint8_t mode = (uint8_t)telemetry_get_mode();   // the stack already stored the rejected value
+            esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, TELEMETRY_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                         TELEMETRY_ATTR_MODE_ID, &mode, false);
+        }
+        return ret;
+    }
+
+    /* Handle writes to Analog Input clusters (EP2 rain gauge, EP3 pulse counter)
+     * This allows Z2M to reset the counter values */
+    if (message->info.cluster == ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT &&
+        message->attribute.id == ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID) {
+        
+        float new_value = message->attribute.data.value ? *(float*)message->attribute.data.value : 0.0f;
+        
         if (message->info.dst_endpoint == HA_ESP_RAIN_GAUGE_ENDPOINT) {
-            /* Reset rain gauge counter */
-            ESP_LOGI(RAIN_TAG, "🔄 Rain gauge reset from Z2M: %.2f mm -> %.2f mm", total_rainfall_mm, new_value);
-            total_rainfall_mm = new_value;
-            rain_pulse_count = (uint32_t)(new_value / RAIN_MM_PER_PULSE);  // Recalculate pulse count
-            
-            /* Save to NVS immediately */
-            save_rainfall_data(total_rainfall_mm, rain_pulse_count);
-            ESP_LOGI(RAIN_TAG, "💾 Rain gauge value saved to NVS: %.2f mm (%lu pulses)", total_rainfall_mm, rain_pulse_count);
+            /* Reset rain gauge counter (saved immediately) */
+            rain_gauge_set_total(new_value);
+            /* The stack already holds the new value; don't gate the next update against the old one */
+            attr_cache_invalidate(HA_ESP_RAIN_GAUGE_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                                  ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID);
         }
         /* v2.0: Pulse counter endpoint removed */
     }
@@ -825,8 +1364,8 @@ static esp_err_t zb_action_handler(esp_zb_core_action_callback_id_t callback_id,
                                  *(int16_t*)report_attr_message->attribute.data.value : 0;
                 if (report_attr_message->src_endpoint == HA_ESP_ENV_SENSOR_ENDPOINT) {
                     ESP_LOGI(TAG, "📡 Env Temp: %.1f°C", temp_raw / 100.0f);
-                } else if (report_attr_message->src_endpoint == HA_ESP_DS18B20_ENDPOINT) {
-                    ESP_LOGI(TAG, "📡 DS18B20 Temp: %.1f°C", temp_raw / 100.0f);
+                } else {
+                    ESP_LOGI(TAG, "📡 DS18B20 Temp (EP%d): %.1f°C", report_attr_message->src_endpoint, temp_raw / 100.0f);
                 }
             } else if (report_attr_message->cluster == ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT) {
                 uint16_t hum_raw = report_attr_message->attribute.data.value ? 
@@ -911,14 +1450,7 @@ static void esp_zb_task(void *pvParameters)
     ESP_LOGI(TAG, "⚡ Power profile: 0.68mA sleep, 12mA transmit, ~0.83mA average");
     
     /* Load rainfall data from NVS BEFORE creating clusters so we can initialize with correct value */
-    float loaded_rainfall = 0.0f;
-    uint32_t loaded_pulses = 0;
-    load_rainfall_data(&loaded_rainfall, &loaded_pulses);
-    total_rainfall_mm = roundf(loaded_rainfall * 100.0f) / 100.0f;
-    rain_pulse_count = loaded_pulses;
-    if (loaded_rainfall > 0.0f || loaded_pulses > 0) {
-        ESP_LOGI(TAG, "📂 Pre-loaded rainfall for cluster init: %.2f mm (%lu pulses)", total_rainfall_mm, rain_pulse_count);
-    }
+    rain_gauge_load();
     
     /* v2.0: Pulse counter removed */
     
@@ -971,6 +1503,7 @@ static void esp_zb_task(void *pvParameters)
     
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_basic_cluster(esp_zb_bme280_clusters, esp_zb_basic_bme280_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     
+#if CONFIG_CAELUM_HAS_ENV
     /* Create Temperature measurement cluster with REPORTING flag for persistence
      * According to ESP Zigbee SDK docs: attributes must have ESP_ZB_ZCL_ATTR_ACCESS_REPORTING
      * flag for reporting configuration to be stored in zb_storage partition and persist across reboots */
@@ -983,6 +1516,8 @@ static void esp_zb_task(void *pvParameters)
                                             ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &temp_value));
     ESP_ERROR_CHECK(esp_zb_temperature_meas_cluster_add_attr(esp_zb_temperature_cluster, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MIN_VALUE_ID, &temp_min));
     ESP_ERROR_CHECK(esp_zb_temperature_meas_cluster_add_attr(esp_zb_temperature_cluster, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MAX_VALUE_ID, &temp_max));
+    add_deadband_attr(esp_zb_temperature_cluster, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, HA_ESP_ENV_SENSOR_ENDPOINT,
+                      ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID);
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_temperature_meas_cluster(esp_zb_bme280_clusters, esp_zb_temperature_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     
     /* Create Humidity measurement cluster with REPORTING flag */
@@ -995,6 +1530,8 @@ static void esp_zb_task(void *pvParameters)
                                             ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &hum_value));
     ESP_ERROR_CHECK(esp_zb_humidity_meas_cluster_add_attr(esp_zb_humidity_cluster, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_MIN_VALUE_ID, &hum_min));
     ESP_ERROR_CHECK(esp_zb_humidity_meas_cluster_add_attr(esp_zb_humidity_cluster, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_MAX_VALUE_ID, &hum_max));
+    add_deadband_attr(esp_zb_humidity_cluster, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, HA_ESP_ENV_SENSOR_ENDPOINT,
+                      ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID);
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_humidity_meas_cluster(esp_zb_bme280_clusters, esp_zb_humidity_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     
     /* Create Pressure measurement cluster with REPORTING flag */
@@ -1007,7 +1544,14 @@ static void esp_zb_task(void *pvParameters)
                                             ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &pressure_value));
     ESP_ERROR_CHECK(esp_zb_pressure_meas_cluster_add_attr(esp_zb_pressure_cluster, ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_MIN_VALUE_ID, &pressure_min));
     ESP_ERROR_CHECK(esp_zb_pressure_meas_cluster_add_attr(esp_zb_pressure_cluster, ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_MAX_VALUE_ID, &pressure_max));
+    int16_t pressure_tendency = INT16_MIN;     // unknown until 3 h of readings
+    ESP_ERROR_CHECK(esp_zb_cluster_add_attr(esp_zb_pressure_cluster, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT,
+                                            PRESSURE_ATTR_TENDENCY_3H_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                                            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &pressure_tendency));
+    add_deadband_attr(esp_zb_pressure_cluster, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT, HA_ESP_ENV_SENSOR_ENDPOINT,
+                      ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID);
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_pressure_meas_cluster(esp_zb_bme280_clusters, esp_zb_pressure_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+#endif
     
     /* Add Identify cluster for environmental sensor endpoint */
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(esp_zb_bme280_clusters, esp_zb_identify_cluster_create(NULL), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
@@ -1020,8 +1564,8 @@ static void esp_zb_task(void *pvParameters)
     
     /* Add battery-specific attributes with REPORTING flag for battery voltage and percentage
      * These are the key attributes that need to be reported for battery monitoring */
-    uint8_t battery_voltage = 0xFF;       // Unknown initially (0.1V units, e.g., 37 = 3.7V)
-    uint8_t battery_percentage = 0xFF;    // Unknown initially (0-200, where 200 = 100%)
+    uint8_t battery_voltage = rtc_battery.zigbee_voltage;        // Last known (RTC/NVS) or 0xFF (0.1V units, e.g., 37 = 3.7V)
+    uint8_t battery_percentage = rtc_battery.zigbee_percentage;  // Last known (RTC/NVS) or 0xFF (0-200, where 200 = 100%)
     uint8_t battery_size = 0xFF;          // 0xFF = other/unknown
     uint8_t battery_quantity = 1;
     uint8_t battery_rated_voltage = 37;   // 3.7V nominal for Li-Ion
@@ -1062,9 +1606,88 @@ static void esp_zb_task(void *pvParameters)
     uint16_t diag_reboots = 0;
     esp_zb_cluster_add_attr(esp_zb_power_cluster, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4004, ESP_ZB_ZCL_ATTR_TYPE_U16,
                             ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, &diag_reboots);
+    /* 0x4005 = time awake for the last report (ms): acquisition trigger to the
+     * attribute flush, i.e. the slowest sensor conversion plus the reads. */
+    uint16_t diag_awake_ms = 0;
+    esp_zb_cluster_add_attr(esp_zb_power_cluster, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, ACQ_AWAKE_ATTR_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_awake_ms);
 
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_power_config_cluster(esp_zb_bme280_clusters, esp_zb_power_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
 
+    /* Adaptive scheduler configuration cluster (values loaded from NVS in app_main) */
+    esp_zb_attribute_list_t *esp_zb_sched_cluster = esp_zb_zcl_attr_list_create(SCHED_CLUSTER_ID);
+    uint16_t sched_interval_attr = (uint16_t)sched_interval_s;
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_sched_cluster, SCHED_ATTR_MIN_INTERVAL_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &sched_cfg.min_interval_s);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_sched_cluster, SCHED_ATTR_MAX_INTERVAL_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &sched_cfg.max_interval_s);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_sched_cluster, SCHED_ATTR_PRESSURE_FALL_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &sched_cfg.pressure_fall_hpa_h);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_sched_cluster, SCHED_ATTR_WIND_GUST_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &sched_cfg.wind_gust_ms);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_sched_cluster, SCHED_ATTR_WIND_SHIFT_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &sched_cfg.wind_shift_deg);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_sched_cluster, SCHED_ATTR_LOW_BATTERY_ID, ESP_ZB_ZCL_ATTR_TYPE_U8,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &sched_cfg.low_battery_percent);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_sched_cluster, SCHED_ATTR_INTERVAL_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &sched_interval_attr);
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_custom_cluster(esp_zb_bme280_clusters, esp_zb_sched_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+
+    /* Offline backfill cluster: batches are sent as a command from this cluster */
+    esp_zb_attribute_list_t *esp_zb_backfill_cluster = esp_zb_zcl_attr_list_create(BACKFILL_CLUSTER_ID);
+    uint16_t backfill_pending_attr = (uint16_t)(meas_log_pending() > UINT16_MAX ? UINT16_MAX : meas_log_pending());
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_backfill_cluster, BACKFILL_ATTR_PENDING_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &backfill_pending_attr);
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_custom_cluster(esp_zb_bme280_clusters, esp_zb_backfill_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+
+    /* Diagnostics cluster: cost of the last rejoin, published when it completes */
+    esp_zb_attribute_list_t *esp_zb_diag_cluster = esp_zb_zcl_attr_list_create(DIAG_CLUSTER_ID);
+    uint16_t diag_u16_zero = 0;
+    uint32_t diag_u32_zero = 0;
+    uint8_t diag_u8_zero = 0;
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_REJOIN_ATTEMPTS_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_u16_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_REJOIN_SCAN_MS_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_u32_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_REJOIN_OUTAGE_S_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_u32_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_REJOIN_PHASE_ID, ESP_ZB_ZCL_ATTR_TYPE_U8,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_u8_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_REJOIN_COUNT_ID, ESP_ZB_ZCL_ATTR_TYPE_U16,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_u16_zero);
+    float diag_float_zero = 0.0f;
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_POWER_AWAKE_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_float_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_POWER_SLEEP_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_float_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_POWER_SLEEPS_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_u32_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_POWER_TX_ID, ESP_ZB_ZCL_ATTR_TYPE_U32,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_u32_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_POWER_RADIO_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_float_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_POWER_CHARGE_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_float_zero);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_POWER_CURRENT_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &diag_float_zero);
+    uint8_t diag_causes[3 + 4 * POWER_CAUSE_COUNT];
+    power_profiler_encode_causes(diag_causes, sizeof(diag_causes));
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_diag_cluster, DIAG_ATTR_POWER_CAUSES_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, diag_causes);
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_custom_cluster(esp_zb_bme280_clusters, esp_zb_diag_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+
+    /* Telemetry cluster: every channel in one octet string, reported after each flush */
+    esp_zb_attribute_list_t *esp_zb_telemetry_cluster = esp_zb_zcl_attr_list_create(TELEMETRY_CLUSTER_ID);
+    /* Full size from the start: the stack sizes the attribute from its initial value */
+    uint8_t telemetry_snapshot[1 + TELEMETRY_MAX_BYTES];
+    telemetry_encode(telemetry_snapshot, sizeof(telemetry_snapshot));
+    uint8_t telemetry_mode = (uint8_t)telemetry_get_mode();
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_telemetry_cluster, TELEMETRY_ATTR_SNAPSHOT_ID, ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY, telemetry_snapshot);
+    esp_zb_custom_cluster_add_custom_attr(esp_zb_telemetry_cluster, TELEMETRY_ATTR_MODE_ID, ESP_ZB_ZCL_ATTR_TYPE_U8,
+                                          ESP_ZB_ZCL_ATTR_ACCESS_READ_WRITE, &telemetry_mode);
+    ESP_ERROR_CHECK(esp_zb_cluster_list_add_custom_cluster(esp_zb_bme280_clusters, esp_zb_telemetry_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+
     /* Add OTA client cluster to environmental sensor endpoint for firmware updates */
 #ifdef OTA_FILE_VERSION
     uint32_t ota_file_version = OTA_FILE_VERSION;
@@ -1107,7 +1730,11 @@ static void esp_zb_task(void *pvParameters)
     esp_zb_endpoint_config_t endpoint_bme280_config = {
         .endpoint = HA_ESP_ENV_SENSOR_ENDPOINT,
         .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+#if CONFIG_CAELUM_HAS_ENV
         .app_device_id = ESP_ZB_HA_TEMPERATURE_SENSOR_DEVICE_ID,
+#else
+        .app_device_id = ESP_ZB_HA_SIMPLE_SENSOR_DEVICE_ID,    // battery, OTA and the custom clusters only
+#endif
         .app_device_version = 0
     };
     esp_zb_ep_list_add_ep(esp_zb_ep_list, esp_zb_bme280_clusters, endpoint_bme280_config);    /* Create rain gauge sensor endpoint */
@@ -1120,7 +1747,7 @@ static void esp_zb_task(void *pvParameters)
     
     /* Create Analog Input cluster for rain gauge with REPORTING flag
      * Present value must have REPORTING flag for reporting config persistence */
-    float rain_present_value = total_rainfall_mm;  // Initialize with loaded value from NVS
+    float rain_present_value = rain_gauge_total_mm();  // Initialize with loaded value from NVS
     esp_zb_attribute_list_t *esp_zb_rain_analog_cluster = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT);
     ESP_ERROR_CHECK(esp_zb_cluster_add_attr(esp_zb_rain_analog_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
                                             ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
@@ -1133,6 +1760,8 @@ static void esp_zb_task(void *pvParameters)
     /* Add engineering units attribute (mm) */
     uint16_t engineering_units = 0;  // 0 = dimensionless, could use custom units
     esp_zb_analog_input_cluster_add_attr(esp_zb_rain_analog_cluster, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_ENGINEERING_UNITS_ID, &engineering_units);
+    add_deadband_attr(esp_zb_rain_analog_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, HA_ESP_RAIN_GAUGE_ENDPOINT,
+                      ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID);
     
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_analog_input_cluster(esp_zb_rain_clusters, esp_zb_rain_analog_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     
@@ -1149,35 +1778,47 @@ static void esp_zb_task(void *pvParameters)
 
     /* v2.0: Pulse counter endpoint removed */
 
-    /* Create DS18B20 temperature sensor endpoint (GPIO24) */
-    esp_zb_cluster_list_t *esp_zb_ds18b20_clusters = esp_zb_zcl_cluster_list_create();
-    
-    /* Create Temperature Measurement cluster for DS18B20 with REPORTING flag
-     * Must manually create cluster to ensure REPORTING flag is set for persistence */
-    int16_t ds18b20_temp_value = (int16_t)(ds18b20_last_temp * 100);  // Initialize with last known value
-    int16_t ds18b20_temp_min = -5000;     // -50°C
-    int16_t ds18b20_temp_max = 12500;     // 125°C
-    
-    esp_zb_attribute_list_t *esp_zb_ds18b20_temperature_cluster = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT);
-    ESP_ERROR_CHECK(esp_zb_cluster_add_attr(esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
-                                            ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
-                                            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &ds18b20_temp_value));
-    ESP_ERROR_CHECK(esp_zb_temperature_meas_cluster_add_attr(esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MIN_VALUE_ID, &ds18b20_temp_min));
-    ESP_ERROR_CHECK(esp_zb_temperature_meas_cluster_add_attr(esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MAX_VALUE_ID, &ds18b20_temp_max));
-    
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_temperature_meas_cluster(esp_zb_ds18b20_clusters, esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
-    
-    /* Add Identify cluster for DS18B20 endpoint */
-    ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(esp_zb_ds18b20_clusters, esp_zb_identify_cluster_create(NULL), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
-    
-    esp_zb_endpoint_config_t endpoint_ds18b20_config = {
-        .endpoint = HA_ESP_DS18B20_ENDPOINT,
-        .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
-        .app_device_id = ESP_ZB_HA_TEMPERATURE_SENSOR_DEVICE_ID,
-        .app_device_version = 0
-    };
-    esp_zb_ep_list_add_ep(esp_zb_ep_list, esp_zb_ds18b20_clusters, endpoint_ds18b20_config);
+#if CONFIG_CAELUM_HAS_DS18B20
+    /* Create DS18B20 temperature sensor endpoints (GPIO24): EP3 always, plus one
+     * per additional probe in the NVS ROM cache */
+    uint8_t ds18b20_cached = ds18b20_get_cached_device_count();
+    ds18b20_endpoint_count = ds18b20_cached > 1 ? ds18b20_cached : 1;
+    for (uint8_t probe = 0; probe < ds18b20_endpoint_count; probe++) {
+        esp_zb_cluster_list_t *esp_zb_ds18b20_clusters = esp_zb_zcl_cluster_list_create();
+        
+        /* Create Temperature Measurement cluster for DS18B20 with REPORTING flag
+         * Must manually create cluster to ensure REPORTING flag is set for persistence */
+        int16_t ds18b20_temp_value = (probe == 0) ? (int16_t)(ds18b20_last_temp * 100)  // Initialize with last known value
+                                                  : (int16_t)0x8000;                    // ZCL "invalid" until first read
+        int16_t ds18b20_temp_min = -5000;     // -50°C
+        int16_t ds18b20_temp_max = 12500;     // 125°C
+        
+        esp_zb_attribute_list_t *esp_zb_ds18b20_temperature_cluster = esp_zb_zcl_attr_list_create(ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT);
+        ESP_ERROR_CHECK(esp_zb_cluster_add_attr(esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
+                                                ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, ESP_ZB_ZCL_ATTR_TYPE_S16,
+                                                ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &ds18b20_temp_value));
+        ESP_ERROR_CHECK(esp_zb_temperature_meas_cluster_add_attr(esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MIN_VALUE_ID, &ds18b20_temp_min));
+        ESP_ERROR_CHECK(esp_zb_temperature_meas_cluster_add_attr(esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_MAX_VALUE_ID, &ds18b20_temp_max));
+        add_deadband_attr(esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, ds18b20_endpoints[probe],
+                          ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID);
+        
+        ESP_ERROR_CHECK(esp_zb_cluster_list_add_temperature_meas_cluster(esp_zb_ds18b20_clusters, esp_zb_ds18b20_temperature_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+        
+        /* Add Identify cluster for DS18B20 endpoint */
+        ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(esp_zb_ds18b20_clusters, esp_zb_identify_cluster_create(NULL), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
+        
+        esp_zb_endpoint_config_t endpoint_ds18b20_config = {
+            .endpoint = ds18b20_endpoints[probe],
+            .app_profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+            .app_device_id = ESP_ZB_HA_TEMPERATURE_SENSOR_DEVICE_ID,
+            .app_device_version = 0
+        };
+        esp_zb_ep_list_add_ep(esp_zb_ep_list, esp_zb_ds18b20_clusters, endpoint_ds18b20_config);
+    }
+    ESP_LOGI(TAG, "🌡️  DS18B20 endpoints registered: %u (from NVS ROM cache)", ds18b20_endpoint_count);
+#endif
 
+#if CONFIG_CAELUM_HAS_WIND
     /* Create wind speed endpoint (EP4, anemometer on GPIO14).
      * No standard ZCL cluster for wind speed - use Analog Input presentValue (m/s),
      * same pattern as the rain gauge. */
@@ -1189,6 +1830,16 @@ static void esp_zb_task(void *pvParameters)
                                             ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &wind_speed_value));
     char wind_speed_desc[] = "\x0A""Wind Speed";  // length-prefixed: 10 chars
     esp_zb_analog_input_cluster_add_attr(esp_zb_wind_speed_cluster, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_DESCRIPTION_ID, wind_speed_desc);
+    /* Wind statistics from the 1 Hz sampler (wind_stats.c): gust, 2 and 10 minute means */
+    float wind_gust_value = 0.0f, wind_avg2_value = 0.0f, wind_avg10_value = 0.0f;
+    esp_zb_cluster_add_attr(esp_zb_wind_speed_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_GUST_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &wind_gust_value);
+    esp_zb_cluster_add_attr(esp_zb_wind_speed_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_2MIN_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &wind_avg2_value);
+    esp_zb_cluster_add_attr(esp_zb_wind_speed_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_SPEED_ATTR_AVG_10MIN_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &wind_avg10_value);
+    add_deadband_attr(esp_zb_wind_speed_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, HA_ESP_WIND_SPEED_ENDPOINT,
+                      ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID);
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_analog_input_cluster(esp_zb_wind_speed_clusters, esp_zb_wind_speed_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(esp_zb_wind_speed_clusters, esp_zb_identify_cluster_create(NULL), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     esp_zb_endpoint_config_t endpoint_wind_speed_config = {
@@ -1209,6 +1860,14 @@ static void esp_zb_task(void *pvParameters)
                                             ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &wind_dir_value));
     char wind_dir_desc[] = "\x0E""Wind Direction";  // length-prefixed: 14 chars
     esp_zb_analog_input_cluster_add_attr(esp_zb_wind_dir_cluster, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_DESCRIPTION_ID, wind_dir_desc);
+    /* Vector-averaged (sin/cos) direction over 2 and 10 minutes */
+    float wind_dir_avg2_value = 0.0f, wind_dir_avg10_value = 0.0f;
+    esp_zb_cluster_add_attr(esp_zb_wind_dir_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_2MIN_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &wind_dir_avg2_value);
+    esp_zb_cluster_add_attr(esp_zb_wind_dir_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, WIND_DIR_ATTR_AVG_10MIN_ID, ESP_ZB_ZCL_ATTR_TYPE_SINGLE,
+                            ESP_ZB_ZCL_ATTR_ACCESS_READ_ONLY | ESP_ZB_ZCL_ATTR_ACCESS_REPORTING, &wind_dir_avg10_value);
+    add_deadband_attr(esp_zb_wind_dir_cluster, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT, HA_ESP_WIND_DIR_ENDPOINT,
+                      ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID);
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_analog_input_cluster(esp_zb_wind_dir_clusters, esp_zb_wind_dir_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(esp_zb_wind_dir_clusters, esp_zb_identify_cluster_create(NULL), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     esp_zb_endpoint_config_t endpoint_wind_dir_config = {
@@ -1218,7 +1877,9 @@ static void esp_zb_task(void *pvParameters)
         .app_device_version = 0
     };
     esp_zb_ep_list_add_ep(esp_zb_ep_list, esp_zb_wind_dir_clusters, endpoint_wind_dir_config);
+#endif
 
+#if CONFIG_CAELUM_HAS_LIGHT
     /* Create illuminance endpoint (EP6, VEML7700 on I2C Bus 2).
      * Standard ZCL Illuminance Measurement cluster (0x0400).
      * MeasuredValue = 10000 * log10(lux) + 1 per ZCL spec. */
@@ -1229,6 +1890,8 @@ static void esp_zb_task(void *pvParameters)
         .max_value = 0xFFFE,
     };
     esp_zb_attribute_list_t *esp_zb_light_cluster = esp_zb_illuminance_meas_cluster_create(&light_cfg);
+    add_deadband_attr(esp_zb_light_cluster, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT, HA_ESP_LIGHT_ENDPOINT,
+                      ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID);
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_illuminance_meas_cluster(esp_zb_light_clusters, esp_zb_light_cluster, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     ESP_ERROR_CHECK(esp_zb_cluster_list_add_identify_cluster(esp_zb_light_clusters, esp_zb_identify_cluster_create(NULL), ESP_ZB_ZCL_CLUSTER_SERVER_ROLE));
     esp_zb_endpoint_config_t endpoint_light_config = {
@@ -1238,6 +1901,7 @@ static void esp_zb_task(void *pvParameters)
         .app_device_version = 0
     };
     esp_zb_ep_list_add_ep(esp_zb_ep_list, esp_zb_light_clusters, endpoint_light_config);
+#endif
 
     /* Endpoint 4 (Sleep Configuration) removed in light sleep mode.
      * Device uses automatic sleep/wake with standard Zigbee reporting configuration.
@@ -1261,6 +1925,9 @@ static void esp_zb_task(void *pvParameters)
 
     esp_zb_device_register(esp_zb_ep_list);
     esp_zb_core_action_handler_register(zb_action_handler);
+
+    /* Continue an interrupted OTA download from its NVS checkpoint */
+    esp_zb_ota_restore_resume_point(HA_ESP_ENV_SENSOR_ENDPOINT);
     
     /* Debug: Verify REPORTING flag is set on critical attributes
      * According to ESP Zigbee SDK docs (section 5.7.4): Use esp_zb_zcl_get_attribute() to verify
@@ -1268,6 +1935,7 @@ static void esp_zb_task(void *pvParameters)
     ESP_LOGI(TAG, "🔍 Verifying REPORTING flag on attributes...");
     esp_zb_zcl_attr_t *attr;
     
+#if CONFIG_CAELUM_HAS_ENV
     // Check temperature
     attr = esp_zb_zcl_get_attribute(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT, 
                                      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID);
@@ -1291,6 +1959,7 @@ static void esp_zb_task(void *pvParameters)
         ESP_LOGI(TAG, "  Pressure: access=0x%02x %s", attr->access,
                  (attr->access & ESP_ZB_ZCL_ATTR_ACCESS_REPORTING) ? "✅ REPORTING" : "❌ NO REPORTING");
     }
+#endif
     
     // Check rain gauge
     attr = esp_zb_zcl_get_attribute(HA_ESP_RAIN_GAUGE_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
@@ -1302,6 +1971,7 @@ static void esp_zb_task(void *pvParameters)
     
     /* v2.0: Pulse counter check removed */
     
+#if CONFIG_CAELUM_HAS_DS18B20
     // Check DS18B20 temperature
     attr = esp_zb_zcl_get_attribute(HA_ESP_DS18B20_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
                                      ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID);
@@ -1309,6 +1979,7 @@ static void esp_zb_task(void *pvParameters)
         ESP_LOGI(TAG, "  DS18B20 temp: access=0x%02x %s", attr->access,
                  (attr->access & ESP_ZB_ZCL_ATTR_ACCESS_REPORTING) ? "✅ REPORTING" : "❌ NO REPORTING");
     }
+#endif
     
     // Check battery voltage
     attr = esp_zb_zcl_get_attribute(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
@@ -1328,6 +1999,32 @@ static void esp_zb_task(void *pvParameters)
     
     ESP_LOGI(TAG, "[CFG] Setting Zigbee channel mask: 0x%08lX", (unsigned long)ESP_ZB_PRIMARY_CHANNEL_MASK);
     esp_zb_set_primary_network_channel_set(ESP_ZB_PRIMARY_CHANNEL_MASK);
+
+    /* Rejoin policy: quick attempts on the last known channel, then backed-off full scans */
+    const rejoin_config_t rejoin_cfg = {
+        .all_channels_mask = ESP_ZB_PRIMARY_CHANNEL_MASK,
+        .fast_attempts = REJOIN_FAST_ATTEMPTS,
+        .fast_delay_ms = REJOIN_FAST_DELAY_MS,
+        .backoff_base_ms = REJOIN_BACKOFF_BASE_MS,
+        .backoff_max_ms = REJOIN_BACKOFF_MAX_MS,
+        .backoff_low_battery_max_ms = REJOIN_BACKOFF_LOW_BATTERY_MS,
+        .low_battery_percent = SCHED_DEFAULT_LOW_BATTERY,
+        .jitter_percent = REJOIN_JITTER_PERCENT,
+    };
+    rejoin_init(&rejoin_cfg, rejoin_load_channel());
+
+    /* Parent polls: the keep-alive, fast only while a reply is on its way */
+    const poll_control_config_t poll_cfg = {
+        .long_interval_ms = POLL_LONG_INTERVAL_MS,
+        .fast_interval_ms = POLL_FAST_INTERVAL_MS,
+        .windows = {
+            [POLL_WINDOW_JOIN] = { POLL_JOIN_FIRST_MS, POLL_JOIN_QUIET_MS, INITIAL_CONFIG_DELAY_SEC * 1000 },
+            [POLL_WINDOW_CONFIG] = { POLL_CONFIG_QUIET_MS, POLL_CONFIG_QUIET_MS, POLL_CONFIG_MAX_MS },
+            [POLL_WINDOW_OTA] = { POLL_OTA_QUIET_MS, POLL_OTA_QUIET_MS, 0 },
+            [POLL_WINDOW_APS_ACK] = { POLL_APS_ACK_FIRST_MS, POLL_APS_ACK_QUIET_MS, POLL_APS_ACK_MAX_MS },
+        },
+    };
+    ESP_ERROR_CHECK(poll_control_init(&poll_cfg));
     ESP_ERROR_CHECK(esp_zb_start(false));
 
     /* Start the always-on rejoin watchdog so the device keeps trying to (re)join
@@ -1337,6 +2034,7 @@ static void esp_zb_task(void *pvParameters)
     /* Register the delivery heartbeat: per-frame APS TX confirmations let us
      * detect a silent parent/route loss and force a rejoin (see aps_data_confirm_cb). */
     esp_zb_aps_data_confirm_handler_register(aps_data_confirm_cb);
+    esp_zb_aps_data_indication_handler_register(aps_data_indication_cb);
 
     /* In SED mode with automatic sleep, we don't manually schedule sleep operations.
      * The initial sensor report will be triggered after network join via the signal handler.
@@ -1386,28 +2084,29 @@ static void factory_reset_device(uint8_t param)
 
 
 
-/* Environmental sensor reading and reporting functions */
+#if CONFIG_CAELUM_HAS_ENV
+/* Environmental sensor reading and reporting functions.
+ * Collect phase of the acquisition pipeline: expects sensor_start_measurement()
+ * to have been issued by acquisition_start(). */
 static void env_read_and_report(uint8_t param)
 {
     float temperature = 0.0f, humidity = 0.0f, pressure = 0.0f;
     esp_err_t ret;
-    bool force_report = false;  // Never force - reporting config persisted via REPORTING flag
 
-    /* Wake sensors and trigger measurement if required */
-    ret = sensor_wake_and_measure();
+    /* Conversions were started by acquisition_start(); fetch the results */
+    ret = sensor_collect_measurement();
     if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "sensor_wake_and_measure() returned %s - will try to read cached/last values", esp_err_to_name(ret));
+        ESP_LOGW(TAG, "sensor_collect_measurement() returned %s - will try to read cached/last values", esp_err_to_name(ret));
     }
 
     /* Read temperature */
     ret = sensor_read_temperature(&temperature);
     if (ret == ESP_OK) {
         int16_t temp_centidegrees = (int16_t)(temperature * 100);
-        ret = esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
-                                           ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID,
-                                           &temp_centidegrees, force_report);
+        ret = attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
+                             ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &temp_centidegrees);
         if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "🌡️ Temperature: %.2f°C (attribute updated)", temperature);
+            ESP_LOGI(TAG, "🌡️ Temperature: %.2f°C (attribute cached)", temperature);
         } else {
             ESP_LOGE(TAG, "Failed to update temperature attribute: %s", esp_err_to_name(ret));
         }
@@ -1419,11 +2118,10 @@ static void env_read_and_report(uint8_t param)
     ret = sensor_read_humidity(&humidity);
     if (ret == ESP_OK) {
         uint16_t hum_centipercent = (uint16_t)(humidity * 100);
-        ret = esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
-                                           ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID,
-                                           &hum_centipercent, force_report);
+        ret = attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
+                             ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID, &hum_centipercent);
         if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "💧 Humidity: %.2f%% (attribute updated)", humidity);
+            ESP_LOGI(TAG, "💧 Humidity: %.2f%% (attribute cached)", humidity);
         } else {
             ESP_LOGE(TAG, "Failed to update humidity attribute: %s", esp_err_to_name(ret));
         }
@@ -1437,14 +2135,26 @@ static void env_read_and_report(uint8_t param)
     ret = sensor_read_pressure(&pressure);
     if (ret == ESP_OK) {
         int16_t pressure_zigbee = (int16_t)(pressure * 10); // hPa -> 0.1 kPa units
-        ret = esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT,
-                                           ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID,
-                                           &pressure_zigbee, force_report);
+        ret = attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT,
+                             ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID, &pressure_zigbee);
         if (ret == ESP_OK) {
-            ESP_LOGI(TAG, "🌪️  Pressure: %.2f hPa (raw: %d x0.1kPa - attribute updated)", pressure, pressure_zigbee);
+            ESP_LOGI(TAG, "🌪️  Pressure: %.2f hPa (raw: %d x0.1kPa - attribute cached)", pressure, pressure_zigbee);
         } else {
             ESP_LOGE(TAG, "Failed to update pressure attribute: %s", esp_err_to_name(ret));
         }
+
+        pressure_tendency_add(pressure);
+        pressure_trend_hpa_h = pressure_tendency_rate_hpa_h(PRESSURE_TREND_SPAN_S);
+        if (!isnan(pressure_trend_hpa_h)) {
+            ESP_LOGI(TAG, "🌪️  Pressure tendency: %+.2f hPa/h", pressure_trend_hpa_h);
+        }
+        float tendency = pressure_tendency_3h();
+        if (!isnan(tendency)) {
+            int16_t tendency_zigbee = (int16_t)lroundf(tendency * 10.0f);
+            attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT,
+                           PRESSURE_ATTR_TENDENCY_3H_ID, &tendency_zigbee);
+            ESP_LOGI(TAG, "🌪️  3-hour tendency: %+.1f hPa", tendency);
+        }
     } else if (ret == ESP_ERR_NOT_SUPPORTED || ret == ESP_ERR_NOT_FOUND) {
         ESP_LOGD(TAG, "Pressure not available from detected sensor (code=%s)", esp_err_to_name(ret));
     } else {
@@ -1454,49 +2164,264 @@ static void env_read_and_report(uint8_t param)
     /* Sensors automatically return to sleep mode after forced measurement.
      * No explicit sleep call needed - sensor is already in low-power state. */
     
-    /* This function can be called by:
+    /* This function is called from acquisition_collect(), for:
      * 1. Initial network join (one-time)
-     * 2. Periodic timer (every 15 minutes)
-     * 3. Coordinator's reporting configuration (based on min/max interval)
+     * 2. Periodic timer (adaptive, 5-30 minutes)
      * 
      * The periodic timer ensures regular updates even if coordinator doesn't
      * configure automatic reporting, while coordinator config can provide
      * additional event-driven reporting based on value changes.
      */
-    ESP_LOGI(TAG, "📊 Sensor data reported. Device will enter light sleep until next event.");
+    ESP_LOGI(TAG, "📊 Environmental data reported");
 }
-
-/* Periodic sensor reading timer callback */
-static void periodic_sensor_report_callback(void *arg)
+#endif /* CONFIG_CAELUM_HAS_ENV */
+
+/* Acquisition pipeline, trigger phase (Zigbee task).
+ * Starts every requested conversion back to back - SHT4x, LPS22HB, DS18B20
+ * CONVERT_T and the battery divider all settle in parallel - then arms one
+ * scheduler alarm for the slowest of them. The device is awake for about
+ * max(conversion time) per cycle instead of the sum of all of them. */
+static void acquisition_start(uint8_t mask)
 {
-    if (zigbee_network_connected) {
-        ESP_LOGI(TAG, "⏰ Periodic sensor read timer fired (5-minute interval)");
-        ESP_LOGI(TAG, "📊 Updating all endpoints: EP1=Env, EP2=Rain, EP4=DS18B20");
-        
-        /* Schedule sensor reads via Zigbee scheduler to avoid ISR context issues.
-         * Note: These functions update Zigbee attributes but don't force reporting.
-         * The Zigbee stack will automatically send reports based on the coordinator's
-         * reporting configuration (min/max intervals, reportable change thresholds). */
-        
-        /* Endpoint 1: Environmental sensors (temperature, humidity, pressure, battery) */
-        esp_zb_scheduler_alarm((esp_zb_callback_t)env_read_and_report, 0, 100);
-        
-        /* Endpoint 3: DS18B20 temperature sensor */
-        esp_zb_scheduler_alarm((esp_zb_callback_t)ds18b20_read_and_report, 0, 200);
+    if (acq_in_flight || !drivers_ready) {
+        /* A cycle is already converting (or the drivers are still coming up):
+         * fold the request into a follow-up cycle instead of re-triggering
+         * chips mid-conversion. */
+        acq_deferred_mask |= mask;
+        ESP_LOGD(TAG, "Acquisition %s - deferring mask 0x%02x", acq_in_flight ? "in flight" : "waiting for drivers", mask);
+        return;
+    }
+
+    uint32_t ready_ms = 0;
+    acq_started_us = esp_timer_get_time();
+    power_profiler_begin(POWER_CAUSE_ACQUISITION);
+    mask &= ACQ_CH_ALL;
+
+#if CAELUM_HAS_I2C
+    /* Parked buses come back from their descriptors with no rescan */
+    acq_i2c_mask = ((mask & ACQ_CH_ENV) ? I2C_BUS1_MASK : 0) |
+                   ((mask & (ACQ_CH_WIND_DIR | ACQ_CH_LIGHT)) ? I2C_BUS2_MASK : 0);
+    if (acq_i2c_mask && i2c_buses_acquire(acq_i2c_mask) != ESP_OK) {
+        ESP_LOGW(TAG, "I2C bus re-init failed - affected channels report cached values");
+    }
+#endif
+
+#if CONFIG_CAELUM_HAS_ENV
+    if (mask & ACQ_CH_ENV) {
+        uint32_t env_ms = 0;
+        if (sensor_start_measurement(&env_ms) == ESP_OK) {
+            if (env_ms > ready_ms) ready_ms = env_ms;
+        } else {
+            ESP_LOGW(TAG, "sensor_start_measurement failed - will report cached values");
+        }
+    }
+#endif
+
+#if CONFIG_CAELUM_HAS_DS18B20
+    if (mask & ACQ_CH_DS18B20) {
+        if (ds18b20_available && ds18b20_start_conversion() == ESP_OK) {
+            if (ds18b20_get_conversion_time_ms() > ready_ms) ready_ms = ds18b20_get_conversion_time_ms();
+        } else {
+            mask &= ~ACQ_CH_DS18B20;
+        }
+    }
+#endif
+
+    if (mask & ACQ_CH_BATTERY) {
+        /* Only requested when its cadence is due, so the divider is connected
+         * exactly when a real read follows */
+        if (battery_prepare_measurement() == ESP_OK && BATTERY_SETTLE_TIME_MS > ready_ms) {
+            ready_ms = BATTERY_SETTLE_TIME_MS;
+        }
+        /* Sample with the radio idle: TX current sags the cell by tens of mV,
+         * so a collect right behind a frame is pushed past the quiet window */
+        int64_t last_tx_us = power_profiler_last_tx_us();
+        if (last_tx_us >= 0) {
+            int64_t quiet_ms = ((last_tx_us - acq_started_us) / 1000) + BATTERY_RADIO_QUIET_MS;
+            if (quiet_ms > (int64_t)ready_ms) ready_ms = (uint32_t)quiet_ms;
+        }
+    }
 
-        /* Endpoint 2: Rain gauge */
+    if (mask & ACQ_CH_RAIN) {
+        /* Handled asynchronously by the rain task, runs alongside the conversions */
         rain_gauge_request_flush(false, true);
+    }
+
+    /* Wind speed (pulse count) and wind direction (AS5600) have nothing to
+     * convert. The VEML7700 is powered up with its auto-selected range and
+     * integrates alongside the others. */
+#if CONFIG_CAELUM_HAS_LIGHT
+    if ((mask & ACQ_CH_LIGHT) && veml7700_available) {
+        uint32_t light_ms = 0;
+        if (veml7700_start_measurement(&light_ms) != ESP_OK) {
+            ESP_LOGW(TAG, "VEML7700 start failed - reading previous integration");
+        }
+        if (light_ms > ready_ms) ready_ms = light_ms;
+    }
+#endif
+
+    acq_in_flight = true;
+    acq_active_mask = mask;
+    ESP_LOGI(TAG, "📊 Acquisition started (mask 0x%02x) - collecting in %lu ms", mask, (unsigned long)ready_ms);
+    esp_zb_scheduler_alarm((esp_zb_callback_t)acquisition_collect, 0, ready_ms);
+    power_profiler_end(POWER_CAUSE_ACQUISITION);
+}
+
+/* Run one collect step, its awake time charged to the given cause */
+static void acquisition_run(power_cause_t cause, void (*read_and_report)(uint8_t))
+{
+    power_profiler_begin(cause);
+    read_and_report(0);
+    power_profiler_end(cause);
+}
+
+#if CONFIG_CAELUM_HAS_WIND
+/* Burst time the worker measured, charged by the Zigbee task once the job is
+ * collected: the profiler counters are only touched from one task */
+static uint64_t wind_dir_job_us = 0;
+
+/* Bus 2 worker: the vane burst only touches the AS5600 and the attribute cache */
+static void acquisition_wind_dir_job(void *arg)
+{
+    (void)arg;
+    int64_t start_us = esp_timer_get_time();
+    wind_dir_read_and_report(0);
+    wind_dir_job_us += (uint64_t)(esp_timer_get_time() - start_us);
+}
+#endif
+
+/* Acquisition pipeline, collect phase (Zigbee task): read every result and
+ * update the attributes of the channels triggered by acquisition_start().
+ * The vane burst is mostly sample spacing, so it runs on the bus 2 worker
+ * while the other channels are read here. */
+static void acquisition_collect(uint8_t param)
+{
+    (void)param;
+    uint8_t mask = acq_active_mask;
+
+#if CONFIG_CAELUM_HAS_WIND
+    bool dir_job = false;
+    if (mask & ACQ_CH_WIND_DIR) {
+        esp_err_t ret = i2c_bus_job_start(i2c_bus2, acquisition_wind_dir_job, NULL);
+        if (ret == ESP_OK) {
+            dir_job = true;
+        } else if (ret == ESP_ERR_INVALID_STATE) {
+            /* Last burst still running: it reports for this cycle too */
+            ESP_LOGW(TAG, "🧭 Wind direction burst still busy - skipped this cycle");
+        } else {
+            acquisition_run(POWER_CAUSE_WIND_DIR, wind_dir_read_and_report);
+        }
+    }
+#endif
+#if CONFIG_CAELUM_HAS_ENV
+    if (mask & ACQ_CH_ENV)        acquisition_run(POWER_CAUSE_ENV, env_read_and_report);
+#endif
+#if CONFIG_CAELUM_HAS_DS18B20
+    if (mask & ACQ_CH_DS18B20)    acquisition_run(POWER_CAUSE_DS18B20, ds18b20_read_and_report);
+#endif
+#if CONFIG_CAELUM_HAS_WIND
+    if (mask & ACQ_CH_WIND_SPEED) acquisition_run(POWER_CAUSE_WIND_SPEED, wind_speed_read_and_report);
+#endif
+#if CONFIG_CAELUM_HAS_LIGHT
+    if (mask & ACQ_CH_LIGHT)      acquisition_run(POWER_CAUSE_LIGHT, light_read_and_report);
+#endif
+    if (mask & ACQ_CH_BATTERY)    acquisition_run(POWER_CAUSE_BATTERY, battery_read_and_report);
+#if CONFIG_CAELUM_HAS_WIND
+    if (dir_job && i2c_bus_job_wait(i2c_bus2, WIND_DIR_JOB_TIMEOUT_MS) == ESP_OK) {
+        /* A burst that outlived the last wait is charged along with this one */
+        power_profiler_add(POWER_CAUSE_WIND_DIR, wind_dir_job_us, false);
+        wind_dir_job_us = 0;
+    }
+#endif
+    power_profiler_begin(POWER_CAUSE_ACQUISITION);
+#if CAELUM_HAS_I2C
+    i2c_buses_release(acq_i2c_mask);
+    acq_i2c_mask = 0;
+#endif
+
+    /* Time awake for this report, published with the rest of the cycle */
+    uint32_t awake_ms = (uint32_t)((esp_timer_get_time() - acq_started_us) / 1000LL);
+    uint16_t awake_attr = awake_ms > UINT16_MAX ? UINT16_MAX : (uint16_t)awake_ms;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, ACQ_AWAKE_ATTR_ID, &awake_attr);
+    acq_cycle_count++;
+    acq_awake_total_ms += awake_ms;
+
+    /* Cycles with the fast channels pick the next adaptive interval from what
+     * they just measured (rain is in the fast group on every profile) */
+    if (mask & ACQ_CH_RAIN) {
+        schedule_next_reading();
+    }
+
+    /* Off the network the cycle is kept for the backfill after the next rejoin */
+    if (!zigbee_network_connected) {
+        offline_log_sample();
+    }
+
+    /* Power profile goes out with the hourly battery read */
+    if (mask & ACQ_CH_BATTERY) {
+        power_profile_publish();
+    }
+
+    /* Every changed attribute of the cycle goes out in one pass (one report burst) */
+    attr_cache_flush(false);
+    power_profiler_end(POWER_CAUSE_ACQUISITION);
+
+    acq_in_flight = false;
+    acq_active_mask = 0;
+    ESP_LOGI(TAG, "📊 Acquisition complete: awake %lu ms (mean %lu ms over %lu reports) - device will sleep until next event",
+             (unsigned long)awake_ms, (unsigned long)(acq_awake_total_ms / acq_cycle_count), (unsigned long)acq_cycle_count);
+
+    if (acq_deferred_mask) {
+        uint8_t deferred = acq_deferred_mask;
+        acq_deferred_mask = 0;
+        esp_zb_scheduler_alarm((esp_zb_callback_t)acquisition_start, deferred, 0);
+    }
+}
 
-        /* Endpoint 4/5/6: wind speed, wind direction, illuminance */
-        esp_zb_scheduler_alarm((esp_zb_callback_t)wind_speed_read_and_report, 0, 500);
-        esp_zb_scheduler_alarm((esp_zb_callback_t)wind_dir_read_and_report, 0, 600);
-        esp_zb_scheduler_alarm((esp_zb_callback_t)light_read_and_report, 0, 700);
+/* Copy the power profile into the diagnostics cluster (Zigbee task). The
+ * per-cause octet string bypasses the cache and is only read on demand. */
+static void power_profile_publish(void)
+{
+    power_profile_t profile;
+    power_profiler_get(&profile);
+    float awake_s = profile.awake_us / 1e6f;
+    float sleep_s = profile.sleep_us / 1e6f;
+    float radio_s = profile.radio_us / 1e6f;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_AWAKE_ID, &awake_s);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_SLEEP_ID, &sleep_s);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_SLEEPS_ID, &profile.sleeps);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_TX_ID, &profile.tx_frames);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_RADIO_ID, &radio_s);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_CHARGE_ID, &profile.charge_uah);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_POWER_CURRENT_ID, &profile.average_ua);
+
+    uint8_t causes[3 + 4 * POWER_CAUSE_COUNT];
+    if (power_profiler_encode_causes(causes, sizeof(causes)) > 0) {
+        esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                     DIAG_ATTR_POWER_CAUSES_ID, causes, false);
+    }
+    ESP_LOGI(TAG, "⚡ Power profile: awake %.0f s, asleep %.0f s, %lu TX, ~%.1f µA average",
+             awake_s, sleep_s, (unsigned long)profile.tx_frames, profile.average_ua);
+}
 
-        /* Battery is read hourly based on its own time tracking */
-        esp_zb_scheduler_alarm((esp_zb_callback_t)battery_read_and_report, 0, 400);
+/* Periodic sensor reading timer callback.
+ * Runs in the esp_timer task (NOT the Zigbee task), so scheduling the trigger
+ * onto the Zigbee task must hold the stack lock. */
+static void periodic_sensor_report_callback(void *arg)
+{
+    if (zigbee_network_connected) {
+        ESP_LOGI(TAG, "⏰ Periodic sensor read timer fired");
     } else {
-        ESP_LOGW(TAG, "⏰ Periodic timer fired but network disconnected - skipping sensor read");
+        ESP_LOGI(TAG, "⏰ Periodic sensor read timer fired while offline - sample goes to the backfill log");
     }
+
+    /* Note: the pipeline updates Zigbee attributes but doesn't force reporting.
+     * The Zigbee stack will automatically send reports based on the coordinator's
+     * reporting configuration (min/max intervals, reportable change thresholds).
+     * Which channels run is decided by the cadence table on the Zigbee task. */
+    esp_zb_lock_acquire(portMAX_DELAY);
+    esp_zb_scheduler_alarm((esp_zb_callback_t)cadence_tick, 0, 0);
+    esp_zb_lock_release();
 }
 
 /* Start periodic sensor reading timer */
@@ -1518,21 +2443,276 @@ static void start_periodic_reading(void)
         return;
     }
     
-    /* Start periodic timer - fires every 5 minutes to read sensors and update attributes.
+    /* One-shot, re-armed for the next due channel after every tick. The join
+     * cycle has just read every channel, so the cadence starts from now.
      * Actual reporting to coordinator is controlled by Zigbee reporting configuration. */
-    ret = esp_timer_start_periodic(periodic_report_timer, PERIODIC_READING_INTERVAL_MS * 1000ULL);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start periodic sensor reading timer: %s", esp_err_to_name(ret));
-        esp_timer_delete(periodic_report_timer);
-        periodic_report_timer = NULL;
-        return;
+    channel_sched_start(esp_timer_get_time());
+    int64_t battery_age_us = 0;
+    if (battery_reading_fresh(&battery_age_us)) {
+        /* Read before the reset/rejoin: keep the hourly grid of that read */
+        channel_sched_mark_run(ACQ_CH_BATTERY, esp_timer_get_time() - battery_age_us);
     }
-    
-    ESP_LOGI(TAG, "⏰ Periodic sensor reading started: every 5 minutes (%llu ms)", 
-             PERIODIC_READING_INTERVAL_MS);
+    cadence_arm_timer();
+
+    ESP_LOGI(TAG, "⏰ Sensor cadence started: fast channels %u-%u s (adaptive), env %u s, DS18B20 %u s, battery %u s",
+             sched_cfg.min_interval_s, sched_cfg.max_interval_s, CADENCE_ENV_S, CADENCE_DS18B20_S, CADENCE_BATTERY_S);
     ESP_LOGI(TAG, "📡 Reporting to coordinator controlled by Zigbee reporting configuration");
 }
 
+/* Collect the activity of the cycle that just finished and re-arm the
+ * periodic timer (Zigbee task, called from acquisition_collect) */
+static void schedule_next_reading(void)
+{
+    weather_activity_t activity = {
+        .rain_mm = sched_last_rain_mm < 0.0f ? 0.0f : rain_gauge_total_mm() - sched_last_rain_mm,
+        .wind_gust_excess_ms = sched_wind_gust_excess_ms,
+        .wind_dir_shift_deg = 0.0f,
+        .pressure_trend_hpa_h = pressure_trend_hpa_h,
+        .battery_percent = battery_get_zigbee_voltage() ? battery_get_zigbee_percentage() / 2 : 0xFF,
+    };
+    sched_last_rain_mm = rain_gauge_total_mm();     // a coordinator reset makes the delta negative: not rain
+
+#if CONFIG_CAELUM_HAS_WIND
+    wind_stats_t stats;
+    if (wind_stats_get(&stats) == ESP_OK && stats.dir_valid && stats.avg_2min_ms > 0.0f) {
+        float shift = fabsf(stats.dir_2min_deg - stats.dir_10min_deg);
+        activity.wind_dir_shift_deg = shift > 180.0f ? 360.0f - shift : shift;
+    }
+#endif
+
+    sched_interval_s = get_adaptive_sleep_duration(&activity, &sched_cfg);
+    uint16_t interval_attr = sched_interval_s > UINT16_MAX ? UINT16_MAX : (uint16_t)sched_interval_s;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, SCHED_ATTR_INTERVAL_ID, &interval_attr);
+
+    channel_sched_set_period(ACQ_CH_FAST, sched_interval_s);
+    cadence_arm_timer();
+}
+
+/* Periodic timer tick (Zigbee task): run every channel that is due within the
+ * coalescing window in one acquisition cycle, then sleep until the next one */
+static void cadence_tick(uint8_t param)
+{
+    (void)param;
+    battery_rtc_touch();
+    uint8_t mask = channel_sched_take_due(esp_timer_get_time(), CADENCE_COALESCE_S);
+    if (mask) {
+        ESP_LOGI(TAG, "📊 Channels due: %s%s%s%s%s%s%s",
+                 (mask & ACQ_CH_ENV) ? "env " : "", (mask & ACQ_CH_DS18B20) ? "ds18b20 " : "",
+                 (mask & ACQ_CH_RAIN) ? "rain " : "", (mask & ACQ_CH_WIND_SPEED) ? "wind " : "",
+                 (mask & ACQ_CH_WIND_DIR) ? "vane " : "", (mask & ACQ_CH_LIGHT) ? "light " : "",
+                 (mask & ACQ_CH_BATTERY) ? "battery" : "");
+        acquisition_start(mask);
+    }
+    cadence_arm_timer();
+}
+
+/* Arm the one-shot periodic timer for the next channel wake */
+static void cadence_arm_timer(void)
+{
+    if (periodic_report_timer == NULL) return;
+
+    int64_t wake_us = channel_sched_next_wake_us();
+    if (wake_us == INT64_MAX) return;
+    int64_t delay_us = wake_us - esp_timer_get_time();
+    if (delay_us < 1000) delay_us = 1000;
+
+    esp_timer_stop(periodic_report_timer);      // ESP_ERR_INVALID_STATE if it already fired
+    esp_timer_start_once(periodic_report_timer, (uint64_t)delay_us);
+    ESP_LOGD(TAG, "⏰ Next channel wake in %lld s", delay_us / 1000000LL);
+}
+
+/* Snapshot of the cycle for the offline log, from the values the attribute
+ * cache holds (Zigbee task, called from acquisition_collect while offline) */
+static void offline_log_sample(void)
+{
+    meas_sample_t sample = { .time_s = (uint32_t)time(NULL) };
+    for (int f = 0; f < MEAS_FIELD_COUNT; f++) {
+        sample.v[f] = MEAS_LOG_ABSENT;
+    }
+
+    float v;
+    if (attr_cache_get(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
+                       ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &v)) {
+        sample.v[MEAS_FIELD_TEMPERATURE] = (int16_t)lroundf(v / 10.0f);     // 0.01 -> 0.1 °C
+    }
+    if (attr_cache_get(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
+                       ESP_ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID, &v)) {
+        sample.v[MEAS_FIELD_HUMIDITY] = (int16_t)lroundf(v / 10.0f);        // 0.01 -> 0.1 %RH
+    }
+    if (attr_cache_get(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_PRESSURE_MEASUREMENT,
+                       ESP_ZB_ZCL_ATTR_PRESSURE_MEASUREMENT_VALUE_ID, &v)) {
+        sample.v[MEAS_FIELD_PRESSURE] = (int16_t)lroundf(v);                // already 0.1 hPa
+    }
+    if (attr_cache_get(HA_ESP_DS18B20_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
+                       ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &v)) {
+        sample.v[MEAS_FIELD_DS18B20] = (int16_t)lroundf(v / 10.0f);
+    }
+    if (attr_cache_get(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                       ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, &v)) {
+        sample.v[MEAS_FIELD_WIND_SPEED] = (int16_t)lroundf(v * 10.0f);
+    }
+    if (attr_cache_get(HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                       ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, &v)) {
+        sample.v[MEAS_FIELD_WIND_DIR] = (int16_t)(lroundf(v) % 360);
+    }
+    if (attr_cache_get(HA_ESP_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT,
+                       ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID, &v)) {
+        sample.v[MEAS_FIELD_LIGHT] = (int16_t)lroundf(v / 32.0f);
+    }
+    if (rtc_battery.voltage_v > 0.0f) {
+        sample.v[MEAS_FIELD_BATTERY] = (int16_t)lroundf(rtc_battery.voltage_v * 1000.0f);
+    }
+    sample.v[MEAS_FIELD_RAIN_TIPS] = (int16_t)(rain_gauge_pulse_count() & 0x7FFF);
+
+    if (meas_log_append(&sample) == ESP_OK) {
+        backfill_publish_pending();
+    }
+}
+
+static void backfill_publish_pending(void)
+{
+    size_t pending = meas_log_pending();
+    uint16_t pending_attr = pending > UINT16_MAX ? UINT16_MAX : (uint16_t)pending;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, BACKFILL_CLUSTER_ID, BACKFILL_ATTR_PENDING_ID, &pending_attr);
+}
+
+/* Offline backfill (Zigbee task): confirm the previous batch, send the next
+ * one and come back after BACKFILL_INTERVAL_MS until the log is drained.
+ * A batch counts as delivered if no APS confirm failed since it was sent;
+ * otherwise it is sent again, so the coordinator may see a sample twice. */
+static void backfill_tick(uint8_t param)
+{
+    (void)param;
+    power_profiler_begin(POWER_CAUSE_BACKFILL);
+    backfill_step();
+    power_profiler_end(POWER_CAUSE_BACKFILL);
+}
+
+static void backfill_step(void)
+{
+    if (!zigbee_network_connected) {
+        ESP_LOGW(TAG, "📦 Backfill paused - network lost, %u samples kept", (unsigned)meas_log_pending());
+        backfill_running = false;
+        backfill_inflight = 0;
+        return;
+    }
+
+    if (backfill_inflight > 0) {
+        if (aps_tx_fail_total == backfill_fail_mark) {
+            meas_log_mark_sent(backfill_inflight);
+        } else {
+            ESP_LOGW(TAG, "📦 Backfill batch not confirmed - sending it again");
+        }
+        backfill_inflight = 0;
+    }
+
+    uint8_t batch[1 + BACKFILL_BATCH_MAX_BYTES];    // ZCL octet string: length byte + data
+    size_t count = 0;
+    size_t len = meas_log_encode_batch(batch + 1, BACKFILL_BATCH_MAX_BYTES,
+                                       (uint16_t)lroundf(RAIN_MM_PER_PULSE * 1000.0f), &count);
+    if (len == 0) {
+        ESP_LOGI(TAG, "📦 Backfill complete");
+        backfill_running = false;
+        backfill_publish_pending();
+        attr_cache_flush(false);
+        return;
+    }
+    batch[0] = (uint8_t)len;
+
+    esp_zb_zcl_custom_cluster_cmd_req_t req = {
+        .zcl_basic_cmd = {
+            .dst_addr_u.addr_short = 0x0000,        // coordinator
+            .dst_endpoint = 1,
+            .src_endpoint = HA_ESP_ENV_SENSOR_ENDPOINT,
+        },
+        .address_mode = ESP_ZB_APS_ADDR_MODE_16_ENDP_PRESENT,
+        .profile_id = ESP_ZB_AF_HA_PROFILE_ID,
+        .cluster_id = BACKFILL_CLUSTER_ID,
+        .custom_cmd_id = BACKFILL_CMD_BATCH_ID,
+        .direction = ESP_ZB_ZCL_CMD_DIRECTION_TO_CLI,
+        .data = {
+            .type = ESP_ZB_ZCL_ATTR_TYPE_OCTET_STRING,
+            .size = (uint16_t)(len + 1),
+            .value = batch,
+        },
+    };
+    esp_zb_zcl_custom_cluster_cmd_req(&req);
+    poll_control_open(POLL_WINDOW_APS_ACK);
+    backfill_inflight = count;
+    backfill_fail_mark = aps_tx_fail_total;
+    ESP_LOGI(TAG, "📦 Backfill batch: %u samples in %u bytes, %u left", (unsigned)count, (unsigned)len,
+             (unsigned)(meas_log_pending() - count));
+
+    esp_zb_scheduler_alarm((esp_zb_callback_t)backfill_tick, 0, BACKFILL_INTERVAL_MS);
+}
+
+static void sched_load_config(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) != ESP_OK) return;
+    adaptive_schedule_t saved;
+    size_t size = sizeof(saved);
+    if (nvs_get_blob(nvs_handle, SCHED_NVS_KEY, &saved, &size) == ESP_OK && size == sizeof(saved) &&
+        saved.min_interval_s >= SCHED_MIN_INTERVAL_LIMIT_S && saved.max_interval_s >= saved.min_interval_s) {
+        sched_cfg = saved;
+        ESP_LOGI(TAG, "📂 Scheduler limits from NVS: %u-%u s", sched_cfg.min_interval_s, sched_cfg.max_interval_s);
+    }
+    nvs_close(nvs_handle);
+    sched_interval_s = sched_cfg.min_interval_s;
+}
+
+/* Write the effective limits back to the scheduler cluster (Zigbee task) */
+static void sched_publish_config(void)
+{
+    esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 SCHED_ATTR_MIN_INTERVAL_ID, &sched_cfg.min_interval_s, false);
+    esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 SCHED_ATTR_MAX_INTERVAL_ID, &sched_cfg.max_interval_s, false);
+    esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 SCHED_ATTR_PRESSURE_FALL_ID, &sched_cfg.pressure_fall_hpa_h, false);
+    esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 SCHED_ATTR_WIND_GUST_ID, &sched_cfg.wind_gust_ms, false);
+    esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 SCHED_ATTR_WIND_SHIFT_ID, &sched_cfg.wind_shift_deg, false);
+    esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, SCHED_CLUSTER_ID, ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
+                                 SCHED_ATTR_LOW_BATTERY_ID, &sched_cfg.low_battery_percent, false);
+}
+
+/* Coordinator write to the scheduler cluster: validate against the other
+ * limits, apply from the next cycle and persist */
+static esp_err_t sched_handle_write(uint16_t attr_id, const void *value)
+{
+    adaptive_schedule_t cfg = sched_cfg;
+    switch (attr_id) {
+        case SCHED_ATTR_MIN_INTERVAL_ID:  cfg.min_interval_s = *(const uint16_t *)value; break;
+        case SCHED_ATTR_MAX_INTERVAL_ID:  cfg.max_interval_s = *(const uint16_t *)value; break;
+        case SCHED_ATTR_PRESSURE_FALL_ID: cfg.pressure_fall_hpa_h = *(const float *)value; break;
+        case SCHED_ATTR_WIND_GUST_ID:     cfg.wind_gust_ms = *(const float *)value; break;
+        case SCHED_ATTR_WIND_SHIFT_ID:    cfg.wind_shift_deg = *(const float *)value; break;
+        case SCHED_ATTR_LOW_BATTERY_ID:   cfg.low_battery_percent = *(const uint8_t *)value; break;
+        default: return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (cfg.min_interval_s < SCHED_MIN_INTERVAL_LIMIT_S || cfg.max_interval_s < cfg.min_interval_s ||
+        !(cfg.pressure_fall_hpa_h > 0.0f) || !(cfg.wind_gust_ms > 0.0f) || !(cfg.wind_shift_deg > 0.0f) ||
+        cfg.low_battery_percent > 100) {
+        ESP_LOGW(TAG, "Rejected scheduler attribute 0x%04x: limits would be inconsistent", attr_id);
+        sched_publish_config();     // the stack already stored the rejected value
+        return ESP_ERR_INVALID_ARG;
+    }
+    sched_cfg = cfg;
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        nvs_set_blob(nvs_handle, SCHED_NVS_KEY, &sched_cfg, sizeof(sched_cfg));
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+    ESP_LOGI(TAG, "⚙️  Scheduler: %u-%u s, pressure %.2f hPa/h, gust %.1f m/s, shift %.0f°, low battery %u%%",
+             sched_cfg.min_interval_s, sched_cfg.max_interval_s, sched_cfg.pressure_fall_hpa_h,
+             sched_cfg.wind_gust_ms, sched_cfg.wind_shift_deg, sched_cfg.low_battery_percent);
+    return ESP_OK;
+}
+
 /* Stop periodic sensor reading timer */
 static void stop_periodic_reading(void)
 {
@@ -1544,13 +2724,134 @@ static void stop_periodic_reading(void)
     }
 }
 
+/* Channel of the last join, kept in NVS so a reboot can rejoin on it first */
+static uint8_t rejoin_load_channel(void)
+{
+    nvs_handle_t nvs_handle;
+    uint8_t channel = 0;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) == ESP_OK) {
+        nvs_get_u8(nvs_handle, REJOIN_CHANNEL_NVS_KEY, &channel);
+        nvs_close(nvs_handle);
+    }
+    return channel;
+}
+
+static void rejoin_save_channel(uint8_t channel)
+{
+    if (channel == rejoin_load_channel()) return;  // no flash write if unchanged
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        nvs_set_u8(nvs_handle, REJOIN_CHANNEL_NVS_KEY, channel);
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+}
+
+/* Link lost (or never there): open an outage and queue its first attempt.
+ * Zigbee task only. */
+static void rejoin_start(void)
+{
+    rejoin_link_lost(esp_timer_get_time());
+    rejoin_schedule_next();
+}
+
+/* Queue the next attempt of the current outage, unless one is already queued
+ * or running. Zigbee task only. */
+static void rejoin_schedule_next(void)
+{
+    if (rejoin_scheduled || rejoin_attempt_running()) return;
+
+    uint8_t battery_percent = battery_get_zigbee_voltage() ? battery_get_zigbee_percentage() / 2 : 0xFF;
+    rejoin_attempt_t next = rejoin_plan_next(battery_percent);
+    rejoin_attempt_mask = next.channel_mask;
+    rejoin_scheduled = true;
+    if (next.phase == REJOIN_PHASE_LAST_CHANNEL) {
+        ESP_LOGI(TAG, "🔄 Rejoin attempt %u on channel %u in %lu ms", rejoin_outage_attempts() + 1,
+                 rejoin_last_channel(), (unsigned long)next.delay_ms);
+    } else {
+        ESP_LOGI(TAG, "🔄 Rejoin attempt %u on all channels in %lu s", rejoin_outage_attempts() + 1,
+                 (unsigned long)(next.delay_ms / 1000));
+    }
+    esp_zb_scheduler_alarm((esp_zb_callback_t)rejoin_attempt_cb, (uint8_t)next.phase, next.delay_ms);
+}
+
+/* Scheduler alarm: restrict steering to the planned channel mask and start it */
+static void rejoin_attempt_cb(uint8_t phase)
+{
+    (void)phase;
+    rejoin_scheduled = false;
+    if (zigbee_network_connected) return;  // rejoined in the meantime
+
+    esp_zb_set_channel_mask(rejoin_attempt_mask);
+    rejoin_attempt_started(esp_timer_get_time());
+    esp_err_t ret = esp_zb_bdb_start_top_level_commissioning(ESP_ZB_BDB_MODE_NETWORK_STEERING);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start Zigbee commissioning: %s", esp_err_to_name(ret));
+        rejoin_steering_done(false);
+    }
+}
+
+/* Steering finished (signal handler, Zigbee task): record the attempt, then
+ * either publish the outage's cost or plan the next attempt */
+static void rejoin_steering_done(bool joined)
+{
+    uint8_t channel = joined ? esp_zb_get_current_channel() : 0;
+    uint32_t duration_ms = rejoin_attempt_finished(joined, channel, esp_timer_get_time());
+    power_profiler_add(POWER_CAUSE_REJOIN, (uint64_t)duration_ms * 1000ULL, true);
+
+    if (!joined) {
+        ESP_LOGW(TAG, "🔄 Rejoin attempt %u failed after %lu ms", rejoin_outage_attempts(), (unsigned long)duration_ms);
+        if (rejoin_outage_attempts() == REJOIN_FAST_ATTEMPTS) {
+            ESP_LOGW(TAG, "⚠️ Quick attempts (%d) exhausted - backing off, up to %lu min between full scans",
+                     REJOIN_FAST_ATTEMPTS, (unsigned long)(REJOIN_BACKOFF_MAX_MS / 60000UL));
+            debug_led_stop_blink();
+            debug_led_blink_red();  // Blink red once to indicate prolonged disconnect
+            esp_zb_scheduler_alarm((esp_zb_callback_t)debug_led_deinit, 0, 5000);
+        }
+        rejoin_schedule_next();
+        return;
+    }
+
+    /* Later scans start from the full mask again; the policy picks it per attempt */
+    esp_zb_set_channel_mask(ESP_ZB_PRIMARY_CHANNEL_MASK);
+    rejoin_save_channel(channel);
+
+    const rejoin_stats_t *stats = rejoin_get_stats();
+    uint8_t phase = (uint8_t)stats->phase;
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_ATTEMPTS_ID, &stats->attempts);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_SCAN_MS_ID, &stats->scan_ms);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_OUTAGE_S_ID, &stats->outage_s);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_PHASE_ID, &phase);
+    attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, DIAG_CLUSTER_ID, DIAG_ATTR_REJOIN_COUNT_ID, &stats->rejoins);
+    attr_cache_flush(false);
+}
+
+/* Watchdog follow-up (Zigbee task): make sure an outage always has an attempt
+ * queued or running */
+static void rejoin_resume(uint8_t param)
+{
+    (void)param;
+    if (zigbee_network_connected) return;
+
+    int64_t started_us = rejoin_attempt_started_us();
+    if (started_us != 0 && esp_timer_get_time() - started_us > REJOIN_ATTEMPT_TIMEOUT_US) {
+        ESP_LOGW(TAG, "🛡️ Rejoin watchdog: attempt never reported back - planning the next one");
+        rejoin_attempt_finished(false, 0, esp_timer_get_time());
+    }
+    if (!rejoin_scheduled && !rejoin_attempt_running()) {
+        ESP_LOGW(TAG, "🛡️ Rejoin watchdog: disconnected with no attempt queued - restarting rejoin");
+        rejoin_start();
+    }
+}
+
 /* Rejoin watchdog callback.
  * Runs in the esp_timer task (NOT the Zigbee task), so every esp_zb_* call here
  * MUST hold the stack lock - same rule as the rain flush. Fires periodically and:
  *   - detects runtime parent loss (stack says not-joined while we think we are
- *     connected) and corrects our state, and
- *   - re-attempts network steering whenever we are disconnected, so the device
- *     keeps trying to rejoin forever instead of giving up. */
+ *     connected) and starts the rejoin sequence, and
+ *   - restarts the sequence if no attempt is queued or the running one never
+ *     reported back, so the device keeps trying to rejoin forever. The
+ *     back-off itself is the rejoin policy's, not this timer's. */
 static void rejoin_watchdog_cb(void *arg)
 {
     bool joined;
@@ -1571,10 +2872,8 @@ static void rejoin_watchdog_cb(void *arg)
         return;  // link healthy, nothing to do
     }
 
-    ESP_LOGW(TAG, "🛡️ Rejoin watchdog: disconnected - attempting network steering");
     esp_zb_lock_acquire(portMAX_DELAY);
-    esp_zb_scheduler_alarm((esp_zb_callback_t)bdb_start_top_level_commissioning_cb,
-                           ESP_ZB_BDB_MODE_NETWORK_STEERING, 0);
+    esp_zb_scheduler_alarm((esp_zb_callback_t)rejoin_resume, 0, 0);
     esp_zb_lock_release();
 }
 
@@ -1608,6 +2907,8 @@ static void start_rejoin_watchdog(void)
  * the link is dead even if the stack still thinks we're joined - force a rejoin. */
 static void aps_data_confirm_cb(esp_zb_apsde_data_confirm_t confirm)
 {
+    power_profiler_tx();
+    poll_control_traffic(POLL_WINDOW_APS_ACK);
     if (confirm.status == 0) {
         /* Delivered: link is alive. */
         aps_tx_fail_streak = 0;
@@ -1617,6 +2918,7 @@ static void aps_data_confirm_cb(esp_zb_apsde_data_confirm_t confirm)
 
     /* Delivery failed (no ACK / no route to parent or coordinator). */
     aps_tx_fail_streak++;
+    aps_tx_fail_total++;
     ESP_LOGW(TAG, "📨 APS delivery failed (status=0x%02x, streak=%lu/%d)",
              confirm.status, (unsigned long)aps_tx_fail_streak, HEARTBEAT_FAIL_THRESHOLD);
 
@@ -1625,339 +2927,151 @@ static void aps_data_confirm_cb(esp_zb_apsde_data_confirm_t confirm)
                  (unsigned long)aps_tx_fail_streak);
         zigbee_network_connected = false;
         aps_tx_fail_streak = 0;
-        /* Zigbee task context: schedule steering directly (no lock needed). */
-        esp_zb_scheduler_alarm((esp_zb_callback_t)bdb_start_top_level_commissioning_cb,
-                               ESP_ZB_BDB_MODE_NETWORK_STEERING, 0);
+        /* Zigbee task context: start the rejoin directly (no lock needed). The
+         * first attempts stay on the current channel - the parent is usually
+         * gone, not the network. */
+        rejoin_start();
     }
 }
 
-/* Rain gauge implementation */
-static void IRAM_ATTR rain_gauge_isr_handler(void *arg)
+/* APS data-indication callback: every frame addressed to us (Zigbee task).
+ * Only feeds the poll windows; false hands the frame on to the stack. */
+static bool aps_data_indication_cb(esp_zb_apsde_data_ind_t ind)
 {
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-
-    /* Prepare event with ISR tick for accurate timing */
-    rain_evt_t evt = {
-        .type = RAIN_EVENT_PULSE,
-        .tick = xTaskGetTickCountFromISR(),
-        .force_nvs = false,
-        .force_attribute = false,
-    };
-
-    /* Only queue event if there's space - prevents overflow from rapid pulses.
-     * If the queue is full the pulse is dropped, but this prevents a crash. */
-    xQueueSendFromISR(rain_gauge_evt_queue, &evt, &xHigherPriorityTaskWoken);
-    
-    if (xHigherPriorityTaskWoken) {
-        portYIELD_FROM_ISR();
-    }
+    poll_control_frame_received(ind.dst_endpoint == 0 ? 0 : ind.cluster_id);
+    return false;
 }
 
-static void rain_gauge_task(void *arg)
-{
-    rain_evt_t evt;
-    TickType_t last_pulse_time = 0;
-    uint32_t pending_pulse_count = 0;
-    bool pending_nvs_flush = false;
-    bool pending_attr_flush = false;
-    const TickType_t DEBOUNCE_TIME = pdMS_TO_TICKS(200); // 200ms debounce
-
-    ESP_LOGI(RAIN_TAG, "Rain gauge task started, waiting for events...");
+/* Battery monitoring functions.
+ * Battery readings are handled by battery_monitor.c (MOSFET-controlled, owns
+ * ADC1). This file only does the NVS persistence and Zigbee reporting around
+ * battery_read_voltage(); when to read is decided by the cadence table. */
+static const char *BATTERY_TAG = "BATTERY";
 
-    for (;;) {
-        if (xQueueReceive(rain_gauge_evt_queue, &evt, portMAX_DELAY)) {
-            switch (evt.type) {
-            case RAIN_EVENT_PULSE: {
-                TickType_t current_time = evt.tick;
-
-                if ((current_time - last_pulse_time) > DEBOUNCE_TIME) {
-                    last_pulse_time = current_time;
-                    pending_pulse_count++;
-                    rain_pulse_count++;
-                    total_rainfall_mm += RAIN_MM_PER_PULSE;
-                    total_rainfall_mm = roundf(total_rainfall_mm * 100.0f) / 100.0f;
-
-                    ESP_LOGI(RAIN_TAG, "🌧️ Rain pulse #%u: %.2f mm total (+%.2f mm)",
-                             rain_pulse_count, total_rainfall_mm, RAIN_MM_PER_PULSE);
-
-                    pending_nvs_flush = true;
-                    if (rain_gauge_enabled && zigbee_network_connected) {
-                        pending_attr_flush = true;
-                    }
-
-                    if (pending_pulse_count >= RAIN_PULSE_FLUSH_THRESHOLD) {
-                        ESP_LOGD(RAIN_TAG, "Pulse threshold reached (%u) - flushing totals", pending_pulse_count);
-                        rain_gauge_flush_totals(pending_nvs_flush, pending_attr_flush);
-                        pending_pulse_count = 0;
-                        pending_nvs_flush = false;
-                        pending_attr_flush = false;
-                        if (rain_flush_timer != NULL) {
-                            esp_timer_stop(rain_flush_timer);
-                        }
-                    } else {
-                        if (rain_flush_timer != NULL) {
-                            esp_timer_stop(rain_flush_timer);
-                            esp_timer_start_once(rain_flush_timer, RAIN_FLUSH_INTERVAL_US);
-                        }
-                    }
-                } else {
-                    ESP_LOGD(RAIN_TAG, "Pulse ignored - debounce active (%u ms)",
-                             pdTICKS_TO_MS(current_time - last_pulse_time));
-                }
-                break;
-            }
-
-            case RAIN_EVENT_FLUSH: {
-                bool do_nvs = pending_nvs_flush || evt.force_nvs;
-                bool do_attr = pending_attr_flush || evt.force_attribute;
-
-                if (do_nvs || do_attr) {
-                    rain_gauge_flush_totals(do_nvs, do_attr);
-                    pending_pulse_count = 0;
-                    pending_nvs_flush = false;
-                    pending_attr_flush = false;
-                }
-                if (rain_flush_timer != NULL) {
-                    esp_timer_stop(rain_flush_timer);
-                }
-                break;
-            }
-
-            default:
-                break;
-            }
-        }
-    }
+#define BATTERY_MIN_VOLTAGE     2.7f             // Li-Ion minimum safe voltage (V)
+#define BATTERY_MAX_VOLTAGE     4.2f             // Li-Ion maximum voltage (V)
+#define BATTERY_ADC_REBOOT_MIN_UPTIME_S  600     // don't auto-reboot to recover the ADC within 10 min of boot (anti-loop)
+/* Monotonic across software resets: esp_timer restarts at 0 on every boot */
+static int64_t battery_clock_us(void)
+{
+    return battery_clock_base_us + esp_timer_get_time();
 }
 
-static void rain_flush_timer_callback(void *arg)
+/* Keep the RTC clock close to now, so the time lost in an unexpected reset is
+ * at most one cadence tick */
+static void battery_rtc_touch(void)
 {
-    rain_gauge_request_flush(false, false);
+    rtc_battery.clock_us = battery_clock_us();
 }
 
-static void rain_gauge_request_flush(bool force_nvs, bool force_attribute)
+static void battery_rtc_restore(void)
 {
-    if (rain_gauge_evt_queue == NULL) {
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (rtc_battery.magic == BATTERY_RTC_MAGIC && reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT) {
+        battery_clock_base_us = rtc_battery.clock_us;
+        ESP_LOGI(BATTERY_TAG, "♻️ Battery record from RTC memory: %.2fV, last read %lld s ago",
+                 rtc_battery.voltage_v,
+                 rtc_battery.last_read_us < 0 ? -1LL : (battery_clock_us() - rtc_battery.last_read_us) / 1000000LL);
         return;
     }
 
-    rain_evt_t evt = {
-        .type = RAIN_EVENT_FLUSH,
-        .tick = xTaskGetTickCount(),
-        .force_nvs = force_nvs,
-        .force_attribute = force_attribute,
-    };
-
-    if (xQueueSend(rain_gauge_evt_queue, &evt, 0) != pdPASS) {
-        ESP_LOGW(RAIN_TAG, "Failed to queue rain flush event (queue full)");
+    /* Power-on: last checkpoint from NVS, but no read time - the join cycle reads */
+    memset(&rtc_battery, 0, sizeof(rtc_battery));
+    rtc_battery.magic = BATTERY_RTC_MAGIC;
+    rtc_battery.last_read_us = -1;
+    rtc_battery.zigbee_voltage = 0xFF;
+    rtc_battery.zigbee_percentage = 0xFF;
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READONLY, &nvs_handle) == ESP_OK) {
+        nvs_get_u8(nvs_handle, "batt_zb_v", &rtc_battery.zigbee_voltage);
+        nvs_get_u8(nvs_handle, "batt_zb_p", &rtc_battery.zigbee_percentage);
+        nvs_get_blob(nvs_handle, "batt_v", &rtc_battery.voltage_v, &(size_t){sizeof(float)});
+        nvs_get_u32(nvs_handle, "batt_reboots", &rtc_battery.reboots);
+        nvs_close(nvs_handle);
     }
+    rtc_battery.last_good_mv = (uint16_t)(rtc_battery.voltage_v * 1000.0f);
+    ESP_LOGI(BATTERY_TAG, "📂 Battery checkpoint from NVS: %.2fV (%lu ADC-recovery reboots)",
+             rtc_battery.voltage_v, (unsigned long)rtc_battery.reboots);
 }
 
-static void rain_gauge_flush_totals(bool save_to_nvs, bool update_attribute)
+/* true if the last real read is younger than the battery cadence */
+static bool battery_reading_fresh(int64_t *age_us)
 {
-    float rounded_rainfall = roundf(total_rainfall_mm * 100.0f) / 100.0f;
-
-    if (save_to_nvs) {
-        ESP_LOGI(RAIN_TAG, "💾 Flushing rain totals to storage: %.2f mm (%u pulses)",
-                 rounded_rainfall, rain_pulse_count);
-        save_rainfall_data(rounded_rainfall, rain_pulse_count);
-    }
-
-    if (update_attribute) {
-        /* Only check network connection, not ISR enabled state
-         * This allows periodic updates even when ISR is temporarily disabled */
-        if (!zigbee_network_connected) {
-            ESP_LOGW(RAIN_TAG, "Skipping Zigbee update - network not connected");
-            return;
-        }
-
-        /* CRITICAL: this runs in rain_gauge_task, NOT the Zigbee task. Unlike the
-         * other *_read_and_report() functions (dispatched via esp_zb_scheduler_alarm
-         * and therefore already on the Zigbee thread), we must take the stack lock
-         * before calling any esp_zb_* API. Calling it unlocked races with the
-         * Zigbee main loop's critical sections and corrupts port_uxCriticalNesting,
-         * which trips "assert failed: vPortExitCritical (port_uxCriticalNesting[0] > 0)". */
-        esp_zb_lock_acquire(portMAX_DELAY);
-        esp_err_t ret = esp_zb_zcl_set_attribute_val(
-            HA_ESP_RAIN_GAUGE_ENDPOINT,
-            ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
-            ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-            ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID,
-            &rounded_rainfall,
-            false);
-        esp_zb_lock_release();
+    if (rtc_battery.last_read_us < 0) return false;
+    int64_t age = battery_clock_us() - rtc_battery.last_read_us;
+    if (age_us) *age_us = age;
+    return age >= 0 && age < (int64_t)CADENCE_BATTERY_S * 1000000LL;
+}
 
-        if (ret == ESP_OK) {
-            ESP_LOGI(RAIN_TAG, "📡 Rain gauge attribute updated: %.2f mm (%u pulses)", rounded_rainfall, rain_pulse_count);
-        } else {
-            ESP_LOGE(RAIN_TAG, "❌ Failed to update rain attribute: %s", esp_err_to_name(ret));
-        }
-    }
+static void battery_nvs_checkpoint(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open("storage", NVS_READWRITE, &nvs_handle) != ESP_OK) return;
+    uint8_t pct = rtc_battery.zigbee_percentage == 0xFF ? 0 : rtc_battery.zigbee_percentage / 2;
+    float percentage = (float)pct;
+    nvs_set_u8(nvs_handle, "batt_zb_v", rtc_battery.zigbee_voltage);
+    nvs_set_u8(nvs_handle, "batt_zb_p", rtc_battery.zigbee_percentage);
+    nvs_set_blob(nvs_handle, "batt_v", &rtc_battery.voltage_v, sizeof(float));
+    nvs_set_blob(nvs_handle, "batt_pct", &percentage, sizeof(float));
+    nvs_set_u32(nvs_handle, "batt_reboots", rtc_battery.reboots);
+    nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    rtc_battery.reads_since_checkpoint = 0;
+    ESP_LOGI(BATTERY_TAG, "💾 Battery checkpoint saved to NVS: %.2fV", rtc_battery.voltage_v);
 }
 
-static void rain_gauge_enable_isr(void)
+/* esp_restart() path (OTA, ADC recovery, factory reset): the RTC record
+ * survives, but save the checkpoint in case power goes next */
+static void battery_shutdown_handler(void)
 {
-    ESP_LOGI(RAIN_TAG, "🔧 Enabling rain gauge ISR on GPIO%d (installed: %s)", RAIN_GAUGE_GPIO, rain_gauge_isr_installed ? "YES" : "NO");
-    
-    // Set enabled flag first
-    rain_gauge_enabled = true;
-    
-    // Add ISR handler (will succeed even if already added)
-    esp_err_t ret = gpio_isr_handler_add(RAIN_GAUGE_GPIO, rain_gauge_isr_handler, NULL);
-    if (ret == ESP_OK) {
-        rain_gauge_isr_installed = true;
-        ESP_LOGI(RAIN_TAG, "✅ Rain gauge ISR enabled successfully on GPIO%d", RAIN_GAUGE_GPIO);
-        /* Ensure interrupt line is enabled so events will be delivered */
-        gpio_intr_enable(RAIN_GAUGE_GPIO);
-    } else if (ret == ESP_ERR_INVALID_STATE) {
-        // ISR already installed - this is fine
-        rain_gauge_isr_installed = true;
-        ESP_LOGI(RAIN_TAG, "✅ Rain gauge ISR already installed, now enabled");
-        /* Make sure the interrupt line is enabled in case it was disabled */
-        gpio_intr_enable(RAIN_GAUGE_GPIO);
-    } else {
-        ESP_LOGE(RAIN_TAG, "❌ Failed to enable rain gauge ISR: %s", esp_err_to_name(ret));
+    battery_rtc_touch();
+    if (rtc_battery.reads_since_checkpoint > 0) {
+        battery_nvs_checkpoint();
     }
-    
-    // Test GPIO level at enable time
-    int current_level = gpio_get_level(RAIN_GAUGE_GPIO);
-    ESP_LOGI(RAIN_TAG, "🔌 Current GPIO%d level at enable: %d", RAIN_GAUGE_GPIO, current_level);
 }
 
-/* Battery monitoring functions.
- * Battery readings are handled by battery_monitor.c (MOSFET-controlled, owns
- * ADC1). This file only does the time-gating, NVS persistence and Zigbee
- * reporting around battery_read_voltage(). */
-static const char *BATTERY_TAG = "BATTERY";
-
-#define BATTERY_MIN_VOLTAGE     2.7f             // Li-Ion minimum safe voltage (V)
-#define BATTERY_MAX_VOLTAGE     4.2f             // Li-Ion maximum voltage (V)
-#define BATTERY_ADC_REBOOT_MIN_UPTIME_S  600     // don't auto-reboot to recover the ADC within 10 min of boot (anti-loop)
-
+/* Real ADC read, only called when the battery cadence is due (hourly) */
 static void battery_read_and_report(uint8_t param)
 {
-    // param: 0 = normal (honour the hourly gate); 1 = force a real ADC read now
-    // (used right after join so the diagnostic attributes populate promptly).
-    // Forced reports fail after reboot because reporting config is not persisted
-    bool force_report = false;
-    bool force_now = (param != 0);
+    (void)param;
+    esp_err_t err;
+
+    ESP_LOGI(BATTERY_TAG, "🔧 battery_read_and_report() called");
 
-    ESP_LOGI(BATTERY_TAG, "🔧 battery_read_and_report() called%s", force_now ? " (forced)" : "");
-    
-    /* Power optimization: Read battery only once per hour (time-based) to save ~360µAh/day
-     * This ensures we read once per hour regardless of wake reason (rain vs timer).
-     * Uses NVS to persist timestamp across deep sleep. */
-    
-    const uint32_t BATTERY_READ_INTERVAL_SEC = 3600;  // 1 hour
-    
-    // Get current time since boot (in seconds)
-    uint32_t current_time_sec = (uint32_t)(esp_timer_get_time() / 1000000ULL);
-    
-    ESP_LOGI(BATTERY_TAG, "🕐 Current time since boot: %lu seconds", current_time_sec);
-    
-    // Read last battery reading timestamp from NVS
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
-    uint32_t last_battery_read_time = 0;
-    bool first_reading = false;
-    bool force_read = false;
-    
-    if (err == ESP_OK) {
-        err = nvs_get_u32(nvs_handle, "batt_time", &last_battery_read_time);
-        if (err != ESP_OK) {
-            first_reading = true;  // Key doesn't exist - this is the first reading
-            ESP_LOGI(BATTERY_TAG, "📝 No previous battery timestamp in NVS - first reading");
-        } else {
-            ESP_LOGI(BATTERY_TAG, "📝 Last battery timestamp from NVS: %lu seconds", last_battery_read_time);
-            
-            // Check for reboot: if saved timestamp is close to current boot time (within 30 seconds),
-            // it means we rebooted and should force a reading
-            if (last_battery_read_time < 30 && current_time_sec < 30) {
-                ESP_LOGI(BATTERY_TAG, "🔄 Recent boot detected (both times < 30s) - forcing battery read");
-                force_read = true;
-            }
-        }
-        nvs_close(nvs_handle);
-    } else {
-        first_reading = true;  // NVS not available - assume first reading
-        ESP_LOGW(BATTERY_TAG, "⚠️  NVS not available - assuming first reading");
-    }
-    
-    // Check if enough time has elapsed (skip interval check on first reading or forced read)
-    if (!first_reading && !force_read && !force_now) {
-        // Handle potential timer overflow on reboot: if last_battery_read_time is much larger
-        // than current_time_sec, it means we rebooted and should read battery
-        if (last_battery_read_time > current_time_sec) {
-            ESP_LOGI(BATTERY_TAG, "🔄 Device rebooted (timer reset detected) - forcing battery read");
-            force_read = true;
-        } else {
-            uint32_t elapsed_sec = current_time_sec - last_battery_read_time;
-            ESP_LOGI(BATTERY_TAG, "⏱️  Elapsed time: %lu seconds (need %lu for next reading)", 
-                     elapsed_sec, BATTERY_READ_INTERVAL_SEC);
-            if (elapsed_sec < BATTERY_READ_INTERVAL_SEC) {
-                ESP_LOGI(BATTERY_TAG, "⏭️  Skipping battery read (%lu sec since last, need %lu)", 
-                         elapsed_sec, BATTERY_READ_INTERVAL_SEC);
-                // Read last battery values from NVS and update Zigbee attributes
-                float battery_voltage = 0.0f;
-                float percentage = 0.0f;
-                uint8_t zigbee_voltage = 0;
-                uint8_t zigbee_percentage = 0;
-                esp_err_t nvs_err = nvs_open("storage", NVS_READONLY, &nvs_handle);
-                if (nvs_err == ESP_OK) {
-                    nvs_get_u8(nvs_handle, "batt_zb_v", &zigbee_voltage);
-                    nvs_get_u8(nvs_handle, "batt_zb_p", &zigbee_percentage);
-                    nvs_get_blob(nvs_handle, "batt_v", &battery_voltage, &(size_t){sizeof(float)});
-                    nvs_get_blob(nvs_handle, "batt_pct", &percentage, &(size_t){sizeof(float)});
-                    nvs_close(nvs_handle);
-                }
-                // Update Zigbee attributes with last known values
-                esp_zb_zcl_set_attribute_val(
-                    HA_ESP_ENV_SENSOR_ENDPOINT,
-                    ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-                    ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                    0x0020,
-                    &zigbee_voltage,
-                    force_report);
-                esp_zb_zcl_set_attribute_val(
-                    HA_ESP_ENV_SENSOR_ENDPOINT,
-                    ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-                    ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-                    0x0021,
-                    &zigbee_percentage,
-                    force_report);
-                ESP_LOGI(BATTERY_TAG, "🔁 Restored battery values from NVS: %.2fV (%.0f%%) - Zigbee: %u, %u",
-                         battery_voltage, percentage, zigbee_voltage, zigbee_percentage);
-                return;  // Skip this reading
-            }
-            ESP_LOGI(BATTERY_TAG, "🔋 Reading battery (last read %lu sec ago)", elapsed_sec);
-        }
-    }
-    if (first_reading) {
-        ESP_LOGI(BATTERY_TAG, "🔋 Reading battery (first reading after boot/pairing)");
-    } else if (force_read) {
-        ESP_LOGI(BATTERY_TAG, "🔋 Reading battery (forced after reboot)");
-    }
-    // Time to read battery - update timestamp in NVS
-    err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-    if (err == ESP_OK) {
-        nvs_set_u32(nvs_handle, "batt_time", current_time_sec);
-        nvs_commit(nvs_handle);
-        nvs_close(nvs_handle);
-    }
     float battery_voltage = 0.0f;
     /* Read battery via the MOSFET-controlled monitor (battery_monitor.c).
      * It owns ADC1 exclusively: enables the GPIO3 MOSFET, samples GPIO4, applies
      * calibration + voltage divider, then releases the ADC unit so it can power
      * down during sleep. This replaces the old inline ADC path that conflicted
      * with battery_monitor.c over ADC1 and fell back to a simulated 3.7V. */
+    /* The estimate is advanced by the charge the profiler saw since the last
+     * read. Once it has settled a single burst is enough; a read it cannot
+     * explain is confirmed with the full median before it is used. */
+    battery_estimate_t estimate = rtc_battery.estimate;
+    power_profile_t profile;
+    power_profiler_get(&profile);
+    int64_t since_read_us = rtc_battery.last_read_us < 0 ? 0 : battery_clock_us() - rtc_battery.last_read_us;
+    battery_estimate_predict(&estimate, profile.charge_uah, (uint32_t)(since_read_us / 1000000LL));
+
+    bool quick = battery_estimate_quick_ok(&estimate);
     uint16_t battery_mv = 0;
-    err = battery_read_voltage(&battery_mv);
+    err = quick ? battery_read_voltage_quick(&battery_mv) : battery_read_voltage(&battery_mv);
+    if (err == ESP_OK && quick) {
+        float sigma = battery_estimate_innovation(&estimate, battery_load_compensate(battery_mv, POWER_MODEL_ACTIVE_UA),
+                                                  BATTERY_EST_QUICK_NOISE_MV);
+        if (sigma > BATTERY_EST_GATE_SIGMA) {
+            ESP_LOGW(BATTERY_TAG, "⚠️ Quick read %u mV is %.1f sigma off the estimate (%.0f mV) - confirming with a full read",
+                     battery_mv, sigma, estimate.ocv_mv);
+            quick = false;
+            err = battery_read_voltage(&battery_mv);
+        }
+    }
     if (err != ESP_OK) {
         ESP_LOGE(BATTERY_TAG, "battery_read_voltage failed (%s), using simulated value", esp_err_to_name(err));
         battery_voltage = 3.7f;  // Fallback simulated value
     } else {
         battery_voltage = battery_mv / 1000.0f;
-        ESP_LOGI(BATTERY_TAG, "📊 Battery: %.2fV (%u mV)", battery_voltage, battery_mv);
+        ESP_LOGI(BATTERY_TAG, "📊 Battery: %.2fV (%u mV, %s read)", battery_voltage, battery_mv, quick ? "quick" : "full");
     }
 
     /* Publish per-read diagnostics (genPowerCfg 0x4000..0x4003) BEFORE the glitch
@@ -1969,24 +3083,13 @@ static void battery_read_and_report(uint8_t param)
         uint16_t diag_div_mv = battery_get_last_divider_mv();
         uint8_t  diag_cal = battery_get_last_calibrated() ? 1 : 0;
         uint16_t diag_uptime_min = (uint16_t)((esp_timer_get_time() / 1000000ULL) / 60ULL);
-        esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-                                     ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x4000, &diag_raw, false);
-        esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-                                     ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x4001, &diag_div_mv, false);
-        esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-                                     ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x4002, &diag_cal, false);
-        esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-                                     ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x4003, &diag_uptime_min, false);
-
-        uint32_t diag_reboots32 = 0;
-        nvs_handle_t d_h;
-        if (nvs_open("storage", NVS_READONLY, &d_h) == ESP_OK) {
-            nvs_get_u32(d_h, "batt_reboots", &diag_reboots32);
-            nvs_close(d_h);
-        }
-        uint16_t diag_reboots = (uint16_t)diag_reboots32;
-        esp_zb_zcl_set_attribute_val(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-                                     ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 0x4004, &diag_reboots, false);
+        attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4000, &diag_raw);
+        attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4001, &diag_div_mv);
+        attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4002, &diag_cal);
+        attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4003, &diag_uptime_min);
+
+        uint16_t diag_reboots = (uint16_t)rtc_battery.reboots;
+        attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG, 0x4004, &diag_reboots);
     }
 
     /* Glitch guard: a Li-Ion under this tiny load cannot really lose hundreds of
@@ -1994,15 +3097,13 @@ static void battery_read_and_report(uint8_t param)
      * consecutive low read before we believe it, so one bad measurement can't
      * poison the value that then gets cached/re-published for an hour. */
     {
-        static uint16_t s_last_good_mv = 0;
-        static uint8_t  s_drop_confirm = 0;
         const uint16_t  MAX_PLAUSIBLE_DROP_MV = 500;
         uint16_t measured_mv = (uint16_t)(battery_voltage * 1000.0f);
 
-        if (s_last_good_mv != 0 && measured_mv + MAX_PLAUSIBLE_DROP_MV < s_last_good_mv) {
-            if (++s_drop_confirm < 2) {
+        if (rtc_battery.last_good_mv != 0 && measured_mv + MAX_PLAUSIBLE_DROP_MV < rtc_battery.last_good_mv) {
+            if (++rtc_battery.drop_confirm < 2) {
                 ESP_LOGW(BATTERY_TAG, "⚠️ Implausible battery drop %u -> %u mV - ignoring (keeping last good %u mV)",
-                         s_last_good_mv, measured_mv, s_last_good_mv);
+                         rtc_battery.last_good_mv, measured_mv, rtc_battery.last_good_mv);
                 return;  // do NOT overwrite the cached good value; re-confirm next read
             }
             /* Confirmed over two reads, and the driver's ADC self-heal already
@@ -2013,15 +3114,8 @@ static void battery_read_and_report(uint8_t param)
              * re-attaches to the network after the restart. */
             uint32_t uptime_s = (uint32_t)(esp_timer_get_time() / 1000000ULL);
             if (uptime_s > BATTERY_ADC_REBOOT_MIN_UPTIME_S) {
-                nvs_handle_t rb_h;
-                if (nvs_open("storage", NVS_READWRITE, &rb_h) == ESP_OK) {
-                    uint32_t n = 0;
-                    nvs_get_u32(rb_h, "batt_reboots", &n);
-                    n++;
-                    nvs_set_u32(rb_h, "batt_reboots", n);
-                    nvs_commit(rb_h);
-                    nvs_close(rb_h);
-                }
+                rtc_battery.reboots++;
+                rtc_battery.reads_since_checkpoint++;   // the shutdown handler saves the count
                 ESP_LOGE(BATTERY_TAG, "🔁 Battery stuck low (%u mV) after ADC self-heal - rebooting to restore ADC reference", measured_mv);
                 vTaskDelay(pdMS_TO_TICKS(50));  // let the log flush
                 esp_restart();
@@ -2029,55 +3123,51 @@ static void battery_read_and_report(uint8_t param)
             ESP_LOGW(BATTERY_TAG, "Confirmed low battery %u mV but uptime %lus < reboot guard - accepting for now",
                      measured_mv, (unsigned long)uptime_s);
         }
-        s_drop_confirm = 0;
-        s_last_good_mv = measured_mv;
+        rtc_battery.drop_confirm = 0;
+        rtc_battery.last_good_mv = measured_mv;
+    }
+
+    /* Report the filtered open-circuit voltage, not the single loaded read */
+    if (err == ESP_OK) {
+        uint16_t ocv_mv = battery_estimate_update(&estimate, battery_load_compensate(battery_mv, POWER_MODEL_ACTIVE_UA),
+                                                  quick ? BATTERY_EST_QUICK_NOISE_MV : BATTERY_EST_FULL_NOISE_MV);
+        rtc_battery.estimate = estimate;
+        battery_voltage = ocv_mv / 1000.0f;
+        ESP_LOGI(BATTERY_TAG, "📈 Estimate: %u mV +/- %.0f mV", ocv_mv, sqrtf(estimate.var_mv2));
     }
 
     // Calculate battery percentage from the shared Li-Ion discharge curve
     // (battery_voltage_to_percentage in battery_monitor.c) so the reported value
     // matches the driver's model and reflects the real non-linear discharge.
     uint8_t pct = battery_voltage_to_percentage((uint16_t)(battery_voltage * 1000.0f));
-    float percentage = (float)pct;  // kept as float for NVS persistence below
+    float percentage = (float)pct;
     // Zigbee uses different units:
     // - Battery voltage: 0.1V units (e.g., 30 = 3.0V)
     // - Battery percentage: 0-200 scale (200 = 100%, 100 = 50%)
     uint8_t zigbee_voltage = (uint8_t)(battery_voltage * 10.0f);
     uint8_t zigbee_percentage = (uint8_t)(pct * 2);
-    // Store last measured values in NVS
-    err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-    if (err == ESP_OK) {
-        nvs_set_u8(nvs_handle, "batt_zb_v", zigbee_voltage);
-        nvs_set_u8(nvs_handle, "batt_zb_p", zigbee_percentage);
-        nvs_set_blob(nvs_handle, "batt_v", &battery_voltage, sizeof(float));
-        nvs_set_blob(nvs_handle, "batt_pct", &percentage, sizeof(float));
-        nvs_commit(nvs_handle);
-        nvs_close(nvs_handle);
+    // Keep the last values in RTC memory, NVS only gets the periodic checkpoint
+    rtc_battery.voltage_v = battery_voltage;
+    rtc_battery.zigbee_voltage = zigbee_voltage;
+    rtc_battery.zigbee_percentage = zigbee_percentage;
+    rtc_battery.last_read_us = battery_clock_us();
+    battery_rtc_touch();
+    if (++rtc_battery.reads_since_checkpoint >= BATTERY_NVS_CHECKPOINT_READS) {
+        battery_nvs_checkpoint();
     }
     // Update battery voltage attribute (0x0020)
-    esp_err_t ret = esp_zb_zcl_set_attribute_val(
-        HA_ESP_ENV_SENSOR_ENDPOINT,
-        ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        0x0020,  // Battery Voltage attribute ID
-        &zigbee_voltage,
-        force_report
-    );
+    esp_err_t ret = attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+                                   0x0020, &zigbee_voltage);  // Battery Voltage attribute ID
     if (ret != ESP_OK) {
         ESP_LOGE(BATTERY_TAG, "❌ Failed to update battery voltage: %s", esp_err_to_name(ret));
     }
     // Update battery percentage attribute (0x0021)
-    ret = esp_zb_zcl_set_attribute_val(
-        HA_ESP_ENV_SENSOR_ENDPOINT,
-        ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-        ESP_ZB_ZCL_CLUSTER_SERVER_ROLE,
-        0x0021,  // Battery Percentage Remaining attribute ID
-        &zigbee_percentage,
-        force_report
-    );
+    ret = attr_cache_set(HA_ESP_ENV_SENSOR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+                         0x0021, &zigbee_percentage);  // Battery Percentage Remaining attribute ID
     if (ret != ESP_OK) {
         ESP_LOGE(BATTERY_TAG, "❌ Failed to update battery percentage: %s", esp_err_to_name(ret));
     }
-    ESP_LOGI(BATTERY_TAG, "🔋 Li-Ion Battery: %.2fV (%.0f%%) (attributes updated)",
+    ESP_LOGI(BATTERY_TAG, "🔋 Li-Ion Battery: %.2fV (%.0f%%) (attributes cached)",
              battery_voltage, percentage);
 
     /* The ADC unit + calibration are kept initialized for the device lifetime
@@ -2091,152 +3181,39 @@ static void battery_read_and_report(uint8_t param)
  * task watchdog. Deletes itself once initialization is complete. */
 static void rain_gauge_init_task(void *arg)
 {
-    rain_gauge_init();
+    rain_gauge_init(zigbee_is_connected);
     vTaskDelete(NULL);
 }
 
-static void rain_gauge_init(void)
+/* Read by the rain task to gate attribute writes */
+static bool zigbee_is_connected(void)
 {
-    ESP_LOGI(RAIN_TAG, "Initializing rain gauge on GPIO%d (disabled until network connection)", RAIN_GAUGE_GPIO);
-    
-    /* Start disabled - will be enabled when connected to network */
-    rain_gauge_enabled = false;
-    
-    /* Note: Rainfall data already loaded in esp_zb_task() before cluster creation.
-     * The global variables total_rainfall_mm and rain_pulse_count are already set.
-     * This ensures the Zigbee cluster is initialized with the correct value. */
-    ESP_LOGI(RAIN_TAG, "Current rainfall total: %.2f mm (%lu pulses)", total_rainfall_mm, rain_pulse_count);
-    
-    /* Check wake reason and count the wake-causing pulse if present. Record
-     * the tick so we can avoid a duplicate count if an ISR event for the
-     * same edge is queued immediately after. */
-    wake_reason_t wake_reason = check_wake_reason();
-    if (wake_reason == WAKE_REASON_RAIN) {
-        rain_pulse_count++;
-        total_rainfall_mm += RAIN_MM_PER_PULSE;
-        total_rainfall_mm = roundf(total_rainfall_mm * 100.0f) / 100.0f; // Round to 2 decimals
-
-        ESP_LOGI(RAIN_TAG, "🌧️ Rain pulse detected during sleep! Pulse #%u, Total: %.2f mm (+%.2f mm)", 
-                 rain_pulse_count, total_rainfall_mm, RAIN_MM_PER_PULSE);
-
-        // Save to NVS immediately when waking from rain
-        save_rainfall_data(total_rainfall_mm, rain_pulse_count);
-    }
-    
-    /* Configure GPIO for rain gauge.
-     * The DRV5032 has an OPEN-DRAIN, active-LOW output: it pulls the line to GND
-     * when a magnet is present and is high-impedance otherwise. It therefore
-     * REQUIRES a pull-up to read HIGH at rest. Enable the internal pull-up so the
-     * line is defined even if the board's external pull-up is missing/weak/wrong-
-     * footprint (a floating line was a prime suspect for "rain gauge not working").
-     * The internal pull-up is harmless if an external one is also present.
-     * Counting edge left as POSEDGE: with a pull-up the line rests HIGH and a
-     * bucket tip pulls it LOW briefly, so the rising edge (magnet leaving) is one
-     * count per tip. Verify one tip == one count on the bench via the monitor log. */
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_POSEDGE,
-        .pin_bit_mask = (1ULL << RAIN_GAUGE_GPIO),
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = 1,
-        .pull_down_en = 0,
-    };
-    esp_err_t ret = gpio_config(&io_conf);
-    if (ret != ESP_OK) {
-        ESP_LOGE(RAIN_TAG, "Failed to configure GPIO%d: %s", RAIN_GAUGE_GPIO, esp_err_to_name(ret));
-        return;
-    }
-    
-    ESP_LOGI(RAIN_TAG, "✅ GPIO%d configured successfully", RAIN_GAUGE_GPIO);
-
-    /* Read the resting level BEFORE arming the wake source. */
-    int initial_level = gpio_get_level(RAIN_GAUGE_GPIO);
-    ESP_LOGI(RAIN_TAG, "🔌 Initial GPIO%d level: %d", RAIN_GAUGE_GPIO, initial_level);
-
-    /* Enable GPIO wakeup for light sleep - allows rain pulses to wake the device.
-     * CRITICAL: light-sleep GPIO wake is LEVEL-triggered. Arming the level the
-     * pin is ALREADY at makes the wake condition immediately true, so the stack
-     * wakes the instant it tries to sleep - a sleep/wake livelock that starves
-     * the IDLE task and trips the task watchdog. Always arm the OPPOSITE of the
-     * current resting level, so a bucket tip (which toggles the line) wakes us. */
-    gpio_int_type_t wake_level = initial_level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
-    ret = gpio_wakeup_enable(RAIN_GAUGE_GPIO, wake_level);
-    if (ret == ESP_OK) {
-        ESP_LOGI(RAIN_TAG, "✅ GPIO%d armed as light-sleep wake source (wake on %s, resting=%d)",
-                 RAIN_GAUGE_GPIO, wake_level == GPIO_INTR_LOW_LEVEL ? "LOW" : "HIGH", initial_level);
-    } else {
-        ESP_LOGW(RAIN_TAG, "⚠️ Failed to enable GPIO wake: %s", esp_err_to_name(ret));
-    }
-
-    /* Create queue for rain events (GPIO pulses + flush requests) */
-    rain_gauge_evt_queue = xQueueCreate(32, sizeof(rain_evt_t));
-    if (!rain_gauge_evt_queue) {
-        ESP_LOGE(RAIN_TAG, "Failed to create event queue");
-        return;
-    }
-
-    /* Create timer used to flush accumulated pulses */
-    const esp_timer_create_args_t flush_timer_args = {
-        .callback = rain_flush_timer_callback,
-        .name = "rain_flush"
-    };
-    if (esp_timer_create(&flush_timer_args, &rain_flush_timer) != ESP_OK) {
-        ESP_LOGE(RAIN_TAG, "Failed to create rain flush timer");
-        return;
-    }
-    
-    /* Install GPIO ISR service if not already installed */
-    esp_err_t isr_ret = gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
-    if (isr_ret == ESP_ERR_INVALID_STATE) {
-        ESP_LOGD(RAIN_TAG, "GPIO ISR service already installed (shared with button driver)");
-    } else if (isr_ret != ESP_OK) {
-        ESP_LOGE(RAIN_TAG, "Failed to install ISR service: %s", esp_err_to_name(isr_ret));
-        return;
-    } else {
-        ESP_LOGD(RAIN_TAG, "GPIO ISR service installed successfully");
-    }
-    
-    /* Install ISR handler now so pulses occurring after wake (but before
-     * Zigbee network reconnect) are captured and queued. We still keep
-     * `rain_gauge_enabled` false so reporting is deferred until connected.
-     */
-    esp_err_t add_ret = gpio_isr_handler_add(RAIN_GAUGE_GPIO, rain_gauge_isr_handler, NULL);
-    if (add_ret == ESP_OK) {
-        rain_gauge_isr_installed = true;
-        /* CRITICAL: Enable GPIO interrupt immediately after installing handler!
-         * Without this, pulses won't be detected even though handler is installed. */
-        gpio_intr_enable(RAIN_GAUGE_GPIO);
-        ESP_LOGI(RAIN_TAG, "✅ ISR handler installed early on GPIO%d (will count pulses while offline)", RAIN_GAUGE_GPIO);
-    } else if (add_ret == ESP_ERR_INVALID_STATE) {
-        /* Already installed by some other initialization path - treat as installed */
-        rain_gauge_isr_installed = true;
-        /* Make sure interrupt is enabled even if handler was already present */
-        gpio_intr_enable(RAIN_GAUGE_GPIO);
-        ESP_LOGI(RAIN_TAG, "ℹ️ ISR handler already present for GPIO%d (counting will occur)", RAIN_GAUGE_GPIO);
-    } else {
-        ESP_LOGW(RAIN_TAG, "⚠️ Failed to add ISR handler early: %s - pulses while offline may be missed", esp_err_to_name(add_ret));
-    }
-    ESP_LOGI(RAIN_TAG, "Rain gauge GPIO configured; ISR installed and interrupt enabled for offline counting");
-    
-    /* Create rain gauge task */
-    BaseType_t rain_task_ret = xTaskCreate(rain_gauge_task, "rain_gauge_task", 4096, NULL, 5, NULL);
-    if (rain_task_ret != pdPASS) {
-        ESP_LOGE(RAIN_TAG, "Failed to create rain gauge task");
-        return;
-    }
-
-    ESP_LOGI(RAIN_TAG, "Rain gauge initialized successfully. Current total: %.2f mm", total_rainfall_mm);
-    ESP_LOGI(RAIN_TAG, "🔧 GPIO%d configured: level=%d, pull-up=enabled, trigger=POSEDGE",
-             RAIN_GAUGE_GPIO, gpio_get_level(RAIN_GAUGE_GPIO));
-    
-    /* Initial rain value will be reported after network join (see signal handler) */
-    ESP_LOGI(RAIN_TAG, "Rain gauge ready - initial report will occur after network connection");
+    return zigbee_network_connected;
 }
 
 void app_main(void)
 {
+    power_profiler_init();      // first: everything after this is accounted for
+    
     /* Initialize NVS */
     ESP_ERROR_CHECK(nvs_flash_init());
-    
+    rain_log_init();            // before the rain totals are loaded; falls back to NVS without the partition
+    meas_log_init();            // offline samples left from before the reboot are still backfilled
+    
+    /* Attribute cache + deadbands (needed before the clusters are created) */
+    ESP_ERROR_CHECK(attr_cache_init(attr_cache_table, sizeof(attr_cache_table) / sizeof(attr_cache_table[0])));
+    ESP_ERROR_CHECK(telemetry_init(telemetry_table, sizeof(telemetry_table) / sizeof(telemetry_table[0]),
+                                   TELEMETRY_HEARTBEAT_S, (telemetry_mode_t)TELEMETRY_DEFAULT_MODE));
+    attr_cache_set_flush_cb(attr_cache_flushed);
+    sched_load_config();
+    battery_rtc_restore();      // before the power config cluster takes its initial values
+#if CONFIG_CAELUM_HAS_ENV
+    pressure_tendency_init();
+#endif
+    esp_register_shutdown_handler(battery_shutdown_handler);
+    ESP_ERROR_CHECK(channel_sched_init(cadence_table, sizeof(cadence_table) / sizeof(cadence_table[0])));
+    channel_sched_set_period(ACQ_CH_FAST, sched_interval_s);
+
     /* Initialize debug LED */
     debug_led_init();
     
@@ -2263,8 +3240,10 @@ void app_main(void)
     uint32_t pulse_count = 0;
     load_rainfall_data(&rainfall_mm, &pulse_count);
     
-    /* Print battery life estimate (assuming 2500mAh battery) */
-    estimate_battery_life(2500);
+    /* Print battery life estimate (assuming 2500mAh battery), then what the
+     * profile measured since power-on says (after a software reset) */
+    estimate_battery_life(BATTERY_CAPACITY_MAH);
+    power_profiler_log(BATTERY_CAPACITY_MAH);
     
     /* Configure ESP-IDF platform */
     esp_zb_platform_config_t config = {
@@ -2299,7 +3278,7 @@ void app_main(void)
     if (zigbee_network_connected) {
         ESP_LOGI(TAG, "📡 Network: Connected");
     } else {
-        ESP_LOGW(TAG, "📡 Network: Disconnected (retries: %d/%d)", connection_retry_count, MAX_CONNECTION_RETRIES);
+        ESP_LOGW(TAG, "📡 Network: Disconnected");
     }
     
     xTaskCreate(esp_zb_task, "Zigbee_main", 4096, NULL, 5, NULL);
@@ -2309,337 +3288,133 @@ void app_main(void)
 
 /********************* DS18B20 Temperature Sensor Functions ***************************/
 
-/* DS18B20 1-Wire Commands */
-#define DS18B20_CMD_SKIP_ROM        0xCC
-#define DS18B20_CMD_CONVERT_T       0x44
-#define DS18B20_CMD_READ_SCRATCHPAD 0xBE
-
-/**
- * @brief 1-Wire reset pulse - pull bus low for 480us, wait for presence pulse
- * @return true if device present, false otherwise
- */
-static bool ds18b20_reset(void)
-{
-    /* Pull bus low for reset pulse */
-    gpio_set_level(DS18B20_GPIO, 0);
-    esp_rom_delay_us(480);  // Reset pulse (480-960us)
-    
-    /* Release bus and wait for presence pulse */
-    gpio_set_level(DS18B20_GPIO, 1);  // Release (open-drain + pull-up = high)
-    esp_rom_delay_us(70);   // Wait for presence pulse (60-240us)
-    
-    int level = gpio_get_level(DS18B20_GPIO);
-    esp_rom_delay_us(410);  // Complete reset cycle
-    
-    return (level == 0);  // Device pulls line low if present
-}
-
-/**
- * @brief Write a bit on 1-Wire bus
- */
-static void ds18b20_write_bit(uint8_t bit)
-{
-    /* Pull bus low to start time slot */
-    gpio_set_level(DS18B20_GPIO, 0);
-    
-    if (bit) {
-        esp_rom_delay_us(6);   // Write 1: short low pulse
-        gpio_set_level(DS18B20_GPIO, 1);  // Release bus early
-        esp_rom_delay_us(64);
-    } else {
-        esp_rom_delay_us(60);  // Write 0: long low pulse
-        gpio_set_level(DS18B20_GPIO, 1);  // Release bus at end
-        esp_rom_delay_us(10);
-    }
-}
-
-/**
- * @brief Read a bit from 1-Wire bus
- */
-static uint8_t ds18b20_read_bit(void)
-{
-    /* Pull bus low briefly to start read slot */
-    gpio_set_level(DS18B20_GPIO, 0);
-    esp_rom_delay_us(3);
-    
-    /* Release bus and sample */
-    gpio_set_level(DS18B20_GPIO, 1);
-    esp_rom_delay_us(10);
-    
-    uint8_t bit = gpio_get_level(DS18B20_GPIO);
-    esp_rom_delay_us(53);
-    
-    return bit;
-}
-
-/**
- * @brief Write a byte on 1-Wire bus (LSB first)
- */
-static void ds18b20_write_byte(uint8_t byte)
-{
-    for (int i = 0; i < 8; i++) {
-        ds18b20_write_bit(byte & 0x01);
-        byte >>= 1;
-    }
-}
-
-/**
- * @brief Read a byte from 1-Wire bus (LSB first)
- */
-static uint8_t ds18b20_read_byte(void)
-{
-    uint8_t byte = 0;
-    for (int i = 0; i < 8; i++) {
-        byte >>= 1;
-        if (ds18b20_read_bit()) {
-            byte |= 0x80;
-        }
-    }
-    return byte;
-}
-
-/**
- * @brief Initialize DS18B20 temperature sensor on 1-Wire bus
- * 
- * Configures GPIO24 for 1-Wire communication and verifies DS18B20 presence.
- * If sensor is not detected, logs warning and continues (allows device to work without DS18B20).
- * Implements retry logic with increased delays to handle sensors that need more power-up time.
- */
-static void ds18b20_init(void)
-{
-    ESP_LOGI(DS18B20_TAG, "Initializing DS18B20 on GPIO%d...", DS18B20_GPIO);
-    
-    /* Configure GPIO as open-drain output (external 4.7kΩ pull-up resistor on PCB)
-     * Important: Internal pull-up DISABLED because hardware has external resistor */
-    gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << DS18B20_GPIO),
-        .mode = GPIO_MODE_INPUT_OUTPUT_OD,  // Open-drain mode for 1-Wire
-        .pull_up_en = GPIO_PULLUP_DISABLE,   // External pull-up present (4.7kΩ to 3.3V)
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-    gpio_config(&io_conf);
-    
-    /* Set initial state high (idle) */
-    gpio_set_level(DS18B20_GPIO, 1);
-    
-    /* Test presence of DS18B20 with retry logic
-     * Some sensors need more time to power up, especially with longer cables or marginal power */
-    const int MAX_RETRIES = 5;
-    const int RETRY_DELAYS_MS[] = {0, 10, 50, 100, 200};  // First attempt immediate, then progressive backoff
-    bool detected = false;
-    
-    for (int retry = 0; retry < MAX_RETRIES; retry++) {
-        if (retry > 0) {
-            ESP_LOGI(DS18B20_TAG, "🔄 Retry %d/%d after %dms delay...", 
-                     retry + 1, MAX_RETRIES, RETRY_DELAYS_MS[retry]);
-            vTaskDelay(pdMS_TO_TICKS(RETRY_DELAYS_MS[retry]));  // Allow bus to stabilize
-        }
-        
-        if (ds18b20_reset()) {
-            detected = true;
-            if (retry > 0) {
-                ESP_LOGI(DS18B20_TAG, "✅ DS18B20 detected on GPIO%d (attempt %d/%d after %dms delay)", 
-                         DS18B20_GPIO, retry + 1, MAX_RETRIES, RETRY_DELAYS_MS[retry]);
-            } else {
-                ESP_LOGI(DS18B20_TAG, "✅ DS18B20 detected on GPIO%d (first attempt)", DS18B20_GPIO);
-            }
-            break;
-        } else {
-            if (retry < MAX_RETRIES - 1) {
-                ESP_LOGI(DS18B20_TAG, "❌ No response on attempt %d/%d, will retry...", 
-                         retry + 1, MAX_RETRIES);
-            } else {
-                ESP_LOGI(DS18B20_TAG, "❌ No response after %d attempts - giving up", MAX_RETRIES);
-            }
-        }
-    }
-    
-    if (detected) {
-        ds18b20_available = true;
-        
-        /* Perform initial temperature reading with retry logic
-         * First conversion after power-up may need more time */
-        ESP_LOGI(DS18B20_TAG, "Performing initial temperature reading...");
-        
-        const int READ_RETRIES = 3;
-        const int CONVERSION_DELAYS_MS[] = {850, 1000, 1200};  // Progressive delays for retry
-        bool reading_success = false;
-        
-        for (int read_attempt = 0; read_attempt < READ_RETRIES && !reading_success; read_attempt++) {
-            if (read_attempt > 0) {
-                ESP_LOGI(DS18B20_TAG, "🔄 Initial read retry %d/%d (longer conversion delay: %dms)", 
-                         read_attempt + 1, READ_RETRIES, CONVERSION_DELAYS_MS[read_attempt]);
-            }
-            
-            /* Start temperature conversion */
-            if (!ds18b20_reset()) {
-                ESP_LOGW(DS18B20_TAG, "❌ Reset failed before conversion (attempt %d)", read_attempt + 1);
-                vTaskDelay(pdMS_TO_TICKS(100));  // Wait before retry
-                continue;
-            }
-            
-            ds18b20_write_byte(DS18B20_CMD_SKIP_ROM);
-            ds18b20_write_byte(DS18B20_CMD_CONVERT_T);
-            vTaskDelay(pdMS_TO_TICKS(CONVERSION_DELAYS_MS[read_attempt]));  // Wait for conversion
-            
-            /* Read scratchpad */
-            if (ds18b20_reset()) {
-                ds18b20_write_byte(DS18B20_CMD_SKIP_ROM);
-                ds18b20_write_byte(DS18B20_CMD_READ_SCRATCHPAD);
-                
-                uint8_t temp_lsb = ds18b20_read_byte();
-                uint8_t temp_msb = ds18b20_read_byte();
-                
-                int16_t raw_temp = (temp_msb << 8) | temp_lsb;
-                float temperature = (float)raw_temp * 0.0625f;
-                
-                if (temperature >= -55.0f && temperature <= 125.0f) {
-                    ds18b20_last_temp = temperature;
-                    reading_success = true;
-                    
-                    if (read_attempt > 0) {
-                        ESP_LOGI(DS18B20_TAG, "✅ Initial temperature reading successful on attempt %d: %.2f°C (raw: 0x%04X)", 
-                                 read_attempt + 1, temperature, raw_temp);
-                    } else {
-                        ESP_LOGI(DS18B20_TAG, "🌡️ Initial temperature reading: %.2f°C (raw: 0x%04X)", temperature, raw_temp);
-                    }
-                    
-                    /* Update Zigbee attribute with initial value */
-                    int16_t temp_centidegrees = (int16_t)(temperature * 100);
-                    esp_err_t attr_ret = esp_zb_zcl_set_attribute_val(HA_ESP_DS18B20_ENDPOINT, 
-                                                                       ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
-                                                                       ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, 
-                                                                       ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID,
-                                                                       &temp_centidegrees, false);
-                    if (attr_ret == ESP_OK) {
-                        ESP_LOGI(DS18B20_TAG, "✅ Initial attribute updated");
-                    } else {
-                        ESP_LOGW(DS18B20_TAG, "Failed to update initial attribute: %s", esp_err_to_name(attr_ret));
-                    }
-                } else {
-                    ESP_LOGW(DS18B20_TAG, "❌ Initial reading out of range: %.2f°C (attempt %d)", 
-                             temperature, read_attempt + 1);
-                }
-            } else {
-                ESP_LOGW(DS18B20_TAG, "❌ Reset failed after conversion (attempt %d)", read_attempt + 1);
-            }
-        }
-        
-        if (!reading_success) {
-            ESP_LOGW(DS18B20_TAG, "⚠️ Failed to read initial temperature after %d attempts - will retry on next read cycle", READ_RETRIES);
-        }
-    } else {
-        ds18b20_available = false;
-        ESP_LOGW(DS18B20_TAG, "⚠️ No DS18B20 detected on GPIO%d - sensor disabled", DS18B20_GPIO);
-    }
-}
+#if CONFIG_CAELUM_HAS_DS18B20
 
 /**
  * @brief Read DS18B20 temperature and update Zigbee attribute
  * 
- * @param param Unused parameter (required for esp_zb_scheduler_alarm callback)
+ * @param param Number of "conversion done" polls already made (0 on first call)
  * 
- * Reads temperature from DS18B20 sensor and updates Temperature Measurement cluster
- * attribute on endpoint 4. Logs warning if sensor is not available.
+ * Collect phase of the acquisition pipeline: reads the conversion started by
+ * ds18b20_start_conversion() and updates the Temperature Measurement cluster
+ * attribute on endpoint 3 (EP7/EP8 for additional probes). Logs warning if
+ * sensor is not available.
+ *
+ * If the sensor still holds the bus low in a read slot (conversion running,
+ * e.g. slow sensor or cold start), the read is re-armed as a scheduler alarm
+ * every DS18B20_POLL_INTERVAL_MS instead of blocking the Zigbee task.
  */
 static void ds18b20_read_and_report(uint8_t param)
 {
-    (void)param;  // Unused
-    
     /* Check if DS18B20 is available */
     if (!ds18b20_available) {
         ESP_LOGW(DS18B20_TAG, "⚠️ DS18B20 not available - skipping read (sensor disabled at init)");
         return;
     }
     
-    ESP_LOGI(DS18B20_TAG, "Starting DS18B20 temperature measurement...");
-    
-    /* Reset and check presence */
-    ESP_LOGD(DS18B20_TAG, "Sending reset pulse...");
-    if (!ds18b20_reset()) {
-        ESP_LOGW(DS18B20_TAG, "❌ DS18B20 not responding to reset");
-        return;
-    }
-    ESP_LOGD(DS18B20_TAG, "✓ Device present");
-    
-    /* Start temperature conversion */
-    ESP_LOGD(DS18B20_TAG, "Starting temperature conversion...");
-    ds18b20_write_byte(DS18B20_CMD_SKIP_ROM);  // Skip ROM (single device)
-    ds18b20_write_byte(DS18B20_CMD_CONVERT_T);  // Convert T command
-    
-    /* Wait for conversion (750ms for 12-bit resolution) */
-    ESP_LOGD(DS18B20_TAG, "Waiting 800ms for conversion...");
-    vTaskDelay(pdMS_TO_TICKS(800));
-    
-    /* Read scratchpad */
-    ESP_LOGD(DS18B20_TAG, "Reading scratchpad...");
-    if (!ds18b20_reset()) {
-        ESP_LOGW(DS18B20_TAG, "❌ DS18B20 not responding after conversion");
-        return;
+    /* Conversion still running (slow sensor, cold start) - poll again later */
+    bool done = true;
+    ds18b20_is_conversion_done(&done);
+    if (!done) {
+        if (param < DS18B20_MAX_POLLS) {
+            esp_zb_scheduler_alarm((esp_zb_callback_t)ds18b20_read_and_report, param + 1, DS18B20_POLL_INTERVAL_MS);
+            return;
+        }
+        ESP_LOGW(DS18B20_TAG, "⚠️ Conversion not done after %d polls - reading anyway", param);
     }
     
-    ds18b20_write_byte(DS18B20_CMD_SKIP_ROM);
-    ds18b20_write_byte(DS18B20_CMD_READ_SCRATCHPAD);
-    
-    /* Read temperature bytes (LSB first) */
-    uint8_t temp_lsb = ds18b20_read_byte();
-    uint8_t temp_msb = ds18b20_read_byte();
-    
-    ESP_LOGD(DS18B20_TAG, "Raw bytes: LSB=0x%02X, MSB=0x%02X", temp_lsb, temp_msb);
+    /* All probes converted together; read them back-to-back. Each scratchpad
+     * read is CRC-checked by the driver; a corrupted read keeps the last value */
+    uint8_t probes = ds18b20_get_device_count();
+    if (probes == 0) probes = 1;                          // SKIP ROM single-probe fallback
+    if (probes > ds18b20_endpoint_count) probes = ds18b20_endpoint_count;
     
-    /* Convert to temperature (12-bit resolution: 0.0625°C per bit) */
-    int16_t raw_temp = (temp_msb << 8) | temp_lsb;
-    float temperature = (float)raw_temp * 0.0625f;
-    
-    ESP_LOGI(DS18B20_TAG, "Raw value: %d, Temperature: %.2f°C", raw_temp, temperature);
-    
-    /* Basic sanity check (-55°C to 125°C is DS18B20 range) */
-    if (temperature < -55.0f || temperature > 125.0f) {
-        ESP_LOGW(DS18B20_TAG, "❌ Invalid temperature reading: %.2f°C (out of range)", temperature);
-        return;
+    for (uint8_t probe = 0; probe < probes; probe++) {
+        float temperature = 0.0f;
+        esp_err_t ret = ds18b20_read_temperature(probe, &temperature);
+        if (ret != ESP_OK) {
+            ESP_LOGW(DS18B20_TAG, "❌ Probe %u read failed: %s", probe, esp_err_to_name(ret));
+            continue;
+        }
+        
+        /* Update last known temperature */
+        if (probe == 0) {
+            ds18b20_last_temp = temperature;
+        }
+        
+        /* Convert to Zigbee format (0.01°C units) */
+        int16_t temp_centidegrees = (int16_t)(temperature * 100);
+        
+        ESP_LOGD(DS18B20_TAG, "Updating Zigbee attribute: %d (0.01°C units)", temp_centidegrees);
+        
+        /* Queued in the attribute cache; written with the rest of the cycle */
+        ret = attr_cache_set(ds18b20_endpoints[probe], ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
+                             ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID, &temp_centidegrees);
+        if (ret == ESP_OK) {
+            ESP_LOGI(DS18B20_TAG, "✅ DS18B20 EP%u Temperature: %.2f°C (attribute cached)", ds18b20_endpoints[probe], temperature);
+        } else {
+            ESP_LOGE(DS18B20_TAG, "❌ Failed to update temperature attribute: %s", esp_err_to_name(ret));
+        }
     }
-    
-    /* Update last known temperature */
-    ds18b20_last_temp = temperature;
-    
-    /* Convert to Zigbee format (0.01°C units) */
-    int16_t temp_centidegrees = (int16_t)(temperature * 100);
-    
-    ESP_LOGD(DS18B20_TAG, "Updating Zigbee attribute: %d (0.01°C units)", temp_centidegrees);
-    
-    /* Update Zigbee attribute (false = don't force report, let coordinator config decide) */
-    esp_err_t ret = esp_zb_zcl_set_attribute_val(HA_ESP_DS18B20_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_TEMP_MEASUREMENT,
-                                                  ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_TEMP_MEASUREMENT_VALUE_ID,
-                                                  &temp_centidegrees, false);
-    if (ret == ESP_OK) {
-        ESP_LOGI(DS18B20_TAG, "✅ DS18B20 Temperature: %.2f°C (attribute updated)", temperature);
-    } else {
-        ESP_LOGE(DS18B20_TAG, "❌ Failed to update temperature attribute: %s", esp_err_to_name(ret));
+
+    /* A re-armed poll finishes after acquisition_collect() already flushed */
+    if (param > 0) {
+        attr_cache_flush(false);
     }
 }
+#endif /* CONFIG_CAELUM_HAS_DS18B20 */
 
+#if CONFIG_CAELUM_HAS_WIND
 /* Wind speed (anemometer, EP4) - Analog Input presentValue in m/s */
 static void wind_speed_read_and_report(uint8_t param)
 {
     (void)param;
     float speed_ms = 0.0f;
-    esp_err_t ret = anemometer_get_wind_speed(&speed_ms);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "anemometer_get_wind_speed failed: %s", esp_err_to_name(ret));
-        return;
+    wind_stats_t stats;
+    bool have_stats = false;
+    esp_err_t ret;
+
+    if (wind_stats_running()) {
+        ret = wind_stats_take_report(&stats);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "wind_stats_take_report failed: %s", esp_err_to_name(ret));
+            return;
+        }
+        speed_ms = stats.mean_since_report_ms;
+        sched_wind_gust_excess_ms = stats.gust_ms - stats.avg_10min_ms;
+        have_stats = true;
+    } else {
+        ret = anemometer_get_wind_speed(&speed_ms);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "anemometer_get_wind_speed failed: %s", esp_err_to_name(ret));
+            return;
+        }
+    }
+    ret = attr_cache_set(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                         ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, &speed_ms);
+    if (have_stats) {
+        attr_cache_set(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                       WIND_SPEED_ATTR_GUST_ID, &stats.gust_ms);
+        attr_cache_set(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                       WIND_SPEED_ATTR_AVG_2MIN_ID, &stats.avg_2min_ms);
+        attr_cache_set(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                       WIND_SPEED_ATTR_AVG_10MIN_ID, &stats.avg_10min_ms);
     }
-    ret = esp_zb_zcl_set_attribute_val(HA_ESP_WIND_SPEED_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
-                                       ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID,
-                                       &speed_ms, false);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "💨 Wind speed: %.2f m/s (attribute updated)", speed_ms);
+        if (have_stats) {
+            ESP_LOGI(TAG, "💨 Wind speed: %.2f m/s, gust %.2f, 2min %.2f, 10min %.2f m/s (attributes cached)",
+                     speed_ms, stats.gust_ms, stats.avg_2min_ms, stats.avg_10min_ms);
+        } else {
+            ESP_LOGI(TAG, "💨 Wind speed: %.2f m/s (attribute cached)", speed_ms);
+        }
     } else {
         ESP_LOGE(TAG, "Failed to update wind speed attribute: %s", esp_err_to_name(ret));
     }
 }
 
-/* Wind direction (AS5600, EP5) - Analog Input presentValue in compass degrees */
+/* Wind direction (AS5600, EP5) - Analog Input presentValue in compass degrees.
+ * A burst of samples is circular-averaged, and the result only replaces the
+ * last reported direction once it has moved WIND_DIR_HYSTERESIS_DEG away. */
 static void wind_dir_read_and_report(uint8_t param)
 {
     (void)param;
@@ -2647,37 +3422,83 @@ static void wind_dir_read_and_report(uint8_t param)
         ESP_LOGD(TAG, "Wind direction skipped - AS5600 not available");
         return;
     }
-    float direction = 0.0f;
-    esp_err_t ret = as5600_get_wind_direction(&direction);
+
+    bool magnet_ok = false;
+    esp_err_t ret = as5600_check_magnet(&magnet_ok);
+    if (ret != ESP_OK || !magnet_ok) {
+        if (as5600_magnet_ok) {
+            ESP_LOGW(TAG, "🧭 AS5600 magnet missing or out of range - wind direction reports suspended");
+        }
+        as5600_magnet_ok = false;
+        return;
+    }
+    if (!as5600_magnet_ok) {
+        ESP_LOGI(TAG, "🧭 AS5600 magnet back in range - wind direction reports resumed");
+        as5600_magnet_ok = true;
+    }
+
+    float direction = 0.0f, spread = 0.0f;
+    ret = as5600_read_direction_burst(WIND_DIR_BURST_SAMPLES, WIND_DIR_BURST_INTERVAL_MS, &direction, &spread);
     if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "as5600_get_wind_direction failed: %s", esp_err_to_name(ret));
+        ESP_LOGW(TAG, "as5600_read_direction_burst failed: %s", esp_err_to_name(ret));
         return;
     }
-    ret = esp_zb_zcl_set_attribute_val(HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
-                                       ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID,
-                                       &direction, false);
+
+    float delta = fabsf(direction - wind_dir_held);
+    if (delta > 180.0f) delta = 360.0f - delta;
+    if (wind_dir_held < 0 || delta >= WIND_DIR_HYSTERESIS_DEG) {
+        wind_dir_held = direction;
+    }
+
+    ret = attr_cache_set(HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                         ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, &wind_dir_held);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "🧭 Wind direction: %.1f° (attribute updated)", direction);
+        ESP_LOGI(TAG, "🧭 Wind direction: %.1f° (burst %.1f° ±%.1f°, attribute cached)", wind_dir_held, direction, spread);
     } else {
         ESP_LOGE(TAG, "Failed to update wind direction attribute: %s", esp_err_to_name(ret));
     }
+
+    wind_stats_t stats;
+    if (wind_stats_get(&stats) == ESP_OK && stats.dir_valid) {
+        attr_cache_set(HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                       WIND_DIR_ATTR_AVG_2MIN_ID, &stats.dir_2min_deg);
+        attr_cache_set(HA_ESP_WIND_DIR_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                       WIND_DIR_ATTR_AVG_10MIN_ID, &stats.dir_10min_deg);
+        ESP_LOGI(TAG, "🧭 Wind direction avg: 2min %.1f°, 10min %.1f°", stats.dir_2min_deg, stats.dir_10min_deg);
+    }
 }
+#endif /* CONFIG_CAELUM_HAS_WIND */
 
+#if CONFIG_CAELUM_HAS_LIGHT
 /* Illuminance (VEML7700, EP6) - standard ZCL Illuminance Measurement (0x0400).
- * MeasuredValue = 10000 * log10(lux) + 1, clamped to [0, 0xFFFE]. */
+ * MeasuredValue = 10000 * log10(lux) + 1, clamped to [0, 0xFFFE].
+ * param > 0: re-read after the auto-range changed the range (own alarm, flushes itself) */
 static void light_read_and_report(uint8_t param)
 {
-    (void)param;
     if (!veml7700_available) {
         ESP_LOGD(TAG, "Illuminance skipped - VEML7700 not available");
         return;
     }
+    /* The re-read runs after the collect released bus 2 */
+    if (param > 0) i2c_buses_acquire(I2C_BUS2_MASK);
     float lux = 0.0f;
     esp_err_t ret = veml7700_read_lux(&lux);
-    if (ret != ESP_OK) {
+    if (ret == ESP_ERR_NOT_FINISHED && param == 0) {
+        /* Clipped or too coarse: integrate once more with the new range */
+        uint32_t light_ms = 0;
+        if (veml7700_start_measurement(&light_ms) == ESP_OK) {
+            esp_zb_scheduler_alarm((esp_zb_callback_t)light_read_and_report, 1, light_ms);
+            return;
+        }
+    } else if (ret != ESP_OK && ret != ESP_ERR_NOT_FINISHED) {
         ESP_LOGW(TAG, "veml7700_read_lux failed: %s", esp_err_to_name(ret));
+        if (param > 0) i2c_buses_release(I2C_BUS2_MASK);
         return;
     }
+#if VEML7700_SHUTDOWN_BETWEEN_READS
+    veml7700_power_down();
+#endif
+    if (param > 0) i2c_buses_release(I2C_BUS2_MASK);
 
     /* ZCL Illuminance encoding: 0 lux -> 0; otherwise 10000*log10(lux)+1. */
     uint16_t measured;
@@ -2690,13 +3511,16 @@ static void light_read_and_report(uint8_t param)
         measured = (uint16_t)val;
     }
 
-    ret = esp_zb_zcl_set_attribute_val(HA_ESP_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT,
-                                       ESP_ZB_ZCL_CLUSTER_SERVER_ROLE, ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID,
-                                       &measured, false);
+    ret = attr_cache_set(HA_ESP_LIGHT_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ILLUMINANCE_MEASUREMENT,
+                         ESP_ZB_ZCL_ATTR_ILLUMINANCE_MEASUREMENT_MEASURED_VALUE_ID, &measured);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "☀️ Illuminance: %.1f lux (ZCL=%u, attribute updated)", lux, measured);
+        ESP_LOGI(TAG, "☀️ Illuminance: %.1f lux (ZCL=%u, attribute cached)", lux, measured);
     } else {
         ESP_LOGE(TAG, "Failed to update illuminance attribute: %s", esp_err_to_name(ret));
     }
-}
 
+    if (param > 0) {
+        attr_cache_flush(false);
+    }
+}
+#endif /* CONFIG_CAELUM_HAS_LIGHT */
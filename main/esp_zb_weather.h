@@ -12,9 +12,15 @@
  * CONDITIONS OF ANY KIND, either express or implied.
  */
 
+#include "sdkconfig.h"
 #include "esp_zigbee_core.h"
 #include "zcl_utility.h"
 
+/* Hardware profile (main/Kconfig.projbuild): CONFIG_CAELUM_HAS_ENV, _DS18B20,
+ * _WIND (anemometer + AS5600) and _LIGHT select what is compiled in. The rain
+ * gauge and the battery monitor are on every board. */
+#define CAELUM_HAS_I2C                  (CONFIG_CAELUM_HAS_ENV || CONFIG_CAELUM_HAS_WIND || CONFIG_CAELUM_HAS_LIGHT)
+
 /* Zigbee configuration */
 #define INSTALLCODE_POLICY_ENABLE       false                                /* enable the install code policy for security */
 #define ED_AGING_TIMEOUT                ESP_ZB_ED_AGING_TIMEOUT_8MIN         /* aging timeout for sleepy end device */
@@ -27,6 +33,89 @@
 #define HA_ESP_WIND_SPEED_ENDPOINT      4                                    /* Anemometer (SS445P hall sensor) */
 #define HA_ESP_WIND_DIR_ENDPOINT        5                                    /* Wind direction (AS5600 magnetic encoder) via I2C Bus 2 */
 #define HA_ESP_LIGHT_ENDPOINT           6                                    /* Light sensor (VEML7700) via I2C Bus 2 */
+#define HA_ESP_DS18B20_PROBE2_ENDPOINT  7                                    /* Second DS18B20 on the GPIO24 bus (if enumerated) */
+#define HA_ESP_DS18B20_PROBE3_ENDPOINT  8                                    /* Third DS18B20 on the GPIO24 bus (if enumerated) */
+
+/* Wind statistics - custom genAnalogInput attributes (single float, read-only, reportable) */
+#define WIND_SPEED_ATTR_GUST_ID         0x4000                               /* EP4: peak 3 s gust since the last report (m/s) */
+#define WIND_SPEED_ATTR_AVG_2MIN_ID     0x4001                               /* EP4: 2-minute mean speed (m/s) */
+#define WIND_SPEED_ATTR_AVG_10MIN_ID    0x4002                               /* EP4: 10-minute mean speed (m/s) */
+#define WIND_DIR_ATTR_AVG_2MIN_ID       0x4000                               /* EP5: 2-minute vector-averaged direction (deg) */
+#define WIND_DIR_ATTR_AVG_10MIN_ID      0x4001                               /* EP5: 10-minute vector-averaged direction (deg) */
+
+/* Barometric tendency - custom Pressure Measurement attribute (S16, read-only, reportable) */
+#define PRESSURE_ATTR_TENDENCY_3H_ID    0x4000                               /* EP1: change over the last 3 h (0.1 hPa, 0x8000 = unknown) */
+
+/* Adaptive reporting scheduler - custom cluster on EP1, limits writable and kept in NVS */
+#define SCHED_CLUSTER_ID                0xFC00                               /* EP1: manufacturer-specific scheduler configuration cluster */
+#define SCHED_ATTR_MIN_INTERVAL_ID      0x0000                               /* U16 s: cadence while the weather is active */
+#define SCHED_ATTR_MAX_INTERVAL_ID      0x0001                               /* U16 s: longest back-off in stable weather */
+#define SCHED_ATTR_PRESSURE_FALL_ID     0x0002                               /* float hPa/h: falling faster than this is active */
+#define SCHED_ATTR_WIND_GUST_ID         0x0003                               /* float m/s: gust above the 10-min mean that is variable wind */
+#define SCHED_ATTR_WIND_SHIFT_ID        0x0004                               /* float deg: 2-min vs 10-min direction shift that is variable wind */
+#define SCHED_ATTR_LOW_BATTERY_ID       0x0005                               /* U8 %: below this the cadence is slowed down */
+#define SCHED_ATTR_INTERVAL_ID          0x0010                               /* U16 s: interval currently in use (read-only, reportable) */
+#define SCHED_DEFAULT_MIN_INTERVAL_S    300                                  /* 5 minutes */
+#define SCHED_DEFAULT_MAX_INTERVAL_S    1800                                 /* 30 minutes */
+#define SCHED_DEFAULT_PRESSURE_FALL     1.0f                                 /* hPa/h (3 hPa in 3 h) */
+#define SCHED_DEFAULT_WIND_GUST         3.0f                                 /* m/s */
+#define SCHED_DEFAULT_WIND_SHIFT        45.0f                                /* degrees */
+#define SCHED_DEFAULT_LOW_BATTERY       20                                   /* percent */
+#define SCHED_MIN_INTERVAL_LIMIT_S      60                                   /* Lower bound accepted for either interval */
+#define BACKFILL_CLUSTER_ID             0xFC01                               /* EP1: manufacturer-specific offline backfill cluster */
+#define BACKFILL_ATTR_PENDING_ID        0x0000                               /* U16: buffered samples not yet sent (read-only, reportable) */
+#define BACKFILL_CMD_BATCH_ID           0x00                                 /* Server-to-client command, octet string batch (see meas_log.h) */
+#define BACKFILL_BATCH_MAX_BYTES        72                                   /* Keeps one batch in a single unfragmented APS frame */
+#define BACKFILL_START_DELAY_MS         15000                                /* After a rejoin, let the join reports go out first */
+#define BACKFILL_INTERVAL_MS            3000                                 /* Between batches, so the parent is not flooded */
+#define DIAG_CLUSTER_ID                 0xFC02                               /* EP1: manufacturer-specific diagnostics cluster (read-only, reportable) */
+#define DIAG_ATTR_REJOIN_ATTEMPTS_ID    0x0000                               /* U16: rejoin attempts during the last outage */
+#define DIAG_ATTR_REJOIN_SCAN_MS_ID     0x0001                               /* U32 ms: time spent in those attempts */
+#define DIAG_ATTR_REJOIN_OUTAGE_S_ID    0x0002                               /* U32 s: from link loss to the rejoin */
+#define DIAG_ATTR_REJOIN_PHASE_ID       0x0003                               /* U8: attempt that succeeded, 1 = last channel, 2 = all channels */
+#define DIAG_ATTR_REJOIN_COUNT_ID       0x0004                               /* U16: outages recovered since boot */
+#define DIAG_ATTR_POWER_AWAKE_ID        0x0010                               /* float s: awake since power-on (power_profiler.h) */
+#define DIAG_ATTR_POWER_SLEEP_ID        0x0011                               /* float s: in light sleep since power-on */
+#define DIAG_ATTR_POWER_SLEEPS_ID       0x0012                               /* U32: light-sleep entries */
+#define DIAG_ATTR_POWER_TX_ID           0x0013                               /* U32: APS frames sent */
+#define DIAG_ATTR_POWER_RADIO_ID        0x0014                               /* float s: modelled radio-on time */
+#define DIAG_ATTR_POWER_CHARGE_ID       0x0015                               /* float µAh: modelled charge */
+#define DIAG_ATTR_POWER_CURRENT_ID      0x0016                               /* float µA: modelled average current */
+#define DIAG_ATTR_POWER_CAUSES_ID       0x0020                               /* Octet string: awake ms per cause (read-only, not reportable) */
+#define TELEMETRY_CLUSTER_ID            0xFC03                               /* EP1: manufacturer-specific telemetry snapshot cluster */
+#define TELEMETRY_ATTR_SNAPSHOT_ID      0x0000                               /* Octet string: every channel in one report (see telemetry.h) */
+#define TELEMETRY_ATTR_MODE_ID          0x0001                               /* U8: 0 = snapshot only, 1 = snapshot + standard clusters, 2 = standard only (kept in NVS) */
+#define TELEMETRY_DEFAULT_MODE          0                                    /* Standard cluster reports are opt-in */
+#define TELEMETRY_HEARTBEAT_S           3600                                 /* Snapshot at least this often, like the standard max interval */
+
+/* Rejoin policy (see rejoin.h) */
+#define REJOIN_FAST_ATTEMPTS            3                                    /* Quick attempts on the last channel after a link loss */
+#define REJOIN_FAST_DELAY_MS            1000                                 /* Before the first quick attempt, doubled for each further one */
+#define REJOIN_BACKOFF_BASE_MS          30000                                /* Before the first full scan, doubled for each further one */
+#define REJOIN_BACKOFF_MAX_MS           (30 * 60 * 1000UL)                   /* Back-off cap */
+#define REJOIN_BACKOFF_LOW_BATTERY_MS   (2 * 60 * 60 * 1000UL)               /* Back-off cap below SCHED_DEFAULT_LOW_BATTERY */
+#define REJOIN_JITTER_PERCENT           20                                   /* Spreads the attempts of stations that lost the same parent */
+
+/* Parent poll rate (see poll_control.h). The parent holds frames for a sleepy
+ * child for 7.68 s (macTransactionPersistenceTime), so the long interval stays
+ * below that: a frame nobody expected is still picked up. */
+#define POLL_LONG_INTERVAL_MS           7500                                 /* No reply expected: the keep-alive */
+#define POLL_FAST_INTERVAL_MS           250                                  /* While a window is open */
+#define POLL_JOIN_FIRST_MS              15000                                /* Join: the coordinator starts its interview within this */
+#define POLL_JOIN_QUIET_MS              5000                                 /* Join: interview over after this long without a frame */
+#define POLL_CONFIG_QUIET_MS            3000                                 /* Later configuration exchange: over after this long without a frame */
+#define POLL_CONFIG_MAX_MS              30000
+#define POLL_OTA_QUIET_MS               10000                                /* OTA: transfer stalled after this long without a block */
+#define POLL_APS_ACK_FIRST_MS           2000                                 /* Reports flushed: give up on the first confirm after this */
+#define POLL_APS_ACK_QUIET_MS           500                                  /* Reports flushed: all confirmed after this long without one */
+#define POLL_APS_ACK_MAX_MS             10000
+
+/* Per-channel cadence - rain, wind and light follow the adaptive interval above */
+#define CADENCE_ENV_S                   900                                  /* SHT4x/LPS22HB temperature, humidity, pressure */
+#define CADENCE_DS18B20_S               1800                                 /* DS18B20 probe(s), e.g. soil temperature */
+#define CADENCE_BATTERY_S               3600                                 /* Battery ADC read (divider connected only then) */
+#define BATTERY_RADIO_QUIET_MS          20                                   /* Battery read at least this long after the last APS frame */
+#define CADENCE_COALESCE_S              30                                   /* Channels due this close together share one wake */
 
 #define ESP_ZB_PRIMARY_CHANNEL_MASK     ESP_ZB_TRANSCEIVER_ALL_CHANNELS_MASK /* Zigbee primary channel mask use in the example */
 
@@ -43,19 +132,41 @@
 /* I2C Bus 2 - Wind and light sensors */
 #define I2C_BUS2_SDA_GPIO               GPIO_NUM_1                           /* I2C Bus 2 SDA - AS5600 + VEML7700 */
 #define I2C_BUS2_SCL_GPIO               GPIO_NUM_2                           /* I2C Bus 2 SCL - AS5600 + VEML7700 */
+#define I2C_PARK_IDLE_BUSES             1                                    /* Delete unused I2C buses and park their pads (frees the controller for peripheral power-down) */
+#define AS5600_IDLE_POWER_MODE          3                                    /* AS5600 CONF PM between reads: 0 NOM, 1-3 LPM1-3 (5/20/100 ms polling) */
+#define AS5600_SLOW_FILTER              0                                    /* AS5600 CONF SF: 0-3 = 16x/8x/4x/2x (lowest noise first) */
+#define WIND_DIR_BURST_SAMPLES          8                                    /* Angle samples circular-averaged per direction report */
+#define WIND_DIR_BURST_INTERVAL_MS      10                                   /* Spacing of the burst samples */
+#define WIND_DIR_JOB_TIMEOUT_MS         500                                  /* Longest wait for the burst on the bus 2 worker */
+#define DRIVER_INIT_BUS2_TIMEOUT_MS     2000                                 /* Longest wait for the bus 2 driver init on its worker */
+#define HW_INVENTORY_CACHE_ENABLED      1                                    /* Bring drivers up from the NVS hardware inventory instead of bus scans */
+#define HW_INVENTORY_REPROBE_DELAY_MS   60000                                /* Background re-scan that checks the cached inventory, after init */
+#define WIND_DIR_HYSTERESIS_DEG         10.0f                                /* Direction must move this far from the last report to update it */
+#define VEML7700_AUTO_RANGE             1                                    /* Pick gain/integration time from the previous reading */
+#define VEML7700_SHUTDOWN_BETWEEN_READS 1                                    /* Shut the VEML7700 down after each read (0 = stay on in PSM mode 4) */
 
 /* Digital sensors */
 #define RAIN_GAUGE_GPIO                 GPIO_NUM_13                          /* Rain sensor (DRV5032DULPG) - bucket tip pulse / light-sleep wake */
 #define LPS22HB_INT_GPIO                GPIO_NUM_12                          /* LPS22HB INT_DRDY */
 #define DS18B20_GPIO                    GPIO_NUM_24                          /* DS18B20 1-Wire temperature sensor */
+#define DS18B20_RESOLUTION_BITS         12                                   /* DS18B20 resolution 9..12 bit (94/188/375/750 ms conversion) */
 #define ANEMOMETER_GPIO                 GPIO_NUM_14                          /* Anemometer SS445P hall sensor (pulse counter) */
 
+/* Pulse counting backend: 1 = count edges in the PCNT peripheral (no CPU wakeup per pulse,
+ * counter read only when wind speed / rain totals are needed), 0 = GPIO interrupt per pulse */
+#define ANEMOMETER_USE_PCNT             0                                    /* Anemometer pulses via PCNT instead of GPIO ISR */
+#define RAIN_GAUGE_USE_PCNT             0                                    /* Rain gauge tips via PCNT instead of ISR + ring */
+#define ANEMOMETER_PCNT_GLITCH_NS       10000                                /* PCNT glitch filter (HW max ~1023 APB cycles, ~31 us) */
+#define RAIN_GAUGE_PCNT_GLITCH_NS       10000                                /* PCNT glitch filter (HW max ~1023 APB cycles, ~31 us) */
+#define ANEMOMETER_USE_PERIOD           1                                    /* Low-wind speed from the median pulse interval (GPIO ISR only) */
+
 /* Battery monitoring - Hardware v2.0 */
 #define BATTERY_ENABLE_GPIO             GPIO_NUM_3                           /* P-MOSFET + N-MOSFET enable for battery measurement */
 #define BATTERY_ADC_GPIO                GPIO_NUM_4                           /* ADC input for battery voltage. On ESP32-H2, GPIO4 = ADC1_CHANNEL_3 */
 #define BATTERY_ADC_CHANNEL             ADC_CHANNEL_3                        /* ADC1_CH3 == GPIO4 (NOT CH4, which is GPIO5) */
 #define BATTERY_VOLTAGE_DIVIDER_R1      22000                                /* R4: top resistor, BATT+ side (22kΩ) */
 #define BATTERY_VOLTAGE_DIVIDER_R2      30000                                /* R5: bottom resistor, OUT-/GND side (30kΩ) */
+#define BATTERY_CAPACITY_MAH            2500                                 /* Li-Ion cell capacity (battery life estimate, charge-based prediction) */
 
 /* Deep sleep configuration for battery operation */
 #define SLEEP_DURATION_MINUTES          5                                    /* Wake up every 5 minutes for periodic reading */
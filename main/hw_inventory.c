@@ -0,0 +1,98 @@
+/*
+ * Hardware inventory - NVS record of the last full probe
+ */
+
+#include <string.h>
+#include "hw_inventory.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "HW_INV";
+
+#define HW_INVENTORY_NVS_NAMESPACE  "storage"
+#define HW_INVENTORY_NVS_KEY        "hw_inventory"
+#define HW_INVENTORY_VERSION        1
+
+typedef struct {
+    uint8_t version;
+    hw_inventory_t inv;
+} hw_inventory_blob_t;
+
+esp_err_t hw_inventory_load(hw_inventory_t *inv)
+{
+    if (!inv) return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(HW_INVENTORY_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    hw_inventory_blob_t blob;
+    size_t size = sizeof(blob);
+    esp_err_t err = nvs_get_blob(nvs_handle, HW_INVENTORY_NVS_KEY, &blob, &size);
+    nvs_close(nvs_handle);
+    if (err != ESP_OK || size != sizeof(blob) || blob.version != HW_INVENTORY_VERSION) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    for (int bus = 0; bus < 2; bus++) {
+        if (blob.inv.bus_count[bus] > HW_INVENTORY_MAX_ADDRS) return ESP_ERR_NOT_FOUND;
+    }
+    *inv = blob.inv;
+    return ESP_OK;
+}
+
+esp_err_t hw_inventory_store(const hw_inventory_t *inv)
+{
+    if (!inv) return ESP_ERR_INVALID_ARG;
+
+    hw_inventory_t stored;
+    if (hw_inventory_load(&stored) == ESP_OK && memcmp(&stored, inv, sizeof(stored)) == 0) {
+        return ESP_OK;
+    }
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(HW_INVENTORY_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "NVS not available - inventory not saved");
+        return err;
+    }
+    hw_inventory_blob_t blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.version = HW_INVENTORY_VERSION;
+    blob.inv = *inv;
+    err = nvs_set_blob(nvs_handle, HW_INVENTORY_NVS_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) err = nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "💾 Hardware inventory saved (bus 1: %u, bus 2: %u device(s), DS18B20 %s)",
+                 inv->bus_count[0], inv->bus_count[1], inv->ds18b20_present ? "present" : "absent");
+    }
+    return err;
+}
+
+void hw_inventory_set_bus(hw_inventory_t *inv, int bus, const uint8_t *addrs, int count)
+{
+    if (!inv || bus < 0 || bus > 1) return;
+    if (count < 0) count = 0;
+    if (count > HW_INVENTORY_MAX_ADDRS) count = HW_INVENTORY_MAX_ADDRS;
+    memset(inv->bus_addrs[bus], 0, sizeof(inv->bus_addrs[bus]));
+    if (count > 0) memcpy(inv->bus_addrs[bus], addrs, (size_t)count);
+    inv->bus_count[bus] = (uint8_t)count;
+}
+
+bool hw_inventory_has_addr(const hw_inventory_t *inv, int bus, uint8_t addr)
+{
+    if (!inv || bus < 0 || bus > 1) return false;
+    for (int i = 0; i < inv->bus_count[bus]; i++) {
+        if (inv->bus_addrs[bus][i] == addr) return true;
+    }
+    return false;
+}
+
+bool hw_inventory_same_buses(const hw_inventory_t *a, const hw_inventory_t *b)
+{
+    for (int bus = 0; bus < 2; bus++) {
+        if (a->bus_count[bus] != b->bus_count[bus]) return false;
+        if (memcmp(a->bus_addrs[bus], b->bus_addrs[bus], a->bus_count[bus]) != 0) return false;
+    }
+    return true;
+}
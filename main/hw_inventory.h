@@ -0,0 +1,66 @@
+/*
+ * Hardware inventory
+ * What the last full probe found - the addresses answering on each I2C bus,
+ * which environmental drivers probed OK and whether a DS18B20 answered - kept
+ * in NVS so a boot can skip the bus scans and the probes of absent parts.
+ * A background re-scan later checks the cache against the real buses.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HW_INVENTORY_MAX_ADDRS  8       // addresses kept per bus (the board has at most 4)
+
+typedef struct {
+    uint8_t bus_count[2];                               // entries used in bus_addrs, per I2C bus
+    uint8_t bus_addrs[2][HW_INVENTORY_MAX_ADDRS];      // 7-bit addresses from i2c_bus_scan()
+    uint32_t env_drivers;                               // sensor_get_present_mask()
+    bool ds18b20_present;
+} hw_inventory_t;
+
+/**
+ * @brief Load the inventory saved by the last full probe
+ *
+ * @param inv Filled on success
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if none (or from another firmware layout)
+ */
+esp_err_t hw_inventory_load(hw_inventory_t *inv);
+
+/**
+ * @brief Save the inventory; nothing is written when NVS already holds it
+ *
+ * @param inv Inventory to keep
+ * @return ESP_OK on success
+ */
+esp_err_t hw_inventory_store(const hw_inventory_t *inv);
+
+/**
+ * @brief Record the result of i2c_bus_scan() for one bus
+ *
+ * @param inv Inventory
+ * @param bus 0 for bus 1, 1 for bus 2
+ * @param addrs Scan result
+ * @param count Entries in addrs (extra ones are dropped)
+ */
+void hw_inventory_set_bus(hw_inventory_t *inv, int bus, const uint8_t *addrs, int count);
+
+/**
+ * @brief Whether addr was found on a bus
+ */
+bool hw_inventory_has_addr(const hw_inventory_t *inv, int bus, uint8_t addr);
+
+/**
+ * @brief Whether two inventories list the same addresses on both buses
+ */
+bool hw_inventory_same_buses(const hw_inventory_t *a, const hw_inventory_t *b);
+
+#ifdef __cplusplus
+}
+#endif
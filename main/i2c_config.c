@@ -1,63 +1,358 @@
 /*
  * I2C Bus Configuration for Hardware v2.0
- * Two independent I2C buses for sensor communication
+ * Two independent I2C buses for sensor communication. Idle buses are
+ * deleted and their pads parked, and rebuilt from the descriptor tables below
+ * on the next use.
  */
 
+#include <stdbool.h>
 #include "i2c_config.h"
 #include "esp_zb_weather.h"
 #include "esp_log.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "I2C_CONFIG";
 
+#define I2C_JOB_TASK_STACK      4096
+#define I2C_JOB_TASK_PRIORITY   5       // same as Zigbee_main, so neither starves the other
+
+#define I2C_DEVICE_TABLE_LEN    8       // every driver that can be probed holds one handle
+
 /* I2C Bus handles */
 i2c_bus_handle_t i2c_bus1 = NULL;
 i2c_bus_handle_t i2c_bus2 = NULL;
 
-esp_err_t i2c_buses_init(void)
+/* Everything needed to rebuild a bus and its devices without a scan */
+typedef struct {
+    i2c_port_t port;
+    int sda;
+    int scl;
+    uint32_t clk_hz;
+    i2c_bus_handle_t *handle;
+    uint8_t refs;                   // i2c_buses_acquire() calls not released yet
+    bool parked;
+    bool keep_powered;              // a device on it could not be tracked
+} i2c_bus_desc_t;
+
+typedef struct {
+    uint8_t bus;                    // i2c_bus_id_t
+    uint8_t addr;
+    i2c_bus_device_handle_t *slot;  // the driver's own handle, rewritten on rebuild
+} i2c_dev_desc_t;
+
+static i2c_bus_desc_t bus_descs[I2C_BUS_COUNT] = {
+    [I2C_BUS_1] = { .port = I2C_NUM_0, .sda = I2C_BUS1_SDA_GPIO, .scl = I2C_BUS1_SCL_GPIO,
+                    .clk_hz = 100000, .handle = &i2c_bus1 },    // 100 kHz for compatibility
+    [I2C_BUS_2] = { .port = I2C_NUM_1, .sda = I2C_BUS2_SDA_GPIO, .scl = I2C_BUS2_SCL_GPIO,
+                    .clk_hz = 100000, .handle = &i2c_bus2 },
+};
+static i2c_dev_desc_t dev_descs[I2C_DEVICE_TABLE_LEN];
+static size_t dev_desc_count = 0;
+static SemaphoreHandle_t power_mutex = NULL;
+
+typedef struct {
+    const char *name;
+    TaskHandle_t task;
+    SemaphoreHandle_t done;
+    i2c_bus_job_fn_t fn;
+    void *arg;
+    bool pending;                   // started and not finished, under power_mutex
+} i2c_bus_worker_t;
+
+static i2c_bus_worker_t bus_workers[I2C_BUS_COUNT] = {
+    { .name = "i2c_bus1_job" },
+    { .name = "i2c_bus2_job" },
+};
+
+static void i2c_bus_job_finish(i2c_bus_worker_t *w);
+
+static void i2c_bus_job_task(void *arg)
 {
-    /* Configure I2C Bus 1 - Environmental sensors (SHT4x + LPS22HB) */
-    i2c_config_t i2c1_conf = {
+    i2c_bus_worker_t *w = (i2c_bus_worker_t *)arg;
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        w->fn(w->arg);
+        i2c_bus_job_finish(w);
+    }
+}
+
+static esp_err_t i2c_bus_worker_create(i2c_bus_worker_t *w)
+{
+    if (w->task != NULL) return ESP_OK;
+    w->done = xSemaphoreCreateBinary();
+    if (w->done == NULL) return ESP_ERR_NO_MEM;
+    if (xTaskCreate(i2c_bus_job_task, w->name, I2C_JOB_TASK_STACK, w, I2C_JOB_TASK_PRIORITY, &w->task) != pdPASS) {
+        vSemaphoreDelete(w->done);
+        w->done = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+
+/* Bring a bus up from its descriptor and re-create the devices drivers registered on it */
+static esp_err_t i2c_bus_power_up(i2c_bus_id_t id)
+{
+    i2c_bus_desc_t *d = &bus_descs[id];
+    i2c_config_t conf = {
         .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_BUS1_SDA_GPIO,
-        .scl_io_num = I2C_BUS1_SCL_GPIO,
+        .sda_io_num = d->sda,
+        .scl_io_num = d->scl,
         .sda_pullup_en = GPIO_PULLUP_DISABLE,  // Use external pull-ups only (saves ~140µA)
         .scl_pullup_en = GPIO_PULLUP_DISABLE,
-        .master.clk_speed = 100000,  // 100 kHz for compatibility
+        .master.clk_speed = d->clk_hz,
     };
-    
-    i2c_bus1 = i2c_bus_create(I2C_NUM_0, &i2c1_conf);
-    if (i2c_bus1 == NULL) {
+    *d->handle = i2c_bus_create(d->port, &conf);
+    if (*d->handle == NULL) return ESP_FAIL;
+
+    esp_err_t ret = ESP_OK;
+    for (size_t i = 0; i < dev_desc_count; i++) {
+        if (dev_descs[i].bus != id) continue;
+        *dev_descs[i].slot = i2c_bus_device_create(*d->handle, dev_descs[i].addr, 0);
+        if (*dev_descs[i].slot == NULL) {
+            ESP_LOGW(TAG, "I2C Bus %d: device 0x%02X not re-created", id + 1, dev_descs[i].addr);
+            ret = ESP_FAIL;
+        }
+    }
+    d->parked = false;
+    return ret;
+}
+
+/* Delete the devices and the bus, then leave the pads with input buffer and
+ * pulls off: the external pull-ups hold both lines idle-high */
+static void i2c_bus_park(i2c_bus_id_t id)
+{
+    i2c_bus_desc_t *d = &bus_descs[id];
+    for (size_t i = 0; i < dev_desc_count; i++) {
+        if (dev_descs[i].bus == id && *dev_descs[i].slot != NULL) {
+            i2c_bus_device_delete(dev_descs[i].slot);
+        }
+    }
+    if (*d->handle != NULL && i2c_bus_delete(d->handle) != ESP_OK) {
+        ESP_LOGW(TAG, "I2C Bus %d: delete failed - left powered", id + 1);
+        return;
+    }
+    gpio_config_t pads = {
+        .pin_bit_mask = (1ULL << d->sda) | (1ULL << d->scl),
+        .mode = GPIO_MODE_DISABLE,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    gpio_config(&pads);
+    d->parked = true;
+}
+
+static int i2c_bus_id_of(i2c_bus_handle_t bus)
+{
+    for (int id = 0; id < I2C_BUS_COUNT; id++) {
+        if (bus != NULL && *bus_descs[id].handle == bus) return id;
+    }
+    return -1;
+}
+
+esp_err_t i2c_buses_init(void)
+{
+    if (power_mutex == NULL) {
+        power_mutex = xSemaphoreCreateMutex();
+        if (power_mutex == NULL) return ESP_ERR_NO_MEM;
+    }
+
+    /* Configure I2C Bus 1 - Environmental sensors (SHT4x + LPS22HB) */
+    if (i2c_bus_power_up(I2C_BUS_1) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create I2C Bus 1");
         return ESP_FAIL;
     }
     ESP_LOGI(TAG, "I2C Bus 1 initialized (GPIO%d/GPIO%d) - SHT4x + LPS22HB", 
              I2C_BUS1_SDA_GPIO, I2C_BUS1_SCL_GPIO);
 
+#if I2C_BUS2_PRESENT
     /* Configure I2C Bus 2 - Wind & Light sensors (AS5600 + VEML7700) */
-    i2c_config_t i2c2_conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_BUS2_SDA_GPIO,
-        .scl_io_num = I2C_BUS2_SCL_GPIO,
-        .sda_pullup_en = GPIO_PULLUP_DISABLE,  // Use external pull-ups only (saves ~140µA)
-        .scl_pullup_en = GPIO_PULLUP_DISABLE,
-        .master.clk_speed = 100000,  // 100 kHz
-    };
-    
-    i2c_bus2 = i2c_bus_create(I2C_NUM_1, &i2c2_conf);
-    if (i2c_bus2 == NULL) {
+    if (i2c_bus_power_up(I2C_BUS_2) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create I2C Bus 2");
         i2c_bus_delete(&i2c_bus1);  // Clean up bus 1
         return ESP_FAIL;
     }
     ESP_LOGI(TAG, "I2C Bus 2 initialized (GPIO%d/GPIO%d) - AS5600 + VEML7700", 
              I2C_BUS2_SDA_GPIO, I2C_BUS2_SCL_GPIO);
+#else
+    ESP_LOGI(TAG, "I2C Bus 2 not fitted in this hardware profile");
+#endif
+
+    /* Held for the driver probes until the caller releases them */
+    for (int id = 0; id < I2C_BUS_COUNT; id++) {
+        if (I2C_BUS_ALL_MASK & (1U << id)) bus_descs[id].refs = 1;
+    }
+
+    /* Without a worker the jobs still run, inline in the caller */
+    for (int i = 0; i < I2C_BUS_COUNT; i++) {
+        if (!(I2C_BUS_ALL_MASK & (1U << i))) continue;
+        if (i2c_bus_worker_create(&bus_workers[i]) != ESP_OK) {
+            ESP_LOGW(TAG, "No job worker for I2C Bus %d - its jobs run in the caller", i + 1);
+        }
+    }
 
     return ESP_OK;
 }
 
+esp_err_t i2c_buses_track_device(i2c_bus_handle_t bus, uint8_t addr, i2c_bus_device_handle_t *slot)
+{
+    int id = i2c_bus_id_of(bus);
+    if (id < 0 || slot == NULL) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    size_t i = 0;
+    while (i < dev_desc_count && dev_descs[i].slot != slot) i++;
+    esp_err_t ret = ESP_OK;
+    if (i < I2C_DEVICE_TABLE_LEN) {
+        dev_descs[i] = (i2c_dev_desc_t) { .bus = (uint8_t)id, .addr = addr, .slot = slot };
+        if (i == dev_desc_count) dev_desc_count++;
+    } else {
+        /* A handle that cannot be rebuilt must never go stale */
+        ESP_LOGW(TAG, "Device table full - I2C Bus %d stays powered", id + 1);
+        bus_descs[id].keep_powered = true;
+        ret = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(power_mutex);
+    return ret;
+}
+
+void i2c_buses_untrack_device(i2c_bus_device_handle_t *slot)
+{
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < dev_desc_count; i++) {
+        if (dev_descs[i].slot == slot) {
+            dev_descs[i] = dev_descs[--dev_desc_count];
+            break;
+        }
+    }
+    xSemaphoreGive(power_mutex);
+}
+
+esp_err_t i2c_buses_acquire(uint8_t mask)
+{
+    if (power_mutex == NULL) return ESP_ERR_INVALID_STATE;
+    mask &= I2C_BUS_ALL_MASK;
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    for (int id = 0; id < I2C_BUS_COUNT; id++) {
+        if (!(mask & (1U << id))) continue;
+        i2c_bus_desc_t *d = &bus_descs[id];
+        d->refs++;
+        /* Also retried by every later acquire if the rebuild failed */
+        if (d->parked && i2c_bus_power_up((i2c_bus_id_t)id) != ESP_OK) {
+            ESP_LOGW(TAG, "I2C Bus %d: re-init failed", id + 1);
+            ret = ESP_FAIL;
+        }
+    }
+    xSemaphoreGive(power_mutex);
+    return ret;
+}
+
+void i2c_buses_release(uint8_t mask)
+{
+    if (power_mutex == NULL) return;
+    mask &= I2C_BUS_ALL_MASK;
+
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    for (int id = 0; id < I2C_BUS_COUNT; id++) {
+        if (!(mask & (1U << id))) continue;
+        i2c_bus_desc_t *d = &bus_descs[id];
+        if (d->refs > 0) d->refs--;
+#if I2C_PARK_IDLE_BUSES
+        if (d->refs == 0 && !d->parked && !d->keep_powered && !bus_workers[id].pending) {
+            i2c_bus_park((i2c_bus_id_t)id);
+        }
+#endif
+    }
+    xSemaphoreGive(power_mutex);
+}
+
+static i2c_bus_worker_t *i2c_bus_worker_of(i2c_bus_handle_t bus)
+{
+    int id = i2c_bus_id_of(bus);
+    return id < 0 ? NULL : &bus_workers[id];
+}
+
+/* Worker side: a job the caller gave up waiting for still frees the worker,
+ * and parks the bus if its last holder released it meanwhile */
+static void i2c_bus_job_finish(i2c_bus_worker_t *w)
+{
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    w->pending = false;
+#if I2C_PARK_IDLE_BUSES
+    int id = (int)(w - bus_workers);
+    i2c_bus_desc_t *d = &bus_descs[id];
+    if (d->refs == 0 && !d->parked && !d->keep_powered) {
+        i2c_bus_park((i2c_bus_id_t)id);
+    }
+#endif
+    /* Given under the mutex so i2c_bus_job_start() can't miss a late one */
+    xSemaphoreGive(w->done);
+    xSemaphoreGive(power_mutex);
+}
+
+esp_err_t i2c_bus_job_start(i2c_bus_handle_t bus, i2c_bus_job_fn_t fn, void *arg)
+{
+    i2c_bus_worker_t *w = i2c_bus_worker_of(bus);
+    if (w == NULL || fn == NULL) return ESP_ERR_INVALID_ARG;
+
+    if (w->task == NULL) {
+        fn(arg);
+        return ESP_OK;
+    }
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    bool busy = w->pending;
+    if (!busy) {
+        /* Drop the completion of a job whose wait timed out */
+        xSemaphoreTake(w->done, 0);
+        w->fn = fn;
+        w->arg = arg;
+        w->pending = true;
+    }
+    xSemaphoreGive(power_mutex);
+    if (busy) return ESP_ERR_INVALID_STATE;
+
+    xTaskNotifyGive(w->task);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_job_wait(i2c_bus_handle_t bus, uint32_t timeout_ms)
+{
+    i2c_bus_worker_t *w = i2c_bus_worker_of(bus);
+    if (w == NULL) return ESP_ERR_INVALID_ARG;
+    if (w->task == NULL) return ESP_OK;
+
+    xSemaphoreTake(power_mutex, portMAX_DELAY);
+    bool busy = w->pending;
+    xSemaphoreGive(power_mutex);
+    if (!busy) return ESP_OK;
+
+    if (xSemaphoreTake(w->done, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        /* The worker clears pending itself when the job returns */
+        ESP_LOGW(TAG, "%s still running after %lu ms", w->name, (unsigned long)timeout_ms);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
 esp_err_t i2c_buses_deinit(void)
 {
     esp_err_t ret = ESP_OK;
+
+    for (size_t i = 0; i < dev_desc_count; i++) {
+        if (*dev_descs[i].slot != NULL) i2c_bus_device_delete(dev_descs[i].slot);
+    }
+    dev_desc_count = 0;
+    for (int id = 0; id < I2C_BUS_COUNT; id++) {
+        bus_descs[id].refs = 0;
+        bus_descs[id].parked = false;
+        bus_descs[id].keep_powered = false;
+    }
     
     if (i2c_bus1 != NULL) {
         if (i2c_bus_delete(&i2c_bus1) != ESP_OK) {
@@ -1,10 +1,14 @@
 /*
  * I2C Bus Configuration for Hardware v2.0
- * Two independent I2C buses for sensor communication
+ * Two independent I2C buses for sensor communication, each with a worker
+ * task so jobs on the two buses can run at the same time. Buses are
+ * reference counted and parked while unused.
  */
 
 #pragma once
 
+#include <stdint.h>
+#include "sdkconfig.h"
 #include "i2c_bus.h"
 #include "esp_err.h"
 
@@ -16,16 +20,76 @@ extern "C" {
 extern i2c_bus_handle_t i2c_bus1;  // Environmental sensors: SHT4x + LPS22HB
 extern i2c_bus_handle_t i2c_bus2;  // Wind & Light sensors: AS5600 + VEML7700
 
+typedef enum {
+    I2C_BUS_1 = 0,
+    I2C_BUS_2,
+    I2C_BUS_COUNT,
+} i2c_bus_id_t;
+
+#define I2C_BUS1_MASK       (1U << I2C_BUS_1)
+#define I2C_BUS2_MASK       (1U << I2C_BUS_2)
+
+/* Bus 2 is only fitted with the wind vane or the light sensor (Kconfig profile) */
+#define I2C_BUS2_PRESENT    (CONFIG_CAELUM_HAS_WIND || CONFIG_CAELUM_HAS_LIGHT)
+#if I2C_BUS2_PRESENT
+#define I2C_BUS_ALL_MASK    (I2C_BUS1_MASK | I2C_BUS2_MASK)
+#else
+#define I2C_BUS_ALL_MASK    I2C_BUS1_MASK
+#endif
+
 /**
  * @brief Initialize both I2C buses for hardware v2.0
  * 
  * Bus 1 (GPIO10/11): SHT4x temperature/humidity + LPS22HB pressure
  * Bus 2 (GPIO1/2): AS5600 wind direction + VEML7700 light sensor
  * 
+ * Both buses come up acquired once, for the driver probes; release them with
+ * i2c_buses_release(I2C_BUS_ALL_MASK) once init is done. Without
+ * I2C_BUS2_PRESENT only bus 1 is created and bus 2 masks are ignored.
+ * 
  * @return ESP_OK on success, ESP_FAIL otherwise
  */
 esp_err_t i2c_buses_init(void);
 
+/**
+ * @brief Register a driver's device handle for rebuilds
+ *
+ * While a bus is parked the handle is NULL; i2c_buses_acquire() re-creates
+ * the device at addr and stores the new handle in *slot.
+ *
+ * @param bus Bus the device was created on
+ * @param addr 7-bit address
+ * @param slot The driver's handle variable
+ * @return ESP_OK, ESP_ERR_NO_MEM when the table is full (the bus then stays powered)
+ */
+esp_err_t i2c_buses_track_device(i2c_bus_handle_t bus, uint8_t addr, i2c_bus_device_handle_t *slot);
+
+/**
+ * @brief Drop a handle registered with i2c_buses_track_device()
+ */
+void i2c_buses_untrack_device(i2c_bus_device_handle_t *slot);
+
+/**
+ * @brief Take a reference on the buses in mask, rebuilding parked ones
+ *
+ * Bus and device handles are re-created from the cached descriptors, with
+ * no bus scan. Every I2C access has to happen between acquire and release;
+ * the bus and device handles may change across a park.
+ *
+ * @param mask I2C_BUS1_MASK, I2C_BUS2_MASK or both
+ * @return ESP_OK, ESP_FAIL if a rebuild failed (retried on the next acquire)
+ */
+esp_err_t i2c_buses_acquire(uint8_t mask);
+
+/**
+ * @brief Drop a reference; a bus left unused is parked (I2C_PARK_IDLE_BUSES)
+ *
+ * Parking deletes the devices and the bus, which releases the I2C
+ * controller so the peripheral power domain may power down in light sleep,
+ * and leaves SDA/SCL with input buffer and pulls off.
+ */
+void i2c_buses_release(uint8_t mask);
+
 /**
  * @brief Deinitialize both I2C buses
  * 
@@ -33,6 +97,36 @@ esp_err_t i2c_buses_init(void);
  */
 esp_err_t i2c_buses_deinit(void);
 
+typedef void (*i2c_bus_job_fn_t)(void *arg);
+
+/**
+ * @brief Run a job on the worker task of a bus
+ *
+ * The controllers are independent, so a bus 2 job (e.g. the AS5600 burst)
+ * runs while the caller keeps using bus 1. Only one job per bus at a time;
+ * collect it with i2c_bus_job_wait(). The job must not call esp_zb_* APIs:
+ * the caller may be the Zigbee task waiting for it with the stack lock held.
+ *
+ * @param bus i2c_bus1 or i2c_bus2
+ * @param fn Job
+ * @param arg Job argument
+ * @return ESP_OK if started, ESP_ERR_INVALID_STATE if a job is still pending,
+ *         ESP_ERR_INVALID_ARG for an unknown bus
+ */
+esp_err_t i2c_bus_job_start(i2c_bus_handle_t bus, i2c_bus_job_fn_t fn, void *arg);
+
+/**
+ * @brief Wait for the job started on a bus
+ *
+ * A job still running at the timeout frees the worker (and parks the bus if
+ * it was released meanwhile) when it returns; the next start then succeeds.
+ *
+ * @param bus Bus passed to i2c_bus_job_start()
+ * @param timeout_ms Longest wait
+ * @return ESP_OK when done (or nothing pending), ESP_ERR_TIMEOUT
+ */
+esp_err_t i2c_bus_job_wait(i2c_bus_handle_t bus, uint32_t timeout_ms);
+
 /**
  * @brief Get I2C Bus 1 handle (Environmental sensors)
  * 
@@ -0,0 +1,121 @@
+/*
+ * I2C register transactions on top of i2c_bus
+ */
+
+#include <string.h>
+#include "i2c_txn.h"
+#include "esp_log.h"
+
+static const char *TAG = "I2C_TXN";
+
+/* Length of the burst starting at ops[first]: every following op of the same
+ * direction that continues at the next register joins it */
+static size_t i2c_txn_burst(const i2c_txn_op_t *ops, size_t count, size_t first, size_t *burst_len)
+{
+    size_t last = first;
+    size_t len = ops[first].len;
+    while (last + 1 < count && ops[last + 1].write == ops[first].write &&
+           ops[last + 1].reg == (uint8_t)(ops[first].reg + len) &&
+           len + ops[last + 1].len <= I2C_TXN_MAX_BURST) {
+        last++;
+        len += ops[last].len;
+    }
+    *burst_len = len;
+    return last;
+}
+
+esp_err_t i2c_txn_run(i2c_bus_device_handle_t dev, const i2c_txn_op_t *ops, size_t count)
+{
+    if (!dev || (!ops && count > 0)) return ESP_ERR_INVALID_ARG;
+
+    uint8_t buf[I2C_TXN_MAX_BURST];
+    for (size_t i = 0; i < count;) {
+        if (ops[i].len == 0 || ops[i].len > I2C_TXN_MAX_BURST || !ops[i].data) return ESP_ERR_INVALID_ARG;
+
+        size_t len = 0;
+        size_t last = i2c_txn_burst(ops, count, i, &len);
+        esp_err_t ret;
+        if (last == i) {
+            /* Nothing to merge: transfer straight from/to the caller's buffer */
+            ret = ops[i].write ? i2c_bus_write_bytes(dev, ops[i].reg, ops[i].len, ops[i].data)
+                               : i2c_bus_read_bytes(dev, ops[i].reg, ops[i].len, ops[i].data);
+        } else if (ops[i].write) {
+            size_t off = 0;
+            for (size_t k = i; k <= last; k++) {
+                memcpy(&buf[off], ops[k].data, ops[k].len);
+                off += ops[k].len;
+            }
+            ret = i2c_bus_write_bytes(dev, ops[i].reg, len, buf);
+        } else {
+            ret = i2c_bus_read_bytes(dev, ops[i].reg, len, buf);
+            size_t off = 0;
+            for (size_t k = i; ret == ESP_OK && k <= last; k++) {
+                memcpy(ops[k].data, &buf[off], ops[k].len);
+                off += ops[k].len;
+            }
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGD(TAG, "%s of %u byte(s) at 0x%02X failed: %s", ops[i].write ? "Write" : "Read",
+                     (unsigned)len, ops[i].reg, esp_err_to_name(ret));
+            return ret;
+        }
+        i = last + 1;
+    }
+    return ESP_OK;
+}
+
+static void i2c_shadow_encode(const i2c_shadow_reg_t *shadow, uint16_t value, uint8_t *data)
+{
+    if (shadow->width == 1) {
+        data[0] = (uint8_t)value;
+    } else if (shadow->lsb_first) {
+        data[0] = value & 0xFF;
+        data[1] = value >> 8;
+    } else {
+        data[0] = value >> 8;
+        data[1] = value & 0xFF;
+    }
+}
+
+esp_err_t i2c_shadow_store(i2c_bus_device_handle_t dev, i2c_shadow_reg_t *shadow, uint16_t value)
+{
+    if (!dev || !shadow || shadow->width == 0 || shadow->width > 2) return ESP_ERR_INVALID_ARG;
+
+    uint8_t data[2];
+    i2c_shadow_encode(shadow, value, data);
+    esp_err_t ret = i2c_bus_write_bytes(dev, shadow->reg, shadow->width, data);
+    /* After a failed write the chip may hold either value */
+    shadow->valid = ret == ESP_OK;
+    shadow->value = value;
+    return ret;
+}
+
+esp_err_t i2c_shadow_write(i2c_bus_device_handle_t dev, i2c_shadow_reg_t *shadow, uint16_t value)
+{
+    if (!shadow) return ESP_ERR_INVALID_ARG;
+    if (shadow->valid && shadow->value == value) return ESP_OK;
+    return i2c_shadow_store(dev, shadow, value);
+}
+
+esp_err_t i2c_shadow_update(i2c_bus_device_handle_t dev, i2c_shadow_reg_t *shadow, uint16_t mask, uint16_t bits)
+{
+    if (!dev || !shadow || shadow->width == 0 || shadow->width > 2) return ESP_ERR_INVALID_ARG;
+
+    if (!shadow->valid) {
+        uint8_t data[2] = {0};
+        esp_err_t ret = i2c_bus_read_bytes(dev, shadow->reg, shadow->width, data);
+        if (ret != ESP_OK) return ret;
+        if (shadow->width == 1) {
+            shadow->value = data[0];
+        } else {
+            shadow->value = shadow->lsb_first ? (uint16_t)(data[0] | (data[1] << 8)) : (uint16_t)((data[0] << 8) | data[1]);
+        }
+        shadow->valid = true;
+    }
+    return i2c_shadow_write(dev, shadow, (shadow->value & ~mask) | (bits & mask));
+}
+
+void i2c_shadow_invalidate(i2c_shadow_reg_t *shadow)
+{
+    if (shadow) shadow->valid = false;
+}
@@ -0,0 +1,100 @@
+/*
+ * I2C register transactions on top of i2c_bus
+ * A driver describes its register accesses as a list; runs of reads (or
+ * writes) on consecutive registers are merged into one burst, i.e. one
+ * start / register address / repeated start / data / stop sequence, so a
+ * status + data + temperature fetch costs one transfer instead of three.
+ * Shadow registers keep the last value written to a configuration register,
+ * so a read-modify-write needs no read and an unchanged write is skipped.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "i2c_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define I2C_TXN_MAX_BURST       32      // longest merged burst in bytes
+
+typedef struct {
+    uint8_t reg;                    // first register
+    uint8_t len;                    // bytes, at most I2C_TXN_MAX_BURST
+    bool write;
+    uint8_t *data;                  // read: destination, write: source
+} i2c_txn_op_t;
+
+#define I2C_TXN_READ(r, buf, n)     { .reg = (r), .len = (n), .write = false, .data = (buf) }
+#define I2C_TXN_WRITE(r, buf, n)    { .reg = (r), .len = (n), .write = true, .data = (uint8_t *)(buf) }
+
+typedef struct {
+    uint8_t reg;
+    uint8_t width;                  // 1 or 2 bytes
+    bool lsb_first;                 // byte order of a 2-byte register
+    bool valid;                     // value mirrors the chip
+    uint16_t value;
+} i2c_shadow_reg_t;
+
+#define I2C_SHADOW_REG8(r)          { .reg = (r), .width = 1 }
+#define I2C_SHADOW_REG16_LE(r)      { .reg = (r), .width = 2, .lsb_first = true }
+#define I2C_SHADOW_REG16_BE(r)      { .reg = (r), .width = 2, .lsb_first = false }
+
+/**
+ * @brief Run a list of register accesses, merging consecutive ones into bursts
+ *
+ * Ops are run in order. A read (or write) that starts at the register where
+ * the previous op of the same direction ended joins its burst, which needs a
+ * chip that auto-increments the register address. The list is not atomic
+ * against other tasks using the same device.
+ *
+ * @param dev Device
+ * @param ops Accesses
+ * @param count Number of ops
+ * @return ESP_OK, the first transfer error, or ESP_ERR_INVALID_ARG
+ */
+esp_err_t i2c_txn_run(i2c_bus_device_handle_t dev, const i2c_txn_op_t *ops, size_t count);
+
+/**
+ * @brief Write a shadowed register unless it already holds the value
+ *
+ * @param dev Device
+ * @param shadow Register shadow
+ * @param value New value
+ * @return ESP_OK on success (or when skipped)
+ */
+esp_err_t i2c_shadow_write(i2c_bus_device_handle_t dev, i2c_shadow_reg_t *shadow, uint16_t value);
+
+/**
+ * @brief Write a shadowed register even if it already holds the value
+ *
+ * For registers whose write has a side effect (e.g. restarting a conversion).
+ */
+esp_err_t i2c_shadow_store(i2c_bus_device_handle_t dev, i2c_shadow_reg_t *shadow, uint16_t value);
+
+/**
+ * @brief Read-modify-write of the bits in mask
+ *
+ * The chip is only read the first time (or after i2c_shadow_invalidate());
+ * the write is skipped when the bits do not change.
+ *
+ * @param dev Device
+ * @param shadow Register shadow
+ * @param mask Bits to change
+ * @param bits New values of those bits
+ * @return ESP_OK on success
+ */
+esp_err_t i2c_shadow_update(i2c_bus_device_handle_t dev, i2c_shadow_reg_t *shadow, uint16_t mask, uint16_t bits);
+
+/**
+ * @brief Forget the shadowed value (chip reset, failed write)
+ */
+void i2c_shadow_invalidate(i2c_shadow_reg_t *shadow);
+
+#ifdef __cplusplus
+}
+#endif
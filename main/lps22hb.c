@@ -4,19 +4,27 @@
  *
  * Operated in one-shot mode for low-power battery use: the device stays idle
  * until a measurement is triggered, then automatically returns to power-down.
+ * In FIFO mode it samples at 1 Hz on its own instead and every fetch drains
+ * the FIFO in one burst: the reading is the mean of the last 32 seconds.
  */
 
 #include "lps22hb.h"
+#include "i2c_txn.h"
+#include "i2c_config.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include <string.h>
 
 static const char *TAG = "LPS22HB";
 
 /* LPS22HB Registers */
 #define LPS22HB_REG_WHO_AM_I    0x0F    // Device ID (reads 0xB1)
 #define LPS22HB_REG_CTRL_REG1   0x10    // Control register 1 (ODR, BDU)
-#define LPS22HB_REG_CTRL_REG2   0x11    // Control register 2 (ONE_SHOT, reset)
+#define LPS22HB_REG_CTRL_REG2   0x11    // Control register 2 (ONE_SHOT, FIFO_EN, reset)
+#define LPS22HB_REG_FIFO_CTRL   0x14    // FIFO mode and watermark
+#define LPS22HB_REG_RES_CONF    0x1A    // Low-current mode
+#define LPS22HB_REG_FIFO_STATUS 0x26    // FIFO level
 #define LPS22HB_REG_STATUS      0x27    // Status (data available flags)
 #define LPS22HB_REG_PRESS_OUT_XL 0x28   // Pressure output, low byte
 #define LPS22HB_REG_PRESS_OUT_L  0x29
@@ -29,10 +37,25 @@ static const char *TAG = "LPS22HB";
 /* CTRL_REG1 bits */
 #define LPS22HB_CTRL1_BDU       0x02    // Block data update (avoid torn reads)
 /* ODR[2:0] = 000 keeps the device in one-shot (power-down) mode */
+#define LPS22HB_CTRL1_ODR_1HZ   0x10
 
 /* CTRL_REG2 bits */
 #define LPS22HB_CTRL2_ONE_SHOT   0x01   // Trigger a single measurement
 #define LPS22HB_CTRL2_IF_ADD_INC 0x10   // Auto-increment register address on multi-byte reads (default 1)
+#define LPS22HB_CTRL2_FIFO_EN    0x40
+
+/* FIFO_CTRL F_MODE[2:0] */
+#define LPS22HB_FIFO_BYPASS     0x00
+#define LPS22HB_FIFO_STREAM     0x40    // keeps the newest samples when full
+
+/* RES_CONF bits */
+#define LPS22HB_RES_LC_EN       0x01    // low-current mode (3 uA at 1 Hz instead of 12, more noise per sample)
+
+/* FIFO_STATUS bits */
+#define LPS22HB_FIFO_FSS_MASK   0x3F    // stored samples
+#define LPS22HB_FIFO_OVR        0x40    // full, oldest overwritten
+
+#define LPS22HB_FIFO_SAMPLE_BYTES 5     // PRESS_OUT_XL..TEMP_OUT_H
 
 /* STATUS bits */
 #define LPS22HB_STATUS_T_DA     0x02    // Temperature data available
@@ -40,6 +63,16 @@ static const char *TAG = "LPS22HB";
 
 static i2c_bus_device_handle_t s_dev = NULL;
 
+/* Output registers captured by the fetch burst, valid until the next trigger */
+static uint8_t s_press_raw[3];
+static uint8_t s_temp_raw[2];
+static bool s_result_valid = false;
+
+/* FIFO mode: mean of the last drain (raw units) */
+static bool s_fifo = false;
+static float s_fifo_press_raw;
+static float s_fifo_temp_raw;
+
 static esp_err_t lps22hb_read_reg(uint8_t reg, uint8_t *data, size_t len)
 {
     /* The LPS22HB auto-increments the register pointer on multi-byte reads by
@@ -78,31 +111,41 @@ esp_err_t lps22hb_init(i2c_bus_handle_t i2c_bus)
         return ESP_ERR_NOT_FOUND;
     }
 
-    /* One-shot mode: ODR=000 (power-down between reads), block data update on */
-    ret = lps22hb_write_reg(LPS22HB_REG_CTRL_REG1, LPS22HB_CTRL1_BDU);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "lps22hb_init: CTRL_REG1 write failed");
-        i2c_bus_device_delete(&s_dev);
-        return ESP_ERR_NOT_FOUND;
-    }
-
-    /* Explicitly set IF_ADD_INC so multi-byte reads auto-increment, rather than
-     * relying on the power-on default (which a careless CTRL_REG2 write can clear). */
-    ret = lps22hb_write_reg(LPS22HB_REG_CTRL_REG2, LPS22HB_CTRL2_IF_ADD_INC);
+    /* One-shot mode: ODR=000 (power-down between reads), block data update on,
+     * FIFO bypassed and low-current mode off (either may be left over from a
+     * previous boot in FIFO mode). IF_ADD_INC is set explicitly so multi-byte
+     * reads auto-increment, rather than relying on the power-on default (which
+     * a careless CTRL_REG2 write can clear). */
+    s_fifo = false;
+    s_result_valid = false;
+    const uint8_t ctrl1 = LPS22HB_CTRL1_BDU;
+    const uint8_t fifo_ctrl = LPS22HB_FIFO_BYPASS;
+    const uint8_t res_conf = 0;
+    const uint8_t ctrl2 = LPS22HB_CTRL2_IF_ADD_INC;
+    const i2c_txn_op_t cfg[] = {
+        I2C_TXN_WRITE(LPS22HB_REG_CTRL_REG1, &ctrl1, 1),
+        I2C_TXN_WRITE(LPS22HB_REG_FIFO_CTRL, &fifo_ctrl, 1),
+        I2C_TXN_WRITE(LPS22HB_REG_RES_CONF, &res_conf, 1),
+        I2C_TXN_WRITE(LPS22HB_REG_CTRL_REG2, &ctrl2, 1),
+    };
+    ret = i2c_txn_run(s_dev, cfg, sizeof(cfg) / sizeof(cfg[0]));
     if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "lps22hb_init: CTRL_REG2 write failed");
+        ESP_LOGW(TAG, "lps22hb_init: configuration failed");
         i2c_bus_device_delete(&s_dev);
         return ESP_ERR_NOT_FOUND;
     }
 
+    i2c_buses_track_device(i2c_bus, LPS22HB_I2C_ADDR, &s_dev);
     ESP_LOGI(TAG, "lps22hb_init: probe OK (one-shot mode)");
     return ESP_OK;
 }
 
-esp_err_t lps22hb_trigger_measurement(void)
+esp_err_t lps22hb_start_measurement(void)
 {
     if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
 
+    s_result_valid = false;
+
     /* Start a one-shot conversion. MUST keep IF_ADD_INC set in the same write:
      * a bare ONE_SHOT (0x01) clears IF_ADD_INC, which disables register
      * auto-increment, so the 3-byte PRESS_OUT read returns the same byte three
@@ -110,21 +153,114 @@ esp_err_t lps22hb_trigger_measurement(void)
     esp_err_t ret = lps22hb_write_reg(LPS22HB_REG_CTRL_REG2,
                                       LPS22HB_CTRL2_IF_ADD_INC | LPS22HB_CTRL2_ONE_SHOT);
     if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "lps22hb_trigger_measurement: ONE_SHOT write failed");
+        ESP_LOGW(TAG, "lps22hb_start_measurement: ONE_SHOT write failed");
+    }
+    return ret;
+}
+
+esp_err_t lps22hb_start_fifo(void)
+{
+    if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
+
+    /* Low-current mode, FIFO in stream mode, then the ODR starts sampling */
+    const uint8_t res_conf = LPS22HB_RES_LC_EN;
+    const uint8_t ctrl2 = LPS22HB_CTRL2_IF_ADD_INC | LPS22HB_CTRL2_FIFO_EN;
+    const uint8_t fifo_ctrl = LPS22HB_FIFO_STREAM;
+    const uint8_t ctrl1 = LPS22HB_CTRL1_ODR_1HZ | LPS22HB_CTRL1_BDU;
+    const i2c_txn_op_t cfg[] = {
+        I2C_TXN_WRITE(LPS22HB_REG_RES_CONF, &res_conf, 1),
+        I2C_TXN_WRITE(LPS22HB_REG_CTRL_REG2, &ctrl2, 1),
+        I2C_TXN_WRITE(LPS22HB_REG_FIFO_CTRL, &fifo_ctrl, 1),
+        I2C_TXN_WRITE(LPS22HB_REG_CTRL_REG1, &ctrl1, 1),
+    };
+    esp_err_t ret = i2c_txn_run(s_dev, cfg, sizeof(cfg) / sizeof(cfg[0]));
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "lps22hb_start_fifo: configuration failed");
         return ret;
     }
+    s_fifo = true;
+    s_result_valid = false;
+    ESP_LOGI(TAG, "FIFO mode: %d Hz, %d samples", LPS22HB_FIFO_ODR_HZ, LPS22HB_FIFO_DEPTH);
+    return ESP_OK;
+}
 
-    /* Poll STATUS until both pressure and temperature are available.
-     * A one-shot conversion completes well within ~40ms. */
-    for (int i = 0; i < 10; i++) {
-        vTaskDelay(pdMS_TO_TICKS(5));
-        uint8_t status = 0;
-        if (lps22hb_read_reg(LPS22HB_REG_STATUS, &status, 1) == ESP_OK) {
-            if ((status & (LPS22HB_STATUS_P_DA | LPS22HB_STATUS_T_DA)) ==
-                (LPS22HB_STATUS_P_DA | LPS22HB_STATUS_T_DA)) {
-                return ESP_OK;
-            }
+/* Read every stored sample in one burst and average it. With the FIFO
+ * enabled the register pointer wraps from TEMP_OUT_H back to PRESS_OUT_XL,
+ * each wrap popping the next sample. */
+static esp_err_t lps22hb_drain_fifo(void)
+{
+    uint8_t status = 0;
+    esp_err_t ret = lps22hb_read_reg(LPS22HB_REG_FIFO_STATUS, &status, 1);
+    if (ret != ESP_OK) return ret;
+
+    int level = status & LPS22HB_FIFO_FSS_MASK;
+    if (status & LPS22HB_FIFO_OVR) level = LPS22HB_FIFO_DEPTH;
+    if (level == 0) return ESP_ERR_NOT_FINISHED;
+
+    uint8_t buf[LPS22HB_FIFO_DEPTH * LPS22HB_FIFO_SAMPLE_BYTES];
+    ret = lps22hb_read_reg(LPS22HB_REG_PRESS_OUT_XL, buf, (size_t)level * LPS22HB_FIFO_SAMPLE_BYTES);
+    if (ret != ESP_OK) return ret;
+
+    int64_t press_sum = 0;
+    int32_t temp_sum = 0;
+    for (int i = 0; i < level; i++) {
+        const uint8_t *p = &buf[i * LPS22HB_FIFO_SAMPLE_BYTES];
+        int32_t p_raw = ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+        if (p_raw & 0x800000) p_raw -= 0x1000000;
+        press_sum += p_raw;
+        temp_sum += (int16_t)(((uint16_t)p[4] << 8) | (uint16_t)p[3]);
+    }
+    s_fifo_press_raw = (float)press_sum / (float)level;
+    s_fifo_temp_raw = (float)temp_sum / (float)level;
+    s_result_valid = true;
+    ESP_LOGD(TAG, "FIFO drained: %d samples", level);
+    return ESP_OK;
+}
+
+esp_err_t lps22hb_fetch_measurement(void)
+{
+    if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
+    if (s_fifo) return lps22hb_drain_fifo();
+
+    /* STATUS alone first: reading the outputs clears P_DA/T_DA, so a
+     * conversion ending mid-burst would never show as ready */
+    uint8_t status = 0;
+    esp_err_t ret = lps22hb_read_reg(LPS22HB_REG_STATUS, &status, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if ((status & (LPS22HB_STATUS_P_DA | LPS22HB_STATUS_T_DA)) !=
+        (LPS22HB_STATUS_P_DA | LPS22HB_STATUS_T_DA)) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+
+    /* PRESS_OUT and TEMP_OUT are adjacent (0x28..0x2C): one burst */
+    uint8_t out[LPS22HB_FIFO_SAMPLE_BYTES];
+    ret = lps22hb_read_reg(LPS22HB_REG_PRESS_OUT_XL, out, sizeof(out));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    memcpy(s_press_raw, out, sizeof(s_press_raw));
+    memcpy(s_temp_raw, out + sizeof(s_press_raw), sizeof(s_temp_raw));
+    s_result_valid = true;
+    return ESP_OK;
+}
+
+esp_err_t lps22hb_trigger_measurement(void)
+{
+    esp_err_t ret = lps22hb_start_measurement();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    /* Wait the typical conversion time, then poll STATUS (one cheap register
+     * read) every millisecond; a one-shot conversion completes well within ~40ms. */
+    vTaskDelay(pdMS_TO_TICKS(LPS22HB_ONE_SHOT_TIME_MS));
+    for (int i = 0; i < 25; i++) {
+        if (lps22hb_fetch_measurement() == ESP_OK) {
+            return ESP_OK;
         }
+        vTaskDelay(pdMS_TO_TICKS(1));
     }
 
     ESP_LOGW(TAG, "lps22hb_trigger_measurement: data not ready (timeout)");
@@ -136,11 +272,21 @@ esp_err_t lps22hb_read_pressure(float *pressure)
     if (!pressure) return ESP_ERR_INVALID_ARG;
     if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
 
+    if (s_fifo) {
+        if (!s_result_valid) return ESP_ERR_INVALID_STATE;
+        *pressure = s_fifo_press_raw / 4096.0f;
+        return ESP_OK;
+    }
+
     uint8_t raw[3] = {0};
-    esp_err_t ret = lps22hb_read_reg(LPS22HB_REG_PRESS_OUT_XL, raw, 3);
-    if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "PRESS read failed: %s", esp_err_to_name(ret));
-        return ret;
+    if (s_result_valid) {
+        memcpy(raw, s_press_raw, sizeof(raw));
+    } else {
+        esp_err_t ret = lps22hb_read_reg(LPS22HB_REG_PRESS_OUT_XL, raw, 3);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "PRESS read failed: %s", esp_err_to_name(ret));
+            return ret;
+        }
     }
 
     /* 24-bit signed value, LSB first */
@@ -158,9 +304,19 @@ esp_err_t lps22hb_read_temperature(float *temperature)
     if (!temperature) return ESP_ERR_INVALID_ARG;
     if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
 
+    if (s_fifo) {
+        if (!s_result_valid) return ESP_ERR_INVALID_STATE;
+        *temperature = s_fifo_temp_raw / 100.0f;
+        return ESP_OK;
+    }
+
     uint8_t raw[2];
-    esp_err_t ret = lps22hb_read_reg(LPS22HB_REG_TEMP_OUT_L, raw, 2);
-    if (ret != ESP_OK) return ret;
+    if (s_result_valid) {
+        memcpy(raw, s_temp_raw, sizeof(raw));
+    } else {
+        esp_err_t ret = lps22hb_read_reg(LPS22HB_REG_TEMP_OUT_L, raw, 2);
+        if (ret != ESP_OK) return ret;
+    }
 
     /* 16-bit signed value, LSB first */
     int16_t t_raw = (int16_t)(((uint16_t)raw[1] << 8) | (uint16_t)raw[0]);
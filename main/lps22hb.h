@@ -23,6 +23,28 @@ extern "C" {
  */
 esp_err_t lps22hb_init(i2c_bus_handle_t i2c_bus);
 
+/* Typical one-shot conversion time; lps22hb_fetch_measurement() checks STATUS
+ * so a slower conversion is reported as ESP_ERR_NOT_FINISHED, not bad data. */
+#define LPS22HB_ONE_SHOT_TIME_MS    15
+
+/**
+ * @brief Start a one-shot conversion without waiting for it
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t lps22hb_start_measurement(void);
+
+/**
+ * @brief Check that the conversion started by lps22hb_start_measurement() is done
+ *
+ * In FIFO mode: drain the FIFO and average it.
+ *
+ * @return ESP_OK when pressure and temperature are available,
+ *         ESP_ERR_NOT_FINISHED while the conversion is still running (FIFO
+ *         mode: the FIFO is empty)
+ */
+esp_err_t lps22hb_fetch_measurement(void);
+
 /**
  * @brief Trigger a one-shot measurement and wait for completion
  *
@@ -30,6 +52,22 @@ esp_err_t lps22hb_init(i2c_bus_handle_t i2c_bus);
  */
 esp_err_t lps22hb_trigger_measurement(void);
 
+/* FIFO (background) mode: 1 Hz in low-current mode into the 32-level FIFO,
+ * stream mode so it always holds the newest 32 s */
+#define LPS22HB_FIFO_DEPTH          32
+#define LPS22HB_FIFO_ODR_HZ         1
+
+/**
+ * @brief Sample continuously into the FIFO instead of one-shot conversions
+ *
+ * From then on lps22hb_fetch_measurement() drains the FIFO in one burst and
+ * the read functions return the mean of the samples drained;
+ * lps22hb_start_measurement() must no longer be called.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t lps22hb_start_fifo(void);
+
 /**
  * @brief Read last measured pressure in hPa
  *
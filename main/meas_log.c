@@ -0,0 +1,441 @@
+/*
+ * Offline measurement log
+ */
+
+#include <string.h>
+#include <time.h>
+#include "meas_log.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "MEAS_LOG";
+
+#define SLOTS_PER_SECTOR        (MEAS_LOG_SECTOR_SIZE / MEAS_LOG_SLOT_SIZE)
+#define SLOT_BODY_SIZE          13
+#define KEY_BODY_SIZE           (2 * SLOT_BODY_SIZE)    // u16 generation, u16 boot, u32 time, int16 fields
+#define WIRE_KEY_SIZE           (1 + 4 + 2 * MEAS_FIELD_COUNT)
+#define WIRE_DELTA_SIZE         (1 + 2 + MEAS_FIELD_COUNT)
+
+#define SLOT_KIND_KEY_A         0x01    // first half of a keyframe, first slot of every sector
+#define SLOT_KIND_KEY_B         0x02
+#define SLOT_KIND_DELTA         0x03
+#define SLOT_KIND_MASK          0x7F
+#define SLOT_UNSENT             0x80    // cleared in place once the sample was backfilled
+
+#define WIRE_KIND_KEY           0
+#define WIRE_KIND_DELTA         1
+#define WIRE_KIND_KEY_OLD_BOOT  2       // time from an earlier boot
+
+typedef struct {
+    uint8_t kind;
+    uint8_t body[SLOT_BODY_SIZE];
+    uint16_t crc;                       // CRC16 of kind (with SLOT_UNSENT) and body
+} meas_slot_t;
+
+_Static_assert(sizeof(meas_slot_t) == MEAS_LOG_SLOT_SIZE, "measurement log slot must stay 16 bytes");
+_Static_assert(KEY_BODY_SIZE == 8 + 2 * MEAS_FIELD_COUNT, "keyframe must fill two slots");
+
+/* Position in the ring plus the decoded sample before it (deltas need it) */
+typedef struct {
+    size_t slot;
+    bool first;                         // slot == head means "whole ring" on the first step
+    bool prev_valid;
+    meas_sample_t prev;
+} meas_reader_t;
+
+static const esp_partition_t *s_part = NULL;
+static size_t s_slots = 0;
+static size_t s_head = 0;               // next slot to write
+static uint16_t s_gen = 0;              // generation of the newest sector
+static uint16_t s_boot = 0;             // this boot's number, stamped on every sample
+static meas_sample_t s_last;            // last appended sample
+static bool s_last_valid = false;
+static uint32_t s_since_key = 0;
+static meas_reader_t s_cursor;          // oldest unsent sample
+static size_t s_pending = 0;
+
+static size_t next_slot(size_t slot)
+{
+    return (slot + 1) % s_slots;
+}
+
+static size_t next_sector_start(size_t slot)
+{
+    return ((slot / SLOTS_PER_SECTOR + 1) * SLOTS_PER_SECTOR) % s_slots;
+}
+
+static uint16_t slot_crc(const meas_slot_t *slot)
+{
+    uint8_t kind = slot->kind | SLOT_UNSENT;
+    uint16_t crc = esp_rom_crc16_le(0, &kind, 1);
+    return esp_rom_crc16_le(crc, slot->body, SLOT_BODY_SIZE);
+}
+
+static bool slot_blank(const meas_slot_t *slot)
+{
+    const uint8_t *p = (const uint8_t *)slot;
+    for (size_t i = 0; i < sizeof(*slot); i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static uint8_t slot_kind(const meas_slot_t *slot)
+{
+    return slot->crc == slot_crc(slot) ? (slot->kind & SLOT_KIND_MASK) : 0;
+}
+
+static esp_err_t read_slot(size_t slot, meas_slot_t *out)
+{
+    return esp_partition_read(s_part, slot * MEAS_LOG_SLOT_SIZE, out, sizeof(*out));
+}
+
+/* The boot takes the upper half of what was a u32 generation: keys written
+ * before it read as boot 0 */
+static void key_pack(uint8_t *body, uint16_t gen, const meas_sample_t *s)
+{
+    memcpy(body, &gen, 2);
+    memcpy(body + 2, &s->boot, 2);
+    memcpy(body + 4, &s->time_s, 4);
+    memcpy(body + 8, s->v, 2 * MEAS_FIELD_COUNT);
+}
+
+static void key_unpack(const uint8_t *body, uint16_t *gen, meas_sample_t *s)
+{
+    if (gen) memcpy(gen, body, 2);
+    memcpy(&s->boot, body + 2, 2);
+    memcpy(&s->time_s, body + 4, 4);
+    memcpy(s->v, body + 8, 2 * MEAS_FIELD_COUNT);
+}
+
+/* Per-field difference that fits an int8, false if the sample needs a keyframe */
+static bool delta_encode(const meas_sample_t *prev, const meas_sample_t *cur, uint16_t *dt, int8_t *d)
+{
+    if (cur->boot != prev->boot) return false;     // the clock restarted in between
+    if (cur->time_s < prev->time_s || cur->time_s - prev->time_s > UINT16_MAX) return false;
+    *dt = (uint16_t)(cur->time_s - prev->time_s);
+
+    for (int f = 0; f < MEAS_FIELD_COUNT; f++) {
+        if (cur->v[f] == MEAS_LOG_ABSENT) {
+            d[f] = INT8_MIN;
+            continue;
+        }
+        if (prev->v[f] == MEAS_LOG_ABSENT) return false;
+        int32_t diff = (int32_t)cur->v[f] - prev->v[f];
+        if (f == MEAS_FIELD_WIND_DIR) {
+            if (diff >= 180) diff -= 360;
+            if (diff < -180) diff += 360;
+        } else if (f == MEAS_FIELD_RAIN_TIPS) {
+            diff &= 0x7FFF;
+            if (diff >= 0x4000) diff -= 0x8000;
+        }
+        if (diff < -127 || diff > 127) return false;
+        d[f] = (int8_t)diff;
+    }
+    return true;
+}
+
+static void delta_apply(const meas_sample_t *prev, uint16_t dt, const int8_t *d, meas_sample_t *out)
+{
+    out->time_s = prev->time_s + dt;
+    out->boot = prev->boot;
+    for (int f = 0; f < MEAS_FIELD_COUNT; f++) {
+        if (d[f] == INT8_MIN) {
+            out->v[f] = MEAS_LOG_ABSENT;
+            continue;
+        }
+        int32_t v = (int32_t)prev->v[f] + d[f];
+        if (f == MEAS_FIELD_WIND_DIR) {
+            v = (v + 360) % 360;
+        } else if (f == MEAS_FIELD_RAIN_TIPS) {
+            v &= 0x7FFF;
+        }
+        out->v[f] = (int16_t)v;
+    }
+}
+
+/* Decode the next sample at or after r->slot, stepping over empty sectors,
+ * torn slots and deltas that lost their keyframe. Stops at the head. */
+static bool reader_next(meas_reader_t *r, meas_sample_t *out, size_t *slot_out, size_t *nslots, bool *unsent)
+{
+    meas_slot_t a, b;
+    while (r->slot != s_head || r->first) {
+        r->first = false;
+        size_t idx = r->slot % SLOTS_PER_SECTOR;
+        bool ok = read_slot(r->slot, &a) == ESP_OK;
+        uint8_t kind = ok ? slot_kind(&a) : 0;
+
+        if ((idx == 0 && kind != SLOT_KIND_KEY_A) || (ok && slot_blank(&a))) {
+            /* Sector not in use, or its written part ends here */
+            size_t next = next_sector_start(r->slot);
+            bool head_ahead = s_head / SLOTS_PER_SECTOR == r->slot / SLOTS_PER_SECTOR && s_head > r->slot;
+            r->slot = head_ahead ? s_head : next;
+            r->prev_valid = false;
+            continue;
+        }
+        if (kind == SLOT_KIND_KEY_A && idx < SLOTS_PER_SECTOR - 1 &&
+            read_slot(r->slot + 1, &b) == ESP_OK && slot_kind(&b) == SLOT_KIND_KEY_B) {
+            uint8_t body[KEY_BODY_SIZE];
+            memcpy(body, a.body, SLOT_BODY_SIZE);
+            memcpy(body + SLOT_BODY_SIZE, b.body, SLOT_BODY_SIZE);
+            key_unpack(body, NULL, out);
+            *slot_out = r->slot;
+            *nslots = 2;
+            *unsent = (a.kind & SLOT_UNSENT) != 0;
+            r->slot = (r->slot + 2) % s_slots;
+            r->prev = *out;
+            r->prev_valid = true;
+            return true;
+        }
+        if (kind == SLOT_KIND_DELTA && r->prev_valid) {
+            uint16_t dt;
+            memcpy(&dt, a.body, 2);
+            delta_apply(&r->prev, dt, (const int8_t *)(a.body + 2), out);
+            *slot_out = r->slot;
+            *nslots = 1;
+            *unsent = (a.kind & SLOT_UNSENT) != 0;
+            r->slot = next_slot(r->slot);
+            r->prev = *out;
+            return true;
+        }
+        /* Torn write, orphan half keyframe or delta without a base */
+        r->slot = next_slot(r->slot);
+        r->prev_valid = false;
+    }
+    return false;
+}
+
+/* The head entered the oldest sector: drop it, unsent samples included */
+static esp_err_t erase_head_sector(void)
+{
+    size_t sector = s_head / SLOTS_PER_SECTOR;
+    if (s_pending > 0 && s_cursor.slot / SLOTS_PER_SECTOR == sector) {
+        size_t lost = 0;
+        meas_slot_t slot;
+        for (size_t i = s_cursor.slot; i < (sector + 1) * SLOTS_PER_SECTOR; i++) {
+            if (read_slot(i, &slot) != ESP_OK || !(slot.kind & SLOT_UNSENT)) continue;
+            uint8_t kind = slot_kind(&slot);
+            if (kind == SLOT_KIND_KEY_A || kind == SLOT_KIND_DELTA) lost++;
+        }
+        s_pending = lost < s_pending ? s_pending - lost : 0;
+        s_cursor.slot = next_sector_start(s_head);
+        s_cursor.first = false;
+        s_cursor.prev_valid = false;
+        ESP_LOGW(TAG, "⚠️ Log full - dropped %u unsent samples", (unsigned)lost);
+    }
+    return esp_partition_erase_range(s_part, sector * MEAS_LOG_SECTOR_SIZE, MEAS_LOG_SECTOR_SIZE);
+}
+
+esp_err_t meas_log_init(void)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, MEAS_LOG_PARTITION_SUBTYPE, MEAS_LOG_PARTITION_LABEL);
+    if (s_part == NULL) {
+        ESP_LOGW(TAG, "⚠️ No '%s' partition - offline samples are not kept", MEAS_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (s_part->size < 2 * MEAS_LOG_SECTOR_SIZE || s_part->size % MEAS_LOG_SECTOR_SIZE != 0) {
+        ESP_LOGE(TAG, "Partition '%s' must be a multiple of %d bytes, at least two sectors",
+                 MEAS_LOG_PARTITION_LABEL, MEAS_LOG_SECTOR_SIZE);
+        s_part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_slots = s_part->size / MEAS_LOG_SLOT_SIZE;
+    size_t sectors = s_slots / SLOTS_PER_SECTOR;
+
+    /* Newest sector = highest generation in its leading keyframe (a u16 wraps
+     * after 65536 sector erases, i.e. over a century of offline samples) */
+    size_t newest = SIZE_MAX;
+    meas_slot_t a, b;
+    s_gen = 0;
+    for (size_t sec = 0; sec < sectors; sec++) {
+        size_t slot = sec * SLOTS_PER_SECTOR;
+        if (read_slot(slot, &a) != ESP_OK || slot_kind(&a) != SLOT_KIND_KEY_A) continue;
+        uint16_t gen;
+        memcpy(&gen, a.body, 2);
+        if (newest == SIZE_MAX || gen > s_gen) {
+            s_gen = gen;
+            newest = sec;
+        }
+    }
+
+    s_head = 0;
+    s_pending = 0;
+    s_boot = 0;
+    memset(&s_cursor, 0, sizeof(s_cursor));
+    if (newest != SIZE_MAX) {
+        size_t used = 0;
+        for (size_t i = 0; i < SLOTS_PER_SECTOR; i++) {
+            if (read_slot(newest * SLOTS_PER_SECTOR + i, &b) == ESP_OK && !slot_blank(&b)) used = i + 1;
+        }
+        s_head = (newest * SLOTS_PER_SECTOR + used) % s_slots;
+
+        /* Walk oldest to newest: count unsent samples, find the first one */
+        meas_reader_t r = { .slot = ((newest + 1) % sectors) * SLOTS_PER_SECTOR };
+        r.first = r.slot == s_head;
+        s_cursor.slot = s_head;
+        meas_sample_t sample;
+        size_t slot, nslots, total = 0;
+        bool unsent;
+        meas_reader_t before = r;
+        while (reader_next(&r, &sample, &slot, &nslots, &unsent)) {
+            total++;
+            s_boot = sample.boot;
+            if (unsent) {
+                if (s_pending == 0) s_cursor = before;
+                s_pending++;
+            }
+            before = r;
+        }
+        ESP_LOGI(TAG, "📂 %u samples, %u not yet sent (generation %u, last boot %u)", (unsigned)total,
+                 (unsigned)s_pending, (unsigned)s_gen, (unsigned)s_boot);
+    } else {
+        ESP_LOGI(TAG, "📂 Log empty (%u slots)", (unsigned)s_slots);
+    }
+
+    /* Newest sample, not the highest number: survives the u16 wrapping; 0 stays "unknown" */
+    if (++s_boot == 0) s_boot = 1;
+
+    /* Start a new chain: the first sample after boot is a keyframe */
+    s_last_valid = false;
+    return ESP_OK;
+}
+
+esp_err_t meas_log_append(const meas_sample_t *in)
+{
+    if (s_part == NULL) return ESP_ERR_INVALID_STATE;
+
+    meas_sample_t stamped = *in;
+    stamped.boot = s_boot;
+    const meas_sample_t *sample = &stamped;
+
+    uint16_t dt = 0;
+    int8_t d[MEAS_FIELD_COUNT];
+    bool key = !s_last_valid || s_since_key >= MEAS_LOG_KEYFRAME_INTERVAL ||
+               s_head % SLOTS_PER_SECTOR == 0 || !delta_encode(&s_last, sample, &dt, d);
+    if (key && s_head % SLOTS_PER_SECTOR == SLOTS_PER_SECTOR - 1) {
+        s_head = next_slot(s_head);     // no room for both halves: leave the last slot blank
+    }
+
+    esp_err_t ret = ESP_OK;
+    if (s_head % SLOTS_PER_SECTOR == 0) {
+        ret = erase_head_sector();
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "❌ Sector erase failed: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        s_gen++;
+        key = true;
+    }
+
+    if (s_pending == 0) {
+        /* The new sample is the oldest unsent one */
+        s_cursor.slot = s_head;
+        s_cursor.first = false;
+        s_cursor.prev = s_last;
+        s_cursor.prev_valid = s_last_valid && !key;
+    }
+
+    meas_slot_t slots[2];
+    size_t nslots;
+    if (key) {
+        uint8_t body[KEY_BODY_SIZE];
+        key_pack(body, s_gen, sample);
+        slots[0].kind = SLOT_KIND_KEY_A | SLOT_UNSENT;
+        memcpy(slots[0].body, body, SLOT_BODY_SIZE);
+        slots[1].kind = SLOT_KIND_KEY_B | SLOT_UNSENT;
+        memcpy(slots[1].body, body + SLOT_BODY_SIZE, SLOT_BODY_SIZE);
+        nslots = 2;
+    } else {
+        slots[0].kind = SLOT_KIND_DELTA | SLOT_UNSENT;
+        memset(slots[0].body, 0xFF, SLOT_BODY_SIZE);
+        memcpy(slots[0].body, &dt, 2);
+        memcpy(slots[0].body + 2, d, MEAS_FIELD_COUNT);
+        nslots = 1;
+    }
+    for (size_t i = 0; i < nslots; i++) {
+        slots[i].crc = slot_crc(&slots[i]);
+    }
+
+    ret = esp_partition_write(s_part, s_head * MEAS_LOG_SLOT_SIZE, slots, nslots * MEAS_LOG_SLOT_SIZE);
+    s_head = (s_head + nslots) % s_slots;      // a failed write leaves a torn slot that readers skip
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Append failed: %s", esp_err_to_name(ret));
+        s_last_valid = false;
+        return ret;
+    }
+
+    s_last = *sample;
+    s_last_valid = true;
+    s_since_key = key ? 0 : s_since_key + 1;
+    s_pending++;
+    ESP_LOGI(TAG, "💾 Offline sample stored as %s (%u pending)", key ? "keyframe" : "delta", (unsigned)s_pending);
+    return ESP_OK;
+}
+
+size_t meas_log_pending(void)
+{
+    return s_part ? s_pending : 0;
+}
+
+size_t meas_log_encode_batch(uint8_t *buf, size_t len, uint16_t tip_um, size_t *count)
+{
+    *count = 0;
+    if (s_part == NULL || s_pending == 0 || len < MEAS_LOG_BATCH_HEADER_SIZE + WIRE_KEY_SIZE) return 0;
+
+    uint32_t now = (uint32_t)time(NULL);
+    buf[0] = MEAS_LOG_BATCH_VERSION;
+    memcpy(buf + 2, &now, 4);
+    memcpy(buf + 6, &tip_um, 2);
+    size_t pos = MEAS_LOG_BATCH_HEADER_SIZE;
+
+    meas_reader_t r = s_cursor;
+    meas_sample_t sample, prev;
+    size_t slot, nslots;
+    bool unsent;
+    while (*count < s_pending && *count < UINT8_MAX) {
+        if (!reader_next(&r, &sample, &slot, &nslots, &unsent)) break;
+
+        uint16_t dt;
+        int8_t d[MEAS_FIELD_COUNT];
+        if (*count > 0 && delta_encode(&prev, &sample, &dt, d)) {
+            if (pos + WIRE_DELTA_SIZE > len) break;
+            buf[pos] = WIRE_KIND_DELTA;
+            memcpy(buf + pos + 1, &dt, 2);
+            memcpy(buf + pos + 3, d, MEAS_FIELD_COUNT);
+            pos += WIRE_DELTA_SIZE;
+        } else {
+            if (pos + WIRE_KEY_SIZE > len) break;
+            buf[pos] = sample.boot == s_boot ? WIRE_KIND_KEY : WIRE_KIND_KEY_OLD_BOOT;
+            memcpy(buf + pos + 1, &sample.time_s, 4);
+            memcpy(buf + pos + 5, sample.v, 2 * MEAS_FIELD_COUNT);
+            pos += WIRE_KEY_SIZE;
+        }
+        prev = sample;
+        (*count)++;
+    }
+    buf[1] = (uint8_t)*count;
+    return *count ? pos : 0;
+}
+
+esp_err_t meas_log_mark_sent(size_t count)
+{
+    if (s_part == NULL) return ESP_ERR_INVALID_STATE;
+
+    meas_sample_t sample;
+    size_t slot, nslots;
+    bool unsent;
+    while (count > 0 && s_pending > 0 && reader_next(&s_cursor, &sample, &slot, &nslots, &unsent)) {
+        /* Clearing a bit needs no erase; the CRC does not cover it */
+        meas_slot_t slots[2];
+        if (esp_partition_read(s_part, slot * MEAS_LOG_SLOT_SIZE, slots, nslots * MEAS_LOG_SLOT_SIZE) == ESP_OK) {
+            for (size_t i = 0; i < nslots; i++) {
+                slots[i].kind &= ~SLOT_UNSENT;
+            }
+            esp_partition_write(s_part, slot * MEAS_LOG_SLOT_SIZE, slots, nslots * MEAS_LOG_SLOT_SIZE);
+        }
+        s_pending--;
+        count--;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,106 @@
+/*
+ * Offline measurement log
+ * While the device is off the network every acquisition cycle is appended to
+ * a ring of 16-byte slots in a raw partition ("meas_log"). A sample is stored
+ * as a keyframe (two slots, absolute values) or as a delta against the
+ * previous sample (one slot, int8 per field); every sector starts with a
+ * keyframe, so erasing the oldest sector when the ring wraps never breaks the
+ * chain. Samples are drained in batches after a rejoin and marked sent in
+ * place (one bit cleared, no erase). Zigbee task only.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEAS_LOG_PARTITION_LABEL        "meas_log"
+#define MEAS_LOG_PARTITION_SUBTYPE      0x41    // custom data subtype, see partitions.csv
+#define MEAS_LOG_SECTOR_SIZE            4096
+#define MEAS_LOG_SLOT_SIZE              16
+#define MEAS_LOG_KEYFRAME_INTERVAL      32      // samples between forced keyframes
+#define MEAS_LOG_BATCH_VERSION          2
+#define MEAS_LOG_BATCH_HEADER_SIZE      8
+#define MEAS_LOG_ABSENT                 INT16_MIN   // field not measured
+
+/* Sample fields, all int16 in log units */
+typedef enum {
+    MEAS_FIELD_TEMPERATURE = 0,     // 0.1 °C
+    MEAS_FIELD_HUMIDITY,            // 0.1 %RH
+    MEAS_FIELD_PRESSURE,            // 0.1 hPa
+    MEAS_FIELD_DS18B20,             // 0.1 °C, first probe
+    MEAS_FIELD_WIND_SPEED,          // 0.1 m/s
+    MEAS_FIELD_WIND_DIR,            // 1°, 0-359
+    MEAS_FIELD_LIGHT,               // ZCL illuminance MeasuredValue / 32
+    MEAS_FIELD_BATTERY,             // mV
+    MEAS_FIELD_RAIN_TIPS,           // total tips, modulo 32768
+    MEAS_FIELD_COUNT,
+} meas_field_t;
+
+typedef struct {
+    uint32_t time_s;                // time() when the sample was taken (seconds since that boot)
+    uint16_t boot;                  // boot it was taken in, set by meas_log_append(); 0 = before boots were logged
+    int16_t v[MEAS_FIELD_COUNT];    // MEAS_LOG_ABSENT if not measured
+} meas_sample_t;
+
+/**
+ * @brief Find the partition and recover head, unsent cursor and pending count
+ *
+ * Also numbers this boot: one more than the boot of the newest sample logged.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the partition table has no meas_log entry
+ */
+esp_err_t meas_log_init(void);
+
+/**
+ * @brief Append one sample, as a delta if it fits, otherwise as a keyframe
+ *
+ * When the ring is full the oldest sector is erased, unsent samples included.
+ * The stored copy gets this boot's number whatever sample->boot holds.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_STATE before meas_log_init() succeeded
+ */
+esp_err_t meas_log_append(const meas_sample_t *sample);
+
+/**
+ * @brief Number of samples not yet marked sent
+ */
+size_t meas_log_pending(void);
+
+/**
+ * @brief Encode the oldest unsent samples as one backfill batch
+ *
+ * Batch layout (little endian): u8 version, u8 sample count, u32 device time
+ * now, u16 rain tip size in µm, then per sample u8 kind (0 = key: u32 time +
+ * int16 per field, 1 = delta: u16 seconds since the previous sample + int8 per
+ * field, INT8_MIN = absent, 2 = key taken before the last reboot). The first
+ * sample of a batch is always a key. time() restarts at every boot, so only
+ * samples of this boot can be placed against the device time; a kind 2 key
+ * and the deltas after it carry the times of an earlier boot.
+ * Nothing is marked sent until meas_log_mark_sent().
+ *
+ * @param buf Output buffer
+ * @param len Buffer size, at least MEAS_LOG_BATCH_HEADER_SIZE plus one key
+ * @param tip_um Rain gauge tip size in µm, copied into the header
+ * @param count Receives the number of samples encoded (0 if nothing is pending)
+ * @return Bytes written to buf
+ */
+size_t meas_log_encode_batch(uint8_t *buf, size_t len, uint16_t tip_um, size_t *count);
+
+/**
+ * @brief Mark the oldest unsent samples as sent
+ *
+ * @param count Samples to mark (as returned by meas_log_encode_batch())
+ * @return ESP_OK on success
+ */
+esp_err_t meas_log_mark_sent(size_t count);
+
+#ifdef __cplusplus
+}
+#endif
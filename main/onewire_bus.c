@@ -0,0 +1,425 @@
+/*
+ * 1-Wire Bus Driver (RMT backed)
+ * One TX channel drives the open-drain pin, one RX channel on the same pin
+ * (loop-back) records what the bus actually did. Slot timing is generated by
+ * hardware at 1 tick = 1 us, so interrupts can no longer stretch a slot.
+ */
+
+#include <string.h>
+#include "onewire_bus.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "driver/rmt_tx.h"
+#include "driver/rmt_rx.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+static const char *TAG = "ONEWIRE";
+
+/* Slot timing in us (1 MHz RMT resolution) */
+#define ONEWIRE_RMT_RESOLUTION_HZ       1000000
+#define ONEWIRE_RESET_PULSE_US          500     // >= 480 us
+#define ONEWIRE_RESET_WAIT_US           200     // presence pulse: 15-60 us wait + 60-240 us low
+#define ONEWIRE_PRESENCE_WAIT_MIN_US    15
+#define ONEWIRE_PRESENCE_LOW_MIN_US     60
+#define ONEWIRE_SLOT_START_US           2       // master low pulse opening every slot
+#define ONEWIRE_SLOT_BIT_US             60
+#define ONEWIRE_SLOT_RECOVERY_US        2
+#define ONEWIRE_SLOT_SAMPLE_US          15      // low longer than this = device sent 0
+#define ONEWIRE_SLOT_IDLE_US            100     // > longest high phase inside a slot train
+
+/* One RMT block is 48 symbols on ESP32-H2 and every bit is one symbol, so reads
+ * are split into chunks that fit a single RX block (no ping-pong needed). */
+#define ONEWIRE_RMT_MEM_SYMBOLS          48
+#define ONEWIRE_RX_CHUNK_BYTES          4
+#define ONEWIRE_TIMEOUT_MS              50
+
+static const rmt_symbol_word_t onewire_bit0_symbol = {
+    .level0 = 0, .duration0 = ONEWIRE_SLOT_START_US + ONEWIRE_SLOT_BIT_US,
+    .level1 = 1, .duration1 = ONEWIRE_SLOT_RECOVERY_US,
+};
+
+static const rmt_symbol_word_t onewire_bit1_symbol = {
+    .level0 = 0, .duration0 = ONEWIRE_SLOT_START_US,
+    .level1 = 1, .duration1 = ONEWIRE_SLOT_BIT_US + ONEWIRE_SLOT_RECOVERY_US,
+};
+
+static const rmt_symbol_word_t onewire_reset_symbol = {
+    .level0 = 0, .duration0 = ONEWIRE_RESET_PULSE_US,
+    .level1 = 1, .duration1 = ONEWIRE_RESET_WAIT_US,
+};
+
+static const rmt_transmit_config_t onewire_tx_config = {
+    .loop_count = 0,
+    .flags.eot_level = 1,   // release the bus (pull-up) after every transmission
+};
+
+/* RX ends once the bus idles longer than signal_range_max_ns. A reset needs the
+ * long window; read slots never stay high longer than one slot, so a short
+ * window ends the capture ~100 us after the last slot instead of ~700 us. */
+static const rmt_receive_config_t onewire_rx_reset_config = {
+    .signal_range_min_ns = 1000000000 / ONEWIRE_RMT_RESOLUTION_HZ,
+    .signal_range_max_ns = (ONEWIRE_RESET_PULSE_US + ONEWIRE_RESET_WAIT_US) * 1000,
+};
+
+static const rmt_receive_config_t onewire_rx_slot_config = {
+    .signal_range_min_ns = 1000000000 / ONEWIRE_RMT_RESOLUTION_HZ,
+    .signal_range_max_ns = ONEWIRE_SLOT_IDLE_US * 1000,
+};
+
+static rmt_channel_handle_t tx_channel = NULL;
+static rmt_channel_handle_t rx_channel = NULL;
+static rmt_encoder_handle_t bytes_encoder = NULL;
+static rmt_encoder_handle_t copy_encoder = NULL;
+static QueueHandle_t rx_queue = NULL;
+static rmt_symbol_word_t rx_symbols[ONEWIRE_RMT_MEM_SYMBOLS];
+static bool bus_enabled = false;
+
+static bool IRAM_ATTR onewire_rx_done_cb(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata,
+                                         void *user_data)
+{
+    BaseType_t task_woken = pdFALSE;
+    xQueueSendFromISR((QueueHandle_t)user_data, edata, &task_woken);
+    return task_woken == pdTRUE;
+}
+
+esp_err_t onewire_bus_init(gpio_num_t gpio)
+{
+    if (tx_channel) {
+        return ESP_OK;
+    }
+
+    /* RX first, then TX with loop-back so both share the pin */
+    rmt_rx_channel_config_t rx_cfg = {
+        .gpio_num = gpio,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = ONEWIRE_RMT_RESOLUTION_HZ,
+        .mem_block_symbols = ONEWIRE_RMT_MEM_SYMBOLS,
+    };
+    esp_err_t ret = rmt_new_rx_channel(&rx_cfg, &rx_channel);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create RMT RX channel: %s", esp_err_to_name(ret));
+        goto err;
+    }
+
+    rmt_tx_channel_config_t tx_cfg = {
+        .gpio_num = gpio,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = ONEWIRE_RMT_RESOLUTION_HZ,
+        .mem_block_symbols = ONEWIRE_RMT_MEM_SYMBOLS,
+        .trans_queue_depth = 4,
+        .flags.io_loop_back = true,   // TX and RX on the same GPIO
+        .flags.io_od_mode = true,     // open-drain, external 4.7k pull-up
+    };
+    ret = rmt_new_tx_channel(&tx_cfg, &tx_channel);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create RMT TX channel: %s", esp_err_to_name(ret));
+        goto err;
+    }
+
+    rmt_bytes_encoder_config_t bytes_cfg = {
+        .bit0 = onewire_bit0_symbol,
+        .bit1 = onewire_bit1_symbol,
+        .flags.msb_first = 0,
+    };
+    ret = rmt_new_bytes_encoder(&bytes_cfg, &bytes_encoder);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create bytes encoder: %s", esp_err_to_name(ret));
+        goto err;
+    }
+
+    rmt_copy_encoder_config_t copy_cfg = {};
+    ret = rmt_new_copy_encoder(&copy_cfg, &copy_encoder);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create copy encoder: %s", esp_err_to_name(ret));
+        goto err;
+    }
+
+    rx_queue = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
+    if (!rx_queue) {
+        ret = ESP_ERR_NO_MEM;
+        goto err;
+    }
+
+    rmt_rx_event_callbacks_t cbs = {
+        .on_recv_done = onewire_rx_done_cb,
+    };
+    ret = rmt_rx_register_event_callbacks(rx_channel, &cbs, rx_queue);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register RX callback: %s", esp_err_to_name(ret));
+        goto err;
+    }
+
+    ESP_LOGI(TAG, "1-Wire bus on GPIO%d (RMT TX+RX, open-drain loop-back)", gpio);
+    return ESP_OK;
+
+err:
+    onewire_bus_deinit();
+    return ret;
+}
+
+esp_err_t onewire_bus_deinit(void)
+{
+    onewire_bus_end();
+    if (bytes_encoder) {
+        rmt_del_encoder(bytes_encoder);
+        bytes_encoder = NULL;
+    }
+    if (copy_encoder) {
+        rmt_del_encoder(copy_encoder);
+        copy_encoder = NULL;
+    }
+    if (tx_channel) {
+        rmt_del_channel(tx_channel);
+        tx_channel = NULL;
+    }
+    if (rx_channel) {
+        rmt_del_channel(rx_channel);
+        rx_channel = NULL;
+    }
+    if (rx_queue) {
+        vQueueDelete(rx_queue);
+        rx_queue = NULL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t onewire_bus_begin(void)
+{
+    if (!tx_channel) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (bus_enabled) {
+        return ESP_OK;
+    }
+    esp_err_t ret = rmt_enable(rx_channel);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = rmt_enable(tx_channel);
+    if (ret != ESP_OK) {
+        rmt_disable(rx_channel);
+        return ret;
+    }
+    bus_enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t onewire_bus_end(void)
+{
+    if (!bus_enabled) {
+        return ESP_OK;
+    }
+    /* Disabling drops the RMT driver's PM lock, allowing light sleep again */
+    rmt_disable(tx_channel);
+    rmt_disable(rx_channel);
+    bus_enabled = false;
+    return ESP_OK;
+}
+
+/* Arm RX, send symbols with the given encoder and wait for the captured waveform */
+static esp_err_t onewire_transceive(rmt_encoder_handle_t encoder, const void *data, size_t size,
+                                    const rmt_receive_config_t *rx_config, rmt_rx_done_event_data_t *evt)
+{
+    if (!bus_enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xQueueReset(rx_queue);
+    esp_err_t ret = rmt_receive(rx_channel, rx_symbols, sizeof(rx_symbols), rx_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = rmt_transmit(tx_channel, encoder, data, size, &onewire_tx_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    /* CPU idles here while the slots are on the wire */
+    if (xQueueReceive(rx_queue, evt, pdMS_TO_TICKS(ONEWIRE_TIMEOUT_MS)) != pdPASS) {
+        rmt_tx_wait_all_done(tx_channel, ONEWIRE_TIMEOUT_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+    return rmt_tx_wait_all_done(tx_channel, ONEWIRE_TIMEOUT_MS);
+}
+
+esp_err_t onewire_bus_reset(bool *present)
+{
+    rmt_rx_done_event_data_t evt;
+    *present = false;
+    esp_err_t ret = onewire_transceive(copy_encoder, &onewire_reset_symbol, sizeof(onewire_reset_symbol),
+                                       &onewire_rx_reset_config, &evt);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    /* Expected: [reset low | release high] [presence low | ...] */
+    const rmt_symbol_word_t *sym = evt.received_symbols;
+    if (evt.num_symbols >= 2) {
+        if (sym[0].level1 == 1) {
+            *present = sym[0].duration1 > ONEWIRE_PRESENCE_WAIT_MIN_US &&
+                       sym[1].duration0 > ONEWIRE_PRESENCE_LOW_MIN_US;
+        } else {
+            *present = sym[0].duration0 > ONEWIRE_PRESENCE_WAIT_MIN_US &&
+                       sym[1].duration1 > ONEWIRE_PRESENCE_LOW_MIN_US;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t onewire_bus_write_bytes(const uint8_t *buf, size_t len)
+{
+    if (!bus_enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = rmt_transmit(tx_channel, bytes_encoder, buf, len, &onewire_tx_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return rmt_tx_wait_all_done(tx_channel, ONEWIRE_TIMEOUT_MS);
+}
+
+esp_err_t onewire_bus_read_bytes(uint8_t *buf, size_t len)
+{
+    static const uint8_t read_slots[ONEWIRE_RX_CHUNK_BYTES] = {0xFF, 0xFF, 0xFF, 0xFF};
+    rmt_rx_done_event_data_t evt;
+
+    while (len > 0) {
+        size_t chunk = len < ONEWIRE_RX_CHUNK_BYTES ? len : ONEWIRE_RX_CHUNK_BYTES;
+
+        /* Writing 1s opens read slots; a device sending 0 stretches the low phase */
+        esp_err_t ret = onewire_transceive(bytes_encoder, read_slots, chunk, &onewire_rx_slot_config, &evt);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (evt.num_symbols < chunk * 8) {
+            ESP_LOGW(TAG, "Short read: %u symbols for %u bytes", (unsigned)evt.num_symbols, (unsigned)chunk);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        memset(buf, 0, chunk);
+        for (size_t i = 0; i < chunk * 8; i++) {
+            if (evt.received_symbols[i].duration0 <= ONEWIRE_SLOT_SAMPLE_US) {
+                buf[i / 8] |= 1 << (i % 8);
+            }
+        }
+        buf += chunk;
+        len -= chunk;
+    }
+    return ESP_OK;
+}
+
+esp_err_t onewire_bus_write_bit(uint8_t bit)
+{
+    if (!bus_enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    const rmt_symbol_word_t *sym = bit ? &onewire_bit1_symbol : &onewire_bit0_symbol;
+    esp_err_t ret = rmt_transmit(tx_channel, copy_encoder, sym, sizeof(*sym), &onewire_tx_config);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return rmt_tx_wait_all_done(tx_channel, ONEWIRE_TIMEOUT_MS);
+}
+
+esp_err_t onewire_bus_read_bit(uint8_t *bit)
+{
+    rmt_rx_done_event_data_t evt;
+    esp_err_t ret = onewire_transceive(copy_encoder, &onewire_bit1_symbol, sizeof(onewire_bit1_symbol),
+                                       &onewire_rx_slot_config, &evt);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (evt.num_symbols < 1) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *bit = evt.received_symbols[0].duration0 <= ONEWIRE_SLOT_SAMPLE_US ? 1 : 0;
+    return ESP_OK;
+}
+
+esp_err_t onewire_bus_search(uint64_t *roms, size_t max_roms, size_t *found)
+{
+    uint64_t rom = 0;
+    int last_discrepancy = -1;
+    *found = 0;
+
+    /* Maxim AN187 binary tree walk: each pass follows the previous path up to
+     * the last discrepancy, then takes the 1 branch there and 0 after it */
+    do {
+        bool present = false;
+        esp_err_t ret = onewire_bus_reset(&present);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (!present) {
+            break;
+        }
+        const uint8_t cmd = ONEWIRE_CMD_SEARCH_ROM;
+        ret = onewire_bus_write_bytes(&cmd, 1);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+
+        int discrepancy = -1;
+        for (int bit = 0; bit < 64; bit++) {
+            uint8_t id_bit = 0, cmp_bit = 0;
+            ret = onewire_bus_read_bit(&id_bit);
+            if (ret == ESP_OK) {
+                ret = onewire_bus_read_bit(&cmp_bit);
+            }
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            if (id_bit && cmp_bit) {
+                ESP_LOGW(TAG, "Search aborted at bit %d (no device answered)", bit);
+                return *found ? ESP_OK : ESP_ERR_NOT_FOUND;
+            }
+
+            uint8_t dir;
+            if (id_bit != cmp_bit) {
+                dir = id_bit;                       // all remaining devices agree
+            } else if (bit < last_discrepancy) {
+                dir = (rom >> bit) & 0x01;          // replay previous path
+            } else {
+                dir = (bit == last_discrepancy);    // take the 1 branch this time
+            }
+            if (id_bit == cmp_bit && dir == 0) {
+                discrepancy = bit;
+            }
+
+            rom = dir ? (rom | (1ULL << bit)) : (rom & ~(1ULL << bit));
+            ret = onewire_bus_write_bit(dir);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+
+        uint8_t rom_bytes[8];
+        for (int i = 0; i < 8; i++) {
+            rom_bytes[i] = (uint8_t)(rom >> (8 * i));
+        }
+        if (onewire_crc8(0, rom_bytes, sizeof(rom_bytes)) == 0) {
+            ESP_LOGI(TAG, "Found device %016llX", rom);
+            roms[(*found)++] = rom;
+        } else {
+            ESP_LOGW(TAG, "ROM %016llX failed CRC - skipped", rom);
+        }
+        last_discrepancy = discrepancy;
+    } while (last_discrepancy >= 0 && *found < max_roms);
+
+    return ESP_OK;
+}
+
+uint8_t onewire_crc8(uint8_t crc, const uint8_t *buf, size_t len)
+{
+    while (len--) {
+        uint8_t byte = *buf++;
+        for (int i = 0; i < 8; i++) {
+            uint8_t mix = (crc ^ byte) & 0x01;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            byte >>= 1;
+        }
+    }
+    return crc;
+}
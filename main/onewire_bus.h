@@ -0,0 +1,129 @@
+/*
+ * 1-Wire Bus Driver (RMT backed)
+ * Generates reset/read/write time slots with the RMT peripheral instead of
+ * bit-banging, so slot timing is immune to interrupts and the CPU blocks on a
+ * queue (idle) while a transaction is on the wire.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ROM commands */
+#define ONEWIRE_CMD_SEARCH_ROM      0xF0
+#define ONEWIRE_CMD_READ_ROM        0x33
+#define ONEWIRE_CMD_MATCH_ROM       0x55
+#define ONEWIRE_CMD_SKIP_ROM        0xCC
+
+/**
+ * @brief Initialize the 1-Wire bus on a GPIO
+ *
+ * Creates one RMT RX and one RMT TX channel on the same open-drain pin
+ * (loop-back). The bus needs an external pull-up. Channels are left disabled
+ * until onewire_bus_begin() so their PM lock does not block light sleep.
+ *
+ * @param gpio Bus GPIO
+ * @return ESP_OK on success
+ */
+esp_err_t onewire_bus_init(gpio_num_t gpio);
+
+/**
+ * @brief Release the RMT channels and encoders
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t onewire_bus_deinit(void);
+
+/**
+ * @brief Enable the RMT channels for a transaction
+ *
+ * Every bus operation must be wrapped in onewire_bus_begin()/onewire_bus_end().
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t onewire_bus_begin(void);
+
+/**
+ * @brief Disable the RMT channels after a transaction
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t onewire_bus_end(void);
+
+/**
+ * @brief Send a reset pulse and sample the presence pulse
+ *
+ * @param present Set to true if at least one device answered
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the RX channel saw nothing
+ */
+esp_err_t onewire_bus_reset(bool *present);
+
+/**
+ * @brief Write bytes (LSB first)
+ *
+ * @param buf Data to write
+ * @param len Number of bytes
+ * @return ESP_OK on success
+ */
+esp_err_t onewire_bus_write_bytes(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Read bytes (LSB first)
+ *
+ * @param buf Buffer to fill
+ * @param len Number of bytes
+ * @return ESP_OK on success
+ */
+esp_err_t onewire_bus_read_bytes(uint8_t *buf, size_t len);
+
+/**
+ * @brief Write a single bit
+ *
+ * @param bit Bit value (0 or 1)
+ * @return ESP_OK on success
+ */
+esp_err_t onewire_bus_write_bit(uint8_t bit);
+
+/**
+ * @brief Read a single time slot
+ *
+ * @param bit Sampled bit value (0 or 1)
+ * @return ESP_OK on success
+ */
+esp_err_t onewire_bus_read_bit(uint8_t *bit);
+
+/**
+ * @brief Enumerate every device on the bus (SEARCH ROM)
+ *
+ * ROM codes are returned as 64-bit values with the family code in the low
+ * byte, i.e. the order they are sent on the wire. Codes failing CRC are
+ * skipped. Must be called between onewire_bus_begin()/onewire_bus_end().
+ *
+ * @param roms Array receiving the ROM codes
+ * @param max_roms Capacity of roms
+ * @param found Number of ROM codes written
+ * @return ESP_OK on success (found may be 0 if nobody answered)
+ */
+esp_err_t onewire_bus_search(uint64_t *roms, size_t max_roms, size_t *found);
+
+/**
+ * @brief Dallas/Maxim CRC8 (x^8 + x^5 + x^4 + 1)
+ *
+ * @param crc Initial CRC (0)
+ * @param buf Data
+ * @param len Number of bytes
+ * @return Updated CRC; 0 when run over data followed by its CRC byte
+ */
+uint8_t onewire_crc8(uint8_t crc, const uint8_t *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,374 @@
+/*
+ * Streaming decoder for compressed / delta OTA images
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ota_decoder.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "OTA_DECODER";
+
+#define OTA_DECODER_OUT_BUF_SIZE    256     // decoded bytes batched per sink call
+#define OTA_DECODER_COPY_BUF_SIZE   256     // base partition read chunk (delta COPY)
+
+typedef enum {
+    HS_TAG,
+    HS_LITERAL,
+    HS_BR_INDEX,
+    HS_BR_COUNT,
+} hs_state_t;
+
+typedef enum {
+    DELTA_OP,
+    DELTA_ARGS,
+    DELTA_INSERT,
+} delta_state_t;
+
+static ota_decoder_sink_t s_sink = NULL;
+static uint8_t *s_window = NULL;            // heatshrink LZ window (2^window_bits)
+static uint8_t *s_out = NULL;               // pending decoded bytes
+static uint8_t *s_copy = NULL;              // base partition read buffer
+static size_t s_out_len = 0;
+
+static uint8_t s_hdr[OTA_DECODER_HEADER_SIZE];
+static size_t s_hdr_len = 0;
+static uint8_t s_method = 0;
+static uint8_t s_window_bits = 0;
+static uint8_t s_lookahead_bits = 0;
+static uint32_t s_out_size = 0;
+static uint32_t s_base_size = 0;
+static const esp_partition_t *s_base = NULL;
+
+static uint32_t s_in_total = 0;
+static uint32_t s_out_total = 0;
+static bool s_done = false;
+
+/* heatshrink bit reader */
+static const uint8_t *s_in = NULL;
+static size_t s_in_len = 0;
+static uint8_t s_cur_byte = 0;
+static uint8_t s_bit_mask = 0;
+static uint16_t s_bit_acc = 0;
+static uint8_t s_bit_count = 0;
+static hs_state_t s_hs_state = HS_TAG;
+static uint16_t s_br_offset = 0;
+static uint32_t s_window_pos = 0;
+
+/* delta interpreter */
+static delta_state_t s_delta_state = DELTA_OP;
+static uint8_t s_delta_op = 0;
+static uint8_t s_delta_args[8];
+static uint8_t s_delta_args_len = 0;
+static uint8_t s_delta_args_need = 0;
+static uint32_t s_insert_remaining = 0;
+
+static uint32_t read_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static esp_err_t out_flush(void)
+{
+    if (s_out_len == 0) return ESP_OK;
+    esp_err_t ret = s_sink(s_out, s_out_len);
+    s_out_len = 0;
+    return ret;
+}
+
+/* Append decoded image bytes; never goes past the size announced in the header */
+static esp_err_t out_write(const uint8_t *data, size_t len)
+{
+    if (len > s_out_size - s_out_total) {
+        ESP_LOGE(TAG, "Decoded data exceeds image size (%lu bytes)", (unsigned long)s_out_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    while (len > 0) {
+        size_t chunk = OTA_DECODER_OUT_BUF_SIZE - s_out_len;
+        if (chunk > len) chunk = len;
+        memcpy(s_out + s_out_len, data, chunk);
+        s_out_len += chunk;
+        s_out_total += chunk;
+        data += chunk;
+        len -= chunk;
+        if (s_out_len == OTA_DECODER_OUT_BUF_SIZE) {
+            esp_err_t ret = out_flush();
+            if (ret != ESP_OK) return ret;
+        }
+    }
+    if (s_out_total == s_out_size) {
+        s_done = true;
+        return out_flush();
+    }
+    return ESP_OK;
+}
+
+static esp_err_t delta_copy(uint32_t offset, uint32_t len)
+{
+    if (offset > s_base_size || len > s_base_size - offset) {
+        ESP_LOGE(TAG, "COPY outside base image (0x%lx + %lu)", (unsigned long)offset, (unsigned long)len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    while (len > 0) {
+        size_t chunk = len > OTA_DECODER_COPY_BUF_SIZE ? OTA_DECODER_COPY_BUF_SIZE : len;
+        esp_err_t ret = esp_partition_read(s_base, offset, s_copy, chunk);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Base read at 0x%lx failed: %s", (unsigned long)offset, esp_err_to_name(ret));
+            return ret;
+        }
+        ret = out_write(s_copy, chunk);
+        if (ret != ESP_OK) return ret;
+        offset += chunk;
+        len -= chunk;
+    }
+    return ESP_OK;
+}
+
+/* One byte of the decompressed instruction stream */
+static esp_err_t delta_put(uint8_t b)
+{
+    switch (s_delta_state) {
+        case DELTA_OP:
+            s_delta_op = b;
+            s_delta_args_len = 0;
+            if (b == OTA_DECODER_DELTA_OP_COPY) {
+                s_delta_args_need = 8;
+            } else if (b == OTA_DECODER_DELTA_OP_INSERT) {
+                s_delta_args_need = 4;
+            } else {
+                ESP_LOGE(TAG, "Unknown delta op 0x%02x at output %lu", b, (unsigned long)s_out_total);
+                return ESP_ERR_INVALID_ARG;
+            }
+            s_delta_state = DELTA_ARGS;
+            return ESP_OK;
+
+        case DELTA_ARGS:
+            s_delta_args[s_delta_args_len++] = b;
+            if (s_delta_args_len < s_delta_args_need) return ESP_OK;
+            s_delta_state = DELTA_OP;
+            if (s_delta_op == OTA_DECODER_DELTA_OP_COPY) {
+                return delta_copy(read_le32(s_delta_args), read_le32(s_delta_args + 4));
+            }
+            s_insert_remaining = read_le32(s_delta_args);
+            if (s_insert_remaining > 0) s_delta_state = DELTA_INSERT;
+            return ESP_OK;
+
+        case DELTA_INSERT:
+            if (--s_insert_remaining == 0) s_delta_state = DELTA_OP;
+            return out_write(&b, 1);
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+/* One byte out of the LZ stage */
+static esp_err_t hs_output(uint8_t b)
+{
+    s_window[s_window_pos & ((1U << s_window_bits) - 1)] = b;
+    s_window_pos++;
+    return s_method == OTA_DECODER_METHOD_DELTA ? delta_put(b) : out_write(&b, 1);
+}
+
+/* Collect count bits MSB first; false if the input ran out (progress is kept) */
+static bool hs_get_bits(uint8_t count, uint16_t *value)
+{
+    while (s_bit_count < count) {
+        if (s_bit_mask == 0) {
+            if (s_in_len == 0) return false;
+            s_cur_byte = *s_in++;
+            s_in_len--;
+            s_bit_mask = 0x80;
+        }
+        s_bit_acc = (s_bit_acc << 1) | ((s_cur_byte & s_bit_mask) ? 1 : 0);
+        s_bit_mask >>= 1;
+        s_bit_count++;
+    }
+    *value = s_bit_acc;
+    s_bit_acc = 0;
+    s_bit_count = 0;
+    return true;
+}
+
+static esp_err_t hs_decode(void)
+{
+    uint16_t bits;
+    esp_err_t ret = ESP_OK;
+    uint32_t mask = (1U << s_window_bits) - 1;
+
+    while (!s_done) {
+        switch (s_hs_state) {
+            case HS_TAG:
+                if (!hs_get_bits(1, &bits)) return ESP_OK;
+                s_hs_state = bits ? HS_LITERAL : HS_BR_INDEX;
+                break;
+
+            case HS_LITERAL:
+                if (!hs_get_bits(8, &bits)) return ESP_OK;
+                s_hs_state = HS_TAG;
+                ret = hs_output((uint8_t)bits);
+                break;
+
+            case HS_BR_INDEX:
+                if (!hs_get_bits(s_window_bits, &bits)) return ESP_OK;
+                s_br_offset = bits + 1;
+                s_hs_state = HS_BR_COUNT;
+                break;
+
+            case HS_BR_COUNT:
+                if (!hs_get_bits(s_lookahead_bits, &bits)) return ESP_OK;
+                s_hs_state = HS_TAG;
+                for (uint16_t i = 0; i <= bits && ret == ESP_OK && !s_done; i++) {
+                    ret = hs_output(s_window[(s_window_pos - s_br_offset) & mask]);
+                }
+                break;
+        }
+        if (ret != ESP_OK) return ret;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_header(void)
+{
+    s_method = s_hdr[5];
+    s_window_bits = s_hdr[6];
+    s_lookahead_bits = s_hdr[7];
+    s_out_size = read_le32(s_hdr + 8);
+    s_base_size = read_le32(s_hdr + 12);
+    uint32_t base_crc = read_le32(s_hdr + 16);
+
+    if (s_hdr[4] != OTA_DECODER_VERSION ||
+        (s_method != OTA_DECODER_METHOD_FULL && s_method != OTA_DECODER_METHOD_DELTA) ||
+        s_window_bits < 4 || s_window_bits > OTA_DECODER_MAX_WINDOW_BITS ||
+        s_lookahead_bits < 3 || s_lookahead_bits >= s_window_bits || s_out_size == 0) {
+        ESP_LOGE(TAG, "Unsupported image header (v%u, method %u, W%u L%u, %lu bytes)",
+                 s_hdr[4], s_method, s_window_bits, s_lookahead_bits, (unsigned long)s_out_size);
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    if (s_method == OTA_DECODER_METHOD_DELTA) {
+        s_base = esp_ota_get_running_partition();
+        if (s_base == NULL || s_base_size == 0 || s_base_size > s_base->size) {
+            ESP_LOGE(TAG, "Delta base (%lu bytes) does not fit the running partition", (unsigned long)s_base_size);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint32_t crc = 0;
+        for (uint32_t off = 0; off < s_base_size; off += OTA_DECODER_COPY_BUF_SIZE) {
+            size_t chunk = s_base_size - off;
+            if (chunk > OTA_DECODER_COPY_BUF_SIZE) chunk = OTA_DECODER_COPY_BUF_SIZE;
+            esp_err_t ret = esp_partition_read(s_base, off, s_copy, chunk);
+            if (ret != ESP_OK) return ret;
+            crc = esp_rom_crc32_le(crc, s_copy, chunk);
+        }
+        if (crc != base_crc) {
+            ESP_LOGE(TAG, "Running image is not the delta base (CRC 0x%08lx, expected 0x%08lx)",
+                     (unsigned long)crc, (unsigned long)base_crc);
+            return ESP_ERR_INVALID_CRC;
+        }
+        ESP_LOGI(TAG, "📦 Delta image: %lu bytes from base %s (%lu bytes, CRC OK)",
+                 (unsigned long)s_out_size, s_base->label, (unsigned long)s_base_size);
+    } else {
+        ESP_LOGI(TAG, "📦 Compressed image: %lu bytes (W%u L%u)",
+                 (unsigned long)s_out_size, s_window_bits, s_lookahead_bits);
+    }
+    return ESP_OK;
+}
+
+static void ota_decoder_release(void)
+{
+    free(s_window);
+    free(s_out);
+    free(s_copy);
+    s_window = NULL;
+    s_out = NULL;
+    s_copy = NULL;
+    s_sink = NULL;
+}
+
+bool ota_decoder_is_compressed(const uint8_t *data, size_t len)
+{
+    return len >= 4 && memcmp(data, OTA_DECODER_MAGIC, 4) == 0;
+}
+
+esp_err_t ota_decoder_begin(ota_decoder_sink_t sink)
+{
+    if (!sink) return ESP_ERR_INVALID_ARG;
+    ota_decoder_release();
+
+    s_window = calloc(1, 1U << OTA_DECODER_MAX_WINDOW_BITS);
+    s_out = malloc(OTA_DECODER_OUT_BUF_SIZE);
+    s_copy = malloc(OTA_DECODER_COPY_BUF_SIZE);
+    if (!s_window || !s_out || !s_copy) {
+        ota_decoder_release();
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_sink = sink;
+    s_out_len = 0;
+    s_hdr_len = 0;
+    s_out_size = 0;
+    s_base = NULL;
+    s_in_total = 0;
+    s_out_total = 0;
+    s_done = false;
+    s_bit_mask = 0;
+    s_bit_acc = 0;
+    s_bit_count = 0;
+    s_hs_state = HS_TAG;
+    s_window_pos = 0;
+    s_delta_state = DELTA_OP;
+    return ESP_OK;
+}
+
+esp_err_t ota_decoder_feed(const uint8_t *data, size_t len)
+{
+    if (!s_sink) return ESP_ERR_INVALID_STATE;
+    s_in_total += len;
+
+    if (s_hdr_len < OTA_DECODER_HEADER_SIZE) {
+        size_t chunk = OTA_DECODER_HEADER_SIZE - s_hdr_len;
+        if (chunk > len) chunk = len;
+        memcpy(s_hdr + s_hdr_len, data, chunk);
+        s_hdr_len += chunk;
+        data += chunk;
+        len -= chunk;
+        if (s_hdr_len < OTA_DECODER_HEADER_SIZE) return ESP_OK;
+
+        esp_err_t ret = parse_header();
+        if (ret != ESP_OK) return ret;
+    }
+
+    s_in = data;
+    s_in_len = len;
+    return hs_decode();
+}
+
+esp_err_t ota_decoder_finish(void)
+{
+    if (!s_sink) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t ret = out_flush();
+    if (ret == ESP_OK && !s_done) {
+        ESP_LOGE(TAG, "Stream ended after %lu of %lu decoded bytes",
+                 (unsigned long)s_out_total, (unsigned long)s_out_size);
+        ret = ESP_ERR_INVALID_SIZE;
+    }
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Decoded %lu -> %lu bytes (%lu%% of the full image over the air)",
+                 (unsigned long)s_in_total, (unsigned long)s_out_total,
+                 (unsigned long)((uint64_t)s_in_total * 100ULL / s_out_total));
+    }
+    ota_decoder_release();
+    return ret;
+}
+
+void ota_decoder_abort(void)
+{
+    ota_decoder_release();
+}
+
+uint32_t ota_decoder_output_size(void)
+{
+    return s_out_size;
+}
@@ -0,0 +1,95 @@
+/*
+ * Streaming decoder for compressed / delta OTA images
+ *
+ * A compressed upgrade image carries a 20-byte "CLMZ" header followed by a
+ * heatshrink (LZSS) bit stream instead of the raw ESP app image:
+ *
+ *   method FULL:  the stream decompresses to the app image itself
+ *   method DELTA: the stream decompresses to COPY/INSERT instructions that
+ *                 rebuild the new image from the running app partition
+ *
+ * Bytes are decoded as they arrive and handed to a sink (ota_writer), so the
+ * only RAM needed is the 1 KB LZ window plus two small scratch buffers. Images
+ * are produced by ota_image_tool.py in the repository root.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_DECODER_MAGIC           "CLMZ"
+#define OTA_DECODER_HEADER_SIZE     20
+#define OTA_DECODER_VERSION         1
+
+#define OTA_DECODER_METHOD_FULL     1   // heatshrink-compressed app image
+#define OTA_DECODER_METHOD_DELTA    2   // heatshrink-compressed delta against the running image
+
+#define OTA_DECODER_DELTA_OP_COPY   0x01    // LE32 base offset, LE32 length
+#define OTA_DECODER_DELTA_OP_INSERT 0x02    // LE32 length, then literal bytes
+
+/* Largest window the decoder allocates (2^10 = 1 KB); the tool defaults to this */
+#define OTA_DECODER_MAX_WINDOW_BITS 10
+
+/**
+ * @brief Receives decoded app image bytes
+ */
+typedef esp_err_t (*ota_decoder_sink_t)(const uint8_t *data, size_t len);
+
+/**
+ * @brief Check whether a buffer starts with a compressed image header
+ *
+ * @param data First bytes of the upgrade image (after the sub-element header)
+ * @param len Number of bytes available
+ * @return true if the CLMZ magic is present
+ */
+bool ota_decoder_is_compressed(const uint8_t *data, size_t len);
+
+/**
+ * @brief Allocate the decoder and start a new stream
+ *
+ * @param sink Called with decoded bytes, in order
+ * @return ESP_OK on success, ESP_ERR_NO_MEM
+ */
+esp_err_t ota_decoder_begin(ota_decoder_sink_t sink);
+
+/**
+ * @brief Decode the next piece of the compressed stream
+ *
+ * The header may be split over several calls. For a delta image the running
+ * app partition is checked against the base CRC32 in the header before any
+ * output is produced.
+ *
+ * @param data Compressed bytes
+ * @param len Number of bytes
+ * @return ESP_OK, ESP_ERR_INVALID_VERSION for a bad header, ESP_ERR_INVALID_CRC
+ *         if the running image is not the delta base, or the sink's error
+ */
+esp_err_t ota_decoder_feed(const uint8_t *data, size_t len);
+
+/**
+ * @brief Check that the complete image was decoded and release the decoder
+ *
+ * @return ESP_OK if the decoded size matches the header, ESP_ERR_INVALID_SIZE otherwise
+ */
+esp_err_t ota_decoder_finish(void);
+
+/**
+ * @brief Release the decoder without checking the result
+ */
+void ota_decoder_abort(void);
+
+/**
+ * @brief Decoded image size from the header (0 until the header is parsed)
+ */
+uint32_t ota_decoder_output_size(void);
+
+#ifdef __cplusplus
+}
+#endif
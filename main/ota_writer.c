@@ -0,0 +1,510 @@
+/*
+ * Buffered OTA image writer
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ota_writer.h"
+#include "ota_decoder.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_app_format.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs.h"
+
+static const char *TAG = "OTA_WRITER";
+
+/* Zigbee OTA upgrade-image sub-element: 16-bit tag + 32-bit length, little endian */
+#define OTA_SUBELEMENT_TAG_UPGRADE_IMAGE    0x0000
+#define OTA_SUBELEMENT_HDR_SIZE             6
+#define OTA_FILE_MAGIC                      0x0BEEF11E  // Zigbee OTA file header identifier
+#define OTA_MAGIC_SCAN_LIMIT                256     // legacy fallback: search the first block for 0xE9
+#define OTA_PROGRESS_STEP_PERCENT           10
+
+#define OTA_CKPT_NVS_NAMESPACE              "storage"
+#define OTA_CKPT_NVS_KEY                    "ota_ckpt"
+#define OTA_CKPT_MAGIC                      0x4F434B31  // "OCK1"
+
+/* Persisted at sector boundaries only, so written is always sector aligned */
+typedef struct {
+    uint32_t magic;
+    ota_writer_image_id_t image;
+    uint32_t partition_addr;
+    uint32_t stream_offset;         // block-stream bytes consumed at the checkpoint
+    uint32_t written;               // flashed app image bytes
+    uint32_t crc32;                 // running CRC32 of the flashed prefix
+    uint32_t element_remaining;     // sub-element bytes still expected after stream_offset
+    uint8_t  element_len_known;
+    uint8_t  reserved[3];
+} ota_checkpoint_t;
+
+static uint8_t *s_stage = NULL;             // OTA_WRITER_SECTOR_SIZE staging buffer
+static size_t s_stage_len = 0;
+static esp_ota_handle_t s_handle = 0;
+static const esp_partition_t *s_partition = NULL;
+static ota_writer_image_id_t s_image;
+static bool s_active = false;
+static bool s_image_found = false;
+static bool s_resume_pending = false;       // first block after a resume not seen yet
+static bool s_decoding = false;             // compressed / delta image, bytes go through ota_decoder
+static uint32_t s_element_remaining = 0;    // app image bytes still expected (0 = unknown length)
+static bool s_element_len_known = false;
+static uint32_t s_stream_pos = 0;           // block-stream bytes consumed so far
+static uint32_t s_crc = 0;
+static int64_t s_start_us = 0;
+static uint32_t s_next_progress = 0;
+static ota_writer_stats_t s_stats;
+
+static bool ota_writer_load_checkpoint(ota_checkpoint_t *ckpt)
+{
+    nvs_handle_t nvs_handle;
+    size_t size = sizeof(*ckpt);
+    if (nvs_open(OTA_CKPT_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = nvs_get_blob(nvs_handle, OTA_CKPT_NVS_KEY, ckpt, &size);
+    nvs_close(nvs_handle);
+    return err == ESP_OK && size == sizeof(*ckpt) && ckpt->magic == OTA_CKPT_MAGIC;
+}
+
+static void ota_writer_save_checkpoint(void)
+{
+    ota_checkpoint_t ckpt = {
+        .magic = OTA_CKPT_MAGIC,
+        .image = s_image,
+        .partition_addr = s_partition->address,
+        .stream_offset = s_stream_pos,
+        .written = s_stats.written,
+        .crc32 = s_crc,
+        .element_remaining = s_element_remaining,
+        .element_len_known = s_element_len_known,
+    };
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_CKPT_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        ESP_LOGW(TAG, "NVS not available - OTA checkpoint not saved");
+        return;
+    }
+    if (nvs_set_blob(nvs_handle, OTA_CKPT_NVS_KEY, &ckpt, sizeof(ckpt)) == ESP_OK) {
+        nvs_commit(nvs_handle);
+        ESP_LOGD(TAG, "Checkpoint: stream %lu, flash %lu", (unsigned long)s_stream_pos, (unsigned long)s_stats.written);
+    }
+    nvs_close(nvs_handle);
+}
+
+void ota_writer_clear_checkpoint(void)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(OTA_CKPT_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_erase_key(nvs_handle, OTA_CKPT_NVS_KEY) == ESP_OK) {
+        nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+}
+
+bool ota_writer_get_checkpoint(ota_writer_image_id_t *image, uint32_t *stream_offset)
+{
+    ota_checkpoint_t ckpt;
+    if (!ota_writer_load_checkpoint(&ckpt)) {
+        return false;
+    }
+    if (image) *image = ckpt.image;
+    if (stream_offset) *stream_offset = ckpt.stream_offset;
+    return true;
+}
+
+static esp_err_t ota_writer_flush(void)
+{
+    if (s_stage_len == 0) return ESP_OK;
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t ret = esp_ota_write(s_handle, s_stage, s_stage_len);
+    s_stats.flash_time_us += esp_timer_get_time() - t0;
+    s_stats.flash_writes++;
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_write(%u bytes) failed: %s", (unsigned)s_stage_len, esp_err_to_name(ret));
+        return ret;
+    }
+    s_crc = esp_rom_crc32_le(s_crc, s_stage, s_stage_len);
+    s_stats.written += s_stage_len;
+
+    bool full_sector = (s_stage_len == OTA_WRITER_SECTOR_SIZE);
+    s_stage_len = 0;
+    /* Decoder state is not persisted, so compressed images are not resumable */
+    if (full_sector && !s_decoding && (s_stats.written / OTA_WRITER_SECTOR_SIZE) % OTA_WRITER_CHECKPOINT_SECTORS == 0) {
+        ota_writer_save_checkpoint();
+    }
+    return ESP_OK;
+}
+
+/* Copy app image bytes into the staging buffer, flushing whenever a sector is
+ * full. Bytes taken straight from the block stream also advance the stream
+ * position and the sub-element count chunk by chunk, so a checkpoint saved by
+ * a flush in the middle of a block records both as of that sector's end. */
+static esp_err_t ota_writer_copy(const uint8_t *data, size_t len, bool from_stream)
+{
+    while (len > 0) {
+        size_t chunk = OTA_WRITER_SECTOR_SIZE - s_stage_len;
+        if (chunk > len) chunk = len;
+        memcpy(s_stage + s_stage_len, data, chunk);
+        s_stage_len += chunk;
+        if (from_stream) {
+            s_stream_pos += chunk;
+            if (s_element_len_known) s_element_remaining -= chunk;
+        }
+        data += chunk;
+        len -= chunk;
+
+        if (s_stage_len == OTA_WRITER_SECTOR_SIZE) {
+            esp_err_t ret = ota_writer_flush();
+            if (ret != ESP_OK) return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+/* ota_decoder sink: decoded bytes, not stream bytes */
+static esp_err_t ota_writer_put(const uint8_t *data, size_t len)
+{
+    return ota_writer_copy(data, len, false);
+}
+
+/* Route upgrade-image bytes to flash, directly or through the decoder */
+static esp_err_t ota_writer_stage(const uint8_t *data, size_t len)
+{
+    uint32_t block_end = s_stream_pos + len;
+
+    if (s_element_len_known && len > s_element_remaining) {
+        len = s_element_remaining;  // trailing sub-elements are not flashed
+    }
+
+    esp_err_t ret;
+    if (s_decoding) {
+        if (s_element_len_known) s_element_remaining -= len;
+        ret = ota_decoder_feed(data, len);
+    } else {
+        ret = ota_writer_copy(data, len, true);
+    }
+    s_stream_pos = block_end;
+    return ret;
+}
+
+/* Upgrade-image sub-element header followed by a raw (0xE9) or compressed (CLMZ) image */
+static bool ota_writer_is_subelement(const uint8_t *data, size_t len)
+{
+    return len > OTA_SUBELEMENT_HDR_SIZE &&
+           (data[0] | (data[1] << 8)) == OTA_SUBELEMENT_TAG_UPGRADE_IMAGE &&
+           (data[OTA_SUBELEMENT_HDR_SIZE] == ESP_IMAGE_HEADER_MAGIC ||
+            ota_decoder_is_compressed(data + OTA_SUBELEMENT_HDR_SIZE, len - OTA_SUBELEMENT_HDR_SIZE));
+}
+
+/* Find where the ESP app image starts in the first block */
+static int ota_writer_find_image(const uint8_t *data, size_t len)
+{
+    if (ota_writer_is_subelement(data, len)) {
+        s_element_remaining = (uint32_t)data[2] | ((uint32_t)data[3] << 8) |
+                              ((uint32_t)data[4] << 16) | ((uint32_t)data[5] << 24);
+        s_element_len_known = s_element_remaining > 0;
+        s_decoding = ota_decoder_is_compressed(data + OTA_SUBELEMENT_HDR_SIZE, len - OTA_SUBELEMENT_HDR_SIZE);
+        ESP_LOGI(TAG, "Upgrade image sub-element: %lu bytes%s", (unsigned long)s_element_remaining,
+                 s_decoding ? " (compressed)" : "");
+        return OTA_SUBELEMENT_HDR_SIZE;
+    }
+
+    for (size_t i = 0; i < len && i < OTA_MAGIC_SCAN_LIMIT; i++) {
+        if (data[i] == ESP_IMAGE_HEADER_MAGIC) {
+            ESP_LOGW(TAG, "No upgrade-image sub-element header, ESP image magic found at offset %u", (unsigned)i);
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+/* True if a block is the beginning of the OTA file rather than a continuation */
+static bool ota_writer_is_stream_start(const uint8_t *data, size_t len)
+{
+    if (len >= 4) {
+        uint32_t magic = (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                         ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+        if (magic == OTA_FILE_MAGIC) return true;
+    }
+    return ota_writer_is_subelement(data, len);
+}
+
+static void ota_writer_release(void)
+{
+    if (s_decoding) {
+        ota_decoder_abort();
+        s_decoding = false;
+    }
+    free(s_stage);
+    s_stage = NULL;
+    s_stage_len = 0;
+    s_handle = 0;
+    s_active = false;
+    s_resume_pending = false;
+}
+
+static void ota_writer_update_timing(void)
+{
+    uint32_t transferred = s_stats.received - s_stats.resumed_from;
+    s_stats.elapsed_us = esp_timer_get_time() - s_start_us;
+    s_stats.rate_bps = s_stats.elapsed_us > 0 ? (uint32_t)((uint64_t)transferred * 1000000ULL / s_stats.elapsed_us) : 0;
+}
+
+static void ota_writer_reset_state(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.image_size = s_image.image_size;
+    s_stage_len = 0;
+    s_image_found = false;
+    s_resume_pending = false;
+    s_decoding = false;
+    s_element_len_known = false;
+    s_element_remaining = 0;
+    s_stream_pos = 0;
+    s_crc = 0;
+    s_next_progress = OTA_PROGRESS_STEP_PERCENT;
+    s_start_us = esp_timer_get_time();
+}
+
+static esp_err_t ota_writer_open_fresh(void)
+{
+    /* The previous code used OTA_SIZE_UNKNOWN, which erases the whole partition
+     * up front. Sequential mode erases each sector just before it is written. */
+    size_t erase_size = OTA_WITH_SEQUENTIAL_WRITES;
+#if OTA_WRITER_PREERASE
+    if (s_image.image_size > 0 && s_image.image_size <= s_partition->size) {
+        erase_size = s_image.image_size;
+    }
+#endif
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t ret = esp_ota_begin(s_partition, erase_size, &s_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ota_writer_reset_state();
+    ESP_LOGI(TAG, "Writing to %s (image %lu bytes, %s erase, begin took %lld ms)",
+             s_partition->label, (unsigned long)s_image.image_size,
+             erase_size == OTA_WITH_SEQUENTIAL_WRITES ? "per-sector" : "up-front",
+             (long long)((s_start_us - t0) / 1000));
+    return ESP_OK;
+}
+
+/* Re-read the flashed prefix and compare it with the checkpointed CRC */
+static bool ota_writer_verify_prefix(const ota_checkpoint_t *ckpt)
+{
+    uint32_t crc = 0;
+    for (uint32_t off = 0; off < ckpt->written; off += OTA_WRITER_SECTOR_SIZE) {
+        size_t len = ckpt->written - off;
+        if (len > OTA_WRITER_SECTOR_SIZE) len = OTA_WRITER_SECTOR_SIZE;
+        if (esp_partition_read(s_partition, off, s_stage, len) != ESP_OK) {
+            return false;
+        }
+        crc = esp_rom_crc32_le(crc, s_stage, len);
+    }
+    return crc == ckpt->crc32;
+}
+
+static esp_err_t ota_writer_open_resume(const ota_checkpoint_t *ckpt)
+{
+    if (!ota_writer_verify_prefix(ckpt)) {
+        ESP_LOGW(TAG, "Flashed prefix does not match checkpoint CRC - starting over");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    esp_err_t ret = esp_ota_resume(s_partition, OTA_WITH_SEQUENTIAL_WRITES, ckpt->written, &s_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "esp_ota_resume failed: %s - starting over", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ota_writer_reset_state();
+    s_image_found = true;
+    s_resume_pending = true;
+    s_stream_pos = ckpt->stream_offset;
+    s_crc = ckpt->crc32;
+    s_element_remaining = ckpt->element_remaining;
+    s_element_len_known = ckpt->element_len_known;
+    s_stats.written = ckpt->written;
+    s_stats.received = ckpt->stream_offset;
+    s_stats.resumed_from = ckpt->stream_offset;
+    if (s_image.image_size > 0) {
+        uint32_t percent = (uint32_t)((uint64_t)s_stats.received * 100ULL / s_image.image_size);
+        s_next_progress = (percent / OTA_PROGRESS_STEP_PERCENT + 1) * OTA_PROGRESS_STEP_PERCENT;
+    }
+
+    ESP_LOGI(TAG, "♻️ Resuming %s at stream offset %lu (%lu bytes already flashed, prefix CRC OK)",
+             s_partition->label, (unsigned long)ckpt->stream_offset, (unsigned long)ckpt->written);
+    return ESP_OK;
+}
+
+esp_err_t ota_writer_begin(const esp_partition_t *partition, const ota_writer_image_id_t *image)
+{
+    if (!partition || !image) return ESP_ERR_INVALID_ARG;
+    if (s_active) {
+        ESP_LOGW(TAG, "Previous image still open - aborting it");
+        ota_writer_abort();
+    }
+
+    s_stage = malloc(OTA_WRITER_SECTOR_SIZE);
+    if (!s_stage) {
+        ESP_LOGE(TAG, "Failed to allocate %d byte staging buffer", OTA_WRITER_SECTOR_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+    s_partition = partition;
+    s_image = *image;
+
+    esp_err_t ret = ESP_FAIL;
+    ota_checkpoint_t ckpt;
+    if (ota_writer_load_checkpoint(&ckpt)) {
+        if (memcmp(&ckpt.image, image, sizeof(*image)) == 0 && ckpt.partition_addr == partition->address &&
+            ckpt.written > 0 && ckpt.written % OTA_WRITER_SECTOR_SIZE == 0 && ckpt.written <= partition->size) {
+            ret = ota_writer_open_resume(&ckpt);
+        } else {
+            ESP_LOGI(TAG, "Checkpoint belongs to another image (v0x%08lx) - discarding",
+                     (unsigned long)ckpt.image.file_version);
+        }
+        if (ret != ESP_OK) {
+            ota_writer_clear_checkpoint();
+        }
+    }
+
+    if (ret != ESP_OK) {
+        ret = ota_writer_open_fresh();
+    }
+    if (ret != ESP_OK) {
+        ota_writer_release();
+        return ret;
+    }
+
+    s_active = true;
+    return ESP_OK;
+}
+
+esp_err_t ota_writer_write(const uint8_t *data, size_t len)
+{
+    if (!s_active) return ESP_ERR_INVALID_STATE;
+    if (!data || len == 0) return ESP_OK;
+
+    if (s_resume_pending) {
+        s_resume_pending = false;
+        if (ota_writer_is_stream_start(data, len)) {
+            /* The server (or the stack) ignored our FileOffset and started at 0 */
+            ESP_LOGW(TAG, "Download restarted from offset 0 - dropping resume point");
+            esp_ota_abort(s_handle);
+            ota_writer_clear_checkpoint();
+            esp_err_t ret = ota_writer_open_fresh();
+            if (ret != ESP_OK) {
+                ota_writer_release();
+                return ret;
+            }
+        } else {
+            ESP_LOGI(TAG, "First block after resume taken as stream offset %lu",
+                     (unsigned long)s_stream_pos);
+        }
+    }
+
+    s_stats.received += len;
+
+    if (!s_image_found) {
+        int offset = ota_writer_find_image(data, len);
+        if (offset < 0) {
+            ESP_LOGE(TAG, "No ESP32 magic byte (0xE9) found in first %u bytes", (unsigned)len);
+            return ESP_ERR_INVALID_ARG;
+        }
+        s_image_found = true;
+        s_stream_pos += offset;
+        data += offset;
+        len -= offset;
+
+        if (s_decoding) {
+            esp_err_t ret = ota_decoder_begin(ota_writer_put);
+            if (ret != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to start image decoder: %s", esp_err_to_name(ret));
+                s_decoding = false;
+                return ret;
+            }
+            s_stats.compressed = true;
+        }
+    }
+
+    esp_err_t ret = ota_writer_stage(data, len);
+    if (ret != ESP_OK) return ret;
+
+    if (s_stats.image_size > 0) {
+        uint32_t percent = (uint32_t)((uint64_t)s_stats.received * 100ULL / s_stats.image_size);
+        if (percent >= s_next_progress) {
+            ota_writer_update_timing();
+            ESP_LOGI(TAG, "OTA progress: %lu%% (%lu KB, %lu B/s, %lu flash writes)",
+                     (unsigned long)percent, (unsigned long)(s_stats.received / 1024),
+                     (unsigned long)s_stats.rate_bps, (unsigned long)s_stats.flash_writes);
+            s_next_progress = (percent / OTA_PROGRESS_STEP_PERCENT + 1) * OTA_PROGRESS_STEP_PERCENT;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_writer_finish(void)
+{
+    if (!s_active) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t ret = ESP_OK;
+    if (s_decoding) {
+        s_decoding = false;
+        ret = ota_decoder_finish();
+    }
+    if (ret == ESP_OK) {
+        ret = ota_writer_flush();
+    }
+    if (ret != ESP_OK) {
+        ota_writer_abort();
+        return ret;
+    }
+
+    ret = esp_ota_end(s_handle);
+    ota_writer_update_timing();
+    ota_writer_release();
+    /* Either complete or invalid: the partial image must not be resumed again */
+    ota_writer_clear_checkpoint();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_end failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Image complete: %lu bytes in %llu s (%lu B/s), %lu flash writes, %llu ms in flash%s",
+             (unsigned long)s_stats.written, (unsigned long long)(s_stats.elapsed_us / 1000000ULL),
+             (unsigned long)s_stats.rate_bps, (unsigned long)s_stats.flash_writes,
+             (unsigned long long)(s_stats.flash_time_us / 1000ULL),
+             s_stats.resumed_from > 0 ? " (resumed)" : (s_stats.compressed ? " (decoded)" : ""));
+    return ESP_OK;
+}
+
+void ota_writer_abort(void)
+{
+    if (!s_active) return;
+
+    esp_ota_abort(s_handle);
+    ota_writer_update_timing();
+    ESP_LOGW(TAG, "Image aborted after %lu bytes (resume point kept)", (unsigned long)s_stats.received);
+    ota_writer_release();
+}
+
+bool ota_writer_is_active(void)
+{
+    return s_active;
+}
+
+void ota_writer_get_stats(ota_writer_stats_t *stats)
+{
+    if (!stats) return;
+    if (s_active) ota_writer_update_timing();
+    *stats = s_stats;
+}
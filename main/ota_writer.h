@@ -0,0 +1,143 @@
+/*
+ * Buffered OTA image writer
+ *
+ * Collects the small Zigbee OTA image blocks into a flash-sector sized staging
+ * buffer and hands esp_ota_write() one full, sector-aligned 4 KB chunk at a
+ * time, so each sector costs one erase + one program instead of dozens of
+ * tiny writes. Also locates the ESP app image inside the Zigbee OTA upgrade
+ * sub-element and keeps transfer statistics. Compressed and delta images
+ * (CLMZ header, see ota_decoder.h) are decoded on the fly before staging.
+ *
+ * Every OTA_WRITER_CHECKPOINT_SECTORS flushed sectors the write position and a
+ * running CRC32 of the flashed prefix are checkpointed in NVS, so an
+ * interrupted download can continue into the same partition after a reboot
+ * or rejoin instead of starting over. Compressed images are not checkpointed
+ * because the decoder window cannot be restored.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_WRITER_SECTOR_SIZE      4096    // SPI flash sector (erase unit)
+
+/* 0 = erase each sector right before it is programmed (OTA_WITH_SEQUENTIAL_WRITES),
+ * 1 = erase the whole image range once at START when the image size is known
+ *     (one longer stall up front, every flush afterwards is program-only) */
+#ifndef OTA_WRITER_PREERASE
+#define OTA_WRITER_PREERASE         0
+#endif
+
+/* Checkpoint every 16 sectors (64 KB): ~10 NVS writes for a 600 KB image */
+#ifndef OTA_WRITER_CHECKPOINT_SECTORS
+#define OTA_WRITER_CHECKPOINT_SECTORS   16
+#endif
+
+/* Identity of the Zigbee OTA file being downloaded (from its header) */
+typedef struct {
+    uint16_t manufacturer;
+    uint16_t image_type;
+    uint32_t file_version;
+    uint32_t image_size;
+} ota_writer_image_id_t;
+
+typedef struct {
+    uint32_t image_size;        // Zigbee OTA file size from the header (0 = unknown)
+    uint32_t received;          // bytes received from the stack (incl. sub-element header)
+    uint32_t written;           // app image bytes handed to flash
+    uint32_t flash_writes;      // esp_ota_write() calls
+    uint64_t flash_time_us;     // time spent inside esp_ota_write()
+    uint64_t elapsed_us;        // since ota_writer_begin()
+    uint32_t rate_bps;          // average receive rate in bytes/s
+    uint32_t resumed_from;      // stream offset the download continued from (0 = fresh)
+    bool compressed;            // image went through ota_decoder (compressed or delta)
+} ota_writer_stats_t;
+
+/**
+ * @brief Start (or resume) an image
+ *
+ * Allocates the staging buffer and opens the OTA partition. If the NVS
+ * checkpoint belongs to the same file and partition, the flashed prefix is
+ * read back and checked against the checkpointed CRC32; when it matches the
+ * partition is reopened with esp_ota_resume() at the checkpointed offset.
+ * Otherwise the checkpoint is dropped and a fresh image is started.
+ *
+ * @param partition Target OTA partition
+ * @param image File identity; image_size is used for progress (and pre-erase if enabled)
+ * @return ESP_OK on success
+ */
+esp_err_t ota_writer_begin(const esp_partition_t *partition, const ota_writer_image_id_t *image);
+
+/**
+ * @brief Feed one block received from the OTA server
+ *
+ * The first bytes are parsed for the upgrade-image sub-element header (tag
+ * 0x0000 + 32-bit length) and everything up to the ESP image magic (0xE9) is
+ * skipped; a CLMZ header instead routes the image through ota_decoder.
+ * Data is copied straight into the staging buffer; flash is only touched when
+ * a full sector is staged.
+ *
+ * After a resume the first block is expected at the checkpointed offset. If
+ * it is recognisably the start of the file instead (OTA file magic or the
+ * upgrade-image sub-element header), the writer restarts the image from 0.
+ *
+ * @param data Block payload
+ * @param len Block length
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if no ESP image is found
+ */
+esp_err_t ota_writer_write(const uint8_t *data, size_t len);
+
+/**
+ * @brief Flush the partial last sector and close the image (esp_ota_end)
+ *
+ * @return ESP_OK if the image validated
+ */
+esp_err_t ota_writer_finish(void);
+
+/**
+ * @brief Close the current image and release the staging buffer
+ *
+ * The NVS checkpoint is kept, so a later ota_writer_begin() for the same file
+ * continues from it.
+ */
+void ota_writer_abort(void);
+
+/**
+ * @brief Read the NVS checkpoint
+ *
+ * @param image File the checkpoint belongs to
+ * @param stream_offset Bytes of the block stream already written
+ * @return true if a checkpoint exists
+ */
+bool ota_writer_get_checkpoint(ota_writer_image_id_t *image, uint32_t *stream_offset);
+
+/**
+ * @brief Delete the NVS checkpoint
+ */
+void ota_writer_clear_checkpoint(void);
+
+/**
+ * @brief Check whether an image is open
+ *
+ * @return true between ota_writer_begin() and ota_writer_finish()/ota_writer_abort()
+ */
+bool ota_writer_is_active(void);
+
+/**
+ * @brief Transfer statistics of the current (or last) image
+ *
+ * @param stats Filled with the statistics
+ */
+void ota_writer_get_stats(ota_writer_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
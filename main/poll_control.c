@@ -0,0 +1,166 @@
+/*
+ * Parent poll rate
+ */
+
+#include <stdint.h>
+#include "poll_control.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_zigbee_core.h"
+
+static const char *TAG = "POLL_CTRL";
+
+typedef struct {
+    bool open;
+    int64_t opened_us;
+    int64_t quiet_until_us;         // first_ms / quiet_ms deadline
+} poll_window_state_t;
+
+static const char *const s_window_names[POLL_WINDOW_COUNT] = { "join", "config", "ota", "aps_ack" };
+
+static poll_control_config_t s_cfg;
+static poll_window_state_t s_windows[POLL_WINDOW_COUNT];
+static bool s_ready = false;
+static bool s_fast = false;
+static int64_t s_fast_since_us = 0;
+static uint8_t s_alarm_gen = 0;             // only the newest expiry alarm acts
+static int64_t s_alarm_due_us = INT64_MAX;
+
+static void poll_control_expire(uint8_t gen);
+
+static int64_t window_deadline(poll_window_t window)
+{
+    const poll_window_state_t *w = &s_windows[window];
+    int64_t deadline = w->quiet_until_us;
+    uint32_t max_ms = s_cfg.windows[window].max_ms;
+    if (max_ms > 0 && w->opened_us + (int64_t)max_ms * 1000 < deadline) {
+        deadline = w->opened_us + (int64_t)max_ms * 1000;
+    }
+    return deadline;
+}
+
+/* Close what has expired, switch the interval, arm the next expiry */
+static void poll_control_update(void)
+{
+    if (!s_ready) return;
+
+    int64_t now = esp_timer_get_time();
+    int64_t next = INT64_MAX;
+    for (int i = 0; i < POLL_WINDOW_COUNT; i++) {
+        if (!s_windows[i].open) continue;
+        int64_t deadline = window_deadline((poll_window_t)i);
+        if (now >= deadline) {
+            s_windows[i].open = false;
+            ESP_LOGD(TAG, "Window %s closed after %lld ms", s_window_names[i],
+                     (long long)((now - s_windows[i].opened_us) / 1000));
+        } else if (deadline < next) {
+            next = deadline;
+        }
+    }
+
+    bool fast = next != INT64_MAX;
+    if (fast != s_fast) {
+        esp_zb_zdo_pim_set_long_poll_interval(fast ? s_cfg.fast_interval_ms : s_cfg.long_interval_ms);
+        if (fast) {
+            s_fast_since_us = now;
+        } else {
+            ESP_LOGI(TAG, "📡 Back to %lu ms polls after %lld ms of fast polling",
+                     (unsigned long)s_cfg.long_interval_ms, (long long)((now - s_fast_since_us) / 1000));
+        }
+        s_fast = fast;
+    }
+
+    /* A later deadline is picked up when the armed alarm fires early */
+    if (next < s_alarm_due_us) {
+        s_alarm_due_us = next;
+        esp_zb_scheduler_alarm(poll_control_expire, ++s_alarm_gen, (uint32_t)((next - now + 999) / 1000));
+    }
+}
+
+static void poll_control_expire(uint8_t gen)
+{
+    if (gen != s_alarm_gen) return;
+    s_alarm_due_us = INT64_MAX;
+    poll_control_update();
+}
+
+esp_err_t poll_control_init(const poll_control_config_t *config)
+{
+    if (!config || config->long_interval_ms == 0 || config->fast_interval_ms == 0) return ESP_ERR_INVALID_ARG;
+
+    s_cfg = *config;
+    for (int i = 0; i < POLL_WINDOW_COUNT; i++) {
+        s_windows[i].open = false;
+    }
+    s_fast = false;
+    s_alarm_due_us = INT64_MAX;
+    s_ready = true;
+    esp_zb_zdo_pim_set_long_poll_interval(s_cfg.long_interval_ms);
+    ESP_LOGI(TAG, "📡 Poll interval %lu ms, %lu ms while a reply is expected",
+             (unsigned long)s_cfg.long_interval_ms, (unsigned long)s_cfg.fast_interval_ms);
+    return ESP_OK;
+}
+
+void poll_control_open(poll_window_t window)
+{
+    if (window >= POLL_WINDOW_COUNT) return;
+
+    poll_window_state_t *w = &s_windows[window];
+    int64_t now = esp_timer_get_time();
+    int64_t until = now + (int64_t)s_cfg.windows[window].first_ms * 1000;
+    if (!poll_control_is_open(window)) {
+        w->open = true;
+        w->opened_us = now;
+        w->quiet_until_us = until;
+        ESP_LOGD(TAG, "Window %s opened", s_window_names[window]);
+    } else if (until > w->quiet_until_us) {
+        w->quiet_until_us = until;
+    }
+    poll_control_update();
+}
+
+void poll_control_traffic(poll_window_t window)
+{
+    if (!poll_control_is_open(window)) return;
+
+    s_windows[window].quiet_until_us = esp_timer_get_time() + (int64_t)s_cfg.windows[window].quiet_ms * 1000;
+    poll_control_update();
+}
+
+void poll_control_close(poll_window_t window)
+{
+    if (window >= POLL_WINDOW_COUNT || !s_windows[window].open) return;
+
+    s_windows[window].open = false;
+    ESP_LOGD(TAG, "Window %s done after %lld ms", s_window_names[window],
+             (long long)((esp_timer_get_time() - s_windows[window].opened_us) / 1000));
+    poll_control_update();
+}
+
+void poll_control_frame_received(uint16_t cluster_id)
+{
+    if (cluster_id == ESP_ZB_ZCL_CLUSTER_ID_OTA_UPGRADE) {
+        if (poll_control_is_open(POLL_WINDOW_OTA)) {
+            poll_control_traffic(POLL_WINDOW_OTA);
+        } else {
+            poll_control_open(POLL_WINDOW_OTA);
+        }
+    } else if (poll_control_is_open(POLL_WINDOW_JOIN)) {
+        poll_control_traffic(POLL_WINDOW_JOIN);
+    } else if (poll_control_is_open(POLL_WINDOW_CONFIG)) {
+        poll_control_traffic(POLL_WINDOW_CONFIG);
+    } else {
+        poll_control_open(POLL_WINDOW_CONFIG);
+    }
+}
+
+bool poll_control_is_open(poll_window_t window)
+{
+    /* Exact even if the expiry alarm has not run yet */
+    return window < POLL_WINDOW_COUNT && s_windows[window].open && esp_timer_get_time() < window_deadline(window);
+}
+
+uint32_t poll_control_interval_ms(void)
+{
+    return s_fast ? s_cfg.fast_interval_ms : s_cfg.long_interval_ms;
+}
@@ -0,0 +1,95 @@
+/*
+ * Parent poll rate
+ * A sleepy end device only hears from its parent when it polls, so the poll
+ * interval sets both the radio-on time and how long an exchange with the
+ * coordinator takes. The device polls at the long interval (the keep-alive)
+ * unless a window is open - a reason to expect frames soon: the interview
+ * after a join, a configuration exchange, an OTA transfer, the APS ACKs of
+ * reports just sent. While any window is open it polls at the fast interval.
+ * A window closes once its traffic has stopped (quiet_ms after the last
+ * frame, first_ms after opening if none came), when the caller knows the
+ * exchange is over, or after max_ms at the latest. Zigbee task only.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    POLL_WINDOW_JOIN = 0,           // coordinator interview after a join
+    POLL_WINDOW_CONFIG,             // later configuration exchange (binds, configure reporting, reads)
+    POLL_WINDOW_OTA,                // OTA query and image block responses
+    POLL_WINDOW_APS_ACK,            // APS ACKs of the reports just sent
+    POLL_WINDOW_COUNT,
+} poll_window_t;
+
+typedef struct {
+    uint32_t first_ms;              // close if nothing arrives this long after opening
+    uint32_t quiet_ms;              // close this long after the last expected frame
+    uint32_t max_ms;                // close this long after opening at the latest, 0 = no cap
+} poll_window_config_t;
+
+typedef struct {
+    uint32_t long_interval_ms;      // no window open
+    uint32_t fast_interval_ms;      // any window open
+    poll_window_config_t windows[POLL_WINDOW_COUNT];
+} poll_control_config_t;
+
+/**
+ * @brief Set the intervals and windows, and start polling at the long interval
+ *
+ * Call after esp_zb_init().
+ *
+ * @param config Intervals and windows (copied)
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a zero interval
+ */
+esp_err_t poll_control_init(const poll_control_config_t *config);
+
+/**
+ * @brief Open a window, or restart the first_ms wait of an open one
+ *
+ * The max_ms cap counts from the first open.
+ */
+void poll_control_open(poll_window_t window);
+
+/**
+ * @brief A frame the window waits for has arrived; no-op if it is closed
+ */
+void poll_control_traffic(poll_window_t window);
+
+/**
+ * @brief The exchange is over: close the window now
+ */
+void poll_control_close(poll_window_t window);
+
+/**
+ * @brief A frame from the network reached one of our endpoints
+ *
+ * OTA cluster frames open the OTA window. Anything else is part of a
+ * configuration exchange: it counts for the join window while that is open
+ * and opens the configuration window otherwise, so the rest of an exchange
+ * whose first frame waited for a long poll arrives at the fast rate.
+ *
+ * @param cluster_id ZCL cluster, 0 for ZDO
+ */
+void poll_control_frame_received(uint16_t cluster_id);
+
+/**
+ * @brief True while the window is open
+ */
+bool poll_control_is_open(poll_window_t window);
+
+/**
+ * @brief Poll interval in use
+ */
+uint32_t poll_control_interval_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,193 @@
+/*
+ * Power profiler
+ */
+
+#include <string.h>
+#include "power_profiler.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+static const char *TAG = "POWER_PROF";
+
+#define POWER_RTC_MAGIC         0x90E7F201U
+#define US_PER_HOUR             3600000000.0
+
+/* Kept across light sleep and software resets, cleared on power-on */
+typedef struct {
+    uint32_t magic;
+    uint64_t awake_us;
+    uint64_t sleep_us;
+    uint32_t sleeps;
+    uint32_t tx_frames;
+    uint64_t scan_us;               // radio on for the whole duration (steering)
+    uint64_t cause_us[POWER_CAUSE_COUNT];
+    uint32_t cause_runs[POWER_CAUSE_COUNT];
+} power_rtc_t;
+
+static RTC_NOINIT_ATTR power_rtc_t rtc_power;
+
+static int64_t s_wake_us = 0;               // esp_timer time of the last wake-up (or init)
+static int64_t s_sleep_enter_us = -1;       // >= 0 while inside esp_zb_sleep_now()
+static int64_t s_begin_us[POWER_CAUSE_COUNT];
+static int s_blocked_cause = -1;            // cause holding off sleep, -1 = none
+static int64_t s_blocked_since_us = 0;
+static int64_t s_last_tx_us = -1;           // esp_timer time of the last power_profiler_tx()
+
+static const char *const s_cause_names[POWER_CAUSE_COUNT] = {
+    "acquisition", "env", "ds18b20", "wind_speed", "wind_dir", "light",
+    "battery", "backfill", "rejoin", "join_config", "ota", "led",
+};
+
+void power_profiler_init(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (rtc_power.magic != POWER_RTC_MAGIC || reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT) {
+        memset(&rtc_power, 0, sizeof(rtc_power));
+        rtc_power.magic = POWER_RTC_MAGIC;
+    }
+    for (int i = 0; i < POWER_CAUSE_COUNT; i++) s_begin_us[i] = -1;
+    s_wake_us = esp_timer_get_time();
+    s_sleep_enter_us = -1;
+    s_blocked_cause = -1;
+}
+
+static void charge_cause(power_cause_t cause, uint64_t duration_us)
+{
+    rtc_power.cause_us[cause] += duration_us;
+    rtc_power.cause_runs[cause]++;
+}
+
+void power_profiler_begin(power_cause_t cause)
+{
+    if (cause >= POWER_CAUSE_COUNT || s_begin_us[cause] >= 0) return;
+    s_begin_us[cause] = esp_timer_get_time();
+}
+
+void power_profiler_end(power_cause_t cause)
+{
+    if (cause >= POWER_CAUSE_COUNT || s_begin_us[cause] < 0) return;
+    charge_cause(cause, (uint64_t)(esp_timer_get_time() - s_begin_us[cause]));
+    s_begin_us[cause] = -1;
+}
+
+void power_profiler_add(power_cause_t cause, uint64_t duration_us, bool radio_on)
+{
+    if (cause >= POWER_CAUSE_COUNT) return;
+    charge_cause(cause, duration_us);
+    if (radio_on) rtc_power.scan_us += duration_us;
+}
+
+void power_profiler_sleep_blocked(power_cause_t cause)
+{
+    if (cause >= POWER_CAUSE_COUNT || s_blocked_cause == (int)cause) return;
+    int64_t now = esp_timer_get_time();
+    if (s_blocked_cause >= 0) {
+        charge_cause((power_cause_t)s_blocked_cause, (uint64_t)(now - s_blocked_since_us));
+    }
+    s_blocked_cause = cause;
+    s_blocked_since_us = now;
+}
+
+void power_profiler_sleep_enter(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (s_blocked_cause >= 0) {
+        charge_cause((power_cause_t)s_blocked_cause, (uint64_t)(now - s_blocked_since_us));
+        s_blocked_cause = -1;
+    }
+    rtc_power.awake_us += (uint64_t)(now - s_wake_us);
+    s_sleep_enter_us = now;
+}
+
+void power_profiler_sleep_exit(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (s_sleep_enter_us >= 0) {
+        rtc_power.sleep_us += (uint64_t)(now - s_sleep_enter_us);
+        rtc_power.sleeps++;
+    }
+    s_sleep_enter_us = -1;
+    s_wake_us = now;
+}
+
+void power_profiler_tx(void)
+{
+    rtc_power.tx_frames++;
+    s_last_tx_us = esp_timer_get_time();
+}
+
+int64_t power_profiler_last_tx_us(void)
+{
+    return s_last_tx_us;
+}
+
+void power_profiler_get(power_profile_t *profile)
+{
+    memset(profile, 0, sizeof(*profile));
+    profile->awake_us = rtc_power.awake_us;
+    if (s_sleep_enter_us < 0) {
+        profile->awake_us += (uint64_t)(esp_timer_get_time() - s_wake_us);
+    }
+    profile->sleep_us = rtc_power.sleep_us;
+    profile->sleeps = rtc_power.sleeps;
+    profile->tx_frames = rtc_power.tx_frames;
+    profile->radio_us = (uint64_t)rtc_power.tx_frames * POWER_MODEL_TX_FRAME_US +
+                        (uint64_t)rtc_power.sleeps * POWER_MODEL_POLL_US + rtc_power.scan_us;
+    memcpy(profile->cause_us, rtc_power.cause_us, sizeof(profile->cause_us));
+    memcpy(profile->cause_runs, rtc_power.cause_runs, sizeof(profile->cause_runs));
+
+    double ua_us = (double)profile->awake_us * POWER_MODEL_ACTIVE_UA +
+                   (double)profile->radio_us * POWER_MODEL_RADIO_UA +
+                   (double)profile->sleep_us * POWER_MODEL_SLEEP_UA +
+                   (double)profile->cause_us[POWER_CAUSE_LED] * POWER_MODEL_LED_UA;
+    uint64_t total_us = profile->awake_us + profile->sleep_us;
+    profile->charge_uah = (float)(ua_us / US_PER_HOUR);
+    profile->average_ua = total_us > 0 ? (float)(ua_us / (double)total_us) : 0.0f;
+}
+
+size_t power_profiler_encode_causes(uint8_t *buf, size_t len)
+{
+    size_t need = 3 + 4 * POWER_CAUSE_COUNT;
+    if (len < need) return 0;
+
+    buf[0] = (uint8_t)(need - 1);
+    buf[1] = POWER_CAUSES_ATTR_VERSION;
+    buf[2] = POWER_CAUSE_COUNT;
+    for (int i = 0; i < POWER_CAUSE_COUNT; i++) {
+        uint64_t ms = rtc_power.cause_us[i] / 1000;
+        uint32_t v = ms > UINT32_MAX ? UINT32_MAX : (uint32_t)ms;
+        uint8_t *p = &buf[3 + 4 * i];
+        p[0] = v & 0xFF;
+        p[1] = (v >> 8) & 0xFF;
+        p[2] = (v >> 16) & 0xFF;
+        p[3] = (v >> 24) & 0xFF;
+    }
+    return need;
+}
+
+void power_profiler_log(uint32_t battery_mah)
+{
+    power_profile_t p;
+    power_profiler_get(&p);
+    uint64_t total_us = p.awake_us + p.sleep_us;
+    if (total_us == 0) {
+        ESP_LOGI(TAG, "⚡ No profile yet (counters cleared at power-on)");
+        return;
+    }
+
+    ESP_LOGI(TAG, "⚡ Since power-on: awake %.1f s, asleep %.1f s (%lu sleeps, duty %.2f %%), %lu TX frames, radio ~%.1f s",
+             p.awake_us / 1e6, p.sleep_us / 1e6, (unsigned long)p.sleeps, 100.0 * p.awake_us / total_us,
+             (unsigned long)p.tx_frames, p.radio_us / 1e6);
+    for (int i = 0; i < POWER_CAUSE_COUNT; i++) {
+        if (p.cause_runs[i] == 0) continue;
+        ESP_LOGI(TAG, "   %-12s %8.1f s in %lu run(s), mean %lu ms", s_cause_names[i], p.cause_us[i] / 1e6,
+                 (unsigned long)p.cause_runs[i], (unsigned long)(p.cause_us[i] / p.cause_runs[i] / 1000));
+    }
+    if (p.average_ua > 0.0f) {
+        float days = battery_mah * 1000.0f / p.average_ua / 24.0f;
+        ESP_LOGI(TAG, "🔋 Modelled %.1f µAh, average %.1f µA - %.0f days on %lu mAh",
+                 p.charge_uah, p.average_ua, days, (unsigned long)battery_mah);
+    }
+}
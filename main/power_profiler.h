@@ -0,0 +1,145 @@
+/*
+ * Power profiler
+ * Measures where the awake time goes instead of assuming it: time spent in
+ * each instrumented callback, in light sleep (ESP_ZB_COMMON_SIGNAL_CAN_SLEEP
+ * to wake-up), with sleep held off (join configuration, OTA) and with the
+ * debug LED lit, plus the APS frames sent. Radio-on time and charge are
+ * modelled from those with the POWER_MODEL_* currents below. Counters live in
+ * RTC memory, so they survive light sleep and software resets and cover the
+ * time since the last power-on. Zigbee task only.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Charge model, datasheet typicals for the ESP32-H2 at 3.3 V - calibrate
+ * against a bench measurement of one board */
+#define POWER_MODEL_ACTIVE_UA           9000    // CPU at 96 MHz, radio off
+#define POWER_MODEL_RADIO_UA            11000   // added while the 802.15.4 radio is on (TX/RX)
+#define POWER_MODEL_SLEEP_UA            35      // light sleep, RTC and wake sources on
+#define POWER_MODEL_LED_UA              5000    // added while the debug LED is lit
+#define POWER_MODEL_TX_FRAME_US         4500    // radio on per APS frame: CSMA, TX, ACK wait
+#define POWER_MODEL_POLL_US             3000    // radio on per wake-up (data request to the parent)
+
+#define POWER_CAUSES_ATTR_VERSION       1
+
+/* Awake-time causes; the order is the layout of the per-cause attribute */
+typedef enum {
+    POWER_CAUSE_ACQUISITION = 0,    // pipeline trigger pass and attribute flush
+    POWER_CAUSE_ENV,                // env_read_and_report
+    POWER_CAUSE_DS18B20,            // ds18b20_read_and_report
+    POWER_CAUSE_WIND_SPEED,         // wind_speed_read_and_report
+    POWER_CAUSE_WIND_DIR,           // wind_dir_read_and_report
+    POWER_CAUSE_LIGHT,              // light_read_and_report
+    POWER_CAUSE_BATTERY,            // battery_read_and_report
+    POWER_CAUSE_BACKFILL,           // backfill_tick
+    POWER_CAUSE_REJOIN,             // steering attempts (radio on throughout)
+    POWER_CAUSE_JOIN_CONFIG,        // sleep held off after a join (INITIAL_CONFIG_DELAY_SEC)
+    POWER_CAUSE_OTA,                // sleep held off by an OTA transfer
+    POWER_CAUSE_LED,                // debug LED lit (not exclusive of the others)
+    POWER_CAUSE_COUNT,
+} power_cause_t;
+
+typedef struct {
+    uint64_t awake_us;              // total awake time
+    uint64_t sleep_us;              // total light-sleep time
+    uint32_t sleeps;                // light-sleep entries
+    uint32_t tx_frames;             // APS frames sent (confirmed or not)
+    uint64_t radio_us;              // modelled radio-on time
+    float charge_uah;               // modelled charge
+    float average_ua;               // charge over the covered time
+    uint64_t cause_us[POWER_CAUSE_COUNT];
+    uint32_t cause_runs[POWER_CAUSE_COUNT];
+} power_profile_t;
+
+/**
+ * @brief Resume the RTC counters after a software reset, clear them after power-on
+ *
+ * Call early in app_main; time before the call is not counted.
+ */
+void power_profiler_init(void);
+
+/**
+ * @brief Start timing a cause
+ *
+ * One timing per cause at a time; a second begin before the end keeps the
+ * first start.
+ */
+void power_profiler_begin(power_cause_t cause);
+
+/**
+ * @brief Stop timing a cause started with power_profiler_begin()
+ */
+void power_profiler_end(power_cause_t cause);
+
+/**
+ * @brief Add a duration measured elsewhere
+ *
+ * @param cause Cause
+ * @param duration_us Duration
+ * @param radio_on true if the radio was on throughout (e.g. a steering scan)
+ */
+void power_profiler_add(power_cause_t cause, uint64_t duration_us, bool radio_on);
+
+/**
+ * @brief Sleep was refused for a cause; the time until the next sleep is charged to it
+ */
+void power_profiler_sleep_blocked(power_cause_t cause);
+
+/**
+ * @brief Call right before esp_zb_sleep_now()
+ */
+void power_profiler_sleep_enter(void);
+
+/**
+ * @brief Call right after esp_zb_sleep_now() returns
+ */
+void power_profiler_sleep_exit(void);
+
+/**
+ * @brief Count one APS frame sent
+ */
+void power_profiler_tx(void);
+
+/**
+ * @brief esp_timer time of the last APS frame's confirm, -1 = none this boot
+ *
+ * The radio is idle after it until the next frame or parent poll; the battery
+ * read is timed against it so TX current does not sag the reading.
+ */
+int64_t power_profiler_last_tx_us(void);
+
+/**
+ * @brief Snapshot of the counters, awake time counted up to now
+ */
+void power_profiler_get(power_profile_t *profile);
+
+/**
+ * @brief Encode the per-cause awake time as a ZCL octet string
+ *
+ * Layout: length byte, u8 version, u8 cause count, then u32 ms per cause
+ * (little endian, saturating) in power_cause_t order.
+ *
+ * @param buf Output buffer
+ * @param len Buffer size, at least 3 + 4 * POWER_CAUSE_COUNT
+ * @return Bytes written including the length byte, 0 if buf is too small
+ */
+size_t power_profiler_encode_causes(uint8_t *buf, size_t len);
+
+/**
+ * @brief Log the counters and the battery life they imply
+ *
+ * @param battery_mah Battery capacity
+ */
+void power_profiler_log(uint32_t battery_mah);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Barometric tendency
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pressure_tendency.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_rtc_time.h"
+
+static const char *TAG = "PRESS_TEND";
+
+#define PRESSURE_TENDENCY_MAGIC         0x50544431  // "PTD1"
+#define PRESSURE_TENDENCY_MIN_STEP_S    (PRESSURE_TENDENCY_SPAN_S / PRESSURE_TENDENCY_SLOTS)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t head;                              // next slot to write
+    uint16_t count;
+    uint32_t time_s[PRESSURE_TENDENCY_SLOTS];   // esp_rtc_get_time_us() / 1e6 of the reading
+    float hpa[PRESSURE_TENDENCY_SLOTS];
+} pressure_tendency_rtc_t;
+
+static RTC_NOINIT_ATTR pressure_tendency_rtc_t rtc_pressure;
+
+static uint32_t now_s(void)
+{
+    return (uint32_t)(esp_rtc_get_time_us() / 1000000ULL);
+}
+
+static int newest_slot(void)
+{
+    return (rtc_pressure.head + PRESSURE_TENDENCY_SLOTS - 1) % PRESSURE_TENDENCY_SLOTS;
+}
+
+static bool history_valid(void)
+{
+    if (rtc_pressure.magic != PRESSURE_TENDENCY_MAGIC || rtc_pressure.head >= PRESSURE_TENDENCY_SLOTS ||
+        rtc_pressure.count > PRESSURE_TENDENCY_SLOTS) {
+        return false;
+    }
+    return rtc_pressure.count == 0 || rtc_pressure.time_s[newest_slot()] <= now_s();
+}
+
+void pressure_tendency_init(void)
+{
+    if (esp_reset_reason() != ESP_RST_POWERON && history_valid()) {
+        ESP_LOGI(TAG, "♻️ Resuming pressure history from RTC memory (%u readings)", rtc_pressure.count);
+        return;
+    }
+    memset(&rtc_pressure, 0, sizeof(rtc_pressure));
+    rtc_pressure.magic = PRESSURE_TENDENCY_MAGIC;
+}
+
+void pressure_tendency_add(float pressure_hpa)
+{
+    uint32_t now = now_s();
+    if (rtc_pressure.count > 0 && now - rtc_pressure.time_s[newest_slot()] < PRESSURE_TENDENCY_MIN_STEP_S) {
+        int slot = newest_slot();
+        rtc_pressure.time_s[slot] = now;
+        rtc_pressure.hpa[slot] = pressure_hpa;
+        return;
+    }
+    rtc_pressure.time_s[rtc_pressure.head] = now;
+    rtc_pressure.hpa[rtc_pressure.head] = pressure_hpa;
+    rtc_pressure.head = (rtc_pressure.head + 1) % PRESSURE_TENDENCY_SLOTS;
+    if (rtc_pressure.count < PRESSURE_TENDENCY_SLOTS) rtc_pressure.count++;
+}
+
+float pressure_tendency_3h(void)
+{
+    if (rtc_pressure.count < 2) return NAN;
+
+    int newest = newest_slot();
+    int64_t target = (int64_t)rtc_pressure.time_s[newest] - PRESSURE_TENDENCY_SPAN_S;
+    int best = -1;
+    int64_t best_off = INT64_MAX;
+    for (int i = 0; i < rtc_pressure.count; i++) {
+        int64_t off = llabs((int64_t)rtc_pressure.time_s[i] - target);
+        if (off < best_off) {
+            best_off = off;
+            best = i;
+        }
+    }
+    if (best < 0 || best_off > PRESSURE_TENDENCY_SLACK_S) return NAN;
+    return rtc_pressure.hpa[newest] - rtc_pressure.hpa[best];
+}
+
+float pressure_tendency_rate_hpa_h(uint32_t span_s)
+{
+    int newest = newest_slot();
+    for (int i = 1; i < rtc_pressure.count; i++) {
+        int slot = (newest + PRESSURE_TENDENCY_SLOTS - i) % PRESSURE_TENDENCY_SLOTS;
+        uint32_t age_s = rtc_pressure.time_s[newest] - rtc_pressure.time_s[slot];
+        if (age_s >= span_s && age_s > 0) {
+            return (rtc_pressure.hpa[newest] - rtc_pressure.hpa[slot]) * (3600.0f / (float)age_s);
+        }
+    }
+    return NAN;
+}
@@ -0,0 +1,58 @@
+/*
+ * Barometric tendency
+ * Keeps the pressure readings of the last few hours in a ring in RTC memory
+ * (resumed after a software reset) and derives the 3-hour tendency from it,
+ * the change a synoptic observation reports: the latest reading minus the one
+ * taken closest to 3 hours earlier. With the pressure sensor in FIFO mode each
+ * reading is already the mean of the chip's FIFO, so the difference is not
+ * dominated by the noise of two single conversions. The same ring gives the
+ * short-term rate the adaptive scheduler watches for a fast fall, so both
+ * come from one source and both resume after a reset. Zigbee task only.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PRESSURE_TENDENCY_SPAN_S        (3 * 3600)  // WMO 3-hour tendency
+#define PRESSURE_TENDENCY_SLACK_S       (30 * 60)   // accept a reference this far from 3 h
+#define PRESSURE_TENDENCY_SLOTS         24          // 6 h at the 15-minute env cadence
+
+/**
+ * @brief Resume the ring from RTC memory after a software reset, or clear it
+ */
+void pressure_tendency_init(void);
+
+/**
+ * @brief Record a pressure reading taken now
+ *
+ * Readings closer together than PRESSURE_TENDENCY_SPAN_S / PRESSURE_TENDENCY_SLOTS
+ * replace the newest slot, so extra reads (join, rejoin) do not shorten the history.
+ */
+void pressure_tendency_add(float pressure_hpa);
+
+/**
+ * @brief Pressure change over the last 3 hours in hPa, negative = falling
+ *
+ * @return NAN until a reading 3 h (± PRESSURE_TENDENCY_SLACK_S) old is held
+ */
+float pressure_tendency_3h(void);
+
+/**
+ * @brief Rate of change in hPa/h over a baseline of at least span_s
+ *
+ * The newest reading against the most recent one at least span_s older, so
+ * a short reading cadence is not dominated by sensor noise.
+ *
+ * @param span_s Shortest baseline, at most the ring's reach (about 3 h)
+ * @return NAN until a reading that old is held
+ */
+float pressure_tendency_rate_hpa_h(uint32_t span_s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Hardware Pulse Counter (PCNT) wrapper
+ */
+
+#include <stdlib.h>
+#include "pulse_counter.h"
+#include "esp_log.h"
+#include "driver/pulse_cnt.h"
+
+static const char *TAG = "PULSE_CNT";
+
+/* Hardware counter range; the driver accumulates across overflows at the
+ * high limit watch point (accum_count), which costs one interrupt per 32767
+ * pulses */
+#define PULSE_COUNTER_HIGH_LIMIT    32767
+#define PULSE_COUNTER_LOW_LIMIT     -1
+
+struct pulse_counter_s {
+    pcnt_unit_handle_t unit;
+    pcnt_channel_handle_t channel;
+    int last_count;
+    bool enabled;
+};
+
+esp_err_t pulse_counter_create(gpio_num_t gpio, bool count_rising, uint32_t glitch_filter_ns,
+                               pulse_counter_handle_t *ret_handle)
+{
+    if (!ret_handle) return ESP_ERR_INVALID_ARG;
+
+    struct pulse_counter_s *pc = calloc(1, sizeof(*pc));
+    if (!pc) return ESP_ERR_NO_MEM;
+
+    pcnt_unit_config_t unit_cfg = {
+        .low_limit = PULSE_COUNTER_LOW_LIMIT,
+        .high_limit = PULSE_COUNTER_HIGH_LIMIT,
+        .flags.accum_count = true,
+    };
+    esp_err_t ret = pcnt_new_unit(&unit_cfg, &pc->unit);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create PCNT unit: %s", esp_err_to_name(ret));
+        free(pc);
+        return ret;
+    }
+
+    if (glitch_filter_ns > 0) {
+        pcnt_glitch_filter_config_t filter_cfg = {
+            .max_glitch_ns = glitch_filter_ns,
+        };
+        ret = pcnt_unit_set_glitch_filter(pc->unit, &filter_cfg);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to set glitch filter (%lu ns): %s", glitch_filter_ns, esp_err_to_name(ret));
+            goto err;
+        }
+    }
+
+    pcnt_chan_config_t chan_cfg = {
+        .edge_gpio_num = gpio,
+        .level_gpio_num = -1,
+    };
+    ret = pcnt_new_channel(pc->unit, &chan_cfg, &pc->channel);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create PCNT channel: %s", esp_err_to_name(ret));
+        goto err;
+    }
+
+    ret = pcnt_channel_set_edge_action(pc->channel,
+                                       count_rising ? PCNT_CHANNEL_EDGE_ACTION_INCREASE : PCNT_CHANNEL_EDGE_ACTION_HOLD,
+                                       count_rising ? PCNT_CHANNEL_EDGE_ACTION_HOLD : PCNT_CHANNEL_EDGE_ACTION_INCREASE);
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_add_watch_point(pc->unit, PULSE_COUNTER_HIGH_LIMIT);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure PCNT channel: %s", esp_err_to_name(ret));
+        goto err;
+    }
+
+    ESP_LOGI(TAG, "PCNT counter on GPIO%d (%s edge, glitch filter %lu ns)",
+             gpio, count_rising ? "rising" : "falling", glitch_filter_ns);
+    *ret_handle = pc;
+    return ESP_OK;
+
+err:
+    if (pc->channel) pcnt_del_channel(pc->channel);
+    pcnt_del_unit(pc->unit);
+    free(pc);
+    return ret;
+}
+
+esp_err_t pulse_counter_enable(pulse_counter_handle_t handle)
+{
+    if (!handle) return ESP_ERR_INVALID_ARG;
+    if (handle->enabled) return ESP_OK;
+
+    esp_err_t ret = pcnt_unit_enable(handle->unit);
+    if (ret == ESP_OK) {
+        ret = pcnt_unit_start(handle->unit);
+    }
+    if (ret == ESP_OK) {
+        handle->enabled = true;
+    }
+    return ret;
+}
+
+esp_err_t pulse_counter_disable(pulse_counter_handle_t handle)
+{
+    if (!handle) return ESP_ERR_INVALID_ARG;
+    if (!handle->enabled) return ESP_OK;
+
+    pcnt_unit_stop(handle->unit);
+    esp_err_t ret = pcnt_unit_disable(handle->unit);
+    if (ret == ESP_OK) {
+        handle->enabled = false;
+    }
+    return ret;
+}
+
+esp_err_t pulse_counter_take(pulse_counter_handle_t handle, uint32_t *pulses)
+{
+    if (!handle || !pulses) return ESP_ERR_INVALID_ARG;
+
+    int count = 0;
+    esp_err_t ret = pcnt_unit_get_count(handle->unit, &count);
+    if (ret != ESP_OK) {
+        *pulses = 0;
+        return ret;
+    }
+    *pulses = (uint32_t)(count - handle->last_count);
+    handle->last_count = count;
+    return ESP_OK;
+}
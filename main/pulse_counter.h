@@ -0,0 +1,71 @@
+/*
+ * Hardware Pulse Counter (PCNT) wrapper
+ * Counts edges on a GPIO in the PCNT peripheral so a pulse does not cost a CPU
+ * interrupt. Used as an optional backend for the anemometer and rain gauge.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct pulse_counter_s *pulse_counter_handle_t;
+
+/**
+ * @brief Create a counter on a GPIO
+ *
+ * The GPIO must already be configured as input (pull-ups etc.). The 16-bit
+ * hardware counter is extended in software on overflow, so counts are 32-bit.
+ *
+ * Note: a non-zero glitch filter makes the PCNT driver hold an APB_FREQ_MAX
+ * PM lock while the counter is enabled, which also keeps the chip out of
+ * light sleep. Without the filter the counter is clock-gated (not counting)
+ * during light sleep, just like a non-wake GPIO interrupt.
+ *
+ * @param gpio Input GPIO
+ * @param count_rising true to count rising edges, false for falling edges
+ * @param glitch_filter_ns Pulses shorter than this are ignored (0 = filter off,
+ *                         hardware maximum is ~1023 APB cycles)
+ * @param ret_handle Returned counter handle
+ * @return ESP_OK on success
+ */
+esp_err_t pulse_counter_create(gpio_num_t gpio, bool count_rising, uint32_t glitch_filter_ns,
+                               pulse_counter_handle_t *ret_handle);
+
+/**
+ * @brief Start counting
+ *
+ * @param handle Counter handle
+ * @return ESP_OK on success
+ */
+esp_err_t pulse_counter_enable(pulse_counter_handle_t handle);
+
+/**
+ * @brief Stop counting (releases the PM lock, count is kept)
+ *
+ * @param handle Counter handle
+ * @return ESP_OK on success
+ */
+esp_err_t pulse_counter_disable(pulse_counter_handle_t handle);
+
+/**
+ * @brief Pulses counted since the previous call
+ *
+ * The hardware counter is never cleared, so no edge is lost between reading
+ * and resetting it.
+ *
+ * @param handle Counter handle
+ * @param pulses Number of new pulses
+ * @return ESP_OK on success
+ */
+esp_err_t pulse_counter_take(pulse_counter_handle_t handle, uint32_t *pulses);
+
+#ifdef __cplusplus
+}
+#endif
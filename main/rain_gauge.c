@@ -0,0 +1,471 @@
+/*
+ * Rain gauge (DRV5032 reed/hall switch on RAIN_GAUGE_GPIO)
+ */
+
+#include <math.h>
+#include "rain_gauge.h"
+#include "esp_zb_weather.h"
+#include "attr_cache.h"
+#include "sleep_manager.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#if RAIN_GAUGE_USE_PCNT
+#include "pulse_counter.h"
+#endif
+
+static const char *RAIN_TAG = "RAIN_GAUGE";
+
+/* Task notification bits (eSetBits, so concurrent requests merge) */
+#define RAIN_NOTIFY_PULSE               (1UL << 0)  // the ISR pushed to an empty ring
+#define RAIN_NOTIFY_FLUSH               (1UL << 1)
+#define RAIN_NOTIFY_FORCE_NVS           (1UL << 2)
+#define RAIN_NOTIFY_FORCE_ATTRIBUTE     (1UL << 3)
+
+_Static_assert((RAIN_GAUGE_RING_LEN & (RAIN_GAUGE_RING_LEN - 1)) == 0, "rain ring length must be a power of two");
+
+static TaskHandle_t rain_gauge_task_handle = NULL;
+#if !RAIN_GAUGE_USE_PCNT
+/* Edge timestamps from the ISR (single producer) to rain_gauge_task (single
+ * consumer). head and tail are free-running: only the ISR writes head, only
+ * the task writes tail, so no lock is needed. */
+static TickType_t rain_ring[RAIN_GAUGE_RING_LEN];
+static uint32_t rain_ring_head = 0;
+static uint32_t rain_ring_tail = 0;
+#endif
+static float total_rainfall_mm = 0.0f;
+static uint32_t rain_pulse_count = 0;
+static bool (*rain_gauge_online)(void) = NULL;
+static bool rain_gauge_enabled = false;  // set on the first join, reporting is deferred until then
+#if !RAIN_GAUGE_USE_PCNT
+static bool rain_gauge_isr_installed = false;  // Track ISR installation state
+#endif
+static esp_timer_handle_t rain_flush_timer = NULL;
+#if RAIN_GAUGE_USE_PCNT
+/* Tips are counted in hardware and harvested on each flush request */
+static pulse_counter_handle_t rain_pulse_counter = NULL;
+#endif
+static rain_gauge_stats_t rain_stats;
+
+static void rain_gauge_flush_totals(bool save_to_nvs, bool update_attribute);
+
+static bool rain_gauge_is_online(void)
+{
+    return rain_gauge_online != NULL && rain_gauge_online();
+}
+
+#if RAIN_GAUGE_USE_PCNT
+/* Move the tips counted by PCNT since the last flush into the totals */
+static uint32_t rain_gauge_take_pcnt_pulses(void)
+{
+    uint32_t pulses = 0;
+    if (rain_pulse_counter == NULL || pulse_counter_take(rain_pulse_counter, &pulses) != ESP_OK || pulses == 0) {
+        return 0;
+    }
+
+    rain_pulse_count += pulses;
+    total_rainfall_mm += pulses * RAIN_MM_PER_PULSE;
+    total_rainfall_mm = roundf(total_rainfall_mm * 100.0f) / 100.0f;
+
+    ESP_LOGI(RAIN_TAG, "🌧️ %lu rain pulse(s) from PCNT: #%lu, %.2f mm total (+%.2f mm)",
+             pulses, rain_pulse_count, total_rainfall_mm, pulses * RAIN_MM_PER_PULSE);
+    return pulses;
+}
+#else
+static void IRAM_ATTR rain_gauge_isr_handler(void *arg)
+{
+    uint32_t head = rain_ring_head;
+    uint32_t tail = __atomic_load_n(&rain_ring_tail, __ATOMIC_ACQUIRE);
+
+    rain_stats.edges++;
+    if (head - tail >= RAIN_GAUGE_RING_LEN) {
+        /* Only a bounce burst outruns the task (tips are >= the debounce time
+         * apart), and the edge count above still records it */
+        rain_stats.ring_overruns++;
+        return;
+    }
+    rain_ring[head & (RAIN_GAUGE_RING_LEN - 1)] = xTaskGetTickCountFromISR();
+    __atomic_store_n(&rain_ring_head, head + 1, __ATOMIC_RELEASE);
+
+    /* One notification per batch: while the ring is non-empty the task has
+     * been notified and drains up to the latest head before it blocks again */
+    if (head == tail) {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+        xTaskNotifyFromISR(rain_gauge_task_handle, RAIN_NOTIFY_PULSE, eSetBits, &xHigherPriorityTaskWoken);
+        if (xHigherPriorityTaskWoken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+#endif
+
+static void rain_gauge_task(void *arg)
+{
+    TickType_t last_pulse_time = 0;
+    uint32_t pending_pulse_count = 0;
+    bool pending_nvs_flush = false;
+    bool pending_attr_flush = false;
+    const TickType_t DEBOUNCE_TIME = pdMS_TO_TICKS(RAIN_GAUGE_DEBOUNCE_MS);
+
+    ESP_LOGI(RAIN_TAG, "Rain gauge task started, waiting for events...");
+
+    for (;;) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, portMAX_DELAY);
+
+#if !RAIN_GAUGE_USE_PCNT
+        /* Drain every edge the ISR stored, re-reading head after each one so an
+         * edge pushed while draining is not left behind without a notification */
+        uint32_t tail = rain_ring_tail;
+        while (tail != __atomic_load_n(&rain_ring_head, __ATOMIC_ACQUIRE)) {
+            TickType_t current_time = rain_ring[tail & (RAIN_GAUGE_RING_LEN - 1)];
+            __atomic_store_n(&rain_ring_tail, ++tail, __ATOMIC_RELEASE);
+
+            if ((current_time - last_pulse_time) <= DEBOUNCE_TIME) {
+                rain_stats.debounced++;
+                ESP_LOGD(RAIN_TAG, "Pulse ignored - debounce active (%u ms)",
+                         pdTICKS_TO_MS(current_time - last_pulse_time));
+                continue;
+            }
+
+            last_pulse_time = current_time;
+            pending_pulse_count++;
+            rain_pulse_count++;
+            total_rainfall_mm += RAIN_MM_PER_PULSE;
+            total_rainfall_mm = roundf(total_rainfall_mm * 100.0f) / 100.0f;
+
+            ESP_LOGI(RAIN_TAG, "🌧️ Rain pulse #%u: %.2f mm total (+%.2f mm)",
+                     rain_pulse_count, total_rainfall_mm, RAIN_MM_PER_PULSE);
+
+            pending_nvs_flush = true;
+            if (rain_gauge_enabled && rain_gauge_is_online()) {
+                pending_attr_flush = true;
+            }
+
+            if (pending_pulse_count >= RAIN_PULSE_FLUSH_THRESHOLD) {
+                ESP_LOGD(RAIN_TAG, "Pulse threshold reached (%u) - flushing totals", pending_pulse_count);
+                rain_gauge_flush_totals(pending_nvs_flush, pending_attr_flush);
+                pending_pulse_count = 0;
+                pending_nvs_flush = false;
+                pending_attr_flush = false;
+                if (rain_flush_timer != NULL) {
+                    esp_timer_stop(rain_flush_timer);
+                }
+            } else {
+                if (rain_flush_timer != NULL) {
+                    esp_timer_stop(rain_flush_timer);
+                    esp_timer_start_once(rain_flush_timer, RAIN_FLUSH_INTERVAL_US);
+                }
+            }
+        }
+#endif
+
+        if (bits & RAIN_NOTIFY_FLUSH) {
+#if RAIN_GAUGE_USE_PCNT
+            /* No per-pulse events in PCNT mode: the flush is where tips are counted */
+            if (rain_gauge_take_pcnt_pulses() > 0) {
+                pending_nvs_flush = true;
+                if (rain_gauge_enabled && rain_gauge_is_online()) {
+                    pending_attr_flush = true;
+                }
+            }
+#endif
+            bool do_nvs = pending_nvs_flush || (bits & RAIN_NOTIFY_FORCE_NVS);
+            bool do_attr = pending_attr_flush || (bits & RAIN_NOTIFY_FORCE_ATTRIBUTE);
+
+            if (do_nvs || do_attr) {
+                rain_gauge_flush_totals(do_nvs, do_attr);
+                pending_pulse_count = 0;
+                pending_nvs_flush = false;
+                pending_attr_flush = false;
+            }
+            if (rain_flush_timer != NULL) {
+                esp_timer_stop(rain_flush_timer);
+            }
+        }
+    }
+}
+
+static void rain_flush_timer_callback(void *arg)
+{
+    rain_gauge_request_flush(false, false);
+}
+
+void rain_gauge_request_flush(bool force_nvs, bool force_attribute)
+{
+    if (rain_gauge_task_handle == NULL) {
+        return;
+    }
+
+    /* Requests made before the task gets to them merge into one flush */
+    uint32_t bits = RAIN_NOTIFY_FLUSH;
+    if (force_nvs) {
+        bits |= RAIN_NOTIFY_FORCE_NVS;
+    }
+    if (force_attribute) {
+        bits |= RAIN_NOTIFY_FORCE_ATTRIBUTE;
+    }
+    xTaskNotify(rain_gauge_task_handle, bits, eSetBits);
+}
+
+static void rain_gauge_flush_totals(bool save_to_nvs, bool update_attribute)
+{
+    float rounded_rainfall = roundf(total_rainfall_mm * 100.0f) / 100.0f;
+
+    if (save_to_nvs) {
+        ESP_LOGI(RAIN_TAG, "💾 Flushing rain totals to storage: %.2f mm (%u pulses)",
+                 rounded_rainfall, rain_pulse_count);
+        save_rainfall_data(rounded_rainfall, rain_pulse_count);
+        rain_stats.flushes++;
+    }
+
+    if (update_attribute) {
+        /* Only check network connection, not ISR enabled state
+         * This allows periodic updates even when ISR is temporarily disabled */
+        if (!rain_gauge_is_online()) {
+            ESP_LOGW(RAIN_TAG, "Skipping Zigbee update - network not connected");
+            return;
+        }
+
+        /* CRITICAL: this runs in rain_gauge_task, NOT the Zigbee task. Unlike the
+         * other *_read_and_report() functions (dispatched via esp_zb_scheduler_alarm
+         * and therefore already on the Zigbee thread), the flush must take the stack
+         * lock before calling any esp_zb_* API. Calling it unlocked races with the
+         * Zigbee main loop's critical sections and corrupts port_uxCriticalNesting,
+         * which trips "assert failed: vPortExitCritical (port_uxCriticalNesting[0] > 0)". */
+        esp_err_t ret = attr_cache_set(HA_ESP_RAIN_GAUGE_ENDPOINT, ESP_ZB_ZCL_CLUSTER_ID_ANALOG_INPUT,
+                                       ESP_ZB_ZCL_ATTR_ANALOG_INPUT_PRESENT_VALUE_ID, &rounded_rainfall);
+        attr_cache_flush(true);
+
+        if (ret == ESP_OK) {
+            ESP_LOGI(RAIN_TAG, "📡 Rain gauge attribute cached: %.2f mm (%u pulses)", rounded_rainfall, rain_pulse_count);
+        } else {
+            ESP_LOGE(RAIN_TAG, "❌ Failed to update rain attribute: %s", esp_err_to_name(ret));
+        }
+    }
+}
+
+void rain_gauge_enable(void)
+{
+    rain_gauge_enabled = true;
+#if RAIN_GAUGE_USE_PCNT
+    if (rain_pulse_counter != NULL) {
+        esp_err_t ret = pulse_counter_enable(rain_pulse_counter);
+        if (ret == ESP_OK) {
+            ESP_LOGI(RAIN_TAG, "✅ Rain gauge PCNT counting on GPIO%d", RAIN_GAUGE_GPIO);
+        } else {
+            ESP_LOGE(RAIN_TAG, "❌ Failed to enable rain gauge PCNT: %s", esp_err_to_name(ret));
+        }
+    }
+#else
+    ESP_LOGI(RAIN_TAG, "🔧 Enabling rain gauge ISR on GPIO%d (installed: %s)", RAIN_GAUGE_GPIO, rain_gauge_isr_installed ? "YES" : "NO");
+
+    // Add ISR handler (will succeed even if already added)
+    esp_err_t ret = gpio_isr_handler_add(RAIN_GAUGE_GPIO, rain_gauge_isr_handler, NULL);
+    if (ret == ESP_OK) {
+        rain_gauge_isr_installed = true;
+        ESP_LOGI(RAIN_TAG, "✅ Rain gauge ISR enabled successfully on GPIO%d", RAIN_GAUGE_GPIO);
+        /* Ensure interrupt line is enabled so events will be delivered */
+        gpio_intr_enable(RAIN_GAUGE_GPIO);
+    } else if (ret == ESP_ERR_INVALID_STATE) {
+        // ISR already installed - this is fine
+        rain_gauge_isr_installed = true;
+        ESP_LOGI(RAIN_TAG, "✅ Rain gauge ISR already installed, now enabled");
+        /* Make sure the interrupt line is enabled in case it was disabled */
+        gpio_intr_enable(RAIN_GAUGE_GPIO);
+    } else {
+        ESP_LOGE(RAIN_TAG, "❌ Failed to enable rain gauge ISR: %s", esp_err_to_name(ret));
+    }
+
+    // Test GPIO level at enable time
+    int current_level = gpio_get_level(RAIN_GAUGE_GPIO);
+    ESP_LOGI(RAIN_TAG, "🔌 Current GPIO%d level at enable: %d", RAIN_GAUGE_GPIO, current_level);
+#endif
+}
+
+void rain_gauge_load(void)
+{
+    float loaded_rainfall = 0.0f;
+    uint32_t loaded_pulses = 0;
+    load_rainfall_data(&loaded_rainfall, &loaded_pulses);
+    total_rainfall_mm = roundf(loaded_rainfall * 100.0f) / 100.0f;
+    rain_pulse_count = loaded_pulses;
+    if (loaded_rainfall > 0.0f || loaded_pulses > 0) {
+        ESP_LOGI(RAIN_TAG, "📂 Pre-loaded rainfall for cluster init: %.2f mm (%lu pulses)", total_rainfall_mm, rain_pulse_count);
+    }
+}
+
+float rain_gauge_total_mm(void)
+{
+    return total_rainfall_mm;
+}
+
+uint32_t rain_gauge_pulse_count(void)
+{
+    return rain_pulse_count;
+}
+
+void rain_gauge_set_total(float rainfall_mm)
+{
+    ESP_LOGI(RAIN_TAG, "🔄 Rain gauge reset from Z2M: %.2f mm -> %.2f mm", total_rainfall_mm, rainfall_mm);
+    total_rainfall_mm = rainfall_mm;
+    rain_pulse_count = (uint32_t)(rainfall_mm / RAIN_MM_PER_PULSE);  // Recalculate pulse count
+
+    /* Save to NVS immediately */
+    save_rainfall_data(total_rainfall_mm, rain_pulse_count);
+    ESP_LOGI(RAIN_TAG, "💾 Rain gauge value saved to NVS: %.2f mm (%lu pulses)", total_rainfall_mm, rain_pulse_count);
+}
+
+void rain_gauge_get_stats(rain_gauge_stats_t *stats)
+{
+    *stats = rain_stats;
+}
+
+esp_err_t rain_gauge_init(bool (*online)(void))
+{
+    ESP_LOGI(RAIN_TAG, "Initializing rain gauge on GPIO%d (reporting deferred until network connection)", RAIN_GAUGE_GPIO);
+    rain_gauge_online = online;
+    rain_gauge_enabled = false;
+
+    /* Note: the totals were already loaded by rain_gauge_load() before cluster
+     * creation, so the Zigbee cluster is initialized with the correct value. */
+    ESP_LOGI(RAIN_TAG, "Current rainfall total: %.2f mm (%lu pulses)", total_rainfall_mm, rain_pulse_count);
+
+    /* Check wake reason and count the wake-causing pulse if present. */
+    wake_reason_t wake_reason = check_wake_reason();
+    if (wake_reason == WAKE_REASON_RAIN) {
+        rain_pulse_count++;
+        total_rainfall_mm += RAIN_MM_PER_PULSE;
+        total_rainfall_mm = roundf(total_rainfall_mm * 100.0f) / 100.0f; // Round to 2 decimals
+
+        ESP_LOGI(RAIN_TAG, "🌧️ Rain pulse detected during sleep! Pulse #%u, Total: %.2f mm (+%.2f mm)",
+                 rain_pulse_count, total_rainfall_mm, RAIN_MM_PER_PULSE);
+
+        // Save to NVS immediately when waking from rain
+        save_rainfall_data(total_rainfall_mm, rain_pulse_count);
+    }
+
+    /* Configure GPIO for rain gauge.
+     * The DRV5032 has an OPEN-DRAIN, active-LOW output: it pulls the line to GND
+     * when a magnet is present and is high-impedance otherwise. It therefore
+     * REQUIRES a pull-up to read HIGH at rest. Enable the internal pull-up so the
+     * line is defined even if the board's external pull-up is missing/weak/wrong-
+     * footprint (a floating line was a prime suspect for "rain gauge not working").
+     * The internal pull-up is harmless if an external one is also present.
+     * Counting edge left as POSEDGE: with a pull-up the line rests HIGH and a
+     * bucket tip pulls it LOW briefly, so the rising edge (magnet leaving) is one
+     * count per tip. Verify one tip == one count on the bench via the monitor log. */
+    gpio_config_t io_conf = {
+#if RAIN_GAUGE_USE_PCNT
+        .intr_type = GPIO_INTR_DISABLE,  // rising edges are counted by PCNT
+#else
+        .intr_type = GPIO_INTR_POSEDGE,
+#endif
+        .pin_bit_mask = (1ULL << RAIN_GAUGE_GPIO),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = 1,
+        .pull_down_en = 0,
+    };
+    esp_err_t ret = gpio_config(&io_conf);
+    if (ret != ESP_OK) {
+        ESP_LOGE(RAIN_TAG, "Failed to configure GPIO%d: %s", RAIN_GAUGE_GPIO, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(RAIN_TAG, "✅ GPIO%d configured successfully", RAIN_GAUGE_GPIO);
+
+    /* Read the resting level BEFORE arming the wake source. */
+    int initial_level = gpio_get_level(RAIN_GAUGE_GPIO);
+    ESP_LOGI(RAIN_TAG, "🔌 Initial GPIO%d level: %d", RAIN_GAUGE_GPIO, initial_level);
+
+    /* Enable GPIO wakeup for light sleep - allows rain pulses to wake the device.
+     * CRITICAL: light-sleep GPIO wake is LEVEL-triggered. Arming the level the
+     * pin is ALREADY at makes the wake condition immediately true, so the stack
+     * wakes the instant it tries to sleep - a sleep/wake livelock that starves
+     * the IDLE task and trips the task watchdog. Always arm the OPPOSITE of the
+     * current resting level, so a bucket tip (which toggles the line) wakes us. */
+    gpio_int_type_t wake_level = initial_level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
+    ret = gpio_wakeup_enable(RAIN_GAUGE_GPIO, wake_level);
+    if (ret == ESP_OK) {
+        ESP_LOGI(RAIN_TAG, "✅ GPIO%d armed as light-sleep wake source (wake on %s, resting=%d)",
+                 RAIN_GAUGE_GPIO, wake_level == GPIO_INTR_LOW_LEVEL ? "LOW" : "HIGH", initial_level);
+    } else {
+        ESP_LOGW(RAIN_TAG, "⚠️ Failed to enable GPIO wake: %s", esp_err_to_name(ret));
+    }
+
+    /* Create the rain gauge task before the ISR can notify it (GPIO pulses +
+     * flush requests both arrive as notification bits) */
+    BaseType_t rain_task_ret = xTaskCreate(rain_gauge_task, "rain_gauge_task", 4096, NULL, 5, &rain_gauge_task_handle);
+    if (rain_task_ret != pdPASS) {
+        ESP_LOGE(RAIN_TAG, "Failed to create rain gauge task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Create timer used to flush accumulated pulses */
+    const esp_timer_create_args_t flush_timer_args = {
+        .callback = rain_flush_timer_callback,
+        .name = "rain_flush"
+    };
+    ret = esp_timer_create(&flush_timer_args, &rain_flush_timer);
+    if (ret != ESP_OK) {
+        ESP_LOGE(RAIN_TAG, "Failed to create rain flush timer");
+        return ret;
+    }
+
+#if RAIN_GAUGE_USE_PCNT
+    /* Count rising edges (magnet leaving) in hardware, same edge as the ISR path.
+     * The counter runs while offline; tips are harvested on each flush. */
+    ret = pulse_counter_create(RAIN_GAUGE_GPIO, true, RAIN_GAUGE_PCNT_GLITCH_NS, &rain_pulse_counter);
+    if (ret == ESP_OK) {
+        ret = pulse_counter_enable(rain_pulse_counter);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(RAIN_TAG, "Failed to start rain gauge PCNT: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(RAIN_TAG, "✅ PCNT counter started on GPIO%d (will count pulses while offline)", RAIN_GAUGE_GPIO);
+#else
+    /* Install GPIO ISR service if not already installed */
+    esp_err_t isr_ret = gpio_install_isr_service(0);
+    if (isr_ret == ESP_ERR_INVALID_STATE) {
+        ESP_LOGD(RAIN_TAG, "GPIO ISR service already installed (shared with button driver)");
+    } else if (isr_ret != ESP_OK) {
+        ESP_LOGE(RAIN_TAG, "Failed to install ISR service: %s", esp_err_to_name(isr_ret));
+        return isr_ret;
+    } else {
+        ESP_LOGD(RAIN_TAG, "GPIO ISR service installed successfully");
+    }
+
+    /* Install ISR handler now so pulses occurring after wake (but before
+     * Zigbee network reconnect) are captured in the ring. Reporting is still
+     * deferred until the online callback says we are connected.
+     */
+    esp_err_t add_ret = gpio_isr_handler_add(RAIN_GAUGE_GPIO, rain_gauge_isr_handler, NULL);
+    if (add_ret == ESP_OK) {
+        rain_gauge_isr_installed = true;
+        /* CRITICAL: Enable GPIO interrupt immediately after installing handler!
+         * Without this, pulses won't be detected even though handler is installed. */
+        gpio_intr_enable(RAIN_GAUGE_GPIO);
+        ESP_LOGI(RAIN_TAG, "✅ ISR handler installed early on GPIO%d (will count pulses while offline)", RAIN_GAUGE_GPIO);
+    } else if (add_ret == ESP_ERR_INVALID_STATE) {
+        /* Already installed by some other initialization path - treat as installed */
+        rain_gauge_isr_installed = true;
+        /* Make sure interrupt is enabled even if handler was already present */
+        gpio_intr_enable(RAIN_GAUGE_GPIO);
+        ESP_LOGI(RAIN_TAG, "ℹ️ ISR handler already present for GPIO%d (counting will occur)", RAIN_GAUGE_GPIO);
+    } else {
+        ESP_LOGW(RAIN_TAG, "⚠️ Failed to add ISR handler early: %s - pulses while offline may be missed", esp_err_to_name(add_ret));
+    }
+    ESP_LOGI(RAIN_TAG, "Rain gauge GPIO configured; ISR installed and interrupt enabled for offline counting");
+#endif
+
+    ESP_LOGI(RAIN_TAG, "Rain gauge initialized successfully. Current total: %.2f mm", total_rainfall_mm);
+    ESP_LOGI(RAIN_TAG, "🔧 GPIO%d configured: level=%d, pull-up=enabled, trigger=POSEDGE (%s)",
+             RAIN_GAUGE_GPIO, gpio_get_level(RAIN_GAUGE_GPIO), RAIN_GAUGE_USE_PCNT ? "PCNT" : "ISR");
+
+    /* Initial rain value will be reported after network join (see signal handler) */
+    ESP_LOGI(RAIN_TAG, "Rain gauge ready - initial report will occur after network connection");
+    return ESP_OK;
+}
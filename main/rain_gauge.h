@@ -0,0 +1,90 @@
+/*
+ * Rain gauge (DRV5032 reed/hall switch on RAIN_GAUGE_GPIO)
+ * Counts bucket tips through the GPIO ISR and a lock-free ring of edge ticks
+ * (or in the PCNT peripheral with RAIN_GAUGE_USE_PCNT), debounces them in its
+ * own task, woken by task notifications once per batch of edges, and flushes
+ * the running total to storage and to the EP2 presentValue, batched by a tip
+ * threshold and an idle timer. Tips are counted while off the network;
+ * the attribute is only written while the online callback says so.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RAIN_MM_PER_PULSE               (CONFIG_CAELUM_RAIN_UM_PER_PULSE / 1000.0f)   // mm of rain per bucket tip (Kconfig, 0.36 mm default)
+#define RAIN_GAUGE_DEBOUNCE_MS          200     // edges closer than this to the last tip are bounce
+#define RAIN_PULSE_FLUSH_THRESHOLD      10U     // tips that force a flush
+#define RAIN_FLUSH_INTERVAL_US          (10ULL * 1000ULL * 1000ULL)  // flush this long after the last tip
+#define RAIN_GAUGE_RING_LEN             32      // edge timestamps buffered for the task (power of two)
+
+typedef struct {
+    uint32_t edges;                 // edges seen by the ISR (0 with PCNT)
+    uint32_t debounced;             // edges dropped as bounce
+    uint32_t ring_overruns;         // edges without a timestamp because the ring was full
+    uint32_t flushes;               // totals written to storage
+} rain_gauge_stats_t;
+
+/**
+ * @brief Load the totals from RTC memory, the rain log or NVS
+ *
+ * Call before the clusters are created so EP2 starts with the stored total.
+ */
+void rain_gauge_load(void);
+
+/**
+ * @brief Configure the GPIO, light-sleep wake, ISR or PCNT, flush timer and task
+ *
+ * Blocking: run it off the Zigbee task. A tip that woke the device from sleep
+ * is counted here.
+ *
+ * @param online Returns true while attribute updates can be sent
+ * @return ESP_OK on success
+ */
+esp_err_t rain_gauge_init(bool (*online)(void));
+
+/**
+ * @brief (Re)arm tip counting after a join
+ */
+void rain_gauge_enable(void);
+
+/**
+ * @brief Ask the rain task to flush the pending totals
+ *
+ * @param force_nvs Write storage even without new tips
+ * @param force_attribute Write the attribute even without new tips
+ */
+void rain_gauge_request_flush(bool force_nvs, bool force_attribute);
+
+/**
+ * @brief Total rainfall in mm (rounded to 0.01)
+ */
+float rain_gauge_total_mm(void);
+
+/**
+ * @brief Tips counted since the last reset
+ */
+uint32_t rain_gauge_pulse_count(void);
+
+/**
+ * @brief Replace the total (coordinator write) and save it
+ *
+ * @param rainfall_mm New total, the tip count is derived from it
+ */
+void rain_gauge_set_total(float rainfall_mm);
+
+/**
+ * @brief Counters of the edges that did not become a tip
+ */
+void rain_gauge_get_stats(rain_gauge_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
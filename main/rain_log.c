@@ -0,0 +1,212 @@
+/*
+ * Append-only rainfall counter log
+ */
+
+#include <string.h>
+#include <time.h>
+#include "rain_log.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "RAIN_LOG";
+
+#define RAIN_LOG_CRC_LEN        offsetof(rain_log_record_t, crc32)
+
+_Static_assert(sizeof(rain_log_record_t) == RAIN_LOG_RECORD_SIZE, "rain log record must stay 32 bytes");
+
+static const esp_partition_t *s_part = NULL;
+static SemaphoreHandle_t s_mutex = NULL;
+static size_t s_slots = 0;                  // records the partition can hold
+static size_t s_head = 0;                   // next slot to write
+static size_t s_latest_slot = 0;
+static rain_log_record_t s_latest;
+static bool s_have_latest = false;
+static size_t s_count = 0;                  // valid records in the partition
+
+static uint32_t record_crc(const rain_log_record_t *rec)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, RAIN_LOG_CRC_LEN);
+}
+
+static bool record_blank(const rain_log_record_t *rec)
+{
+    const uint8_t *p = (const uint8_t *)rec;
+    for (size_t i = 0; i < sizeof(*rec); i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static bool record_valid(const rain_log_record_t *rec)
+{
+    return rec->seq != 0xFFFFFFFFU && rec->crc32 == record_crc(rec);
+}
+
+static esp_err_t read_slot(size_t slot, rain_log_record_t *rec)
+{
+    return esp_partition_read(s_part, slot * RAIN_LOG_RECORD_SIZE, rec, sizeof(*rec));
+}
+
+/* Erase the sector starting at slot, dropping its (oldest) records from the count */
+static esp_err_t erase_sector_at(size_t slot)
+{
+    rain_log_record_t rec;
+    for (size_t i = slot; i < slot + RAIN_LOG_RECORDS_PER_SECTOR; i++) {
+        if (read_slot(i, &rec) == ESP_OK && record_valid(&rec) && s_count > 0) {
+            s_count--;
+        }
+    }
+    return esp_partition_erase_range(s_part, slot * RAIN_LOG_RECORD_SIZE, RAIN_LOG_SECTOR_SIZE);
+}
+
+esp_err_t rain_log_init(void)
+{
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, RAIN_LOG_PARTITION_SUBTYPE, RAIN_LOG_PARTITION_LABEL);
+    if (s_part == NULL) {
+        ESP_LOGW(TAG, "⚠️ No '%s' partition - rain totals fall back to NVS", RAIN_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (s_part->size < 2 * RAIN_LOG_SECTOR_SIZE || s_part->size % RAIN_LOG_SECTOR_SIZE != 0) {
+        ESP_LOGE(TAG, "Partition '%s' must be a multiple of %d bytes, at least two sectors",
+                 RAIN_LOG_PARTITION_LABEL, RAIN_LOG_SECTOR_SIZE);
+        s_part = NULL;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_mutex == NULL) {
+        s_mutex = xSemaphoreCreateMutex();
+        if (s_mutex == NULL) {
+            s_part = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    s_slots = s_part->size / RAIN_LOG_RECORD_SIZE;
+    s_have_latest = false;
+    s_count = 0;
+    size_t damaged = 0;
+    rain_log_record_t rec;
+    for (size_t slot = 0; slot < s_slots; slot++) {
+        if (read_slot(slot, &rec) != ESP_OK || record_blank(&rec)) continue;
+        if (!record_valid(&rec)) {
+            damaged++;
+            continue;
+        }
+        s_count++;
+        if (!s_have_latest || rec.seq > s_latest.seq) {
+            s_latest = rec;
+            s_latest_slot = slot;
+            s_have_latest = true;
+        }
+    }
+    s_head = s_have_latest ? (s_latest_slot + 1) % s_slots : 0;
+
+    if (s_have_latest) {
+        ESP_LOGI(TAG, "📂 %u records, newest #%lu: %.2f mm, %lu tips (%u damaged)", (unsigned)s_count,
+                 (unsigned long)s_latest.seq, s_latest.rainfall_mm, (unsigned long)s_latest.pulse_count, (unsigned)damaged);
+    } else {
+        ESP_LOGI(TAG, "📂 Log empty (%u slots)", (unsigned)s_slots);
+    }
+    return ESP_OK;
+}
+
+esp_err_t rain_log_append(float rainfall_mm, uint32_t pulse_count, uint16_t flags)
+{
+    if (s_part == NULL) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_have_latest && flags == 0 && pulse_count == s_latest.pulse_count && rainfall_mm == s_latest.rainfall_mm) {
+        xSemaphoreGive(s_mutex);
+        return ESP_OK;      // nothing new, save the write
+    }
+
+    rain_log_record_t rec;
+    memset(&rec, 0xFF, sizeof(rec));
+    rec.seq = s_have_latest ? s_latest.seq + 1 : 0;
+    rec.time_s = (uint32_t)time(NULL);
+    rec.pulse_count = pulse_count;
+    rec.rainfall_mm = rainfall_mm;
+    rec.flags = flags;
+    uint32_t tips = pulse_count;
+    if (s_have_latest) {
+        if (pulse_count < s_latest.pulse_count || rainfall_mm < s_latest.rainfall_mm) {
+            rec.flags |= RAIN_LOG_FLAG_RESET;
+        } else {
+            tips = pulse_count - s_latest.pulse_count;
+        }
+    }
+    rec.tips = tips > 0xFFFF ? 0xFFFF : (uint16_t)tips;
+    rec.crc32 = record_crc(&rec);
+
+    /* Skip slots left dirty by a torn write; entering a sector erases it first */
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    rain_log_record_t probe;
+    for (size_t tries = 0; tries < s_slots; tries++) {
+        if (s_head % RAIN_LOG_RECORDS_PER_SECTOR == 0) {
+            ret = erase_sector_at(s_head);
+            if (ret != ESP_OK) break;
+        } else if (read_slot(s_head, &probe) != ESP_OK || !record_blank(&probe)) {
+            s_head = (s_head + 1) % s_slots;
+            continue;
+        }
+        ret = esp_partition_write(s_part, s_head * RAIN_LOG_RECORD_SIZE, &rec, sizeof(rec));
+        break;
+    }
+
+    if (ret == ESP_OK) {
+        s_latest = rec;
+        s_latest_slot = s_head;
+        s_have_latest = true;
+        s_count++;
+        s_head = (s_head + 1) % s_slots;
+        ESP_LOGD(TAG, "#%lu: %.2f mm, %lu tips (+%u)", (unsigned long)rec.seq, rainfall_mm,
+                 (unsigned long)pulse_count, rec.tips);
+    } else {
+        ESP_LOGE(TAG, "❌ Append failed: %s", esp_err_to_name(ret));
+    }
+    xSemaphoreGive(s_mutex);
+    return ret;
+}
+
+bool rain_log_latest(rain_log_record_t *rec)
+{
+    if (s_part == NULL || !s_have_latest) return false;
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    *rec = s_latest;
+    xSemaphoreGive(s_mutex);
+    return true;
+}
+
+size_t rain_log_count(void)
+{
+    return s_part ? s_count : 0;
+}
+
+esp_err_t rain_log_read(size_t back, rain_log_record_t *rec)
+{
+    if (s_part == NULL) return ESP_ERR_INVALID_STATE;
+    if (!s_have_latest || back >= s_count) return ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    /* Walk back over valid records, stepping over blank or torn slots */
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    uint32_t want_seq = s_latest.seq - (uint32_t)back;
+    size_t slot = s_latest_slot;
+    for (size_t i = 0; i < s_slots; i++) {
+        if (read_slot(slot, rec) == ESP_OK && record_valid(rec)) {
+            if (rec->seq == want_seq) {
+                ret = ESP_OK;
+                break;
+            }
+            if (rec->seq < want_seq) {
+                ret = ESP_ERR_INVALID_CRC;      // the wanted record was damaged
+                break;
+            }
+        }
+        slot = (slot == 0 ? s_slots : slot) - 1;
+    }
+    xSemaphoreGive(s_mutex);
+    return ret;
+}
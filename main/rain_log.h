@@ -0,0 +1,89 @@
+/*
+ * Append-only rainfall counter log
+ * Rain totals are written as fixed-size records to a small raw partition
+ * ("rain_log") instead of rewriting NVS keys. Each record carries a sequence
+ * number and a CRC32; the newest valid record is found by scanning the
+ * partition at boot, and the oldest sector is erased when the log wraps, so
+ * every sector sees one erase per RAIN_LOG_RECORDS_PER_SECTOR appends. The
+ * records double as a timestamped tip history.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RAIN_LOG_PARTITION_LABEL        "rain_log"
+#define RAIN_LOG_PARTITION_SUBTYPE      0x40    // custom data subtype, see partitions.csv
+#define RAIN_LOG_SECTOR_SIZE            4096
+#define RAIN_LOG_RECORD_SIZE            32
+#define RAIN_LOG_RECORDS_PER_SECTOR     (RAIN_LOG_SECTOR_SIZE / RAIN_LOG_RECORD_SIZE)
+
+#define RAIN_LOG_FLAG_RESET             0x0001  // totals went down (coordinator reset)
+#define RAIN_LOG_FLAG_MIGRATED          0x0002  // first record, copied from the old NVS keys
+
+typedef struct {
+    uint32_t seq;               // increments with every append, never 0xFFFFFFFF
+    uint32_t time_s;            // system time (time()) of the append
+    uint32_t pulse_count;       // total tips
+    float rainfall_mm;          // total rainfall
+    uint16_t tips;              // tips since the previous record
+    uint16_t flags;             // RAIN_LOG_FLAG_*
+    uint32_t reserved[2];       // 0xFF, keeps the record at 32 bytes
+    uint32_t crc32;             // CRC32 of the preceding bytes
+} rain_log_record_t;
+
+/**
+ * @brief Find the partition and recover the newest record
+ *
+ * Call once after nvs_flash_init(). A torn last write fails its CRC and is
+ * skipped, so the previous record becomes the newest one.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if the partition table has no rain_log entry
+ */
+esp_err_t rain_log_init(void);
+
+/**
+ * @brief Append the current totals
+ *
+ * The number of tips since the previous record and the reset flag are derived
+ * from the newest record.
+ *
+ * @param rainfall_mm Total rainfall
+ * @param pulse_count Total tips
+ * @param flags Extra RAIN_LOG_FLAG_* bits
+ * @return ESP_OK, ESP_ERR_INVALID_STATE before rain_log_init() succeeded
+ */
+esp_err_t rain_log_append(float rainfall_mm, uint32_t pulse_count, uint16_t flags);
+
+/**
+ * @brief Newest record
+ *
+ * @param rec Receives the record
+ * @return true if the log holds at least one valid record
+ */
+bool rain_log_latest(rain_log_record_t *rec);
+
+/**
+ * @brief Number of records currently held (at most one sector less than the partition)
+ */
+size_t rain_log_count(void);
+
+/**
+ * @brief Read the history, newest first
+ *
+ * @param back 0 = newest, 1 = the one before, ...
+ * @param rec Receives the record
+ * @return ESP_OK, ESP_ERR_NOT_FOUND past the oldest record, ESP_ERR_INVALID_CRC for a damaged one
+ */
+esp_err_t rain_log_read(size_t back, rain_log_record_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
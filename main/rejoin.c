@@ -0,0 +1,159 @@
+/*
+ * Rejoin policy
+ */
+
+#include <string.h>
+#include "rejoin.h"
+#include "esp_log.h"
+#include "esp_random.h"
+
+static const char *TAG = "REJOIN";
+
+#define CHANNEL_MIN     11
+#define CHANNEL_MAX     26
+
+static rejoin_config_t s_cfg;
+static uint8_t s_channel = 0;
+static bool s_in_outage = false;
+static int64_t s_outage_start_us = 0;
+static uint32_t s_planned = 0;              // attempts planned in this outage
+static rejoin_phase_t s_planned_phase = REJOIN_PHASE_NONE;
+static bool s_running = false;
+static int64_t s_started_us = 0;
+static rejoin_phase_t s_running_phase = REJOIN_PHASE_NONE;
+static uint16_t s_attempts = 0;             // attempts started in this outage
+static uint32_t s_scan_ms = 0;
+static rejoin_stats_t s_stats;
+
+static bool channel_valid(uint8_t channel)
+{
+    return channel >= CHANNEL_MIN && channel <= CHANNEL_MAX;
+}
+
+/* base * 2^n, saturating at cap */
+static uint32_t doubled(uint32_t base, uint32_t n, uint32_t cap)
+{
+    uint32_t delay = base;
+    while (n-- > 0 && delay < cap) {
+        delay = delay > cap / 2 ? cap : delay * 2;
+    }
+    return delay < cap ? delay : cap;
+}
+
+static uint32_t jittered(uint32_t delay_ms)
+{
+    uint32_t span = (uint32_t)((uint64_t)delay_ms * s_cfg.jitter_percent / 100);
+    if (span == 0) return delay_ms;
+    return delay_ms - span + esp_random() % (2 * span + 1);
+}
+
+void rejoin_init(const rejoin_config_t *config, uint8_t last_channel)
+{
+    s_cfg = *config;
+    s_channel = channel_valid(last_channel) ? last_channel : 0;
+    s_in_outage = false;
+    s_planned = 0;
+    s_running = false;
+    memset(&s_stats, 0, sizeof(s_stats));
+    if (s_channel) {
+        ESP_LOGI(TAG, "Last join on channel %u", s_channel);
+    }
+}
+
+void rejoin_link_lost(int64_t now_us)
+{
+    if (s_in_outage) return;
+    s_in_outage = true;
+    s_outage_start_us = now_us;
+    s_planned = 0;
+    s_attempts = 0;
+    s_scan_ms = 0;
+}
+
+bool rejoin_in_outage(void)
+{
+    return s_in_outage;
+}
+
+rejoin_attempt_t rejoin_plan_next(uint8_t battery_percent)
+{
+    rejoin_attempt_t next;
+    uint32_t fast = s_cfg.fast_attempts;
+
+    if (s_planned < fast) {
+        /* Quick retries, on the last channel once there has been a join */
+        next.phase = s_channel ? REJOIN_PHASE_LAST_CHANNEL : REJOIN_PHASE_ALL_CHANNELS;
+        next.channel_mask = s_channel ? 1UL << s_channel : s_cfg.all_channels_mask;
+        next.delay_ms = doubled(s_cfg.fast_delay_ms, s_planned, s_cfg.backoff_base_ms);
+    } else {
+        bool low = battery_percent != 0xFF && battery_percent < s_cfg.low_battery_percent;
+        uint32_t cap = low ? s_cfg.backoff_low_battery_max_ms : s_cfg.backoff_max_ms;
+        next.phase = REJOIN_PHASE_ALL_CHANNELS;
+        next.channel_mask = s_cfg.all_channels_mask;
+        next.delay_ms = doubled(s_cfg.backoff_base_ms, s_planned - fast, cap);
+    }
+    next.delay_ms = jittered(next.delay_ms);
+    s_planned++;
+    s_planned_phase = next.phase;
+    return next;
+}
+
+void rejoin_attempt_started(int64_t now_us)
+{
+    s_running = true;
+    s_started_us = now_us;
+    s_running_phase = s_planned_phase != REJOIN_PHASE_NONE ? s_planned_phase : REJOIN_PHASE_ALL_CHANNELS;
+    s_planned_phase = REJOIN_PHASE_NONE;
+    if (s_attempts < UINT16_MAX) s_attempts++;
+}
+
+uint32_t rejoin_attempt_finished(bool joined, uint8_t channel, int64_t now_us)
+{
+    uint32_t duration_ms = 0;
+    if (s_running) {
+        duration_ms = (uint32_t)((now_us - s_started_us) / 1000);
+        s_scan_ms += duration_ms;
+        s_running = false;
+    }
+    if (!joined) return duration_ms;
+
+    if (channel_valid(channel)) s_channel = channel;
+    if (s_in_outage) {
+        s_stats.attempts = s_attempts;
+        s_stats.scan_ms = s_scan_ms;
+        s_stats.outage_s = (uint32_t)((now_us - s_outage_start_us) / 1000000LL);
+        s_stats.phase = s_running_phase;
+        s_stats.rejoins++;
+        ESP_LOGI(TAG, "🔗 Back online after %lu s: %u attempt(s), %lu ms scanning, joined with a %s scan",
+                 (unsigned long)s_stats.outage_s, s_stats.attempts, (unsigned long)s_stats.scan_ms,
+                 s_stats.phase == REJOIN_PHASE_LAST_CHANNEL ? "last-channel" : "full");
+    }
+    s_in_outage = false;
+    s_planned = 0;
+    return duration_ms;
+}
+
+uint16_t rejoin_outage_attempts(void)
+{
+    return s_in_outage ? s_attempts : 0;
+}
+
+bool rejoin_attempt_running(void)
+{
+    return s_running;
+}
+
+int64_t rejoin_attempt_started_us(void)
+{
+    return s_running ? s_started_us : 0;
+}
+
+uint8_t rejoin_last_channel(void)
+{
+    return s_channel;
+}
+
+const rejoin_stats_t *rejoin_get_stats(void)
+{
+    return &s_stats;
+}
@@ -0,0 +1,126 @@
+/*
+ * Rejoin policy
+ * Decides where and when the next rejoin attempt happens after the link is
+ * lost. The first few attempts follow each other quickly and only scan the
+ * channel of the last good join (every channel before the first join), which
+ * is a fraction of the radio time of a scan across every channel; after that
+ * the full mask is scanned with an exponential, jittered back-off whose cap is
+ * raised when the battery is low. Each attempt's duration and outcome are
+ * accumulated per outage for the diagnostics cluster. No Zigbee calls are made
+ * here; the caller sets the channel mask and starts steering.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    REJOIN_PHASE_NONE = 0,
+    REJOIN_PHASE_LAST_CHANNEL,      // scan only the channel of the last join
+    REJOIN_PHASE_ALL_CHANNELS,      // scan the full mask
+} rejoin_phase_t;
+
+typedef struct {
+    uint32_t all_channels_mask;     // mask for a full scan
+    uint8_t fast_attempts;          // quick attempts (last channel if known) before the back-off
+    uint32_t fast_delay_ms;         // before the first fast attempt, doubled for each further one
+    uint32_t backoff_base_ms;       // before the first full scan, doubled for each further one
+    uint32_t backoff_max_ms;        // back-off cap
+    uint32_t backoff_low_battery_max_ms;    // back-off cap below low_battery_percent
+    uint8_t low_battery_percent;
+    uint8_t jitter_percent;         // each delay is randomised by +/- this much
+} rejoin_config_t;
+
+typedef struct {
+    rejoin_phase_t phase;
+    uint32_t channel_mask;
+    uint32_t delay_ms;              // wait this long before starting it
+} rejoin_attempt_t;
+
+typedef struct {
+    uint16_t attempts;              // attempts in the last completed outage
+    uint32_t scan_ms;               // time spent in those attempts
+    uint32_t outage_s;              // from link loss to the successful join
+    rejoin_phase_t phase;           // phase of the attempt that succeeded
+    uint16_t rejoins;               // completed outages since boot
+} rejoin_stats_t;
+
+/**
+ * @brief Set the policy and the channel of the last join (0 if unknown)
+ *
+ * @param config Policy (copied)
+ * @param last_channel Channel 11-26, or 0 to go straight to full scans
+ */
+void rejoin_init(const rejoin_config_t *config, uint8_t last_channel);
+
+/**
+ * @brief Start an outage, unless one is already running
+ *
+ * @param now_us Current esp_timer time
+ */
+void rejoin_link_lost(int64_t now_us);
+
+/**
+ * @brief True between rejoin_link_lost() and a successful join
+ */
+bool rejoin_in_outage(void);
+
+/**
+ * @brief Plan the next attempt of the current outage
+ *
+ * @param battery_percent 0-100, 0xFF if unknown
+ * @return Where and when to scan
+ */
+rejoin_attempt_t rejoin_plan_next(uint8_t battery_percent);
+
+/**
+ * @brief An attempt planned by rejoin_plan_next() is starting now
+ */
+void rejoin_attempt_started(int64_t now_us);
+
+/**
+ * @brief The running attempt has finished
+ *
+ * On success the outage is closed, its totals become the stats and the
+ * channel is remembered for the next outage.
+ *
+ * @param joined Steering succeeded
+ * @param channel Channel joined on (ignored on failure)
+ * @param now_us Current esp_timer time
+ * @return Duration of the attempt in ms (0 if none was running)
+ */
+uint32_t rejoin_attempt_finished(bool joined, uint8_t channel, int64_t now_us);
+
+/**
+ * @brief Attempts started in the current outage
+ */
+uint16_t rejoin_outage_attempts(void);
+
+/**
+ * @brief True while an attempt is running
+ */
+bool rejoin_attempt_running(void);
+
+/**
+ * @brief Start time of the running attempt (esp_timer us), 0 if none
+ */
+int64_t rejoin_attempt_started_us(void);
+
+/**
+ * @brief Channel of the last join, 0 if unknown
+ */
+uint8_t rejoin_last_channel(void);
+
+/**
+ * @brief Totals of the last completed outage
+ */
+const rejoin_stats_t *rejoin_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
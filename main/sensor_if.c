@@ -1,14 +1,171 @@
 #include "sensor_if.h"
 #include "sht41.h"
+#include "aht20.h"
 #include "lps22hb.h"
+#include "dps368.h"
+#include "bmp280.h"
+#include "bme280_app.h"
 #include "esp_log.h"
 #include "i2c_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <stdio.h>
 
 static const char *TAG = "SENSOR_IF";
-static sensor_type_t detected = SENSOR_TYPE_NONE;
-static bool sht41_available = false;
-static bool lps22hb_available = false;
+
+#define SENSOR_SCAN_MAX         32
+#define SENSOR_FETCH_RETRIES    10  // status polls for a conversion that runs past its modelled time
+#define SENSOR_FETCH_RETRY_MS   1   // one status read costs ~100 us at 400 kHz
+
+#define US_TO_MS_CEIL(us)       (((us) + 999) / 1000)
+
+/* ---- Per-driver adapters ------------------------------------------------ */
+
+/* Ready times come from each chip's current oversampling/precision settings.
+ * Chips with a data-ready bit (BMP280 STATUS, LPS22HB STATUS, DPS368 MEAS_CFG,
+ * AHT20 busy flag) are then polled by fetch; the SHT4x has none, so its time is
+ * the datasheet maximum. */
+static uint32_t sht41_ready_ms(void)   { return US_TO_MS_CEIL(sht41_get_measure_time_us()); }
+static uint32_t aht20_ready_ms(void)   { return AHT20_MEASURE_TIME_MS; }
+static uint32_t lps22hb_ready_ms(void) { return LPS22HB_ONE_SHOT_TIME_MS; }
+static uint32_t dps368_ready_ms(void)  { return US_TO_MS_CEIL(dps368_get_measure_time_us()); }
+static uint32_t bmp280_ready_ms(void)  { return US_TO_MS_CEIL(bmp280_get_measure_time_us()); }
+static uint32_t no_wait_ms(void)       { return 0; }   // result valid when trigger returns
+
+static esp_err_t sht41_read(sensor_quantity_t qty, float *out)
+{
+    return qty == SENSOR_QTY_TEMPERATURE ? sht41_read_temperature(out) : sht41_read_humidity(out);
+}
+
+static esp_err_t aht20_read(sensor_quantity_t qty, float *out)
+{
+    return qty == SENSOR_QTY_TEMPERATURE ? aht20_read_temperature(out) : aht20_read_humidity(out);
+}
+
+static esp_err_t lps22hb_read(sensor_quantity_t qty, float *out)
+{
+    return qty == SENSOR_QTY_TEMPERATURE ? lps22hb_read_temperature(out) : lps22hb_read_pressure(out);
+}
+
+static esp_err_t dps368_read(sensor_quantity_t qty, float *out)
+{
+    return qty == SENSOR_QTY_TEMPERATURE ? dps368_read_temperature(out) : dps368_read_pressure(out);
+}
+
+static esp_err_t bmp280_read(sensor_quantity_t qty, float *out)
+{
+    return qty == SENSOR_QTY_TEMPERATURE ? bmp280_read_temperature(out) : bmp280_read_pressure(out);
+}
+
+static esp_err_t bme280_probe(i2c_bus_handle_t bus)
+{
+    esp_err_t ret = bme280_app_init(bus);
+    if (ret == ESP_OK && bme280_app_is_bmp280()) {
+        /* Same footprint, no humidity: leave it to the lighter BMP280 driver */
+        bme280_app_deinit();
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ret;
+}
+
+static esp_err_t bme280_read(sensor_quantity_t qty, float *out)
+{
+    switch (qty) {
+        case SENSOR_QTY_TEMPERATURE: return bme280_app_read_temperature(out);
+        case SENSOR_QTY_HUMIDITY:    return bme280_app_read_humidity(out);
+        default:                     return bme280_app_read_pressure(out);
+    }
+}
+
+/* ---- Registry ----------------------------------------------------------- */
+
+/* Probe order matters where addresses are shared (0x76/0x77): each probe checks
+ * the chip ID and returns ESP_ERR_NOT_FOUND for a foreign part. Ranks follow
+ * datasheet accuracy: SHT4x for T/RH, DPS368 for pressure. */
+static const sensor_driver_t s_drivers[] = {
+    {
+        .name = "SHT4x", .addr = { 0x44, 0 },
+        .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_HUMIDITY,
+        .rank = { [SENSOR_QTY_TEMPERATURE] = 6, [SENSOR_QTY_HUMIDITY] = 3 },
+        .probe = sht41_init, .trigger = sht41_start_measurement, .ready_ms = sht41_ready_ms,
+        .fetch = sht41_fetch_measurement, .read = sht41_read, .sleep = NULL,   // idles after each conversion
+    },
+    {
+        .name = "AHT20", .addr = { 0x38, 0 },
+        .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_HUMIDITY,
+        .rank = { [SENSOR_QTY_TEMPERATURE] = 5, [SENSOR_QTY_HUMIDITY] = 2 },
+        .probe = aht20_init, .trigger = aht20_start_measurement, .ready_ms = aht20_ready_ms,
+        .fetch = aht20_fetch_measurement, .read = aht20_read, .sleep = NULL,
+    },
+    {
+        .name = "DPS368", .addr = { DPS368_I2C_ADDR, 0 },
+        .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_PRESSURE,
+        .rank = { [SENSOR_QTY_TEMPERATURE] = 4, [SENSOR_QTY_PRESSURE] = 4 },
+        .probe = dps368_init, .trigger = dps368_start_measurement, .ready_ms = dps368_ready_ms,
+        .fetch = dps368_fetch_measurement, .read = dps368_read, .sleep = dps368_sleep,
+        .background = dps368_start_fifo,
+    },
+    {
+        .name = "LPS22HB", .addr = { LPS22HB_I2C_ADDR, 0 },
+        .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_PRESSURE,
+        .rank = { [SENSOR_QTY_TEMPERATURE] = 1, [SENSOR_QTY_PRESSURE] = 3 },
+        .probe = lps22hb_init, .trigger = lps22hb_start_measurement, .ready_ms = lps22hb_ready_ms,
+        .fetch = lps22hb_fetch_measurement, .read = lps22hb_read, .sleep = NULL, // one-shot, powers down
+        .background = lps22hb_start_fifo,
+    },
+    {
+        .name = "BME280", .addr = { 0x76, 0 },
+        .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_HUMIDITY | SENSOR_CAP_PRESSURE,
+        .rank = { [SENSOR_QTY_TEMPERATURE] = 3, [SENSOR_QTY_HUMIDITY] = 1, [SENSOR_QTY_PRESSURE] = 2 },
+        .probe = bme280_probe, .trigger = bme280_app_start_measurement, .ready_ms = no_wait_ms,
+        .fetch = NULL, .read = bme280_read, .sleep = bme280_app_sleep,
+    },
+    {
+        .name = "BMP280", .addr = { 0x76, 0x77 },
+        .caps = SENSOR_CAP_TEMPERATURE | SENSOR_CAP_PRESSURE,
+        .rank = { [SENSOR_QTY_TEMPERATURE] = 2, [SENSOR_QTY_PRESSURE] = 1 },
+        .probe = bmp280_init, .trigger = bmp280_start_measurement, .ready_ms = bmp280_ready_ms,
+        .fetch = bmp280_fetch_measurement, .read = bmp280_read, .sleep = NULL,  // forced mode
+    },
+};
+
+#define SENSOR_DRIVER_COUNT (sizeof(s_drivers) / sizeof(s_drivers[0]))
+
+static bool s_present[SENSOR_DRIVER_COUNT];
+static bool s_active[SENSOR_DRIVER_COUNT];              // selected for at least one quantity
+static bool s_background[SENSOR_DRIVER_COUNT];          // sampling into its FIFO, never triggered
+static const sensor_driver_t *s_source[SENSOR_QTY_COUNT];
+
+static bool addr_in_scan(const uint8_t *found, int count, const sensor_driver_t *drv)
+{
+    for (int a = 0; a < 2; a++) {
+        if (drv->addr[a] == 0) continue;
+        for (int i = 0; i < count; i++) {
+            if (found[i] == drv->addr[a]) return true;
+        }
+    }
+    return false;
+}
+
+/* Best present driver for a quantity; with prefer_active, only chips that are
+ * already being read for another quantity are considered. */
+static int pick_source(sensor_quantity_t qty, bool prefer_active)
+{
+    int best = -1;
+    for (size_t i = 0; i < SENSOR_DRIVER_COUNT; i++) {
+        if (!s_present[i] || !(s_drivers[i].caps & (1 << qty))) continue;
+        if (prefer_active && !s_active[i]) continue;
+        if (best < 0 || s_drivers[i].rank[qty] > s_drivers[best].rank[qty]) best = (int)i;
+    }
+    return best;
+}
+
+static void select_source(sensor_quantity_t qty, int idx)
+{
+    if (idx < 0) return;
+    s_source[qty] = &s_drivers[idx];
+    s_active[idx] = true;
+}
 
 esp_err_t sensor_init(i2c_bus_handle_t i2c_bus)
 {
@@ -17,104 +174,200 @@ esp_err_t sensor_init(i2c_bus_handle_t i2c_bus)
         return ESP_ERR_INVALID_ARG;
     }
 
-    detected = SENSOR_TYPE_NONE;
-    sht41_available = false;
-    lps22hb_available = false;
-
-    // Diagnostic scan: list all devices on the bus to help debug NACKs
-    uint8_t found[32];
+    /* One scan decides which drivers get probed at all: absent chips cost no
+     * transaction (and no NACK timeout) at boot. */
+    uint8_t found[SENSOR_SCAN_MAX];
     int n = i2c_bus_scan(i2c_bus, found, sizeof(found));
     if (n == 0) {
         ESP_LOGW(TAG, "I2C scan: no devices found on bus");
-    } else {
-        char buf[128];
-        int off = 0;
-        off += snprintf(buf + off, sizeof(buf) - off, "I2C scan: %d device(s):", n);
-        for (int i = 0; i < n; ++i) off += snprintf(buf + off, sizeof(buf) - off, " 0x%02x", found[i]);
-        ESP_LOGI(TAG, "%s", buf);
+        for (size_t i = 0; i < SENSOR_DRIVER_COUNT; i++) s_present[i] = s_active[i] = s_background[i] = false;
+        for (int q = 0; q < SENSOR_QTY_COUNT; q++) s_source[q] = NULL;
+        return ESP_ERR_NOT_FOUND;
     }
+    char buf[128];
+    int off = 0;
+    off += snprintf(buf + off, sizeof(buf) - off, "I2C scan: %d device(s):", n);
+    for (int i = 0; i < n; ++i) off += snprintf(buf + off, sizeof(buf) - off, " 0x%02x", found[i]);
+    ESP_LOGI(TAG, "%s", buf);
 
-    ESP_LOGI(TAG, "Probing for SHT4x...");
-    if (sht41_init(i2c_bus) == ESP_OK) {
-        sht41_available = true;
-        ESP_LOGI(TAG, "SHT4x probe OK");
-    } else {
-        ESP_LOGW(TAG, "SHT4x not found or init failed");
+    return sensor_init_from_scan(i2c_bus, found, n, SENSOR_DRIVERS_ALL);
+}
+
+esp_err_t sensor_init_from_scan(i2c_bus_handle_t i2c_bus, const uint8_t *found, int count, uint32_t driver_mask)
+{
+    if (!i2c_bus || (!found && count > 0)) return ESP_ERR_INVALID_ARG;
+
+    for (size_t i = 0; i < SENSOR_DRIVER_COUNT; i++) {
+        s_present[i] = false;
+        s_active[i] = false;
+        s_background[i] = false;
     }
+    for (int q = 0; q < SENSOR_QTY_COUNT; q++) s_source[q] = NULL;
+
+    for (size_t i = 0; i < SENSOR_DRIVER_COUNT; i++) {
+        const sensor_driver_t *drv = &s_drivers[i];
+        if (!(driver_mask & (1u << i)) || !addr_in_scan(found, count, drv)) continue;
 
-    ESP_LOGI(TAG, "Probing for LPS22HB...");
-    if (lps22hb_init(i2c_bus) == ESP_OK) {
-        lps22hb_available = true;
-        ESP_LOGI(TAG, "LPS22HB probe OK");
-    } else {
-        ESP_LOGW(TAG, "LPS22HB not found or init failed");
+        ESP_LOGI(TAG, "Probing for %s...", drv->name);
+        if (drv->probe(i2c_bus) == ESP_OK) {
+            s_present[i] = true;
+            ESP_LOGI(TAG, "%s probe OK", drv->name);
+        } else {
+            ESP_LOGD(TAG, "%s not at its address", drv->name);
+        }
     }
 
-    if (sht41_available && lps22hb_available) {
-        detected = SENSOR_TYPE_SHT41_LPS22HB;
-        ESP_LOGI(TAG, "Detected sensor combo: SHT4x + LPS22HB");
-        return ESP_OK;
+    /* Humidity and pressure first; temperature then comes from a chip that is
+     * read anyway if possible, so a wake touches as few devices as possible. */
+    select_source(SENSOR_QTY_HUMIDITY, pick_source(SENSOR_QTY_HUMIDITY, false));
+    select_source(SENSOR_QTY_PRESSURE, pick_source(SENSOR_QTY_PRESSURE, false));
+    int temp_idx = pick_source(SENSOR_QTY_TEMPERATURE, true);
+    select_source(SENSOR_QTY_TEMPERATURE, temp_idx >= 0 ? temp_idx : pick_source(SENSOR_QTY_TEMPERATURE, false));
+
+    bool any = false;
+    for (size_t i = 0; i < SENSOR_DRIVER_COUNT; i++) {
+        if (s_active[i]) {
+            any = true;
+        } else if (s_present[i] && s_drivers[i].sleep) {
+            /* Present but redundant: park it and never wake it again */
+            s_drivers[i].sleep();
+            ESP_LOGI(TAG, "%s not needed - left in standby", s_drivers[i].name);
+        }
     }
-    if (sht41_available) {
-        detected = SENSOR_TYPE_SHT41;
-        ESP_LOGI(TAG, "Detected sensor: SHT4x only (humidity + temperature)");
-        return ESP_OK;
+    if (!any) {
+        return ESP_ERR_NOT_FOUND;
     }
-    if (lps22hb_available) {
-        detected = SENSOR_TYPE_LPS22HB;
-        ESP_LOGI(TAG, "Detected sensor: LPS22HB only (pressure + temperature)");
-        return ESP_OK;
+
+    ESP_LOGI(TAG, "Sources: temperature=%s, humidity=%s, pressure=%s",
+             s_source[SENSOR_QTY_TEMPERATURE] ? s_source[SENSOR_QTY_TEMPERATURE]->name : "none",
+             s_source[SENSOR_QTY_HUMIDITY] ? s_source[SENSOR_QTY_HUMIDITY]->name : "none",
+             s_source[SENSOR_QTY_PRESSURE] ? s_source[SENSOR_QTY_PRESSURE]->name : "none");
+    return ESP_OK;
+}
+
+uint32_t sensor_get_present_mask(void)
+{
+    uint32_t mask = 0;
+    for (size_t i = 0; i < SENSOR_DRIVER_COUNT; i++) {
+        if (s_present[i]) mask |= 1u << i;
     }
+    return mask;
+}
 
-    return ESP_ERR_NOT_FOUND;
+const char *sensor_get_source_name(sensor_quantity_t qty)
+{
+    if (qty >= SENSOR_QTY_COUNT || !s_source[qty]) return NULL;
+    return s_source[qty]->name;
 }
 
-sensor_type_t sensor_get_type(void)
+esp_err_t sensor_start_background(sensor_quantity_t qty)
 {
-    return detected;
+    if (qty >= SENSOR_QTY_COUNT) return ESP_ERR_INVALID_ARG;
+    const sensor_driver_t *drv = s_source[qty];
+    if (!drv) return ESP_ERR_NOT_FOUND;
+    if (!drv->background) return ESP_ERR_NOT_SUPPORTED;
+
+    size_t idx = (size_t)(drv - s_drivers);
+    if (s_background[idx]) return ESP_OK;
+    esp_err_t ret = drv->background();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "%s FIFO mode failed: %s", drv->name, esp_err_to_name(ret));
+        return ret;
+    }
+    s_background[idx] = true;
+    ESP_LOGI(TAG, "%s sampling into its FIFO", drv->name);
+    return ESP_OK;
 }
 
 esp_err_t sensor_wake_and_measure(void)
 {
-    esp_err_t r1 = ESP_ERR_NOT_FOUND;
-    esp_err_t r2 = ESP_ERR_NOT_FOUND;
+    uint32_t ready_ms = 0;
+    esp_err_t ret = sensor_start_measurement(&ready_ms);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    vTaskDelay(pdMS_TO_TICKS(ready_ms));
+    return sensor_collect_measurement();
+}
+
+esp_err_t sensor_start_measurement(uint32_t *ready_ms)
+{
+    bool started = false;
+    uint32_t ms = 0;
+
+    /* All conversions run in parallel inside the chips; only the I2C command
+     * writes are sequential. */
+    for (size_t i = 0; i < SENSOR_DRIVER_COUNT; i++) {
+        const sensor_driver_t *drv = &s_drivers[i];
+        if (!s_active[i]) continue;
+        if (s_background[i]) {
+            started = true;     // the FIFO already holds the samples
+            continue;
+        }
 
-    if (sht41_available) {
-        r1 = sht41_trigger_measurement();
+        esp_err_t ret = drv->trigger ? drv->trigger() : ESP_OK;
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "%s trigger failed: %s", drv->name, esp_err_to_name(ret));
+            continue;
+        }
+        started = true;
+        uint32_t t = drv->ready_ms ? drv->ready_ms() : 0;
+        if (ms < t) ms = t;
     }
-    if (lps22hb_available) {
-        r2 = lps22hb_trigger_measurement();
+
+    if (ready_ms) *ready_ms = ms;
+    return started ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t sensor_collect_measurement(void)
+{
+    bool collected = false;
+
+    for (size_t i = 0; i < SENSOR_DRIVER_COUNT; i++) {
+        const sensor_driver_t *drv = &s_drivers[i];
+        if (!s_active[i]) continue;
+        if (!drv->fetch) {
+            collected = true;
+            continue;
+        }
+
+        /* A modelled time can still be a little short (oscillator tolerance,
+         * typical figures): poll the status bit briefly rather than failing.
+         * An empty FIFO does not fill within the retries: no point waiting. */
+        esp_err_t ret = drv->fetch();
+        for (int r = 0; r < SENSOR_FETCH_RETRIES && ret == ESP_ERR_NOT_FINISHED && !s_background[i]; r++) {
+            vTaskDelay(pdMS_TO_TICKS(SENSOR_FETCH_RETRY_MS));
+            ret = drv->fetch();
+        }
+        if (ret == ESP_OK) {
+            collected = true;
+        } else {
+            ESP_LOGW(TAG, "%s result not ready: %s", drv->name, esp_err_to_name(ret));
+        }
     }
 
-    return (r1 == ESP_OK || r2 == ESP_OK) ? ESP_OK : ESP_ERR_NOT_FOUND;
+    return collected ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+static esp_err_t sensor_read(sensor_quantity_t qty, float *out, esp_err_t missing)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    const sensor_driver_t *drv = s_source[qty];
+    if (!drv) return missing;
+    return drv->read(qty, out);
 }
 
 esp_err_t sensor_read_temperature(float *out_c)
 {
-    if (!out_c) return ESP_ERR_INVALID_ARG;
-    if (sht41_available) {
-        return sht41_read_temperature(out_c);
-    }
-    if (lps22hb_available) {
-        return lps22hb_read_temperature(out_c);
-    }
-    return ESP_ERR_NOT_FOUND;
+    return sensor_read(SENSOR_QTY_TEMPERATURE, out_c, ESP_ERR_NOT_FOUND);
 }
 
 esp_err_t sensor_read_humidity(float *out_percent)
 {
-    if (!out_percent) return ESP_ERR_INVALID_ARG;
-    if (sht41_available) {
-        return sht41_read_humidity(out_percent);
-    }
-    return ESP_ERR_NOT_SUPPORTED;
+    return sensor_read(SENSOR_QTY_HUMIDITY, out_percent, ESP_ERR_NOT_SUPPORTED);
 }
 
 esp_err_t sensor_read_pressure(float *out_hpa)
 {
-    if (!out_hpa) return ESP_ERR_INVALID_ARG;
-    if (lps22hb_available) {
-        return lps22hb_read_pressure(out_hpa);
-    }
-    return ESP_ERR_NOT_SUPPORTED;
+    return sensor_read(SENSOR_QTY_PRESSURE, out_hpa, ESP_ERR_NOT_SUPPORTED);
 }
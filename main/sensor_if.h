@@ -1,24 +1,68 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "i2c_bus.h"
 #include "esp_err.h"
 
 typedef enum {
-    SENSOR_TYPE_NONE = 0,
-    SENSOR_TYPE_SHT41,
-    SENSOR_TYPE_SHT41_LPS22HB,
-    SENSOR_TYPE_LPS22HB,
-} sensor_type_t;
+    SENSOR_QTY_TEMPERATURE = 0,
+    SENSOR_QTY_HUMIDITY,
+    SENSOR_QTY_PRESSURE,
+    SENSOR_QTY_COUNT,
+} sensor_quantity_t;
 
-// Initialize selected sensor stack (SHT4x + LPS22HB)
+// Capability flags (one bit per sensor_quantity_t)
+#define SENSOR_CAP_TEMPERATURE  (1 << SENSOR_QTY_TEMPERATURE)
+#define SENSOR_CAP_HUMIDITY     (1 << SENSOR_QTY_HUMIDITY)
+#define SENSOR_CAP_PRESSURE     (1 << SENSOR_QTY_PRESSURE)
+
+// Environmental sensor driver descriptor. Optional hooks may be NULL.
+typedef struct {
+    const char *name;
+    uint8_t addr[2];                    // I2C addresses the chip can answer on (0 = unused)
+    uint8_t caps;                       // SENSOR_CAP_* provided by the chip
+    uint8_t rank[SENSOR_QTY_COUNT];     // source preference per quantity, higher wins
+    esp_err_t (*probe)(i2c_bus_handle_t bus);                 // identify + configure, ESP_ERR_NOT_FOUND if absent
+    esp_err_t (*trigger)(void);                               // start a conversion (NULL: free-running)
+    uint32_t (*ready_ms)(void);                               // time from trigger to a valid result
+    esp_err_t (*fetch)(void);                                 // latch the result, ESP_ERR_NOT_FINISHED if still busy
+    esp_err_t (*read)(sensor_quantity_t qty, float *out);     // last fetched value
+    esp_err_t (*sleep)(void);                                 // lowest power state while unused (NULL: automatic)
+    esp_err_t (*background)(void);                            // sample on its own into the chip FIFO, fetch then
+                                                              // drains and averages it (NULL: no FIFO)
+} sensor_driver_t;
+
+// Probe every known driver from one bus scan and pick a source per quantity
 esp_err_t sensor_init(i2c_bus_handle_t i2c_bus);
 
-// Return detected sensor type (after sensor_init)
-sensor_type_t sensor_get_type(void);
+#define SENSOR_DRIVERS_ALL      UINT32_MAX
+
+// As sensor_init() with a scan result from elsewhere (e.g. a cached inventory);
+// only drivers whose bit is set in driver_mask are probed
+esp_err_t sensor_init_from_scan(i2c_bus_handle_t i2c_bus, const uint8_t *found, int count, uint32_t driver_mask);
+
+// Drivers whose probe succeeded, bit n = registry entry n
+uint32_t sensor_get_present_mask(void);
 
-// Wake sensor(s) and trigger measurement (if required)
+// Name of the chip selected for a quantity, NULL if none was found
+const char *sensor_get_source_name(sensor_quantity_t qty);
+
+// Switch the chip selected for a quantity to FIFO sampling: it is no longer
+// triggered, and each sensor_collect_measurement() drains its FIFO. Call after
+// sensor_init(). ESP_ERR_NOT_SUPPORTED if that chip has no FIFO.
+esp_err_t sensor_start_background(sensor_quantity_t qty);
+
+// Wake sensor(s) and trigger measurement (if required), blocking until done
 esp_err_t sensor_wake_and_measure(void);
 
+// Start conversions on the selected sensors at once without waiting.
+// *ready_ms receives the time until the slowest one is done.
+esp_err_t sensor_start_measurement(uint32_t *ready_ms);
+
+// Collect the results of sensor_start_measurement() (call after *ready_ms)
+esp_err_t sensor_collect_measurement(void);
+
 // Read last measured temperature in degrees Celsius
 esp_err_t sensor_read_temperature(float *out_c);
 
@@ -1,5 +1,6 @@
 #include "sht41.h"
 #include "i2c_bus.h"
+#include "i2c_config.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "freertos/FreeRTOS.h"
@@ -14,11 +15,20 @@ static const char *TAG = "SHT41";
 
 // Commands for SHT41
 #define SHT41_CMD_MEASURE_HIGH_PRECISION 0xFD  // High precision measurement (~8.3ms)
+#define SHT41_CMD_MEASURE_MED_PRECISION  0xF6  // Medium precision (~4.5ms)
+#define SHT41_CMD_MEASURE_LOW_PRECISION  0xE0  // Low precision (~1.6ms)
 #define SHT41_CMD_SOFT_RESET 0x94
 
 static i2c_bus_device_handle_t s_dev = NULL;
 static float s_last_temperature = 0.0f;
 static float s_last_humidity = 0.0f;
+static sht41_precision_t s_precision = SHT41_PRECISION_HIGH;
+
+/* Indexed by sht41_precision_t: measurement command and datasheet max duration */
+static const uint8_t SHT41_MEASURE_CMD[] = {
+    SHT41_CMD_MEASURE_HIGH_PRECISION, SHT41_CMD_MEASURE_MED_PRECISION, SHT41_CMD_MEASURE_LOW_PRECISION,
+};
+static const uint16_t SHT41_MEASURE_TIME_US[] = { 8300, 4500, 1600 };
 
 // CRC-8 calculation for SHT41 (polynomial: 0x31, init: 0xFF)
 static uint8_t sht41_crc8(const uint8_t *data, size_t len)
@@ -71,29 +81,46 @@ esp_err_t sht41_init(i2c_bus_handle_t i2c_bus)
 
     ESP_LOGI(TAG, "sht41_init: probe OK");
     s_dev = dev;
+    i2c_buses_track_device(i2c_bus, SHT41_I2C_ADDR, &s_dev);
     return ESP_OK;
 }
 
-esp_err_t sht41_trigger_measurement(void)
+esp_err_t sht41_set_precision(sht41_precision_t precision)
+{
+    if (precision > SHT41_PRECISION_LOW) return ESP_ERR_INVALID_ARG;
+    s_precision = precision;
+    return ESP_OK;
+}
+
+uint32_t sht41_get_measure_time_us(void)
+{
+    return SHT41_MEASURE_TIME_US[s_precision];
+}
+
+esp_err_t sht41_start_measurement(void)
 {
     if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
 
-    // Send high precision measurement command
-    uint8_t cmd = SHT41_CMD_MEASURE_HIGH_PRECISION;
+    /* Send the measurement command; the result is fetched later with
+     * sht41_fetch_measurement() so the caller can overlap other conversions. */
+    uint8_t cmd = SHT41_MEASURE_CMD[s_precision];
     esp_err_t ret = i2c_bus_write_bytes(s_dev, NULL_I2C_MEM_ADDR, 1, &cmd);
     if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "sht41_trigger_measurement: write failed");
-        return ret;
+        ESP_LOGW(TAG, "sht41_start_measurement: write failed");
     }
+    return ret;
+}
 
-    // Wait for measurement to complete (typical 8.3ms for high precision)
-    vTaskDelay(pdMS_TO_TICKS(10));
+esp_err_t sht41_fetch_measurement(void)
+{
+    if (s_dev == NULL) return ESP_ERR_NOT_FOUND;
 
     // Read 6 bytes: temp_msb, temp_lsb, temp_crc, hum_msb, hum_lsb, hum_crc
+    // (the SHT4x NACKs the read header while the conversion is still running)
     uint8_t raw[6];
-    ret = i2c_bus_read_bytes(s_dev, NULL_I2C_MEM_ADDR, 6, raw);
+    esp_err_t ret = i2c_bus_read_bytes(s_dev, NULL_I2C_MEM_ADDR, 6, raw);
     if (ret != ESP_OK) {
-        ESP_LOGW(TAG, "sht41_trigger_measurement: read failed");
+        ESP_LOGW(TAG, "sht41_fetch_measurement: read failed");
         return ret;
     }
 
@@ -128,6 +155,19 @@ esp_err_t sht41_trigger_measurement(void)
     return ESP_OK;
 }
 
+esp_err_t sht41_trigger_measurement(void)
+{
+    esp_err_t ret = sht41_start_measurement();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Wait for measurement to complete (worst case for the current precision)
+    vTaskDelay(pdMS_TO_TICKS((sht41_get_measure_time_us() + 999) / 1000));
+
+    return sht41_fetch_measurement();
+}
+
 esp_err_t sht41_read_temperature(float *out_c)
 {
     if (!out_c) return ESP_ERR_INVALID_ARG;
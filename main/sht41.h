@@ -6,7 +6,27 @@
 // Initialize SHT41 on the provided I2C bus
 esp_err_t sht41_init(i2c_bus_handle_t i2c_bus);
 
-// Trigger a measurement
+typedef enum {
+    SHT41_PRECISION_HIGH = 0,   // datasheet max 8.3 ms
+    SHT41_PRECISION_MEDIUM,     // max 4.5 ms
+    SHT41_PRECISION_LOW,        // max 1.6 ms
+} sht41_precision_t;
+
+// Select the repeatability used by the next measurements (default: high)
+esp_err_t sht41_set_precision(sht41_precision_t precision);
+
+// Worst-case conversion time for the current precision, in microseconds.
+// The SHT4x has no status register (it NACKs reads while busy), so this is
+// the time to wait before fetching.
+uint32_t sht41_get_measure_time_us(void);
+
+// Start a measurement without waiting for it (fetch after sht41_get_measure_time_us())
+esp_err_t sht41_start_measurement(void);
+
+// Fetch the result of a measurement started with sht41_start_measurement()
+esp_err_t sht41_fetch_measurement(void);
+
+// Trigger a measurement and wait for the result (start + delay + fetch)
 esp_err_t sht41_trigger_measurement(void);
 
 // Read temperature in degrees Celsius
@@ -9,6 +9,7 @@
  * with maintained Zigbee network connection for instant wake and reporting
  */
 
+#include <math.h>
 #include "esp_sleep.h"
 #include "esp_log.h"
 #include "driver/gpio.h"
@@ -16,6 +17,8 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_zb_weather.h"
+#include "sleep_manager.h"
+#include "rain_log.h"
 
 static const char *SLEEP_TAG = "SLEEP";
 
@@ -26,14 +29,7 @@ static RTC_DATA_ATTR uint32_t rtc_rain_pulse_count = 0;
 static RTC_DATA_ATTR float rtc_pulse_counter_value = 0.0f;
 static RTC_DATA_ATTR uint32_t rtc_pulse_counter_count = 0;
 static RTC_DATA_ATTR int64_t last_report_timestamp = 0;
-
-/* Wake-up reason tracking */
-typedef enum {
-    WAKE_REASON_TIMER = 0,
-    WAKE_REASON_RAIN,
-    WAKE_REASON_BUTTON,
-    WAKE_REASON_RESET
-} wake_reason_t;
+static RTC_DATA_ATTR uint8_t rtc_stable_cycles = 0;   // calm cycles in a row (adaptive scheduler)
 
 /**
  * @brief Get and log the wake-up reason
@@ -112,7 +108,7 @@ void configure_gpio_wakeup(gpio_num_t gpio_num, int level)
 }
 
 /**
- * @brief Save rainfall data to RTC memory and NVS
+ * @brief Save rainfall data to RTC memory and the rain log
  * @param rainfall_mm Current total rainfall in mm
  * @param pulse_count Current pulse count
  */
@@ -124,9 +120,18 @@ void save_rainfall_data(float rainfall_mm, uint32_t pulse_count)
     
     ESP_LOGI(SLEEP_TAG, "💾 Saved to RTC: %.2f mm, %lu pulses", rtc_rainfall_mm, rtc_rain_pulse_count);
     
-    // Also save to NVS for persistence across power loss
+    // Append to the flash log for persistence across power loss
+    esp_err_t ret = rain_log_append(rainfall_mm, pulse_count, 0);
+    if (ret == ESP_OK) {
+        return;
+    }
+    if (ret != ESP_ERR_INVALID_STATE) {
+        ESP_LOGW(SLEEP_TAG, "⚠️ Rain log append failed (%s), writing NVS instead", esp_err_to_name(ret));
+    }
+
+    // No usable log partition: keep the old NVS keys up to date
     nvs_handle_t nvs_handle;
-    esp_err_t ret = nvs_open("rain_storage", NVS_READWRITE, &nvs_handle);
+    ret = nvs_open("rain_storage", NVS_READWRITE, &nvs_handle);
     if (ret == ESP_OK) {
         nvs_set_blob(nvs_handle, "rainfall", &rainfall_mm, sizeof(float));
         nvs_set_u32(nvs_handle, "pulses", pulse_count);
@@ -137,10 +142,10 @@ void save_rainfall_data(float rainfall_mm, uint32_t pulse_count)
 }
 
 /**
- * @brief Load rainfall data from RTC memory or NVS
+ * @brief Load rainfall data from RTC memory, the rain log or NVS
  * @param rainfall_mm Pointer to store rainfall value
  * @param pulse_count Pointer to store pulse count
- * @return true if data loaded from RTC, false if loaded from NVS
+ * @return true if data loaded from RTC, false if loaded from flash
  */
 bool load_rainfall_data(float *rainfall_mm, uint32_t *pulse_count)
 {
@@ -152,7 +157,19 @@ bool load_rainfall_data(float *rainfall_mm, uint32_t *pulse_count)
         return true;
     }
     
-    // Otherwise, try to load from NVS
+    // Newest record of the rain log
+    rain_log_record_t rec;
+    if (rain_log_latest(&rec)) {
+        *rainfall_mm = rec.rainfall_mm;
+        *pulse_count = rec.pulse_count;
+        ESP_LOGI(SLEEP_TAG, "📂 Loaded from rain log #%lu: %.2f mm, %lu pulses",
+                 (unsigned long)rec.seq, *rainfall_mm, *pulse_count);
+        rtc_rainfall_mm = *rainfall_mm;
+        rtc_rain_pulse_count = *pulse_count;
+        return false;
+    }
+
+    // Otherwise, try to load from NVS (firmware without the log, or no log partition)
     nvs_handle_t nvs_handle;
     esp_err_t ret = nvs_open("rain_storage", NVS_READONLY, &nvs_handle);
     if (ret == ESP_OK) {
@@ -163,9 +180,10 @@ bool load_rainfall_data(float *rainfall_mm, uint32_t *pulse_count)
             nvs_close(nvs_handle);
             ESP_LOGI(SLEEP_TAG, "📂 Loaded from NVS: %.2f mm, %lu pulses", *rainfall_mm, *pulse_count);
             
-            // Update RTC memory
+            // Update RTC memory and carry the totals over into the log
             rtc_rainfall_mm = *rainfall_mm;
             rtc_rain_pulse_count = *pulse_count;
+            rain_log_append(*rainfall_mm, *pulse_count, RAIN_LOG_FLAG_MIGRATED);
             return false;
         }
         nvs_close(nvs_handle);
@@ -285,21 +303,54 @@ uint32_t estimate_battery_life(uint32_t battery_mah)
 }
 
 /**
- * @brief Get sleep duration based on rainfall
- * @param recent_rainfall_mm Recent rainfall in last sleep cycle
- * @return Sleep duration in seconds
+ * @brief Get the next reading interval from weather activity
+ * @param activity Activity seen over the last cycle
+ * @param limits Scheduler limits
+ * @return Interval in seconds
  */
-uint32_t get_adaptive_sleep_duration(float recent_rainfall_mm, uint32_t base_duration_seconds)
+uint32_t get_adaptive_sleep_duration(const weather_activity_t *activity, const adaptive_schedule_t *limits)
 {
-    /* If it's raining heavily, check more frequently */
-    if (recent_rainfall_mm > RAIN_MM_THRESHOLD) {
-        ESP_LOGI(SLEEP_TAG, "🌧️ Recent rain detected (%.2f mm), using shorter sleep (5 min)", 
-                 recent_rainfall_mm);
-        return 5 * 60; // 5 minutes during active rain
+    uint32_t min_s = limits->min_interval_s;
+    uint32_t max_s = limits->max_interval_s > min_s ? limits->max_interval_s : min_s;
+    uint32_t interval_s;
+
+    bool raining = activity->rain_mm > 0.0f;
+    bool gusty = activity->wind_gust_excess_ms >= limits->wind_gust_ms ||
+                 activity->wind_dir_shift_deg >= limits->wind_shift_deg;
+    bool falling = !isnan(activity->pressure_trend_hpa_h) &&
+                   activity->pressure_trend_hpa_h <= -limits->pressure_fall_hpa_h;
+
+    if (raining || gusty || falling) {
+        /* Something is happening: report at the fastest cadence */
+        rtc_stable_cycles = 0;
+        interval_s = min_s;
+        ESP_LOGI(SLEEP_TAG, "🌦️ Active weather (%s%s%s) - next reading in %lu s",
+                 raining ? "rain " : "", gusty ? "wind " : "", falling ? "pressure " : "",
+                 (unsigned long)interval_s);
+    } else {
+        /* Stable: double the interval for every calm cycle in a row */
+        if (rtc_stable_cycles < 16) rtc_stable_cycles++;
+        interval_s = min_s << rtc_stable_cycles;
+        if (interval_s > max_s || interval_s < min_s) interval_s = max_s;
+        ESP_LOGI(SLEEP_TAG, "🌤️ Stable weather (%u cycles) - next reading in %lu s",
+                 rtc_stable_cycles, (unsigned long)interval_s);
     }
-    
-    /* Use configurable base sleep duration */
-    return base_duration_seconds;
+
+    if (activity->battery_percent <= 100) {
+        uint32_t floor_s = 0;
+        if (activity->battery_percent < limits->low_battery_percent / 2) {
+            floor_s = max_s;
+        } else if (activity->battery_percent < limits->low_battery_percent) {
+            floor_s = (min_s + max_s) / 2;
+        }
+        if (interval_s < floor_s) {
+            ESP_LOGI(SLEEP_TAG, "🔋 Battery %u%% - interval held at %lu s", activity->battery_percent,
+                     (unsigned long)floor_s);
+            interval_s = floor_s;
+        }
+    }
+
+    return interval_s;
 }
 
 /**
@@ -88,13 +88,41 @@ bool load_pulse_counter_data(float *pulse_value, uint32_t *pulse_count);
 uint32_t estimate_battery_life(uint32_t battery_mah);
 
 /**
- * @brief Get adaptive sleep duration based on recent rainfall
- * 
- * @param recent_rainfall_mm Recent rainfall amount
- * @param base_duration_seconds Base sleep duration in seconds (configurable)
- * @return Sleep duration in seconds
+ * @brief Weather activity seen over the last reporting cycle
+ */
+typedef struct {
+    float rain_mm;                  /*!< Rain since the previous cycle */
+    float wind_gust_excess_ms;      /*!< Peak gust minus the 10-minute mean speed */
+    float wind_dir_shift_deg;       /*!< Angle between the 2- and 10-minute mean directions */
+    float pressure_trend_hpa_h;     /*!< Pressure tendency, negative = falling (NAN if not known yet) */
+    uint8_t battery_percent;        /*!< 0-100, 0xFF if not measured yet */
+} weather_activity_t;
+
+/**
+ * @brief Limits of the adaptive reporting scheduler (configurable over Zigbee)
+ */
+typedef struct {
+    uint16_t min_interval_s;        /*!< Cadence while the weather is active */
+    uint16_t max_interval_s;        /*!< Longest back-off in stable weather */
+    float pressure_fall_hpa_h;      /*!< Pressure falling faster than this is active */
+    float wind_gust_ms;             /*!< Gust excess above this is variable wind */
+    float wind_shift_deg;           /*!< Direction shift above this is variable wind */
+    uint8_t low_battery_percent;    /*!< Below this the cadence is held at half the back-off or slower */
+} adaptive_schedule_t;
+
+/**
+ * @brief Get the interval until the next reading from recent weather activity
+ *
+ * Active weather (any rain, variable wind, fast falling pressure) selects the
+ * minimum interval. Each stable cycle in a row doubles the interval, up to the
+ * maximum. A low battery holds the result at (min + max) / 2 or above, and
+ * below half the low-battery threshold at the maximum.
+ *
+ * @param activity Activity of the last cycle
+ * @param limits Scheduler limits
+ * @return Interval in seconds
  */
-uint32_t get_adaptive_sleep_duration(float recent_rainfall_mm, uint32_t base_duration_seconds);
+uint32_t get_adaptive_sleep_duration(const weather_activity_t *activity, const adaptive_schedule_t *limits);
 
 /**
  * @brief Print wake-up statistics and power information
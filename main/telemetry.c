@@ -0,0 +1,176 @@
+/*
+ * Telemetry snapshot
+ */
+
+#include <math.h>
+#include <string.h>
+#include "telemetry.h"
+#include "attr_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+static const char *TAG = "TELEMETRY";
+
+#define TELEMETRY_NVS_NAMESPACE     "storage"
+#define TELEMETRY_NVS_KEY_MODE      "tlm_mode"
+
+static telemetry_field_def_t s_fields[TELEMETRY_MAX_FIELDS];
+static size_t s_count = 0;
+static size_t s_size = TELEMETRY_HEADER_SIZE;   // encoded snapshot, without the length byte
+static int64_t s_heartbeat_us = 0;
+static telemetry_mode_t s_mode = TELEMETRY_MODE_SNAPSHOT;
+static uint16_t s_sequence = 0;
+static uint8_t s_last[TELEMETRY_MAX_BYTES];     // fields of the last snapshot
+static bool s_have_last = false;
+static int64_t s_last_us = 0;
+
+static size_t encoding_size(telemetry_encoding_t encoding)
+{
+    switch (encoding) {
+        case TELEMETRY_S16: return 2;
+        case TELEMETRY_U8:  return 1;
+        case TELEMETRY_U16: return 2;
+        case TELEMETRY_U32: return 4;
+    }
+    return 0;
+}
+
+static void put_le(uint8_t *p, uint32_t v, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+/* One field in its encoding, clamped to the range below the absent marker */
+static size_t encode_field(const telemetry_field_def_t *f, uint8_t *p)
+{
+    size_t size = encoding_size(f->encoding);
+    float raw;
+    if (!attr_cache_get(f->endpoint, f->cluster_id, f->attr_id, &raw)) {
+        put_le(p, f->encoding == TELEMETRY_S16 ? (uint16_t)INT16_MIN : UINT32_MAX, size);
+        return size;
+    }
+
+    double v = round((double)raw * f->scale);
+    uint32_t out;
+    switch (f->encoding) {
+        case TELEMETRY_S16:
+            out = (uint16_t)(int16_t)fmax(INT16_MIN + 1, fmin(INT16_MAX, v));
+            break;
+        case TELEMETRY_U8:
+            out = (uint32_t)fmax(0, fmin(UINT8_MAX - 1, v));
+            break;
+        case TELEMETRY_U16:
+            out = (uint32_t)fmax(0, fmin(UINT16_MAX - 1, v));
+            break;
+        default:
+            out = (uint32_t)fmax(0, fmin(UINT32_MAX - 1.0, v));
+            break;
+    }
+    put_le(p, out, size);
+    return size;
+}
+
+esp_err_t telemetry_init(const telemetry_field_def_t *table, size_t count, uint32_t heartbeat_s,
+                         telemetry_mode_t default_mode)
+{
+    if (!table || count > TELEMETRY_MAX_FIELDS || default_mode >= TELEMETRY_MODE_COUNT) return ESP_ERR_INVALID_ARG;
+
+    size_t size = TELEMETRY_HEADER_SIZE;
+    for (size_t i = 0; i < count; i++) {
+        size += encoding_size(table[i].encoding);
+    }
+    if (size > TELEMETRY_MAX_BYTES) return ESP_ERR_INVALID_ARG;
+
+    memcpy(s_fields, table, count * sizeof(table[0]));
+    s_count = count;
+    s_size = size;
+    s_heartbeat_us = (int64_t)heartbeat_s * 1000000LL;
+    s_have_last = false;
+    s_mode = default_mode;
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(TELEMETRY_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        uint8_t saved;
+        if (nvs_get_u8(nvs_handle, TELEMETRY_NVS_KEY_MODE, &saved) == ESP_OK && saved < TELEMETRY_MODE_COUNT) {
+            s_mode = (telemetry_mode_t)saved;
+        }
+        nvs_close(nvs_handle);
+    }
+
+    ESP_LOGI(TAG, "Telemetry snapshot: %u fields in %u bytes, mode %d", (unsigned)count, (unsigned)size, s_mode);
+    return ESP_OK;
+}
+
+/* Length byte, header and every field */
+static void encode_snapshot(uint8_t *buf, uint16_t sequence)
+{
+    uint8_t *body = buf + 1;
+    uint8_t *p = body + TELEMETRY_HEADER_SIZE;
+    for (size_t i = 0; i < s_count; i++) {
+        p += encode_field(&s_fields[i], p);
+    }
+    buf[0] = (uint8_t)s_size;
+    body[0] = TELEMETRY_VERSION;
+    body[1] = (uint8_t)s_count;
+    put_le(&body[2], sequence, 2);
+}
+
+size_t telemetry_encode(uint8_t *buf, size_t len)
+{
+    if (len < s_size + 1) return 0;
+    encode_snapshot(buf, s_sequence);
+    return s_size + 1;
+}
+
+size_t telemetry_build(uint8_t *buf, size_t len)
+{
+    if (s_mode == TELEMETRY_MODE_STANDARD || len < s_size + 1) return 0;
+
+    encode_snapshot(buf, (uint16_t)(s_sequence + 1));
+    uint8_t *body = buf + 1;
+    size_t fields_size = s_size - TELEMETRY_HEADER_SIZE;
+
+    int64_t now = esp_timer_get_time();
+    bool changed = !s_have_last || memcmp(s_last, body + TELEMETRY_HEADER_SIZE, fields_size) != 0;
+    if (!changed && now - s_last_us < s_heartbeat_us) return 0;
+
+    memcpy(s_last, body + TELEMETRY_HEADER_SIZE, fields_size);
+    s_have_last = true;
+    s_last_us = now;
+    s_sequence++;
+    ESP_LOGD(TAG, "Snapshot %u (%s)", s_sequence, changed ? "changed" : "heartbeat");
+    return s_size + 1;
+}
+
+bool telemetry_covers(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id)
+{
+    for (size_t i = 0; i < s_count; i++) {
+        const telemetry_field_def_t *f = &s_fields[i];
+        if (f->endpoint == endpoint && f->cluster_id == cluster_id && f->attr_id == attr_id) return true;
+    }
+    return false;
+}
+
+telemetry_mode_t telemetry_get_mode(void)
+{
+    return s_mode;
+}
+
+esp_err_t telemetry_set_mode(telemetry_mode_t mode)
+{
+    if (mode >= TELEMETRY_MODE_COUNT) return ESP_ERR_INVALID_ARG;
+
+    s_mode = mode;
+    s_have_last = false;
+    nvs_handle_t nvs_handle;
+    if (nvs_open(TELEMETRY_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        nvs_set_u8(nvs_handle, TELEMETRY_NVS_KEY_MODE, (uint8_t)mode);
+        nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+    ESP_LOGI(TAG, "📦 Telemetry mode %d", mode);
+    return ESP_OK;
+}
@@ -0,0 +1,112 @@
+/*
+ * Telemetry snapshot
+ * Packs the latest value of every measurement channel into one octet string,
+ * so an acquisition cycle costs one report frame (and one APS ACK) instead of
+ * one per cluster. Values come from the attribute cache after a flush and
+ * are stored as fixed-point integers; a snapshot is only built when one of
+ * them changed since the last one or the heartbeat is due. The standard
+ * measurement clusters stay in place and can be reported alongside or
+ * instead (telemetry_mode_t, kept in NVS). Zigbee task only.
+ *
+ * Layout (little endian): u8 version, u8 field count, u16 sequence number,
+ * then every field of the table in order, in its encoding's width. An absent
+ * value (attribute never set) is the encoding's marker: INT16_MIN, 0xFF,
+ * 0xFFFF or 0xFFFFFFFF.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_VERSION               1
+#define TELEMETRY_HEADER_SIZE           4
+#define TELEMETRY_MAX_FIELDS            24
+#define TELEMETRY_MAX_BYTES             72      // one unfragmented APS frame, as for backfill batches
+
+typedef enum {
+    TELEMETRY_S16 = 0,
+    TELEMETRY_U8,
+    TELEMETRY_U16,
+    TELEMETRY_U32,
+} telemetry_encoding_t;
+
+typedef enum {
+    TELEMETRY_MODE_SNAPSHOT = 0,    // snapshot only, standard reporting of its attributes off
+    TELEMETRY_MODE_BOTH,            // snapshot and standard reports
+    TELEMETRY_MODE_STANDARD,        // standard reports only (no snapshot)
+    TELEMETRY_MODE_COUNT,
+} telemetry_mode_t;
+
+typedef struct {
+    uint8_t endpoint;
+    uint16_t cluster_id;
+    uint16_t attr_id;               // attribute cache entry the value comes from
+    telemetry_encoding_t encoding;
+    float scale;                    // field units per raw attribute unit
+} telemetry_field_def_t;
+
+/**
+ * @brief Load the field table (copied) and the mode saved in NVS
+ *
+ * @param table Fields in snapshot order; append only, the order is the wire format
+ * @param count Number of fields (at most TELEMETRY_MAX_FIELDS)
+ * @param heartbeat_s Longest time between two snapshots while nothing changes
+ * @param default_mode Mode until the coordinator writes one
+ * @return ESP_OK, ESP_ERR_INVALID_ARG if the table is too long or encodes past TELEMETRY_MAX_BYTES
+ */
+esp_err_t telemetry_init(const telemetry_field_def_t *table, size_t count, uint32_t heartbeat_s,
+                         telemetry_mode_t default_mode);
+
+/**
+ * @brief Build the next snapshot if one is due
+ *
+ * Due when a field differs from the last snapshot or heartbeat_s has passed.
+ * Each snapshot built takes the next sequence number. Always 0 in
+ * TELEMETRY_MODE_STANDARD.
+ *
+ * @param buf Receives a ZCL octet string (length byte first)
+ * @param len Buffer size, at least TELEMETRY_MAX_BYTES + 1
+ * @return Bytes written including the length byte, 0 if nothing is due
+ */
+size_t telemetry_build(uint8_t *buf, size_t len);
+
+/**
+ * @brief Encode the current values without taking a sequence number
+ *
+ * For the attribute's initial value: absent fields read as their marker.
+ *
+ * @param buf Receives a ZCL octet string (length byte first)
+ * @param len Buffer size, at least TELEMETRY_MAX_BYTES + 1
+ * @return Bytes written including the length byte, 0 if buf is too short
+ */
+size_t telemetry_encode(uint8_t *buf, size_t len);
+
+/**
+ * @brief True if the attribute is carried by the snapshot
+ */
+bool telemetry_covers(uint8_t endpoint, uint16_t cluster_id, uint16_t attr_id);
+
+/**
+ * @brief Mode in use
+ */
+telemetry_mode_t telemetry_get_mode(void);
+
+/**
+ * @brief Change the mode and save it in NVS
+ *
+ * The next telemetry_build() sends a snapshot whatever changed.
+ *
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for an unknown mode
+ */
+esp_err_t telemetry_set_mode(telemetry_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
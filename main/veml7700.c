@@ -4,9 +4,13 @@
  */
 
 #include "veml7700.h"
+#include "i2c_txn.h"
+#include "i2c_config.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "esp_timer.h"
+#include <stdbool.h>
 
 static const char *TAG = "VEML7700";
 
@@ -40,18 +44,70 @@ static const char *TAG = "VEML7700";
 #define VEML7700_ALS_INT_EN     0x0002  // Enable interrupt
 #define VEML7700_ALS_SD         0x0001  // Shut down (power off)
 
+/* Power saving register: PSM mode 4 (longest refresh) + enable */
+#define VEML7700_PSM_MODE_4     0x0006
+#define VEML7700_PSM_EN         0x0001
+
+/* Auto-range limits: keep the count in [RAW_MIN, RAW_MAX] so a reading has
+ * resolution to spare and room to grow ~6x before the 16-bit counter clips */
+#define VEML7700_RAW_MIN        100
+#define VEML7700_RAW_MAX        10000
+#define VEML7700_RAW_SATURATED  65000
+#define VEML7700_AUTO_MAX_IT_MS 400     // longest integration auto-range will pick
+#define VEML7700_NONLINEAR_LUX  1000.0f // Vishay correction applies above this
+
+#define VEML7700_WAKEUP_US      2500    // SD=0 -> integration starts (datasheet: 2.5 ms)
+
+typedef struct {
+    uint16_t bits;
+    float factor;       // gain relative to x1
+} veml7700_gain_t;
+
+typedef struct {
+    uint16_t bits;
+    uint16_t ms;
+} veml7700_it_t;
+
+/* Ascending sensitivity */
+static const veml7700_gain_t GAINS[] = {
+    { VEML7700_ALS_GAIN_1_8, 0.125f },
+    { VEML7700_ALS_GAIN_1_4, 0.25f },
+    { VEML7700_ALS_GAIN_1,   1.0f },
+    { VEML7700_ALS_GAIN_2,   2.0f },
+};
+static const veml7700_it_t ITS[] = {
+    { VEML7700_ALS_IT_25MS, 25 }, { VEML7700_ALS_IT_50MS, 50 }, { VEML7700_ALS_IT_100MS, 100 },
+    { VEML7700_ALS_IT_200MS, 200 }, { VEML7700_ALS_IT_400MS, 400 }, { VEML7700_ALS_IT_800MS, 800 },
+};
+#define GAIN_COUNT  (sizeof(GAINS) / sizeof(GAINS[0]))
+#define IT_COUNT    (sizeof(ITS) / sizeof(ITS[0]))
+
 static i2c_bus_device_handle_t veml7700_dev = NULL;
 
+/* Write-only configuration, kept locally: no read-modify-write, and an
+ * unchanged power-saving or shutdown write is skipped */
+static i2c_shadow_reg_t als_conf_shadow = I2C_SHADOW_REG16_LE(VEML7700_REG_ALS_CONF);
+static i2c_shadow_reg_t psm_shadow = I2C_SHADOW_REG16_LE(VEML7700_REG_PWR_SAVE);
+
 /* Current configuration */
-static float current_resolution = 0.0036f;  // lux/count (depends on gain/integration time)
+static uint8_t gain_idx = 2;                 // x1
+static uint8_t it_idx = 2;                   // 100 ms
+static bool auto_range = false;
+static bool powered = false;
+static float last_lux = -1.0f;               // < 0: no reading yet
+static int64_t first_result_at_us = 0;       // end of the first integration after power-on
 
-/* Helper: write 16-bit register */
-static esp_err_t veml7700_write_reg(uint8_t reg, uint16_t value)
+/* Vishay app note: 0.0036 lux/count at gain x2, IT 800 ms, scaling inversely
+ * with gain and integration time */
+static float resolution(uint8_t g, uint8_t i)
 {
-    uint8_t data[2];
-    data[0] = value & 0xFF;        // LSB first
-    data[1] = (value >> 8) & 0xFF; // MSB
-    return i2c_bus_write_bytes(veml7700_dev, reg, 2, data);
+    return 0.0036f * (2.0f / GAINS[g].factor) * (800.0f / ITS[i].ms);
+}
+
+static void veml7700_mark_started(void)
+{
+    /* First valid sample after one integration; the internal oscillator runs up to 10 % slow */
+    first_result_at_us = esp_timer_get_time() + VEML7700_WAKEUP_US + (int64_t)ITS[it_idx].ms * 1100;
 }
 
 /* Helper: read 16-bit register */
@@ -65,6 +121,51 @@ static esp_err_t veml7700_read_reg(uint8_t reg, uint16_t *value)
     return ret;
 }
 
+static uint16_t veml7700_config(bool shutdown)
+{
+    uint16_t config = GAINS[gain_idx].bits | ITS[it_idx].bits | VEML7700_ALS_PERS_1;
+    if (shutdown) config |= VEML7700_ALS_SD;
+    return config;
+}
+
+/* Every power-on write restarts the integration, so it is never skipped */
+static esp_err_t veml7700_write_config(bool shutdown)
+{
+    return shutdown ? i2c_shadow_write(veml7700_dev, &als_conf_shadow, veml7700_config(true))
+                    : i2c_shadow_store(veml7700_dev, &als_conf_shadow, veml7700_config(false));
+}
+
+static uint8_t max_auto_it(void)
+{
+    uint8_t i = 0;
+    while (i + 1 < IT_COUNT && ITS[i + 1].ms <= VEML7700_AUTO_MAX_IT_MS) i++;
+    return i;
+}
+
+/* Shortest integration first (less time awake), then the lowest gain that
+ * lands the expected count inside the window */
+static void pick_range(float lux)
+{
+    const uint8_t it_max = max_auto_it();
+
+    for (uint8_t i = 0; i <= it_max; i++) {
+        for (uint8_t g = 0; g < GAIN_COUNT; g++) {
+            float raw = lux / resolution(g, i);
+            if (raw > VEML7700_RAW_MAX) break;          // higher gains only get worse
+            if (raw >= VEML7700_RAW_MIN) {
+                gain_idx = g;
+                it_idx = i;
+                return;
+            }
+        }
+    }
+
+    /* Outside every window: clamp to the least or most sensitive range */
+    bool too_bright = lux / resolution(0, 0) > VEML7700_RAW_MAX;
+    gain_idx = too_bright ? 0 : GAIN_COUNT - 1;
+    it_idx = too_bright ? 0 : it_max;
+}
+
 esp_err_t veml7700_init(i2c_bus_handle_t i2c_bus)
 {
     if (!i2c_bus) return ESP_ERR_INVALID_ARG;
@@ -76,25 +177,68 @@ esp_err_t veml7700_init(i2c_bus_handle_t i2c_bus)
         return ESP_FAIL;
     }
 
-    /* Configure sensor: Gain x1, Integration time 100ms, Enable */
-    uint16_t config = VEML7700_ALS_GAIN_1 | VEML7700_ALS_IT_100MS | VEML7700_ALS_PERS_1;
-    esp_err_t ret = veml7700_write_reg(VEML7700_REG_ALS_CONF, config);
+    /* Default range, enabled: Gain x1, Integration time 100ms */
+    i2c_shadow_invalidate(&als_conf_shadow);
+    i2c_shadow_invalidate(&psm_shadow);
+    gain_idx = 2;
+    it_idx = 2;
+    last_lux = -1.0f;
+    esp_err_t ret = veml7700_write_config(false);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to write configuration");
         return ret;
     }
+    i2c_shadow_store(veml7700_dev, &psm_shadow, 0);
+    powered = true;
 
-    /* Set resolution based on gain x1 and integration time 100ms */
-    current_resolution = 0.0036f;  // lux/count
-
-    /* Wait for first measurement to complete (100ms integration time) */
-    vTaskDelay(pdMS_TO_TICKS(150));
+    /* No blocking wait: the first read is held off by veml7700_get_ready_ms() */
+    veml7700_mark_started();
+    i2c_buses_track_device(i2c_bus, VEML7700_I2C_ADDR, &veml7700_dev);
 
-    ESP_LOGI(TAG, "VEML7700 initialized (Gain x1, IT 100ms, resolution %.4f lux/count)", 
-             current_resolution);
+    ESP_LOGI(TAG, "VEML7700 initialized (Gain x1, IT 100ms, resolution %.4f lux/count)",
+             resolution(gain_idx, it_idx));
     return ESP_OK;
 }
 
+void veml7700_set_auto_range(bool enable)
+{
+    auto_range = enable;
+    if (enable) {
+        /* Nothing known yet: least sensitive range can't clip in direct sun */
+        gain_idx = 0;
+        it_idx = 0;
+    }
+}
+
+esp_err_t veml7700_set_power_saving(bool enable)
+{
+    if (!veml7700_dev) return ESP_ERR_INVALID_STATE;
+    return i2c_shadow_write(veml7700_dev, &psm_shadow, enable ? (VEML7700_PSM_MODE_4 | VEML7700_PSM_EN) : 0);
+}
+
+esp_err_t veml7700_start_measurement(uint32_t *ready_ms)
+{
+    if (!veml7700_dev) return ESP_ERR_INVALID_STATE;
+
+    if (auto_range && last_lux >= 0.0f) {
+        pick_range(last_lux);
+    }
+    /* A config write restarts the integration with the new range */
+    esp_err_t ret = veml7700_write_config(false);
+    if (ret == ESP_OK) {
+        powered = true;
+        veml7700_mark_started();
+    }
+    if (ready_ms) *ready_ms = veml7700_get_ready_ms();
+    return ret;
+}
+
+uint32_t veml7700_get_ready_ms(void)
+{
+    int64_t remaining_us = first_result_at_us - esp_timer_get_time();
+    return remaining_us > 0 ? (uint32_t)((remaining_us + 999) / 1000) : 0;
+}
+
 esp_err_t veml7700_read_als_raw(uint16_t *als_raw)
 {
     if (!als_raw || !veml7700_dev) return ESP_ERR_INVALID_ARG;
@@ -112,26 +256,43 @@ esp_err_t veml7700_read_lux(float *lux)
     if (ret != ESP_OK) return ret;
 
     /* Convert raw count to lux using current resolution */
-    *lux = als_raw * current_resolution;
+    float value = als_raw * resolution(gain_idx, it_idx);
+    if (value > VEML7700_NONLINEAR_LUX) {
+        /* Vishay "Designing the VEML7700 into an application" correction */
+        value = (((6.0135e-13f * value - 9.3924e-9f) * value + 8.1488e-5f) * value + 1.0023f) * value;
+    }
+    *lux = value;
+
+    ESP_LOGD(TAG, "Light: %.2f lux (raw: %d, gain x%.3f, IT %u ms)", value, als_raw,
+             GAINS[gain_idx].factor, ITS[it_idx].ms);
 
-    ESP_LOGD(TAG, "Light: %.2f lux (raw: %d)", *lux, als_raw);
+    if (!auto_range) return ESP_OK;
+
+    /* Re-range if the count clipped or is too coarse and another range helps */
+    uint8_t old_g = gain_idx, old_i = it_idx;
+    bool saturated = als_raw >= VEML7700_RAW_SATURATED;
+    last_lux = saturated ? value * 8.0f : value;    // clipped: assume much brighter
+    if (saturated || als_raw < VEML7700_RAW_MIN) {
+        pick_range(last_lux);
+        if (gain_idx != old_g || it_idx != old_i) {
+            ESP_LOGI(TAG, "Range: raw %u at gain x%.3f/IT %u ms -> gain x%.3f/IT %u ms", als_raw,
+                     GAINS[old_g].factor, ITS[old_i].ms, GAINS[gain_idx].factor, ITS[it_idx].ms);
+            return ESP_ERR_NOT_FINISHED;
+        }
+    }
     return ESP_OK;
 }
 
 esp_err_t veml7700_power_down(void)
 {
     if (!veml7700_dev) return ESP_ERR_INVALID_STATE;
+    if (!powered) return ESP_OK;
 
-    /* Read current config */
-    uint16_t config;
-    esp_err_t ret = veml7700_read_reg(VEML7700_REG_ALS_CONF, &config);
-    if (ret != ESP_OK) return ret;
-
-    /* Set ALS_SD bit to shut down sensor */
-    config |= VEML7700_ALS_SD;
-    ret = veml7700_write_reg(VEML7700_REG_ALS_CONF, config);
+    /* Config is known locally: one write, no read-modify-write */
+    esp_err_t ret = veml7700_write_config(true);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "VEML7700 powered down");
+        powered = false;
+        ESP_LOGD(TAG, "VEML7700 powered down");
     }
     return ret;
 }
@@ -140,17 +301,12 @@ esp_err_t veml7700_power_up(void)
 {
     if (!veml7700_dev) return ESP_ERR_INVALID_STATE;
 
-    /* Read current config */
-    uint16_t config;
-    esp_err_t ret = veml7700_read_reg(VEML7700_REG_ALS_CONF, &config);
-    if (ret != ESP_OK) return ret;
-
-    /* Clear ALS_SD bit to wake up sensor */
-    config &= ~VEML7700_ALS_SD;
-    ret = veml7700_write_reg(VEML7700_REG_ALS_CONF, config);
+    /* Clear ALS_SD to wake up the sensor */
+    esp_err_t ret = veml7700_write_config(false);
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "VEML7700 powered up");
-        vTaskDelay(pdMS_TO_TICKS(5));  // Wait for sensor to stabilize
+        powered = true;
+        ESP_LOGD(TAG, "VEML7700 powered up");
+        veml7700_mark_started();
     }
     return ret;
 }
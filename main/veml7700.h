@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include "i2c_bus.h"
 #include "esp_err.h"
 
@@ -23,11 +24,42 @@ extern "C" {
  */
 esp_err_t veml7700_init(i2c_bus_handle_t i2c_bus);
 
+/**
+ * @brief Enable auto-ranging
+ *
+ * Each veml7700_start_measurement() then picks gain and integration time from
+ * the previous reading: the shortest integration (up to 400 ms) and lowest
+ * gain that keep the count between 100 and 10000.
+ *
+ * @param enable true to auto-range, false to keep gain x1 / IT 100 ms
+ */
+void veml7700_set_auto_range(bool enable);
+
+/**
+ * @brief Enable or disable power saving mode 4 (for a sensor left powered)
+ *
+ * @param enable true for PSM mode 4
+ * @return ESP_OK on success
+ */
+esp_err_t veml7700_set_power_saving(bool enable);
+
+/**
+ * @brief Power the sensor up with the current (or auto-selected) range
+ *
+ * @param ready_ms Receives the time until the first integration is complete
+ * @return ESP_OK on success
+ */
+esp_err_t veml7700_start_measurement(uint32_t *ready_ms);
+
 /**
  * @brief Read ambient light level in lux
+ *
+ * Readings above 1000 lux get the Vishay non-linearity correction.
  * 
  * @param lux Pointer to store light level in lux
- * @return ESP_OK on success
+ * @return ESP_OK on success; with auto-ranging ESP_ERR_NOT_FINISHED if the
+ *         count clipped or was too low and a new range was selected (*lux is
+ *         still filled in; start a new measurement for an accurate value)
  */
 esp_err_t veml7700_read_lux(float *lux);
 
@@ -40,14 +72,24 @@ esp_err_t veml7700_read_lux(float *lux);
 esp_err_t veml7700_read_als_raw(uint16_t *als_raw);
 
 /**
- * @brief Enable power saving mode
+ * @brief Time until the current integration period holds valid data
+ *
+ * Non-zero only right after veml7700_init()/veml7700_power_up(): the first
+ * result needs one full integration time (plus 10 % oscillator tolerance).
+ *
+ * @return Remaining milliseconds, 0 when a result is available
+ */
+uint32_t veml7700_get_ready_ms(void);
+
+/**
+ * @brief Shut the sensor down (ALS_SD, ~0.5 uA)
  * 
  * @return ESP_OK on success
  */
 esp_err_t veml7700_power_down(void);
 
 /**
- * @brief Wake from power saving mode
+ * @brief Wake from shutdown with the current range
  * 
  * @return ESP_OK on success
  */
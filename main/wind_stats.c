@@ -0,0 +1,312 @@
+/*
+ * Wind statistics engine
+ *
+ * Two rings live in RTC_NOINIT memory (kept across software resets):
+ *   - per-second: pulse count, speed + vane angle for the last 2 minutes
+ *   - per-minute: pulse sum + direction sin/cos sums for the last 10 minutes
+ * Direction is averaged as a unit vector (sum of sin/cos), so averaging across
+ * North (359° and 1°) gives 0° instead of 180°.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "wind_stats.h"
+#include "anemometer.h"
+#include "as5600.h"
+#include "i2c_config.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_rtc_time.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "WIND_STATS";
+
+#define WIND_STATS_MAGIC            0x57535432  // "WST2"
+#define WIND_STATS_MAX_GAP_US       (60ULL * 1000000ULL)  // resume history after a reset shorter than this
+#define WIND_STATS_ANGLE_INVALID    0xFFFF
+#define WIND_STATS_TASK_STACK       3072
+#define WIND_STATS_TASK_PRIORITY    3
+
+#define DEG_TO_RAD(d)   ((d) * (float)M_PI / 180.0f)
+#define RAD_TO_DEG(r)   ((r) * 180.0f / (float)M_PI)
+
+typedef struct {
+    uint32_t magic;
+    uint64_t last_sample_us;                        // esp_rtc_get_time_us() of the newest sample
+
+    /* Per-second ring */
+    uint16_t sec_head;                              // next slot to write
+    uint16_t sec_count;
+    uint8_t  sec_pulses[WIND_STATS_SHORT_SECONDS];  // saturates at 255 pulses/s (~130 m/s)
+    uint16_t sec_angle[WIND_STATS_SHORT_SECONDS];   // 0.1° steps, WIND_STATS_ANGLE_INVALID = no sample
+    uint16_t sec_speed_cms[WIND_STATS_SHORT_SECONDS];  // per-second speed in cm/s (period-based at low wind)
+
+    /* Per-minute ring */
+    uint8_t  min_head;
+    uint8_t  min_count;
+    uint16_t min_pulses[WIND_STATS_LONG_MINUTES];
+    float    min_sin[WIND_STATS_LONG_MINUTES];
+    float    min_cos[WIND_STATS_LONG_MINUTES];
+    uint8_t  min_dir_n[WIND_STATS_LONG_MINUTES];
+
+    /* Minute being filled */
+    uint16_t cur_pulses;
+    uint8_t  cur_seconds;
+    uint8_t  cur_dir_n;
+    float    cur_sin;
+    float    cur_cos;
+
+    /* Since the previous report */
+    uint32_t report_pulses;
+    uint32_t report_seconds;
+    uint16_t gust_peak_cms;                         // highest 3-second mean of sec_speed_cms
+} wind_stats_rtc_t;
+
+static RTC_NOINIT_ATTR wind_stats_rtc_t rtc_wind;
+
+static SemaphoreHandle_t wind_mutex = NULL;
+static bool wind_running = false;
+static bool wind_sample_vane = false;
+static bool vane_bus_held = false;          // sampler's reference on bus 2
+static uint16_t vane_still_s = 0;           // seconds in a row without a pulse
+
+static void wind_stats_reset_history(void)
+{
+    memset(&rtc_wind, 0, sizeof(rtc_wind));
+    rtc_wind.magic = WIND_STATS_MAGIC;
+    rtc_wind.last_sample_us = esp_rtc_get_time_us();
+}
+
+static bool wind_stats_history_valid(void)
+{
+    if (rtc_wind.magic != WIND_STATS_MAGIC ||
+        rtc_wind.sec_head >= WIND_STATS_SHORT_SECONDS || rtc_wind.sec_count > WIND_STATS_SHORT_SECONDS ||
+        rtc_wind.min_head >= WIND_STATS_LONG_MINUTES || rtc_wind.min_count > WIND_STATS_LONG_MINUTES ||
+        rtc_wind.cur_seconds >= 60) {
+        return false;
+    }
+    uint64_t now = esp_rtc_get_time_us();
+    return now >= rtc_wind.last_sample_us && (now - rtc_wind.last_sample_us) < WIND_STATS_MAX_GAP_US;
+}
+
+/* Push one second worth of data. Caller holds wind_mutex. */
+static void wind_stats_push(uint32_t pulses, float speed_ms, uint16_t angle_ddeg)
+{
+    uint8_t p = pulses > UINT8_MAX ? UINT8_MAX : (uint8_t)pulses;
+    float cms = speed_ms * 100.0f;
+
+    rtc_wind.sec_pulses[rtc_wind.sec_head] = p;
+    rtc_wind.sec_speed_cms[rtc_wind.sec_head] = cms > UINT16_MAX ? UINT16_MAX : (uint16_t)lroundf(cms);
+    rtc_wind.sec_angle[rtc_wind.sec_head] = angle_ddeg;
+    rtc_wind.sec_head = (rtc_wind.sec_head + 1) % WIND_STATS_SHORT_SECONDS;
+    if (rtc_wind.sec_count < WIND_STATS_SHORT_SECONDS) rtc_wind.sec_count++;
+
+    /* Running 3 s mean for the gust peak (window may span the previous report) */
+    if (rtc_wind.sec_count >= WIND_STATS_GUST_SECONDS) {
+        uint32_t sum = 0;
+        for (uint16_t i = 1; i <= WIND_STATS_GUST_SECONDS; i++) {
+            sum += rtc_wind.sec_speed_cms[(rtc_wind.sec_head + WIND_STATS_SHORT_SECONDS - i) % WIND_STATS_SHORT_SECONDS];
+        }
+        uint16_t mean = (uint16_t)(sum / WIND_STATS_GUST_SECONDS);
+        if (mean > rtc_wind.gust_peak_cms) rtc_wind.gust_peak_cms = mean;
+    }
+
+    rtc_wind.report_pulses += p;
+    rtc_wind.report_seconds++;
+
+    rtc_wind.cur_pulses += p;
+    if (angle_ddeg != WIND_STATS_ANGLE_INVALID) {
+        float rad = DEG_TO_RAD(angle_ddeg / 10.0f);
+        rtc_wind.cur_sin += sinf(rad);
+        rtc_wind.cur_cos += cosf(rad);
+        rtc_wind.cur_dir_n++;
+    }
+    if (++rtc_wind.cur_seconds >= 60) {
+        rtc_wind.min_pulses[rtc_wind.min_head] = rtc_wind.cur_pulses;
+        rtc_wind.min_sin[rtc_wind.min_head] = rtc_wind.cur_sin;
+        rtc_wind.min_cos[rtc_wind.min_head] = rtc_wind.cur_cos;
+        rtc_wind.min_dir_n[rtc_wind.min_head] = rtc_wind.cur_dir_n;
+        rtc_wind.min_head = (rtc_wind.min_head + 1) % WIND_STATS_LONG_MINUTES;
+        if (rtc_wind.min_count < WIND_STATS_LONG_MINUTES) rtc_wind.min_count++;
+
+        rtc_wind.cur_pulses = 0;
+        rtc_wind.cur_seconds = 0;
+        rtc_wind.cur_dir_n = 0;
+        rtc_wind.cur_sin = 0.0f;
+        rtc_wind.cur_cos = 0.0f;
+    }
+
+    rtc_wind.last_sample_us = esp_rtc_get_time_us();
+}
+
+static float wind_stats_vector_deg(float sum_sin, float sum_cos)
+{
+    float deg = RAD_TO_DEG(atan2f(sum_sin, sum_cos));
+    if (deg < 0.0f) deg += 360.0f;
+    if (deg >= 360.0f) deg -= 360.0f;
+    return deg;
+}
+
+/* Compute the statistics. Caller holds wind_mutex. */
+static void wind_stats_compute(wind_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->samples = rtc_wind.sec_count;
+
+    stats->mean_since_report_ms = anemometer_pulses_to_speed(rtc_wind.report_pulses, (float)rtc_wind.report_seconds);
+    stats->gust_ms = rtc_wind.gust_peak_cms / 100.0f;
+
+    /* 2 minutes: straight from the per-second ring */
+    uint32_t pulses = 0;
+    float s = 0.0f, c = 0.0f;
+    uint16_t dir_n = 0;
+    for (uint16_t i = 0; i < rtc_wind.sec_count; i++) {
+        pulses += rtc_wind.sec_pulses[i];
+        if (rtc_wind.sec_angle[i] != WIND_STATS_ANGLE_INVALID) {
+            float rad = DEG_TO_RAD(rtc_wind.sec_angle[i] / 10.0f);
+            s += sinf(rad);
+            c += cosf(rad);
+            dir_n++;
+        }
+    }
+    stats->avg_2min_ms = anemometer_pulses_to_speed(pulses, (float)rtc_wind.sec_count);
+    if (dir_n > 0) {
+        stats->dir_2min_deg = wind_stats_vector_deg(s, c);
+        stats->dir_valid = true;
+    }
+
+    /* 10 minutes: the minute being filled plus as many complete minutes as fit
+     * in the window (window is 9..10 minutes long once the ring is full) */
+    pulses = rtc_wind.cur_pulses;
+    uint32_t seconds = rtc_wind.cur_seconds;
+    s = rtc_wind.cur_sin;
+    c = rtc_wind.cur_cos;
+    dir_n = rtc_wind.cur_dir_n;
+    uint8_t full = (WIND_STATS_LONG_MINUTES * 60 - rtc_wind.cur_seconds) / 60;
+    if (full > rtc_wind.min_count) full = rtc_wind.min_count;
+    for (uint8_t i = 1; i <= full; i++) {
+        uint8_t idx = (rtc_wind.min_head + WIND_STATS_LONG_MINUTES - i) % WIND_STATS_LONG_MINUTES;
+        pulses += rtc_wind.min_pulses[idx];
+        seconds += 60;
+        s += rtc_wind.min_sin[idx];
+        c += rtc_wind.min_cos[idx];
+        dir_n += rtc_wind.min_dir_n[idx];
+    }
+    stats->avg_10min_ms = anemometer_pulses_to_speed(pulses, (float)seconds);
+    stats->dir_10min_deg = dir_n > 0 ? wind_stats_vector_deg(s, c) : stats->dir_2min_deg;
+}
+
+static void wind_stats_task(void *arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(WIND_STATS_SAMPLE_PERIOD_MS));
+
+        uint32_t pulses = anemometer_take_pulses();
+
+        /* One pulse per revolution: below a few pulses the 1 s count is too
+         * coarse, so the second takes the speed of the recent revolution periods */
+        float period_speed = 0.0f;
+        bool have_period = anemometer_get_period_speed(&period_speed, NULL) == ESP_OK;
+        float speed = (have_period && pulses < WIND_STATS_PERIOD_BELOW_PULSES)
+                      ? period_speed : anemometer_pulses_to_speed(pulses, 1.0f);
+
+        /* The vane is sampled while the cups turn; bus 2 is held across such a
+         * spell and released once the cups have been still for a while */
+        uint16_t angle_ddeg = WIND_STATS_ANGLE_INVALID;
+        if (wind_sample_vane) {
+            vane_still_s = pulses > 0 ? 0 : (vane_still_s < UINT16_MAX ? vane_still_s + 1 : vane_still_s);
+            if (vane_still_s < WIND_STATS_VANE_STILL_S) {
+                if (!vane_bus_held) {
+                    /* A failed rebuild is retried on the next second */
+                    vane_bus_held = i2c_buses_acquire(I2C_BUS2_MASK) == ESP_OK;
+                    if (!vane_bus_held) i2c_buses_release(I2C_BUS2_MASK);
+                }
+                float direction = 0.0f;
+                if (vane_bus_held && as5600_get_wind_direction(&direction) == ESP_OK) {
+                    angle_ddeg = (uint16_t)lroundf(direction * 10.0f) % 3600;
+                }
+            } else if (vane_bus_held) {
+                vane_bus_held = false;
+                i2c_buses_release(I2C_BUS2_MASK);
+            }
+        }
+
+        xSemaphoreTake(wind_mutex, portMAX_DELAY);
+        wind_stats_push(pulses, speed, angle_ddeg);
+        xSemaphoreGive(wind_mutex);
+    }
+}
+
+esp_err_t wind_stats_start(bool sample_vane)
+{
+    if (wind_running) return ESP_OK;
+
+    wind_mutex = xSemaphoreCreateMutex();
+    if (!wind_mutex) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (esp_reset_reason() != ESP_RST_POWERON && wind_stats_history_valid()) {
+        ESP_LOGI(TAG, "♻️ Resuming wind history from RTC memory (%u s, %u min)",
+                 rtc_wind.sec_count, rtc_wind.min_count);
+    } else {
+        wind_stats_reset_history();
+    }
+
+    /* Drop whatever accumulated before the sampler took over the counter */
+    anemometer_take_pulses();
+    anemometer_take_intervals(NULL, 0);
+    wind_sample_vane = sample_vane;
+    vane_bus_held = false;
+    vane_still_s = WIND_STATS_VANE_STILL_S;     // wait for the first pulse
+
+    BaseType_t task_ret = xTaskCreate(wind_stats_task, "wind_stats", WIND_STATS_TASK_STACK, NULL,
+                                      WIND_STATS_TASK_PRIORITY, NULL);
+    if (task_ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create wind stats task");
+        vSemaphoreDelete(wind_mutex);
+        wind_mutex = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    wind_running = true;
+    ESP_LOGI(TAG, "✅ Wind sampler running at %d ms (vane %s)", WIND_STATS_SAMPLE_PERIOD_MS,
+             sample_vane ? "sampled" : "not available");
+    return ESP_OK;
+}
+
+bool wind_stats_running(void)
+{
+    return wind_running;
+}
+
+esp_err_t wind_stats_get(wind_stats_t *stats)
+{
+    if (!stats) return ESP_ERR_INVALID_ARG;
+    if (!wind_running) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(wind_mutex, portMAX_DELAY);
+    wind_stats_compute(stats);
+    xSemaphoreGive(wind_mutex);
+    return ESP_OK;
+}
+
+esp_err_t wind_stats_take_report(wind_stats_t *stats)
+{
+    if (!stats) return ESP_ERR_INVALID_ARG;
+    if (!wind_running) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(wind_mutex, portMAX_DELAY);
+    wind_stats_compute(stats);
+    rtc_wind.report_pulses = 0;
+    rtc_wind.report_seconds = 0;
+    rtc_wind.gust_peak_cms = 0;
+    xSemaphoreGive(wind_mutex);
+    return ESP_OK;
+}
@@ -0,0 +1,80 @@
+/*
+ * Wind statistics engine
+ * Samples the anemometer pulse count and the AS5600 vane once per second into
+ * a ring buffer in RTC memory and derives gust / rolling averages from it, so
+ * the report cadence no longer hides short-term wind behaviour. The averages
+ * come from pulse counts; the gust comes from per-second speeds, which at low
+ * wind are taken from the median revolution period.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WIND_STATS_SAMPLE_PERIOD_MS     1000    // one sample per second
+#define WIND_STATS_GUST_SECONDS         3       // WMO gust: peak 3-second mean
+#define WIND_STATS_SHORT_SECONDS        120     // 2-minute average (per-second ring)
+#define WIND_STATS_LONG_MINUTES         10      // 10-minute average (per-minute ring)
+#define WIND_STATS_PERIOD_BELOW_PULSES  8       // seconds with fewer pulses use the period-based speed
+#define WIND_STATS_VANE_STILL_S         30      // vane sampling (and bus 2) stops after this long without a pulse
+
+typedef struct {
+    float mean_since_report_ms;     // mean speed since the previous report
+    float gust_ms;                  // peak 3 s mean since the previous report (0.01 m/s steps)
+    float avg_2min_ms;              // mean speed over the last 2 minutes
+    float avg_10min_ms;             // mean speed over the last ~10 minutes
+    float dir_2min_deg;             // vector-averaged direction, 2 minutes
+    float dir_10min_deg;            // vector-averaged direction, ~10 minutes
+    bool dir_valid;                 // false if no vane samples in the window
+    uint16_t samples;               // seconds held in the 2-minute ring
+} wind_stats_t;
+
+/**
+ * @brief Start the 1 Hz sampler
+ *
+ * Takes over the anemometer pulse counter (anemometer_get_wind_speed() must no
+ * longer be used). History kept in RTC memory is resumed after a software
+ * reset if it is recent enough, otherwise it is cleared. The vane is only
+ * sampled while the cups turn: the sampler holds I2C bus 2 from the first
+ * pulse until WIND_STATS_VANE_STILL_S seconds without one, then releases it
+ * so the bus can be parked.
+ *
+ * @param sample_vane true if the AS5600 is available and should be sampled
+ * @return ESP_OK on success
+ */
+esp_err_t wind_stats_start(bool sample_vane);
+
+/**
+ * @brief Check whether the sampler is running
+ *
+ * @return true after a successful wind_stats_start()
+ */
+bool wind_stats_running(void);
+
+/**
+ * @brief Current statistics without resetting anything
+ *
+ * @param stats Filled with the current values
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the sampler is not running
+ */
+esp_err_t wind_stats_get(wind_stats_t *stats);
+
+/**
+ * @brief Current statistics, then restart the "since report" mean and the gust peak
+ *
+ * Call once per wind speed report.
+ *
+ * @param stats Filled with the current values
+ * @return ESP_OK on success, ESP_ERR_INVALID_STATE if the sampler is not running
+ */
+esp_err_t wind_stats_take_report(wind_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
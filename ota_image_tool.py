@@ -0,0 +1,263 @@
+#!/usr/bin/env python3
+"""
+Compressed / delta OTA image tool for Caelum Pro
+================================================
+
+Produces the payload that main/ota_decoder.c decodes on the device. The output
+replaces the raw app .bin as the input of esp-zigbee-sdk's image_builder_tool,
+which wraps it in a Zigbee OTA file (use the compressed image type, 0x1203).
+
+Payload layout (little endian):
+
+    0   "CLMZ"
+    4   u8  format version (1)
+    5   u8  method: 1 = full image, 2 = delta against the running image
+    6   u8  heatshrink window bits (W)
+    7   u8  heatshrink lookahead bits (L)
+    8   u32 decoded image size
+    12  u32 delta base size (0 for full images)
+    16  u32 CRC32 of the delta base (0 for full images)
+    20  heatshrink bit stream
+
+A delta stream decompresses to instructions:
+
+    0x01 COPY   u32 base offset, u32 length
+    0x02 INSERT u32 length, <length literal bytes>
+
+Usage:
+    python ota_image_tool.py compress -f build/caelum_pro.bin -o build/caelum_pro.clmz
+    python ota_image_tool.py delta --base old/caelum_pro.bin -f build/caelum_pro.bin -o build/caelum_pro.clmz
+
+Every generated payload is decoded again and compared with the input before it
+is written.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+MAGIC = b"CLMZ"
+FORMAT_VERSION = 1
+METHOD_FULL = 1
+METHOD_DELTA = 2
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+DEFAULT_WINDOW_BITS = 10     # must not exceed OTA_DECODER_MAX_WINDOW_BITS
+DEFAULT_LOOKAHEAD_BITS = 4
+
+DELTA_BLOCK = 32             # base is indexed in blocks of this size
+DELTA_MIN_COPY = 24          # shorter matches are cheaper as INSERT
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.bits = 0
+
+    def put(self, value, count):
+        for i in range(count - 1, -1, -1):
+            self.acc = (self.acc << 1) | ((value >> i) & 1)
+            self.bits += 1
+            if self.bits == 8:
+                self.out.append(self.acc)
+                self.acc = 0
+                self.bits = 0
+
+    def finish(self):
+        if self.bits:
+            self.out.append(self.acc << (8 - self.bits))
+        return bytes(self.out)
+
+
+def heatshrink_encode(data, w, l):
+    """Greedy LZSS in heatshrink's bit format (tag 1 = literal, 0 = backref)."""
+    window = 1 << w
+    max_len = 1 << l
+    writer = BitWriter()
+    chains = {}
+    i = 0
+    n = len(data)
+    while i < n:
+        best_len = 0
+        best_off = 0
+        if i + 2 <= n:
+            key = data[i:i + 2]
+            for pos in reversed(chains.get(key, ())):
+                off = i - pos
+                if off > window:
+                    break
+                length = 2
+                limit = min(max_len, n - i)
+                while length < limit and data[pos + length] == data[i + length]:
+                    length += 1
+                if length > best_len:
+                    best_len = length
+                    best_off = off
+                    if length == limit:
+                        break
+        # a backref costs 1 + W + L bits, a literal 9
+        step = best_len if best_len * 9 > 1 + w + l else 1
+        if step > 1:
+            writer.put(0, 1)
+            writer.put(best_off - 1, w)
+            writer.put(best_len - 1, l)
+        else:
+            writer.put(1, 1)
+            writer.put(data[i], 8)
+        for j in range(i, i + step):
+            if j + 2 <= n:
+                chain = chains.setdefault(data[j:j + 2], [])
+                chain.append(j)
+                if len(chain) > 64:
+                    del chain[:32]
+        i += step
+    return writer.finish()
+
+
+def heatshrink_decode(stream, w, l, out_size):
+    """Reference decoder, mirrors ota_decoder.c. Stops at out_size bytes."""
+    out = bytearray()
+    bitpos = 0
+    total_bits = len(stream) * 8
+
+    def get(count):
+        nonlocal bitpos
+        if bitpos + count > total_bits:
+            return None
+        value = 0
+        for _ in range(count):
+            value = (value << 1) | ((stream[bitpos >> 3] >> (7 - (bitpos & 7))) & 1)
+            bitpos += 1
+        return value
+
+    while len(out) < out_size:
+        tag = get(1)
+        if tag is None:
+            break
+        if tag:
+            value = get(8)
+            if value is None:
+                break
+            out.append(value)
+        else:
+            index = get(w)
+            count = get(l)
+            if index is None or count is None:
+                break
+            for _ in range(count + 1):
+                out.append(out[len(out) - index - 1] if index < len(out) else 0)
+    return bytes(out)
+
+
+def delta_encode(base, target):
+    """COPY/INSERT instruction stream rebuilding target from base."""
+    index = {}
+    for pos in range(0, len(base) - DELTA_BLOCK + 1, DELTA_BLOCK):
+        index.setdefault(base[pos:pos + DELTA_BLOCK], pos)
+
+    ops = bytearray()
+    literal_start = 0
+    i = 0
+    n = len(target)
+
+    def flush_literal(end):
+        if end > literal_start:
+            ops.extend(struct.pack("<BI", OP_INSERT, end - literal_start))
+            ops.extend(target[literal_start:end])
+
+    while i + DELTA_BLOCK <= n:
+        pos = index.get(target[i:i + DELTA_BLOCK])
+        if pos is None:
+            i += 1
+            continue
+        start, src = i, pos
+        # grow the match backwards into pending literals, then forwards
+        while start > literal_start and src > 0 and target[start - 1] == base[src - 1]:
+            start -= 1
+            src -= 1
+        end, src_end = i + DELTA_BLOCK, pos + DELTA_BLOCK
+        while end < n and src_end < len(base) and target[end] == base[src_end]:
+            end += 1
+            src_end += 1
+        if end - start < DELTA_MIN_COPY:
+            i += 1
+            continue
+        flush_literal(start)
+        ops.extend(struct.pack("<BII", OP_COPY, src, end - start))
+        literal_start = i = end
+    flush_literal(n)
+    return bytes(ops)
+
+
+def delta_apply(base, ops, out_size):
+    out = bytearray()
+    i = 0
+    while len(out) < out_size:
+        op = ops[i]
+        if op == OP_COPY:
+            src, length = struct.unpack_from("<II", ops, i + 1)
+            out.extend(base[src:src + length])
+            i += 9
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from("<I", ops, i + 1)
+            out.extend(ops[i + 5:i + 5 + length])
+            i += 5 + length
+        else:
+            raise ValueError("unknown delta op 0x%02x" % op)
+    return bytes(out)
+
+
+def build_payload(target, base, w, l):
+    if base is None:
+        method, base_size, base_crc, body = METHOD_FULL, 0, 0, target
+    else:
+        method, base_size, base_crc = METHOD_DELTA, len(base), zlib.crc32(base)
+        body = delta_encode(base, target)
+    stream = heatshrink_encode(body, w, l)
+    header = MAGIC + struct.pack("<BBBBIII", FORMAT_VERSION, method, w, l, len(target), base_size, base_crc)
+
+    decoded = heatshrink_decode(stream, w, l, len(body))
+    if method == METHOD_DELTA:
+        decoded = delta_apply(base, decoded, len(target))
+    if decoded != target:
+        raise RuntimeError("round-trip check failed")
+    return header + stream
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build compressed / delta OTA payloads for Caelum Pro")
+    sub = parser.add_subparsers(dest="command", required=True)
+    for name in ("compress", "delta"):
+        p = sub.add_parser(name)
+        p.add_argument("-f", "--file", required=True, help="new app image (.bin)")
+        p.add_argument("-o", "--output", required=True, help="payload for image_builder_tool")
+        p.add_argument("-w", "--window-bits", type=int, default=DEFAULT_WINDOW_BITS)
+        p.add_argument("-l", "--lookahead-bits", type=int, default=DEFAULT_LOOKAHEAD_BITS)
+        if name == "delta":
+            p.add_argument("--base", required=True, help="app image currently running on the device (.bin)")
+    args = parser.parse_args()
+
+    if not 4 <= args.window_bits <= DEFAULT_WINDOW_BITS or not 3 <= args.lookahead_bits < args.window_bits:
+        parser.error("window bits must be 4..%d and lookahead bits 3..W-1" % DEFAULT_WINDOW_BITS)
+
+    with open(args.file, "rb") as f:
+        target = f.read()
+    base = None
+    if args.command == "delta":
+        with open(args.base, "rb") as f:
+            base = f.read()
+
+    payload = build_payload(target, base, args.window_bits, args.lookahead_bits)
+    with open(args.output, "wb") as f:
+        f.write(payload)
+
+    print("%s: %d -> %d bytes (%.1f%%)" % (args.command, len(target), len(payload),
+                                           100.0 * len(payload) / max(len(target), 1)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())